@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <map>
 #include <chrono>
 #include <iostream>
@@ -107,6 +108,34 @@ struct ApiResponse {
         success = (http_code >= 200 && http_code < 300);
     }
 
+    // Helper to send an already-serialized body as-is; the server never re-parses it
+    void setSerializedResponse(std::string serialized, std::string type, int http_code = 200) {
+        body = std::move(serialized);
+        content_type = std::move(type);
+        status_code = http_code;
+        http_status = http_code;
+        success = (http_code >= 200 && http_code < 300);
+    }
+
+    // Content-Type for raw handler output, judged from its leading bytes only
+    static const char* detectContentType(std::string_view content) {
+        size_t start = content.find_first_not_of(" \t\r\n");
+        if (start == std::string_view::npos) {
+            return "text/plain";
+        }
+        std::string_view head = content.substr(start, 5);
+        if (head[0] == '{' || head[0] == '[') {
+            return "application/json";
+        }
+        if (head == "<!DOC" || head == "<html") {
+            return "text/html";
+        }
+        if (head == "<?xml") {
+            return "application/xml";
+        }
+        return "text/plain";
+    }
+
     // Helper to set error response
     void setErrorResponse(const std::string& message, int code = 500) {
         status_code = code;
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Crash-safe replacement of configuration and state files.
+ *
+ * Writing through std::ofstream truncates the file first, so losing power
+ * before the data reaches the flash leaves an empty or partial file behind.
+ * AtomicFile::write() builds the new contents in an unnamed temporary file
+ * (O_TMPFILE, or a named one where the file system lacks it), syncs it and
+ * renames it over the old file, so after a crash the path holds either the
+ * old or the new contents.
+ */
+class AtomicFile {
+public:
+    // Replace path with contents, keeping the mode of the file replaced.
+    // durable=false skips the fsyncs, for callers whose data is already safe
+    // elsewhere (the WriteJournal); the replacement is still atomic.
+    static bool write(const std::string& path, const std::string& contents, std::string& error,
+                      bool durable = true);
+
+    // fsync of a file or directory; a path that no longer exists is not an error
+    static bool syncPath(const std::string& path);
+
+    static std::string directoryOf(const std::string& path);
+};
+
+/**
+ * Append-only journal that makes many small file updates durable with one
+ * fsync.
+ *
+ * An update is appended to the journal and the journal is synced once for
+ * every writer that arrived in the meantime (group commit); the target file
+ * is then replaced atomically but without syncing it. Once the journal grows
+ * past CHECKPOINT_BYTES, or on close(), the files written since the last
+ * checkpoint are synced and the journal is emptied. After a crash, open()
+ * writes the updates still in the journal back out.
+ *
+ * Until open() is called, and for updates too large to be worth journaling,
+ * writes go through AtomicFile::write() with its own fsyncs. A journal that
+ * is open is checkpointed before such a write, so no older record of the
+ * same file is left for replay to roll it back to.
+ */
+class WriteJournal {
+public:
+    struct Update {
+        std::string path;
+        std::string contents;
+        std::string error;      // Set when this update could not be written
+    };
+
+    static constexpr size_t CHECKPOINT_BYTES = 1024 * 1024;
+    static constexpr size_t MAX_JOURNALED_BYTES = 256 * 1024;   // Per write() call
+
+    static WriteJournal& getInstance();
+
+    // Open (or create) the journal and replay what a crash left in it
+    bool open(const std::string& path);
+    bool isOpen() const;
+
+    // Make the updates durable, then replace their files. False when any of
+    // them failed; see Update::error.
+    bool write(std::vector<Update>& updates);
+    bool write(const std::string& path, const std::string& contents, std::string& error);
+
+    // Sync the files written since the last checkpoint and empty the journal
+    bool checkpoint();
+
+    // Checkpoint and close; later writes go through AtomicFile::write()
+    void close();
+
+private:
+    WriteJournal() = default;
+    ~WriteJournal();
+    WriteJournal(const WriteJournal&) = delete;
+    WriteJournal& operator=(const WriteJournal&) = delete;
+
+    size_t replay();
+    bool append(const std::string& records);
+    bool checkpointLocked();                // Caller holds checkpoint_lock_ exclusively
+    static bool writeDirect(std::vector<Update>& updates);
+
+    std::shared_mutex checkpoint_lock_;     // Shared by writers, exclusive for a checkpoint
+
+    mutable std::mutex mutex_;
+    std::condition_variable synced_cv_;
+    int fd_ = -1;
+    std::string path_;
+    size_t size_ = 0;                       // Bytes in the journal
+    uint64_t appended_ = 0;                 // Appends so far
+    uint64_t synced_ = 0;                   // Appends known to be on disk
+    bool syncing_ = false;                  // A writer is in fdatasync() for the others
+    std::set<std::string> unsynced_;        // Files replaced since the last checkpoint
+};
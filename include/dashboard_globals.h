@@ -66,7 +66,9 @@ namespace DashboardGlobals {
     bool updateAllData(bool force_update = false);
     
     /**
-     * Update specific component data
+     * Update specific component data. System data is copied from the
+     * SystemMetricsSampler snapshot; network and cellular still collect
+     * synchronously and are called from the background updater thread.
      */
     bool updateSystemData(bool force_update = false);
     bool updateNetworkData(bool force_update = false);
@@ -160,8 +162,15 @@ namespace DashboardGlobals {
                                    bool include_performance = true);
     
     /**
-     * Force refresh of all data and return updated response
-     * @return JSON string with refreshed dashboard data
+     * Ask the background threads to refresh a component ahead of schedule.
+     * Returns immediately; request threads never collect data themselves.
+     * @param component "system", "network", "cellular" or "all"
+     */
+    void requestRefresh(const std::string& component);
+    
+    /**
+     * Schedule a refresh of all data and return the current response
+     * @return JSON string with dashboard data
      */
     std::string getRefreshedDashboardResponse();
     
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+/**
+ * In-process DNS stub resolver shared by the DNS utility and every engine
+ * that needs a host name turned into an address.
+ *
+ * Queries go out over UDP (with EDNS0) on a connected socket per server and
+ * are retried over TCP when the answer comes back truncated. A query is sent
+ * to all of its servers at once: by default the first usable answer wins;
+ * with all_servers every server is waited for so their latencies can be
+ * compared. Everything runs on one reactor thread.
+ *
+ * Answers are cached for their TTL, negative answers for the SOA minimum
+ * (RFC 2308), keyed by name, type and servers. /etc/resolv.conf and
+ * /etc/hosts are re-read when they change.
+ *
+ * on_done runs on the reactor thread: it must not block and must not call
+ * lookup() or resolve().
+ */
+class DnsEngine {
+public:
+    struct Record {
+        std::string name;                   // Owner name, fully qualified ("example.com.")
+        std::string type;                   // "A", "MX", ... ("TYPE65" when unknown)
+        std::string recordClass = "IN";
+        uint32_t ttl = 0;
+        std::string value;                  // As dig prints it; MX without the preference
+        int priority = 0;                   // MX preference, SRV priority
+    };
+
+    struct ServerTiming {
+        std::string server;                 // "192.0.2.53#53"
+        bool answered = false;
+        double rtt_ms = 0.0;                // Until the answer (or the failure)
+        std::string status;                 // RCODE ("NOERROR", ...), why there was no answer, or
+                                            // empty when not waited for
+    };
+
+    struct Response {
+        std::string status;                 // RCODE of the answer used; empty when none came
+        std::string error;                  // Why no server answered
+        std::string server;                 // That gave the answer used
+        bool authoritative = false;
+        bool recursion_available = false;
+        bool truncated = false;             // The UDP answer was truncated and TCP was used
+        bool from_cache = false;
+        double query_time_ms = 0.0;
+        size_t size = 0;                    // Bytes of the answer message
+        std::vector<Record> answers;
+        std::vector<Record> authority;
+        std::vector<Record> additional;
+        std::vector<ServerTiming> servers;  // Every server asked; empty for cached answers
+    };
+
+    struct Query {
+        std::string name;
+        uint16_t type = 1;                  // A
+        std::vector<std::string> servers;   // "addr" or "addr#port"; empty for the resolv.conf servers
+        bool ipv6_transport = false;        // Only ask the servers reachable over IPv6
+        bool recursive = true;
+        bool all_servers = false;           // Wait for every server instead of the first answer
+        bool use_cache = true;              // Answer from the cache when fresh
+        std::chrono::milliseconds timeout{5000};    // Per server, retransmissions included
+        int attempts = 2;                   // UDP transmissions per server
+        std::function<void(const Response& response)> on_done;
+    };
+
+    static constexpr size_t MAX_CACHE_ENTRIES = 4096;
+    static constexpr uint32_t MAX_CACHE_TTL = 86400;
+    static constexpr size_t MAX_SERVERS = 16;
+
+    static DnsEngine& getInstance();
+
+    // Type mnemonics ("MX") to numbers and back; unknown numbers are "TYPE<n>"
+    static bool typeFromName(const std::string& name, uint16_t& type);
+    static std::string typeName(uint16_t type);
+
+    // "192.0.2.1" -> "1.2.0.192.in-addr.arpa." (and ip6.arpa for IPv6);
+    // empty when the text is not an address
+    static std::string reverseName(const std::string& address);
+
+    // Start a query. Returns 0 when it completed at once (a cache hit, or it
+    // could not be sent) with on_done already called, otherwise an id.
+    uint64_t start(Query query);
+
+    // Query and wait
+    Response lookup(Query query);
+
+    // Run the queries concurrently and wait for all of them; responses are
+    // in query order
+    std::vector<Response> lookupAll(std::vector<Query> queries);
+
+    // Host name to address: literals, /etc/hosts, then A/AAAA queries through
+    // the cache with the resolv.conf search list, and getaddrinfo() when no
+    // server can be reached. AF_UNSPEC prefers IPv4.
+    bool resolve(const std::string& host, int family, sockaddr_storage& address,
+                 socklen_t& address_length, std::string& error);
+
+    // Current resolv.conf servers as "addr#port"
+    std::vector<std::string> systemServers();
+
+    size_t cacheSize() const;
+    void flushCache();
+    size_t activeCount() const;
+
+    // Fail every outstanding query and stop the reactor
+    void shutdown();
+
+private:
+    struct Server {
+        sockaddr_storage address{};
+        socklen_t length = 0;
+        std::string label;
+    };
+    struct SystemConfig {
+        std::vector<Server> servers;
+        std::vector<std::string> search;
+        int ndots = 1;
+        std::vector<std::pair<std::string, sockaddr_storage>> hosts;   // Lower-case name, address
+        timespec resolv_mtime{};
+        timespec hosts_mtime{};
+        std::chrono::steady_clock::time_point checked;
+    };
+    struct CacheEntry {
+        Response response;
+        std::chrono::steady_clock::time_point stored;
+        std::chrono::steady_clock::time_point expires;
+    };
+    struct Pending;
+    struct Attempt;
+
+    DnsEngine();
+    ~DnsEngine();
+    DnsEngine(const DnsEngine&) = delete;
+    DnsEngine& operator=(const DnsEngine&) = delete;
+
+    static bool parseServer(const std::string& text, Server& server);
+    void refreshSystemConfig();
+    bool lookupCache(const std::string& key, Response& response);
+    void storeCache(const std::string& key, const Response& response);
+
+    void wake();
+    void reactorLoop();
+    void adoptPending();
+    void openAttempt(Pending& query, size_t server_index);
+    bool sendUdp(Attempt& attempt);
+    void switchToTcp(Attempt& attempt, Pending& query);
+    void handleEvent(Attempt& attempt, uint32_t events);
+    bool handleMessage(Attempt& attempt, const uint8_t* data, size_t length);
+    void failAttempt(Attempt& attempt, const std::string& why);
+    void settle(Pending& query, size_t server_index, const Response* response, const std::string& why);
+    void checkDeadlines();
+    void finish(uint64_t id);
+    int nextTimeoutMs() const;
+
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Pending>> pending_;
+    std::set<uint64_t> live_;                       // Started and not yet finished
+    uint64_t next_id_ = 0;
+
+    std::mutex config_mutex_;
+    SystemConfig config_;
+
+    mutable std::mutex cache_mutex_;
+    std::unordered_map<std::string, CacheEntry> cache_;
+
+    // Reactor thread only
+    std::map<uint64_t, std::unique_ptr<Pending>> queries_;
+    std::map<uint64_t, std::unique_ptr<Attempt>> attempts_;     // By epoll key
+    uint64_t next_attempt_ = 0;
+    std::mt19937 random_;
+    std::vector<uint8_t> buffer_;
+
+    std::thread thread_;
+    std::atomic<bool> stopping_{false};
+};
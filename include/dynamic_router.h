@@ -2,24 +2,60 @@
 #define DYNAMIC_ROUTER_H
 
 #include <string>
+#include <string_view>
 #include <map>
 #include <vector>
 #include <functional>
-#include <regex>
 #include <memory>
+#include "api_request.h"
+#include "request_body_sink.h"
+
+using RouteHandlerFunction = std::function<std::string(const std::string&, const std::map<std::string, std::string>&, const std::string&)>;
+
+// Maps a download request's path/query params to the file to send; an empty
+// path answers 404
+using DownloadRouteResolver = std::function<std::string(const std::map<std::string, std::string>&)>;
+
+// Which route table a matched entry came from. When several tables register
+// the exact same path, the lookup prefers them in this order.
+enum class RouteKind {
+    NONE,
+    STREAMING,      // RequestBodySink factory, only chosen for POST/PUT
+    DOWNLOAD,       // File sent from its descriptor, only chosen for GET/HEAD
+    STRUCTURED,     // RouteProcessor taking ApiRequest / returning ApiResponse
+    DYNAMIC,        // Pattern routes ({param}, :param, trailing *)
+    LEGACY          // Exact-path string handlers
+};
+
+// Terminal payload stored in the route trie. One entry can hold a handler
+// from each table for the same path.
+struct RouteEntry {
+    std::string pattern;
+    std::vector<std::string> param_names;   // Capture names, in path order
+    StreamingRouteFactory streaming_factory;
+    DownloadRouteResolver download_resolver;
+    RouteProcessor structured_processor;
+    RouteHandlerFunction dynamic_handler;
+    RouteHandlerFunction legacy_handler;
+};
 
 struct RouteMatch {
     bool matched = false;
+    RouteKind kind = RouteKind::NONE;
+    const RouteEntry* entry = nullptr;
     std::map<std::string, std::string> path_params;
     std::map<std::string, std::string> query_params;
     std::string matched_pattern;
 };
 
-struct RoutePattern {
-    std::string pattern;
-    std::regex regex_pattern;
-    std::vector<std::string> param_names;
-    std::function<std::string(const std::string&, const std::map<std::string, std::string>&, const std::string&)> handler;
+// Segment trie node. Lookup walks one node per path segment, trying the
+// literal child first, then the capture child, then a trailing wildcard,
+// so the most specific route wins without any regex evaluation.
+struct RouteNode {
+    std::map<std::string, std::unique_ptr<RouteNode>, std::less<>> static_children;
+    std::unique_ptr<RouteNode> param_child;
+    std::unique_ptr<RouteEntry> wildcard_entry;
+    std::unique_ptr<RouteEntry> entry;
 };
 
 class DynamicRouter {
@@ -27,38 +63,48 @@ public:
     DynamicRouter();
     ~DynamicRouter() = default;
 
-    // Register routes with dynamic patterns
-    void addRoute(const std::string& pattern, 
-                  std::function<std::string(const std::string&, const std::map<std::string, std::string>&, const std::string&)> handler);
-    
+    // Register routes with dynamic patterns: "/api/users/{id}", "/api/users/:id", "/api/files/*"
+    void addRoute(const std::string& pattern, RouteHandlerFunction handler);
+
     // Static route registration (for backward compatibility)
-    void addStaticRoute(const std::string& path,
-                       std::function<std::string(const std::string&, const std::map<std::string, std::string>&, const std::string&)> handler);
-    
+    void addStaticRoute(const std::string& path, RouteHandlerFunction handler);
+
+    // Exact-path tables owned by HttpHandler, resolved in the same lookup
+    void addStructuredRoute(const std::string& path, RouteProcessor processor);
+    void addLegacyRoute(const std::string& path, RouteHandlerFunction handler);
+    void addStreamingRoute(const std::string& path, StreamingRouteFactory factory);
+
+    // Pattern route whose GET/HEAD requests are answered with a file
+    void addDownloadRoute(const std::string& pattern, DownloadRouteResolver resolver);
+
     // Process a request through dynamic routing
-    std::string processRequest(const std::string& method, const std::string& path, 
-                              const std::map<std::string, std::string>& query_params, 
+    std::string processRequest(const std::string& method, const std::string& path,
+                              const std::map<std::string, std::string>& query_params,
                               const std::string& body);
-    
-    // Check if a path matches any registered routes
-    RouteMatch findMatch(const std::string& path) const;
-    
+
+    // Resolve a path against all route tables in a single trie walk. Streaming
+    // routes are only selected when the method carries a body (POST/PUT),
+    // download routes only when it does not (GET/HEAD).
+    RouteMatch findMatch(std::string_view path, std::string_view method = {}) const;
+
     // Get all registered route patterns
     std::vector<std::string> getRegisteredPatterns() const;
 
 private:
-    std::vector<RoutePattern> dynamic_routes_;
-    std::map<std::string, std::function<std::string(const std::string&, const std::map<std::string, std::string>&, const std::string&)>> static_routes_;
-    
-    // Convert route pattern to regex
-    std::pair<std::regex, std::vector<std::string>> compilePattern(const std::string& pattern);
-    
-    // Extract path parameters from matched URL
-    std::map<std::string, std::string> extractPathParams(const std::string& path, const RoutePattern& route) const;
-    
-    // Utility functions
-    std::string escapeRegex(const std::string& input);
-    std::vector<std::string> splitPath(const std::string& path);
+    RouteNode root_;
+    std::vector<std::string> patterns_;
+
+    // Walk/create the trie for a pattern. Literal patterns never treat
+    // '{', ':' or '*' specially.
+    RouteEntry& insertPattern(const std::string& pattern, bool literal);
+
+    const RouteEntry* matchNode(const RouteNode* node, const std::string_view* segments,
+                                size_t segment_count, size_t depth,
+                                std::string_view path, std::string_view* captures,
+                                size_t& capture_count) const;
+
+    static bool isCaptureSegment(std::string_view segment, std::string& name);
+    static size_t splitPath(std::string_view path, std::string_view* segments, size_t max_segments);
 };
 
-#endif // DYNAMIC_ROUTER_H
\ No newline at end of file
+#endif // DYNAMIC_ROUTER_H
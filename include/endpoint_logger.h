@@ -2,57 +2,170 @@
 #define ENDPOINT_LOGGER_H
 
 #include <string>
+#include <string_view>
 #include <map>
 #include <iostream>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
 #include <mutex>
+#include <thread>
 
 /**
- * Centralized endpoint logging system that filters log messages based on 
- * endpoint group configuration from the JSON config file
+ * Centralized endpoint logging system that filters log messages based on
+ * endpoint group configuration from the JSON config file.
+ *
+ * Group names are interned once into small integer IDs, each with an atomic
+ * enable bit, so the ENDPOINT_LOG* macros can skip a disabled group before
+ * the message expression is even evaluated. Enabled messages are pushed into
+ * a bounded lock-free MPSC ring and formatted/written in batches by a
+ * background thread; request threads never touch stdout. When the ring is
+ * full the message is dropped and counted rather than blocking the caller.
  */
 class EndpointLogger {
 public:
+    using GroupId = uint16_t;
+
+    enum class Level : uint8_t {
+        PLAIN,
+        INFO,
+        WARNING,
+        ERROR
+    };
+
     static EndpointLogger& getInstance();
-    
+
     // Configure logging filters from ServerConfig
     void setEndpointFilters(const std::map<std::string, bool>& filters);
-    
+
+    // Map a group name to its ID, registering it on first use
+    GroupId internGroup(std::string_view endpoint_group);
+
+    // Lock-free enable check for an interned group
+    bool isEnabled(GroupId group) const {
+        return groups_[group].enabled.load(std::memory_order_relaxed);
+    }
+
     // Check if logging is enabled for a specific endpoint group
-    bool isLoggingEnabled(const std::string& endpoint_group) const;
-    
+    bool isLoggingEnabled(const std::string& endpoint_group);
+
+    // Queue a message for an interned group (caller has checked isEnabled)
+    void write(GroupId group, Level level, std::string message);
+
     // Log methods for different endpoint groups
     void log(const std::string& endpoint_group, const std::string& message);
     void logInfo(const std::string& endpoint_group, const std::string& message);
     void logWarning(const std::string& endpoint_group, const std::string& message);
     void logError(const std::string& endpoint_group, const std::string& message);
-    
-    // Convenience macros will be provided for easy usage
-    
+
+    // Block until everything queued so far has been written
+    void flush();
+
+    // Drain the ring and stop the writer thread; later messages are written
+    // synchronously. Runs automatically at exit.
+    void shutdown();
+
+    // Messages discarded because the ring was full
+    uint64_t getDroppedCount() const { return dropped_.load(std::memory_order_relaxed); }
+
 private:
-    EndpointLogger() = default;
+    static constexpr size_t MAX_GROUPS = 128;
+    static constexpr size_t RING_CAPACITY = 16384;   // Power of two
+    static constexpr size_t WRITE_BATCH_SIZE = 256;
+
+    struct Group {
+        std::string name;
+        std::atomic<bool> enabled{true};
+    };
+
+    struct Record {
+        std::chrono::system_clock::time_point time;
+        GroupId group = 0;
+        Level level = Level::PLAIN;
+        std::string message;
+    };
+
+    struct Slot {
+        std::atomic<size_t> sequence{0};
+        Record record;
+    };
+
+    EndpointLogger();
     ~EndpointLogger() = default;
     EndpointLogger(const EndpointLogger&) = delete;
     EndpointLogger& operator=(const EndpointLogger&) = delete;
-    
+
+    bool tryPush(Record&& record);
+    bool tryPop(Record& record);
+    void writerLoop();
+    void appendFormatted(std::string& out, const Record& record);
+    void writeOut(const std::string& text);
+
+    // Interned groups; names are written once under registry_mutex_ and never change
+    std::array<Group, MAX_GROUPS> groups_;
+    std::atomic<size_t> group_count_{0};
+    std::map<std::string, GroupId, std::less<>> group_ids_;
     std::map<std::string, bool> endpoint_filters_;
-    mutable std::mutex mutex_;
+    std::mutex registry_mutex_;
+
+    // Bounded MPSC ring (sequence-numbered slots)
+    std::unique_ptr<Slot[]> slots_;
+    alignas(64) std::atomic<size_t> enqueue_pos_{0};
+    alignas(64) size_t dequeue_pos_ = 0;
+    std::atomic<size_t> written_pos_{0};
+    std::atomic<uint64_t> dropped_{0};
+
+    // Writer thread
+    std::thread writer_;
+    std::atomic<bool> running_{false};
+    std::atomic<bool> writer_idle_{false};
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    std::mutex sync_write_mutex_;
+
+    // Formatting cache, only touched by whoever is writing
+    int64_t cached_second_ = -1;
+    char cached_timestamp_[32] = {};
 };
 
+// Resolve a group literal to its ID once per call site. The capture-less
+// lambda makes a non-constant group argument a compile error instead of a
+// silently cached wrong ID.
+#define ENDPOINT_LOG_GROUP_ID(group) \
+    ([]() -> EndpointLogger::GroupId { \
+        static const EndpointLogger::GroupId endpoint_log_group_id = \
+            EndpointLogger::getInstance().internGroup(group); \
+        return endpoint_log_group_id; \
+    }())
+
+// The message expression is only evaluated when the group is enabled
+#define ENDPOINT_LOG_AT(level, group, message) \
+    do { \
+        const EndpointLogger::GroupId endpoint_log_group_ = ENDPOINT_LOG_GROUP_ID(group); \
+        EndpointLogger& endpoint_logger_ = EndpointLogger::getInstance(); \
+        if (endpoint_logger_.isEnabled(endpoint_log_group_)) { \
+            endpoint_logger_.write(endpoint_log_group_, level, message); \
+        } \
+    } while (0)
+
 // Convenience macros for easier usage
 #define ENDPOINT_LOG(group, message) \
-    EndpointLogger::getInstance().log(group, message)
+    ENDPOINT_LOG_AT(EndpointLogger::Level::PLAIN, group, message)
 
 #define ENDPOINT_LOG_INFO(group, message) \
-    EndpointLogger::getInstance().logInfo(group, message)
+    ENDPOINT_LOG_AT(EndpointLogger::Level::INFO, group, message)
 
 #define ENDPOINT_LOG_WARNING(group, message) \
-    EndpointLogger::getInstance().logWarning(group, message)
+    ENDPOINT_LOG_AT(EndpointLogger::Level::WARNING, group, message)
 
 #define ENDPOINT_LOG_ERROR(group, message) \
-    EndpointLogger::getInstance().logError(group, message)
+    ENDPOINT_LOG_AT(EndpointLogger::Level::ERROR, group, message)
 
 // Check if logging is enabled for a group
 #define IS_ENDPOINT_LOGGING_ENABLED(group) \
-    EndpointLogger::getInstance().isLoggingEnabled(group)
+    EndpointLogger::getInstance().isEnabled(ENDPOINT_LOG_GROUP_ID(group))
 
-#endif // ENDPOINT_LOGGER_H
\ No newline at end of file
+#endif // ENDPOINT_LOGGER_H
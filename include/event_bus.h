@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+/**
+ * In-process topic publish/subscribe bus feeding the Server-Sent Events
+ * stream (see EventStream).
+ *
+ * Topics are dotted names ("dashboard", "firmware.tftp",
+ * "network-utility.ping"); a subscription filter matches a topic equal to it
+ * or nested below it, and an empty filter list matches everything. Each
+ * publish is formatted once into an SSE frame shared by every subscriber.
+ * The last frame of each topic is retained and replayed to new subscribers,
+ * so a page that connects mid-operation sees the current state immediately.
+ *
+ * Publishing never blocks on a slow client: every subscription has a bounded
+ * queue that drops its oldest frames when the client falls behind. Producers
+ * can call hasSubscribers() to skip building payloads nobody will receive.
+ */
+class EventBus {
+public:
+    using Frame = std::shared_ptr<const std::string>;
+
+    class Subscription {
+    public:
+        enum class PopResult {
+            FRAME,      // `frame` holds the next frame
+            PARKED,     // Queue empty; `park` ran and the wake hook will fire
+            CLOSED      // Closed and drained
+        };
+
+        explicit Subscription(std::vector<std::string> topics);
+
+        bool matches(const std::string& topic) const;
+
+        // Next frame, waiting up to `timeout`. Returns false on timeout or
+        // once the subscription is closed and drained.
+        bool pop(Frame& frame, std::chrono::milliseconds timeout);
+
+        // Next frame without waiting. When the queue is empty, `park` runs
+        // under the queue lock and the wake hook fires on the next push or
+        // close, so no frame can slip in between the check and parking.
+        PopResult popOrPark(Frame& frame, const std::function<void()>& park);
+
+        // Called under the queue lock when a parked subscription gets a frame
+        void setWakeHook(std::function<void()> hook);
+
+        void push(const Frame& frame);
+        void close();
+        bool isClosed() const;
+        uint64_t droppedFrames() const;
+
+    private:
+        static constexpr size_t MAX_QUEUED_FRAMES = 256;
+
+        void wakeLocked();
+
+        const std::vector<std::string> topics_;
+        mutable std::mutex mutex_;
+        std::condition_variable cv_;
+        std::deque<Frame> queue_;
+        std::function<void()> wake_hook_;
+        bool parked_ = false;
+        bool closed_ = false;
+        uint64_t dropped_ = 0;
+    };
+
+    static EventBus& getInstance();
+
+    void publish(const std::string& topic, const std::string& data);
+    void publish(const std::string& topic, const nlohmann::json& data);
+
+    // True when at least one open subscription would receive `topic`
+    bool hasSubscribers(const std::string& topic) const;
+    size_t subscriberCount() const;
+
+    // Register a subscription for `topics` (empty for all) and queue the
+    // retained frame of every matching topic
+    std::shared_ptr<Subscription> subscribe(std::vector<std::string> topics);
+    void unsubscribe(const std::shared_ptr<Subscription>& subscription);
+
+    // Close every subscription and stop the keepalive thread
+    void shutdown();
+
+    // Interval of the comment frame sent to every subscriber to keep streams alive
+    static constexpr std::chrono::seconds KEEPALIVE_INTERVAL{15};
+
+private:
+    EventBus() = default;
+    ~EventBus();
+    EventBus(const EventBus&) = delete;
+    EventBus& operator=(const EventBus&) = delete;
+
+    static bool topicMatches(const std::string& filter, const std::string& topic);
+    void startKeepaliveLocked();
+    void keepaliveLoop();
+
+    mutable std::mutex mutex_;
+    std::vector<std::shared_ptr<Subscription>> subscriptions_;
+    std::map<std::string, std::pair<uint64_t, Frame>> retained_;   // topic -> (event id, frame)
+    uint64_t next_id_ = 0;
+    std::atomic<size_t> subscriber_count_{0};
+
+    std::thread keepalive_thread_;
+    std::condition_variable keepalive_cv_;
+    bool stopping_ = false;
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <microhttpd.h>
+
+/**
+ * Server-Sent Events endpoint: GET /api/events/stream?topics=a,b
+ *
+ * Each request becomes an EventBus subscription streamed back through
+ * MHD_create_response_from_callback with an unknown length (chunked). With
+ * a thread per connection the content reader simply blocks until the next
+ * frame. In the polling modes a reader that runs dry suspends its
+ * connection and the next publish resumes it, so idle streams cost neither
+ * a thread nor a wakeup; the daemon must then be started with
+ * MHD_ALLOW_SUSPEND_RESUME.
+ */
+class EventStream {
+public:
+    static constexpr const char* PATH = "/api/events/stream";
+
+    // Open streams beyond this are refused with 503
+    static constexpr size_t MAX_STREAMS = 32;
+
+    static enum MHD_Result handleRequest(struct MHD_Connection* connection, const std::string& method,
+                                         bool suspend_when_idle);
+
+    // Close every stream and wait up to `timeout` for their connections to
+    // finish, so the daemon can stop. New streams are refused until reopen().
+    // The EventBus itself keeps running.
+    static void closeAll(std::chrono::milliseconds timeout = std::chrono::seconds(5));
+    static void reopen();
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <functional>
+#include <cstdint>
+#include <microhttpd.h>
+
+/**
+ * Zero-copy response construction shared by FileServer and the backup
+ * download route. Large files are handed to libmicrohttpd as descriptors so
+ * the kernel can sendfile() them; cached assets are sent straight from their
+ * immutable cache buffers. Both honour single-range "Range: bytes=" requests.
+ */
+class FileResponse {
+public:
+    struct ByteRange {
+        uint64_t offset = 0;
+        uint64_t length = 0;
+    };
+
+    enum class RangeStatus {
+        FULL,           // No (usable) Range header: send everything with 200
+        PARTIAL,        // Send `range` with 206
+        UNSATISFIABLE   // Range starts past the end: 416
+    };
+
+    // Resolve the request's Range header against a body of `size` bytes. Only
+    // a single "bytes=" range is honoured; multiple ranges, other units,
+    // malformed values or an If-Range that does not match `etag` all fall
+    // back to the full body.
+    static RangeStatus resolveRange(struct MHD_Connection* connection, uint64_t size,
+                                    const std::string& etag, ByteRange& range);
+
+    // Response over [offset, offset + length) of an open descriptor. Takes
+    // ownership of fd, also when creation fails.
+    static struct MHD_Response* fromFd(int fd, const ByteRange& range);
+
+    // Response over an immutable buffer; `owner` keeps it alive until
+    // libmicrohttpd has finished sending
+    static struct MHD_Response* fromSharedBuffer(std::shared_ptr<const void> owner,
+                                                 const char* data, size_t size);
+
+    // Add Accept-Ranges (and Content-Range when partial/unsatisfiable);
+    // returns the status code to queue with
+    static unsigned int addRangeHeaders(struct MHD_Response* response, RangeStatus status,
+                                        const ByteRange& range, uint64_t size);
+
+    // Queue an open regular file of `size` bytes with Range support. Takes
+    // ownership of fd. add_headers runs before queueing for caller-specific
+    // headers (caching, Content-Disposition, ...).
+    static enum MHD_Result queueFile(struct MHD_Connection* connection, int fd, uint64_t size,
+                                     const std::string& content_type, const std::string& etag,
+                                     const std::function<void(struct MHD_Response*)>& add_headers);
+};
@@ -2,10 +2,13 @@
 #define FILE_SERVER_H
 
 #include <string>
+#include <map>
 #include <unordered_map>
 #include <chrono>
 #include <mutex>
 #include <memory>
+#include <ctime>
+#include <sys/stat.h>
 #include <microhttpd.h>
 
 // Page transaction state for hot swap and session handling
@@ -25,7 +28,11 @@ struct PageTransaction {
 // File cache entry for hot swap capability
 struct CacheEntry {
     std::string content;
-    std::string etag;
+    std::string etag;                   // Strong validator from inode, size and mtime
+    std::string gzip_content;           // Precompressed variant, empty when not worthwhile
+    std::string gzip_etag;              // Distinct validator for the gzip variant
+    std::string last_modified_header;   // File mtime as an HTTP-date
+    std::time_t mtime;
     std::chrono::steady_clock::time_point last_modified;
     std::chrono::steady_clock::time_point cache_time;
     size_t file_size;
@@ -34,6 +41,7 @@ struct CacheEntry {
         auto now = std::chrono::steady_clock::now();
         last_modified = now;
         cache_time = now;
+        mtime = 0;
         file_size = 0;
     }
 };
@@ -63,6 +71,11 @@ public:
     void clearCache();
     void refreshFile(const std::string& path);
     
+    // Cache-Control value per URL path prefix; the longest matching prefix wins.
+    // Fingerprinted assets (e.g. app.3f9a1c2b.js) are sent as immutable when enabled.
+    void setCacheControlRules(const std::map<std::string, std::string>& rules) { cache_control_rules_ = rules; }
+    void setImmutableFingerprintedAssets(bool enable) { immutable_fingerprinted_ = enable; }
+    
     // Transaction management
     std::string createPageTransaction(const std::string& session_token,
                                     const std::string& user_id,
@@ -85,6 +98,10 @@ private:
     std::unordered_map<std::string, std::shared_ptr<CacheEntry>> file_cache_;
     mutable std::mutex cache_mutex_;
     
+    // HTTP caching policy
+    std::map<std::string, std::string> cache_control_rules_;
+    bool immutable_fingerprinted_;
+    
     // Transaction management
     std::unordered_map<std::string, std::shared_ptr<PageTransaction>> active_transactions_;
     mutable std::mutex transaction_mutex_;
@@ -93,10 +110,22 @@ private:
     bool fileExists(const std::string& path);
     bool isDirectory(const std::string& path);
     std::string readFile(const std::string& path);
-    std::shared_ptr<CacheEntry> readFileWithCache(const std::string& path);
+    std::shared_ptr<CacheEntry> readFileWithCache(const std::string& path, const struct stat& file_stat);
     std::string getMimeType(const std::string& file_path);
     std::string sanitizePath(const std::string& path);
-    std::string generateETag(const std::string& path, const std::string& content);
+    std::string generateETag(const struct stat& file_stat);
+    
+    // Conditional request handling
+    std::string getCacheControl(const std::string& request_path) const;
+    static bool isFingerprinted(const std::string& path);
+    static bool isNotModified(struct MHD_Connection* connection, const std::string& etag, std::time_t mtime);
+    void precompress(CacheEntry& entry, const std::string& path);
+    
+    // Files at least this large bypass the cache and are sent from their descriptor
+    static constexpr uint64_t LARGE_FILE_SIZE = 1024 * 1024;
+    static bool etagListMatches(const std::string& header, const std::string& etag);
+    static std::string formatHttpDate(std::time_t time);
+    static bool parseHttpDate(const std::string& value, std::time_t& time);
     
     // Enhanced page processing for transactions
     std::string processPageForTransaction(const std::string& content, 
@@ -106,7 +135,16 @@ private:
     // Response helpers
     enum MHD_Result sendFileResponse(struct MHD_Connection* connection, 
                         const std::string& file_path,
-                        const std::string& content);
+                        const std::shared_ptr<CacheEntry>& entry,
+                        const std::string& cache_control,
+                        bool use_gzip);
+    enum MHD_Result sendNotModified(struct MHD_Connection* connection,
+                                    const CacheEntry& entry,
+                                    const std::string& cache_control,
+                                    bool use_gzip);
+    enum MHD_Result sendLargeFile(struct MHD_Connection* connection,
+                                  const std::string& file_path,
+                                  const std::string& cache_control);
     
     enum MHD_Result sendDirectoryListing(struct MHD_Connection* connection, 
                            const std::string& directory_path);
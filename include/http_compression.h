@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+/**
+ * gzip content coding for HTTP responses (zlib).
+ *
+ * Static assets are compressed once when they enter the FileServer cache;
+ * API responses above a size threshold are compressed per request. Both
+ * only do so when the client's Accept-Encoding allows gzip.
+ */
+class HttpCompression {
+public:
+    // Bodies smaller than this are never worth compressing
+    static constexpr size_t MIN_COMPRESS_SIZE = 1024;
+
+    // Per-request compression costs CPU on every response, so API bodies
+    // must be larger before it pays off over the link
+    static constexpr size_t DYNAMIC_COMPRESS_SIZE = 4096;
+    static constexpr int DYNAMIC_COMPRESS_LEVEL = 6;
+
+    // gzip-encode data; returns an empty string on failure
+    static std::string gzip(std::string_view data, int level);
+
+    // True when the Accept-Encoding header value permits gzip (honours q=0 and "*")
+    static bool acceptsGzip(const char* accept_encoding);
+
+    // Text-like MIME types that compress well; images, archives and fonts do not
+    static bool isCompressibleType(std::string_view content_type);
+};
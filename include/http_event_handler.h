@@ -64,6 +64,12 @@ public:
     void registerEventHandler(const std::string& event_type,
                              std::function<EventResponse(const EventData&)> handler);
     
+    // Validate a .uacc file streamed to disk by the /api/file-auth upload
+    // sink and issue a session for it. upload_path must be the path the sink
+    // wrote; it is removed when validation fails. Deliberately not an event
+    // type, so clients cannot point it at other files.
+    EventResponse authenticateUploadedFile(const std::string& filename, const std::string& upload_path);
+
     // Get credential manager for external use
     std::shared_ptr<CredentialManager> getCredentialManager() const;
 
@@ -4,9 +4,30 @@
 #include <string>
 #include <map>
 #include <functional>
+#include <memory>
 #include <microhttpd.h>
 #include "api_request.h"
 #include "dynamic_router.h"
+#include "request_body_sink.h"
+
+/**
+ * Per-connection request state stored in MHD's con_cls. Allocated by
+ * WebServer on the first access-handler call and released in the
+ * request-completed callback.
+ */
+struct ConnectionState {
+    std::string body;                           // Buffered body for non-streaming routes
+    std::unique_ptr<RequestBodySink> sink;      // Active sink for streaming routes
+    bool sink_finished = false;
+    bool streaming_declined = false;            // Factory returned no sink; use the buffered handler
+
+    ~ConnectionState() {
+        // Let the sink discard partial output when the request never completed
+        if (sink && !sink_finished) {
+            sink->abort();
+        }
+    }
+};
 
 class HttpHandler {
 public:
@@ -28,6 +49,12 @@ public:
                                                   const std::map<std::string, std::string>& params,
                                                   const std::string& body)> handler);
     
+    // Streaming route handlers (body delivered chunk by chunk to a RequestBodySink)
+    void addStreamingRouteHandler(const std::string& path, StreamingRouteFactory factory);
+    
+    // Download route handlers (GET/HEAD answered with the file the resolver names)
+    void addDownloadRouteHandler(const std::string& pattern, DownloadRouteResolver resolver);
+    
     // Dynamic route handlers (for pattern-based routing)
     void addDynamicRoute(const std::string& pattern,
                         std::function<std::string(const std::string& method, 
@@ -35,15 +62,8 @@ public:
                                                   const std::string& body)> handler);
 
 private:
-    // New structured route processors
-    std::map<std::string, RouteProcessor> structured_route_processors_;
-    
-    // Legacy route handlers
-    std::map<std::string, std::function<std::string(const std::string&, 
-                                                   const std::map<std::string, std::string>&,
-                                                   const std::string&)>> route_handlers_;
-    
-    // Dynamic router for pattern-based routing
+    // Single trie holding structured, dynamic and legacy routes so every
+    // request is resolved with one O(path length) lookup
     std::unique_ptr<DynamicRouter> dynamic_router_;
 
     // Request processing (structured approach)
@@ -52,6 +72,21 @@ private:
                               size_t* upload_data_size, void** con_cls);
     enum MHD_Result sendApiResponse(struct MHD_Connection* connection, const ApiResponse& response);
     
+    // Zero-copy file download for download routes
+    enum MHD_Result sendFileDownload(struct MHD_Connection* connection, const std::string& file_path);
+    
+    // Send a string handler's serialized output without re-parsing it
+    enum MHD_Result sendHandlerOutput(struct MHD_Connection* connection, const std::string& url,
+                                      std::string output);
+    
+    // Streaming request processing
+    std::unique_ptr<RequestBodySink> openStreamingSink(struct MHD_Connection* connection, const RouteMatch& route_match,
+                                                       const char* url, const char* method);
+    enum MHD_Result handleStreamingRequest(struct MHD_Connection* connection, const RouteMatch& route_match,
+                                          const char* url, const char* method,
+                                          const char* upload_data, size_t* upload_data_size,
+                                          ConnectionState* state);
+    
     // Legacy request processing
     std::map<std::string, std::string> parseQueryString(const std::string& query);
     std::map<std::string, std::string> parseHeaders(struct MHD_Connection* connection);
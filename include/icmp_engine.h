@@ -0,0 +1,148 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <time.h>
+
+/**
+ * In-process ICMP echo ("ping") shared by the ping utility, the iperf3
+ * server checks and the source page.
+ *
+ * Probes go out on unprivileged datagram ICMP sockets (SOCK_DGRAM with
+ * IPPROTO_ICMP / IPPROTO_ICMPV6, allowed by net.ipv4.ping_group_range) or,
+ * failing that, raw sockets when the process is privileged. Every session
+ * shares one socket per family: replies are matched to their probe by a
+ * 16-bit sequence number allocated engine-wide, so any number of targets
+ * are pinged concurrently from one reactor thread. Round-trip times use the
+ * kernel receive timestamp (SO_TIMESTAMPNS) rather than the time the
+ * reactor got around to reading the reply; ICMP errors (unreachable, TTL
+ * exceeded) arrive on the socket error queue.
+ *
+ * on_echo and on_done run on the reactor thread: they must not block and
+ * must not call run().
+ */
+class IcmpEngine {
+public:
+    struct Echo {
+        int sequence = 0;           // 1-based within the session
+        bool success = false;
+        double rtt_ms = 0.0;
+        int ttl = 0;                // Of the reply; 0 when not reported
+        int bytes = 0;              // ICMP header and payload
+        std::string from;           // Replying address (a router for errors)
+        std::string error;          // "Request timeout", "Destination Host Unreachable", ...
+    };
+
+    struct Result {
+        int sent = 0;
+        int received = 0;
+        bool cancelled = false;
+        std::string error;          // Why the session could not run
+        std::vector<Echo> echoes;   // Filled by run() only
+    };
+
+    struct Options {
+        sockaddr_storage address{};
+        socklen_t address_length = 0;
+        int count = 1;                              // 0 to continue until stop()
+        std::chrono::milliseconds interval{1000};
+        std::chrono::milliseconds timeout{5000};    // Per probe
+        int payload_size = 56;
+        int ttl = 64;
+        bool dont_fragment = false;
+        std::function<void(const Echo& echo)> on_echo;  // Once per probe: reply, error or timeout
+        std::function<void(const Result& result)> on_done;
+    };
+
+    static constexpr int MAX_PAYLOAD = 65507;
+
+    static IcmpEngine& getInstance();
+
+    // Whether ICMP sockets of this family (AF_INET, AF_INET6) can be opened
+    bool available(int family);
+
+    // Start a session. Returns 0 (and calls on_done with the error) when it
+    // could not be started, otherwise an id for stop().
+    uint64_t start(Options options);
+
+    // Stop sending; outstanding probes are abandoned and on_done reports
+    // the session cancelled. False when it already finished.
+    bool stop(uint64_t id);
+
+    // Probe and wait; echoes are collected into the result
+    Result run(const sockaddr_storage& address, socklen_t address_length, int count,
+               std::chrono::milliseconds interval, std::chrono::milliseconds timeout);
+
+    static std::string formatAddress(const sockaddr* address);
+
+    size_t activeCount() const;
+
+    // Stop every session and the reactor
+    void shutdown();
+
+private:
+    struct Socket {
+        int fd = -1;
+        int family = 0;
+        bool raw = false;           // Raw sockets carry the IPv4 header and see every reply
+    };
+    struct Session;
+    struct Probe {
+        uint64_t session = 0;
+        int sequence = 0;
+        timespec sent{};                                // CLOCK_REALTIME, like SO_TIMESTAMPNS
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    IcmpEngine();
+    ~IcmpEngine();
+    IcmpEngine(const IcmpEngine&) = delete;
+    IcmpEngine& operator=(const IcmpEngine&) = delete;
+
+    static size_t socketIndex(int family, bool dont_fragment);
+    bool openSocket(size_t index, std::string& error);
+
+    void wake();
+    void reactorLoop();
+    void adoptPending();
+    void sendProbe(Session& session);
+    void receive(const Socket& socket);
+    void receiveErrors(const Socket& socket);
+    void complete(const Probe& probe, const Echo& echo);
+    void checkDeadlines();
+    void finish(uint64_t id);
+    int nextTimeoutMs() const;
+
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    uint16_t ident_ = 0;            // Echo identifier on raw sockets
+
+    mutable std::mutex mutex_;
+    std::array<Socket, 4> sockets_;                 // {IPv4, IPv6} x {default, don't fragment}
+    std::vector<std::unique_ptr<Session>> pending_;
+    std::vector<uint64_t> stop_requests_;
+    std::set<uint64_t> live_;                       // Started and not yet finished
+    uint64_t next_id_ = 0;
+
+    // Reactor thread only
+    std::map<uint64_t, std::unique_ptr<Session>> sessions_;
+    std::map<uint16_t, Probe> in_flight_;           // By wire sequence number
+    uint16_t next_wire_sequence_ = 0;
+    std::array<int, 4> socket_ttl_{{-1, -1, -1, -1}};   // TTL last set on each socket
+    std::vector<uint8_t> send_buffer_;
+    std::vector<uint8_t> receive_buffer_;
+
+    std::thread thread_;
+    std::atomic<bool> stopping_{false};
+};
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/types.h>
+#include <nlohmann/json.hpp>
+
+/**
+ * In-memory store for the JSON files under data/ that the handlers and data
+ * managers read on every request.
+ *
+ * A file is parsed once, on first use; after that reads are served from an
+ * immutable snapshot that a write replaces (readers only take a shared lock
+ * long enough to copy the pointer). Elements of an array can be looked up
+ * by id through a hash index built lazily per snapshot.
+ *
+ * Writes are write-behind: the new document is visible at once and reaches
+ * the disk from the store thread after WRITE_DELAY, so a burst of writes to
+ * one file costs one write. Files are replaced through the WriteJournal,
+ * so each flush costs one fsync however many files it writes. Directories holding documents are watched with inotify,
+ * and a file changed by someone else is re-read, unless a write of ours is
+ * still pending, in which case ours wins.
+ */
+class JsonDocumentStore {
+public:
+    static constexpr std::chrono::milliseconds WRITE_DELAY{100};
+
+    static JsonDocumentStore& getInstance();
+
+    // The document; null when the file does not exist or does not parse
+    std::shared_ptr<const nlohmann::json> snapshot(const std::string& path);
+
+    // Copy of the document. False (and document untouched) when the file
+    // does not exist or does not parse.
+    bool read(const std::string& path, nlohmann::json& document);
+
+    // Copy of the element of the array document[array_key] whose id_key
+    // member is the string id; false when there is none
+    bool find(const std::string& path, const std::string& array_key, const std::string& id,
+              nlohmann::json& element, const std::string& id_key = "id");
+
+    // Replace the document. False when its directory does not exist;
+    // otherwise readers see it at once and the file is written shortly.
+    bool write(const std::string& path, nlohmann::json document, int indent = 2);
+
+    // Write every pending document now. False when any write failed.
+    bool flush();
+
+    size_t documentCount() const;
+
+    // Flush and stop the store thread; later writes go straight to disk
+    void shutdown();
+
+private:
+    struct Version {
+        explicit Version(nlohmann::json value) : document(std::move(value)) {}
+        nlohmann::json document;
+        mutable std::mutex index_mutex;
+        // "array_key\nid_key" -> id -> position in the array
+        mutable std::unordered_map<std::string, std::unordered_map<std::string, size_t>> indexes;
+    };
+    struct FileStamp {
+        ino_t inode = 0;
+        off_t size = -1;
+        int64_t mtime_ns = 0;
+        bool operator==(const FileStamp& other) const {
+            return inode == other.inode && size == other.size && mtime_ns == other.mtime_ns;
+        }
+    };
+    struct Document {
+        std::string path;
+        mutable std::shared_mutex lock;             // Guards loaded and current
+        bool loaded = false;
+        std::shared_ptr<const Version> current;     // Null when there is no valid file
+
+        // Guarded by the store's state_mutex_
+        bool dirty = false;
+        int indent = 2;
+        std::chrono::steady_clock::time_point due;
+        FileStamp stamp;                            // The file as last read or written by us
+    };
+
+    JsonDocumentStore();
+    ~JsonDocumentStore();
+    JsonDocumentStore(const JsonDocumentStore&) = delete;
+    JsonDocumentStore& operator=(const JsonDocumentStore&) = delete;
+
+    static std::string normalize(const std::string& path);
+    static bool stampFile(const std::string& path, FileStamp& stamp);
+    static std::shared_ptr<const Version> parseFile(const std::string& path);
+
+    std::shared_ptr<Document> document(const std::string& path);
+    std::shared_ptr<const Version> current(Document& document);
+    void watchDirectory(const std::string& path);
+    bool persist(const std::vector<std::shared_ptr<Document>>& documents);
+    bool flushDue(bool all);
+    void reloadIfChanged(Document& document);
+
+    void wake();
+    void storeLoop();
+    void handleWatchEvents();
+    int nextTimeoutMs() const;
+
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    int inotify_fd_ = -1;
+
+    mutable std::shared_mutex documents_mutex_;
+    std::unordered_map<std::string, std::shared_ptr<Document>> documents_;
+
+    mutable std::mutex state_mutex_;                // Write-behind state and watches
+    std::map<int, std::string> watches_;            // inotify descriptor -> directory
+    std::map<std::string, int> watched_;            // Directory -> inotify descriptor
+
+    std::mutex persist_mutex_;                      // One writer to the disk at a time
+
+    std::thread thread_;
+    std::atomic<bool> stopping_{false};
+};
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+
+/**
+ * In-process view of the kernel's interface, address and route tables.
+ *
+ * One NETLINK_ROUTE socket is subscribed to link, address and route
+ * multicast groups; the tables are dumped once at construction and then
+ * kept current from RTM_NEW and RTM_DEL events on a background thread. Link
+ * counters do not generate events, so links are re-dumped every
+ * STATS_REFRESH_INTERVAL. Each change publishes a new immutable Table;
+ * readers take the current one with snapshot() and never fork or block.
+ */
+class NetlinkStateEngine {
+public:
+    struct LinkCounters {
+        uint64_t rx_bytes = 0;
+        uint64_t tx_bytes = 0;
+        uint64_t rx_packets = 0;
+        uint64_t tx_packets = 0;
+        uint64_t rx_errors = 0;
+        uint64_t tx_errors = 0;
+        uint64_t rx_dropped = 0;
+        uint64_t tx_dropped = 0;
+    };
+
+    struct Link {
+        int index = 0;
+        std::string name;
+        std::string mac_address;
+        std::string kind;            // IFLA_INFO_KIND ("bridge", "vlan", ...), empty for physical links
+        uint16_t type = 0;           // ARPHRD_*
+        uint32_t flags = 0;          // IFF_*
+        uint8_t operstate = 0;       // IF_OPER_*
+        uint32_t mtu = 0;
+        bool is_wireless = false;
+        int speed_mbps = -1;         // -1 when unknown or no carrier
+        std::string duplex;          // "full", "half" or empty
+        LinkCounters counters;
+        // When this engine saw the link come up (process start for links
+        // already up at the initial dump)
+        std::chrono::steady_clock::time_point up_since;
+
+        bool isUp() const;
+        bool hasCarrier() const;
+        bool isLoopback() const;
+    };
+
+    struct Address {
+        int ifindex = 0;
+        int family = AF_UNSPEC;
+        std::string address;
+        uint8_t prefix_len = 0;
+        uint8_t scope = 0;           // RT_SCOPE_*
+        uint32_t flags = 0;          // IFA_F_*
+        bool dynamic = false;        // Finite valid lifetime (DHCP/SLAAC)
+    };
+
+    struct Route {
+        int family = AF_UNSPEC;
+        std::string destination;     // Empty for the default route
+        uint8_t dst_len = 0;
+        std::string gateway;
+        int oif = 0;
+        uint32_t priority = 0;
+        uint8_t protocol = 0;        // RTPROT_*
+    };
+
+    struct Table {
+        std::map<int, Link> links;
+        std::vector<Address> addresses;
+        std::vector<Route> routes;   // Main table unicast routes only
+        uint64_t generation = 0;
+        std::chrono::steady_clock::time_point updated_at;
+
+        const Link* findLink(int index) const;
+        const Link* findLink(const std::string& name) const;
+        // Lowest-metric default route, nullptr when there is none
+        const Route* defaultRoute(int family = AF_INET) const;
+        std::vector<const Address*> addressesOf(int index, int family = AF_UNSPEC) const;
+        // First global-scope address of a link, nullptr when there is none
+        const Address* primaryAddress(int index, int family = AF_INET) const;
+        // Link carrying the default route when it is wired, else the first
+        // physical Ethernet link (preferring one with carrier)
+        const Link* wiredLink() const;
+    };
+
+    static NetlinkStateEngine& getInstance();
+
+    // Start following kernel events; the initial dump already happened
+    bool start();
+    void stop();
+    bool isRunning() const { return running_.load(std::memory_order_acquire); }
+
+    // Latest published table, never null (empty if netlink is unavailable)
+    std::shared_ptr<const Table> snapshot() const {
+        return current_.load(std::memory_order_acquire);
+    }
+
+private:
+    static constexpr std::chrono::seconds STATS_REFRESH_INTERVAL{5};
+
+    NetlinkStateEngine();
+    ~NetlinkStateEngine();
+    NetlinkStateEngine(const NetlinkStateEngine&) = delete;
+    NetlinkStateEngine& operator=(const NetlinkStateEngine&) = delete;
+
+    bool openSockets();
+    bool resync();
+    bool dump(uint16_t type, Table& table);
+    void drainEvents();
+    void applyMessage(Table& table, const struct nlmsghdr* header);
+    void applyLink(Table& table, const struct nlmsghdr* header);
+    void applyAddress(Table& table, const struct nlmsghdr* header);
+    void applyRoute(Table& table, const struct nlmsghdr* header);
+    void publish();
+    void run();
+
+    int listen_fd_ = -1;    // Multicast events
+    int dump_fd_ = -1;      // Request/response dumps
+    int wake_fd_ = -1;      // eventfd used to stop the thread
+    uint32_t dump_seq_ = 0;
+
+    // Owned by whichever thread applies updates (constructor, then run())
+    Table table_;
+    bool initial_dump_ = true;
+
+    std::atomic<std::shared_ptr<const Table>> current_;
+
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    std::mutex lifecycle_mutex_;
+};
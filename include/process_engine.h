@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/types.h>
+
+/**
+ * Shared handle for cancelling one or more running processes. Copies refer
+ * to the same state; cancel() may be called from any thread.
+ */
+class CancellationToken {
+public:
+    CancellationToken();
+
+    void cancel() const;
+    bool isCancelled() const;
+
+private:
+    std::shared_ptr<std::atomic<bool>> cancelled_;
+};
+
+/**
+ * Subprocess execution shared by the utility engines, the routers and the
+ * sysupgrade manager.
+ *
+ * Processes are started with posix_spawnp() straight from an argument
+ * vector (no /bin/sh), in their own process group, with stdin on /dev/null
+ * and stdout (optionally merged with stderr) on a non-blocking pipe. One
+ * reactor thread multiplexes every pipe and pidfd on epoll, splits output
+ * into lines in a per-process buffer and enforces deadlines: a process past
+ * its timeout gets SIGKILL, a cancelled one SIGTERM and then SIGKILL after
+ * CANCEL_GRACE. Running many diagnostics at once therefore costs this one
+ * thread rather than one per test.
+ *
+ * on_line and on_exit run on the reactor thread: they must not block and
+ * must not call run().
+ */
+class ProcessEngine {
+public:
+    struct Result {
+        int exit_code = -1;         // Exit status, 128 + signal when killed, -1 when never started
+        bool timed_out = false;
+        bool cancelled = false;
+        std::string error;          // Why the process could not be started
+        std::string output;         // Captured output (Options::capture_output)
+        std::chrono::milliseconds elapsed{0};
+
+        bool succeeded() const { return exit_code == 0 && !timed_out && !cancelled; }
+    };
+
+    struct Options {
+        std::vector<std::string> argv;          // argv[0] is looked up on PATH
+        std::chrono::milliseconds timeout{0};   // Hard limit, 0 for none
+        bool merge_stderr = true;               // Otherwise stderr goes to /dev/null
+        bool capture_output = false;            // Collect the whole output into Result::output
+        size_t max_output = 4 * 1024 * 1024;    // Capture limit; the rest is discarded
+        CancellationToken cancel;
+        std::function<void(const std::string& line)> on_line;   // Without the trailing newline
+        std::function<void(const Result& result)> on_exit;
+    };
+
+    static constexpr std::chrono::seconds CANCEL_GRACE{2};
+
+    static ProcessEngine& getInstance();
+
+    // Start a process. Returns false (and calls on_exit with the error) when
+    // it could not be spawned.
+    bool spawn(Options options);
+
+    // Start a process and wait for it; output is captured
+    Result run(std::vector<std::string> argv, std::chrono::milliseconds timeout,
+               const CancellationToken& cancel = CancellationToken(), bool merge_stderr = true);
+
+    size_t runningCount() const;
+
+    // Kill everything still running and stop the reactor
+    void shutdown();
+
+private:
+    friend class CancellationToken;   // cancel() wakes the reactor
+    struct Process;
+
+    ProcessEngine();
+    ~ProcessEngine();
+    ProcessEngine(const ProcessEngine&) = delete;
+    ProcessEngine& operator=(const ProcessEngine&) = delete;
+
+    void wake();
+    void reactorLoop();
+    void adoptPending();
+    void readOutput(Process& process);
+    void emitLine(Process& process, const char* data, size_t length);
+    void signalGroup(Process& process, int signal);
+    bool reap(Process& process, bool block);
+    void finish(uint64_t id);
+    void checkDeadlines();
+    int nextTimeoutMs() const;
+
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Process>> pending_;     // Spawned, not yet registered with epoll
+    bool closed_ = false;                               // Reactor gone: pending_ is never adopted again
+    std::atomic<size_t> running_{0};
+    uint64_t next_id_ = 0;
+
+    // Reactor thread only
+    std::map<uint64_t, std::unique_ptr<Process>> processes_;
+    std::vector<char> read_buffer_;
+
+    std::thread thread_;
+    std::atomic<bool> stopping_{false};
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <functional>
+#include "api_request.h"
+
+/**
+ * Incremental consumer for a request body.
+ *
+ * Streaming routes register a factory instead of a string handler. The
+ * factory runs once the request headers are known; the returned sink then
+ * receives every upload chunk exactly as libmicrohttpd delivers it, so the
+ * body never has to be held in memory.
+ */
+class RequestBodySink {
+public:
+    virtual ~RequestBodySink() = default;
+
+    // Consume the next body chunk. Returning false aborts the request and
+    // sends errorResponse() to the client.
+    virtual bool consume(const char* data, size_t size) = 0;
+
+    // Called once after the last chunk; produces the response to send.
+    virtual ApiResponse finish() = 0;
+
+    // Called when the request ends without finish() (client abort, error,
+    // server shutdown) so partially written state can be discarded.
+    virtual void abort() {}
+
+    // Response sent when consume() fails
+    virtual ApiResponse errorResponse() const {
+        ApiResponse response;
+        response.setErrorResponse("Request body rejected", 400);
+        return response;
+    }
+};
+
+/**
+ * Creates a sink for a request. The ApiRequest carries method, route, query
+ * params and headers but no body. Returning nullptr hands the request to the
+ * buffered handler registered on the same path, or rejects it with 400 when
+ * there is none.
+ */
+using StreamingRouteFactory = std::function<std::unique_ptr<RequestBodySink>(const ApiRequest&)>;
@@ -1,13 +1,20 @@
 #pragma once
 
 #include "api_request.h"
+#include "netlink_state_engine.h"
 #include <string>
 #include <memory>
 
 /**
  * Data structures for system information
+ *
+ * Hardware figures that cannot be read are reported as -1 (numbers) or
+ * left empty (strings), never estimated. Temperatures can be negative, so
+ * an unknown one is TEMPERATURE_UNKNOWN and goes out as null.
  */
 struct SystemInfo {
+    static constexpr int TEMPERATURE_UNKNOWN = -274;    // Below absolute zero: never a reading
+
     // CPU Information
     int cpu_usage_percent = 0;
     int cpu_cores = 0;
@@ -114,6 +121,10 @@ public:
     // Enable/disable auto-refresh
     void setAutoRefresh(bool enabled, int interval_seconds = 30);
     
+    // Interface, address and gateway fields from the netlink tables
+    // (memory reads only, cheap enough for every request)
+    static void fillLinkInfo(NetworkInfo& info);
+    
 private:
     SystemStatusData cached_data_;
     bool auto_refresh_enabled_ = false;
@@ -121,15 +132,15 @@ private:
     std::string last_refresh_time_;
     
     // Helper methods for data collection
-    int getCpuUsagePercent();
-    float getMemoryUsage();
-    bool checkInternetConnectivity();
+    // One echo to 8.8.8.8; latency_ms is its round trip when it answered
+    bool checkInternetConnectivity(int& latency_ms);
     std::string getCurrentTimestamp();
     
     // Network interface helpers
-    std::string getLocalIpAddress();
-    std::string getMacAddress();
-    std::string getGatewayIp();
+    static std::string getLocalIpAddress(const NetlinkStateEngine::Table& table,
+                                         const NetlinkStateEngine::Link* link);
+    static std::string getMacAddress(const NetlinkStateEngine::Link* link);
+    static std::string getGatewayIp(const NetlinkStateEngine::Route* route);
     
     // System command helpers
     std::string executeSystemCommand(const std::string& command);
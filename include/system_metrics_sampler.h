@@ -0,0 +1,83 @@
+#pragma once
+
+#include "source-page-data.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/**
+ * Background sampler for CPU, memory and temperature metrics.
+ *
+ * /proc/stat, /proc/meminfo and the CPU thermal zone are opened once and
+ * re-read with pread() on every tick, so sampling never forks or reopens a
+ * file. CPU usage is the busy share of the jiffies elapsed since the previous
+ * tick. Each tick publishes a new immutable Snapshot; readers grab the
+ * current one with snapshot() and never wait for the sampler.
+ */
+class SystemMetricsSampler {
+public:
+    struct Snapshot {
+        SystemInfo system;
+        std::chrono::steady_clock::time_point sampled_at;
+        uint64_t sequence = 0;
+    };
+
+    static SystemMetricsSampler& getInstance();
+
+    // Start the sampler thread, or change its interval if already running
+    void start(std::chrono::milliseconds interval);
+    void stop();
+    bool isRunning() const { return running_.load(std::memory_order_acquire); }
+
+    // Ask for a sample ahead of schedule; does not wait for it
+    void requestSample();
+
+    // Latest published snapshot, never null
+    std::shared_ptr<const Snapshot> snapshot() const {
+        return current_.load(std::memory_order_acquire);
+    }
+
+private:
+    struct CpuTimes {
+        uint64_t busy = 0;
+        uint64_t total = 0;
+    };
+
+    SystemMetricsSampler();
+    ~SystemMetricsSampler();
+    SystemMetricsSampler(const SystemMetricsSampler&) = delete;
+    SystemMetricsSampler& operator=(const SystemMetricsSampler&) = delete;
+
+    void openSources();
+    void readStaticInfo();
+    void sampleOnce();
+    void run();
+
+    bool readCpuTimes(CpuTimes& times);
+    bool readMemory(SystemInfo& info);
+    bool readTemperature(int& celsius);
+
+    // Pre-opened sources, -1 when unavailable
+    int stat_fd_ = -1;
+    int meminfo_fd_ = -1;
+    int thermal_fd_ = -1;
+
+    // Owned by whichever thread samples (constructor, then the sampler thread)
+    SystemInfo static_info_;
+    CpuTimes previous_cpu_;
+    uint64_t sequence_ = 0;
+
+    std::atomic<std::shared_ptr<const Snapshot>> current_;
+
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    std::atomic<int64_t> interval_ms_{2000};
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    bool wake_requested_ = false;
+    std::mutex lifecycle_mutex_;
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+
+/**
+ * Native traceroute shared by the traceroute utility.
+ *
+ * Rather than walking one TTL at a time, a trace sends the probes for every
+ * TTL and query at once and matches the replies back to their probe, so a
+ * full trace takes about one timeout whatever the number of hops. Probes
+ * keep a constant flow identifier ("Paris" traceroute) so per-flow load
+ * balancers route them all alike:
+ *
+ *  - ICMP: echo requests on a datagram (or raw) ICMP socket; the sequence
+ *    number tells probes apart and the payload keeps the checksum constant.
+ *  - UDP and TCP with raw sockets (IPv4): fixed ports; the probe is encoded
+ *    in the UDP checksum or the TCP sequence number.
+ *  - UDP without raw sockets: one datagram socket whose TTL is set before
+ *    each send; the destination port goes up by one per probe, as with
+ *    traceroute(8), which costs the constant flow identifier.
+ *
+ * Routers' Time Exceeded and Unreachable messages arrive on the socket error
+ * queue with the quoted probe header. Hop names are looked up on a small pool
+ * of resolver threads while the trace runs.
+ *
+ * on_hop and on_done run on the reactor thread and must not block.
+ */
+class TracerouteEngine {
+public:
+    enum class Protocol { ICMP, UDP, TCP };
+
+    struct Hop {
+        int number = 0;
+        std::string address;                // First responder; empty when nothing answered
+        std::string hostname;               // PTR name; empty when not resolved
+        std::vector<double> rtts;           // Answered probes, in milliseconds
+        std::vector<std::string> errors;    // traceroute-style annotations: "!H", "!N", "!X", ...
+        int lost = 0;                       // Probes that timed out
+        bool reached = false;               // The target itself answered
+    };
+
+    struct Result {
+        bool reached = false;
+        int hops = 0;                       // Hops reported through on_hop
+        bool cancelled = false;
+        std::string error;                  // Why the trace could not run
+    };
+
+    struct Options {
+        sockaddr_storage address{};
+        socklen_t address_length = 0;
+        Protocol protocol = Protocol::ICMP;
+        uint16_t port = 33434;              // UDP and TCP destination port; the first of a range for UDP without raw sockets
+        int max_hops = 30;
+        int queries = 3;
+        std::chrono::milliseconds timeout{5000};
+        bool dont_fragment = false;
+        bool resolve_names = true;
+        std::function<void(const Hop& hop)> on_hop;     // In hop order, once every probe of the hop is settled
+        std::function<void(const Result& result)> on_done;
+    };
+
+    static constexpr int MAX_HOPS = 64;
+    static constexpr int MAX_QUERIES = 10;
+    static constexpr size_t RESOLVER_THREADS = 4;
+
+    static TracerouteEngine& getInstance();
+
+    // Whether this process can trace with the protocol over the family
+    // (TCP needs raw IPv4 sockets)
+    static bool supports(Protocol protocol, int family);
+
+    // Start a trace. Returns 0 (and calls on_done with the error) when it
+    // could not be started, otherwise an id for stop().
+    uint64_t start(Options options);
+
+    // Abandon a trace; on_done reports it cancelled. False when it already
+    // finished.
+    bool stop(uint64_t id);
+
+    size_t activeCount() const;
+
+    // Stop every trace, the reactor and the resolver threads
+    void shutdown();
+
+private:
+    struct Trace;
+    struct Lookup {
+        uint64_t trace = 0;
+        int hop = 0;
+        sockaddr_storage address{};
+        std::string name;
+    };
+
+    TracerouteEngine();
+    ~TracerouteEngine();
+    TracerouteEngine(const TracerouteEngine&) = delete;
+    TracerouteEngine& operator=(const TracerouteEngine&) = delete;
+
+    bool openSocket(Trace& trace, std::string& error);
+    void wake();
+    void reactorLoop();
+    void resolverLoop();
+    void adoptPending();
+    void sendProbes(Trace& trace);
+    void receive(Trace& trace);
+    void receiveErrors(Trace& trace);
+    void settle(Trace& trace, size_t probe_index, const sockaddr_storage* from, const timespec* received,
+                const std::string& annotation, bool reached);
+    void checkDeadlines(Trace& trace);
+    void reportHops(Trace& trace);
+    void finish(uint64_t id);
+    int nextTimeoutMs() const;
+
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Trace>> pending_;
+    std::vector<uint64_t> stop_requests_;
+    std::vector<Lookup> resolved_;
+    std::set<uint64_t> live_;                       // Started and not yet finished
+    uint64_t next_id_ = 0;
+
+    // Resolver pool
+    std::mutex lookup_mutex_;
+    std::condition_variable lookup_cv_;
+    std::deque<Lookup> lookups_;
+    std::vector<std::thread> resolvers_;
+
+    // Reactor thread only
+    std::map<uint64_t, std::unique_ptr<Trace>> traces_;
+    std::vector<uint8_t> buffer_;
+
+    std::thread thread_;
+    std::atomic<bool> stopping_{false};
+};
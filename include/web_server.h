@@ -12,6 +12,8 @@
 #include <shared_mutex>
 #include <nlohmann/json.hpp>
 #include <microhttpd.h>
+#include "request_body_sink.h"
+#include "dynamic_router.h"
 
 class WebSocketHandler;
 class HttpHandler;
@@ -40,9 +42,26 @@ struct ServerConfig {
     std::string ssl_key_file;
     int max_connections = 1000;
     int connection_timeout = 30;
+
+    // HTTP daemon threading model:
+    //   "single"                - one internal polling thread (default, legacy behaviour)
+    //   "thread_per_connection" - one thread per client connection
+    //   "thread_pool"           - epoll (or poll) based pool of thread_pool_size workers
+    // The last two run route handlers concurrently; opt in only once the
+    // handlers in use are known to be thread-safe.
+    std::string threading_mode = "single";
+    int thread_pool_size = 4;
     bool enable_cors = true;
     std::vector<std::string> allowed_origins;
 
+    // Static file Cache-Control per URL path prefix (longest prefix wins).
+    // Fingerprinted assets (name.<hash>.ext) get a year-long immutable policy.
+    std::map<std::string, std::string> cache_control = {
+        {"/", "no-cache"},
+        {"/assets/", "public, max-age=300"}
+    };
+    bool immutable_fingerprinted_assets = true;
+
     // WebSocket debugging configuration
     bool websocket_debug_enabled = false;
     bool websocket_debug_connections = false;
@@ -97,6 +116,12 @@ public:
     using RouteProcessor = std::function<ApiResponse(const ApiRequest&)>;
     void addStructuredRouteHandler(const std::string& path, RouteProcessor processor);
 
+    // Streaming API route handlers (request body delivered chunk by chunk to a sink)
+    void addStreamingRouteHandler(const std::string& path, StreamingRouteFactory factory);
+
+    // Download route handlers (GET/HEAD answered with the file the resolver names)
+    void addDownloadRouteHandler(const std::string& pattern, DownloadRouteResolver resolver);
+
     // ======== NEW CALLBACK-BASED WEBSOCKET INTERFACE ========
 
     // Connection event callbacks
@@ -237,6 +262,7 @@ private:
                      size_t* upload_data_size, void** con_cls);
 
     // Internal helpers
+    unsigned int buildDaemonFlags() const;
     void setupDefaultWebSocketCallbacks();
     void addCallbackId(const std::string& callback_id);
     void removeCallbackId(const std::string& callback_id);
@@ -1,4 +1,5 @@
 #include "login_manager.hpp"
+#include "atomic_file.h"
 #include <fstream>
 #include <sstream>
 #include <random>
@@ -351,15 +352,9 @@ bool LoginManager::saveCredentials() {
         std::string json_string = credentials_json.dump(4);
         std::string encrypted_data = encryptData(json_string, encryption_key_);
         
-        std::ofstream file(credentials_file_path_, std::ios::binary);
-        if (!file.is_open()) {
-            return false;
-        }
-        
-        file << encrypted_data;
-        file.close();
-        
-        return true;
+        // Replaced atomically: a power cut must not leave an empty credentials file
+        std::string error;
+        return AtomicFile::write(credentials_file_path_, encrypted_data, error);
         
     } catch (const std::exception& e) {
         return false;
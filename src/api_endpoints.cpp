@@ -3,6 +3,7 @@
 #include "http_event_handler.h"
 #include "route_processors.h"
 #include "endpoint_logger.h"
+#include "multipart_upload_sink.h"
 #include "routers/VpnRouter.h"
 #include "routers/WirelessRouter.h"
 #include "routers/NetworkPriorityRouter.h"
@@ -140,6 +141,35 @@ void ApiEndpoints::configureAuthEndpoints(WebServer& server,
         }
     });
 
+    // Multipart .uacc upload: the file is streamed to disk, then validated where it was written
+    server.addStreamingRouteHandler("/api/file-auth", [event_handler](const ApiRequest& request) -> std::unique_ptr<RequestBodySink> {
+        std::string boundary = MultipartFileUploadSink::boundaryFromRequest(request);
+        if (boundary.empty()) {
+            return nullptr; // JSON/base64 uploads keep using the buffered handler
+        }
+
+        const size_t MAX_AUTH_FILE_SIZE = 1024 * 1024;
+        std::string upload_prefix = "auth_" + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count()) + "_";
+
+        return std::make_unique<MultipartFileUploadSink>(
+            boundary, "", "./data/file-auth-attempts", upload_prefix, MAX_AUTH_FILE_SIZE,
+            [event_handler](const MultipartFileUploadSink::Upload& upload) {
+                auto response = event_handler->authenticateUploadedFile(upload.filename, upload.file_path);
+
+                json api_response = {
+                    {"success", response.result == HttpEventHandler::EventResult::SUCCESS},
+                    {"message", response.message},
+                    {"data", response.data},
+                    {"session_token", response.session_token}
+                };
+
+                ApiResponse api_result;
+                api_result.setJsonResponse(api_response, response.http_status);
+                return api_result;
+            });
+    });
+
     // Echo endpoint for testing
     server.addRouteHandler("/api/echo", [event_handler](const std::string& method, const std::map<std::string, std::string>& params, const std::string& body) -> std::string {
         ENDPOINT_LOG_INFO("utils", "Echo endpoint called with method: " + method);
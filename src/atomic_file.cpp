@@ -0,0 +1,413 @@
+#include "atomic_file.h"
+#include "endpoint_logger.h"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace {
+
+// Journal record: header, then the path, then the contents
+struct RecordHeader {
+    uint32_t magic;
+    uint32_t path_length;
+    uint32_t contents_length;
+    uint32_t crc;                   // CRC-32 of the path and the contents
+};
+constexpr uint32_t RECORD_MAGIC = 0x314a5755;   // "UWJ1"
+
+std::atomic<uint64_t> temporary_counter{0};
+
+bool writeAll(int fd, const char* data, size_t length) {
+    size_t offset = 0;
+    while (offset < length) {
+        ssize_t written = ::write(fd, data + offset, length - offset);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        offset += static_cast<size_t>(written);
+    }
+    return true;
+}
+
+uint32_t recordCrc(const char* path, size_t path_length, const char* contents, size_t contents_length) {
+    uLong crc = ::crc32(0L, Z_NULL, 0);
+    crc = ::crc32(crc, reinterpret_cast<const Bytef*>(path), static_cast<uInt>(path_length));
+    crc = ::crc32(crc, reinterpret_cast<const Bytef*>(contents), static_cast<uInt>(contents_length));
+    return static_cast<uint32_t>(crc);
+}
+
+void appendRecord(std::string& records, const std::string& path, const std::string& contents) {
+    RecordHeader header{RECORD_MAGIC, static_cast<uint32_t>(path.size()),
+                        static_cast<uint32_t>(contents.size()),
+                        recordCrc(path.data(), path.size(), contents.data(), contents.size())};
+    records.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    records += path;
+    records += contents;
+}
+
+std::string describe(const std::string& what, int code) {
+    return what + ": " + std::strerror(code);
+}
+
+} // namespace
+
+// ==================== AtomicFile ====================
+
+std::string AtomicFile::directoryOf(const std::string& path) {
+    std::string directory = std::filesystem::path(path).parent_path().string();
+    return directory.empty() ? "." : directory;
+}
+
+bool AtomicFile::syncPath(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return errno == ENOENT;
+    }
+    bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+bool AtomicFile::write(const std::string& path, const std::string& contents, std::string& error,
+                       bool durable) {
+    std::string directory = directoryOf(path);
+
+    // Keep the mode of the file being replaced
+    struct stat info{};
+    mode_t mode = ::stat(path.c_str(), &info) == 0 ? (info.st_mode & 07777) : 0644;
+
+    // An O_TMPFILE file has no name until it is complete, so a crash while
+    // writing leaves nothing behind. It gets a temporary name just before
+    // the rename, since linkat() cannot replace an existing file.
+    std::string temporary = path + ".tmp-" + std::to_string(::getpid()) + "-" +
+                            std::to_string(temporary_counter.fetch_add(1));
+    bool unnamed = true;
+    int fd = ::open(directory.c_str(), O_TMPFILE | O_WRONLY | O_CLOEXEC, mode);
+    if (fd < 0 && (errno == EOPNOTSUPP || errno == EISDIR || errno == EINVAL)) {
+        unnamed = false;
+        fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, mode);
+    }
+    if (fd < 0) {
+        error = describe("open " + (unnamed ? directory : temporary), errno);
+        return false;
+    }
+
+    bool ok = true;
+    ::fchmod(fd, mode);     // open() applied the umask
+    if (!writeAll(fd, contents.data(), contents.size())) {
+        error = describe("write " + path, errno);
+        ok = false;
+    } else if (durable && ::fdatasync(fd) != 0) {
+        error = describe("fsync " + path, errno);
+        ok = false;
+    }
+    if (ok && unnamed) {
+        std::string proc_path = "/proc/self/fd/" + std::to_string(fd);
+        int linked = ::linkat(AT_FDCWD, proc_path.c_str(), AT_FDCWD, temporary.c_str(), AT_SYMLINK_FOLLOW);
+        if (linked != 0 && errno == ENOENT) {
+            // No /proc; this needs CAP_DAC_READ_SEARCH instead
+            linked = ::linkat(fd, "", AT_FDCWD, temporary.c_str(), AT_EMPTY_PATH);
+        }
+        if (linked != 0) {
+            error = describe("link " + temporary, errno);
+            ok = false;
+        }
+    }
+    if (::close(fd) != 0 && ok) {
+        error = describe("close " + temporary, errno);
+        ok = false;
+    }
+    if (ok && ::rename(temporary.c_str(), path.c_str()) != 0) {
+        error = describe("rename to " + path, errno);
+        ok = false;
+    }
+    if (!ok) {
+        ::unlink(temporary.c_str());
+        return false;
+    }
+
+    // The rename is only durable once the directory is
+    if (durable && !syncPath(directory)) {
+        error = describe("fsync " + directory, errno);
+        return false;
+    }
+    return true;
+}
+
+// ==================== WriteJournal ====================
+
+WriteJournal& WriteJournal::getInstance() {
+    static WriteJournal instance;
+    return instance;
+}
+
+WriteJournal::~WriteJournal() {
+    close();
+}
+
+bool WriteJournal::open(const std::string& path) {
+    std::unique_lock<std::shared_mutex> exclusive(checkpoint_lock_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fd_ >= 0) {
+        return true;
+    }
+
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (fd_ < 0) {
+        ENDPOINT_LOG("persistence", "Cannot open journal " + describe(path, errno) +
+                     "; files are synced one by one");
+        return false;
+    }
+    path_ = path;
+
+    size_t replayed = replay();
+    if (::ftruncate(fd_, 0) != 0 || ::fdatasync(fd_) != 0) {
+        ENDPOINT_LOG("persistence", "Cannot reset journal " + describe(path, errno));
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    AtomicFile::syncPath(AtomicFile::directoryOf(path));
+    size_ = 0;
+    if (replayed > 0) {
+        ENDPOINT_LOG("persistence", "Restored " + std::to_string(replayed) + " file(s) from journal " + path);
+    }
+    return true;
+}
+
+size_t WriteJournal::replay() {
+    std::string journal;
+    char buffer[65536];
+    off_t offset = 0;
+    for (;;) {
+        ssize_t count = ::pread(fd_, buffer, sizeof(buffer), offset);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) break;
+        journal.append(buffer, static_cast<size_t>(count));
+        offset += count;
+    }
+
+    // Later updates of a file supersede earlier ones. Parsing stops at the
+    // first damaged record: it is the append a crash interrupted.
+    std::map<std::string, std::string> latest;
+    size_t position = 0;
+    while (journal.size() - position >= sizeof(RecordHeader)) {
+        RecordHeader header;
+        std::memcpy(&header, journal.data() + position, sizeof(header));
+        size_t body = static_cast<size_t>(header.path_length) + header.contents_length;
+        if (header.magic != RECORD_MAGIC || journal.size() - position - sizeof(header) < body) {
+            break;
+        }
+        const char* path = journal.data() + position + sizeof(header);
+        const char* contents = path + header.path_length;
+        if (recordCrc(path, header.path_length, contents, header.contents_length) != header.crc) {
+            break;
+        }
+        latest[std::string(path, header.path_length)] = std::string(contents, header.contents_length);
+        position += sizeof(header) + body;
+    }
+    if (position < journal.size()) {
+        ENDPOINT_LOG("persistence", "Ignoring " + std::to_string(journal.size() - position) +
+                     " bytes of incomplete journal record(s)");
+    }
+
+    size_t restored = 0;
+    for (const auto& [path, contents] : latest) {
+        std::string error;
+        if (AtomicFile::write(path, contents, error)) {
+            ++restored;
+        } else {
+            ENDPOINT_LOG("persistence", "Cannot restore " + path + " from journal: " + error);
+        }
+    }
+    return restored;
+}
+
+bool WriteJournal::isOpen() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return fd_ >= 0;
+}
+
+bool WriteJournal::writeDirect(std::vector<Update>& updates) {
+    bool ok = true;
+    for (auto& update : updates) {
+        if (!AtomicFile::write(update.path, update.contents, update.error)) {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool WriteJournal::append(const std::string& records) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (fd_ < 0) {
+        return false;
+    }
+    if (!writeAll(fd_, records.data(), records.size())) {
+        // Drop the partial record so that later appends stay readable
+        ENDPOINT_LOG("persistence", "Journal append failed: " + describe(path_, errno));
+        [[maybe_unused]] int rc = ::ftruncate(fd_, static_cast<off_t>(size_));
+        return false;
+    }
+    size_ += records.size();
+    uint64_t ticket = ++appended_;
+
+    // Group commit: one writer syncs for everything appended so far while
+    // the others wait for it
+    while (synced_ < ticket) {
+        if (syncing_) {
+            synced_cv_.wait(lock);
+            continue;
+        }
+        syncing_ = true;
+        uint64_t target = appended_;
+        int fd = fd_;
+        lock.unlock();
+        bool synced = ::fdatasync(fd) == 0;
+        int code = errno;
+        lock.lock();
+        syncing_ = false;
+        if (synced) {
+            synced_ = std::max(synced_, target);
+        }
+        synced_cv_.notify_all();
+        if (!synced) {
+            ENDPOINT_LOG("persistence", "Journal sync failed: " + describe(path_, code));
+            return false;
+        }
+    }
+    return true;
+}
+
+bool WriteJournal::write(std::vector<Update>& updates) {
+    if (updates.empty()) {
+        return true;
+    }
+    size_t bytes = 0;
+    for (const auto& update : updates) {
+        bytes += update.path.size() + update.contents.size();
+    }
+
+    bool ok = true;
+    bool journaled = false;
+    bool checkpoint_due = false;
+    {
+        std::shared_lock<std::shared_mutex> shared(checkpoint_lock_);
+        if (!isOpen()) {
+            return writeDirect(updates);
+        }
+
+        if (bytes <= MAX_JOURNALED_BYTES) {
+            std::string records;
+            records.reserve(bytes + updates.size() * sizeof(RecordHeader));
+            for (const auto& update : updates) {
+                // Replay may run from another working directory
+                std::error_code ec;
+                std::filesystem::path absolute = std::filesystem::absolute(update.path, ec);
+                appendRecord(records, ec ? update.path : absolute.string(), update.contents);
+            }
+            journaled = append(records);
+        }
+
+        if (journaled) {
+            // The journal has the updates now; the files themselves are synced
+            // at the next checkpoint
+            for (auto& update : updates) {
+                if (!AtomicFile::write(update.path, update.contents, update.error, false)) {
+                    ok = false;
+                }
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (const auto& update : updates) {
+                if (update.error.empty()) {
+                    unsynced_.insert(update.path);
+                }
+            }
+            checkpoint_due = size_ >= CHECKPOINT_BYTES;
+        }
+    }
+
+    if (!journaled) {
+        // Too large to journal, or the append failed. The journal may still
+        // hold older contents of these files, which replay would put back
+        // after a crash, so empty it first and keep writers out until the
+        // files are replaced.
+        std::unique_lock<std::shared_mutex> exclusive(checkpoint_lock_);
+        if (!checkpointLocked()) {
+            for (auto& update : updates) {
+                update.error = "journal holds older contents and could not be checkpointed";
+            }
+            return false;
+        }
+        return writeDirect(updates);
+    }
+
+    if (checkpoint_due) {
+        checkpoint();
+    }
+    return ok;
+}
+
+bool WriteJournal::write(const std::string& path, const std::string& contents, std::string& error) {
+    std::vector<Update> updates{{path, contents, {}}};
+    bool ok = write(updates);
+    error = updates.front().error;
+    return ok;
+}
+
+bool WriteJournal::checkpoint() {
+    std::unique_lock<std::shared_mutex> exclusive(checkpoint_lock_);
+    return checkpointLocked();
+}
+
+bool WriteJournal::checkpointLocked() {
+    std::set<std::string> files;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (fd_ < 0 || size_ == 0) {
+            return true;
+        }
+        files.swap(unsynced_);
+    }
+
+    bool ok = true;
+    std::set<std::string> directories;
+    for (const auto& file : files) {
+        ok = AtomicFile::syncPath(file) && ok;
+        directories.insert(AtomicFile::directoryOf(file));
+    }
+    for (const auto& directory : directories) {
+        ok = AtomicFile::syncPath(directory) && ok;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!ok) {
+        // Keep the journal; the files are synced again next time
+        ENDPOINT_LOG("persistence", "Checkpoint could not sync every file; journal kept");
+        unsynced_.insert(files.begin(), files.end());
+        return false;
+    }
+    if (::ftruncate(fd_, 0) != 0 || ::fdatasync(fd_) != 0) {
+        ENDPOINT_LOG("persistence", "Cannot reset journal " + describe(path_, errno));
+        return false;
+    }
+    size_ = 0;
+    return true;
+}
+
+void WriteJournal::close() {
+    checkpoint();
+    std::unique_lock<std::shared_mutex> exclusive(checkpoint_lock_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
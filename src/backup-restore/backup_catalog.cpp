@@ -0,0 +1,259 @@
+#include "backup_catalog.h"
+#include "atomic_file.h"
+#include "backup_object_store.h"
+#include "backup_stream.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <vector>
+#include <sys/stat.h>
+
+namespace {
+
+const char* const CATALOG_FILE = "catalog.json";
+const char* const BACKUP_TYPES[] = {"full", "partial", "network_config", "license", "authentication"};
+
+int64_t mtimeOf(const struct stat& info) {
+    return static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+}
+
+std::string formatTime(time_t time) {
+    std::stringstream ss;
+    ss << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S");
+    return ss.str();
+}
+
+std::string backupTypeOf(const std::string& filename) {
+    for (const char* type : BACKUP_TYPES) {
+        if (filename.starts_with(std::string("backup_") + type + "_")) {
+            return type;
+        }
+    }
+    return "unknown";
+}
+
+} // namespace
+
+BackupCatalog::BackupCatalog(const std::string& storagePath)
+    : m_storagePath(storagePath), m_catalogPath(storagePath + "/" + CATALOG_FILE) {
+}
+
+bool BackupCatalog::isBackupFile(const std::string& filename) {
+    return filename.starts_with("backup_") &&
+           (filename.ends_with(".uhb") || filename.ends_with(".uhb.enc") || filename.ends_with(".uhm"));
+}
+
+bool BackupCatalog::isCurrent(const json& entry) {
+    struct stat info{};
+    std::string path = entry.value("file_path", "");
+    return ::stat(path.c_str(), &info) == 0 &&
+           entry.value("size", uint64_t(0)) == static_cast<uint64_t>(info.st_size) &&
+           entry.value("modified_ns", int64_t(0)) == mtimeOf(info);
+}
+
+json BackupCatalog::add(const std::string& path) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ensureLoaded();
+
+    json entry = describe(path);
+    m_entries[entry["filename"]] = entry;
+    save();
+    return entry;
+}
+
+bool BackupCatalog::remove(const std::string& filename) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ensureLoaded();
+
+    auto found = m_entries.find(filename);
+    if (found == m_entries.end()) {
+        return false;
+    }
+    std::error_code ec;
+    std::filesystem::remove(found->second.value("file_path", ""), ec);
+    if (ec) {
+        throw std::runtime_error("Failed to delete " + filename + ": " + ec.message());
+    }
+    m_entries.erase(found);
+    save();
+    return true;
+}
+
+json BackupCatalog::list() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ensureLoaded();
+
+    std::vector<const json*> entries;
+    for (const auto& [filename, entry] : m_entries) {
+        entries.push_back(&entry);
+    }
+    std::sort(entries.begin(), entries.end(), [](const json* a, const json* b) {
+        return a->value("modified_ns", int64_t(0)) > b->value("modified_ns", int64_t(0));
+    });
+
+    json result = json::array();
+    for (const json* entry : entries) {
+        result.push_back(*entry);
+    }
+    return result;
+}
+
+bool BackupCatalog::find(const std::string& filename, json& entry) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ensureLoaded();
+
+    auto found = m_entries.find(filename);
+    if (found == m_entries.end()) {
+        return false;
+    }
+    entry = found->second;
+    return true;
+}
+
+void BackupCatalog::setValidation(const std::string& filename, bool valid) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ensureLoaded();
+
+    auto found = m_entries.find(filename);
+    if (found == m_entries.end()) {
+        return;
+    }
+    found->second["validation"] = valid ? "passed" : "failed";
+    found->second["validated_at"] = formatTime(std::time(nullptr));
+    save();
+}
+
+void BackupCatalog::ensureLoaded() {
+    if (m_loaded) {
+        if (directoryMtime() != m_directoryMtime) {
+            reconcile();
+        }
+        return;
+    }
+    m_loaded = true;
+
+    std::ifstream file(m_catalogPath);
+    if (file) {
+        try {
+            json catalog = json::parse(file);
+            for (const auto& entry : catalog.at("backups")) {
+                m_entries[entry.at("filename")] = entry;
+            }
+        } catch (const std::exception& e) {
+            std::cout << "[BACKUP-CATALOG] Rebuilding unreadable catalog: " << e.what() << std::endl;
+            m_entries.clear();
+        }
+    } else {
+        std::cout << "[BACKUP-CATALOG] No catalog yet, building it from " << m_storagePath << std::endl;
+    }
+    // Whatever changed while the server was not running
+    reconcile();
+}
+
+void BackupCatalog::reconcile() {
+    int64_t mtime = directoryMtime();
+    std::set<std::string> present;
+    bool changed = false;
+
+    std::error_code ec;
+    for (const auto& file : std::filesystem::directory_iterator(m_storagePath, ec)) {
+        std::string filename = file.path().filename().string();
+        if (!file.is_regular_file() || !isBackupFile(filename)) {
+            continue;
+        }
+        present.insert(filename);
+        auto found = m_entries.find(filename);
+        if (found == m_entries.end() || !isCurrent(found->second)) {
+            m_entries[filename] = describe(file.path());
+            changed = true;
+        }
+    }
+    for (auto entry = m_entries.begin(); entry != m_entries.end();) {
+        if (present.count(entry->first) == 0) {
+            entry = m_entries.erase(entry);
+            changed = true;
+        } else {
+            ++entry;
+        }
+    }
+
+    if (changed || !std::filesystem::exists(m_catalogPath)) {
+        save();
+    } else {
+        m_directoryMtime = mtime;
+    }
+}
+
+void BackupCatalog::save() {
+    json catalog;
+    catalog["version"] = 1;
+    catalog["backups"] = json::array();
+    for (const auto& [filename, entry] : m_entries) {
+        catalog["backups"].push_back(entry);
+    }
+
+    std::string error;
+    if (AtomicFile::write(m_catalogPath, catalog.dump(), error)) {
+        // Includes the rename of the catalog itself
+        m_directoryMtime = directoryMtime();
+    } else {
+        // The in-memory catalog stays right; the file is rebuilt next start
+        std::cout << "[BACKUP-CATALOG] Warning: Failed to save catalog: " << error << std::endl;
+        m_directoryMtime = -1;
+    }
+}
+
+json BackupCatalog::describe(const std::filesystem::path& path) const {
+    std::string filename = path.filename().string();
+
+    json entry;
+    entry["filename"] = filename;
+    entry["file_path"] = path.string();
+    entry["type"] = backupTypeOf(filename);
+    entry["encrypted"] = filename.ends_with(".enc");
+    entry["incremental"] = filename.ends_with(".uhm");
+    entry["file_count"] = 0;
+    entry["sha256"] = "";
+    entry["validation"] = "unverified";
+
+    struct stat info{};
+    if (::stat(path.c_str(), &info) != 0) {
+        entry["error"] = std::strerror(errno);
+        return entry;
+    }
+    entry["size"] = info.st_size;
+    entry["modified_ns"] = mtimeOf(info);
+    entry["created_at"] = formatTime(info.st_mtim.tv_sec);
+
+    try {
+        if (entry["incremental"]) {
+            json manifest = BackupStream::ObjectStore::readManifest(path.string());
+            entry["type"] = manifest.value("backup_type", entry["type"].get<std::string>());
+            entry["file_count"] = manifest.value("file_count", 0);
+            entry["content_size"] = manifest.value("total_size", uint64_t(0));
+        } else if (!entry["encrypted"]) {
+            // The header only; the payload is hashed when validated
+            BackupStream::UhbReader reader(path.string());
+            entry["file_count"] = reader.metadata().value("file_count", 0);
+            entry["sha256"] = reader.metadata().value("sha256", "");
+            entry["compressed_size"] = reader.metadata().value("compressed_size", uint64_t(0));
+        }
+    } catch (const std::exception& e) {
+        entry["error"] = e.what();
+    }
+    return entry;
+}
+
+int64_t BackupCatalog::directoryMtime() const {
+    struct stat info{};
+    if (::stat(m_storagePath.c_str(), &info) != 0) {
+        return -1;
+    }
+    return mtimeOf(info);
+}
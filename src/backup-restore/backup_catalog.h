@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+/**
+ * Index of the backups in the storage directory (catalog.json), so that
+ * listing them, looking one up or asking whether it was validated does not
+ * scan the directory or open the files.
+ *
+ * Each entry holds what the backup's header or manifest says (type, file
+ * count, payload hash), its size and mtime, and the outcome of the last
+ * integrity check. The catalog is replaced atomically whenever a backup is
+ * added or removed. It is loaded on first use and rebuilt from the files
+ * when missing or unreadable; when the directory's mtime shows that files
+ * came or went behind its back, only those files are looked at again.
+ */
+class BackupCatalog {
+public:
+    explicit BackupCatalog(const std::string& storagePath);
+
+    // Describe a backup just written (or rewritten) and record it
+    json add(const std::string& path);
+    // Delete the backup file and its entry; false when it is not catalogued
+    bool remove(const std::string& filename);
+
+    // Entries, newest first
+    json list();
+    bool find(const std::string& filename, json& entry);
+
+    // Record the outcome of an integrity check
+    void setValidation(const std::string& filename, bool valid);
+
+    // Whether the file still has the size and mtime its entry records
+    static bool isCurrent(const json& entry);
+    // backup_<type>_<timestamp>.uhb, .uhb.enc or .uhm
+    static bool isBackupFile(const std::string& filename);
+
+private:
+    void ensureLoaded();
+    void reconcile();
+    void save();
+    json describe(const std::filesystem::path& path) const;
+    int64_t directoryMtime() const;
+
+    std::string m_storagePath;
+    std::string m_catalogPath;
+    std::mutex m_mutex;
+    bool m_loaded = false;
+    int64_t m_directoryMtime = -1;      // As last seen; -1 forces a reconcile
+    std::map<std::string, json> m_entries;
+};
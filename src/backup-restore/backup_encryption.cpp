@@ -0,0 +1,408 @@
+#include "backup_encryption.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+
+namespace BackupStream {
+
+namespace {
+
+constexpr size_t NONCE_SIZE = 12;
+constexpr size_t SALT_OFFSET = 16;
+constexpr size_t SALT_SIZE = 16;
+constexpr size_t MAC_OFFSET = 32;           // The MAC covers the bytes before it
+constexpr uint32_t MIN_CHUNK_SIZE = 4096;   // Chunk 0 must hold the .uhb header
+constexpr uint32_t MAX_CHUNK_SIZE = 16 * 1024 * 1024;
+constexpr uint32_t MAX_ITERATIONS = 10000000;
+
+std::runtime_error systemError(const std::string& what) {
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+void putBigEndian32(uint8_t* out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out[i] = static_cast<uint8_t>(value >> (24 - 8 * i));
+    }
+}
+
+uint32_t getBigEndian32(const uint8_t* in) {
+    return (uint32_t{in[0]} << 24) | (uint32_t{in[1]} << 16) | (uint32_t{in[2]} << 8) | in[3];
+}
+
+void makeNonce(uint64_t index, bool last, uint8_t* nonce) {
+    for (int i = 0; i < 8; ++i) {
+        nonce[i] = static_cast<uint8_t>(index >> (56 - 8 * i));
+    }
+    putBigEndian32(nonce + 8, last ? 1 : 0);
+}
+
+// AES key and header MAC key from the password
+void deriveKeys(const std::string& password, const uint8_t* salt, uint32_t iterations,
+                std::array<uint8_t, 32>& key, std::array<uint8_t, 32>& macKey) {
+    uint8_t derived[64];
+    if (PKCS5_PBKDF2_HMAC(password.data(), static_cast<int>(password.size()), salt, SALT_SIZE,
+                          static_cast<int>(iterations), EVP_sha256(), sizeof(derived), derived) != 1) {
+        throw std::runtime_error("Failed to derive the backup key");
+    }
+    std::memcpy(key.data(), derived, 32);
+    std::memcpy(macKey.data(), derived + 32, 32);
+    OPENSSL_cleanse(derived, sizeof(derived));
+}
+
+void headerMac(const std::array<uint8_t, 32>& macKey, const uint8_t* header, uint8_t* mac) {
+    unsigned int length = 0;
+    HMAC(EVP_sha256(), macKey.data(), static_cast<int>(macKey.size()), header, MAC_OFFSET, mac, &length);
+}
+
+// Ciphertext followed by the tag
+bool sealChunk(const std::array<uint8_t, 32>& key, const uint8_t* header, uint64_t index, bool last,
+               const uint8_t* plaintext, size_t length, uint8_t* out) {
+    uint8_t nonce[NONCE_SIZE];
+    makeNonce(index, last, nonce);
+    EVP_CIPHER_CTX* context = EVP_CIPHER_CTX_new();
+    int produced = 0;
+    int finalLength = 0;
+    bool ok = context &&
+              EVP_EncryptInit_ex(context, EVP_aes_256_gcm(), nullptr, key.data(), nonce) == 1 &&
+              EVP_EncryptUpdate(context, nullptr, &produced, header, BackupEncryption::HEADER_SIZE) == 1 &&
+              EVP_EncryptUpdate(context, out, &produced, plaintext, static_cast<int>(length)) == 1 &&
+              EVP_EncryptFinal_ex(context, out + produced, &finalLength) == 1 &&
+              EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_GCM_GET_TAG, BackupEncryption::TAG_SIZE, out + length) == 1;
+    EVP_CIPHER_CTX_free(context);
+    return ok;
+}
+
+bool openChunk(const std::array<uint8_t, 32>& key, const uint8_t* header, uint64_t index, bool last,
+               uint8_t* sealed, size_t length, uint8_t* plaintext) {
+    uint8_t nonce[NONCE_SIZE];
+    makeNonce(index, last, nonce);
+    EVP_CIPHER_CTX* context = EVP_CIPHER_CTX_new();
+    int produced = 0;
+    int finalLength = 0;
+    bool ok = context &&
+              EVP_DecryptInit_ex(context, EVP_aes_256_gcm(), nullptr, key.data(), nonce) == 1 &&
+              EVP_DecryptUpdate(context, nullptr, &produced, header, BackupEncryption::HEADER_SIZE) == 1 &&
+              EVP_DecryptUpdate(context, plaintext, &produced, sealed, static_cast<int>(length)) == 1 &&
+              EVP_CIPHER_CTX_ctrl(context, EVP_CTRL_GCM_SET_TAG, BackupEncryption::TAG_SIZE, sealed + length) == 1 &&
+              EVP_DecryptFinal_ex(context, plaintext + produced, &finalLength) == 1;
+    EVP_CIPHER_CTX_free(context);
+    return ok;
+}
+
+bool readAll(int fd, uint8_t* data, size_t length, uint64_t offset) {
+    while (length > 0) {
+        ssize_t count = ::pread(fd, data, length, static_cast<off_t>(offset));
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) return false;
+        data += count;
+        length -= static_cast<size_t>(count);
+        offset += static_cast<uint64_t>(count);
+    }
+    return true;
+}
+
+} // namespace
+
+bool BackupEncryption::isContainer(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    uint8_t magic[sizeof(MAGIC)];
+    bool match = readAll(fd, magic, sizeof(magic), 0) && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+    ::close(fd);
+    return match;
+}
+
+uint64_t BackupEncryption::containerSize(uint64_t plainSize) {
+    // A chunk is only sealed once it is full or the data ends, so an empty
+    // payload still takes one (empty) chunk
+    uint64_t chunks = std::max<uint64_t>(1, (plainSize + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    return HEADER_SIZE + plainSize + chunks * TAG_SIZE;
+}
+
+// ==================== EncryptedFileOutput ====================
+
+EncryptedFileOutput::EncryptedFileOutput(const std::string& path, const std::string& password, uint32_t iterations)
+    : m_path(path) {
+    std::memcpy(m_header.data(), BackupEncryption::MAGIC, sizeof(BackupEncryption::MAGIC));
+    putBigEndian32(m_header.data() + 8, BackupEncryption::CHUNK_SIZE);
+    putBigEndian32(m_header.data() + 12, iterations);
+    if (RAND_bytes(m_header.data() + SALT_OFFSET, SALT_SIZE) != 1) {
+        throw std::runtime_error("Failed to generate a salt");
+    }
+    std::array<uint8_t, 32> macKey{};
+    deriveKeys(password, m_header.data() + SALT_OFFSET, iterations, m_key, macKey);
+    headerMac(macKey, m_header.data(), m_header.data() + MAC_OFFSET);
+    OPENSSL_cleanse(macKey.data(), macKey.size());
+
+    m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (m_fd < 0) {
+        throw systemError("Failed to create output file: " + path);
+    }
+    if (::pwrite(m_fd, m_header.data(), m_header.size(), 0) != static_cast<ssize_t>(m_header.size())) {
+        auto error = systemError("Failed to write " + path);
+        abandon();
+        throw error;
+    }
+    m_chunk.reserve(BackupEncryption::CHUNK_SIZE);
+    m_ciphertext.resize(BackupEncryption::CHUNK_SIZE + BackupEncryption::TAG_SIZE);
+}
+
+EncryptedFileOutput::~EncryptedFileOutput() {
+    abandon();
+    OPENSSL_cleanse(m_key.data(), m_key.size());
+}
+
+void EncryptedFileOutput::write(const uint8_t* data, size_t length) {
+    while (length > 0) {
+        // A full chunk is only sealed once more data arrives: the last one
+        // must be marked as such
+        if (m_chunk.size() == BackupEncryption::CHUNK_SIZE) {
+            if (m_index == 0) {
+                m_first.swap(m_chunk);
+            } else {
+                writeChunk(m_index, m_chunk, false);
+            }
+            m_chunk.clear();
+            m_chunk.reserve(BackupEncryption::CHUNK_SIZE);
+            m_index++;
+        }
+        size_t count = std::min(length, BackupEncryption::CHUNK_SIZE - m_chunk.size());
+        m_chunk.insert(m_chunk.end(), data, data + count);
+        data += count;
+        length -= count;
+    }
+}
+
+void EncryptedFileOutput::patch(const uint8_t* data, size_t length) {
+    std::vector<uint8_t>& first = m_index == 0 ? m_chunk : m_first;
+    if (length > first.size()) {
+        throw std::runtime_error("Backup header patch is larger than the first chunk");
+    }
+    std::memcpy(first.data(), data, length);
+}
+
+void EncryptedFileOutput::commit() {
+    writeChunk(m_index, m_chunk, true);
+    if (m_index > 0) {
+        writeChunk(0, m_first, false);
+    }
+    if (::fdatasync(m_fd) != 0) {
+        throw systemError("Failed to sync " + m_path);
+    }
+    ::close(m_fd);
+    m_fd = -1;
+}
+
+void EncryptedFileOutput::abandon() {
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+        ::unlink(m_path.c_str());
+    }
+}
+
+void EncryptedFileOutput::writeChunk(uint64_t index, const std::vector<uint8_t>& plaintext, bool last) {
+    if (!sealChunk(m_key, m_header.data(), index, last, plaintext.data(), plaintext.size(), m_ciphertext.data())) {
+        throw std::runtime_error("Failed to encrypt backup");
+    }
+    size_t length = plaintext.size() + BackupEncryption::TAG_SIZE;
+    uint64_t offset = BackupEncryption::HEADER_SIZE + index * (BackupEncryption::CHUNK_SIZE + BackupEncryption::TAG_SIZE);
+    const uint8_t* data = m_ciphertext.data();
+    while (length > 0) {
+        ssize_t written = ::pwrite(m_fd, data, length, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            throw systemError("Failed to write " + m_path);
+        }
+        data += written;
+        length -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
+    }
+}
+
+// ==================== EncryptedFileInput ====================
+
+EncryptedFileInput::EncryptedFileInput(const std::string& path, const std::string& password, size_t threads)
+    : m_path(path), m_threads(std::max<size_t>(threads, 1)), m_maxInFlight(2 * m_threads) {
+    m_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info{};
+    if (m_fd < 0 || ::fstat(m_fd, &info) != 0) {
+        auto error = systemError("Failed to open backup file " + path);
+        if (m_fd >= 0) {
+            ::close(m_fd);
+        }
+        throw error;
+    }
+
+    try {
+        if (!readAll(m_fd, m_header.data(), m_header.size(), 0) ||
+            std::memcmp(m_header.data(), BackupEncryption::MAGIC, sizeof(BackupEncryption::MAGIC)) != 0) {
+            throw std::runtime_error("Not an encrypted backup: " + path);
+        }
+        m_chunkSize = getBigEndian32(m_header.data() + 8);
+        uint32_t iterations = getBigEndian32(m_header.data() + 12);
+        if (m_chunkSize < MIN_CHUNK_SIZE || m_chunkSize > MAX_CHUNK_SIZE ||
+            iterations == 0 || iterations > MAX_ITERATIONS) {
+            throw std::runtime_error("Damaged encrypted backup header");
+        }
+
+        std::array<uint8_t, 32> macKey{};
+        deriveKeys(password, m_header.data() + SALT_OFFSET, iterations, m_key, macKey);
+        uint8_t mac[32];
+        headerMac(macKey, m_header.data(), mac);
+        OPENSSL_cleanse(macKey.data(), macKey.size());
+        if (CRYPTO_memcmp(mac, m_header.data() + MAC_OFFSET, sizeof(mac)) != 0) {
+            throw std::runtime_error("Wrong password or damaged backup header");
+        }
+
+        uint64_t body = static_cast<uint64_t>(info.st_size) - std::min<uint64_t>(info.st_size, BackupEncryption::HEADER_SIZE);
+        uint64_t stride = m_chunkSize + BackupEncryption::TAG_SIZE;
+        m_chunkCount = (body + stride - 1) / stride;
+        uint64_t lastLength = m_chunkCount > 0 ? body - (m_chunkCount - 1) * stride : 0;
+        if (m_chunkCount == 0 || lastLength < BackupEncryption::TAG_SIZE) {
+            throw std::runtime_error("Encrypted backup is truncated");
+        }
+        m_plainSize = (m_chunkCount - 1) * m_chunkSize + lastLength - BackupEncryption::TAG_SIZE;
+    } catch (...) {
+        ::close(m_fd);
+        OPENSSL_cleanse(m_key.data(), m_key.size());
+        throw;
+    }
+}
+
+EncryptedFileInput::~EncryptedFileInput() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_workAvailable.notify_all();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+    ::close(m_fd);
+    OPENSSL_cleanse(m_key.data(), m_key.size());
+}
+
+bool EncryptedFileInput::decryptChunk(uint64_t index, std::vector<uint8_t>& sealed, std::vector<uint8_t>& plaintext) const {
+    bool last = index + 1 == m_chunkCount;
+    uint64_t length = last ? m_plainSize - index * m_chunkSize : m_chunkSize;
+    uint64_t offset = BackupEncryption::HEADER_SIZE + index * (m_chunkSize + BackupEncryption::TAG_SIZE);
+    sealed.resize(length + BackupEncryption::TAG_SIZE);
+    plaintext.resize(length);
+    return readAll(m_fd, sealed.data(), sealed.size(), offset) &&
+           openChunk(m_key, m_header.data(), index, last, sealed.data(), length, plaintext.data());
+}
+
+std::shared_ptr<EncryptedFileInput::Chunk> EncryptedFileInput::fetch(uint64_t index) {
+    std::shared_ptr<Chunk> chunk;
+    if (m_threads == 1) {
+        chunk = std::make_shared<Chunk>();
+        chunk->index = index;
+        chunk->ok = decryptChunk(index, chunk->sealed, chunk->plaintext);
+    } else {
+        if (m_workers.empty()) {
+            for (size_t i = 0; i < m_threads; ++i) {
+                m_workers.emplace_back(&EncryptedFileInput::workerLoop, this);
+            }
+        }
+        if (m_inFlight.empty() || m_inFlight.front()->index != index) {
+            // Not the next chunk: what was read ahead is of no use. Chunks
+            // a worker already took finish on their own.
+            m_inFlight.clear();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_queue.clear();
+            }
+            m_nextSubmit = index;
+        }
+        while (m_inFlight.size() < m_maxInFlight && m_nextSubmit < m_chunkCount) {
+            submit(m_nextSubmit++);
+        }
+
+        chunk = m_inFlight.front();
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_chunkDone.wait(lock, [&chunk] { return chunk->done; });
+        }
+        m_inFlight.pop_front();
+        if (m_nextSubmit < m_chunkCount) {
+            submit(m_nextSubmit++);
+        }
+    }
+    if (!chunk->ok) {
+        throw std::runtime_error("Encrypted backup failed authentication");
+    }
+    return chunk;
+}
+
+void EncryptedFileInput::submit(uint64_t index) {
+    auto chunk = std::make_shared<Chunk>();
+    chunk->index = index;
+    m_inFlight.push_back(chunk);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(std::move(chunk));
+    }
+    m_workAvailable.notify_one();
+}
+
+void EncryptedFileInput::workerLoop() {
+    for (;;) {
+        std::shared_ptr<Chunk> chunk;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_workAvailable.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+            if (m_stopping) {
+                return;
+            }
+            chunk = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+
+        chunk->ok = decryptChunk(chunk->index, chunk->sealed, chunk->plaintext);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            chunk->done = true;
+        }
+        m_chunkDone.notify_all();
+    }
+}
+
+size_t EncryptedFileInput::readAt(uint64_t offset, uint8_t* data, size_t length) {
+    if (offset >= m_plainSize || length == 0) {
+        return 0;
+    }
+    uint64_t index = offset / m_chunkSize;
+    if (!m_current || m_current->index != index) {
+        m_current = fetch(index);
+    }
+    const std::vector<uint8_t>& chunk = m_current->plaintext;
+    size_t start = static_cast<size_t>(offset % m_chunkSize);
+    size_t count = std::min(length, chunk.size() - start);
+    std::memcpy(data, chunk.data() + start, count);
+    return count;
+}
+
+bool EncryptedFileInput::verify() {
+    // Through the same read-ahead as sequential reads, keeping nothing
+    try {
+        for (uint64_t index = 0; index < m_chunkCount; ++index) {
+            fetch(index);
+        }
+    } catch (const std::exception&) {
+        return false;
+    }
+    return true;
+}
+
+} // namespace BackupStream
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "backup_stream.h"
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Encrypted .uhb.enc container: AES-256-GCM over fixed-size chunks, so that
+ * a backup is encrypted and decrypted as it streams and any chunk can be
+ * read (and checked) on its own.
+ *
+ *   header   "UHBGCM01", chunk size and PBKDF2 iterations (big-endian
+ *            uint32), 16-byte salt, then an HMAC-SHA256 of those 32 bytes
+ *   chunks   ciphertext of chunk_size bytes (the last one shorter or equal)
+ *            followed by its 16-byte tag
+ *
+ * PBKDF2-HMAC-SHA256 of the password yields the AES key and the header MAC
+ * key, once per backup or restore. Chunk i uses the nonce big-endian(i) in
+ * 8 bytes followed by 1 for the last chunk and 0 otherwise, and the header
+ * as additional data; a truncated, reordered or spliced file therefore fails
+ * to authenticate. OpenSSL picks the AES-NI/VAES code paths on its own.
+ */
+namespace BackupStream {
+
+class BackupEncryption {
+public:
+    static constexpr char MAGIC[8] = {'U', 'H', 'B', 'G', 'C', 'M', '0', '1'};
+    static constexpr size_t HEADER_SIZE = 64;
+    static constexpr size_t TAG_SIZE = 16;
+    static constexpr uint32_t CHUNK_SIZE = 64 * 1024;
+    static constexpr uint32_t PBKDF2_ITERATIONS = 100000;
+
+    // True when the file starts with this container's magic (older .enc
+    // files are AES-CBC with a bare salt and IV)
+    static bool isContainer(const std::string& path);
+    // Size of the container holding plainSize bytes, without deriving a key
+    static uint64_t containerSize(uint64_t plainSize);
+};
+
+// Writes the container. Chunk 0, which holds the .uhb header, is kept in
+// memory until commit() so the header can still be patched; the other
+// chunks are encrypted and written as they fill.
+class EncryptedFileOutput : public UhbOutput {
+public:
+    EncryptedFileOutput(const std::string& path, const std::string& password,
+                        uint32_t iterations = BackupEncryption::PBKDF2_ITERATIONS);
+    ~EncryptedFileOutput() override;
+
+    void write(const uint8_t* data, size_t length) override;
+    void patch(const uint8_t* data, size_t length) override;
+    void commit() override;
+    void abandon() override;
+
+private:
+    void writeChunk(uint64_t index, const std::vector<uint8_t>& plaintext, bool last);
+
+    std::string m_path;
+    int m_fd = -1;
+    std::array<uint8_t, BackupEncryption::HEADER_SIZE> m_header{};
+    std::array<uint8_t, 32> m_key{};
+    uint64_t m_index = 0;                   // Of the chunk in m_chunk
+    std::vector<uint8_t> m_chunk;
+    std::vector<uint8_t> m_first;           // Chunk 0 once full
+    std::vector<uint8_t> m_ciphertext;
+};
+
+// Reads the plaintext back. With more than one thread, sequential reads are
+// served from chunks that a pool of workers, started on the first read,
+// decrypts ahead of them; a read elsewhere in the file restarts the
+// read-ahead there.
+class EncryptedFileInput : public RandomAccessInput {
+public:
+    // Throws when the password is wrong or the header was altered
+    EncryptedFileInput(const std::string& path, const std::string& password, size_t threads = 1);
+    ~EncryptedFileInput() override;
+
+    uint64_t size() const override { return m_plainSize; }
+    size_t readAt(uint64_t offset, uint8_t* data, size_t length) override;
+
+    // Authenticate every chunk, spread over the threads, without keeping
+    // the plaintext
+    bool verify();
+
+private:
+    struct Chunk {
+        uint64_t index = 0;
+        std::vector<uint8_t> sealed;
+        std::vector<uint8_t> plaintext;
+        bool ok = false;
+        bool done = false;
+    };
+
+    bool decryptChunk(uint64_t index, std::vector<uint8_t>& ciphertext, std::vector<uint8_t>& plaintext) const;
+    // The decrypted chunk; throws when it fails authentication
+    std::shared_ptr<Chunk> fetch(uint64_t index);
+    void submit(uint64_t index);
+    void workerLoop();
+
+    std::string m_path;
+    int m_fd = -1;
+    std::array<uint8_t, BackupEncryption::HEADER_SIZE> m_header{};
+    std::array<uint8_t, 32> m_key{};
+    uint32_t m_chunkSize = 0;
+    uint64_t m_chunkCount = 0;
+    uint64_t m_plainSize = 0;
+    size_t m_threads;
+    size_t m_maxInFlight;
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_chunkDone;
+    std::deque<std::shared_ptr<Chunk>> m_queue;         // Waiting for a worker
+    bool m_stopping = false;
+
+    // Calling thread only
+    std::deque<std::shared_ptr<Chunk>> m_inFlight;      // Read-ahead, in index order
+    uint64_t m_nextSubmit = 0;
+    std::shared_ptr<Chunk> m_current;                   // Chunk reads are served from
+};
+
+} // namespace BackupStream
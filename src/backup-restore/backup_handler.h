@@ -4,7 +4,10 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <nlohmann/json.hpp>
+#include "backup_catalog.h"
 
 using json = nlohmann::json;
 
@@ -26,9 +29,20 @@ public:
     std::string createLicenseBackup(const json& config);
     std::string createAuthenticationBackup(const json& config);
     
+    // Stored backups, from the catalog
+    json listBackups();
+    bool findBackup(const std::string& filename, json& entry);
+    bool deleteBackup(const std::string& filename);
+    
+    // Size and file count a backup would have; a temporary backup is only
+    // built when the selected files changed since the last estimate
+    json estimateBackup(const json& backupConfig);
+    
     // Utility functions
     std::vector<std::string> getBackupFiles(const std::string& backupType);
     std::string calculateDirectorySize(const std::vector<std::string>& files);
+    // Answered from the catalog when a stored .uhb is unchanged since its
+    // last check; incremental manifests are checked object by object each time
     bool validateBackupIntegrity(const std::string& backupFilePath);
     
 private:
@@ -40,13 +54,36 @@ private:
     int m_maxBackupAgeDays;
     bool m_autoCleanup;
     int m_compressionLevel;
+    int m_compressionThreads;   // 0: one per core
+    bool m_incrementalBackups;
+    std::mutex m_storeMutex;    // Object store: incremental backups, their restores and cleanup
+    std::unique_ptr<BackupCatalog> m_catalog;
+    std::mutex m_estimateMutex;
+    std::map<std::string, json> m_estimates;    // Selection -> fingerprint of its files, size, count
     
     // Core operations
-    std::string compressFiles(const std::vector<std::string>& files, const std::string& outputPath);
+    // Archive, or incremental manifest, as configured; returns the path written
+    std::string writeBackup(const std::vector<std::string>& files, const std::string& backupType,
+                            const json& config);
+    // Returns the path written: outputPath, or outputPath + ".enc" with a password
+    std::string compressFiles(const std::vector<std::string>& files, const std::string& outputPath,
+                              const std::string& password = "");
     std::string encryptBackup(const std::string& filePath, const std::string& password);
     std::string decryptBackup(const std::string& filePath, const std::string& password);
     
+    // Incremental backups: a manifest of files stored in the object store
+    std::string createIncrementalBackup(const std::vector<std::string>& files, const std::string& manifestPath,
+                                        const std::string& backupType);
+    size_t restoreIncrementalBackup(const std::string& manifestPath, bool validate);
+    bool validateIncrementalBackup(const std::string& manifestPath);
+    std::string latestManifest();
+    
+    // Retention (max_backup_count, max_backup_age_days), then removal of
+    // objects no remaining manifest refers to
+    void cleanupBackups(const std::string& keepPath);
+    
     // Integrity checking
+    bool checkBackupIntegrity(const std::string& backupFilePath);
     std::string calculateSHA256(const std::string& filePath);
     std::string calculateSHA256FromData(const std::vector<uint8_t>& data);
     bool verifyIntegrity(const std::string& filePath, const std::string& expectedHash);
@@ -57,12 +94,14 @@ private:
     bool copyFile(const std::string& source, const std::string& destination);
     std::string generateTimestamp();
     std::string formatFileSize(size_t bytes);
+    size_t workerThreads() const;
     
     // Configuration helpers
     json loadBackupConfig();
     void loadServerConfig();
     void setDefaultConfig();
     std::vector<std::string> getFilesByCategory(const std::string& category);
+    std::vector<std::string> getSelectedFiles(const json& config);     // Partial backups
     std::string getBackupOutputPath(const std::string& backupType, bool encrypted);
     
     // Temporary backup helpers
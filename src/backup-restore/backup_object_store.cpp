@@ -0,0 +1,239 @@
+#include "backup_object_store.h"
+#include "atomic_file.h"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace BackupStream {
+
+namespace {
+
+// Sequential reads over a RandomAccessInput
+class InputSource : public Source {
+public:
+    explicit InputSource(RandomAccessInput& input) : m_input(input) {}
+
+    size_t read(uint8_t* data, size_t length) override {
+        size_t count = m_input.readAt(m_offset, data, length);
+        m_offset += count;
+        return count;
+    }
+
+private:
+    RandomAccessInput& m_input;
+    uint64_t m_offset = 0;
+};
+
+class OutputSink : public Sink {
+public:
+    explicit OutputSink(UhbOutput& output) : m_output(output) {}
+
+    void write(const uint8_t* data, size_t length) override {
+        m_output.write(data, length);
+        m_bytes += length;
+    }
+
+    uint64_t bytes() const { return m_bytes; }
+
+private:
+    UhbOutput& m_output;
+    uint64_t m_bytes = 0;
+};
+
+// Manifests come from disk, so a name is only ever used as a path once it
+// is known to be a hash
+bool isObjectName(const std::string& name) {
+    return name.size() == 64 && name.find_first_not_of("0123456789abcdef") == std::string::npos;
+}
+
+bool syncDirectory(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    bool synced = ::fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+}
+
+} // namespace
+
+ObjectStore::ObjectStore(const std::string& root, int compressionLevel)
+    : m_root(root), m_compressionLevel(compressionLevel) {
+    std::filesystem::create_directories(m_root + "/objects");
+}
+
+std::string ObjectStore::objectPath(const std::string& sha256) const {
+    if (!isObjectName(sha256)) {
+        throw std::runtime_error("Invalid backup object name: " + sha256);
+    }
+    return m_root + "/objects/" + sha256.substr(0, 2) + "/" + sha256;
+}
+
+bool ObjectStore::put(const std::string& path, Stored& stored) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info{};
+    if (::fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    // Compressed aside while hashed, so the object is named after exactly
+    // the bytes it holds even if the file changes meanwhile
+    static std::atomic<uint64_t> sequence{0};
+    std::string temporary = m_root + "/objects/tmp-" + std::to_string(::getpid()) + "-" + std::to_string(sequence++);
+    Sha256 hash;
+    uint64_t size = 0;
+    uint64_t compressedSize = 0;
+    try {
+        FileOutput file(temporary);
+        OutputSink sink(file);
+        GzipWriter gzip(sink, m_compressionLevel);
+        std::vector<uint8_t> buffer(BUFFER_SIZE);
+        for (;;) {
+            ssize_t count = ::read(fd, buffer.data(), buffer.size());
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count < 0) {
+                throw std::runtime_error("Failed to read " + path + ": " + std::strerror(errno));
+            }
+            if (count == 0) {
+                break;
+            }
+            hash.update(buffer.data(), static_cast<size_t>(count));
+            gzip.write(buffer.data(), static_cast<size_t>(count));
+            size += static_cast<uint64_t>(count);
+        }
+        gzip.finish();
+        file.commit();
+        compressedSize = sink.bytes();
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+
+    stored.sha256 = hash.hexDigest();
+    stored.size = size;
+    stored.storedBytes = 0;
+
+    std::string target = objectPath(stored.sha256);
+    if (std::filesystem::exists(target)) {
+        ::unlink(temporary.c_str());
+        return true;
+    }
+    std::string directory = std::filesystem::path(target).parent_path().string();
+    if (std::filesystem::create_directory(directory)) {
+        m_unsynced.insert(m_root + "/objects");
+    }
+    if (::rename(temporary.c_str(), target.c_str()) != 0) {
+        int error = errno;
+        ::unlink(temporary.c_str());
+        throw std::runtime_error("Failed to store " + path + ": " + std::strerror(error));
+    }
+    m_unsynced.insert(directory);
+    stored.storedBytes = compressedSize;
+    return true;
+}
+
+bool ObjectStore::contains(const std::string& sha256) const {
+    return isObjectName(sha256) && std::filesystem::exists(objectPath(sha256));
+}
+
+bool ObjectStore::verify(const std::string& sha256) const {
+    try {
+        if (!contains(sha256)) {
+            return false;
+        }
+        FileInput file(objectPath(sha256));
+        InputSource input(file);
+        GzipReader gzip(input);
+        Sha256 hash;
+        std::vector<uint8_t> buffer(BUFFER_SIZE);
+        while (size_t count = gzip.read(buffer.data(), buffer.size())) {
+            hash.update(buffer.data(), count);
+        }
+        return hash.hexDigest() == sha256;
+    } catch (const std::exception& e) {
+        std::cout << "[BACKUP-STORE] Object " << sha256 << " is unreadable: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+void ObjectStore::restore(const std::string& sha256, const std::string& path, uint64_t size, uint32_t mode,
+                          int64_t mtime) const {
+    FileInput file(objectPath(sha256));
+    InputSource input(file);
+    GzipReader gzip(input);
+    restoreFile(gzip, path, size, mode, mtime);
+}
+
+void ObjectStore::sync() {
+    for (const auto& directory : m_unsynced) {
+        if (!syncDirectory(directory)) {
+            throw std::runtime_error("Failed to sync " + directory + ": " + std::strerror(errno));
+        }
+    }
+    m_unsynced.clear();
+}
+
+void ObjectStore::writeManifest(const std::string& path, const json& manifest) {
+    sync();
+    std::string error;
+    if (!AtomicFile::write(path, manifest.dump(), error)) {
+        throw std::runtime_error("Failed to write backup manifest: " + error);
+    }
+}
+
+json ObjectStore::readManifest(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Failed to open backup manifest: " + path);
+    }
+    json manifest = json::parse(file);
+    if (manifest.value("format", "") != "manifest" || !manifest.contains("files") || !manifest["files"].is_array()) {
+        throw std::runtime_error("Not a backup manifest: " + path);
+    }
+    return manifest;
+}
+
+size_t ObjectStore::collect(const std::map<std::string, size_t>& references, uint64_t& freedBytes) {
+    size_t removed = 0;
+    std::error_code ec;
+
+    for (const auto& directory : std::filesystem::directory_iterator(m_root + "/objects", ec)) {
+        if (!directory.is_directory()) {
+            if (directory.path().filename().string().starts_with("tmp-")) {
+                std::filesystem::remove(directory.path(), ec);
+            }
+            continue;
+        }
+        for (const auto& object : std::filesystem::directory_iterator(directory.path(), ec)) {
+            std::string name = object.path().filename().string();
+            if (references.count(name) > 0) {
+                continue;
+            }
+            std::error_code sizeError;
+            uint64_t size = object.file_size(sizeError);
+            if (std::filesystem::remove(object.path(), ec)) {
+                freedBytes += sizeError ? 0 : size;
+                removed++;
+            }
+        }
+    }
+    return removed;
+}
+
+} // namespace BackupStream
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "backup_stream.h"
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+
+/**
+ * Content-addressed file store behind incremental backups.
+ *
+ * Every file archived by an incremental backup is stored once, gzip
+ * compressed, under the SHA-256 of its contents (objects/ab/abcdef...); the
+ * backup itself is a .uhm manifest listing the files it holds and the
+ * object each one refers to. Unchanged files are shared by every manifest
+ * that lists them, so a routine backup only adds the files that changed.
+ * Objects no manifest refers to any more are removed by collect().
+ */
+namespace BackupStream {
+
+class ObjectStore {
+public:
+    struct Stored {
+        std::string sha256;
+        uint64_t size = 0;              // Of the contents
+        uint64_t storedBytes = 0;       // Added to the store; 0 when already there
+    };
+
+    ObjectStore(const std::string& root, int compressionLevel);
+
+    // Store the contents of a regular file; false (and nothing stored) when
+    // it cannot be read
+    bool put(const std::string& path, Stored& stored);
+    bool contains(const std::string& sha256) const;
+
+    // Inflate the object and check that it hashes to its name
+    bool verify(const std::string& sha256) const;
+
+    // Write the contents of an object to path as restoreFile() does
+    void restore(const std::string& sha256, const std::string& path, uint64_t size, uint32_t mode,
+                 int64_t mtime) const;
+
+    // Write a manifest once the objects added since the last call are
+    // durable, so it never refers to an object a crash could lose
+    void writeManifest(const std::string& path, const json& manifest);
+    static json readManifest(const std::string& path);
+
+    // Remove the objects with no references, and leftovers of interrupted
+    // puts; returns the number removed and adds the bytes freed
+    size_t collect(const std::map<std::string, size_t>& references, uint64_t& freedBytes);
+
+private:
+    void sync();
+    std::string objectPath(const std::string& sha256) const;
+
+    std::string m_root;
+    int m_compressionLevel;
+    std::set<std::string> m_unsynced;   // Directories with new entries
+};
+
+} // namespace BackupStream
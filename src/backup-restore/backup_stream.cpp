@@ -0,0 +1,860 @@
+#include "backup_stream.h"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace BackupStream {
+
+namespace {
+
+constexpr size_t BLOCK_SIZE = 512;
+
+// ustar header layout (POSIX.1-1988)
+struct TarHeader {
+    char name[100];
+    char mode[8];
+    char uid[8];
+    char gid[8];
+    char size[12];
+    char mtime[12];
+    char checksum[8];
+    char type;
+    char linkname[100];
+    char magic[6];
+    char version[2];
+    char uname[32];
+    char gname[32];
+    char devmajor[8];
+    char devminor[8];
+    char prefix[155];
+    char padding[12];
+};
+static_assert(sizeof(TarHeader) == BLOCK_SIZE, "tar header must be one block");
+
+std::runtime_error systemError(const std::string& what) {
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+void writeAll(int fd, const uint8_t* data, size_t length, const std::string& path) {
+    while (length > 0) {
+        ssize_t written = ::write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            throw systemError("Failed to write " + path);
+        }
+        data += written;
+        length -= static_cast<size_t>(written);
+    }
+}
+
+void readExact(Source& input, uint8_t* data, size_t length) {
+    while (length > 0) {
+        size_t count = input.read(data, length);
+        if (count == 0) {
+            throw std::runtime_error("Backup archive is truncated");
+        }
+        data += count;
+        length -= count;
+    }
+}
+
+// Octal, NUL terminated, as wide as the field allows
+void putOctal(char* field, size_t width, uint64_t value) {
+    std::memset(field, '0', width - 1);
+    field[width - 1] = '\0';
+    for (size_t i = width - 1; i-- > 0 && value > 0; value >>= 3) {
+        field[i] = static_cast<char>('0' + (value & 7));
+    }
+}
+
+// Octal, or GNU base-256 when the top bit of the first byte is set
+uint64_t getNumber(const char* field, size_t width) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(field);
+    uint64_t value = 0;
+    if (bytes[0] & 0x80) {
+        value = bytes[0] & 0x3f;
+        for (size_t i = 1; i < width; ++i) {
+            value = (value << 8) | bytes[i];
+        }
+        return value;
+    }
+    size_t i = 0;
+    while (i < width && (field[i] == ' ' || field[i] == '\0')) ++i;
+    for (; i < width && field[i] >= '0' && field[i] <= '7'; ++i) {
+        value = (value << 3) | static_cast<uint64_t>(field[i] - '0');
+    }
+    return value;
+}
+
+std::string getString(const char* field, size_t width) {
+    return std::string(field, strnlen(field, width));
+}
+
+// Sum of the header bytes with the checksum field as spaces; some old tars
+// summed signed chars, which readers accept too
+uint32_t headerChecksum(const TarHeader& header, bool signedBytes = false) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&header);
+    int64_t sum = 0;
+    for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+        bool inChecksum = i >= offsetof(TarHeader, checksum) && i < offsetof(TarHeader, checksum) + 8;
+        sum += inChecksum ? ' ' : (signedBytes ? static_cast<int8_t>(bytes[i]) : bytes[i]);
+    }
+    return static_cast<uint32_t>(sum);
+}
+
+uint64_t paddingFor(uint64_t size) {
+    return (BLOCK_SIZE - size % BLOCK_SIZE) % BLOCK_SIZE;
+}
+
+} // namespace
+
+// ==================== Sha256 ====================
+
+Sha256::Sha256() : m_context(EVP_MD_CTX_new()) {
+    if (!m_context || EVP_DigestInit_ex(m_context, EVP_sha256(), nullptr) != 1) {
+        throw std::runtime_error("Failed to initialize SHA-256");
+    }
+}
+
+Sha256::~Sha256() {
+    EVP_MD_CTX_free(m_context);
+}
+
+void Sha256::update(const uint8_t* data, size_t length) {
+    EVP_DigestUpdate(m_context, data, length);
+}
+
+std::string Sha256::hexDigest() {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int length = 0;
+    EVP_DigestFinal_ex(m_context, digest, &length);
+
+    std::stringstream ss;
+    for (unsigned int i = 0; i < length; i++) {
+        ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(digest[i]);
+    }
+    return ss.str();
+}
+
+// ==================== FileOutput ====================
+
+FileOutput::FileOutput(const std::string& path) : m_path(path) {
+    m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (m_fd < 0) {
+        throw systemError("Failed to create output file: " + path);
+    }
+    m_buffer.reserve(BUFFER_SIZE);
+}
+
+FileOutput::~FileOutput() {
+    abandon();
+}
+
+void FileOutput::write(const uint8_t* data, size_t length) {
+    while (length > 0) {
+        size_t count = std::min(length, BUFFER_SIZE - m_buffer.size());
+        m_buffer.insert(m_buffer.end(), data, data + count);
+        data += count;
+        length -= count;
+        if (m_buffer.size() == BUFFER_SIZE) {
+            flushBuffer();
+        }
+    }
+}
+
+void FileOutput::flushBuffer() {
+    writeAll(m_fd, m_buffer.data(), m_buffer.size(), m_path);
+    m_buffer.clear();
+}
+
+void FileOutput::patch(const uint8_t* data, size_t length) {
+    flushBuffer();
+    if (::pwrite(m_fd, data, length, 0) != static_cast<ssize_t>(length)) {
+        throw systemError("Failed to write backup header to " + m_path);
+    }
+}
+
+void FileOutput::commit() {
+    flushBuffer();
+    if (::fdatasync(m_fd) != 0) {
+        throw systemError("Failed to sync " + m_path);
+    }
+    ::close(m_fd);
+    m_fd = -1;
+}
+
+void FileOutput::abandon() {
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+        ::unlink(m_path.c_str());
+    }
+}
+
+// ==================== UhbWriter ====================
+
+UhbWriter::UhbWriter(const std::string& path) : UhbWriter(std::make_unique<FileOutput>(path)) {
+}
+
+UhbWriter::UhbWriter(std::unique_ptr<UhbOutput> output) : m_output(std::move(output)) {
+    // Zeros until the end, so an interrupted backup never looks valid
+    std::vector<uint8_t> header(UHB_HEADER_SIZE, 0);
+    m_output->write(header.data(), header.size());
+}
+
+void UhbWriter::write(const uint8_t* data, size_t length) {
+    m_hash.update(data, length);
+    m_payloadSize += length;
+    m_output->write(data, length);
+}
+
+void UhbWriter::complete(json metadata) {
+    metadata["sha256"] = m_hash.hexDigest();
+    metadata["compressed_size"] = m_payloadSize;
+    std::string text = metadata.dump();
+    if (text.size() >= UHB_HEADER_SIZE) {
+        throw std::runtime_error("Backup metadata does not fit in the header");
+    }
+    std::vector<uint8_t> header(UHB_HEADER_SIZE, 0);
+    std::copy(text.begin(), text.end(), header.begin());
+    m_output->patch(header.data(), header.size());
+    m_output->commit();
+}
+
+void UhbWriter::abandon() {
+    m_output->abandon();
+}
+
+// ==================== GzipWriter ====================
+
+GzipWriter::GzipWriter(Sink& output, int level) : m_output(output), m_buffer(BUFFER_SIZE) {
+    if (level < Z_NO_COMPRESSION || level > Z_BEST_COMPRESSION) {
+        level = Z_DEFAULT_COMPRESSION;
+    }
+    // 16 + 15: gzip wrapper, 32 KB window
+    if (deflateInit2(&m_stream, level, Z_DEFLATED, 16 + 15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw std::runtime_error("Failed to initialize deflate");
+    }
+}
+
+GzipWriter::~GzipWriter() {
+    deflateEnd(&m_stream);
+}
+
+void GzipWriter::write(const uint8_t* data, size_t length) {
+    m_stream.next_in = const_cast<Bytef*>(data);
+    m_stream.avail_in = static_cast<uInt>(length);
+    deflateInto(Z_NO_FLUSH);
+}
+
+void GzipWriter::finish() {
+    if (m_finished) {
+        return;
+    }
+    m_stream.next_in = nullptr;
+    m_stream.avail_in = 0;
+    deflateInto(Z_FINISH);
+    m_finished = true;
+}
+
+void GzipWriter::deflateInto(int flush) {
+    int result;
+    do {
+        m_stream.next_out = m_buffer.data();
+        m_stream.avail_out = static_cast<uInt>(m_buffer.size());
+        result = deflate(&m_stream, flush);
+        if (result == Z_STREAM_ERROR) {
+            throw std::runtime_error("Compression failed");
+        }
+        size_t produced = m_buffer.size() - m_stream.avail_out;
+        if (produced > 0) {
+            m_output.write(m_buffer.data(), produced);
+        }
+    } while (m_stream.avail_out == 0 || (flush == Z_FINISH && result != Z_STREAM_END));
+}
+
+// ==================== ParallelGzipWriter ====================
+
+ParallelGzipWriter::ParallelGzipWriter(Sink& output, int level, size_t threads)
+    : m_output(output), m_level(level), m_crc(crc32(0L, Z_NULL, 0)) {
+    if (m_level < Z_NO_COMPRESSION || m_level > Z_BEST_COMPRESSION) {
+        m_level = Z_DEFAULT_COMPRESSION;
+    }
+    threads = std::max<size_t>(threads, 1);
+    m_maxInFlight = 2 * threads;
+    m_chunk.reserve(CHUNK_SIZE);
+
+    // The header zlib writes: no name, no time, OS Unix
+    uint8_t header[10] = {0x1f, 0x8b, Z_DEFLATED, 0, 0, 0, 0, 0,
+                          static_cast<uint8_t>(m_level == Z_BEST_COMPRESSION ? 2 : m_level == Z_BEST_SPEED ? 4 : 0),
+                          3};
+    m_output.write(header, sizeof(header));
+
+    for (size_t i = 0; i < threads; ++i) {
+        m_workers.emplace_back(&ParallelGzipWriter::workerLoop, this);
+    }
+}
+
+ParallelGzipWriter::~ParallelGzipWriter() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_workAvailable.notify_all();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+}
+
+void ParallelGzipWriter::write(const uint8_t* data, size_t length) {
+    while (length > 0) {
+        size_t count = std::min(length, CHUNK_SIZE - m_chunk.size());
+        m_chunk.insert(m_chunk.end(), data, data + count);
+        data += count;
+        length -= count;
+        if (m_chunk.size() == CHUNK_SIZE) {
+            submit(false);
+        }
+    }
+}
+
+void ParallelGzipWriter::finish() {
+    if (m_finished) {
+        return;
+    }
+    submit(true);
+    while (!m_inFlight.empty()) {
+        writeOldest();
+    }
+
+    uint8_t trailer[8];
+    for (int i = 0; i < 4; ++i) {
+        trailer[i] = static_cast<uint8_t>(m_crc >> (8 * i));
+        trailer[4 + i] = static_cast<uint8_t>(m_length >> (8 * i));    // Length mod 2^32
+    }
+    m_output.write(trailer, sizeof(trailer));
+    m_finished = true;
+}
+
+void ParallelGzipWriter::submit(bool last) {
+    while (m_inFlight.size() >= m_maxInFlight) {
+        writeOldest();
+    }
+
+    auto chunk = std::make_shared<Chunk>();
+    chunk->dictionary = m_dictionary;
+    chunk->last = last;
+    chunk->input.swap(m_chunk);
+    m_chunk.reserve(CHUNK_SIZE);
+
+    // The next chunk's dictionary: the last 32 KB of input so far
+    const auto& input = chunk->input;
+    if (input.size() >= DICTIONARY_SIZE) {
+        m_dictionary.assign(input.end() - DICTIONARY_SIZE, input.end());
+    } else {
+        m_dictionary.insert(m_dictionary.end(), input.begin(), input.end());
+        if (m_dictionary.size() > DICTIONARY_SIZE) {
+            m_dictionary.erase(m_dictionary.begin(), m_dictionary.end() - DICTIONARY_SIZE);
+        }
+    }
+
+    m_inFlight.push_back(chunk);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(std::move(chunk));
+    }
+    m_workAvailable.notify_one();
+}
+
+void ParallelGzipWriter::writeOldest() {
+    std::shared_ptr<Chunk> chunk = m_inFlight.front();
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_chunkDone.wait(lock, [&chunk] { return chunk->done; });
+    }
+    m_inFlight.pop_front();
+    if (!chunk->error.empty()) {
+        throw std::runtime_error(chunk->error);
+    }
+
+    m_output.write(chunk->output.data(), chunk->output.size());
+    m_crc = crc32_combine(m_crc, chunk->crc, static_cast<z_off_t>(chunk->input.size()));
+    m_length += chunk->input.size();
+}
+
+void ParallelGzipWriter::workerLoop() {
+    for (;;) {
+        std::shared_ptr<Chunk> chunk;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_workAvailable.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+            if (m_stopping) {
+                return;
+            }
+            chunk = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+
+        compress(*chunk);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            chunk->done = true;
+        }
+        m_chunkDone.notify_all();
+    }
+}
+
+void ParallelGzipWriter::compress(Chunk& chunk) const {
+    chunk.crc = crc32(crc32(0L, Z_NULL, 0), chunk.input.data(), static_cast<uInt>(chunk.input.size()));
+
+    // Raw deflate: the gzip header and trailer are written around the chunks
+    z_stream stream{};
+    if (deflateInit2(&stream, m_level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        chunk.error = "Failed to initialize deflate";
+        return;
+    }
+    if (!chunk.dictionary.empty()) {
+        deflateSetDictionary(&stream, chunk.dictionary.data(), static_cast<uInt>(chunk.dictionary.size()));
+    }
+
+    // Room for the worst case plus the empty stored block a sync flush adds
+    chunk.output.resize(deflateBound(&stream, chunk.input.size()) + 16);
+    stream.next_in = chunk.input.data();
+    stream.avail_in = static_cast<uInt>(chunk.input.size());
+    stream.next_out = chunk.output.data();
+    stream.avail_out = static_cast<uInt>(chunk.output.size());
+
+    // A sync flush ends every chunk but the last on a byte boundary without
+    // ending the deflate stream
+    int result = deflate(&stream, chunk.last ? Z_FINISH : Z_SYNC_FLUSH);
+    if (result != (chunk.last ? Z_STREAM_END : Z_OK) || stream.avail_in != 0) {
+        chunk.error = "Compression failed";
+    }
+    chunk.output.resize(chunk.output.size() - stream.avail_out);
+    deflateEnd(&stream);
+}
+
+// ==================== TarWriter ====================
+
+TarWriter::TarWriter(Sink& output) : m_output(output), m_buffer(BUFFER_SIZE) {
+}
+
+void TarWriter::writeHeader(const std::string& name, char type, uint64_t size, uint32_t mode, int64_t mtime) {
+    TarHeader header{};
+
+    // Up to 100 characters go in name; up to 255 split at a '/' into prefix
+    // and name; anything longer is preceded by a GNU long name member
+    std::string shortName = name;
+    std::string prefix;
+    if (name.size() > sizeof(header.name)) {
+        size_t split = name.find('/', name.size() > sizeof(header.name) + 1 ?
+                                          name.size() - sizeof(header.name) - 1 : 0);
+        if (split != std::string::npos && split > 0 && split <= sizeof(header.prefix)) {
+            prefix = name.substr(0, split);
+            shortName = name.substr(split + 1);
+        } else {
+            writeHeader("././@LongLink", 'L', name.size() + 1, 0644, 0);
+            std::vector<uint8_t> longName(name.begin(), name.end());
+            longName.push_back(0);
+            m_output.write(longName.data(), longName.size());
+            pad(longName.size());
+            shortName = name.substr(0, sizeof(header.name));
+        }
+    }
+
+    std::memcpy(header.name, shortName.data(), std::min(shortName.size(), sizeof(header.name)));
+    std::memcpy(header.prefix, prefix.data(), prefix.size());
+    putOctal(header.mode, sizeof(header.mode), mode & 07777);
+    putOctal(header.uid, sizeof(header.uid), 0);
+    putOctal(header.gid, sizeof(header.gid), 0);
+    if (size < (uint64_t{1} << 33)) {
+        putOctal(header.size, sizeof(header.size), size);
+    } else {
+        // GNU base-256 for files of 8 GiB and more
+        for (size_t i = sizeof(header.size); i-- > 1; size >>= 8) {
+            header.size[i] = static_cast<char>(size & 0xff);
+        }
+        header.size[0] = static_cast<char>(0x80);
+    }
+    putOctal(header.mtime, sizeof(header.mtime), static_cast<uint64_t>(std::max<int64_t>(mtime, 0)));
+    header.type = type;
+    std::memcpy(header.magic, "ustar", 6);
+    std::memcpy(header.version, "00", 2);
+
+    putOctal(header.checksum, 7, headerChecksum(header));
+    header.checksum[7] = ' ';
+
+    m_output.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+}
+
+void TarWriter::pad(uint64_t size) {
+    static const uint8_t zeros[BLOCK_SIZE] = {};
+    uint64_t padding = paddingFor(size);
+    if (padding > 0) {
+        m_output.write(zeros, padding);
+    }
+}
+
+bool TarWriter::addFile(const std::string& path, const std::string& name) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info{};
+    if (::fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    // The size in the header is what gets written: a file that shrinks
+    // while being read is padded with zeros, one that grows is cut
+    uint64_t size = static_cast<uint64_t>(info.st_size);
+    writeHeader(name, '0', size, info.st_mode, info.st_mtim.tv_sec);
+    uint64_t remaining = size;
+    while (remaining > 0) {
+        ssize_t count = ::read(fd, m_buffer.data(), std::min<uint64_t>(remaining, m_buffer.size()));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            std::cout << "[BACKUP-STREAM] Warning: " << path << " shrank while being archived" << std::endl;
+            std::fill(m_buffer.begin(), m_buffer.end(), 0);
+            while (remaining > 0) {
+                size_t zeros = std::min<uint64_t>(remaining, m_buffer.size());
+                m_output.write(m_buffer.data(), zeros);
+                remaining -= zeros;
+            }
+            break;
+        }
+        m_output.write(m_buffer.data(), static_cast<size_t>(count));
+        remaining -= static_cast<uint64_t>(count);
+    }
+    ::close(fd);
+    pad(size);
+
+    m_fileCount++;
+    m_inputBytes += size;
+    return true;
+}
+
+void TarWriter::finish() {
+    static const uint8_t zeros[2 * BLOCK_SIZE] = {};
+    m_output.write(zeros, sizeof(zeros));
+    m_output.finish();
+}
+
+// ==================== FileInput ====================
+
+FileInput::FileInput(const std::string& path) : m_path(path) {
+    m_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info{};
+    if (m_fd < 0 || ::fstat(m_fd, &info) != 0) {
+        auto error = systemError("Failed to open backup file " + path);
+        if (m_fd >= 0) {
+            ::close(m_fd);
+        }
+        throw error;
+    }
+    m_size = static_cast<uint64_t>(info.st_size);
+    ::posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
+FileInput::~FileInput() {
+    ::close(m_fd);
+}
+
+size_t FileInput::readAt(uint64_t offset, uint8_t* data, size_t length) {
+    for (;;) {
+        ssize_t count = ::pread(m_fd, data, length, static_cast<off_t>(offset));
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            throw systemError("Failed to read " + m_path);
+        }
+        return static_cast<size_t>(count);
+    }
+}
+
+// ==================== UhbReader ====================
+
+UhbReader::UhbReader(const std::string& path) : UhbReader(std::make_unique<FileInput>(path)) {
+}
+
+UhbReader::UhbReader(std::unique_ptr<RandomAccessInput> input) : m_input(std::move(input)) {
+    char header[UHB_HEADER_SIZE];
+    size_t got = 0;
+    while (got < sizeof(header)) {
+        size_t count = m_input->readAt(got, reinterpret_cast<uint8_t*>(header) + got, sizeof(header) - got);
+        if (count == 0) {
+            throw std::runtime_error("Backup file is too short");
+        }
+        got += count;
+    }
+    try {
+        m_metadata = json::parse(std::string(header, strnlen(header, sizeof(header))));
+    } catch (const std::exception& e) {
+        throw std::runtime_error(std::string("Invalid backup header: ") + e.what());
+    }
+}
+
+size_t UhbReader::read(uint8_t* data, size_t length) {
+    size_t count = m_input->readAt(m_offset, data, length);
+    m_offset += count;
+    return count;
+}
+
+bool UhbReader::verify() {
+    Sha256 hash;
+    std::vector<uint8_t> buffer(BUFFER_SIZE);
+    uint64_t offset = UHB_HEADER_SIZE;
+    for (;;) {
+        size_t count = m_input->readAt(offset, buffer.data(), buffer.size());
+        if (count == 0) {
+            break;
+        }
+        hash.update(buffer.data(), count);
+        offset += count;
+    }
+    return hash.hexDigest() == m_metadata.value("sha256", "");
+}
+
+// ==================== GzipReader ====================
+
+GzipReader::GzipReader(Source& input) : m_input(input), m_buffer(BUFFER_SIZE) {
+    // 32 + 15: detect gzip or zlib, 32 KB window
+    if (inflateInit2(&m_stream, 32 + 15) != Z_OK) {
+        throw std::runtime_error("Failed to initialize inflate");
+    }
+}
+
+GzipReader::~GzipReader() {
+    inflateEnd(&m_stream);
+}
+
+size_t GzipReader::read(uint8_t* data, size_t length) {
+    m_stream.next_out = data;
+    m_stream.avail_out = static_cast<uInt>(length);
+
+    while (m_stream.avail_out > 0 && !m_streamEnded) {
+        if (m_stream.avail_in == 0 && !m_inputDone) {
+            size_t count = m_input.read(m_buffer.data(), m_buffer.size());
+            m_stream.next_in = m_buffer.data();
+            m_stream.avail_in = static_cast<uInt>(count);
+            m_inputDone = count == 0;
+        }
+
+        int result = inflate(&m_stream, Z_NO_FLUSH);
+        if (result == Z_STREAM_END) {
+            // Another gzip member may follow
+            if (m_stream.avail_in == 0 && !m_inputDone) {
+                size_t count = m_input.read(m_buffer.data(), m_buffer.size());
+                m_stream.next_in = m_buffer.data();
+                m_stream.avail_in = static_cast<uInt>(count);
+                m_inputDone = count == 0;
+            }
+            if (m_stream.avail_in == 0) {
+                m_streamEnded = true;
+            } else {
+                inflateReset(&m_stream);
+            }
+        } else if (result == Z_BUF_ERROR && m_inputDone && m_stream.avail_in == 0) {
+            throw std::runtime_error("Compressed backup data is truncated");
+        } else if (result != Z_OK && result != Z_BUF_ERROR) {
+            throw std::runtime_error(std::string("Failed to decompress backup: ") +
+                                     (m_stream.msg ? m_stream.msg : "error " + std::to_string(result)));
+        }
+    }
+    return length - m_stream.avail_out;
+}
+
+// ==================== Restoring files ====================
+
+std::string restorePath(const std::string& root, const std::string& name) {
+    std::filesystem::path relative;
+    for (const auto& part : std::filesystem::path(name)) {
+        std::string component = part.string();
+        if (component.empty() || component == "/" || component == ".") {
+            continue;
+        }
+        if (component == "..") {
+            throw std::runtime_error("Backup member escapes the restore directory: " + name);
+        }
+        relative /= part;
+    }
+    if (relative.empty()) {
+        return "";
+    }
+    return (std::filesystem::path(root) / relative).string();
+}
+
+void restoreFile(Source& input, const std::string& path, uint64_t size, uint32_t mode, int64_t mtime) {
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+
+    // Written aside and renamed, so a failed restore leaves the old file
+    std::string temporary = path + ".restore-tmp";
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        throw systemError("Failed to create " + temporary);
+    }
+    try {
+        std::vector<uint8_t> buffer(BUFFER_SIZE);
+        uint64_t remaining = size;
+        while (remaining > 0) {
+            size_t count = std::min<uint64_t>(remaining, buffer.size());
+            readExact(input, buffer.data(), count);
+            writeAll(fd, buffer.data(), count, temporary);
+            remaining -= count;
+        }
+        ::fchmod(fd, (mode & 07777) ? (mode & 07777) : 0644);
+        struct timespec times[2] = {{0, UTIME_OMIT}, {static_cast<time_t>(mtime), 0}};
+        ::futimens(fd, times);
+        if (::fdatasync(fd) != 0) {
+            throw systemError("Failed to sync " + temporary);
+        }
+        ::close(fd);
+        fd = -1;
+        if (::rename(temporary.c_str(), path.c_str()) != 0) {
+            throw systemError("Failed to replace " + path);
+        }
+    } catch (...) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        ::unlink(temporary.c_str());
+        throw;
+    }
+}
+
+// ==================== TarExtractor ====================
+
+TarExtractor::TarExtractor(Source& input, const std::string& root)
+    : m_input(input), m_root(root), m_buffer(BUFFER_SIZE) {
+}
+
+void TarExtractor::readExact(uint8_t* data, size_t length) {
+    BackupStream::readExact(m_input, data, length);
+}
+
+bool TarExtractor::readBlock(uint8_t* block) {
+    size_t count = m_input.read(block, BLOCK_SIZE);
+    if (count == 0) {
+        return false;
+    }
+    readExact(block + count, BLOCK_SIZE - count);
+    return true;
+}
+
+void TarExtractor::skip(uint64_t size) {
+    while (size > 0) {
+        size_t count = std::min<uint64_t>(size, m_buffer.size());
+        readExact(m_buffer.data(), count);
+        size -= count;
+    }
+}
+
+std::string TarExtractor::readMetadata(uint64_t size) {
+    if (size > MAX_METADATA_SIZE) {
+        throw std::runtime_error("Backup archive has an oversized header member (" + std::to_string(size) + " bytes)");
+    }
+    std::string text(static_cast<size_t>(size), '\0');
+    readExact(reinterpret_cast<uint8_t*>(text.data()), text.size());
+    skip(paddingFor(size));
+    return text;
+}
+
+size_t TarExtractor::extract() {
+    size_t restored = 0;
+    std::string longName;
+    TarHeader header;
+    auto* block = reinterpret_cast<uint8_t*>(&header);
+
+    while (readBlock(block)) {
+        if (std::all_of(block, block + BLOCK_SIZE, [](uint8_t b) { return b == 0; })) {
+            break;      // End-of-archive
+        }
+        uint64_t checksum = getNumber(header.checksum, sizeof(header.checksum));
+        if (checksum != headerChecksum(header) && checksum != headerChecksum(header, true)) {
+            throw std::runtime_error("Backup archive header is corrupted");
+        }
+
+        uint64_t size = getNumber(header.size, sizeof(header.size));
+        std::string name = getString(header.name, sizeof(header.name));
+        if (std::memcmp(header.magic, "ustar", 6) == 0 && header.prefix[0] != '\0') {
+            name = getString(header.prefix, sizeof(header.prefix)) + "/" + name;
+        }
+        if (!longName.empty()) {
+            name = longName;
+            longName.clear();
+        }
+
+        switch (header.type) {
+            case 'L': {     // GNU long name for the next member
+                longName = readMetadata(size);
+                longName.erase(std::find(longName.begin(), longName.end(), '\0'), longName.end());
+                continue;
+            }
+            case 'x': {     // POSIX extended header: only the path matters here
+                std::string records = readMetadata(size);
+                size_t position = 0;
+                while (position < records.size()) {
+                    // "<length> <key>=<value>\n", length counting the whole record
+                    size_t space = records.find(' ', position);
+                    size_t length = 0;
+                    const char* first = records.data() + position;
+                    const char* last = records.data() + (space == std::string::npos ? position : space);
+                    auto [end, status] = std::from_chars(first, last, length);
+                    if (space == std::string::npos || status != std::errc() || end != last ||
+                        length < space - position + 2 || length > records.size() - position) {
+                        throw std::runtime_error("Malformed extended header for " + name);
+                    }
+                    std::string record = records.substr(space + 1, position + length - space - 2);
+                    if (record.starts_with("path=")) {
+                        longName = record.substr(5);
+                    }
+                    position += length;
+                }
+                continue;
+            }
+            case '0':
+            case '\0':
+            case '7': {
+                std::string path = restorePath(m_root, name);
+                if (path.empty()) {
+                    skip(size + paddingFor(size));
+                    continue;
+                }
+                restoreFile(m_input, path, size, static_cast<uint32_t>(getNumber(header.mode, sizeof(header.mode))),
+                            static_cast<int64_t>(getNumber(header.mtime, sizeof(header.mtime))));
+                skip(paddingFor(size));
+                restored++;
+                continue;
+            }
+            case '5': {
+                std::string path = restorePath(m_root, name);
+                if (!path.empty()) {
+                    std::filesystem::create_directories(path);
+                }
+                skip(size + paddingFor(size));
+                continue;
+            }
+            default:
+                std::cout << "[BACKUP-STREAM] Skipping " << name << " (member type '" << header.type << "')"
+                          << std::endl;
+                skip(size + paddingFor(size));
+                continue;
+        }
+    }
+    return restored;
+}
+
+} // namespace BackupStream
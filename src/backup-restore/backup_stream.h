@@ -0,0 +1,306 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include <openssl/evp.h>
+#include <zlib.h>
+
+using json = nlohmann::json;
+
+/**
+ * Streaming pieces of the .uhb backup format, so that a backup is built and
+ * restored in one pass with bounded buffers instead of through tar, gzip and
+ * intermediate files.
+ *
+ * A .uhb file is a 1024-byte NUL-padded JSON header followed by a gzip
+ * compressed ustar archive; the header holds the SHA-256 and size of the
+ * compressed payload. Writing: TarWriter -> GzipWriter -> UhbWriter.
+ * Reading: UhbReader -> GzipReader -> TarExtractor. Errors throw
+ * std::runtime_error, as in BackupHandler.
+ */
+namespace BackupStream {
+
+constexpr size_t UHB_HEADER_SIZE = 1024;
+constexpr size_t BUFFER_SIZE = 64 * 1024;
+
+class Sink {
+public:
+    virtual ~Sink() = default;
+    virtual void write(const uint8_t* data, size_t length) = 0;
+    // No more data; flush whatever is buffered downstream
+    virtual void finish() {}
+};
+
+class Source {
+public:
+    virtual ~Source() = default;
+    // Up to length bytes; 0 at the end
+    virtual size_t read(uint8_t* data, size_t length) = 0;
+};
+
+// Incremental SHA-256 through EVP
+class Sha256 {
+public:
+    Sha256();
+    ~Sha256();
+    Sha256(const Sha256&) = delete;
+    Sha256& operator=(const Sha256&) = delete;
+
+    void update(const uint8_t* data, size_t length);
+    std::string hexDigest();        // Once, at the end
+
+private:
+    EVP_MD_CTX* m_context;
+};
+
+// Where a .uhb file goes: the payload is written in order and the header,
+// only known at the end, patched over the start
+class UhbOutput {
+public:
+    virtual ~UhbOutput() = default;
+    virtual void write(const uint8_t* data, size_t length) = 0;
+    virtual void patch(const uint8_t* data, size_t length) = 0;
+    // Complete and durable
+    virtual void commit() = 0;
+    // Remove what was written; implementations do this on destruction
+    // unless committed
+    virtual void abandon() = 0;
+};
+
+class FileOutput : public UhbOutput {
+public:
+    explicit FileOutput(const std::string& path);
+    ~FileOutput() override;
+
+    void write(const uint8_t* data, size_t length) override;
+    void patch(const uint8_t* data, size_t length) override;
+    void commit() override;
+    void abandon() override;
+
+private:
+    void flushBuffer();
+
+    std::string m_path;
+    int m_fd = -1;
+    std::vector<uint8_t> m_buffer;
+};
+
+// The .uhb file: header reserved up front and written last, payload hashed
+// as it goes
+class UhbWriter : public Sink {
+public:
+    explicit UhbWriter(const std::string& path);
+    explicit UhbWriter(std::unique_ptr<UhbOutput> output);
+
+    void write(const uint8_t* data, size_t length) override;
+
+    // Add sha256 and compressed_size to the metadata, write the header and
+    // commit the output
+    void complete(json metadata);
+    // Remove a partly written file (also done on destruction unless complete)
+    void abandon();
+
+    uint64_t payloadSize() const { return m_payloadSize; }
+
+private:
+    std::unique_ptr<UhbOutput> m_output;
+    Sha256 m_hash;
+    uint64_t m_payloadSize = 0;
+};
+
+// gzip (RFC 1952) at a zlib compression level
+class GzipWriter : public Sink {
+public:
+    GzipWriter(Sink& output, int level);
+    ~GzipWriter() override;
+
+    void write(const uint8_t* data, size_t length) override;
+    void finish() override;
+
+private:
+    void deflateInto(int flush);
+
+    Sink& m_output;
+    z_stream m_stream{};
+    std::vector<uint8_t> m_buffer;
+    bool m_finished = false;
+};
+
+// The same gzip stream, compressed pigz-style on a pool of threads: input is
+// cut into CHUNK_SIZE pieces, each deflated on its own with the previous
+// 32 KB of input as its dictionary and ended on a byte boundary, so that
+// the pieces concatenate into one ordinary gzip member whose CRC is combined
+// from theirs. Output is written in order from the calling thread, with at
+// most two chunks per thread in flight.
+class ParallelGzipWriter : public Sink {
+public:
+    static constexpr size_t CHUNK_SIZE = 128 * 1024;
+    static constexpr size_t DICTIONARY_SIZE = 32 * 1024;
+
+    ParallelGzipWriter(Sink& output, int level, size_t threads);
+    ~ParallelGzipWriter() override;
+
+    void write(const uint8_t* data, size_t length) override;
+    void finish() override;
+
+private:
+    struct Chunk {
+        std::vector<uint8_t> dictionary;
+        std::vector<uint8_t> input;
+        std::vector<uint8_t> output;
+        bool last = false;
+        uLong crc = 0;
+        bool done = false;
+        std::string error;
+    };
+
+    void submit(bool last);
+    void writeOldest();
+    void workerLoop();
+    void compress(Chunk& chunk) const;
+
+    Sink& m_output;
+    int m_level;
+    std::vector<std::thread> m_workers;
+    size_t m_maxInFlight;
+
+    std::mutex m_mutex;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_chunkDone;
+    std::deque<std::shared_ptr<Chunk>> m_queue;         // Waiting for a worker
+    bool m_stopping = false;
+
+    // Calling thread only
+    std::deque<std::shared_ptr<Chunk>> m_inFlight;      // In stream order, until written
+    std::vector<uint8_t> m_chunk;                       // Being filled
+    std::vector<uint8_t> m_dictionary;                  // Input just before m_chunk
+    uLong m_crc;
+    uint64_t m_length = 0;
+    bool m_finished = false;
+};
+
+// ustar archive members; names longer than ustar allows use GNU long names,
+// as GNU tar did
+class TarWriter {
+public:
+    explicit TarWriter(Sink& output);
+
+    // Stream a regular file into the archive under name; false (and nothing
+    // written) when it cannot be opened
+    bool addFile(const std::string& path, const std::string& name);
+    // End-of-archive blocks, then finish the output
+    void finish();
+
+    size_t fileCount() const { return m_fileCount; }
+    uint64_t inputBytes() const { return m_inputBytes; }
+
+private:
+    void writeHeader(const std::string& name, char type, uint64_t size, uint32_t mode, int64_t mtime);
+    void pad(uint64_t size);
+
+    Sink& m_output;
+    std::vector<uint8_t> m_buffer;
+    size_t m_fileCount = 0;
+    uint64_t m_inputBytes = 0;
+};
+
+// Where a .uhb file is read from
+class RandomAccessInput {
+public:
+    virtual ~RandomAccessInput() = default;
+    virtual uint64_t size() const = 0;
+    // Up to length bytes at offset; 0 at the end
+    virtual size_t readAt(uint64_t offset, uint8_t* data, size_t length) = 0;
+};
+
+class FileInput : public RandomAccessInput {
+public:
+    explicit FileInput(const std::string& path);
+    ~FileInput() override;
+
+    uint64_t size() const override { return m_size; }
+    size_t readAt(uint64_t offset, uint8_t* data, size_t length) override;
+
+private:
+    std::string m_path;
+    int m_fd = -1;
+    uint64_t m_size = 0;
+};
+
+// Payload of a .uhb file
+class UhbReader : public Source {
+public:
+    explicit UhbReader(const std::string& path);
+    explicit UhbReader(std::unique_ptr<RandomAccessInput> input);
+
+    const json& metadata() const { return m_metadata; }
+
+    size_t read(uint8_t* data, size_t length) override;
+
+    // Hash the whole payload (leaving the read position alone) and compare
+    // it with the header
+    bool verify();
+
+private:
+    std::unique_ptr<RandomAccessInput> m_input;
+    json m_metadata;
+    uint64_t m_offset = UHB_HEADER_SIZE;
+};
+
+// Inflates gzip or zlib data, including concatenated gzip members
+class GzipReader : public Source {
+public:
+    explicit GzipReader(Source& input);
+    ~GzipReader() override;
+
+    size_t read(uint8_t* data, size_t length) override;
+
+private:
+    Source& m_input;
+    z_stream m_stream{};
+    std::vector<uint8_t> m_buffer;
+    bool m_inputDone = false;
+    bool m_streamEnded = false;
+};
+
+// Where an archive member named name lands under root ("" for root itself);
+// throws for names that would escape it
+std::string restorePath(const std::string& root, const std::string& name);
+
+// Write the next size bytes of input to path as a restore does: aside,
+// synced, then renamed over the old file, so a failure leaves the old one
+void restoreFile(Source& input, const std::string& path, uint64_t size, uint32_t mode, int64_t mtime);
+
+// Unpacks an archive under a root directory. Regular files and directories
+// are restored (each file is written aside and renamed into place); links
+// and devices are skipped, and names that would escape the root rejected.
+class TarExtractor {
+public:
+    TarExtractor(Source& input, const std::string& root);
+
+    // Number of files restored
+    size_t extract();
+
+private:
+    // Bound on a long-name ('L') or extended header ('x') member, which is
+    // read into memory; real ones are a few hundred bytes
+    static constexpr uint64_t MAX_METADATA_SIZE = 64 * 1024;
+
+    bool readBlock(uint8_t* block);
+    void readExact(uint8_t* data, size_t length);
+    void skip(uint64_t size);
+    std::string readMetadata(uint64_t size);
+
+    Source& m_input;
+    std::string m_root;
+    std::vector<uint8_t> m_buffer;
+};
+
+} // namespace BackupStream
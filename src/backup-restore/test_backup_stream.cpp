@@ -0,0 +1,371 @@
+#include "backup_stream.h"
+#include "backup_encryption.h"
+#include "backup_object_store.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace BackupStream;
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string& description) {
+    std::cout << (condition ? "PASS: " : "FAIL: ") << description << std::endl;
+    if (!condition) {
+        failures++;
+    }
+}
+
+class MemorySink : public Sink {
+public:
+    void write(const uint8_t* data, size_t length) override {
+        bytes.insert(bytes.end(), data, data + length);
+    }
+
+    std::vector<uint8_t> bytes;
+};
+
+class MemorySource : public Source {
+public:
+    explicit MemorySource(const std::vector<uint8_t>& bytes) : m_bytes(bytes) {}
+
+    size_t read(uint8_t* data, size_t length) override {
+        size_t count = std::min(length, m_bytes.size() - m_offset);
+        std::memcpy(data, m_bytes.data() + m_offset, count);
+        m_offset += count;
+        return count;
+    }
+
+private:
+    const std::vector<uint8_t>& m_bytes;
+    size_t m_offset = 0;
+};
+
+std::string readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+void writeFile(const std::string& path, const std::string& contents) {
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << contents;
+}
+
+// Half text, half noise, so compression has work to do on both kinds
+std::string sampleData(size_t size, unsigned seed) {
+    std::mt19937 random(seed);
+    std::string data;
+    data.reserve(size);
+    while (data.size() < size) {
+        if ((data.size() / 4096) % 2 == 0) {
+            data += "line " + std::to_string(data.size()) + " of the sample configuration\n";
+        } else {
+            data += static_cast<char>(random() & 0xff);
+        }
+    }
+    data.resize(size);
+    return data;
+}
+
+std::vector<uint8_t> readAll(Source& source) {
+    std::vector<uint8_t> bytes;
+    std::vector<uint8_t> buffer(BUFFER_SIZE);
+    while (size_t count = source.read(buffer.data(), buffer.size())) {
+        bytes.insert(bytes.end(), buffer.begin(), buffer.begin() + count);
+    }
+    return bytes;
+}
+
+// Whether function throws, with what() containing message when one is given
+template <typename Function>
+bool throws(Function function, const std::string& message = "") {
+    try {
+        function();
+    } catch (const std::exception& e) {
+        return std::string(e.what()).find(message) != std::string::npos;
+    }
+    return false;
+}
+
+// An archive holding one metadata member ('L' or 'x') with the given body
+std::vector<uint8_t> metadataArchive(char type, const std::string& body) {
+    size_t size = body.size();
+    size_t padded = (size + 511) / 512 * 512;
+    std::vector<uint8_t> archive(512 + padded + 2 * 512, 0);
+    char* header = reinterpret_cast<char*>(archive.data());
+    std::strcpy(header, "././@LongLink");
+    std::snprintf(header + 100, 8, "%07o", 0644);
+    std::snprintf(header + 124, 12, "%011llo", static_cast<unsigned long long>(size));
+    header[156] = type;
+    std::memcpy(header + 257, "ustar", 6);
+    std::memset(header + 148, ' ', 8);
+    unsigned sum = 0;
+    for (size_t i = 0; i < 512; ++i) {
+        sum += static_cast<uint8_t>(header[i]);
+    }
+    std::snprintf(header + 148, 8, "%06o", sum);
+    std::memcpy(archive.data() + 512, body.data(), size);
+    return archive;
+}
+
+void testTarRoundTrip(const std::string& dir) {
+    std::cout << "\n--- TarWriter / TarExtractor ---" << std::endl;
+    std::string longName = "deeply/" + std::string(120, 'n') + "/settings.json";
+    std::map<std::string, std::string> files = {
+        {"config/server.json", "{\"port\": 8080}\n"},
+        {"config/empty.json", ""},
+        {"data/large.bin", sampleData(300 * 1024 + 7, 1)},
+        {longName, "long name contents"},
+    };
+    for (const auto& [name, contents] : files) {
+        writeFile(dir + "/source/" + name, contents);
+    }
+
+    MemorySink compressed;
+    {
+        GzipWriter gzip(compressed, 6);
+        TarWriter tar(gzip);
+        for (const auto& [name, contents] : files) {
+            check(tar.addFile(dir + "/source/" + name, name), "archived " + name.substr(0, 40));
+        }
+        check(!tar.addFile(dir + "/source/missing", "missing"), "missing file is skipped");
+        tar.finish();
+        check(tar.fileCount() == files.size(), "file count is recorded");
+    }
+
+    MemorySource input(compressed.bytes);
+    GzipReader gzip(input);
+    TarExtractor extractor(gzip, dir + "/restore");
+    check(extractor.extract() == files.size(), "every file is restored");
+    bool identical = true;
+    for (const auto& [name, contents] : files) {
+        identical = identical && readFile(dir + "/restore/" + name) == contents;
+    }
+    check(identical, "restored files match, including the GNU long name");
+
+    for (char type : {'L', 'x'}) {
+        std::vector<uint8_t> archive = metadataArchive(type, std::string(1024 * 1024, '1'));
+        MemorySource source(archive);
+        TarExtractor oversized(source, dir + "/restore");
+        check(throws([&]() { oversized.extract(); }),
+              std::string("oversized '") + type + "' member is rejected before it is read");
+    }
+
+    {
+        std::vector<uint8_t> archive = metadataArchive('x', "11 path=ab\n20 mtime=1700000000\n");
+        MemorySource source(archive);
+        TarExtractor wellFormed(source, dir + "/restore");
+        check(!throws([&]() { wellFormed.extract(); }), "well-formed extended header is accepted");
+    }
+
+    for (const std::string records : {"12abc path=x\n", "x path=y\n", "99 path=a\n", "4 path=abc\n", "path=abc\n"}) {
+        std::vector<uint8_t> archive = metadataArchive('x', records);
+        MemorySource source(archive);
+        TarExtractor malformed(source, dir + "/restore");
+        check(throws([&]() { malformed.extract(); }, "Malformed extended header"),
+              "malformed extended header record is rejected: " + records.substr(0, records.size() - 1));
+    }
+}
+
+void testRestorePath() {
+    std::cout << "\n--- restorePath ---" << std::endl;
+    check(restorePath("/r", "etc/config.json") == "/r/etc/config.json", "plain name lands under the root");
+    check(restorePath("/r", "/etc/./config.json") == "/r/etc/config.json", "absolute and dot components are dropped");
+    check(restorePath("/r", "./") == "", "root itself maps to an empty path");
+    check(throws([]() { restorePath("/r", "../etc/passwd"); }), "leading .. is rejected");
+    check(throws([]() { restorePath("/r", "etc/../../passwd"); }), "embedded .. is rejected");
+    check(throws([]() { restorePath("/r", "etc/.."); }), "trailing .. is rejected");
+}
+
+void testParallelGzip(const std::string& dir) {
+    std::cout << "\n--- ParallelGzipWriter ---" << std::endl;
+    std::string data = sampleData(ParallelGzipWriter::CHUNK_SIZE * 5 + 12345, 2);
+
+    MemorySink compressed;
+    {
+        ParallelGzipWriter gzip(compressed, 6, 4);
+        // Odd write sizes so chunk boundaries fall inside writes
+        for (size_t offset = 0; offset < data.size(); offset += 10007) {
+            size_t count = std::min<size_t>(10007, data.size() - offset);
+            gzip.write(reinterpret_cast<const uint8_t*>(data.data()) + offset, count);
+        }
+        gzip.finish();
+    }
+
+    MemorySource input(compressed.bytes);
+    GzipReader reader(input);
+    std::vector<uint8_t> decoded = readAll(reader);
+    check(std::string(decoded.begin(), decoded.end()) == data, "GzipReader decodes the parallel stream");
+
+    MemorySink empty;
+    {
+        ParallelGzipWriter gzip(empty, 6, 2);
+        gzip.finish();
+    }
+    MemorySource emptyInput(empty.bytes);
+    GzipReader emptyReader(emptyInput);
+    check(readAll(emptyReader).empty(), "empty input gives a valid empty stream");
+
+    std::string gzPath = dir + "/parallel.gz";
+    writeFile(gzPath, std::string(compressed.bytes.begin(), compressed.bytes.end()));
+    if (std::system("gzip --version > /dev/null 2>&1") != 0) {
+        std::cout << "SKIP: gzip not installed" << std::endl;
+        return;
+    }
+    std::string command = "gzip -t " + gzPath + " && gzip -dc " + gzPath + " > " + dir + "/parallel.out";
+    check(std::system(command.c_str()) == 0, "gzip accepts the stream and its CRC");
+    check(readFile(dir + "/parallel.out") == data, "gzip decodes the parallel stream");
+}
+
+void testEncryption(const std::string& dir) {
+    std::cout << "\n--- EncryptedFileOutput / EncryptedFileInput ---" << std::endl;
+    std::string path = dir + "/backup.uhb.enc";
+    std::string payload = sampleData(BackupEncryption::CHUNK_SIZE * 3 + 100, 3);
+    const uint32_t iterations = 1000;   // The real count only slows the test down
+
+    {
+        UhbWriter writer(std::make_unique<EncryptedFileOutput>(path, "secret", iterations));
+        writer.write(reinterpret_cast<const uint8_t*>(payload.data()), payload.size());
+        writer.complete({{"backup_type", "full"}});
+    }
+    check(BackupEncryption::isContainer(path), "file is a GCM container");
+    check(readFile(path).find("sample configuration") == std::string::npos, "plaintext does not appear in the file");
+
+    {
+        UhbReader reader(std::make_unique<EncryptedFileInput>(path, "secret", 2));
+        check(reader.metadata().value("backup_type", "") == "full", "header decrypts");
+        check(reader.verify(), "payload hash matches");
+        std::vector<uint8_t> decoded = readAll(reader);
+        check(std::string(decoded.begin(), decoded.end()) == payload, "payload decrypts");
+    }
+
+    {
+        // The same plaintext whatever the thread count and the read order
+        EncryptedFileInput serial(path, "secret", 1);
+        EncryptedFileInput parallel(path, "secret", 3);
+        check(std::filesystem::file_size(path) == BackupEncryption::containerSize(serial.size()),
+              "container size follows from the plaintext size");
+        check(parallel.verify(), "every chunk authenticates on the worker pool");
+        bool same = true;
+        std::vector<uint8_t> expected(1000);
+        std::vector<uint8_t> actual(1000);
+        for (uint64_t offset : {uint64_t{0}, 2 * uint64_t{BackupEncryption::CHUNK_SIZE} + 5, uint64_t{17},
+                                uint64_t{BackupEncryption::CHUNK_SIZE} - 3, serial.size() - 1}) {
+            size_t count = serial.readAt(offset, expected.data(), expected.size());
+            same = same && parallel.readAt(offset, actual.data(), actual.size()) == count &&
+                   std::equal(expected.begin(), expected.begin() + count, actual.begin());
+        }
+        check(same, "reads out of order match the serial reader");
+    }
+    check(BackupEncryption::containerSize(0) == BackupEncryption::HEADER_SIZE + BackupEncryption::TAG_SIZE,
+          "empty payload takes one chunk");
+
+    check(throws([&]() { EncryptedFileInput input(path, "wrong"); }), "wrong password is rejected");
+
+    // Chunks are stored as ciphertext followed by their tag
+    const size_t storedChunk = BackupEncryption::CHUNK_SIZE + BackupEncryption::TAG_SIZE;
+    std::string original = readFile(path);
+    std::string tampered = original;
+    tampered[BackupEncryption::HEADER_SIZE + storedChunk + 10] ^= 0x01;     // Inside chunk 1
+    writeFile(path, tampered);
+    {
+        EncryptedFileInput input(path, "secret", 2);
+        check(!input.verify(), "flipped ciphertext bit fails verification");
+        std::vector<uint8_t> buffer(BackupEncryption::CHUNK_SIZE);
+        check(throws([&]() { input.readAt(BackupEncryption::CHUNK_SIZE, buffer.data(), buffer.size()); }),
+              "reading the tampered chunk throws");
+    }
+
+    tampered = original;
+    tampered[20] ^= 0x01;
+    writeFile(path, tampered);
+    check(throws([&]() { EncryptedFileInput input(path, "secret"); }), "altered header is rejected");
+
+    // Dropping the final chunk leaves a file whose new last chunk is not marked last
+    size_t chunks = (original.size() - BackupEncryption::HEADER_SIZE + storedChunk - 1) / storedChunk;
+    writeFile(path, original.substr(0, BackupEncryption::HEADER_SIZE + (chunks - 1) * storedChunk));
+    bool truncatedRejected = throws([&]() {
+        EncryptedFileInput input(path, "secret");
+        if (!input.verify()) {
+            throw std::runtime_error("verification failed");
+        }
+    });
+    check(truncatedRejected, "truncated file is rejected");
+}
+
+void testObjectStore(const std::string& dir) {
+    std::cout << "\n--- ObjectStore ---" << std::endl;
+    std::string root = dir + "/store";
+    ObjectStore store(root, 6);
+
+    writeFile(dir + "/objects/kept.txt", sampleData(20000, 4));
+    writeFile(dir + "/objects/dropped.txt", sampleData(30000, 5));
+    writeFile(dir + "/objects/copy.txt", sampleData(20000, 4));
+
+    ObjectStore::Stored kept;
+    ObjectStore::Stored dropped;
+    ObjectStore::Stored copy;
+    check(store.put(dir + "/objects/kept.txt", kept) && kept.storedBytes > 0, "new object is stored");
+    check(store.put(dir + "/objects/dropped.txt", dropped), "second object is stored");
+    check(store.put(dir + "/objects/copy.txt", copy) && copy.sha256 == kept.sha256 && copy.storedBytes == 0,
+          "identical contents are stored once");
+    check(!store.put(dir + "/objects/missing.txt", copy), "missing file is not stored");
+    check(store.verify(kept.sha256), "stored object verifies");
+
+    store.restore(kept.sha256, dir + "/objects/restored.txt", kept.size, 0644, 0);
+    check(readFile(dir + "/objects/restored.txt") == readFile(dir + "/objects/kept.txt"), "object restores");
+
+    writeFile(root + "/objects/tmp-leftover", "partial");
+    std::map<std::string, size_t> references = {{kept.sha256, 1}};
+    uint64_t freed = 0;
+    size_t removed = store.collect(references, freed);
+    check(removed == 1 && freed > 0, "unreferenced object is collected");
+    check(store.contains(kept.sha256) && !store.contains(dropped.sha256), "referenced object survives collection");
+    check(!std::filesystem::exists(root + "/objects/tmp-leftover"), "interrupted put is cleaned up");
+
+    std::string objectPath = root + "/objects/" + kept.sha256.substr(0, 2) + "/" + kept.sha256;
+    std::string object = readFile(objectPath);
+    object[object.size() / 2] ^= 0x01;
+    writeFile(objectPath, object);
+    check(!store.verify(kept.sha256), "damaged object fails verification");
+}
+
+} // namespace
+
+int main() {
+    std::cout << "Testing the backup stream pipeline..." << std::endl;
+
+    std::string dir = std::filesystem::temp_directory_path().string() + "/test_backup_stream_" + std::to_string(::getpid());
+    std::filesystem::create_directories(dir);
+
+    try {
+        testTarRoundTrip(dir);
+        testRestorePath();
+        testParallelGzip(dir);
+        testEncryption(dir);
+        testObjectStore(dir);
+    } catch (const std::exception& e) {
+        std::cout << "FAIL: unexpected exception: " << e.what() << std::endl;
+        failures++;
+    }
+
+    std::filesystem::remove_all(dir);
+
+    std::cout << "\n" << (failures == 0 ? "All tests passed" : std::to_string(failures) + " test(s) failed") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
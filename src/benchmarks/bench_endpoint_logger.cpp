@@ -0,0 +1,145 @@
+// EndpointLogger benchmark for the UR WebIF API server.
+//
+// Measures the cost an ENDPOINT_LOG call adds to the calling (request)
+// thread, with several threads logging concurrently:
+//   - disabled group: the macro must bail out before building the message
+//   - enabled group:  message is built and queued for the background writer
+//   - synchronous:    the previous behaviour (mutex + std::map filter lookup,
+//                     localtime/put_time and an std::endl flush per line)
+// Log output goes to /dev/null; results are printed on stderr.
+//
+// Usage:
+//   bench_endpoint_logger [threads] [calls_per_thread]
+//   bench_endpoint_logger 8 100000
+
+#include "endpoint_logger.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <map>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+namespace {
+
+// Stand-in for the old synchronous logger
+std::mutex legacy_mutex;
+std::map<std::string, bool> legacy_filters = {{"bench_on", true}, {"bench_off", false}};
+
+void legacyLog(const std::string& group, const std::string& message) {
+    {
+        std::lock_guard<std::mutex> lock(legacy_mutex);
+        auto it = legacy_filters.find(group);
+        if (it != legacy_filters.end() && !it->second) {
+            return;
+        }
+    }
+    auto now = std::chrono::system_clock::now();
+    auto time_t = std::chrono::system_clock::to_time_t(now);
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000;
+    std::ostringstream timestamp;
+    timestamp << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
+    timestamp << "." << std::setfill('0') << std::setw(3) << ms.count();
+    std::cout << "[" << timestamp.str() << "] [" << group << "] " << message << std::endl;
+}
+
+struct Stats {
+    double p50_ns = 0;
+    double p99_ns = 0;
+    double max_ns = 0;
+    double mean_ns = 0;
+};
+
+// Run `call(thread, i)` from several threads, timing every call
+Stats run(int threads, int calls, const std::function<void(int, int)>& call) {
+    std::vector<std::vector<double>> samples(threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            samples[t].reserve(calls);
+            for (int i = 0; i < calls; ++i) {
+                auto start = std::chrono::steady_clock::now();
+                call(t, i);
+                auto end = std::chrono::steady_clock::now();
+                samples[t].push_back(std::chrono::duration<double, std::nano>(end - start).count());
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    std::vector<double> all;
+    for (const auto& s : samples) {
+        all.insert(all.end(), s.begin(), s.end());
+    }
+    std::sort(all.begin(), all.end());
+
+    Stats stats;
+    if (all.empty()) {
+        return stats;
+    }
+    double sum = 0;
+    for (double v : all) {
+        sum += v;
+    }
+    stats.mean_ns = sum / all.size();
+    stats.p50_ns = all[all.size() / 2];
+    stats.p99_ns = all[std::min(all.size() - 1, static_cast<size_t>(all.size() * 0.99))];
+    stats.max_ns = all.back();
+    return stats;
+}
+
+void report(const std::string& name, const Stats& stats) {
+    std::cerr << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(1)
+              << " mean " << std::setw(9) << stats.mean_ns << " ns"
+              << "  p50 " << std::setw(9) << stats.p50_ns << " ns"
+              << "  p99 " << std::setw(9) << stats.p99_ns << " ns"
+              << "  max " << std::setw(11) << stats.max_ns << " ns" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int threads = (argc > 1) ? std::atoi(argv[1]) : 8;
+    int calls = (argc > 2) ? std::atoi(argv[2]) : 100000;
+
+    if (!std::freopen("/dev/null", "w", stdout)) {
+        std::cerr << "Cannot redirect stdout to /dev/null" << std::endl;
+        return 1;
+    }
+
+    std::cerr << "=== UR WebIF EndpointLogger Benchmark ===" << std::endl;
+    std::cerr << "Threads: " << threads << ", calls/thread: " << calls << std::endl;
+
+    EndpointLogger::getInstance().setEndpointFilters({{"bench_on", true}, {"bench_off", false}});
+    std::string payload(120, 'x');
+
+    report("async, disabled group", run(threads, calls, [&](int t, int i) {
+        ENDPOINT_LOG_INFO("bench_off", "thread " + std::to_string(t) + " call " + std::to_string(i) + " " + payload);
+    }));
+
+    report("async, enabled group", run(threads, calls, [&](int t, int i) {
+        ENDPOINT_LOG_INFO("bench_on", "thread " + std::to_string(t) + " call " + std::to_string(i) + " " + payload);
+    }));
+    EndpointLogger::getInstance().flush();
+
+    report("sync (previous), disabled", run(threads, calls, [&](int t, int i) {
+        legacyLog("bench_off", "[INFO] thread " + std::to_string(t) + " call " + std::to_string(i) + " " + payload);
+    }));
+
+    report("sync (previous), enabled", run(threads, calls, [&](int t, int i) {
+        legacyLog("bench_on", "[INFO] thread " + std::to_string(t) + " call " + std::to_string(i) + " " + payload);
+    }));
+
+    std::cerr << "Dropped (ring full): " << EndpointLogger::getInstance().getDroppedCount() << std::endl;
+    return 0;
+}
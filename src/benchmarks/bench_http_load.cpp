@@ -0,0 +1,168 @@
+// HTTP load benchmark for the UR WebIF API server.
+//
+// Spawns N concurrent keep-alive-less clients that each issue M GET requests
+// against a fast endpoint and reports p50/p90/p99/max latency. An optional
+// "slow path" (e.g. /api/backup/create or a DNS lookup endpoint) can be
+// hammered from a background client at the same time to show whether one slow
+// handler stalls every other request (threading_mode "single") or not
+// ("thread_per_connection" / "thread_pool").
+//
+// Usage:
+//   bench_http_load [host] [port] [path] [clients] [requests_per_client] [slow_path]
+//   bench_http_load 127.0.0.1 5000 /api/dashboard/data 16 200 /api/backup/create
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <mutex>
+#include <cstring>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+struct LoadResult {
+    std::vector<double> latencies_ms;
+    int failures = 0;
+};
+
+// Perform a single HTTP/1.1 GET with "Connection: close" and return latency in ms (or -1 on error)
+static double timedRequest(const std::string& host, int port, const std::string& path) {
+    auto start = std::chrono::steady_clock::now();
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1.0;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1 ||
+        connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1.0;
+    }
+
+    std::string request = "GET " + path + " HTTP/1.1\r\nHost: " + host +
+                          "\r\nConnection: close\r\n\r\n";
+    if (send(fd, request.data(), request.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(request.size())) {
+        close(fd);
+        return -1.0;
+    }
+
+    // Drain the full response; the server closes the connection when done
+    char buffer[16384];
+    ssize_t n;
+    bool got_status = false;
+    while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+        if (!got_status && n >= 12 && std::strncmp(buffer, "HTTP/1.", 7) == 0) {
+            got_status = true;
+        }
+    }
+    close(fd);
+
+    if (!got_status) {
+        return -1.0;
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+int main(int argc, char* argv[]) {
+    std::string host = (argc > 1) ? argv[1] : "127.0.0.1";
+    int port = (argc > 2) ? std::atoi(argv[2]) : 5000;
+    std::string path = (argc > 3) ? argv[3] : "/api/dashboard/data";
+    int clients = (argc > 4) ? std::atoi(argv[4]) : 16;
+    int requests_per_client = (argc > 5) ? std::atoi(argv[5]) : 200;
+    std::string slow_path = (argc > 6) ? argv[6] : "";
+
+    std::cout << "=== UR WebIF HTTP Load Benchmark ===" << std::endl;
+    std::cout << "Target: http://" << host << ":" << port << path << std::endl;
+    std::cout << "Clients: " << clients << ", requests/client: " << requests_per_client << std::endl;
+    if (!slow_path.empty()) {
+        std::cout << "Background slow path: " << slow_path << std::endl;
+    }
+
+    std::atomic<bool> done{false};
+    std::atomic<int> slow_requests{0};
+    std::thread slow_client;
+    if (!slow_path.empty()) {
+        slow_client = std::thread([&]() {
+            while (!done) {
+                timedRequest(host, port, slow_path);
+                slow_requests++;
+            }
+        });
+    }
+
+    std::vector<LoadResult> results(clients);
+    std::vector<std::thread> workers;
+    auto bench_start = std::chrono::steady_clock::now();
+
+    for (int c = 0; c < clients; ++c) {
+        workers.emplace_back([&, c]() {
+            results[c].latencies_ms.reserve(requests_per_client);
+            for (int r = 0; r < requests_per_client; ++r) {
+                double latency = timedRequest(host, port, path);
+                if (latency < 0) {
+                    results[c].failures++;
+                } else {
+                    results[c].latencies_ms.push_back(latency);
+                }
+            }
+        });
+    }
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    auto bench_end = std::chrono::steady_clock::now();
+    done = true;
+    if (slow_client.joinable()) {
+        slow_client.join();
+    }
+
+    std::vector<double> all;
+    int failures = 0;
+    for (const auto& result : results) {
+        all.insert(all.end(), result.latencies_ms.begin(), result.latencies_ms.end());
+        failures += result.failures;
+    }
+    std::sort(all.begin(), all.end());
+
+    double elapsed_s = std::chrono::duration<double>(bench_end - bench_start).count();
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "\n--- Results ---" << std::endl;
+    std::cout << "Completed: " << all.size() << ", failed: " << failures << std::endl;
+    std::cout << "Throughput: " << (elapsed_s > 0 ? all.size() / elapsed_s : 0.0) << " req/s" << std::endl;
+    std::cout << "Latency p50: " << percentile(all, 0.50) << " ms" << std::endl;
+    std::cout << "Latency p90: " << percentile(all, 0.90) << " ms" << std::endl;
+    std::cout << "Latency p99: " << percentile(all, 0.99) << " ms" << std::endl;
+    std::cout << "Latency max: " << (all.empty() ? 0.0 : all.back()) << " ms" << std::endl;
+    if (!slow_path.empty()) {
+        std::cout << "Slow requests completed meanwhile: " << slow_requests.load() << std::endl;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,173 @@
+// Multipart parsing benchmark for the UR WebIF API server.
+//
+// Feeds synthetic multipart/form-data bodies (one form field plus one binary
+// file part) through MultipartStreamParser in fixed-size chunks, the way
+// libmicrohttpd delivers an upload, and reports throughput and peak RSS. The
+// body is generated on the fly, so even the 1 GB case never exists in memory.
+// For bodies up to 100 MB the buffered MultipartParser (whole body in a
+// std::string, parts copied out) is measured as well for comparison.
+//
+// Usage:
+//   bench_multipart [chunk_size_bytes] [body_size_mb...]
+//   bench_multipart 65536 1 100 1024
+
+#include "../multipart_parser.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <sys/resource.h>
+
+static const std::string BOUNDARY = "----WebKitFormBoundary7MA4YWxkTrZu0gW";
+
+static long peakRssKb() {
+    struct rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// Produces the body piece by piece: headers, file payload from a repeating
+// random pattern (with near-miss delimiter fragments mixed in), closing boundary
+class BodyGenerator {
+public:
+    explicit BodyGenerator(size_t file_size) : file_size_(file_size), file_sent_(0), stage_(0) {
+        std::mt19937 rng(42);
+        pattern_.resize(1 << 20);
+        for (auto& c : pattern_) {
+            c = static_cast<char>(rng() & 0xff);
+        }
+        const std::string near_miss = "\r\n--" + BOUNDARY.substr(0, BOUNDARY.size() / 2);
+        for (size_t pos = 4096; pos + near_miss.size() < pattern_.size(); pos += 65536) {
+            pattern_.replace(pos, near_miss.size(), near_miss);
+        }
+
+        head_ = "--" + BOUNDARY + "\r\n"
+                "Content-Disposition: form-data; name=\"upload_type\"\r\n\r\n"
+                "firmware\r\n"
+                "--" + BOUNDARY + "\r\n"
+                "Content-Disposition: form-data; name=\"firmware_file\"; filename=\"image.bin\"\r\n"
+                "Content-Type: application/octet-stream\r\n\r\n";
+        tail_ = "\r\n--" + BOUNDARY + "--\r\n";
+    }
+
+    size_t totalSize() const { return head_.size() + file_size_ + tail_.size(); }
+
+    // Fill out with up to max bytes; returns false when the body is exhausted
+    bool next(std::string& out, size_t max) {
+        out.clear();
+        while (out.size() < max) {
+            if (stage_ == 0) {
+                out.append(head_);
+                stage_ = 1;
+            } else if (stage_ == 1) {
+                if (file_sent_ == file_size_) {
+                    stage_ = 2;
+                    continue;
+                }
+                size_t offset = file_sent_ % pattern_.size();
+                size_t n = std::min({max - out.size(), file_size_ - file_sent_, pattern_.size() - offset});
+                out.append(pattern_, offset, n);
+                file_sent_ += n;
+            } else if (stage_ == 2) {
+                out.append(tail_);
+                stage_ = 3;
+            } else {
+                break;
+            }
+        }
+        return !out.empty();
+    }
+
+private:
+    std::string pattern_;
+    std::string head_;
+    std::string tail_;
+    size_t file_size_;
+    size_t file_sent_;
+    int stage_;
+};
+
+static void benchStreaming(size_t file_size, size_t chunk_size) {
+    BodyGenerator generator(file_size);
+    MultipartStreamParser parser(BOUNDARY);
+
+    size_t file_bytes = 0;
+    size_t callbacks = 0;
+    parser.onPartData([&](std::string_view data) {
+        file_bytes += data.size();
+        ++callbacks;
+        return true;
+    });
+
+    std::string chunk;
+    chunk.reserve(chunk_size);
+    double parse_seconds = 0.0;
+    while (generator.next(chunk, chunk_size)) {
+        auto start = std::chrono::steady_clock::now();
+        parser.feed(chunk.data(), chunk.size());
+        parse_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    bool ok = parser.finish() && file_bytes == file_size + std::string("firmware").size();
+
+    double mb = generator.totalSize() / (1024.0 * 1024.0);
+    std::cout << "  streaming: " << std::setw(9) << (parse_seconds * 1000.0) << " ms, "
+              << std::setw(9) << (parse_seconds > 0 ? mb / parse_seconds : 0.0) << " MB/s, "
+              << callbacks << " data callbacks, peak RSS " << peakRssKb() / 1024 << " MB"
+              << (ok ? "" : "  [PARSE MISMATCH]") << std::endl;
+}
+
+static void benchBuffered(size_t file_size, size_t chunk_size) {
+    BodyGenerator generator(file_size);
+    std::string body;
+    body.reserve(generator.totalSize());
+    std::string chunk;
+    while (generator.next(chunk, chunk_size)) {
+        body.append(chunk);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    MultipartParser parser("multipart/form-data; boundary=" + BOUNDARY);
+    bool ok = parser.parse(body) && parser.hasFile("firmware_file") &&
+              parser.getFile("firmware_file")->size == file_size;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double mb = body.size() / (1024.0 * 1024.0);
+    std::cout << "  buffered:  " << std::setw(9) << (seconds * 1000.0) << " ms, "
+              << std::setw(9) << (seconds > 0 ? mb / seconds : 0.0) << " MB/s, peak RSS "
+              << peakRssKb() / 1024 << " MB" << (ok ? "" : "  [PARSE MISMATCH]") << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    size_t chunk_size = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 65536;
+    std::vector<size_t> sizes_mb;
+    for (int i = 2; i < argc; ++i) {
+        sizes_mb.push_back(std::strtoull(argv[i], nullptr, 10));
+    }
+    if (sizes_mb.empty()) {
+        sizes_mb = {1, 100, 1024};
+    }
+
+    std::cout << "=== UR WebIF Multipart Parser Benchmark ===" << std::endl;
+    std::cout << "Chunk size: " << chunk_size << " bytes" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+
+    // Streaming runs first so their peak RSS is not inflated by the buffered runs
+    for (size_t mb : sizes_mb) {
+        std::cout << "\nBody size: " << mb << " MB" << std::endl;
+        benchStreaming(mb * 1024 * 1024, chunk_size);
+    }
+
+    std::cout << "\n--- Buffered MultipartParser (bodies up to 100 MB) ---" << std::endl;
+    for (size_t mb : sizes_mb) {
+        if (mb > 100) {
+            continue;
+        }
+        std::cout << "Body size: " << mb << " MB" << std::endl;
+        benchBuffered(mb * 1024 * 1024, chunk_size);
+    }
+
+    return 0;
+}
@@ -1,7 +1,7 @@
 
 #include "cellular_data_manager.h"
 #include "config_manager.h"
-#include <fstream>
+#include "json_document_store.h"
 #include <iostream>
 #include <filesystem>
 
@@ -22,32 +22,18 @@ void CellularDataManager::initializePaths() {
 
 // Generic file operations
 json CellularDataManager::loadJsonFile(const std::string& filePath) {
-    try {
-        std::ifstream file(filePath);
-        if (file.is_open()) {
-            json data;
-            file >> data;
-            file.close();
-            std::cout << "[CELLULAR-DATA-MGR] Successfully loaded data from " << filePath << std::endl;
-            return data;
-        } else {
-            std::cout << "[CELLULAR-DATA-MGR] File not found: " << filePath << ", creating default" << std::endl;
-            return json::object();
-        }
-    } catch (const std::exception& e) {
-        std::cout << "[CELLULAR-DATA-MGR] Error loading " << filePath << ": " << e.what() << std::endl;
+    json data;
+    if (!JsonDocumentStore::getInstance().read(filePath, data)) {
+        std::cout << "[CELLULAR-DATA-MGR] File not found or invalid: " << filePath << ", creating default" << std::endl;
         return json::object();
     }
+    return data;
 }
 
 bool CellularDataManager::saveJsonFile(const std::string& filePath, const json& data) {
     try {
         ensureDirectoryExists(filePath);
-        std::ofstream file(filePath);
-        if (file.is_open()) {
-            file << data.dump(2);
-            file.close();
-            std::cout << "[CELLULAR-DATA-MGR] Data saved to " << filePath << std::endl;
+        if (JsonDocumentStore::getInstance().write(filePath, data, 2)) {
             return true;
         } else {
             std::cout << "[CELLULAR-DATA-MGR] Error: Could not open " << filePath << " for writing" << std::endl;
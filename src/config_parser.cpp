@@ -61,6 +61,14 @@ bool ConfigParser::parseConfig(const std::string& config_file, ServerConfig& con
             config.connection_timeout = json_config["connection_timeout"];
         }
         
+        if (json_config.contains("threading_mode")) {
+            config.threading_mode = json_config["threading_mode"];
+        }
+        
+        if (json_config.contains("thread_pool_size")) {
+            config.thread_pool_size = json_config["thread_pool_size"];
+        }
+        
         if (json_config.contains("enable_cors")) {
             config.enable_cors = json_config["enable_cors"];
         }
@@ -69,6 +77,14 @@ bool ConfigParser::parseConfig(const std::string& config_file, ServerConfig& con
             config.allowed_origins = json_config["allowed_origins"].get<std::vector<std::string>>();
         }
         
+        if (json_config.contains("cache_control")) {
+            config.cache_control = json_config["cache_control"].get<std::map<std::string, std::string>>();
+        }
+        
+        if (json_config.contains("immutable_fingerprinted_assets")) {
+            config.immutable_fingerprinted_assets = json_config["immutable_fingerprinted_assets"];
+        }
+        
         // Parse WebSocket debugging configuration
         if (json_config.contains("websocket_debug_enabled")) {
             config.websocket_debug_enabled = json_config["websocket_debug_enabled"];
@@ -127,8 +143,12 @@ bool ConfigParser::saveConfig(const std::string& config_file, const ServerConfig
         json_config["ssl_key_file"] = config.ssl_key_file;
         json_config["max_connections"] = config.max_connections;
         json_config["connection_timeout"] = config.connection_timeout;
+        json_config["threading_mode"] = config.threading_mode;
+        json_config["thread_pool_size"] = config.thread_pool_size;
         json_config["enable_cors"] = config.enable_cors;
         json_config["allowed_origins"] = config.allowed_origins;
+        json_config["cache_control"] = config.cache_control;
+        json_config["immutable_fingerprinted_assets"] = config.immutable_fingerprinted_assets;
         
         // Save WebSocket debugging configuration
         json_config["websocket_debug_enabled"] = config.websocket_debug_enabled;
@@ -167,8 +187,15 @@ ServerConfig ConfigParser::getDefaultConfig() {
     config.enable_ssl = false;
     config.max_connections = 1000;
     config.connection_timeout = 30;
+    config.threading_mode = "single";
+    config.thread_pool_size = 4;
     config.enable_cors = true;
     config.allowed_origins = {"*"};
+    config.cache_control = {
+        {"/", "no-cache"},
+        {"/assets/", "public, max-age=300"}
+    };
+    config.immutable_fingerprinted_assets = true;
     
     // Default WebSocket debugging configuration
     config.websocket_debug_enabled = false;
@@ -218,6 +245,19 @@ void ConfigParser::validateConfig(ServerConfig& config) {
         config.connection_timeout = 30;
     }
     
+    // Validate HTTP threading model
+    if (config.threading_mode != "single" &&
+        config.threading_mode != "thread_per_connection" &&
+        config.threading_mode != "thread_pool") {
+        std::cerr << "Warning: Invalid threading_mode '" << config.threading_mode << "', using default single" << std::endl;
+        config.threading_mode = "single";
+    }
+    
+    if (config.thread_pool_size < 1 || config.thread_pool_size > 256) {
+        std::cerr << "Warning: Invalid thread_pool_size " << config.thread_pool_size << ", using default 4" << std::endl;
+        config.thread_pool_size = 4;
+    }
+    
     // Ensure document root is not empty
     if (config.document_root.empty()) {
         config.document_root = "./web";
@@ -1,5 +1,6 @@
 #include "credential_manager.h"
 #include "endpoint_logger.h"
+#include "atomic_file.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -390,13 +391,13 @@ std::string CredentialManager::readFile(const std::string& path) {
 }
 
 bool CredentialManager::writeFile(const std::string& path, const std::string& content) {
-    std::ofstream file(path);
-    if (!file.is_open()) {
+    // Replaced atomically: a power cut must not leave an empty credentials file
+    std::string error;
+    if (!AtomicFile::write(path, content, error)) {
+        std::cout << "[CREDENTIAL-MANAGER] Failed to write " << path << ": " << error << std::endl;
         return false;
     }
-    
-    file << content;
-    return file.good();
+    return true;
 }
 
 // Login attempt tracking methods
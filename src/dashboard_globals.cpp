@@ -1,10 +1,14 @@
 #include "dashboard_globals.h"
 #include "endpoint_logger.h"
+#include "system_metrics_sampler.h"
+#include "event_bus.h"
 #include <nlohmann/json.hpp>
 #include <iomanip>
 #include <sstream>
 #include <iostream>
 #include <algorithm>
+#include <condition_variable>
+#include <thread>
 
 using json = nlohmann::json;
 
@@ -44,6 +48,50 @@ namespace DashboardGlobals {
     static std::chrono::steady_clock::time_point g_network_last_update;
     static std::chrono::steady_clock::time_point g_cellular_last_update;
     
+    // Background updater for network/cellular data, which still shells out.
+    // Request threads only ever flag a refresh and read what is published.
+    static std::thread g_updater_thread;
+    static std::mutex g_updater_mutex;
+    static std::condition_variable g_updater_cv;
+    static bool g_updater_stop = false;
+    static bool g_network_refresh_requested = false;
+    static bool g_cellular_refresh_requested = false;
+    
+    static void updaterLoop() {
+        uint64_t published_sequence = 0;
+        std::unique_lock<std::mutex> lock(g_updater_mutex);
+        while (!g_updater_stop) {
+            g_updater_cv.wait_for(lock, std::chrono::seconds(1));
+            if (g_updater_stop) {
+                break;
+            }
+            bool force_network = g_network_refresh_requested;
+            bool force_cellular = g_cellular_refresh_requested;
+            g_network_refresh_requested = false;
+            g_cellular_refresh_requested = false;
+            bool periodic = g_auto_update_enabled.load();
+            
+            lock.unlock();
+            if (periodic || force_network) {
+                updateNetworkData(force_network);
+            }
+            if (periodic || force_cellular) {
+                updateCellularData(force_cellular);
+            }
+            Internal::updateDataAge();
+            
+            // Push a snapshot to "dashboard" event streams on every new
+            // system sample or forced refresh; nothing is built when nobody listens
+            uint64_t sequence = SystemMetricsSampler::getInstance().snapshot()->sequence;
+            if ((sequence != published_sequence || force_network || force_cellular) &&
+                EventBus::getInstance().hasSubscribers("dashboard")) {
+                EventBus::getInstance().publish("dashboard", getDashboardResponse(true, true));
+                published_sequence = sequence;
+            }
+            lock.lock();
+        }
+    }
+    
     bool initialize(std::shared_ptr<SourcePageDataManager> data_manager) {
         std::lock_guard<std::mutex> lock(g_data_mutex);
         
@@ -59,6 +107,10 @@ namespace DashboardGlobals {
         
         g_data_manager = data_manager;
         
+        // System metrics come from the sampler thread from here on
+        SystemMetricsSampler& sampler = SystemMetricsSampler::getInstance();
+        sampler.start(std::chrono::seconds(g_system_update_interval.load()));
+        
         // Initialize timestamps
         auto now = std::chrono::steady_clock::now();
         g_last_update = now;
@@ -67,12 +119,7 @@ namespace DashboardGlobals {
         g_cellular_last_update = now;
         
         // Set default values immediately (non-blocking initialization)
-        g_system_data.system.cpu_usage_percent = 15;
-        g_system_data.system.cpu_cores = 2;
-        g_system_data.system.cpu_model = "System CPU";
-        g_system_data.system.cpu_temp_celsius = 45;
-        g_system_data.system.ram_usage_percent = 30;
-        g_system_data.system.ram_total_gb = 4.0f;
+        g_system_data.system = sampler.snapshot()->system;
         
         g_system_data.network.internet_connected = true;
         g_system_data.network.internet_status = "Connected";
@@ -84,6 +131,12 @@ namespace DashboardGlobals {
         
         g_system_data.last_update = Internal::timestampToString(now);
         
+        {
+            std::lock_guard<std::mutex> updater_lock(g_updater_mutex);
+            g_updater_stop = false;
+        }
+        g_updater_thread = std::thread(updaterLoop);
+        
         g_data_initialized.store(true);
         ENDPOINT_LOG_INFO("dashboard", "Initialized successfully with default values");
         
@@ -91,6 +144,17 @@ namespace DashboardGlobals {
     }
     
     void shutdown() {
+        // Stop the background threads before tearing down what they use
+        {
+            std::lock_guard<std::mutex> updater_lock(g_updater_mutex);
+            g_updater_stop = true;
+        }
+        g_updater_cv.notify_one();
+        if (g_updater_thread.joinable()) {
+            g_updater_thread.join();
+        }
+        SystemMetricsSampler::getInstance().stop();
+        
         std::lock_guard<std::mutex> lock(g_data_mutex);
         
         g_auto_update_enabled.store(false);
@@ -114,11 +178,11 @@ namespace DashboardGlobals {
             
             // Set default values for all data structures
             g_system_data.system.cpu_usage_percent = 0;
-            g_system_data.system.cpu_cores = 1;
-            g_system_data.system.cpu_model = "Unknown CPU";
-            g_system_data.system.cpu_temp_celsius = 45;
-            g_system_data.system.ram_usage_percent = 0;
-            g_system_data.system.ram_total_gb = 4.0f;
+            g_system_data.system.cpu_cores = -1;
+            g_system_data.system.cpu_model = "";
+            g_system_data.system.cpu_temp_celsius = SystemInfo::TEMPERATURE_UNKNOWN;
+            g_system_data.system.ram_usage_percent = -1;
+            g_system_data.system.ram_total_gb = -1.0f;
             
             g_system_data.network.internet_connected = false;
             g_system_data.network.internet_status = "Unknown";
@@ -149,29 +213,21 @@ namespace DashboardGlobals {
     }
     
     bool updateSystemData(bool force_update) {
-        if (!isDataFresh("system") || force_update) {
-            try {
-                SystemInfo new_system_info = g_data_manager->collectSystemInfo();
-                
-                std::lock_guard<std::mutex> lock(g_data_mutex);
-                g_system_data.system = new_system_info;
-                g_system_last_update = std::chrono::steady_clock::now();
-                
-                ENDPOINT_LOG_INFO("dashboard", "System data updated - CPU: " + std::to_string(new_system_info.cpu_usage_percent) + "%, RAM: " + std::to_string(new_system_info.ram_usage_percent) + "%");
-                return true;
-            } catch (const std::exception& e) {
-                std::cerr << "[DASHBOARD-GLOBALS] Error updating system data: " << e.what() 
-                          << " - Using default values" << std::endl;
-                
-                // Use default values when collection fails
-                std::lock_guard<std::mutex> lock(g_data_mutex);
-                g_system_data.system.cpu_usage_percent = 15;  // Default reasonable values
-                g_system_data.system.ram_usage_percent = 25;
-                g_system_last_update = std::chrono::steady_clock::now();
-                return true;  // Return true since we provided default data
-            }
+        // Never samples on the calling thread: a forced update only asks the
+        // sampler for an early tick, then picks up whatever is published
+        SystemMetricsSampler& sampler = SystemMetricsSampler::getInstance();
+        if (force_update) {
+            sampler.requestSample();
         }
-        return false;
+        
+        std::shared_ptr<const SystemMetricsSampler::Snapshot> snapshot = sampler.snapshot();
+        std::lock_guard<std::mutex> lock(g_data_mutex);
+        if (snapshot->sampled_at == g_system_last_update) {
+            return false;
+        }
+        g_system_data.system = snapshot->system;
+        g_system_last_update = snapshot->sampled_at;
+        return true;
     }
     
     bool updateNetworkData(bool force_update) {
@@ -229,18 +285,29 @@ namespace DashboardGlobals {
     }
     
     SystemStatusData getCurrentData() {
-        std::lock_guard<std::mutex> lock(g_data_mutex);
-        return g_system_data;
+        SystemStatusData data;
+        {
+            std::lock_guard<std::mutex> lock(g_data_mutex);
+            data = g_system_data;
+        }
+        data.system = SystemMetricsSampler::getInstance().snapshot()->system;
+        // Link state is tracked from netlink events, so it is never stale
+        SourcePageDataManager::fillLinkInfo(data.network);
+        return data;
     }
     
     SystemInfo getCurrentSystemInfo() {
-        std::lock_guard<std::mutex> lock(g_data_mutex);
-        return g_system_data.system;
+        return SystemMetricsSampler::getInstance().snapshot()->system;
     }
     
     NetworkInfo getCurrentNetworkInfo() {
-        std::lock_guard<std::mutex> lock(g_data_mutex);
-        return g_system_data.network;
+        NetworkInfo info;
+        {
+            std::lock_guard<std::mutex> lock(g_data_mutex);
+            info = g_system_data.network;
+        }
+        SourcePageDataManager::fillLinkInfo(info);
+        return info;
     }
     
     CellularInfo getCurrentCellularInfo() {
@@ -271,6 +338,9 @@ namespace DashboardGlobals {
         g_network_update_interval.store(std::max(1, network_interval_sec));
         g_cellular_update_interval.store(std::max(1, cellular_interval_sec));
         
+        // The sampler keeps running either way so forced refreshes still work
+        SystemMetricsSampler::getInstance().start(std::chrono::seconds(g_system_update_interval.load()));
+        
         ENDPOINT_LOG_INFO("dashboard", "Auto-update " + std::string(enabled ? "enabled" : "disabled") + " - Intervals: System=" + std::to_string(system_interval_sec) + "s, Network=" + std::to_string(network_interval_sec) + "s, Cellular=" + std::to_string(cellular_interval_sec) + "s");
     }
     
@@ -294,8 +364,11 @@ namespace DashboardGlobals {
         
         if (component == "system") {
             return static_cast<int>(std::chrono::duration_cast<std::chrono::seconds>(
-                now - g_system_last_update).count());
-        } else if (component == "network") {
+                now - SystemMetricsSampler::getInstance().snapshot()->sampled_at).count());
+        }
+        
+        std::lock_guard<std::mutex> lock(g_data_mutex);
+        if (component == "network") {
             return static_cast<int>(std::chrono::duration_cast<std::chrono::seconds>(
                 now - g_network_last_update).count());
         } else if (component == "cellular") {
@@ -344,11 +417,7 @@ namespace DashboardGlobals {
     }
     
     std::string getDashboardResponse(bool include_custom_metrics, bool include_performance) {
-        // Update data if auto-update is enabled
-        if (g_auto_update_enabled.load()) {
-            updateAllData(false);
-        }
-        
+        // Only reads published data; the sampler and updater threads keep it current
         json response;
         
         // Get current data
@@ -359,7 +428,8 @@ namespace DashboardGlobals {
             {"cpu_usage_percent", data.system.cpu_usage_percent},
             {"cpu_cores", data.system.cpu_cores},
             {"cpu_model", data.system.cpu_model},
-            {"cpu_temp_celsius", data.system.cpu_temp_celsius},
+            {"cpu_temp_celsius", data.system.cpu_temp_celsius == SystemInfo::TEMPERATURE_UNKNOWN
+                ? json(nullptr) : json(data.system.cpu_temp_celsius)},
             {"cpu_base_clock_ghz", data.system.cpu_base_clock_ghz},
             {"cpu_boost_clock_ghz", data.system.cpu_boost_clock_ghz},
             {"ram_usage_percent", data.system.ram_usage_percent},
@@ -449,8 +519,29 @@ namespace DashboardGlobals {
         return response.dump();
     }
     
+    void requestRefresh(const std::string& component) {
+        if (component == "system" || component == "all") {
+            SystemMetricsSampler::getInstance().requestSample();
+        }
+        if (component == "system") {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(g_updater_mutex);
+            if (component == "network" || component == "all") {
+                g_network_refresh_requested = true;
+            }
+            if (component == "cellular" || component == "all") {
+                g_cellular_refresh_requested = true;
+            }
+        }
+        g_updater_cv.notify_one();
+    }
+    
     std::string getRefreshedDashboardResponse() {
-        updateAllData(true);
+        // Schedules the refresh and answers with the current data; the
+        // refreshed values show up on the next request
+        requestRefresh("all");
         return getDashboardResponse(true, true);
     }
     
@@ -0,0 +1,1453 @@
+#include "dns_engine.h"
+#include "endpoint_logger.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cctype>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sstream>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint64_t WAKE_KEY = 0;            // Attempt keys start at 1
+constexpr const char* DEFAULT_PORT = "53";
+constexpr uint16_t EDNS_PAYLOAD = 1232;     // DNS flag day 2020: no IP fragmentation
+constexpr size_t HEADER_LENGTH = 12;
+constexpr size_t BUFFER_SIZE = 65536;
+constexpr uint16_t TYPE_A = 1;
+constexpr uint16_t TYPE_AAAA = 28;
+constexpr uint16_t TYPE_OPT = 41;
+constexpr uint16_t CLASS_IN = 1;
+constexpr int MAX_POINTERS = 64;
+constexpr size_t MAX_RESOLV_SERVERS = 3;    // MAXNS, as glibc
+constexpr auto CONFIG_CHECK_INTERVAL = std::chrono::seconds(1);
+constexpr auto MIN_RETRANSMIT = std::chrono::milliseconds(100);
+constexpr const char* RESOLV_CONF = "/etc/resolv.conf";
+constexpr const char* HOSTS_FILE = "/etc/hosts";
+
+const std::vector<std::pair<uint16_t, const char*>> TYPE_NAMES = {
+    {1, "A"}, {2, "NS"}, {5, "CNAME"}, {6, "SOA"}, {12, "PTR"}, {13, "HINFO"}, {15, "MX"}, {16, "TXT"},
+    {28, "AAAA"}, {33, "SRV"}, {35, "NAPTR"}, {39, "DNAME"}, {41, "OPT"}, {43, "DS"}, {46, "RRSIG"},
+    {47, "NSEC"}, {48, "DNSKEY"}, {50, "NSEC3"}, {51, "NSEC3PARAM"}, {52, "TLSA"}, {64, "SVCB"},
+    {65, "HTTPS"}, {99, "SPF"}, {255, "ANY"}, {257, "CAA"}
+};
+
+const char* const RCODE_NAMES[] = {
+    "NOERROR", "FORMERR", "SERVFAIL", "NXDOMAIN", "NOTIMP", "REFUSED",
+    "YXDOMAIN", "YXRRSET", "NXRRSET", "NOTAUTH", "NOTZONE"
+};
+
+std::string rcodeName(int rcode) {
+    return rcode < 11 ? RCODE_NAMES[rcode] : "RCODE" + std::to_string(rcode);
+}
+
+// Lower case without the trailing dot: the form names are compared in
+std::string canonicalName(const std::string& name) {
+    std::string result = name;
+    if (result.size() > 1 && result.back() == '.') {
+        result.pop_back();
+    }
+    std::transform(result.begin(), result.end(), result.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return result;
+}
+
+uint16_t read16(const uint8_t* data) {
+    return static_cast<uint16_t>(data[0] << 8 | data[1]);
+}
+
+void append16(std::string& out, uint16_t value) {
+    out += static_cast<char>(value >> 8);
+    out += static_cast<char>(value & 0xff);
+}
+
+std::string hex(const uint8_t* data, size_t length) {
+    static const char digits[] = "0123456789ABCDEF";
+    std::string out;
+    out.reserve(length * 2);
+    for (size_t i = 0; i < length; ++i) {
+        out += digits[data[i] >> 4];
+        out += digits[data[i] & 0x0f];
+    }
+    return out;
+}
+
+std::string base64(const uint8_t* data, size_t length) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    out.reserve((length + 2) / 3 * 4);
+    for (size_t i = 0; i < length; i += 3) {
+        uint32_t chunk = static_cast<uint32_t>(data[i]) << 16;
+        if (i + 1 < length) chunk |= static_cast<uint32_t>(data[i + 1]) << 8;
+        if (i + 2 < length) chunk |= data[i + 2];
+        out += alphabet[chunk >> 18 & 0x3f];
+        out += alphabet[chunk >> 12 & 0x3f];
+        out += i + 1 < length ? alphabet[chunk >> 6 & 0x3f] : '=';
+        out += i + 2 < length ? alphabet[chunk & 0x3f] : '=';
+    }
+    return out;
+}
+
+// Character strings and labels in presentation format: special and
+// non-printable bytes escaped as dig does
+std::string escape(const uint8_t* data, size_t length, bool quoted) {
+    std::string out;
+    for (size_t i = 0; i < length; ++i) {
+        uint8_t c = data[i];
+        if (c < 0x20 || c > 0x7e) {
+            char code[5];
+            std::snprintf(code, sizeof(code), "\\%03u", c);
+            out += code;
+        } else if (c == '"' || c == '\\' || (!quoted && (c == '.' || c == ' '))) {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+    return out;
+}
+
+// Bounds-checked reader over a whole message (names may point anywhere in it)
+class Reader {
+public:
+    Reader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+    bool ok() const { return ok_; }
+    size_t position() const { return position_; }
+    void seek(size_t position) { position_ = position; }
+    void reset(size_t position) {
+        position_ = position;
+        ok_ = true;
+    }
+
+    uint8_t u8() { return need(1) ? data_[position_++] : 0; }
+    uint16_t u16() {
+        if (!need(2)) return 0;
+        uint16_t value = read16(data_ + position_);
+        position_ += 2;
+        return value;
+    }
+    uint32_t u32() {
+        uint32_t high = u16();
+        return high << 16 | u16();
+    }
+    const uint8_t* bytes(size_t length) {
+        if (!need(length)) return nullptr;
+        const uint8_t* start = data_ + position_;
+        position_ += length;
+        return start;
+    }
+
+    std::string name() {
+        std::string result;
+        size_t position = position_;
+        bool jumped = false;
+        int pointers = 0;
+        while (true) {
+            if (position >= size_) {
+                return fail();
+            }
+            uint8_t length = data_[position];
+            if ((length & 0xc0) == 0xc0) {
+                if (position + 1 >= size_ || ++pointers > MAX_POINTERS) {
+                    return fail();
+                }
+                if (!jumped) {
+                    position_ = position + 2;
+                    jumped = true;
+                }
+                position = static_cast<size_t>(length & 0x3f) << 8 | data_[position + 1];
+                continue;
+            }
+            if (length & 0xc0) {
+                return fail();      // Obsolete extended label types
+            }
+            ++position;
+            if (length == 0) {
+                break;
+            }
+            if (position + length > size_ || result.size() > 1024) {
+                return fail();
+            }
+            result += escape(data_ + position, length, false);
+            result += '.';
+            position += length;
+        }
+        if (!jumped) {
+            position_ = position;
+        }
+        return result.empty() ? "." : result;
+    }
+
+private:
+    bool need(size_t length) {
+        if (!ok_ || position_ + length > size_) {
+            ok_ = false;
+            return false;
+        }
+        return true;
+    }
+    std::string fail() {
+        ok_ = false;
+        return "";
+    }
+
+    const uint8_t* data_;
+    size_t size_;
+    size_t position_ = 0;
+    bool ok_ = true;
+};
+
+std::string signatureTime(uint32_t value) {
+    time_t seconds = static_cast<time_t>(value);
+    struct tm parts{};
+    ::gmtime_r(&seconds, &parts);
+    char text[16];
+    std::strftime(text, sizeof(text), "%Y%m%d%H%M%S", &parts);
+    return text;
+}
+
+// RDATA in presentation format. Returns false when it does not parse, in
+// which case the caller falls back to the RFC 3597 generic form.
+bool renderData(Reader& reader, size_t end, uint16_t type, DnsEngine::Record& record) {
+    std::ostringstream value;
+    auto rest = [&]() -> std::pair<const uint8_t*, size_t> {
+        size_t length = end > reader.position() ? end - reader.position() : 0;
+        return {reader.bytes(length), length};
+    };
+
+    switch (type) {
+    case 1: {   // A
+        const uint8_t* data = reader.bytes(4);
+        char text[INET_ADDRSTRLEN];
+        if (!data) return false;
+        ::inet_ntop(AF_INET, data, text, sizeof(text));
+        value << text;
+        break;
+    }
+    case 28: {  // AAAA
+        const uint8_t* data = reader.bytes(16);
+        char text[INET6_ADDRSTRLEN];
+        if (!data) return false;
+        ::inet_ntop(AF_INET6, data, text, sizeof(text));
+        value << text;
+        break;
+    }
+    case 2: case 5: case 12: case 39:   // NS, CNAME, PTR, DNAME
+        value << reader.name();
+        break;
+    case 15:    // MX
+        record.priority = reader.u16();
+        value << reader.name();
+        break;
+    case 6: {   // SOA
+        std::string primary = reader.name();
+        std::string mailbox = reader.name();
+        value << primary << ' ' << mailbox;
+        for (int i = 0; i < 5; ++i) {
+            value << ' ' << reader.u32();
+        }
+        break;
+    }
+    case 16: case 99: {     // TXT, SPF
+        bool first = true;
+        while (reader.ok() && reader.position() < end) {
+            uint8_t length = reader.u8();
+            const uint8_t* data = reader.bytes(length);
+            if (!data) return false;
+            value << (first ? "" : " ") << '"' << escape(data, length, true) << '"';
+            first = false;
+        }
+        break;
+    }
+    case 13: {  // HINFO
+        for (int i = 0; i < 2; ++i) {
+            uint8_t length = reader.u8();
+            const uint8_t* data = reader.bytes(length);
+            if (!data) return false;
+            value << (i ? " " : "") << '"' << escape(data, length, true) << '"';
+        }
+        break;
+    }
+    case 33: {  // SRV
+        uint16_t priority = reader.u16();
+        uint16_t weight = reader.u16();
+        uint16_t port = reader.u16();
+        record.priority = priority;
+        value << priority << ' ' << weight << ' ' << port << ' ' << reader.name();
+        break;
+    }
+    case 257: { // CAA
+        uint8_t flags = reader.u8();
+        uint8_t tag_length = reader.u8();
+        const uint8_t* tag = reader.bytes(tag_length);
+        if (!tag) return false;
+        auto [data, length] = rest();
+        if (!data && length) return false;
+        value << static_cast<int>(flags) << ' ' << std::string(reinterpret_cast<const char*>(tag), tag_length)
+              << " \"" << escape(data, length, true) << '"';
+        break;
+    }
+    case 43: {  // DS
+        uint16_t key_tag = reader.u16();
+        uint8_t algorithm = reader.u8();
+        uint8_t digest_type = reader.u8();
+        auto [data, length] = rest();
+        if (!data && length) return false;
+        value << key_tag << ' ' << static_cast<int>(algorithm) << ' ' << static_cast<int>(digest_type)
+              << ' ' << hex(data, length);
+        break;
+    }
+    case 48: {  // DNSKEY
+        uint16_t flags = reader.u16();
+        uint8_t protocol = reader.u8();
+        uint8_t algorithm = reader.u8();
+        auto [data, length] = rest();
+        if (!data && length) return false;
+        value << flags << ' ' << static_cast<int>(protocol) << ' ' << static_cast<int>(algorithm)
+              << ' ' << base64(data, length);
+        break;
+    }
+    case 46: {  // RRSIG
+        uint16_t covered = reader.u16();
+        uint8_t algorithm = reader.u8();
+        uint8_t labels = reader.u8();
+        uint32_t original_ttl = reader.u32();
+        uint32_t expiration = reader.u32();
+        uint32_t inception = reader.u32();
+        uint16_t key_tag = reader.u16();
+        std::string signer = reader.name();
+        auto [data, length] = rest();
+        if (!data && length) return false;
+        value << DnsEngine::typeName(covered) << ' ' << static_cast<int>(algorithm) << ' '
+              << static_cast<int>(labels) << ' ' << original_ttl << ' ' << signatureTime(expiration) << ' '
+              << signatureTime(inception) << ' ' << key_tag << ' ' << signer << ' ' << base64(data, length);
+        break;
+    }
+    case 47: {  // NSEC
+        value << reader.name();
+        while (reader.ok() && reader.position() < end) {
+            uint8_t window = reader.u8();
+            uint8_t length = reader.u8();
+            const uint8_t* bitmap = reader.bytes(length);
+            if (!bitmap || length > 32) return false;
+            for (size_t i = 0; i < length; ++i) {
+                for (int bit = 0; bit < 8; ++bit) {
+                    if (bitmap[i] & (0x80 >> bit)) {
+                        value << ' ' << DnsEngine::typeName(static_cast<uint16_t>(window * 256 + i * 8 + bit));
+                    }
+                }
+            }
+        }
+        break;
+    }
+    default:
+        return false;
+    }
+
+    if (!reader.ok() || reader.position() != end) {
+        return false;
+    }
+    record.value = value.str();
+    return true;
+}
+
+bool parseRecord(Reader& reader, DnsEngine::Record& record, uint16_t& type) {
+    record.name = reader.name();
+    type = reader.u16();
+    uint16_t record_class = reader.u16();
+    record.ttl = reader.u32();
+    uint16_t length = reader.u16();
+    if (!reader.ok()) {
+        return false;
+    }
+
+    record.type = DnsEngine::typeName(type);
+    record.recordClass = record_class == 1 ? "IN" : record_class == 3 ? "CH" : record_class == 4 ? "HS"
+        : "CLASS" + std::to_string(record_class);
+
+    size_t start = reader.position();
+    size_t end = start + length;
+    if (type != TYPE_OPT && !renderData(reader, end, type, record)) {
+        reader.reset(start);
+        const uint8_t* data = reader.bytes(length);
+        if (!data) {
+            return false;
+        }
+        record.priority = 0;
+        record.value = "\\# " + std::to_string(length) + (length ? " " + hex(data, length) : "");
+    }
+    reader.seek(end);
+    return true;
+}
+
+struct ParsedHeader {
+    uint16_t id = 0;
+    bool truncated = false;
+    std::string question;       // Canonical
+    uint16_t question_type = 0;
+};
+
+bool parseMessage(const uint8_t* data, size_t length, ParsedHeader& header, DnsEngine::Response& response) {
+    if (length < HEADER_LENGTH) {
+        return false;
+    }
+    header.id = read16(data);
+    uint16_t flags = read16(data + 2);
+    uint16_t questions = read16(data + 4);
+    uint16_t counts[3] = {read16(data + 6), read16(data + 8), read16(data + 10)};
+    if (!(flags & 0x8000) || questions != 1) {
+        return false;
+    }
+    header.truncated = flags & 0x0200;
+    response.authoritative = flags & 0x0400;
+    response.recursion_available = flags & 0x0080;
+    response.status = rcodeName(flags & 0x0f);
+    response.size = length;
+
+    Reader reader(data, length);
+    reader.seek(HEADER_LENGTH);
+    header.question = canonicalName(reader.name());
+    header.question_type = reader.u16();
+    reader.u16();
+    if (!reader.ok()) {
+        return false;
+    }
+    if (header.truncated) {
+        return true;        // Sections may be cut anywhere; TCP gives the whole answer
+    }
+
+    std::vector<DnsEngine::Record>* sections[3] = {&response.answers, &response.authority, &response.additional};
+    for (int section = 0; section < 3; ++section) {
+        for (uint16_t i = 0; i < counts[section]; ++i) {
+            DnsEngine::Record record;
+            uint16_t type = 0;
+            if (!parseRecord(reader, record, type)) {
+                return false;
+            }
+            if (type != TYPE_OPT) {
+                sections[section]->push_back(std::move(record));
+            }
+        }
+    }
+    return true;
+}
+
+bool encodeQuery(const std::string& name, uint16_t type, bool recursive, std::string& packet, std::string& error) {
+    packet.clear();
+    append16(packet, 0);                        // Id, set per server
+    append16(packet, recursive ? 0x0100 : 0);   // RD
+    append16(packet, 1);
+    append16(packet, 0);
+    append16(packet, 0);
+    append16(packet, 1);                        // OPT
+
+    size_t name_length = 1;
+    if (name != ".") {
+        std::string trimmed = name.size() > 1 && name.back() == '.' ? name.substr(0, name.size() - 1) : name;
+        size_t start = 0;
+        while (start <= trimmed.size()) {
+            size_t dot = trimmed.find('.', start);
+            size_t end = dot == std::string::npos ? trimmed.size() : dot;
+            size_t length = end - start;
+            if (length == 0 || length > 63) {
+                error = "invalid name: " + name;
+                return false;
+            }
+            packet += static_cast<char>(length);
+            packet.append(trimmed, start, length);
+            name_length += length + 1;
+            if (dot == std::string::npos) {
+                break;
+            }
+            start = dot + 1;
+        }
+    }
+    if (name_length > 255) {
+        error = "name too long: " + name;
+        return false;
+    }
+    packet += '\0';
+    append16(packet, type);
+    append16(packet, CLASS_IN);
+
+    // EDNS0: root owner, OPT, UDP payload size, no extended flags
+    packet += '\0';
+    append16(packet, TYPE_OPT);
+    append16(packet, EDNS_PAYLOAD);
+    append16(packet, 0);
+    append16(packet, 0);
+    append16(packet, 0);
+    return true;
+}
+
+// Seconds an answer may be cached: the smallest answer TTL, or for negative
+// answers the SOA TTL capped by its minimum field (RFC 2308)
+uint32_t cacheTtl(const DnsEngine::Response& response) {
+    if (response.status == "NOERROR" && !response.answers.empty()) {
+        uint32_t ttl = UINT32_MAX;
+        for (const auto& record : response.answers) {
+            ttl = std::min(ttl, record.ttl);
+        }
+        return std::min(ttl, DnsEngine::MAX_CACHE_TTL);
+    }
+    if (response.status != "NOERROR" && response.status != "NXDOMAIN") {
+        return 0;
+    }
+    for (const auto& record : response.authority) {
+        size_t space = record.value.rfind(' ');
+        if (record.type == "SOA" && space != std::string::npos) {
+            uint32_t minimum = static_cast<uint32_t>(std::strtoul(record.value.c_str() + space + 1, nullptr, 10));
+            return std::min({record.ttl, minimum, DnsEngine::MAX_CACHE_TTL});
+        }
+    }
+    return 0;
+}
+
+bool numericAddress(const std::string& text, int family, sockaddr_storage& address, socklen_t& length) {
+    struct addrinfo hints{};
+    hints.ai_family = family;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_NUMERICHOST;
+    struct addrinfo* results = nullptr;
+    if (::getaddrinfo(text.c_str(), nullptr, &hints, &results) != 0 || !results) {
+        return false;
+    }
+    std::memset(&address, 0, sizeof(address));
+    std::memcpy(&address, results->ai_addr, results->ai_addrlen);
+    length = results->ai_addrlen;
+    ::freeaddrinfo(results);
+    return true;
+}
+
+bool sameTime(const timespec& a, const timespec& b) {
+    return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+}
+
+std::string formatAddress(const sockaddr_storage& address) {
+    char text[INET6_ADDRSTRLEN] = "";
+    if (address.ss_family == AF_INET) {
+        ::inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in&>(address).sin_addr, text, sizeof(text));
+    } else if (address.ss_family == AF_INET6) {
+        ::inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6&>(address).sin6_addr, text, sizeof(text));
+    }
+    return text;
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+struct DnsEngine::Pending {
+    uint64_t id = 0;
+    Query query;
+    std::vector<Server> servers;
+    std::string packet;                 // Query message; the id is set per server
+    std::string key;                    // Cache key
+    std::string name;                   // Canonical, to match answers against
+    Response response;
+    bool answered = false;              // response holds a final answer (NOERROR or NXDOMAIN)
+    bool done = false;
+    size_t outstanding = 0;             // Servers still being asked
+    std::vector<ServerTiming> timings;
+};
+
+struct DnsEngine::Attempt {
+    uint64_t key = 0;
+    uint64_t query = 0;
+    size_t server = 0;
+    int fd = -1;
+    uint16_t wire_id = 0;
+    bool tcp = false;
+    bool connected = false;
+    bool truncated = false;
+    int sends = 0;                      // UDP transmissions so far
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::time_point deadline;     // Next retransmission, or giving up
+    std::string packet;
+    std::string out;                    // TCP: not yet written
+    std::string in;                     // TCP: read so far
+
+    ~Attempt() {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+};
+
+DnsEngine& DnsEngine::getInstance() {
+    static DnsEngine instance;
+    return instance;
+}
+
+DnsEngine::DnsEngine() : random_(std::random_device{}()), buffer_(BUFFER_SIZE) {
+    epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (epoll_fd_ < 0 || wake_fd_ < 0) {
+        ENDPOINT_LOG("dns-resolver", "Failed to create epoll/eventfd: " + std::string(std::strerror(errno)));
+        return;
+    }
+
+    struct epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = WAKE_KEY;
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event);
+
+    thread_ = std::thread(&DnsEngine::reactorLoop, this);
+}
+
+DnsEngine::~DnsEngine() {
+    shutdown();
+    if (wake_fd_ >= 0) {
+        ::close(wake_fd_);
+    }
+    if (epoll_fd_ >= 0) {
+        ::close(epoll_fd_);
+    }
+}
+
+bool DnsEngine::typeFromName(const std::string& name, uint16_t& type) {
+    std::string upper = name;
+    std::transform(upper.begin(), upper.end(), upper.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+    for (const auto& [number, mnemonic] : TYPE_NAMES) {
+        if (upper == mnemonic) {
+            type = number;
+            return true;
+        }
+    }
+    if (upper.rfind("TYPE", 0) == 0 && upper.size() > 4 && upper.size() <= 9 &&
+        std::all_of(upper.begin() + 4, upper.end(), [](unsigned char c) { return std::isdigit(c); })) {
+        unsigned long number = std::stoul(upper.substr(4));
+        if (number <= 0xffff) {
+            type = static_cast<uint16_t>(number);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string DnsEngine::typeName(uint16_t type) {
+    for (const auto& [number, mnemonic] : TYPE_NAMES) {
+        if (number == type) {
+            return mnemonic;
+        }
+    }
+    return "TYPE" + std::to_string(type);
+}
+
+std::string DnsEngine::reverseName(const std::string& address) {
+    uint8_t bytes[16];
+    std::string name;
+    if (::inet_pton(AF_INET, address.c_str(), bytes) == 1) {
+        for (int i = 3; i >= 0; --i) {
+            name += std::to_string(bytes[i]) + ".";
+        }
+        return name + "in-addr.arpa.";
+    }
+    if (::inet_pton(AF_INET6, address.c_str(), bytes) == 1) {
+        static const char digits[] = "0123456789abcdef";
+        for (int i = 15; i >= 0; --i) {
+            name += digits[bytes[i] & 0x0f];
+            name += '.';
+            name += digits[bytes[i] >> 4];
+            name += '.';
+        }
+        return name + "ip6.arpa.";
+    }
+    return "";
+}
+
+bool DnsEngine::parseServer(const std::string& text, Server& server) {
+    // dig notation: "addr" or "addr#port"
+    std::string host = text;
+    std::string port = DEFAULT_PORT;
+    size_t hash = text.find('#');
+    if (hash != std::string::npos) {
+        host = text.substr(0, hash);
+        port = text.substr(hash + 1);
+    }
+    if (!host.empty() && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+
+    struct addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV;
+    struct addrinfo* results = nullptr;
+    if (host.empty() || ::getaddrinfo(host.c_str(), port.c_str(), &hints, &results) != 0 || !results) {
+        return false;
+    }
+    std::memset(&server.address, 0, sizeof(server.address));
+    std::memcpy(&server.address, results->ai_addr, results->ai_addrlen);
+    server.length = results->ai_addrlen;
+    ::freeaddrinfo(results);
+    server.label = formatAddress(server.address) + "#" + port;
+    return true;
+}
+
+void DnsEngine::refreshSystemConfig() {
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    auto now = std::chrono::steady_clock::now();
+    if (now - config_.checked < CONFIG_CHECK_INTERVAL) {
+        return;
+    }
+    config_.checked = now;
+
+    struct stat info{};
+    timespec mtime{};
+    if (::stat(RESOLV_CONF, &info) == 0) {
+        mtime = info.st_mtim;
+    }
+    if (!sameTime(mtime, config_.resolv_mtime) || config_.servers.empty()) {
+        config_.resolv_mtime = mtime;
+        config_.servers.clear();
+        config_.search.clear();
+        config_.ndots = 1;
+
+        std::ifstream file(RESOLV_CONF);
+        std::string line;
+        while (std::getline(file, line)) {
+            std::istringstream words(line);
+            std::string keyword;
+            words >> keyword;
+            if (keyword == "nameserver") {
+                std::string address;
+                Server server;
+                if (words >> address && config_.servers.size() < MAX_RESOLV_SERVERS && parseServer(address, server)) {
+                    config_.servers.push_back(server);
+                }
+            } else if (keyword == "search" || keyword == "domain") {
+                config_.search.clear();
+                std::string domain;
+                while (words >> domain) {
+                    config_.search.push_back(domain);
+                }
+            } else if (keyword == "options") {
+                std::string option;
+                while (words >> option) {
+                    if (option.rfind("ndots:", 0) == 0) {
+                        config_.ndots = std::clamp(std::atoi(option.c_str() + 6), 0, 15);
+                    }
+                }
+            }
+        }
+        if (config_.servers.empty()) {
+            Server server;
+            parseServer("127.0.0.1", server);       // As the C library does
+            config_.servers.push_back(server);
+        }
+    }
+
+    mtime = {};
+    if (::stat(HOSTS_FILE, &info) == 0) {
+        mtime = info.st_mtim;
+    }
+    if (!sameTime(mtime, config_.hosts_mtime)) {
+        config_.hosts_mtime = mtime;
+        config_.hosts.clear();
+
+        std::ifstream file(HOSTS_FILE);
+        std::string line;
+        while (std::getline(file, line)) {
+            line = line.substr(0, line.find('#'));
+            std::istringstream words(line);
+            std::string text;
+            sockaddr_storage address{};
+            socklen_t length = 0;
+            if (!(words >> text) || !numericAddress(text, AF_UNSPEC, address, length)) {
+                continue;
+            }
+            std::string name;
+            while (words >> name) {
+                config_.hosts.emplace_back(canonicalName(name), address);
+            }
+        }
+    }
+}
+
+std::vector<std::string> DnsEngine::systemServers() {
+    refreshSystemConfig();
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    std::vector<std::string> labels;
+    for (const auto& server : config_.servers) {
+        labels.push_back(server.label);
+    }
+    return labels;
+}
+
+bool DnsEngine::lookupCache(const std::string& key, Response& response) {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    auto it = cache_.find(key);
+    if (it == cache_.end()) {
+        return false;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (it->second.expires <= now) {
+        cache_.erase(it);
+        return false;
+    }
+
+    // TTLs count down from when the answer was stored
+    response = it->second.response;
+    uint32_t elapsed = static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::seconds>(now - it->second.stored).count());
+    for (auto* section : {&response.answers, &response.authority, &response.additional}) {
+        for (auto& record : *section) {
+            record.ttl -= std::min(record.ttl, elapsed);
+        }
+    }
+    response.from_cache = true;
+    response.query_time_ms = 0.0;
+    response.servers.clear();
+    return true;
+}
+
+void DnsEngine::storeCache(const std::string& key, const Response& response) {
+    uint32_t ttl = cacheTtl(response);
+    if (ttl == 0) {
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    if (cache_.size() >= MAX_CACHE_ENTRIES && !cache_.count(key)) {
+        for (auto it = cache_.begin(); it != cache_.end();) {
+            it = it->second.expires <= now ? cache_.erase(it) : std::next(it);
+        }
+        if (cache_.size() >= MAX_CACHE_ENTRIES) {
+            auto soonest = std::min_element(cache_.begin(), cache_.end(), [](const auto& a, const auto& b) {
+                return a.second.expires < b.second.expires;
+            });
+            cache_.erase(soonest);
+        }
+    }
+    CacheEntry& entry = cache_[key];
+    entry.response = response;
+    entry.stored = now;
+    entry.expires = now + std::chrono::seconds(ttl);
+}
+
+size_t DnsEngine::cacheSize() const {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    return cache_.size();
+}
+
+void DnsEngine::flushCache() {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    cache_.clear();
+}
+
+uint64_t DnsEngine::start(Query query) {
+    auto pending = std::make_unique<Pending>();
+    pending->query = std::move(query);
+    const Query& request = pending->query;
+
+    auto complete = [&](Response& response) -> uint64_t {
+        if (request.on_done) {
+            request.on_done(response);
+        }
+        return 0;
+    };
+    auto fail = [&](const std::string& error) -> uint64_t {
+        pending->response.error = error;
+        return complete(pending->response);
+    };
+
+    std::string error;
+    if (!encodeQuery(request.name, request.type, request.recursive, pending->packet, error)) {
+        return fail(error);
+    }
+
+    if (request.servers.empty()) {
+        refreshSystemConfig();
+        std::lock_guard<std::mutex> lock(config_mutex_);
+        pending->servers = config_.servers;
+    }
+    for (const auto& text : request.servers) {
+        Server server;
+        if (!parseServer(text, server)) {
+            return fail("invalid server address: " + text);
+        }
+        pending->servers.push_back(server);
+    }
+    if (request.ipv6_transport) {
+        pending->servers.erase(std::remove_if(pending->servers.begin(), pending->servers.end(),
+            [](const Server& server) { return server.address.ss_family != AF_INET6; }), pending->servers.end());
+    }
+    if (pending->servers.empty()) {
+        return fail("no servers to query");
+    }
+    if (pending->servers.size() > MAX_SERVERS) {
+        pending->servers.resize(MAX_SERVERS);
+    }
+
+    pending->name = canonicalName(request.name);
+    pending->key = pending->name + "|" + std::to_string(request.type) + (request.recursive ? "|rd|" : "|norec|");
+    for (const auto& server : pending->servers) {
+        pending->key += server.label + ",";
+        ServerTiming timing;
+        timing.server = server.label;
+        pending->timings.push_back(timing);
+    }
+
+    if (request.use_cache && lookupCache(pending->key, pending->response)) {
+        return complete(pending->response);
+    }
+
+    uint64_t id = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_.load() || epoll_fd_ < 0) {
+            error = "DNS engine is not running";
+        } else {
+            id = pending->id = ++next_id_;
+            live_.insert(id);
+            pending_.push_back(std::move(pending));
+        }
+    }
+    if (pending) {
+        return fail(error);
+    }
+
+    wake();
+    return id;
+}
+
+DnsEngine::Response DnsEngine::lookup(Query query) {
+    if (std::this_thread::get_id() == thread_.get_id()) {
+        Response response;
+        response.error = "lookup() called from the reactor thread";
+        return response;
+    }
+
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    bool done = false;
+    Response response;
+
+    query.on_done = [&](const Response& finished) {
+        std::lock_guard<std::mutex> lock(done_mutex);
+        response = finished;
+        done = true;
+        done_cv.notify_one();
+    };
+    start(std::move(query));
+
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done_cv.wait(lock, [&]() { return done; });
+    return response;
+}
+
+std::vector<DnsEngine::Response> DnsEngine::lookupAll(std::vector<Query> queries) {
+    std::vector<Response> responses(queries.size());
+    if (std::this_thread::get_id() == thread_.get_id()) {
+        for (auto& response : responses) {
+            response.error = "lookupAll() called from the reactor thread";
+        }
+        return responses;
+    }
+
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    size_t remaining = queries.size();
+
+    for (size_t i = 0; i < queries.size(); ++i) {
+        queries[i].on_done = [&, i](const Response& finished) {
+            std::lock_guard<std::mutex> lock(done_mutex);
+            responses[i] = finished;
+            if (--remaining == 0) {
+                done_cv.notify_one();
+            }
+        };
+        start(std::move(queries[i]));
+    }
+
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done_cv.wait(lock, [&]() { return remaining == 0; });
+    return responses;
+}
+
+bool DnsEngine::resolve(const std::string& host, int family, sockaddr_storage& address,
+                        socklen_t& address_length, std::string& error) {
+    if (host.empty()) {
+        error = ::gai_strerror(EAI_NONAME);
+        return false;
+    }
+    if (numericAddress(host, family, address, address_length)) {
+        return true;
+    }
+
+    // /etc/hosts first, as nsswitch.conf has it nearly everywhere
+    refreshSystemConfig();
+    std::vector<std::string> candidates;
+    {
+        std::lock_guard<std::mutex> lock(config_mutex_);
+        std::string name = canonicalName(host);
+        for (int pass = 0; pass < 2; ++pass) {
+            for (const auto& [entry, entry_address] : config_.hosts) {
+                bool wanted = family == AF_UNSPEC ? (pass == 1 || entry_address.ss_family == AF_INET)
+                                                  : entry_address.ss_family == family;
+                if (entry == name && wanted) {
+                    address = entry_address;
+                    address_length = entry_address.ss_family == AF_INET6 ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+                    return true;
+                }
+            }
+        }
+
+        // Search list, tried before the bare name when it has fewer than ndots dots
+        bool absolute = host.back() == '.';
+        long dots = std::count(host.begin(), host.end(), '.');
+        if (absolute || dots >= config_.ndots) {
+            candidates.push_back(host);
+        }
+        if (!absolute) {
+            for (const auto& domain : config_.search) {
+                candidates.push_back(host + "." + domain);
+            }
+            if (dots < config_.ndots) {
+                candidates.push_back(host);
+            }
+        }
+    }
+
+    std::vector<uint16_t> types;
+    if (family != AF_INET6) types.push_back(TYPE_A);
+    if (family != AF_INET) types.push_back(TYPE_AAAA);
+
+    bool reached = false;
+    for (const auto& candidate : candidates) {
+        for (uint16_t type : types) {
+            Query query;
+            query.name = candidate;
+            query.type = type;
+            Response response = lookup(std::move(query));
+            reached = reached || !response.status.empty();
+            for (const auto& record : response.answers) {
+                if (record.type == typeName(type) &&
+                    numericAddress(record.value, type == TYPE_A ? AF_INET : AF_INET6, address, address_length)) {
+                    return true;
+                }
+            }
+        }
+    }
+    if (reached) {
+        error = ::gai_strerror(EAI_NONAME);
+        return false;
+    }
+
+    // No server could be reached: let the C library try its other sources
+    struct addrinfo hints{};
+    hints.ai_family = family;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_ADDRCONFIG;
+    struct addrinfo* results = nullptr;
+    int rc = ::getaddrinfo(host.c_str(), nullptr, &hints, &results);
+    if (rc != 0 || !results) {
+        error = rc == EAI_SYSTEM ? std::string(std::strerror(errno)) : std::string(::gai_strerror(rc));
+        return false;
+    }
+    const struct addrinfo* chosen = results;
+    if (family == AF_UNSPEC) {
+        for (const struct addrinfo* entry = results; entry; entry = entry->ai_next) {
+            if (entry->ai_family == AF_INET) {
+                chosen = entry;
+                break;
+            }
+        }
+    }
+    std::memset(&address, 0, sizeof(address));
+    std::memcpy(&address, chosen->ai_addr, chosen->ai_addrlen);
+    address_length = chosen->ai_addrlen;
+    ::freeaddrinfo(results);
+    return true;
+}
+
+size_t DnsEngine::activeCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return live_.size();
+}
+
+void DnsEngine::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_.exchange(true)) {
+            return;
+        }
+    }
+    wake();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void DnsEngine::wake() {
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t written = ::write(wake_fd_, &one, sizeof(one));
+}
+
+void DnsEngine::adoptPending() {
+    std::vector<std::unique_ptr<Pending>> adopted;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        adopted.swap(pending_);
+    }
+
+    for (auto& pending : adopted) {
+        Pending& query = *pending;
+        queries_.emplace(query.id, std::move(pending));
+        for (size_t i = 0; i < query.servers.size(); ++i) {
+            openAttempt(query, i);
+        }
+        if (query.outstanding == 0) {
+            query.done = true;
+        }
+    }
+}
+
+void DnsEngine::openAttempt(Pending& query, size_t server_index) {
+    const Server& server = query.servers[server_index];
+    auto attempt = std::make_unique<Attempt>();
+    attempt->key = ++next_attempt_;
+    attempt->query = query.id;
+    attempt->server = server_index;
+    attempt->wire_id = static_cast<uint16_t>(random_());
+    attempt->packet = query.packet;
+    attempt->packet[0] = static_cast<char>(attempt->wire_id >> 8);
+    attempt->packet[1] = static_cast<char>(attempt->wire_id & 0xff);
+    attempt->started = std::chrono::steady_clock::now();
+
+    // A connected socket per server: the kernel picks a random source port
+    // and drops datagrams from anyone else
+    attempt->fd = ::socket(server.address.ss_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (attempt->fd < 0 ||
+        ::connect(attempt->fd, reinterpret_cast<const sockaddr*>(&server.address), server.length) != 0) {
+        query.timings[server_index].status = std::strerror(errno);
+        return;
+    }
+
+    struct epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = attempt->key;
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, attempt->fd, &event);
+
+    ++query.outstanding;
+    Attempt& registered = *attempt;
+    attempts_.emplace(attempt->key, std::move(attempt));
+    if (!sendUdp(registered)) {
+        failAttempt(registered, std::strerror(errno));
+    }
+}
+
+bool DnsEngine::sendUdp(Attempt& attempt) {
+    const Query& query = queries_.at(attempt.query)->query;
+    if (::send(attempt.fd, attempt.packet.data(), attempt.packet.size(), 0) < 0) {
+        return false;
+    }
+
+    // Retransmissions share the per-server timeout
+    ++attempt.sends;
+    auto now = std::chrono::steady_clock::now();
+    auto give_up = attempt.started + query.timeout;
+    auto slice = std::max<std::chrono::steady_clock::duration>(query.timeout / std::max(query.attempts, 1), MIN_RETRANSMIT);
+    attempt.deadline = attempt.sends >= query.attempts ? give_up : std::min(now + slice, give_up);
+    return true;
+}
+
+void DnsEngine::switchToTcp(Attempt& attempt, Pending& query) {
+    const Server& server = query.servers[attempt.server];
+    ::close(attempt.fd);    // Also leaves epoll
+
+    attempt.fd = ::socket(server.address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (attempt.fd < 0 ||
+        (::connect(attempt.fd, reinterpret_cast<const sockaddr*>(&server.address), server.length) != 0 &&
+         errno != EINPROGRESS)) {
+        failAttempt(attempt, std::strerror(errno));
+        return;
+    }
+    attempt.tcp = true;
+    attempt.truncated = true;
+    attempt.out.clear();
+    append16(attempt.out, static_cast<uint16_t>(attempt.packet.size()));
+    attempt.out += attempt.packet;
+    attempt.deadline = std::chrono::steady_clock::now() + query.query.timeout;
+
+    struct epoll_event event{};
+    event.events = EPOLLIN | EPOLLOUT;
+    event.data.u64 = attempt.key;
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, attempt.fd, &event);
+}
+
+void DnsEngine::handleEvent(Attempt& attempt, uint32_t events) {
+    if (!attempt.tcp) {
+        while (true) {
+            ssize_t n = ::recv(attempt.fd, buffer_.data(), buffer_.size(), MSG_DONTWAIT);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    failAttempt(attempt, std::strerror(errno));     // ICMP port unreachable and such
+                }
+                return;
+            }
+            if (handleMessage(attempt, buffer_.data(), static_cast<size_t>(n))) {
+                return;
+            }
+        }
+    }
+
+    if (!attempt.connected && (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        ::getsockopt(attempt.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+        if (error != 0) {
+            failAttempt(attempt, std::strerror(error));
+            return;
+        }
+        attempt.connected = true;
+    }
+    if (!attempt.connected) {
+        return;
+    }
+
+    if (!attempt.out.empty()) {
+        ssize_t n = ::send(attempt.fd, attempt.out.data(), attempt.out.size(), MSG_NOSIGNAL);
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            failAttempt(attempt, std::strerror(errno));
+            return;
+        }
+        if (n > 0) {
+            attempt.out.erase(0, static_cast<size_t>(n));
+        }
+        if (attempt.out.empty()) {
+            struct epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.u64 = attempt.key;
+            ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, attempt.fd, &event);
+        }
+    }
+
+    bool closed = false;
+    while (true) {
+        ssize_t n = ::recv(attempt.fd, buffer_.data(), buffer_.size(), MSG_DONTWAIT);
+        if (n > 0) {
+            attempt.in.append(reinterpret_cast<const char*>(buffer_.data()), static_cast<size_t>(n));
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            failAttempt(attempt, std::strerror(errno));
+            return;
+        }
+        closed = n == 0;
+        break;
+    }
+
+    // Two-byte length prefix, then the message
+    if (attempt.in.size() >= 2) {
+        size_t length = read16(reinterpret_cast<const uint8_t*>(attempt.in.data()));
+        if (attempt.in.size() >= length + 2) {
+            if (!handleMessage(attempt, reinterpret_cast<const uint8_t*>(attempt.in.data()) + 2, length)) {
+                failAttempt(attempt, "malformed answer over TCP");
+            }
+            return;
+        }
+    }
+    if (closed) {
+        failAttempt(attempt, "connection closed");
+    }
+}
+
+bool DnsEngine::handleMessage(Attempt& attempt, const uint8_t* data, size_t length) {
+    Pending& query = *queries_.at(attempt.query);
+
+    // Anything not answering our question from our socket is ignored
+    ParsedHeader header;
+    Response response;
+    if (!parseMessage(data, length, header, response) || header.id != attempt.wire_id ||
+        header.question != query.name || header.question_type != query.query.type) {
+        return false;
+    }
+    if (header.truncated && !attempt.tcp) {
+        switchToTcp(attempt, query);
+        return true;
+    }
+
+    double rtt = millisecondsSince(attempt.started);
+    response.truncated = attempt.truncated;
+    response.server = query.timings[attempt.server].server;
+    response.query_time_ms = rtt;
+    query.timings[attempt.server].rtt_ms = rtt;
+
+    uint64_t key = attempt.key;
+    settle(query, attempt.server, &response, "");
+    attempts_.erase(key);
+    return true;
+}
+
+void DnsEngine::failAttempt(Attempt& attempt, const std::string& why) {
+    Pending& query = *queries_.at(attempt.query);
+    query.timings[attempt.server].rtt_ms = millisecondsSince(attempt.started);
+    uint64_t key = attempt.key;
+    settle(query, attempt.server, nullptr, why);
+    attempts_.erase(key);
+}
+
+void DnsEngine::settle(Pending& query, size_t server_index, const Response* response, const std::string& why) {
+    ServerTiming& timing = query.timings[server_index];
+    --query.outstanding;
+
+    if (response) {
+        timing.answered = true;
+        timing.status = response->status;
+        // SERVFAIL and REFUSED only stand when nobody does better
+        bool final = response->status == "NOERROR" || response->status == "NXDOMAIN";
+        if (final && !query.answered) {
+            query.response = *response;
+            query.answered = true;
+        } else if (!query.answered && query.response.status.empty()) {
+            query.response = *response;
+        }
+    } else {
+        timing.status = why;
+    }
+
+    if ((query.answered && !query.query.all_servers) || query.outstanding == 0) {
+        query.done = true;
+    }
+}
+
+void DnsEngine::checkDeadlines() {
+    auto now = std::chrono::steady_clock::now();
+    std::vector<uint64_t> expired;
+    for (const auto& [key, attempt] : attempts_) {
+        if (attempt->deadline <= now) {
+            expired.push_back(key);
+        }
+    }
+
+    for (uint64_t key : expired) {
+        auto it = attempts_.find(key);
+        if (it == attempts_.end()) {
+            continue;
+        }
+        Attempt& attempt = *it->second;
+        const Query& query = queries_.at(attempt.query)->query;
+        if (!attempt.tcp && attempt.sends < query.attempts) {
+            if (!sendUdp(attempt)) {
+                failAttempt(attempt, std::strerror(errno));
+            }
+        } else {
+            failAttempt(attempt, "timed out");
+        }
+    }
+}
+
+void DnsEngine::reactorLoop() {
+    std::vector<epoll_event> events(64);
+
+    while (!stopping_.load()) {
+        adoptPending();
+        checkDeadlines();
+
+        std::vector<uint64_t> done;
+        for (const auto& [id, query] : queries_) {
+            if (query->done) {
+                done.push_back(id);
+            }
+        }
+        for (uint64_t id : done) {
+            finish(id);
+        }
+
+        int ready = ::epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), nextTimeoutMs());
+        for (int i = 0; i < ready; ++i) {
+            uint64_t key = events[i].data.u64;
+            if (key == WAKE_KEY) {
+                uint64_t count;
+                [[maybe_unused]] ssize_t drained = ::read(wake_fd_, &count, sizeof(count));
+                continue;
+            }
+            // An earlier event in this batch may have finished the attempt
+            auto it = attempts_.find(key);
+            if (it != attempts_.end()) {
+                handleEvent(*it->second, events[i].events);
+            }
+        }
+    }
+
+    // Shutting down: everything still queued or running fails
+    adoptPending();
+    while (!queries_.empty()) {
+        finish(queries_.begin()->first);
+    }
+}
+
+void DnsEngine::finish(uint64_t id) {
+    auto it = queries_.find(id);
+    if (it == queries_.end()) {
+        return;
+    }
+    std::unique_ptr<Pending> query = std::move(it->second);
+    queries_.erase(it);
+    for (auto attempt = attempts_.begin(); attempt != attempts_.end();) {
+        attempt = attempt->second->query == id ? attempts_.erase(attempt) : std::next(attempt);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        live_.erase(id);
+    }
+
+    Response& response = query->response;
+    response.servers = query->timings;
+    if (response.status.empty()) {
+        if (stopping_.load()) {
+            response.error = "DNS engine shut down";
+        } else {
+            response.error = "no servers could be reached";
+            if (query->timings.size() == 1) {
+                response.error += ": " + query->timings.front().status;
+            }
+        }
+    }
+    if (query->answered) {
+        storeCache(query->key, response);
+    }
+
+    if (query->query.on_done) {
+        try {
+            query->query.on_done(response);
+        } catch (const std::exception& e) {
+            ENDPOINT_LOG("dns-resolver", "Completion callback threw: " + std::string(e.what()));
+        }
+    }
+}
+
+int DnsEngine::nextTimeoutMs() const {
+    if (attempts_.empty()) {
+        return -1;
+    }
+    auto next = std::chrono::steady_clock::time_point::max();
+    for (const auto& [key, attempt] : attempts_) {
+        next = std::min(next, attempt->deadline);
+    }
+    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next - std::chrono::steady_clock::now());
+    return static_cast<int>(std::clamp<int64_t>(wait.count() + 1, 0, 60000));
+}
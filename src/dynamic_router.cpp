@@ -4,201 +4,233 @@
 #include <algorithm>
 #include "endpoint_logger.h"
 
+namespace {
+    // Upper bound on path depth handled by the trie; deeper paths never match
+    constexpr size_t MAX_ROUTE_SEGMENTS = 64;
+}
+
 DynamicRouter::DynamicRouter() {
     ENDPOINT_LOG("router", "DynamicRouter initialized");
 }
 
-void DynamicRouter::addRoute(const std::string& pattern, 
-                            std::function<std::string(const std::string&, const std::map<std::string, std::string>&, const std::string&)> handler) {
-    
+void DynamicRouter::addRoute(const std::string& pattern, RouteHandlerFunction handler) {
     ENDPOINT_LOG("router", "Registering dynamic route pattern: " + pattern);
-    
-    RoutePattern route;
-    route.pattern = pattern;
-    route.handler = handler;
-    
-    auto compiled = compilePattern(pattern);
-    route.regex_pattern = compiled.first;
-    route.param_names = compiled.second;
-    
-    dynamic_routes_.push_back(route);
+    insertPattern(pattern, false).dynamic_handler = std::move(handler);
 }
 
-void DynamicRouter::addStaticRoute(const std::string& path,
-                                  std::function<std::string(const std::string&, const std::map<std::string, std::string>&, const std::string&)> handler) {
-    
+void DynamicRouter::addStaticRoute(const std::string& path, RouteHandlerFunction handler) {
     ENDPOINT_LOG("router", "Registering static route: " + path);
-    static_routes_[path] = handler;
+    insertPattern(path, true).dynamic_handler = std::move(handler);
+}
+
+void DynamicRouter::addStructuredRoute(const std::string& path, RouteProcessor processor) {
+    insertPattern(path, true).structured_processor = std::move(processor);
+}
+
+void DynamicRouter::addLegacyRoute(const std::string& path, RouteHandlerFunction handler) {
+    insertPattern(path, true).legacy_handler = std::move(handler);
+}
+
+void DynamicRouter::addStreamingRoute(const std::string& path, StreamingRouteFactory factory) {
+    insertPattern(path, true).streaming_factory = std::move(factory);
 }
 
-std::string DynamicRouter::processRequest(const std::string& method, const std::string& path, 
-                                         const std::map<std::string, std::string>& query_params, 
+void DynamicRouter::addDownloadRoute(const std::string& pattern, DownloadRouteResolver resolver) {
+    ENDPOINT_LOG("router", "Registering download route pattern: " + pattern);
+    insertPattern(pattern, false).download_resolver = std::move(resolver);
+}
+
+std::string DynamicRouter::processRequest(const std::string& method, const std::string& path,
+                                         const std::map<std::string, std::string>& query_params,
                                          const std::string& body) {
-    
+
     ENDPOINT_LOG("router", "Processing request: " + method + " " + path);
-    
-    // First, check static routes for exact match
-    auto static_it = static_routes_.find(path);
-    if (static_it != static_routes_.end()) {
-        ENDPOINT_LOG("router", "Matched static route: " + path);
-        return static_it->second(method, query_params, body);
-    }
-    
-    // Then check dynamic routes
-    for (const auto& route : dynamic_routes_) {
-        std::smatch matches;
-        if (std::regex_match(path, matches, route.regex_pattern)) {
-            ENDPOINT_LOG("router", "Matched dynamic route pattern: " + route.pattern);
-            
-            // Extract path parameters
-            std::map<std::string, std::string> combined_params = query_params;
-            
-            // Add path parameters
-            for (size_t i = 1; i < matches.size() && i - 1 < route.param_names.size(); ++i) {
-                combined_params[route.param_names[i - 1]] = matches[i].str();
-            }
-            
-            // Log extracted parameters
-            if (!combined_params.empty()) {
-                std::string params_str = "Extracted parameters: ";
-                for (const auto& param : combined_params) {
-                    params_str += param.first + "=" + param.second + " ";
-                }
-                ENDPOINT_LOG("router", params_str);
-            }
-            
-            return route.handler(method, combined_params, body);
+
+    RouteMatch match = findMatch(path);
+    if (match.matched && match.entry->dynamic_handler) {
+        ENDPOINT_LOG("router", "Matched dynamic route pattern: " + match.matched_pattern);
+
+        std::map<std::string, std::string> combined_params = query_params;
+        for (const auto& param : match.path_params) {
+            combined_params[param.first] = param.second;
         }
+
+        return match.entry->dynamic_handler(method, combined_params, body);
     }
-    
+
     ENDPOINT_LOG("router", "No route matched for path: " + path);
     return "{\"error\":\"Route not found\",\"path\":\"" + path + "\",\"status\":404}";
 }
 
-RouteMatch DynamicRouter::findMatch(const std::string& path) const {
+RouteMatch DynamicRouter::findMatch(std::string_view path, std::string_view method) const {
     RouteMatch result;
-    
-    // Check static routes first
-    if (static_routes_.find(path) != static_routes_.end()) {
-        result.matched = true;
-        result.matched_pattern = path;
+
+    std::string_view segments[MAX_ROUTE_SEGMENTS];
+    size_t segment_count = splitPath(path, segments, MAX_ROUTE_SEGMENTS);
+    if (segment_count == 0) {
         return result;
     }
-    
-    // Check dynamic routes
-    for (const auto& route : dynamic_routes_) {
-        std::smatch matches;
-        if (std::regex_match(path, matches, route.regex_pattern)) {
-            result.matched = true;
-            result.matched_pattern = route.pattern;
-            
-            // Extract path parameters
-            for (size_t i = 1; i < matches.size() && i - 1 < route.param_names.size(); ++i) {
-                result.path_params[route.param_names[i - 1]] = matches[i].str();
-            }
-            
-            return result;
-        }
+
+    std::string_view captures[MAX_ROUTE_SEGMENTS];
+    size_t capture_count = 0;
+    const RouteEntry* entry = matchNode(&root_, segments, segment_count, 0, path, captures, capture_count);
+    if (!entry) {
+        return result;
     }
-    
+
+    result.matched = true;
+    result.entry = entry;
+    result.matched_pattern = entry->pattern;
+
+    if (entry->streaming_factory && (method == "POST" || method == "PUT")) {
+        result.kind = RouteKind::STREAMING;
+    } else if (entry->download_resolver && (method == "GET" || method == "HEAD")) {
+        result.kind = RouteKind::DOWNLOAD;
+    } else if (entry->structured_processor) {
+        result.kind = RouteKind::STRUCTURED;
+    } else if (entry->dynamic_handler) {
+        result.kind = RouteKind::DYNAMIC;
+    } else if (entry->legacy_handler) {
+        result.kind = RouteKind::LEGACY;
+    } else {
+        // Only a streaming or download route exists at this path and the
+        // method does not suit it; the streaming branch answers 405
+        result.kind = RouteKind::STREAMING;
+    }
+
+    for (size_t i = 0; i < capture_count && i < entry->param_names.size(); ++i) {
+        result.path_params.emplace(entry->param_names[i], std::string(captures[i]));
+    }
+
     return result;
 }
 
 std::vector<std::string> DynamicRouter::getRegisteredPatterns() const {
-    std::vector<std::string> patterns;
-    
-    // Add static routes
-    for (const auto& route : static_routes_) {
-        patterns.push_back(route.first);
-    }
-    
-    // Add dynamic routes
-    for (const auto& route : dynamic_routes_) {
-        patterns.push_back(route.pattern);
-    }
-    
-    return patterns;
+    return patterns_;
 }
 
-std::pair<std::regex, std::vector<std::string>> DynamicRouter::compilePattern(const std::string& pattern) {
-    std::string regex_pattern = pattern;
+RouteEntry& DynamicRouter::insertPattern(const std::string& pattern, bool literal) {
+    std::string_view segments[MAX_ROUTE_SEGMENTS];
+    size_t segment_count = splitPath(pattern, segments, MAX_ROUTE_SEGMENTS);
+
+    RouteNode* node = &root_;
     std::vector<std::string> param_names;
-    
-    // Replace {param} with regex capture groups
-    std::regex param_regex(R"(\{([^}]+)\})");
-    std::smatch matches;
-    
-    size_t offset = 0;
-    std::string::const_iterator start = regex_pattern.cbegin();
-    
-    while (std::regex_search(start, regex_pattern.cend(), matches, param_regex)) {
-        // Extract parameter name
-        param_names.push_back(matches[1].str());
-        
-        // Calculate position and replace with regex
-        size_t pos = offset + matches.position();
-        regex_pattern.replace(pos, matches.length(), "([^/]+)");
-        
-        // Update offset and iterator
-        offset = pos + 7; // Length of "([^/]+)"
-        start = regex_pattern.cbegin() + offset;
+
+    for (size_t i = 0; i < segment_count; ++i) {
+        std::string_view segment = segments[i];
+        std::string param_name;
+
+        if (!literal && segment == "*") {
+            // Wildcard swallows the rest of the path, so any following segments are meaningless
+            if (i + 1 < segment_count) {
+                ENDPOINT_LOG("router", "Ignoring segments after wildcard in pattern: " + pattern);
+            }
+            if (!node->wildcard_entry) {
+                node->wildcard_entry = std::make_unique<RouteEntry>();
+                node->wildcard_entry->pattern = pattern;
+                patterns_.push_back(pattern);
+            }
+            node->wildcard_entry->param_names = param_names;
+            return *node->wildcard_entry;
+        }
+
+        if (!literal && isCaptureSegment(segment, param_name)) {
+            if (!node->param_child) {
+                node->param_child = std::make_unique<RouteNode>();
+            }
+            param_names.push_back(param_name);
+            node = node->param_child.get();
+            continue;
+        }
+
+        auto it = node->static_children.find(segment);
+        if (it == node->static_children.end()) {
+            it = node->static_children.emplace(std::string(segment), std::make_unique<RouteNode>()).first;
+        }
+        node = it->second.get();
     }
-    
-    // Handle wildcard patterns (*)
-    std::regex wildcard_regex(R"(\*)");
-    regex_pattern = std::regex_replace(regex_pattern, wildcard_regex, "(.*)");
-    
-    // Add anchors to ensure full path matching
-    regex_pattern = "^" + regex_pattern + "$";
-    
-    ENDPOINT_LOG("router", "Compiled pattern '" + pattern + "' to regex '" + regex_pattern + "'");
-    
-    try {
-        std::regex compiled_regex(regex_pattern);
-        return std::make_pair(compiled_regex, param_names);
-    } catch (const std::regex_error& e) {
-        ENDPOINT_LOG("router", "Regex compilation error for pattern '" + pattern + "': " + e.what());
-        // Return a regex that matches nothing
-        return std::make_pair(std::regex("^$"), param_names);
+
+    if (!node->entry) {
+        node->entry = std::make_unique<RouteEntry>();
+        node->entry->pattern = pattern;
+        patterns_.push_back(pattern);
     }
+    node->entry->param_names = param_names;
+    return *node->entry;
 }
 
-std::map<std::string, std::string> DynamicRouter::extractPathParams(const std::string& path, const RoutePattern& route) const {
-    std::map<std::string, std::string> params;
-    std::smatch matches;
-    
-    if (std::regex_match(path, matches, route.regex_pattern)) {
-        for (size_t i = 1; i < matches.size() && i - 1 < route.param_names.size(); ++i) {
-            params[route.param_names[i - 1]] = matches[i].str();
+const RouteEntry* DynamicRouter::matchNode(const RouteNode* node, const std::string_view* segments,
+                                           size_t segment_count, size_t depth,
+                                           std::string_view path, std::string_view* captures,
+                                           size_t& capture_count) const {
+    if (depth == segment_count) {
+        return node->entry.get();
+    }
+
+    std::string_view segment = segments[depth];
+
+    // 1. Literal segment
+    auto it = node->static_children.find(segment);
+    if (it != node->static_children.end()) {
+        const RouteEntry* entry = matchNode(it->second.get(), segments, segment_count, depth + 1,
+                                            path, captures, capture_count);
+        if (entry) {
+            return entry;
         }
     }
-    
-    return params;
-}
 
-std::string DynamicRouter::escapeRegex(const std::string& input) {
-    std::string escaped;
-    for (char c : input) {
-        if (c == '.' || c == '^' || c == '$' || c == '*' || c == '+' || c == '?' || 
-            c == '(' || c == ')' || c == '[' || c == ']' || c == '{' || c == '}' || 
-            c == '\\' || c == '|') {
-            escaped += '\\';
+    // 2. Capture segment (never matches an empty segment)
+    if (node->param_child && !segment.empty()) {
+        size_t saved_count = capture_count;
+        captures[capture_count++] = segment;
+        const RouteEntry* entry = matchNode(node->param_child.get(), segments, segment_count, depth + 1,
+                                            path, captures, capture_count);
+        if (entry) {
+            return entry;
         }
-        escaped += c;
+        capture_count = saved_count;
+    }
+
+    // 3. Trailing wildcard matches the remainder of the path, slashes included
+    if (node->wildcard_entry) {
+        return node->wildcard_entry.get();
+    }
+
+    return nullptr;
+}
+
+bool DynamicRouter::isCaptureSegment(std::string_view segment, std::string& name) {
+    if (segment.size() > 2 && segment.front() == '{' && segment.back() == '}') {
+        name.assign(segment.substr(1, segment.size() - 2));
+        return true;
+    }
+    if (segment.size() > 1 && segment.front() == ':') {
+        name.assign(segment.substr(1));
+        return true;
     }
-    return escaped;
+    return false;
 }
 
-std::vector<std::string> DynamicRouter::splitPath(const std::string& path) {
-    std::vector<std::string> segments;
-    std::stringstream ss(path);
-    std::string segment;
-    
-    while (std::getline(ss, segment, '/')) {
-        if (!segment.empty()) {
-            segments.push_back(segment);
+size_t DynamicRouter::splitPath(std::string_view path, std::string_view* segments, size_t max_segments) {
+    // Paths must be absolute. Empty segments are kept, so "/a/b" and "/a/b/" stay distinct routes.
+    if (path.empty() || path.front() != '/') {
+        return 0;
+    }
+
+    size_t count = 0;
+    size_t start = 1;
+    while (true) {
+        if (count == max_segments) {
+            return 0;
         }
+        size_t slash = path.find('/', start);
+        if (slash == std::string_view::npos) {
+            segments[count++] = path.substr(start);
+            break;
+        }
+        segments[count++] = path.substr(start, slash - start);
+        start = slash + 1;
     }
-    
-    return segments;
-}
\ No newline at end of file
+
+    return count;
+}
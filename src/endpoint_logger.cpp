@@ -1,54 +1,271 @@
 #include "endpoint_logger.h"
-#include <chrono>
-#include <iomanip>
-#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
 
 EndpointLogger& EndpointLogger::getInstance() {
-    static EndpointLogger instance;
-    return instance;
+    // Never destroyed: static destructors elsewhere may still log during exit.
+    // The atexit hook drains the ring and stops the writer instead.
+    static EndpointLogger* instance = []() {
+        auto* logger = new EndpointLogger();
+        std::atexit([]() { EndpointLogger::getInstance().shutdown(); });
+        return logger;
+    }();
+    return *instance;
+}
+
+EndpointLogger::EndpointLogger()
+    : slots_(new Slot[RING_CAPACITY]) {
+    for (size_t i = 0; i < RING_CAPACITY; ++i) {
+        slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    // Overflow group shared by every name past MAX_GROUPS
+    groups_[MAX_GROUPS - 1].name = "other";
+
+    running_.store(true, std::memory_order_release);
+    writer_ = std::thread(&EndpointLogger::writerLoop, this);
 }
 
 void EndpointLogger::setEndpointFilters(const std::map<std::string, bool>& filters) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::lock_guard<std::mutex> lock(registry_mutex_);
     endpoint_filters_ = filters;
+
+    // Groups not mentioned in the config default to enabled
+    size_t count = group_count_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < count; ++i) {
+        auto it = endpoint_filters_.find(groups_[i].name);
+        groups_[i].enabled.store(it == endpoint_filters_.end() || it->second, std::memory_order_relaxed);
+    }
 }
 
-bool EndpointLogger::isLoggingEnabled(const std::string& endpoint_group) const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    auto it = endpoint_filters_.find(endpoint_group);
-    if (it != endpoint_filters_.end()) {
-        return it->second;
+EndpointLogger::GroupId EndpointLogger::internGroup(std::string_view endpoint_group) {
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+
+    auto existing = group_ids_.find(endpoint_group);
+    if (existing != group_ids_.end()) {
+        return existing->second;
     }
-    // Default to true if group not found in config
-    return true;
+
+    size_t index = group_count_.load(std::memory_order_relaxed);
+    if (index >= MAX_GROUPS - 1) {
+        return static_cast<GroupId>(MAX_GROUPS - 1);
+    }
+
+    Group& group = groups_[index];
+    group.name.assign(endpoint_group);
+    auto filter = endpoint_filters_.find(group.name);
+    group.enabled.store(filter == endpoint_filters_.end() || filter->second, std::memory_order_relaxed);
+
+    group_ids_.emplace(group.name, static_cast<GroupId>(index));
+    group_count_.store(index + 1, std::memory_order_release);
+    return static_cast<GroupId>(index);
 }
 
-void EndpointLogger::log(const std::string& endpoint_group, const std::string& message) {
-    if (!isLoggingEnabled(endpoint_group)) {
+bool EndpointLogger::isLoggingEnabled(const std::string& endpoint_group) {
+    return isEnabled(internGroup(endpoint_group));
+}
+
+void EndpointLogger::write(GroupId group, Level level, std::string message) {
+    Record record;
+    record.time = std::chrono::system_clock::now();
+    record.group = group;
+    record.level = level;
+    record.message = std::move(message);
+
+    if (!running_.load(std::memory_order_acquire)) {
+        // Writer already stopped (process exit): write synchronously
+        std::lock_guard<std::mutex> lock(sync_write_mutex_);
+        std::string line;
+        appendFormatted(line, record);
+        writeOut(line);
         return;
     }
-    
-    // Get current timestamp
-    auto now = std::chrono::system_clock::now();
-    auto time_t = std::chrono::system_clock::to_time_t(now);
-    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-        now.time_since_epoch()) % 1000;
-    
-    std::ostringstream timestamp;
-    timestamp << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
-    timestamp << "." << std::setfill('0') << std::setw(3) << ms.count();
-    
-    std::cout << "[" << timestamp.str() << "] [" << endpoint_group << "] " << message << std::endl;
+
+    if (!tryPush(std::move(record))) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    if (writer_idle_.load(std::memory_order_relaxed)) {
+        wake_cv_.notify_one();
+    }
+}
+
+void EndpointLogger::log(const std::string& endpoint_group, const std::string& message) {
+    GroupId group = internGroup(endpoint_group);
+    if (isEnabled(group)) {
+        write(group, Level::PLAIN, message);
+    }
 }
 
 void EndpointLogger::logInfo(const std::string& endpoint_group, const std::string& message) {
-    log(endpoint_group, "[INFO] " + message);
+    GroupId group = internGroup(endpoint_group);
+    if (isEnabled(group)) {
+        write(group, Level::INFO, message);
+    }
 }
 
 void EndpointLogger::logWarning(const std::string& endpoint_group, const std::string& message) {
-    log(endpoint_group, "[WARNING] " + message);
+    GroupId group = internGroup(endpoint_group);
+    if (isEnabled(group)) {
+        write(group, Level::WARNING, message);
+    }
 }
 
 void EndpointLogger::logError(const std::string& endpoint_group, const std::string& message) {
-    log(endpoint_group, "[ERROR] " + message);
-}
\ No newline at end of file
+    GroupId group = internGroup(endpoint_group);
+    if (isEnabled(group)) {
+        write(group, Level::ERROR, message);
+    }
+}
+
+void EndpointLogger::flush() {
+    size_t target = enqueue_pos_.load(std::memory_order_acquire);
+    while (running_.load(std::memory_order_acquire) &&
+           written_pos_.load(std::memory_order_acquire) < target) {
+        wake_cv_.notify_one();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void EndpointLogger::shutdown() {
+    if (!running_.exchange(false, std::memory_order_acq_rel)) {
+        return;
+    }
+    wake_cv_.notify_one();
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+}
+
+// Claim a slot whose sequence equals the enqueue position, then publish it
+// by advancing the sequence. A slot still holding an unread record means the
+// ring is full.
+bool EndpointLogger::tryPush(Record&& record) {
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+        slot = &slots_[pos & (RING_CAPACITY - 1)];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->record = std::move(record);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+// Single consumer: only the writer thread (or shutdown drain) pops
+bool EndpointLogger::tryPop(Record& record) {
+    Slot& slot = slots_[dequeue_pos_ & (RING_CAPACITY - 1)];
+    size_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence != dequeue_pos_ + 1) {
+        return false;
+    }
+
+    record = std::move(slot.record);
+    slot.record.message = std::string();
+    slot.sequence.store(dequeue_pos_ + RING_CAPACITY, std::memory_order_release);
+    ++dequeue_pos_;
+    return true;
+}
+
+void EndpointLogger::writerLoop() {
+    std::string batch;
+    batch.reserve(64 * 1024);
+    Record record;
+    uint64_t reported_dropped = 0;
+
+    while (true) {
+        size_t popped = 0;
+        while (popped < WRITE_BATCH_SIZE && tryPop(record)) {
+            appendFormatted(batch, record);
+            ++popped;
+        }
+
+        uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+        if (dropped != reported_dropped) {
+            batch += "[endpoint_logger] " + std::to_string(dropped - reported_dropped) +
+                     " messages dropped (log ring full)\n";
+            reported_dropped = dropped;
+        }
+
+        if (!batch.empty()) {
+            writeOut(batch);
+            batch.clear();
+        }
+        written_pos_.store(dequeue_pos_, std::memory_order_release);
+
+        if (popped == WRITE_BATCH_SIZE) {
+            continue;
+        }
+
+        if (!running_.load(std::memory_order_acquire)) {
+            // Producers that raced with shutdown may still be publishing; one
+            // final drain catches everything already claimed
+            while (tryPop(record)) {
+                appendFormatted(batch, record);
+            }
+            if (!batch.empty()) {
+                writeOut(batch);
+            }
+            written_pos_.store(dequeue_pos_, std::memory_order_release);
+            return;
+        }
+
+        // Idle: sleep until a producer nudges us, with a timeout so a missed
+        // notification only delays output slightly
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        writer_idle_.store(true, std::memory_order_relaxed);
+        wake_cv_.wait_for(lock, std::chrono::milliseconds(50));
+        writer_idle_.store(false, std::memory_order_relaxed);
+    }
+}
+
+void EndpointLogger::appendFormatted(std::string& out, const Record& record) {
+    auto since_epoch = record.time.time_since_epoch();
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(since_epoch);
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(since_epoch - seconds).count();
+
+    // localtime_r/strftime only once per second of log output
+    if (seconds.count() != cached_second_) {
+        std::time_t time_t = static_cast<std::time_t>(seconds.count());
+        std::tm tm{};
+        localtime_r(&time_t, &tm);
+        std::strftime(cached_timestamp_, sizeof(cached_timestamp_), "%Y-%m-%d %H:%M:%S", &tm);
+        cached_second_ = seconds.count();
+    }
+
+    char millis[8];
+    std::snprintf(millis, sizeof(millis), ".%03d", static_cast<int>(ms));
+
+    out += '[';
+    out += cached_timestamp_;
+    out += millis;
+    out += "] [";
+    out += groups_[record.group].name;
+    out += "] ";
+    switch (record.level) {
+        case Level::INFO:    out += "[INFO] "; break;
+        case Level::WARNING: out += "[WARNING] "; break;
+        case Level::ERROR:   out += "[ERROR] "; break;
+        case Level::PLAIN:   break;
+    }
+    out += record.message;
+    out += '\n';
+}
+
+void EndpointLogger::writeOut(const std::string& text) {
+    std::fwrite(text.data(), 1, text.size(), stdout);
+    std::fflush(stdout);
+}
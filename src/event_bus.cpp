@@ -0,0 +1,246 @@
+#include "event_bus.h"
+#include <algorithm>
+
+EventBus::Subscription::Subscription(std::vector<std::string> topics)
+    : topics_(std::move(topics)) {
+}
+
+bool EventBus::Subscription::matches(const std::string& topic) const {
+    if (topics_.empty()) {
+        return true;
+    }
+    return std::any_of(topics_.begin(), topics_.end(), [&](const std::string& filter) {
+        return EventBus::topicMatches(filter, topic);
+    });
+}
+
+bool EventBus::Subscription::pop(Frame& frame, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait_for(lock, timeout, [this]() { return !queue_.empty() || closed_; });
+    if (queue_.empty()) {
+        return false;
+    }
+    frame = std::move(queue_.front());
+    queue_.pop_front();
+    return true;
+}
+
+EventBus::Subscription::PopResult EventBus::Subscription::popOrPark(Frame& frame,
+                                                                    const std::function<void()>& park) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!queue_.empty()) {
+        frame = std::move(queue_.front());
+        queue_.pop_front();
+        return PopResult::FRAME;
+    }
+    if (closed_) {
+        return PopResult::CLOSED;
+    }
+    park();
+    parked_ = true;
+    return PopResult::PARKED;
+}
+
+void EventBus::Subscription::setWakeHook(std::function<void()> hook) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    wake_hook_ = std::move(hook);
+}
+
+void EventBus::Subscription::push(const Frame& frame) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_) {
+        return;
+    }
+    if (queue_.size() >= MAX_QUEUED_FRAMES) {
+        // The client is not keeping up: lose the oldest frames, not the newest
+        queue_.pop_front();
+        ++dropped_;
+    }
+    queue_.push_back(frame);
+    cv_.notify_one();
+    wakeLocked();
+}
+
+void EventBus::Subscription::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    cv_.notify_all();
+    wakeLocked();
+}
+
+bool EventBus::Subscription::isClosed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return closed_;
+}
+
+uint64_t EventBus::Subscription::droppedFrames() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_;
+}
+
+void EventBus::Subscription::wakeLocked() {
+    if (!parked_) {
+        return;
+    }
+    parked_ = false;
+    if (wake_hook_) {
+        wake_hook_();
+    }
+}
+
+EventBus& EventBus::getInstance() {
+    static EventBus instance;
+    return instance;
+}
+
+EventBus::~EventBus() {
+    shutdown();
+}
+
+// "firmware" matches "firmware" and "firmware.tftp", but not "firmwarex"
+bool EventBus::topicMatches(const std::string& filter, const std::string& topic) {
+    if (topic.size() < filter.size() || topic.compare(0, filter.size(), filter) != 0) {
+        return false;
+    }
+    return topic.size() == filter.size() || topic[filter.size()] == '.';
+}
+
+void EventBus::publish(const std::string& topic, const std::string& data) {
+    std::vector<std::shared_ptr<Subscription>> targets;
+    Frame frame;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) {
+            return;
+        }
+
+        // The data field cannot span lines, so each line gets its own "data:"
+        uint64_t id = ++next_id_;
+        std::string text = "id: " + std::to_string(id) + "\nevent: " + topic + "\n";
+        text.reserve(text.size() + data.size() + 16);
+        size_t start = 0;
+        while (true) {
+            size_t end = data.find('\n', start);
+            text += "data: ";
+            text.append(data, start, end == std::string::npos ? std::string::npos : end - start);
+            text += '\n';
+            if (end == std::string::npos) {
+                break;
+            }
+            start = end + 1;
+        }
+        text += '\n';
+
+        frame = std::make_shared<const std::string>(std::move(text));
+        retained_[topic] = {id, frame};
+        for (const auto& subscription : subscriptions_) {
+            if (subscription->matches(topic)) {
+                targets.push_back(subscription);
+            }
+        }
+    }
+
+    // Queue outside the bus lock: waking a subscriber may call into libmicrohttpd
+    for (const auto& subscription : targets) {
+        subscription->push(frame);
+    }
+}
+
+void EventBus::publish(const std::string& topic, const nlohmann::json& data) {
+    publish(topic, data.dump());
+}
+
+bool EventBus::hasSubscribers(const std::string& topic) const {
+    if (subscriber_count_.load(std::memory_order_relaxed) == 0) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::any_of(subscriptions_.begin(), subscriptions_.end(),
+                       [&](const std::shared_ptr<Subscription>& subscription) {
+        return subscription->matches(topic);
+    });
+}
+
+size_t EventBus::subscriberCount() const {
+    return subscriber_count_.load(std::memory_order_relaxed);
+}
+
+std::shared_ptr<EventBus::Subscription> EventBus::subscribe(std::vector<std::string> topics) {
+    auto subscription = std::make_shared<Subscription>(std::move(topics));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+        subscription->close();
+        return subscription;
+    }
+
+    // Replay current state in publish order so the client's last event id stays monotonic
+    std::vector<std::pair<uint64_t, Frame>> replay;
+    for (const auto& [topic, retained] : retained_) {
+        if (subscription->matches(topic)) {
+            replay.push_back(retained);
+        }
+    }
+    std::sort(replay.begin(), replay.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    for (const auto& [id, frame] : replay) {
+        subscription->push(frame);
+    }
+
+    subscriptions_.push_back(subscription);
+    subscriber_count_.store(subscriptions_.size(), std::memory_order_relaxed);
+    startKeepaliveLocked();
+    return subscription;
+}
+
+void EventBus::unsubscribe(const std::shared_ptr<Subscription>& subscription) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        subscriptions_.erase(std::remove(subscriptions_.begin(), subscriptions_.end(), subscription),
+                             subscriptions_.end());
+        subscriber_count_.store(subscriptions_.size(), std::memory_order_relaxed);
+    }
+    subscription->close();
+}
+
+void EventBus::shutdown() {
+    std::vector<std::shared_ptr<Subscription>> closing;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        closing.swap(subscriptions_);
+        subscriber_count_.store(0, std::memory_order_relaxed);
+    }
+    keepalive_cv_.notify_all();
+
+    for (const auto& subscription : closing) {
+        subscription->close();
+    }
+    if (keepalive_thread_.joinable()) {
+        keepalive_thread_.join();
+    }
+}
+
+void EventBus::startKeepaliveLocked() {
+    if (!keepalive_thread_.joinable()) {
+        keepalive_thread_ = std::thread(&EventBus::keepaliveLoop, this);
+    }
+}
+
+// Comment lines are ignored by EventSource; they keep proxies from timing the
+// stream out and let the server notice clients that went away silently
+void EventBus::keepaliveLoop() {
+    static const Frame keepalive = std::make_shared<const std::string>(": keepalive\n\n");
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        if (keepalive_cv_.wait_for(lock, KEEPALIVE_INTERVAL, [this]() { return stopping_; })) {
+            break;
+        }
+        std::vector<std::shared_ptr<Subscription>> targets = subscriptions_;
+        lock.unlock();
+        for (const auto& subscription : targets) {
+            subscription->push(keepalive);
+        }
+        lock.lock();
+    }
+}
@@ -0,0 +1,233 @@
+#include "event_stream.h"
+#include "event_bus.h"
+#include "endpoint_logger.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace {
+
+// Sent first: confirms the stream and sets the client's reconnect delay
+const EventBus::Frame STREAM_PREAMBLE = std::make_shared<const std::string>(": connected\nretry: 3000\n\n");
+
+struct Stream {
+    std::shared_ptr<EventBus::Subscription> subscription;
+    struct MHD_Connection* connection = nullptr;
+    bool suspend_when_idle = false;
+    EventBus::Frame frame;      // Frame being written
+    size_t offset = 0;          // Bytes of `frame` already handed to MHD
+};
+
+// Streams whose connections are still open, so that closeAll() can end
+// them and wait until libmicrohttpd has released every one
+struct OpenStreams {
+    std::mutex mutex;
+    std::condition_variable drained;
+    std::set<Stream*> streams;
+    bool accepting = true;
+};
+
+OpenStreams& openStreams() {
+    static OpenStreams instance;
+    return instance;
+}
+
+std::vector<std::string> parseTopics(const char* value) {
+    std::vector<std::string> topics;
+    if (!value) {
+        return topics;
+    }
+    std::string list(value);
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        std::string topic = list.substr(start, end - start);
+        topic.erase(0, topic.find_first_not_of(' '));
+        topic.erase(topic.find_last_not_of(' ') + 1);
+        if (!topic.empty()) {
+            topics.push_back(topic);
+        }
+        start = end + 1;
+    }
+    return topics;
+}
+
+// Fetch the next frame. Returns false when the stream should end; sets
+// `parked` when the connection was suspended until the next publish.
+bool nextFrame(Stream* stream, bool& parked) {
+    parked = false;
+    if (!stream->suspend_when_idle) {
+        // Thread per connection: this thread belongs to the stream anyway.
+        // The keepalive frames bound the wait.
+        while (!stream->subscription->pop(stream->frame, EventBus::KEEPALIVE_INTERVAL * 2)) {
+            if (stream->subscription->isClosed()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    switch (stream->subscription->popOrPark(stream->frame, [stream]() {
+        MHD_suspend_connection(stream->connection);
+    })) {
+    case EventBus::Subscription::PopResult::FRAME:
+        return true;
+    case EventBus::Subscription::PopResult::PARKED:
+        parked = true;
+        return true;
+    case EventBus::Subscription::PopResult::CLOSED:
+        break;
+    }
+    return false;
+}
+
+ssize_t readCallback(void* cls, uint64_t pos, char* buf, size_t max) {
+    (void)pos;
+    Stream* stream = static_cast<Stream*>(cls);
+
+    if (!stream->frame || stream->offset >= stream->frame->size()) {
+        bool parked = false;
+        stream->frame.reset();
+        stream->offset = 0;
+        if (!nextFrame(stream, parked)) {
+            return MHD_CONTENT_READER_END_OF_STREAM;
+        }
+        if (parked) {
+            return 0; // Suspended; MHD calls again once resumed
+        }
+    }
+
+    size_t length = std::min(max, stream->frame->size() - stream->offset);
+    std::memcpy(buf, stream->frame->data() + stream->offset, length);
+    stream->offset += length;
+    return static_cast<ssize_t>(length);
+}
+
+void freeCallback(void* cls) {
+    Stream* stream = static_cast<Stream*>(cls);
+    {
+        OpenStreams& open = openStreams();
+        std::lock_guard<std::mutex> lock(open.mutex);
+        open.streams.erase(stream);
+        if (open.streams.empty()) {
+            open.drained.notify_all();
+        }
+    }
+    // Clearing the hook under the queue lock guarantees no publisher is
+    // still resuming this connection once we return
+    stream->subscription->setWakeHook(nullptr);
+    EventBus::getInstance().unsubscribe(stream->subscription);
+    ENDPOINT_LOG("events", "Event stream closed (" +
+                 std::to_string(stream->subscription->droppedFrames()) + " frames dropped)");
+    delete stream;
+}
+
+enum MHD_Result sendPlainError(struct MHD_Connection* connection, unsigned int status_code, const char* message) {
+    struct MHD_Response* response = MHD_create_response_from_buffer(std::strlen(message),
+                                                                   const_cast<char*>(message),
+                                                                   MHD_RESPMEM_PERSISTENT);
+    if (!response) {
+        return MHD_NO;
+    }
+    MHD_add_response_header(response, "Content-Type", "text/plain");
+    enum MHD_Result result = MHD_queue_response(connection, status_code, response);
+    MHD_destroy_response(response);
+    return result;
+}
+
+} // namespace
+
+enum MHD_Result EventStream::handleRequest(struct MHD_Connection* connection, const std::string& method,
+                                           bool suspend_when_idle) {
+    if (method != "GET") {
+        return sendPlainError(connection, MHD_HTTP_METHOD_NOT_ALLOWED, "Method not allowed");
+    }
+
+    EventBus& bus = EventBus::getInstance();
+    std::vector<std::string> topics = parseTopics(MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "topics"));
+
+    // The cap is checked and the stream registered under one lock, so
+    // concurrent connects cannot both take the last slot
+    OpenStreams& open = openStreams();
+    std::unique_lock<std::mutex> lock(open.mutex);
+    if (!open.accepting) {
+        return sendPlainError(connection, MHD_HTTP_SERVICE_UNAVAILABLE, "Server is shutting down");
+    }
+    if (open.streams.size() >= MAX_STREAMS) {
+        lock.unlock();
+        ENDPOINT_LOG("events", "Refusing event stream: " + std::to_string(MAX_STREAMS) + " already open");
+        return sendPlainError(connection, MHD_HTTP_SERVICE_UNAVAILABLE, "Too many event streams");
+    }
+
+    auto* stream = new Stream();
+    stream->connection = connection;
+    stream->suspend_when_idle = suspend_when_idle;
+    stream->frame = STREAM_PREAMBLE;
+    stream->subscription = bus.subscribe(std::move(topics));
+    if (suspend_when_idle) {
+        stream->subscription->setWakeHook([connection]() {
+            MHD_resume_connection(connection);
+        });
+    }
+
+    struct MHD_Response* response = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, 4096,
+                                                                      &readCallback, stream, &freeCallback);
+    if (!response) {
+        bus.unsubscribe(stream->subscription);
+        delete stream;
+        return MHD_NO;
+    }
+    open.streams.insert(stream);
+    size_t open_count = open.streams.size();
+    lock.unlock();
+
+    MHD_add_response_header(response, "Content-Type", "text/event-stream");
+    MHD_add_response_header(response, "Cache-Control", "no-cache");
+    MHD_add_response_header(response, "X-Accel-Buffering", "no");
+    MHD_add_response_header(response, "Access-Control-Allow-Origin", "*");
+
+    // The stream is idle between events by design; keepalives replace the timeout
+    MHD_set_connection_option(connection, MHD_CONNECTION_OPTION_TIMEOUT, 0u);
+
+    ENDPOINT_LOG("events", "Event stream opened (" + std::to_string(open_count) + " open)");
+
+    enum MHD_Result result = MHD_queue_response(connection, MHD_HTTP_OK, response);
+    MHD_destroy_response(response);
+    return result;
+}
+
+void EventStream::closeAll(std::chrono::milliseconds timeout) {
+    OpenStreams& open = openStreams();
+    std::vector<std::shared_ptr<EventBus::Subscription>> closing;
+    std::unique_lock<std::mutex> lock(open.mutex);
+    open.accepting = false;
+    for (Stream* stream : open.streams) {
+        closing.push_back(stream->subscription);
+    }
+    lock.unlock();
+
+    // Closing resumes a parked stream's connection (outside our lock: MHD may
+    // be releasing another stream meanwhile); its reader then ends the
+    // response and MHD frees the stream through freeCallback
+    for (const auto& subscription : closing) {
+        subscription->close();
+    }
+
+    lock.lock();
+    if (!open.drained.wait_for(lock, timeout, [&open]() { return open.streams.empty(); })) {
+        ENDPOINT_LOG("events", std::to_string(open.streams.size()) + " event stream(s) still open at shutdown");
+    }
+}
+
+void EventStream::reopen() {
+    OpenStreams& open = openStreams();
+    std::lock_guard<std::mutex> lock(open.mutex);
+    open.accepting = true;
+}
@@ -0,0 +1,166 @@
+#include "file_response.h"
+#include <iostream>
+#include <cctype>
+#include <unistd.h>
+
+namespace {
+    bool parseOffset(const std::string& text, uint64_t& value) {
+        if (text.empty() || text.size() > 19) {
+            return false;
+        }
+        value = 0;
+        for (char c : text) {
+            if (!std::isdigit(static_cast<unsigned char>(c))) {
+                return false;
+            }
+            value = value * 10 + static_cast<uint64_t>(c - '0');
+        }
+        return true;
+    }
+}
+
+FileResponse::RangeStatus FileResponse::resolveRange(struct MHD_Connection* connection, uint64_t size,
+                                                     const std::string& etag, ByteRange& range) {
+    range.offset = 0;
+    range.length = size;
+
+    const char* range_header = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Range");
+    if (!range_header) {
+        return RangeStatus::FULL;
+    }
+
+    // If-Range: only resume when the client's copy is still current. Dates
+    // are treated as a mismatch, which just costs a full re-send.
+    const char* if_range = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "If-Range");
+    if (if_range && (etag.empty() || etag != if_range)) {
+        return RangeStatus::FULL;
+    }
+
+    std::string spec(range_header);
+    if (spec.compare(0, 6, "bytes=") != 0 || spec.find(',') != std::string::npos) {
+        return RangeStatus::FULL;
+    }
+    spec.erase(0, 6);
+    while (!spec.empty() && spec.back() == ' ') {
+        spec.pop_back();
+    }
+
+    size_t dash = spec.find('-');
+    if (dash == std::string::npos) {
+        return RangeStatus::FULL;
+    }
+    std::string first_text = spec.substr(0, dash);
+    std::string last_text = spec.substr(dash + 1);
+
+    uint64_t first = 0;
+    uint64_t last = 0;
+    if (first_text.empty()) {
+        // Suffix range: the final N bytes
+        uint64_t suffix = 0;
+        if (!parseOffset(last_text, suffix)) {
+            return RangeStatus::FULL;
+        }
+        if (suffix == 0 || size == 0) {
+            return RangeStatus::UNSATISFIABLE;
+        }
+        first = suffix >= size ? 0 : size - suffix;
+        last = size - 1;
+    } else {
+        if (!parseOffset(first_text, first)) {
+            return RangeStatus::FULL;
+        }
+        if (last_text.empty()) {
+            last = size == 0 ? 0 : size - 1;
+        } else if (!parseOffset(last_text, last) || last < first) {
+            return RangeStatus::FULL;
+        }
+        if (first >= size) {
+            return RangeStatus::UNSATISFIABLE;
+        }
+        if (last >= size) {
+            last = size - 1;
+        }
+    }
+
+    range.offset = first;
+    range.length = last - first + 1;
+    return RangeStatus::PARTIAL;
+}
+
+struct MHD_Response* FileResponse::fromFd(int fd, const ByteRange& range) {
+    struct MHD_Response* response = MHD_create_response_from_fd_at_offset64(range.length, fd, range.offset);
+    if (!response) {
+        close(fd);
+    }
+    return response;
+}
+
+struct MHD_Response* FileResponse::fromSharedBuffer(std::shared_ptr<const void> owner,
+                                                    const char* data, size_t size) {
+#if MHD_VERSION >= 0x00097302
+    // The response holds a reference to the cache entry, so the buffer stays
+    // valid even if the cache drops the entry while it is being sent
+    auto* holder = new std::shared_ptr<const void>(std::move(owner));
+    struct MHD_Response* response = MHD_create_response_from_buffer_with_free_callback_cls(
+        size, data,
+        [](void* cls) { delete static_cast<std::shared_ptr<const void>*>(cls); },
+        holder);
+    if (!response) {
+        delete holder;
+    }
+    return response;
+#else
+    // Older libmicrohttpd cannot tie the buffer's lifetime to the response
+    return MHD_create_response_from_buffer(size, const_cast<char*>(data), MHD_RESPMEM_MUST_COPY);
+#endif
+}
+
+unsigned int FileResponse::addRangeHeaders(struct MHD_Response* response, RangeStatus status,
+                                           const ByteRange& range, uint64_t size) {
+    MHD_add_response_header(response, "Accept-Ranges", "bytes");
+
+    if (status == RangeStatus::PARTIAL) {
+        std::string content_range = "bytes " + std::to_string(range.offset) + "-" +
+                                    std::to_string(range.offset + range.length - 1) + "/" +
+                                    std::to_string(size);
+        MHD_add_response_header(response, "Content-Range", content_range.c_str());
+        return MHD_HTTP_PARTIAL_CONTENT;
+    }
+    if (status == RangeStatus::UNSATISFIABLE) {
+        MHD_add_response_header(response, "Content-Range", ("bytes */" + std::to_string(size)).c_str());
+        return MHD_HTTP_RANGE_NOT_SATISFIABLE;
+    }
+    return MHD_HTTP_OK;
+}
+
+enum MHD_Result FileResponse::queueFile(struct MHD_Connection* connection, int fd, uint64_t size,
+                                        const std::string& content_type, const std::string& etag,
+                                        const std::function<void(struct MHD_Response*)>& add_headers) {
+    ByteRange range;
+    RangeStatus status = resolveRange(connection, size, etag, range);
+
+    struct MHD_Response* response = nullptr;
+    if (status == RangeStatus::UNSATISFIABLE) {
+        close(fd);
+        response = MHD_create_response_from_buffer(0, nullptr, MHD_RESPMEM_PERSISTENT);
+    } else {
+        response = fromFd(fd, range);
+    }
+
+    if (!response) {
+        std::cerr << "FileResponse: Failed to create file response" << std::endl;
+        return MHD_NO;
+    }
+
+    unsigned int status_code = addRangeHeaders(response, status, range, size);
+    if (status != RangeStatus::UNSATISFIABLE) {
+        MHD_add_response_header(response, "Content-Type", content_type.c_str());
+    }
+    if (add_headers) {
+        add_headers(response);
+    }
+
+    enum MHD_Result ret = MHD_queue_response(connection, status_code, response);
+    MHD_destroy_response(response);
+    return ret;
+}
@@ -1,5 +1,7 @@
 #include "file_server.h"
 #include "endpoint_logger.h"
+#include "http_compression.h"
+#include "file_response.h"
 #include <iostream>
 #include <fstream>
 #include <filesystem>
@@ -9,10 +11,15 @@
 #include <cstring>
 #include <random>
 #include <functional>
+#include <cctype>
+#include <fcntl.h>
+#include <unistd.h>
 
 FileServer::FileServer(const std::string& document_root, const std::string& default_file)
     : document_root_(document_root), default_file_(default_file), 
-      cache_enabled_(true), cache_max_age_(300) { // 5 minute default cache
+      cache_enabled_(true), cache_max_age_(300), // 5 minute default cache
+      cache_control_rules_{{"/", "no-cache"}, {"/assets/", "public, max-age=300"}},
+      immutable_fingerprinted_(true) {
     ENDPOINT_LOG("file_server", "[FILESERVER] Initialized with transaction support and caching");
     ENDPOINT_LOG("file_server", "[FILESERVER] Document root: " + document_root_);
     ENDPOINT_LOG("file_server", "[FILESERVER] Default file: " + default_file_);
@@ -51,14 +58,22 @@ enum MHD_Result FileServer::serveFileWithState(struct MHD_Connection* connection
         }
         
         // Check if file exists
-        if (!fileExists(full_path)) {
+        struct stat file_stat;
+        if (stat(full_path.c_str(), &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
             ENDPOINT_LOG("file_server", "FileServer: File does not exist: " + full_path);
             return sendNotFound(connection);
         }
         
+        std::string cache_control = getCacheControl(requested_path);
+        
+        // Large files are never held in memory; the kernel sends them from the page cache
+        if (static_cast<uint64_t>(file_stat.st_size) >= LARGE_FILE_SIZE) {
+            return sendLargeFile(connection, full_path, cache_control);
+        }
+        
         // Read file content with caching support
         ENDPOINT_LOG("file_server", "FileServer: Reading file with cache: " + full_path);
-        auto cache_entry = readFileWithCache(full_path);
+        auto cache_entry = readFileWithCache(full_path, file_stat);
         if (!cache_entry || cache_entry->content.empty()) {
             ENDPOINT_LOG("file_server", "FileServer: Failed to read file: " + full_path);
             return sendInternalError(connection);
@@ -66,8 +81,21 @@ enum MHD_Result FileServer::serveFileWithState(struct MHD_Connection* connection
         
         ENDPOINT_LOG("file_server", "FileServer: Successfully read " + std::to_string(cache_entry->content.length()) + " bytes (cached: " + (cache_enabled_ ? "yes" : "no") + ")");
         
+        // Pick the representation; each variant has its own ETag. Byte ranges
+        // always refer to the identity bytes.
+        bool use_gzip = !cache_entry->gzip_content.empty() &&
+                        !MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Range") &&
+                        HttpCompression::acceptsGzip(MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Accept-Encoding"));
+        const std::string& etag = use_gzip ? cache_entry->gzip_etag : cache_entry->etag;
+        
+        // Client already holds this exact version: answer 304 without a body
+        if (isNotModified(connection, etag, cache_entry->mtime)) {
+            ENDPOINT_LOG("file_server", "FileServer: Not modified: " + full_path + " " + etag);
+            return sendNotModified(connection, *cache_entry, cache_control, use_gzip);
+        }
+        
         // Use the production-ready sendFileResponse method
-        return sendFileResponse(connection, full_path, cache_entry->content);
+        return sendFileResponse(connection, full_path, cache_entry, cache_control, use_gzip);
         
     } catch (const std::exception& e) {
         std::cerr << "Error serving file: " << e.what() << std::endl;
@@ -93,14 +121,22 @@ bool FileServer::isDirectory(const std::string& path) {
 
 std::string FileServer::readFile(const std::string& path) {
     try {
-        std::ifstream file(path, std::ios::binary);
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
         if (!file.is_open()) {
             return "";
         }
         
-        std::ostringstream oss;
-        oss << file.rdbuf();
-        return oss.str();
+        // Size the buffer once and read straight into it
+        std::streamsize size = file.tellg();
+        if (size <= 0) {
+            return "";
+        }
+        std::string content(static_cast<size_t>(size), '\0');
+        file.seekg(0);
+        if (!file.read(content.data(), size)) {
+            return "";
+        }
+        return content;
         
     } catch (const std::exception& e) {
         std::cerr << "Error reading file " << path << ": " << e.what() << std::endl;
@@ -155,61 +191,208 @@ std::string FileServer::getMimeType(const std::string& file_path) {
 
 // ======== NEW CACHE AND TRANSACTION METHODS ========
 
-std::shared_ptr<CacheEntry> FileServer::readFileWithCache(const std::string& path) {
-    if (!cache_enabled_) {
-        // Cache disabled, read directly
+std::shared_ptr<CacheEntry> FileServer::readFileWithCache(const std::string& path, const struct stat& file_stat) {
+    // The caller's stat doubles as the ETag and as the staleness check for
+    // the cached copy
+    std::string etag = generateETag(file_stat);
+    
+    auto load = [&]() {
         auto entry = std::make_shared<CacheEntry>();
         entry->content = readFile(path);
         entry->file_size = entry->content.length();
-        entry->etag = generateETag(path, entry->content);
+        entry->etag = etag;
+        entry->mtime = file_stat.st_mtime;
+        entry->last_modified_header = formatHttpDate(file_stat.st_mtime);
         return entry;
-    }
+    };
     
-    std::lock_guard<std::mutex> lock(cache_mutex_);
+    if (!cache_enabled_) {
+        // Cache disabled, read directly
+        return load();
+    }
     
-    // Check if file is in cache and still valid
-    auto cache_it = file_cache_.find(path);
-    if (cache_it != file_cache_.end()) {
-        auto& entry = cache_it->second;
-        auto now = std::chrono::steady_clock::now();
-        auto age = std::chrono::duration_cast<std::chrono::seconds>(now - entry->cache_time).count();
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex_);
         
-        if (age < cache_max_age_) {
-            ENDPOINT_LOG("file_server", "[FILESERVER-CACHE] Cache hit for: " + path + " (age: " + std::to_string(age) + "s)");
-            return entry;
-        } else {
-            ENDPOINT_LOG("file_server", "[FILESERVER-CACHE] Cache expired for: " + path + " (age: " + std::to_string(age) + "s)");
-            file_cache_.erase(cache_it);
+        // Check if file is in cache and still valid
+        auto cache_it = file_cache_.find(path);
+        if (cache_it != file_cache_.end()) {
+            auto& entry = cache_it->second;
+            auto now = std::chrono::steady_clock::now();
+            auto age = std::chrono::duration_cast<std::chrono::seconds>(now - entry->cache_time).count();
+            
+            if (entry->etag != etag) {
+                ENDPOINT_LOG("file_server", "[FILESERVER-CACHE] File changed on disk: " + path);
+                file_cache_.erase(cache_it);
+            } else if (age < cache_max_age_) {
+                ENDPOINT_LOG("file_server", "[FILESERVER-CACHE] Cache hit for: " + path + " (age: " + std::to_string(age) + "s)");
+                return entry;
+            } else {
+                ENDPOINT_LOG("file_server", "[FILESERVER-CACHE] Cache expired for: " + path + " (age: " + std::to_string(age) + "s)");
+                file_cache_.erase(cache_it);
+            }
         }
     }
     
-    // Read file and cache it
+    // Read and compress without the lock, so a miss on one file does not
+    // stall requests for every other one
     ENDPOINT_LOG("file_server", "[FILESERVER-CACHE] Cache miss, reading: " + path);
-    auto entry = std::make_shared<CacheEntry>();
-    entry->content = readFile(path);
-    entry->file_size = entry->content.length();
-    entry->etag = generateETag(path, entry->content);
+    auto entry = load();
     entry->cache_time = std::chrono::steady_clock::now();
+    precompress(*entry, path);
     
     if (!entry->content.empty()) {
-        file_cache_[path] = entry;
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+        auto& cached = file_cache_[path];
+        if (cached && cached->etag == etag) {
+            // Another request filled it meanwhile; share its copy
+            return cached;
+        }
+        cached = entry;
         ENDPOINT_LOG("file_server", "[FILESERVER-CACHE] Cached file: " + path + " (" + std::to_string(entry->file_size) + " bytes)");
     }
     
     return entry;
 }
 
-std::string FileServer::generateETag(const std::string& path, const std::string& content) {
-    // Simple ETag generation based on path and content hash
-    std::hash<std::string> hasher;
-    auto path_hash = hasher(path);
-    auto content_hash = hasher(content);
-    
+std::string FileServer::generateETag(const struct stat& file_stat) {
+    // Strong ETag from inode, size and nanosecond mtime: any rewrite or
+    // replacement of the file changes it, without hashing the content
     std::ostringstream oss;
-    oss << "\"" << std::hex << path_hash << "-" << content_hash << "\"";
+    oss << "\"" << std::hex << file_stat.st_ino << "-" << file_stat.st_size << "-"
+        << file_stat.st_mtim.tv_sec << "." << file_stat.st_mtim.tv_nsec << "\"";
     return oss.str();
 }
 
+void FileServer::precompress(CacheEntry& entry, const std::string& path) {
+    // Paid once per cache fill, so use the best ratio zlib offers
+    if (entry.content.size() < HttpCompression::MIN_COMPRESS_SIZE ||
+        !HttpCompression::isCompressibleType(getMimeType(path))) {
+        return;
+    }
+    
+    std::string compressed = HttpCompression::gzip(entry.content, 9);
+    if (compressed.empty() || compressed.size() >= entry.content.size() - entry.content.size() / 10) {
+        return; // Less than 10% saved: not worth a second variant
+    }
+    
+    entry.gzip_content = std::move(compressed);
+    entry.gzip_etag = entry.etag;
+    entry.gzip_etag.insert(entry.gzip_etag.size() - 1, "-gz");
+    ENDPOINT_LOG("file_server", "[FILESERVER-CACHE] Precompressed " + path + ": " + std::to_string(entry.content.size()) +
+                 " -> " + std::to_string(entry.gzip_content.size()) + " bytes");
+}
+
+std::string FileServer::getCacheControl(const std::string& request_path) const {
+    if (immutable_fingerprinted_ && isFingerprinted(request_path)) {
+        return "public, max-age=31536000, immutable";
+    }
+    
+    const std::string* best = nullptr;
+    size_t best_length = 0;
+    for (const auto& rule : cache_control_rules_) {
+        if (rule.first.size() >= best_length && request_path.compare(0, rule.first.size(), rule.first) == 0) {
+            best = &rule.second;
+            best_length = rule.first.size();
+        }
+    }
+    return best ? *best : "no-cache";
+}
+
+bool FileServer::isFingerprinted(const std::string& path) {
+    // Content hash embedded in the file name: name.<hex>.ext or name-<hex>.ext
+    // with at least 8 hex digits
+    size_t name_start = path.find_last_of('/');
+    name_start = (name_start == std::string::npos) ? 0 : name_start + 1;
+    size_t ext_dot = path.find_last_of('.');
+    if (ext_dot == std::string::npos || ext_dot <= name_start) {
+        return false;
+    }
+    
+    size_t separator = path.find_last_of(".-", ext_dot - 1);
+    if (separator == std::string::npos || separator < name_start) {
+        return false;
+    }
+    
+    size_t hash_length = ext_dot - separator - 1;
+    if (hash_length < 8) {
+        return false;
+    }
+    for (size_t i = separator + 1; i < ext_dot; ++i) {
+        if (!std::isxdigit(static_cast<unsigned char>(path[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FileServer::isNotModified(struct MHD_Connection* connection, const std::string& etag, std::time_t mtime) {
+    // If-None-Match takes precedence; If-Modified-Since is only consulted without it (RFC 9110 13.2.2)
+    const char* if_none_match = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "If-None-Match");
+    if (if_none_match) {
+        return etagListMatches(if_none_match, etag);
+    }
+    
+    const char* if_modified_since = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "If-Modified-Since");
+    std::time_t since;
+    if (if_modified_since && parseHttpDate(if_modified_since, since)) {
+        return mtime <= since;
+    }
+    return false;
+}
+
+bool FileServer::etagListMatches(const std::string& header, const std::string& etag) {
+    // Weak comparison as required for If-None-Match: a W/ prefix is ignored
+    size_t pos = 0;
+    while (pos < header.size()) {
+        while (pos < header.size() && (header[pos] == ' ' || header[pos] == '\t' || header[pos] == ',')) {
+            ++pos;
+        }
+        if (pos >= header.size()) {
+            break;
+        }
+        
+        size_t end = header.find(',', pos);
+        if (end == std::string::npos) {
+            end = header.size();
+        }
+        std::string candidate = header.substr(pos, end - pos);
+        while (!candidate.empty() && (candidate.back() == ' ' || candidate.back() == '\t')) {
+            candidate.pop_back();
+        }
+        if (candidate == "*") {
+            return true;
+        }
+        if (candidate.compare(0, 2, "W/") == 0) {
+            candidate.erase(0, 2);
+        }
+        if (candidate == etag) {
+            return true;
+        }
+        pos = end + 1;
+    }
+    return false;
+}
+
+std::string FileServer::formatHttpDate(std::time_t time) {
+    std::tm tm{};
+    gmtime_r(&time, &tm);
+    char buffer[64];
+    std::strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    return buffer;
+}
+
+bool FileServer::parseHttpDate(const std::string& value, std::time_t& time) {
+    // Only the IMF-fixdate form; obsolete formats are treated as absent
+    std::tm tm{};
+    const char* end = strptime(value.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if (!end) {
+        return false;
+    }
+    time = timegm(&tm);
+    return time != static_cast<std::time_t>(-1);
+}
+
 void FileServer::clearCache() {
     std::lock_guard<std::mutex> lock(cache_mutex_);
     file_cache_.clear();
@@ -362,8 +545,12 @@ std::string FileServer::sanitizePath(const std::string& path) {
 
 enum MHD_Result FileServer::sendFileResponse(struct MHD_Connection* connection, 
                                 const std::string& file_path,
-                                const std::string& content) {
+                                const std::shared_ptr<CacheEntry>& entry,
+                                const std::string& cache_control,
+                                bool use_gzip) {
     
+    const std::string& content = use_gzip ? entry->gzip_content : entry->content;
+    const std::string& etag = use_gzip ? entry->gzip_etag : entry->etag;
     std::string mime_type = getMimeType(file_path);
     ENDPOINT_LOG("file_server", "FileServer: Sending file response for " + file_path + " (" + std::to_string(content.length()) + " bytes, " + mime_type + ")");
     
@@ -381,13 +568,18 @@ enum MHD_Result FileServer::sendFileResponse(struct MHD_Connection* connection,
         return sendNotFound(connection);
     }
     
-    // Use MHD_RESPMEM_MUST_COPY for safety - avoids memory ownership issues
+    FileResponse::ByteRange range;
+    FileResponse::RangeStatus range_status = FileResponse::resolveRange(connection, content.length(), etag, range);
+    
+    // Send straight from the immutable cache buffer; the response keeps the
+    // entry alive, so a concurrent cache refresh cannot free it mid-send
     try {
-        response = MHD_create_response_from_buffer(
-            content.length(),
-            const_cast<char*>(content.c_str()),
-            MHD_RESPMEM_MUST_COPY  // Safe: MHD copies the data
-        );
+        if (range_status == FileResponse::RangeStatus::UNSATISFIABLE) {
+            response = MHD_create_response_from_buffer(0, nullptr, MHD_RESPMEM_PERSISTENT);
+        } else {
+            response = FileResponse::fromSharedBuffer(entry, content.data() + range.offset,
+                                                      static_cast<size_t>(range.length));
+        }
     } catch (const std::exception& e) {
         std::cerr << "FileServer: Exception creating response: " << e.what() << std::endl;
         return sendInternalError(connection);
@@ -399,15 +591,24 @@ enum MHD_Result FileServer::sendFileResponse(struct MHD_Connection* connection,
     }
     
     // Set production headers
+    unsigned int status_code = FileResponse::addRangeHeaders(response, range_status, range, content.length());
     MHD_add_response_header(response, "Content-Type", mime_type.c_str());
     MHD_add_response_header(response, "Access-Control-Allow-Origin", "*");
-    MHD_add_response_header(response, "Cache-Control", "public, max-age=300");
+    MHD_add_response_header(response, "Cache-Control", cache_control.c_str());
+    MHD_add_response_header(response, "ETag", etag.c_str());
+    MHD_add_response_header(response, "Last-Modified", entry->last_modified_header.c_str());
+    if (use_gzip) {
+        MHD_add_response_header(response, "Content-Encoding", "gzip");
+    }
+    if (!entry->gzip_content.empty()) {
+        MHD_add_response_header(response, "Vary", "Accept-Encoding");
+    }
     
     // Critical: Safe response queueing to prevent core dumps
     enum MHD_Result ret = MHD_NO;
     
     try {
-        ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
+        ret = MHD_queue_response(connection, status_code, response);
         if (ret != MHD_YES) {
             std::cerr << "FileServer: Failed to queue response, status: " << ret << std::endl;
         } else {
@@ -432,6 +633,67 @@ enum MHD_Result FileServer::sendFileResponse(struct MHD_Connection* connection,
     return ret;
 }
 
+enum MHD_Result FileServer::sendLargeFile(struct MHD_Connection* connection,
+                                          const std::string& file_path,
+                                          const std::string& cache_control) {
+    // Validators and length come from the open descriptor, so a file replaced
+    // after the path lookup is still sent consistently
+    int fd = open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat file_stat;
+    if (fd < 0 || fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return sendNotFound(connection);
+    }
+    
+    CacheEntry validators;
+    validators.etag = generateETag(file_stat);
+    validators.mtime = file_stat.st_mtime;
+    validators.last_modified_header = formatHttpDate(file_stat.st_mtime);
+    
+    if (isNotModified(connection, validators.etag, validators.mtime)) {
+        close(fd);
+        return sendNotModified(connection, validators, cache_control, false);
+    }
+    
+    ENDPOINT_LOG("file_server", "FileServer: Sending large file from descriptor: " + file_path + " (" +
+                 std::to_string(file_stat.st_size) + " bytes)");
+    
+    return FileResponse::queueFile(connection, fd, static_cast<uint64_t>(file_stat.st_size),
+                                   getMimeType(file_path), validators.etag,
+                                   [&](struct MHD_Response* response) {
+        MHD_add_response_header(response, "Access-Control-Allow-Origin", "*");
+        MHD_add_response_header(response, "Cache-Control", cache_control.c_str());
+        MHD_add_response_header(response, "ETag", validators.etag.c_str());
+        MHD_add_response_header(response, "Last-Modified", validators.last_modified_header.c_str());
+    });
+}
+
+enum MHD_Result FileServer::sendNotModified(struct MHD_Connection* connection,
+                                            const CacheEntry& entry,
+                                            const std::string& cache_control,
+                                            bool use_gzip) {
+    struct MHD_Response* response = MHD_create_response_from_buffer(0, nullptr, MHD_RESPMEM_PERSISTENT);
+    if (!response) {
+        return MHD_NO;
+    }
+    
+    // A 304 must repeat the validators and caching headers a 200 would carry
+    MHD_add_response_header(response, "ETag", (use_gzip ? entry.gzip_etag : entry.etag).c_str());
+    MHD_add_response_header(response, "Last-Modified", entry.last_modified_header.c_str());
+    MHD_add_response_header(response, "Cache-Control", cache_control.c_str());
+    MHD_add_response_header(response, "Access-Control-Allow-Origin", "*");
+    if (!entry.gzip_content.empty()) {
+        MHD_add_response_header(response, "Vary", "Accept-Encoding");
+    }
+    
+    enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_NOT_MODIFIED, response);
+    MHD_destroy_response(response);
+    
+    return ret;
+}
+
 enum MHD_Result FileServer::sendDirectoryListing(struct MHD_Connection* connection, 
                                     const std::string& directory_path) {
     // For security reasons, directory listing is disabled by default
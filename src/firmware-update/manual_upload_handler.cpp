@@ -1,5 +1,6 @@
 #include "manual_upload_handler.h"
 #include "config_manager.h"
+#include "atomic_file.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -44,92 +45,190 @@ ManualUploadHandler::~ManualUploadHandler() {
     std::cout << "[MANUAL-UPLOAD] Handler destroyed" << std::endl;
 }
 
-std::string ManualUploadHandler::uploadFirmwareFile(const std::vector<uint8_t>& file_data,
-                                                   const std::string& filename,
-                                                   const std::string& file_type,
-                                                   bool verify_signature) {
-    std::cout << "[MANUAL-UPLOAD] Starting upload: " << filename << " (" << file_data.size() << " bytes)" << std::endl;
+namespace {
+    std::string finalizeDigest(EVP_MD_CTX* ctx) {
+        unsigned char hash[EVP_MAX_MD_SIZE];
+        unsigned int hash_len = 0;
+        if (!ctx || EVP_DigestFinal_ex(ctx, hash, &hash_len) != 1) {
+            return "";
+        }
 
-    // Validate file
-    std::string validation_error = validateFirmwareFile(filename, file_data.size());
-    if (!validation_error.empty()) {
-        std::cout << "[MANUAL-UPLOAD] Validation failed: " << validation_error << std::endl;
+        std::ostringstream oss;
+        for (unsigned int i = 0; i < hash_len; ++i) {
+            oss << std::hex << std::setw(2) << std::setfill('0') << (int)hash[i];
+        }
+        return oss.str();
+    }
+}
+
+ManualUploadSession::ManualUploadSession(ManualUploadHandler& handler)
+    : handler_(handler), md5_ctx_(EVP_MD_CTX_new()), sha256_ctx_(EVP_MD_CTX_new()), active_(false) {
+    info_.file_size = 0;
+    info_.verify_signature = false;
+}
+
+ManualUploadSession::~ManualUploadSession() {
+    if (active_) {
+        abort();
+    }
+    EVP_MD_CTX_free(md5_ctx_);
+    EVP_MD_CTX_free(sha256_ctx_);
+}
+
+bool ManualUploadSession::write(const char* data, size_t size) {
+    if (!active_) {
+        return false;
+    }
+
+    if (info_.file_size + size > ManualUploadHandler::MAX_FILE_SIZE) {
+        return fail("File too large (maximum 32MB)");
+    }
+
+    file_.write(data, size);
+    if (!file_) {
+        return fail("Failed to write file: " + info_.file_path);
+    }
+
+    if (EVP_DigestUpdate(md5_ctx_, data, size) != 1 ||
+        EVP_DigestUpdate(sha256_ctx_, data, size) != 1) {
+        return fail("Checksum calculation failed");
+    }
+
+    info_.file_size += size;
+    return true;
+}
+
+std::string ManualUploadSession::commit() {
+    if (!active_) {
+        return "";
+    }
+
+    file_.close();
+    if (!file_) {
+        fail("Failed to finish writing file: " + info_.file_path);
+        return "";
+    }
+
+    if (info_.file_size == 0) {
+        fail("File is empty");
+        return "";
+    }
+
+    info_.checksum_md5 = finalizeDigest(md5_ctx_);
+    info_.checksum_sha256 = finalizeDigest(sha256_ctx_);
+    info_.upload_timestamp = std::chrono::system_clock::now();
+    info_.status = "completed";
+    info_.error_message = "";
+
+    // Clean up old uploads (keep only 3 most recent); this upload has no metadata yet so it is never a candidate
+    handler_.cleanupOldUploads();
+
+    if (!handler_.saveUploadMetadata(info_)) {
+        fail("Failed to save metadata for: " + info_.upload_id);
         return "";
     }
 
+    active_ = false;
+    std::cout << "[MANUAL-UPLOAD] Upload completed successfully: " << info_.upload_id
+              << " (" << info_.file_size << " bytes)" << std::endl;
+    return info_.upload_id;
+}
+
+void ManualUploadSession::abort() {
+    if (!active_) {
+        return;
+    }
+    active_ = false;
+
+    if (file_.is_open()) {
+        file_.close();
+    }
+
+    std::cout << "[MANUAL-UPLOAD] Upload aborted, removing: " << info_.upload_id << std::endl;
+    handler_.deleteUpload(info_.upload_id);
+}
+
+bool ManualUploadSession::fail(const std::string& message) {
+    std::cout << "[MANUAL-UPLOAD] Upload error: " << message << std::endl;
+    error_ = message;
+    abort();
+    return false;
+}
+
+std::unique_ptr<ManualUploadSession> ManualUploadHandler::beginUpload(const std::string& filename,
+                                                                      const std::string& file_type,
+                                                                      bool verify_signature,
+                                                                      std::string& error) {
+    std::cout << "[MANUAL-UPLOAD] Starting streaming upload: " << filename << std::endl;
+
+    error = validateFirmwareFilename(filename);
+    if (!error.empty()) {
+        std::cout << "[MANUAL-UPLOAD] Validation failed: " << error << std::endl;
+        return nullptr;
+    }
+
+    std::unique_ptr<ManualUploadSession> session(new ManualUploadSession(*this));
+    if (!session->md5_ctx_ || !session->sha256_ctx_ ||
+        EVP_DigestInit_ex(session->md5_ctx_, EVP_md5(), nullptr) != 1 ||
+        EVP_DigestInit_ex(session->sha256_ctx_, EVP_sha256(), nullptr) != 1) {
+        error = "Checksum initialization failed";
+        return nullptr;
+    }
+
     // Generate upload ID
     std::string upload_id = generateUploadId();
     std::cout << "[MANUAL-UPLOAD] Generated upload ID: " << upload_id << std::endl;
 
-    // Create upload directory
     if (!createUploadDirectory(upload_id)) {
-        std::cout << "[MANUAL-UPLOAD] Failed to create upload directory for: " << upload_id << std::endl;
-        return "";
+        error = "Failed to create upload directory";
+        return nullptr;
     }
 
-    // Create upload info
-    ManualUploadInfo info;
+    ManualUploadInfo& info = session->info_;
     info.upload_id = upload_id;
-    info.filename = filename;
-    info.file_path = getUploadDirectory(upload_id) + "/" + filename;
-    info.file_size = file_data.size();
+    info.filename = std::filesystem::path(filename).filename().string();
+    info.file_path = getUploadDirectory(upload_id) + "/" + info.filename;
     info.file_type = file_type;
-    info.checksum_md5 = calculateMD5(file_data);
-    info.checksum_sha256 = calculateSHA256(file_data);
-    info.upload_timestamp = std::chrono::system_clock::now();
     info.verify_signature = verify_signature;
-    info.status = "completed";
-    info.error_message = "";
+    info.status = "uploading";
+
+    session->file_.open(info.file_path, std::ios::binary);
+    if (!session->file_) {
+        std::cout << "[MANUAL-UPLOAD] Failed to create file: " << info.file_path << std::endl;
+        std::cout << "[MANUAL-UPLOAD] Error: " << strerror(errno) << std::endl;
+        deleteUpload(upload_id);
+        error = "Failed to create upload file";
+        return nullptr;
+    }
 
-    try {
-        // Clean up old uploads (keep only 3 most recent)
-        cleanupOldUploads();
-        
-        // Debug: Check if directory exists
-        std::string upload_dir = getUploadDirectory(upload_id);
-        std::cout << "[MANUAL-UPLOAD] Upload directory: " << upload_dir << std::endl;
-        std::cout << "[MANUAL-UPLOAD] File path: " << info.file_path << std::endl;
-        std::cout << "[MANUAL-UPLOAD] Directory exists: " << std::filesystem::exists(upload_dir) << std::endl;
-        
-        // Save firmware file
-        std::ofstream file(info.file_path, std::ios::binary);
-        if (!file) {
-            std::cout << "[MANUAL-UPLOAD] Failed to create file: " << info.file_path << std::endl;
-            std::cout << "[MANUAL-UPLOAD] Error: " << strerror(errno) << std::endl;
-            return "";
-        }
+    session->active_ = true;
+    return session;
+}
 
-        std::cout << "[MANUAL-UPLOAD] Writing " << file_data.size() << " bytes to file" << std::endl;
-        file.write(reinterpret_cast<const char*>(file_data.data()), file_data.size());
-        file.close();
-        
-        // Verify file was created
-        if (std::filesystem::exists(info.file_path)) {
-            auto file_size = std::filesystem::file_size(info.file_path);
-            std::cout << "[MANUAL-UPLOAD] File created successfully, size: " << file_size << " bytes" << std::endl;
-        } else {
-            std::cout << "[MANUAL-UPLOAD] File was not created: " << info.file_path << std::endl;
-            return "";
-        }
+std::string ManualUploadHandler::uploadFirmwareFile(const std::vector<uint8_t>& file_data,
+                                                   const std::string& filename,
+                                                   const std::string& file_type,
+                                                   bool verify_signature) {
+    std::cout << "[MANUAL-UPLOAD] Starting upload: " << filename << " (" << file_data.size() << " bytes)" << std::endl;
 
-        // Save metadata
-        if (!saveUploadMetadata(info)) {
-            std::cout << "[MANUAL-UPLOAD] Failed to save metadata for: " << upload_id << std::endl;
-            // Clean up file
-            std::filesystem::remove(info.file_path);
-            return "";
-        }
+    // Validate file
+    std::string validation_error = validateFirmwareFile(filename, file_data.size());
+    if (!validation_error.empty()) {
+        std::cout << "[MANUAL-UPLOAD] Validation failed: " << validation_error << std::endl;
+        return "";
+    }
 
-        std::cout << "[MANUAL-UPLOAD] Upload completed successfully: " << upload_id << std::endl;
-        return upload_id;
+    std::string error;
+    std::unique_ptr<ManualUploadSession> session = beginUpload(filename, file_type, verify_signature, error);
+    if (!session) {
+        return "";
+    }
 
-    } catch (const std::exception& e) {
-        std::cout << "[MANUAL-UPLOAD] Upload error: " << e.what() << std::endl;
-        info.status = "failed";
-        info.error_message = e.what();
-        saveUploadMetadata(info);
+    if (!session->write(reinterpret_cast<const char*>(file_data.data()), file_data.size())) {
         return "";
     }
+
+    return session->commit();
 }
 
 std::shared_ptr<ManualUploadInfo> ManualUploadHandler::getUploadInfo(const std::string& upload_id) {
@@ -171,9 +270,6 @@ bool ManualUploadHandler::deleteUpload(const std::string& upload_id) {
 }
 
 std::string ManualUploadHandler::validateFirmwareFile(const std::string& filename, size_t file_size) {
-    const size_t MAX_FILE_SIZE = 32 * 1024 * 1024; // 32MB
-    const std::vector<std::string> ALLOWED_EXTENSIONS = {".bin", ".img", ".trx"};
-
     if (file_size == 0) {
         return "File is empty";
     }
@@ -182,6 +278,16 @@ std::string ManualUploadHandler::validateFirmwareFile(const std::string& filenam
         return "File too large (maximum 32MB)";
     }
 
+    return validateFirmwareFilename(filename);
+}
+
+std::string ManualUploadHandler::validateFirmwareFilename(const std::string& filename) {
+    const std::vector<std::string> ALLOWED_EXTENSIONS = {".bin", ".img", ".trx"};
+
+    if (filename.empty()) {
+        return "Missing filename";
+    }
+
     // Check file extension
     std::string lower_filename = filename;
     std::transform(lower_filename.begin(), lower_filename.end(), lower_filename.begin(), ::tolower);
@@ -215,50 +321,6 @@ std::string ManualUploadHandler::generateUploadId() {
     return oss.str();
 }
 
-std::string FirmwareUpdate::ManualUploadHandler::calculateMD5(const std::vector<unsigned char>& data) {
-    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
-    if (!ctx) {
-        return "";
-    }
-
-    if (EVP_DigestInit_ex(ctx, EVP_md5(), nullptr) != 1) {
-        EVP_MD_CTX_free(ctx);
-        return "";
-    }
-
-    if (EVP_DigestUpdate(ctx, data.data(), data.size()) != 1) {
-        EVP_MD_CTX_free(ctx);
-        return "";
-    }
-
-    unsigned char hash[EVP_MAX_MD_SIZE];
-    unsigned int hash_len;
-    if (EVP_DigestFinal_ex(ctx, hash, &hash_len) != 1) {
-        EVP_MD_CTX_free(ctx);
-        return "";
-    }
-
-    EVP_MD_CTX_free(ctx);
-
-    std::stringstream ss;
-    for (unsigned int i = 0; i < hash_len; i++) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << (int)hash[i];
-    }
-    return ss.str();
-}
-
-std::string ManualUploadHandler::calculateSHA256(const std::vector<uint8_t>& data) {
-    unsigned char hash[SHA256_DIGEST_LENGTH];
-    SHA256(data.data(), data.size(), hash);
-
-    std::ostringstream oss;
-    for (int i = 0; i < SHA256_DIGEST_LENGTH; ++i) {
-        oss << std::hex << std::setw(2) << std::setfill('0') << (int)hash[i];
-    }
-
-    return oss.str();
-}
-
 bool ManualUploadHandler::saveUploadMetadata(const ManualUploadInfo& info) {
     try {
         json metadata;
@@ -276,14 +338,12 @@ bool ManualUploadHandler::saveUploadMetadata(const ManualUploadInfo& info) {
         metadata["error_message"] = info.error_message;
 
         std::string metadata_path = getUploadDirectory(info.upload_id) + "/metadata.json";
-        std::ofstream file(metadata_path);
-        if (!file) {
+        std::string error;
+        if (!WriteJournal::getInstance().write(metadata_path, metadata.dump(2), error)) {
+            std::cout << "[MANUAL-UPLOAD] Error saving metadata: " << error << std::endl;
             return false;
         }
 
-        file << metadata.dump(2);
-        file.close();
-
         std::cout << "[MANUAL-UPLOAD] Metadata saved: " << metadata_path << std::endl;
         return true;
 
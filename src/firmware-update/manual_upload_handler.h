@@ -5,6 +5,8 @@
 #include <vector>
 #include <chrono>
 #include <memory>
+#include <fstream>
+#include <openssl/evp.h>
 
 namespace FirmwareUpdate {
 
@@ -22,8 +24,48 @@ struct ManualUploadInfo {
     std::string error_message;
 };
 
+class ManualUploadHandler;
+
+// Incremental firmware upload. Chunks are written straight to the upload
+// directory while MD5 and SHA-256 are updated, so memory use does not depend
+// on the file size. A session that is neither committed nor aborted removes
+// its partial file when destroyed.
+class ManualUploadSession {
+public:
+    ~ManualUploadSession();
+
+    // Append data to the file; fails once the size limit is exceeded
+    bool write(const char* data, size_t size);
+
+    // Finalize checksums and metadata; returns the upload ID or "" on failure
+    std::string commit();
+
+    // Discard the partial upload
+    void abort();
+
+    size_t getBytesWritten() const { return info_.file_size; }
+    const std::string& getFilename() const { return info_.filename; }
+    const std::string& getError() const { return error_; }
+
+private:
+    friend class ManualUploadHandler;
+    explicit ManualUploadSession(ManualUploadHandler& handler);
+
+    bool fail(const std::string& message);
+
+    ManualUploadHandler& handler_;
+    ManualUploadInfo info_;
+    std::ofstream file_;
+    EVP_MD_CTX* md5_ctx_;
+    EVP_MD_CTX* sha256_ctx_;
+    bool active_;
+    std::string error_;
+};
+
 class ManualUploadHandler {
 public:
+    static constexpr size_t MAX_FILE_SIZE = 32 * 1024 * 1024; // 32MB
+
     ManualUploadHandler();
     ~ManualUploadHandler();
 
@@ -33,6 +75,12 @@ public:
                                   const std::string& file_type,
                                   bool verify_signature = false);
 
+    // Start a streaming upload; returns nullptr and sets error if the file is rejected
+    std::unique_ptr<ManualUploadSession> beginUpload(const std::string& filename,
+                                                     const std::string& file_type,
+                                                     bool verify_signature,
+                                                     std::string& error);
+
     // Get upload information
     std::shared_ptr<ManualUploadInfo> getUploadInfo(const std::string& upload_id);
 
@@ -44,14 +92,15 @@ public:
 
     // Validate file
     std::string validateFirmwareFile(const std::string& filename, size_t file_size);
+    std::string validateFirmwareFilename(const std::string& filename);
 
     // Clean up old uploads (keep only 3 most recent)
     void cleanupOldUploads();
 
 private:
+    friend class ManualUploadSession;
+
     std::string generateUploadId();
-    std::string calculateMD5(const std::vector<uint8_t>& data);
-    std::string calculateSHA256(const std::vector<uint8_t>& data);
     bool saveUploadMetadata(const ManualUploadInfo& info);
     std::shared_ptr<ManualUploadInfo> loadUploadMetadata(const std::string& upload_id);
     bool createUploadDirectory(const std::string& upload_id);
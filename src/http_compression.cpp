@@ -0,0 +1,95 @@
+#include "http_compression.h"
+#include <zlib.h>
+#include <cctype>
+#include <cstdlib>
+
+std::string HttpCompression::gzip(std::string_view data, int level) {
+    z_stream stream{};
+    // windowBits 15 + 16 selects the gzip wrapper instead of raw zlib
+    if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return "";
+    }
+
+    std::string output;
+    output.resize(deflateBound(&stream, static_cast<uLong>(data.size())));
+
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef*>(output.data());
+    stream.avail_out = static_cast<uInt>(output.size());
+
+    int result = deflate(&stream, Z_FINISH);
+    size_t written = stream.total_out;
+    deflateEnd(&stream);
+
+    if (result != Z_STREAM_END) {
+        return "";
+    }
+    output.resize(written);
+    return output;
+}
+
+bool HttpCompression::acceptsGzip(const char* accept_encoding) {
+    if (!accept_encoding) {
+        return false;
+    }
+
+    std::string_view header(accept_encoding);
+    bool gzip_listed = false;
+    bool gzip_allowed = false;
+    bool wildcard_allowed = false;
+
+    size_t pos = 0;
+    while (pos < header.size()) {
+        size_t end = header.find(',', pos);
+        if (end == std::string_view::npos) {
+            end = header.size();
+        }
+        std::string_view item = header.substr(pos, end - pos);
+        pos = end + 1;
+
+        // Split "coding;q=0.5"
+        size_t semicolon = item.find(';');
+        std::string_view coding = item.substr(0, semicolon);
+        while (!coding.empty() && std::isspace(static_cast<unsigned char>(coding.front()))) {
+            coding.remove_prefix(1);
+        }
+        while (!coding.empty() && std::isspace(static_cast<unsigned char>(coding.back()))) {
+            coding.remove_suffix(1);
+        }
+
+        double quality = 1.0;
+        if (semicolon != std::string_view::npos) {
+            size_t q = item.find("q=", semicolon);
+            if (q != std::string_view::npos) {
+                quality = std::strtod(std::string(item.substr(q + 2)).c_str(), nullptr);
+            }
+        }
+
+        bool is_gzip = coding.size() == 4;
+        for (size_t i = 0; is_gzip && i < 4; ++i) {
+            is_gzip = std::tolower(static_cast<unsigned char>(coding[i])) == "gzip"[i];
+        }
+
+        if (is_gzip) {
+            gzip_listed = true;
+            gzip_allowed = quality > 0.0;
+        } else if (coding == "*") {
+            wildcard_allowed = quality > 0.0;
+        }
+    }
+
+    return gzip_listed ? gzip_allowed : wildcard_allowed;
+}
+
+bool HttpCompression::isCompressibleType(std::string_view content_type) {
+    if (content_type.compare(0, 5, "text/") == 0) {
+        return true;
+    }
+    for (std::string_view type : {"application/json", "application/javascript", "application/xml", "image/svg+xml"}) {
+        if (content_type.compare(0, type.size(), type) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
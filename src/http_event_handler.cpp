@@ -380,6 +380,75 @@ HttpEventHandler::EventResponse HttpEventHandler::handleFileUploadEvent(const Ev
     };
 }
 
+HttpEventHandler::EventResponse HttpEventHandler::authenticateUploadedFile(const std::string& filename,
+                                                                           const std::string& upload_path) {
+    ENDPOINT_LOG_INFO("auth", "Processing uploaded authentication file");
+
+    int64_t upload_time = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    if (filename.empty() || upload_path.empty()) {
+        return {
+            EventResult::VALIDATION_ERROR,
+            json{{"error", "Missing uploaded file"}},
+            "File upload is required",
+            "",
+            400
+        };
+    }
+
+    const std::string expected_ext = ".uacc";
+    if (filename.length() < expected_ext.length() ||
+        filename.compare(filename.length() - expected_ext.length(), expected_ext.length(), expected_ext) != 0) {
+        ENDPOINT_LOG_ERROR("auth", "Invalid file extension: " + filename);
+        std::filesystem::remove(upload_path);
+        return {
+            EventResult::VALIDATION_ERROR,
+            json{{"error", "Invalid file type"}},
+            "Only .uacc files are supported",
+            "",
+            400
+        };
+    }
+
+    json validation_result = validateAuthAccessFile(upload_path);
+    if (!validation_result.value("valid", false)) {
+        ENDPOINT_LOG_INFO("auth", "File authentication failed: " + validation_result.value("error", std::string("Invalid file content")));
+        std::filesystem::remove(upload_path);
+        return {
+            EventResult::AUTHENTICATION_FAILED,
+            json{
+                {"error", "File validation failed"},
+                {"file_validated", false},
+                {"details", validation_result}
+            },
+            "Authentication file is invalid or expired",
+            "",
+            401
+        };
+    }
+
+    std::string username = validation_result.value("username", "unknown");
+    std::string session_token = generateSessionToken(username);
+    ENDPOINT_LOG_INFO("auth", "File validation successful for user: " + username);
+
+    return {
+        EventResult::SUCCESS,
+        json{
+            {"user", {
+                {"username", username},
+                {"role", "user"}
+            }},
+            {"session_token", session_token},
+            {"file_validated", true},
+            {"upload_path", std::filesystem::path(upload_path).filename().string()},
+            {"upload_time", upload_time}
+        },
+        "File authentication successful",
+        session_token,
+        200
+    };
+}
+
 HttpEventHandler::EventResponse HttpEventHandler::handleEchoEvent(const EventData& event) {
     ENDPOINT_LOG_INFO("utils", "Processing echo request");
 
@@ -1,12 +1,17 @@
 #include "../include/http_handler.h"
 #include "../include/api_request.h"
 #include "../include/endpoint_logger.h"
+#include "../include/http_compression.h"
+#include "../include/file_response.h"
 #include <iostream>
 #include <sstream>
 #include <cstdlib>
 #include <ctime>
 #include <fstream>
 #include <nlohmann/json.hpp>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 HttpHandler::HttpHandler() {
     // Initialize random seed for request IDs
@@ -36,24 +41,83 @@ enum MHD_Result HttpHandler::handleRequest(struct MHD_Connection* connection,
         return sendErrorResponse(connection, MHD_HTTP_URI_TOO_LONG, "Request URI too long");
     }
     
-    // Check structured route processors first
-    auto structured_it = structured_route_processors_.find(url_str);
-    if (structured_it != structured_route_processors_.end()) {
+    // Resolve streaming, structured, dynamic and legacy routes in one trie lookup
+    RouteMatch route_match = dynamic_router_->findMatch(url_str, method_str);
+    if (!route_match.matched) {
+        return MHD_NO; // Let file server handle it
+    }
+    
+    ConnectionState* state = static_cast<ConnectionState*>(*con_cls);
+    if (state == nullptr) {
+        // First call for this connection - initialize state and wait for the body
+        *con_cls = new ConnectionState();
+        return MHD_YES;
+    }
+    
+    if (route_match.kind == RouteKind::STREAMING) {
+        if (!route_match.entry->streaming_factory || (method_str != "POST" && method_str != "PUT")) {
+            return sendErrorResponse(connection, MHD_HTTP_METHOD_NOT_ALLOWED, "Method not allowed");
+        }
+        
+        if (!state->sink && !state->streaming_declined) {
+            state->sink = openStreamingSink(connection, route_match, url, method);
+            state->streaming_declined = !state->sink;
+        }
+        
+        // A declined request falls through to a buffered handler on the same path, if any
+        const RouteEntry* entry = route_match.entry;
+        if (state->sink || !(entry->structured_processor || entry->dynamic_handler || entry->legacy_handler)) {
+            return handleStreamingRequest(connection, route_match, url, method, upload_data, upload_data_size, state);
+        }
+        route_match.kind = entry->structured_processor ? RouteKind::STRUCTURED
+                         : entry->dynamic_handler ? RouteKind::DYNAMIC
+                         : RouteKind::LEGACY;
+    }
+    
+    if (route_match.kind == RouteKind::DOWNLOAD) {
+        std::map<std::string, std::string> params;
+        MHD_get_connection_values(connection, MHD_GET_ARGUMENT_KIND,
+                                [](void* cls, enum MHD_ValueKind kind, const char* key, const char* value) -> enum MHD_Result {
+                                    auto* params_map = static_cast<std::map<std::string, std::string>*>(cls);
+                                    if (key && value) {
+                                        (*params_map)[std::string(key)] = std::string(value);
+                                    }
+                                    return MHD_YES;
+                                }, &params);
+        for (const auto& param : route_match.path_params) {
+            params[param.first] = param.second;
+        }
+
+        std::string file_path;
+        try {
+            file_path = route_match.entry->download_resolver(params);
+        } catch (const std::exception& e) {
+            ENDPOINT_LOG_ERROR("http", "Download resolution failed: " + std::string(e.what()));
+            return sendErrorResponse(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, "Download failed");
+        }
+        if (file_path.empty()) {
+            return sendErrorResponse(connection, MHD_HTTP_NOT_FOUND, "File not found");
+        }
+        return sendFileDownload(connection, file_path);
+    }
+
+    if (route_match.kind == RouteKind::STRUCTURED) {
         // Use structured approach
         ApiRequest api_request = buildApiRequest(connection, url, method, upload_data, upload_data_size, con_cls);
         if (api_request.request_id.empty()) {
             return MHD_YES; // Still processing, wait for more data
         }
         
-        // Log the structured request
-        api_request.logRequest();
+        // Log the structured request (formatting the body is not free, so only when asked for)
+        if (IS_ENDPOINT_LOGGING_ENABLED("http")) {
+            api_request.logRequest();
+        }
         
         // Process using structured handler
-        ApiResponse api_response = structured_it->second(api_request);
+        ApiResponse api_response = route_match.entry->structured_processor(api_request);
         return sendApiResponse(connection, api_response);
     }
     
-    // Try dynamic routing first
     std::map<std::string, std::string> query_params;
     MHD_get_connection_values(connection, MHD_GET_ARGUMENT_KIND,
                             [](void* cls, enum MHD_ValueKind kind, const char* key, const char* value) -> enum MHD_Result {
@@ -64,8 +128,7 @@ enum MHD_Result HttpHandler::handleRequest(struct MHD_Connection* connection,
                                 return MHD_YES;
                             }, &query_params);
     
-    RouteMatch route_match = dynamic_router_->findMatch(url_str);
-    if (route_match.matched) {
+    if (route_match.kind == RouteKind::DYNAMIC) {
         ENDPOINT_LOG("http", "Using dynamic routing for: " + url_str + " (pattern: " + route_match.matched_pattern + ")");
         
         // Handle the request using dynamic routing
@@ -73,26 +136,17 @@ enum MHD_Result HttpHandler::handleRequest(struct MHD_Connection* connection,
             // Get request body for non-GET requests
             std::string body;
             if (method_str != "GET" && method_str != "HEAD") {
-                std::string* con_info = static_cast<std::string*>(*con_cls);
-                if (con_info == nullptr) {
-                    con_info = new std::string();
-                    *con_cls = con_info;
-                    return MHD_YES;
-                }
-                
                 if (*upload_data_size > 0) {
                     const size_t MAX_BODY_SIZE = 10 * 1024 * 1024;
-                    if (con_info->size() + *upload_data_size > MAX_BODY_SIZE) {
+                    if (state->body.size() + *upload_data_size > MAX_BODY_SIZE) {
                         return sendErrorResponse(connection, MHD_HTTP_CONTENT_TOO_LARGE, "Request body too large");
                     }
-                    con_info->append(upload_data, *upload_data_size);
+                    state->body.append(upload_data, *upload_data_size);
                     *upload_data_size = 0;
                     return MHD_YES;
                 }
                 
-                if (!con_info->empty()) {
-                    body = *con_info;
-                }
+                body = state->body;
             }
             
             // Combine path and query parameters
@@ -101,14 +155,8 @@ enum MHD_Result HttpHandler::handleRequest(struct MHD_Connection* connection,
                 combined_params[param.first] = param.second;
             }
             
-            std::string response = dynamic_router_->processRequest(method_str, url_str, combined_params, body);
-            
-            std::string content_type = "application/json";
-            if (!response.empty() && response[0] != '{' && response[0] != '[') {
-                content_type = "text/plain";
-            }
-            
-            return sendResponse(connection, MHD_HTTP_OK, response, content_type);
+            return sendHandlerOutput(connection, url_str,
+                                     route_match.entry->dynamic_handler(method_str, combined_params, body));
             
         } catch (const std::exception& e) {
             ENDPOINT_LOG("http", "Error in dynamic routing: " + std::string(e.what()));
@@ -116,22 +164,10 @@ enum MHD_Result HttpHandler::handleRequest(struct MHD_Connection* connection,
         }
     }
     
-    // Fall back to legacy route handlers
-    auto it = route_handlers_.find(url_str);
-    if (it == route_handlers_.end()) {
-        return MHD_NO; // Let file server handle it
-    }
+    // Legacy route handler
+    const RouteHandlerFunction& legacy_handler = route_match.entry->legacy_handler;
     
     try {
-        // Critical: Handle connection state properly for MHD to prevent memory corruption
-        std::string* con_info = static_cast<std::string*>(*con_cls);
-        if (con_info == nullptr) {
-            // First call for this connection - initialize with empty body
-            con_info = new std::string();
-            *con_cls = con_info;
-            return MHD_YES;
-        }
-        
         // Handle GET requests on second call
         if (method_str == "GET" && *upload_data_size == 0) {
             // Parse query parameters
@@ -155,28 +191,7 @@ enum MHD_Result HttpHandler::handleRequest(struct MHD_Connection* connection,
             }
             
             // Process GET request
-            std::string response = it->second(method_str, params, "");
-            ENDPOINT_LOG("http", "Generated response: " + response + " (length: " + std::to_string(response.length()) + ")");
-            
-            // Create and send response
-            struct MHD_Response* mhd_response = MHD_create_response_from_buffer(
-                response.length(),
-                const_cast<char*>(response.c_str()),
-                MHD_RESPMEM_MUST_COPY
-            );
-            
-            if (!mhd_response) {
-                std::cerr << "Failed to create MHD response" << std::endl;
-                return MHD_NO;
-            }
-            
-            MHD_add_response_header(mhd_response, "Content-Type", "application/json");
-            MHD_add_response_header(mhd_response, "Access-Control-Allow-Origin", "*");
-            
-            enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_OK, mhd_response);
-            MHD_destroy_response(mhd_response);
-            
-            return ret;
+            return sendHandlerOutput(connection, url_str, legacy_handler(method_str, params, ""));
         }
         
         // Handle other HTTP methods: POST, PUT, DELETE, HEAD, OPTIONS
@@ -210,7 +225,7 @@ enum MHD_Result HttpHandler::handleRequest(struct MHD_Connection* connection,
         if (method_str == "HEAD") {
             // HEAD requests are like GET but without response body
             if (*upload_data_size == 0) {
-                std::string response = it->second(method_str, params, "");
+                std::string response = legacy_handler(method_str, params, "");
                 return sendResponse(connection, MHD_HTTP_OK, "", "application/json");
             }
         }
@@ -231,18 +246,7 @@ enum MHD_Result HttpHandler::handleRequest(struct MHD_Connection* connection,
         if (method_str == "DELETE") {
             if (*upload_data_size == 0) {
                 ENDPOINT_LOG("http", "Processing DELETE request for " + url_str);
-                std::string response = it->second(method_str, params, "");
-                
-                // Log the response for debugging
-                ENDPOINT_LOG_INFO("http", "DELETE response for " + url_str + ": " + response);
-                
-                // Determine appropriate response content type
-                std::string content_type = "application/json";
-                if (!response.empty() && response[0] != '{' && response[0] != '[') {
-                    content_type = "text/plain";
-                }
-                
-                return sendResponse(connection, MHD_HTTP_OK, response, content_type);
+                return sendHandlerOutput(connection, url_str, legacy_handler(method_str, params, ""));
             } else {
                 // Some DELETE requests might have a body (for bulk operations)
                 // Continue processing like POST/PUT
@@ -256,35 +260,21 @@ enum MHD_Result HttpHandler::handleRequest(struct MHD_Connection* connection,
             if (*upload_data_size > 0) {
                 // Limit request body size for security (10MB max)
                 const size_t MAX_BODY_SIZE = 10 * 1024 * 1024;
-                if (con_info->size() + *upload_data_size > MAX_BODY_SIZE) {
+                if (state->body.size() + *upload_data_size > MAX_BODY_SIZE) {
                     return sendErrorResponse(connection, MHD_HTTP_CONTENT_TOO_LARGE, "Request body too large");
                 }
                 
-                con_info->append(upload_data, *upload_data_size);
+                state->body.append(upload_data, *upload_data_size);
                 *upload_data_size = 0; // Mark as processed
                 return MHD_YES; // Continue processing
             }
             
-            // Get the accumulated body (skip if it contains initialization artifacts)
-            if (!con_info->empty()) {
-                body = *con_info;
-                
-                // Clean up any initialization artifacts
-                if (body.find("initialized") == 0) {
-                    body = body.substr(11); // Remove "initialized" prefix
-                }
+            // Take over the accumulated body; the connection state is done with it
+            if (!state->body.empty()) {
+                body = std::move(state->body);
                 
-                // Log request body for debugging
-                ENDPOINT_LOG_INFO("http", method_str + " request body content: " + body);
-                
-                // Try to parse and pretty-print JSON if valid
-                try {
-                    if (!body.empty() && (body[0] == '{' || body[0] == '[')) {
-                        auto parsed_json = nlohmann::json::parse(body);
-                        ENDPOINT_LOG_INFO("http", method_str + " JSON (formatted): " + parsed_json.dump(2));
-                    }
-                } catch (const std::exception& e) {
-                    ENDPOINT_LOG_INFO("http", method_str + " body (not valid JSON): " + body);
+                if (IS_ENDPOINT_LOGGING_ENABLED("http")) {
+                    ENDPOINT_LOG_INFO("http", method_str + " request body content: " + body);
                 }
             }
         }
@@ -295,93 +285,16 @@ enum MHD_Result HttpHandler::handleRequest(struct MHD_Connection* connection,
             return sendErrorResponse(connection, MHD_HTTP_METHOD_NOT_ALLOWED, "Method not allowed");
         }
         
-        // Handle backup file downloads
-        if (url_str.find("/api/backup/download/") == 0) {
-            std::string backup_id = url_str.substr(std::string("/api/backup/download/").length());
-            if (!backup_id.empty()) {
-                std::string backup_path = "ur-webif-api/data/backup-storage/" + backup_id;
-                
-                if (std::filesystem::exists(backup_path)) {
-                    // Read file content
-                    std::ifstream file(backup_path, std::ios::binary);
-                    if (file) {
-                        std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-                        file.close();
-                        
-                        // Create MHD response for file download
-                        struct MHD_Response* mhd_response = MHD_create_response_from_buffer(
-                            content.length(),
-                            const_cast<char*>(content.c_str()),
-                            MHD_RESPMEM_MUST_COPY
-                        );
-                        
-                        if (!mhd_response) {
-                            return sendErrorResponse(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, "Failed to create response");
-                        }
-                        
-                        // Set appropriate headers for file download
-                        MHD_add_response_header(mhd_response, "Content-Type", "application/octet-stream");
-                        MHD_add_response_header(mhd_response, "Content-Disposition", ("attachment; filename=\"" + backup_id + "\"").c_str());
-                        MHD_add_response_header(mhd_response, "Access-Control-Allow-Origin", "*");
-                        
-                        enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_OK, mhd_response);
-                        MHD_destroy_response(mhd_response);
-                        return ret;
-                    }
-                }
-                
-                // File not found
-                return sendErrorResponse(connection, MHD_HTTP_NOT_FOUND, "Backup file not found");
-            }
-        }
-        
-        // Process the request with timeout protection
+        // Process the request
         std::string response;
         try {
-
-            response = it->second(method_str, params, body);
-            
-            // Log the response for debugging
-            ENDPOINT_LOG_INFO("http", "Generated response for " + url_str + ": " + response);
-            
-            // Try to pretty-print JSON responses
-            try {
-                if (!response.empty() && (response[0] == '{' || response[0] == '[')) {
-                    auto parsed_json = nlohmann::json::parse(response);
-                    ENDPOINT_LOG_INFO("http", "Response JSON (formatted): " + parsed_json.dump(2));
-                }
-            } catch (const std::exception& e) {
-                ENDPOINT_LOG_INFO("http", "Response (not valid JSON): " + response);
-            }
-            
-            // Validate response size
-            if (response.size() > 100 * 1024 * 1024) { // 100MB limit
-                std::cerr << "Response too large, truncating" << std::endl;
-                return sendErrorResponse(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, "Response too large");
-            }
+            response = legacy_handler(method_str, params, body);
         } catch (const std::bad_alloc& e) {
             std::cerr << "Memory allocation error: " << e.what() << std::endl;
             return sendErrorResponse(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, "Out of memory");
         }
         
-        // Determine content type with better detection
-        std::string content_type = "text/plain";
-        if (!response.empty()) {
-            if (response[0] == '{' || response[0] == '[') {
-                try {
-                    auto parsed = nlohmann::json::parse(response);
-                    content_type = "application/json";
-                } catch (...) {
-                    // Keep as text/plain
-                }
-            } else if (response.substr(0, 5) == "<!DOC" || response.substr(0, 5) == "<html") {
-                content_type = "text/html";
-            } else if (response.substr(0, 5) == "<?xml") {
-                content_type = "application/xml";
-            }
-        }
-        
-        return sendResponse(connection, MHD_HTTP_OK, response, content_type);
+        return sendHandlerOutput(connection, url_str, std::move(response));
         
     } catch (const std::exception& e) {
         std::cerr << "Error handling request " << url_str << ": " << e.what() << std::endl;
@@ -396,7 +309,7 @@ void HttpHandler::addRouteHandler(const std::string& path,
                                  std::function<std::string(const std::string& method, 
                                                           const std::map<std::string, std::string>& params,
                                                           const std::string& body)> handler) {
-    route_handlers_[path] = handler;
+    dynamic_router_->addLegacyRoute(path, handler);
 }
 
 void HttpHandler::addDynamicRoute(const std::string& pattern,
@@ -408,9 +321,17 @@ void HttpHandler::addDynamicRoute(const std::string& pattern,
     }
 }
 
+void HttpHandler::addStreamingRouteHandler(const std::string& path, StreamingRouteFactory factory) {
+    dynamic_router_->addStreamingRoute(path, factory);
+}
+
+void HttpHandler::addDownloadRouteHandler(const std::string& pattern, DownloadRouteResolver resolver) {
+    dynamic_router_->addDownloadRoute(pattern, resolver);
+}
+
 // Structured route handler registration
 void HttpHandler::addStructuredRouteHandler(const std::string& path, RouteProcessor processor) {
-    structured_route_processors_[path] = processor;
+    dynamic_router_->addStructuredRoute(path, processor);
 }
 
 // Build structured API request
@@ -420,19 +341,13 @@ ApiRequest HttpHandler::buildApiRequest(struct MHD_Connection* connection, const
     ApiRequest request;
     
     // Critical: Handle connection state properly for MHD
-    std::string* con_info = static_cast<std::string*>(*con_cls);
-    if (con_info == nullptr) {
+    ConnectionState* state = static_cast<ConnectionState*>(*con_cls);
+    if (state == nullptr) {
         // First call - initialize with proper state tracking
-        con_info = new std::string("structured_handler_initialized");
-        *con_cls = con_info;
+        *con_cls = new ConnectionState();
         return request; // Return empty request to signal "still processing"
     }
     
-    // Validate connection state
-    if (con_info->empty() || *con_info == "structured_handler_initialized") {
-        con_info->assign("processing");
-    }
-    
     // Basic request information
     request.route = std::string(url);
     request.method = std::string(method);
@@ -468,19 +383,19 @@ ApiRequest HttpHandler::buildApiRequest(struct MHD_Connection* connection, const
     if (*upload_data_size > 0) {
         // Limit request body size for security (10MB max)
         const size_t MAX_BODY_SIZE = 10 * 1024 * 1024;
-        if (con_info->size() + *upload_data_size > MAX_BODY_SIZE) {
+        if (state->body.size() + *upload_data_size > MAX_BODY_SIZE) {
             request.request_id = ""; // Signal error
             return request;
         }
         
-        con_info->append(upload_data, *upload_data_size);
+        state->body.append(upload_data, *upload_data_size);
         *upload_data_size = 0; // Mark as processed
         return request; // Return empty request ID to signal "still processing"
     }
     
     // Get the accumulated body
-    if (!con_info->empty() && *con_info != "processing") {
-        request.body = *con_info;
+    if (!state->body.empty()) {
+        request.body = state->body;
         request.content_length = request.body.length();
         request.parseJsonBody();
     }
@@ -493,6 +408,139 @@ enum MHD_Result HttpHandler::sendApiResponse(struct MHD_Connection* connection,
     return sendResponse(connection, response.status_code, response.body, response.content_type);
 }
 
+// Wrap a string handler's already-serialized output and send it. The body is
+// never parsed here: the content type comes from its leading bytes, and the
+// pretty-printed copy for the log is only produced when "http" logging is on.
+enum MHD_Result HttpHandler::sendHandlerOutput(struct MHD_Connection* connection, const std::string& url,
+                                               std::string output) {
+    if (IS_ENDPOINT_LOGGING_ENABLED("http")) {
+        ENDPOINT_LOG_INFO("http", "Generated response for " + url + " (length: " +
+                          std::to_string(output.length()) + "): " + output);
+        if (ApiResponse::detectContentType(output) == std::string_view("application/json")) {
+            nlohmann::json parsed = nlohmann::json::parse(output, nullptr, false);
+            if (!parsed.is_discarded()) {
+                ENDPOINT_LOG_INFO("http", "Response JSON (formatted): " + parsed.dump(2));
+            }
+        }
+    }
+    
+    if (output.size() > 100 * 1024 * 1024) { // 100MB limit
+        std::cerr << "Response too large for " << url << std::endl;
+        return sendErrorResponse(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, "Response too large");
+    }
+    
+    ApiResponse response;
+    const char* content_type = ApiResponse::detectContentType(output);
+    response.setSerializedResponse(std::move(output), content_type, MHD_HTTP_OK);
+    return sendApiResponse(connection, response);
+}
+
+// Stream a file from its descriptor (sendfile), with Range support for resumed downloads
+enum MHD_Result HttpHandler::sendFileDownload(struct MHD_Connection* connection, const std::string& file_path) {
+    int fd = open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat file_stat;
+    if (fd < 0 || fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return sendErrorResponse(connection, MHD_HTTP_NOT_FOUND, "File not found");
+    }
+    
+    // Downloads are immutable once written, so size and mtime identify the content for If-Range
+    std::string etag = "\"" + std::to_string(file_stat.st_size) + "-" + std::to_string(file_stat.st_mtime) + "\"";
+    std::string filename = file_path.substr(file_path.find_last_of('/') + 1);
+    
+    ENDPOINT_LOG("http", "Serving download " + file_path + " (" + std::to_string(file_stat.st_size) + " bytes)");
+    
+    return FileResponse::queueFile(connection, fd, static_cast<uint64_t>(file_stat.st_size),
+                                   "application/octet-stream", etag,
+                                   [&](struct MHD_Response* response) {
+        MHD_add_response_header(response, "Content-Disposition", ("attachment; filename=\"" + filename + "\"").c_str());
+        MHD_add_response_header(response, "ETag", etag.c_str());
+        MHD_add_response_header(response, "Access-Control-Allow-Origin", "*");
+    });
+}
+
+// Ask the route's factory for a sink; nullptr means the request is not for the streaming handler
+std::unique_ptr<RequestBodySink> HttpHandler::openStreamingSink(struct MHD_Connection* connection, const RouteMatch& route_match,
+                                                                const char* url, const char* method) {
+    ApiRequest request;
+    request.route = std::string(url);
+    request.method = std::string(method);
+    request.generateRequestId();
+    request.headers = parseHeaders(connection);
+    MHD_get_connection_values(connection, MHD_GET_ARGUMENT_KIND,
+                            [](void* cls, enum MHD_ValueKind kind, const char* key, const char* value) -> enum MHD_Result {
+                                auto* params_map = static_cast<std::map<std::string, std::string>*>(cls);
+                                if (key && value) {
+                                    (*params_map)[std::string(key)] = std::string(value);
+                                }
+                                return MHD_YES;
+                            }, &request.params);
+    for (const auto& param : route_match.path_params) {
+        request.params[param.first] = param.second;
+    }
+    
+    auto content_length = request.headers.find("Content-Length");
+    if (content_length != request.headers.end()) {
+        request.content_length = std::strtoull(content_length->second.c_str(), nullptr, 10);
+    }
+    
+    ENDPOINT_LOG("http", "Opening streaming body sink for " + request.method + " " + request.route);
+    
+    try {
+        return route_match.entry->streaming_factory(request);
+    } catch (const std::exception& e) {
+        ENDPOINT_LOG_ERROR("http", "Streaming sink creation failed: " + std::string(e.what()));
+    }
+    return nullptr;
+}
+
+// Streaming request: hand each upload chunk to the route's sink as it arrives
+enum MHD_Result HttpHandler::handleStreamingRequest(struct MHD_Connection* connection, const RouteMatch& route_match,
+                                                    const char* url, const char* method,
+                                                    const char* upload_data, size_t* upload_data_size,
+                                                    ConnectionState* state) {
+    if (state->sink_finished) {
+        // Response already queued after a rejected chunk; drop the rest of the body
+        *upload_data_size = 0;
+        return MHD_YES;
+    }
+    
+    if (!state->sink) {
+        // Factory declined this request and no buffered handler shares the path
+        return sendErrorResponse(connection, MHD_HTTP_BAD_REQUEST, "Request rejected");
+    }
+    
+    if (*upload_data_size > 0) {
+        bool accepted = false;
+        try {
+            accepted = state->sink->consume(upload_data, *upload_data_size);
+        } catch (const std::exception& e) {
+            ENDPOINT_LOG_ERROR("http", "Streaming sink error: " + std::string(e.what()));
+        }
+        *upload_data_size = 0;
+        
+        if (!accepted) {
+            ApiResponse error_response = state->sink->errorResponse();
+            state->sink->abort();
+            state->sink_finished = true;
+            return sendApiResponse(connection, error_response);
+        }
+        return MHD_YES;
+    }
+    
+    // Final call: body fully consumed
+    state->sink_finished = true;
+    try {
+        return sendApiResponse(connection, state->sink->finish());
+    } catch (const std::exception& e) {
+        ENDPOINT_LOG_ERROR("http", "Streaming sink finish failed: " + std::string(e.what()));
+        state->sink->abort();
+        return sendErrorResponse(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, "Internal server error");
+    }
+}
+
 std::map<std::string, std::string> HttpHandler::parseQueryString(const std::string& query) {
     std::map<std::string, std::string> params;
     std::istringstream iss(query);
@@ -513,8 +561,14 @@ std::map<std::string, std::string> HttpHandler::parseQueryString(const std::stri
 std::map<std::string, std::string> HttpHandler::parseHeaders(struct MHD_Connection* connection) {
     std::map<std::string, std::string> headers;
     
-    // This would need a custom iterator function for MHD headers
-    // For now, we'll implement specific header lookups as needed
+    MHD_get_connection_values(connection, MHD_HEADER_KIND,
+                            [](void* cls, enum MHD_ValueKind kind, const char* key, const char* value) -> enum MHD_Result {
+                                auto* headers_map = static_cast<std::map<std::string, std::string>*>(cls);
+                                if (key && value) {
+                                    (*headers_map)[std::string(key)] = std::string(value);
+                                }
+                                return MHD_YES;
+                            }, &headers);
     
     return headers;
 }
@@ -535,18 +589,33 @@ enum MHD_Result HttpHandler::sendResponse(struct MHD_Connection* connection,
     // Critical: Create response with robust memory management to prevent core dumps
     struct MHD_Response* response = nullptr;
     
-    // Validate content before creating response
-    std::string validated_content = content;
-    if (validated_content.empty()) {
+    // Validate content before creating response; MHD copies the bytes, so no local copy is needed
+    static const std::string empty_body_fallback = "{\"error\":\"Empty response\"}";
+    const std::string* body = &content;
+    if (body->empty()) {
         std::cerr << "Warning: Attempting to send empty response" << std::endl;
-        validated_content = std::string("{\"error\":\"Empty response\"}");
+        body = &empty_body_fallback;
+    }
+    
+    // Compress large text/JSON bodies for clients that accept gzip
+    bool varies_by_encoding = body->size() >= HttpCompression::DYNAMIC_COMPRESS_SIZE &&
+                              HttpCompression::isCompressibleType(content_type);
+    bool gzip_encoded = false;
+    std::string compressed;
+    if (varies_by_encoding &&
+        HttpCompression::acceptsGzip(MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Accept-Encoding"))) {
+        compressed = HttpCompression::gzip(*body, HttpCompression::DYNAMIC_COMPRESS_LEVEL);
+        if (!compressed.empty() && compressed.size() < body->size()) {
+            body = &compressed;
+            gzip_encoded = true;
+        }
     }
     
     // Use safe memory allocation strategy
     try {
         response = MHD_create_response_from_buffer(
-            validated_content.length(),
-            const_cast<char*>(validated_content.c_str()),
+            body->length(),
+            const_cast<char*>(body->data()),
             MHD_RESPMEM_MUST_COPY  // Safe: MHD copies data, no memory ownership issues
         );
     } catch (const std::exception& e) {
@@ -561,7 +630,13 @@ enum MHD_Result HttpHandler::sendResponse(struct MHD_Connection* connection,
     
     // Set comprehensive headers for robust web operations
     MHD_add_response_header(response, "Content-Type", content_type.c_str());
-    MHD_add_response_header(response, "Content-Length", std::to_string(content.length()).c_str());
+    MHD_add_response_header(response, "Content-Length", std::to_string(body->length()).c_str());
+    if (gzip_encoded) {
+        MHD_add_response_header(response, "Content-Encoding", "gzip");
+    }
+    if (varies_by_encoding) {
+        MHD_add_response_header(response, "Vary", "Accept-Encoding");
+    }
     
     // Security headers
     MHD_add_response_header(response, "X-Content-Type-Options", "nosniff");
@@ -0,0 +1,756 @@
+#include "icmp_engine.h"
+#include "endpoint_logger.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <linux/errqueue.h>
+#include <linux/icmp.h>
+#include <netinet/icmp6.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint64_t WAKE_KEY = 0;            // Socket keys start at 1
+constexpr size_t ICMP_HEADER_LENGTH = 8;
+constexpr size_t RECEIVE_BUFFER_SIZE = 65536 + 60;
+constexpr size_t CONTROL_BUFFER_SIZE = 512;
+
+constexpr uint8_t ICMP4_ECHO_REQUEST = 8;
+constexpr uint8_t ICMP4_ECHO_REPLY = 0;
+constexpr uint8_t ICMP6_ECHO_REQUEST_TYPE = 128;
+constexpr uint8_t ICMP6_ECHO_REPLY_TYPE = 129;
+
+// The epoll key carries everything the reactor needs to read a socket, so
+// it never looks at sockets_ (which start() fills under the mutex)
+uint64_t socketKey(int fd, size_t index, bool raw) {
+    return (static_cast<uint64_t>(fd) << 32) | (raw ? 0x100u : 0u) | (index + 1);
+}
+
+uint16_t checksum(const uint8_t* data, size_t length) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i + 1 < length; i += 2) {
+        sum += static_cast<uint32_t>(data[i] << 8 | data[i + 1]);
+    }
+    if (length & 1) {
+        sum += static_cast<uint32_t>(data[length - 1] << 8);
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return static_cast<uint16_t>(~sum);
+}
+
+double millisecondsBetween(const timespec& from, const timespec& to) {
+    return (to.tv_sec - from.tv_sec) * 1000.0 + (to.tv_nsec - from.tv_nsec) / 1e6;
+}
+
+bool sameAddress(const sockaddr_storage& a, const sockaddr_storage& b) {
+    if (a.ss_family != b.ss_family) {
+        return false;
+    }
+    if (a.ss_family == AF_INET) {
+        return reinterpret_cast<const sockaddr_in&>(a).sin_addr.s_addr ==
+               reinterpret_cast<const sockaddr_in&>(b).sin_addr.s_addr;
+    }
+    return std::memcmp(&reinterpret_cast<const sockaddr_in6&>(a).sin6_addr,
+                       &reinterpret_cast<const sockaddr_in6&>(b).sin6_addr, sizeof(in6_addr)) == 0;
+}
+
+// Wording follows iputils ping so results read the same as before
+std::string describeError(const sock_extended_err& error) {
+    if (error.ee_origin == SO_EE_ORIGIN_ICMP) {
+        if (error.ee_type == ICMP_DEST_UNREACH) {
+            switch (error.ee_code) {
+            case ICMP_NET_UNREACH: return "Destination Net Unreachable";
+            case ICMP_HOST_UNREACH: return "Destination Host Unreachable";
+            case ICMP_PROT_UNREACH: return "Destination Protocol Unreachable";
+            case ICMP_PORT_UNREACH: return "Destination Port Unreachable";
+            case ICMP_FRAG_NEEDED: return "Frag needed and DF set (mtu = " + std::to_string(error.ee_info) + ")";
+            case ICMP_NET_ANO:
+            case ICMP_HOST_ANO:
+            case ICMP_PKT_FILTERED: return "Packet filtered";
+            default: return "Destination Unreachable, Bad Code: " + std::to_string(error.ee_code);
+            }
+        }
+        if (error.ee_type == ICMP_TIME_EXCEEDED) {
+            return "Time to live exceeded";
+        }
+    } else if (error.ee_origin == SO_EE_ORIGIN_ICMP6) {
+        if (error.ee_type == ICMP6_DST_UNREACH) {
+            switch (error.ee_code) {
+            case ICMP6_DST_UNREACH_NOROUTE: return "Destination Net Unreachable";
+            case ICMP6_DST_UNREACH_ADMIN: return "Packet filtered";
+            case ICMP6_DST_UNREACH_ADDR: return "Destination Host Unreachable";
+            case ICMP6_DST_UNREACH_NOPORT: return "Destination Port Unreachable";
+            default: return "Destination Unreachable, Bad Code: " + std::to_string(error.ee_code);
+            }
+        }
+        if (error.ee_type == ICMP6_PACKET_TOO_BIG) {
+            return "Packet too big: mtu=" + std::to_string(error.ee_info);
+        }
+        if (error.ee_type == ICMP6_TIME_EXCEEDED) {
+            return "Time to live exceeded";
+        }
+    }
+    return std::strerror(static_cast<int>(error.ee_errno));
+}
+
+} // namespace
+
+struct IcmpEngine::Session {
+    uint64_t id = 0;
+    size_t socket = 0;
+    Options options;
+    Result result;
+    int outstanding = 0;        // Probes sent and not yet answered or timed out
+    bool stopped = false;
+    std::chrono::steady_clock::time_point next_send;
+};
+
+IcmpEngine& IcmpEngine::getInstance() {
+    static IcmpEngine instance;
+    return instance;
+}
+
+IcmpEngine::IcmpEngine()
+    : ident_(static_cast<uint16_t>(::getpid() & 0xffff)),
+      receive_buffer_(RECEIVE_BUFFER_SIZE) {
+    epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (epoll_fd_ < 0 || wake_fd_ < 0) {
+        ENDPOINT_LOG("icmp-engine", "Failed to create epoll/eventfd: " + std::string(std::strerror(errno)));
+        return;
+    }
+
+    struct epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = WAKE_KEY;
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event);
+
+    thread_ = std::thread(&IcmpEngine::reactorLoop, this);
+}
+
+IcmpEngine::~IcmpEngine() {
+    shutdown();
+    for (auto& socket : sockets_) {
+        if (socket.fd >= 0) {
+            ::close(socket.fd);
+        }
+    }
+    if (wake_fd_ >= 0) {
+        ::close(wake_fd_);
+    }
+    if (epoll_fd_ >= 0) {
+        ::close(epoll_fd_);
+    }
+}
+
+size_t IcmpEngine::socketIndex(int family, bool dont_fragment) {
+    return (family == AF_INET6 ? 2 : 0) + (dont_fragment ? 1 : 0);
+}
+
+bool IcmpEngine::openSocket(size_t index, std::string& error) {
+    Socket& socket = sockets_[index];
+    if (socket.fd >= 0) {
+        return true;
+    }
+
+    int family = index >= 2 ? AF_INET6 : AF_INET;
+    int protocol = family == AF_INET6 ? static_cast<int>(IPPROTO_ICMPV6) : static_cast<int>(IPPROTO_ICMP);
+    bool dont_fragment = index & 1;
+
+    // Datagram ICMP sockets need no privileges when ping_group_range
+    // includes our group; raw sockets need CAP_NET_RAW
+    bool raw = false;
+    int fd = ::socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, protocol);
+    if (fd < 0) {
+        int datagram_errno = errno;
+        fd = ::socket(family, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, protocol);
+        if (fd < 0) {
+            error = "cannot open ICMP socket: " + std::string(std::strerror(datagram_errno));
+            return false;
+        }
+        raw = true;
+    }
+
+    int on = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+    if (family == AF_INET) {
+        ::setsockopt(fd, IPPROTO_IP, IP_RECVERR, &on, sizeof(on));
+        ::setsockopt(fd, IPPROTO_IP, IP_RECVTTL, &on, sizeof(on));
+        if (dont_fragment) {
+            int pmtu = IP_PMTUDISC_DO;
+            ::setsockopt(fd, IPPROTO_IP, IP_MTU_DISCOVER, &pmtu, sizeof(pmtu));
+        }
+        if (raw) {
+            // Raw sockets see every incoming ICMP message; errors come
+            // through the error queue, so only echo replies are wanted
+            struct icmp_filter filter{};
+            filter.data = ~(1U << ICMP4_ECHO_REPLY);
+            ::setsockopt(fd, SOL_RAW, ICMP_FILTER, &filter, sizeof(filter));
+        }
+    } else {
+        ::setsockopt(fd, IPPROTO_IPV6, IPV6_RECVERR, &on, sizeof(on));
+        ::setsockopt(fd, IPPROTO_IPV6, IPV6_RECVHOPLIMIT, &on, sizeof(on));
+        if (dont_fragment) {
+            int pmtu = IPV6_PMTUDISC_DO;
+            ::setsockopt(fd, IPPROTO_IPV6, IPV6_MTU_DISCOVER, &pmtu, sizeof(pmtu));
+        }
+        if (raw) {
+            struct icmp6_filter filter;
+            ICMP6_FILTER_SETBLOCKALL(&filter);
+            ICMP6_FILTER_SETPASS(ICMP6_ECHO_REPLY_TYPE, &filter);
+            ::setsockopt(fd, IPPROTO_ICMPV6, ICMP6_FILTER, &filter, sizeof(filter));
+        }
+    }
+
+    struct epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = socketKey(fd, index, raw);
+    if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+        error = "cannot watch ICMP socket: " + std::string(std::strerror(errno));
+        ::close(fd);
+        return false;
+    }
+
+    socket.fd = fd;
+    socket.family = family;
+    socket.raw = raw;
+    ENDPOINT_LOG("icmp-engine", std::string("Opened ") + (raw ? "raw" : "datagram") + " ICMP socket for " +
+                 (family == AF_INET6 ? "IPv6" : "IPv4") + (dont_fragment ? " (don't fragment)" : ""));
+    return true;
+}
+
+bool IcmpEngine::available(int family) {
+    if (family != AF_INET && family != AF_INET6) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string error;
+    return epoll_fd_ >= 0 && !stopping_.load() && openSocket(socketIndex(family, false), error);
+}
+
+uint64_t IcmpEngine::start(Options options) {
+    auto session = std::make_unique<Session>();
+    session->options = std::move(options);
+
+    auto fail = [&](const std::string& error) -> uint64_t {
+        session->result.error = error;
+        ENDPOINT_LOG("icmp-engine", "Cannot start ping to " +
+                     formatAddress(reinterpret_cast<const sockaddr*>(&session->options.address)) + ": " + error);
+        if (session->options.on_done) {
+            session->options.on_done(session->result);
+        }
+        return 0;
+    };
+
+    const Options& requested = session->options;
+    int family = requested.address.ss_family;
+    if (family != AF_INET && family != AF_INET6) {
+        return fail("unsupported address family");
+    }
+    if (requested.count < 0 || requested.payload_size < 0 || requested.payload_size > MAX_PAYLOAD ||
+        requested.ttl < 1 || requested.ttl > 255) {
+        return fail("invalid options");
+    }
+
+    uint64_t id = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::string error;
+        if (stopping_.load() || epoll_fd_ < 0) {
+            error = "ICMP engine is not running";
+        } else {
+            openSocket(socketIndex(family, requested.dont_fragment), error);
+        }
+        if (!error.empty()) {
+            // Unlock before calling back into the caller
+            session->result.error = error;
+        } else {
+            session->socket = socketIndex(family, requested.dont_fragment);
+            id = session->id = ++next_id_;
+            live_.insert(id);
+            pending_.push_back(std::move(session));
+        }
+    }
+    if (session) {
+        return fail(session->result.error);
+    }
+
+    wake();
+    return id;
+}
+
+bool IcmpEngine::stop(uint64_t id) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!live_.count(id)) {
+            return false;
+        }
+        stop_requests_.push_back(id);
+    }
+    wake();
+    return true;
+}
+
+IcmpEngine::Result IcmpEngine::run(const sockaddr_storage& address, socklen_t address_length, int count,
+                                   std::chrono::milliseconds interval, std::chrono::milliseconds timeout) {
+    if (std::this_thread::get_id() == thread_.get_id()) {
+        Result result;
+        result.error = "run() called from the reactor thread";
+        return result;
+    }
+
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    bool done = false;
+    Result result;
+    std::vector<Echo> echoes;
+
+    Options options;
+    options.address = address;
+    options.address_length = address_length;
+    options.count = std::max(count, 1);
+    options.interval = interval;
+    options.timeout = timeout;
+    options.on_echo = [&](const Echo& echo) {
+        echoes.push_back(echo);     // Reactor thread; read only after on_done
+    };
+    options.on_done = [&](const Result& finished) {
+        std::lock_guard<std::mutex> lock(done_mutex);
+        result = finished;
+        result.echoes = std::move(echoes);
+        done = true;
+        done_cv.notify_one();
+    };
+
+    start(std::move(options));
+
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done_cv.wait(lock, [&]() { return done; });
+    return result;
+}
+
+std::string IcmpEngine::formatAddress(const sockaddr* address) {
+    char text[INET6_ADDRSTRLEN] = "";
+    if (address->sa_family == AF_INET) {
+        ::inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in*>(address)->sin_addr, text, sizeof(text));
+    } else if (address->sa_family == AF_INET6) {
+        ::inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6*>(address)->sin6_addr, text, sizeof(text));
+    }
+    return text;
+}
+
+size_t IcmpEngine::activeCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return live_.size();
+}
+
+void IcmpEngine::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_.exchange(true)) {
+            return;
+        }
+    }
+    wake();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void IcmpEngine::wake() {
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t written = ::write(wake_fd_, &one, sizeof(one));
+}
+
+void IcmpEngine::adoptPending() {
+    std::vector<std::unique_ptr<Session>> adopted;
+    std::vector<uint64_t> stops;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        adopted.swap(pending_);
+        stops.swap(stop_requests_);
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    for (auto& session : adopted) {
+        session->next_send = now;
+        uint64_t id = session->id;
+        sessions_.emplace(id, std::move(session));
+    }
+    for (uint64_t id : stops) {
+        auto it = sessions_.find(id);
+        if (it != sessions_.end()) {
+            it->second->stopped = true;
+        }
+    }
+}
+
+void IcmpEngine::reactorLoop() {
+    std::vector<epoll_event> events(16);
+
+    while (!stopping_.load()) {
+        adoptPending();
+
+        auto now = std::chrono::steady_clock::now();
+        for (auto& [id, session] : sessions_) {
+            const Options& options = session->options;
+            if (!session->stopped && (options.count == 0 || session->result.sent < options.count) &&
+                session->next_send <= now) {
+                sendProbe(*session);
+                // A late reactor does not make up for lost time with a burst
+                session->next_send = std::max(session->next_send + options.interval, now);
+            }
+        }
+        checkDeadlines();
+
+        std::vector<uint64_t> done;
+        for (auto& [id, session] : sessions_) {
+            const Options& options = session->options;
+            bool all_sent = options.count > 0 && session->result.sent >= options.count;
+            if (session->stopped || (all_sent && session->outstanding == 0)) {
+                done.push_back(id);
+            }
+        }
+        for (uint64_t id : done) {
+            finish(id);
+        }
+
+        int ready = ::epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), nextTimeoutMs());
+        for (int i = 0; i < ready; ++i) {
+            uint64_t key = events[i].data.u64;
+            if (key == WAKE_KEY) {
+                uint64_t count;
+                [[maybe_unused]] ssize_t drained = ::read(wake_fd_, &count, sizeof(count));
+                continue;
+            }
+            Socket socket;
+            socket.fd = static_cast<int>(key >> 32);
+            socket.family = (key & 0xff) - 1 >= 2 ? AF_INET6 : AF_INET;
+            socket.raw = key & 0x100;
+            if (events[i].events & EPOLLERR) {
+                receiveErrors(socket);
+            }
+            if (events[i].events & EPOLLIN) {
+                receive(socket);
+            }
+        }
+    }
+
+    // Shutting down: everything still queued or running ends cancelled
+    adoptPending();
+    for (auto& [id, session] : sessions_) {
+        session->stopped = true;
+    }
+    while (!sessions_.empty()) {
+        finish(sessions_.begin()->first);
+    }
+}
+
+void IcmpEngine::sendProbe(Session& session) {
+    const Options& options = session.options;
+    int sequence = ++session.result.sent;
+
+    Echo failed;
+    failed.sequence = sequence;
+
+    // Wire sequence numbers are shared by every session on the socket
+    bool allocated = false;
+    uint16_t wire = 0;
+    for (int attempt = 0; attempt < 65536 && !allocated; ++attempt) {
+        wire = next_wire_sequence_++;
+        allocated = !in_flight_.count(wire);
+    }
+    if (!allocated) {
+        failed.error = "Too many probes in flight";
+        Probe probe{session.id, sequence, {}, {}};
+        ++session.outstanding;
+        complete(probe, failed);
+        return;
+    }
+
+    const Socket& socket = sockets_[session.socket];
+    if (socket_ttl_[session.socket] != options.ttl) {
+        if (socket.family == AF_INET) {
+            ::setsockopt(socket.fd, IPPROTO_IP, IP_TTL, &options.ttl, sizeof(options.ttl));
+        } else {
+            ::setsockopt(socket.fd, IPPROTO_IPV6, IPV6_UNICAST_HOPS, &options.ttl, sizeof(options.ttl));
+        }
+        socket_ttl_[session.socket] = options.ttl;
+    }
+
+    size_t length = ICMP_HEADER_LENGTH + static_cast<size_t>(options.payload_size);
+    if (send_buffer_.size() < length) {
+        size_t filled = send_buffer_.size();
+        send_buffer_.resize(length);
+        for (size_t i = std::max(filled, ICMP_HEADER_LENGTH); i < length; ++i) {
+            send_buffer_[i] = static_cast<uint8_t>(i - ICMP_HEADER_LENGTH);
+        }
+    }
+    uint8_t* packet = send_buffer_.data();
+    packet[0] = socket.family == AF_INET ? ICMP4_ECHO_REQUEST : ICMP6_ECHO_REQUEST_TYPE;
+    packet[1] = 0;
+    packet[2] = packet[3] = 0;
+    // The kernel replaces the identifier on datagram sockets
+    packet[4] = static_cast<uint8_t>(ident_ >> 8);
+    packet[5] = static_cast<uint8_t>(ident_);
+    packet[6] = static_cast<uint8_t>(wire >> 8);
+    packet[7] = static_cast<uint8_t>(wire);
+    if (socket.family == AF_INET) {
+        // ICMPv6 checksums are always computed by the kernel
+        uint16_t sum = checksum(packet, length);
+        packet[2] = static_cast<uint8_t>(sum >> 8);
+        packet[3] = static_cast<uint8_t>(sum);
+    }
+
+    Probe probe;
+    probe.session = session.id;
+    probe.sequence = sequence;
+    ::clock_gettime(CLOCK_REALTIME, &probe.sent);
+    probe.deadline = std::chrono::steady_clock::now() + options.timeout;
+
+    ssize_t sent = ::sendto(socket.fd, packet, length, 0,
+                            reinterpret_cast<const sockaddr*>(&options.address), options.address_length);
+    ++session.outstanding;
+    if (sent < 0) {
+        failed.error = std::strerror(errno);
+        complete(probe, failed);
+        return;
+    }
+    in_flight_.emplace(wire, probe);
+}
+
+void IcmpEngine::receive(const Socket& socket) {
+    char control[CONTROL_BUFFER_SIZE];
+
+    while (true) {
+        sockaddr_storage from{};
+        struct iovec iov{receive_buffer_.data(), receive_buffer_.size()};
+        struct msghdr message{};
+        message.msg_name = &from;
+        message.msg_namelen = sizeof(from);
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        ssize_t n = ::recvmsg(socket.fd, &message, MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                ENDPOINT_LOG("icmp-engine", "recvmsg failed: " + std::string(std::strerror(errno)));
+            }
+            return;
+        }
+
+        timespec received{};
+        bool stamped = false;
+        int ttl = 0;
+        for (cmsghdr* header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+            if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_TIMESTAMPNS) {
+                std::memcpy(&received, CMSG_DATA(header), sizeof(received));
+                stamped = true;
+            } else if ((header->cmsg_level == IPPROTO_IP && header->cmsg_type == IP_TTL) ||
+                       (header->cmsg_level == IPPROTO_IPV6 && header->cmsg_type == IPV6_HOPLIMIT)) {
+                std::memcpy(&ttl, CMSG_DATA(header), sizeof(ttl));
+            }
+        }
+        if (!stamped) {
+            ::clock_gettime(CLOCK_REALTIME, &received);
+        }
+
+        const uint8_t* icmp = receive_buffer_.data();
+        size_t length = static_cast<size_t>(n);
+        if (socket.raw && socket.family == AF_INET) {
+            size_t header_length = static_cast<size_t>(icmp[0] & 0x0f) * 4;
+            if (length < header_length + ICMP_HEADER_LENGTH) {
+                continue;
+            }
+            if (ttl == 0) {
+                ttl = icmp[8];
+            }
+            icmp += header_length;
+            length -= header_length;
+        }
+        if (length < ICMP_HEADER_LENGTH) {
+            continue;
+        }
+
+        uint8_t reply_type = socket.family == AF_INET ? ICMP4_ECHO_REPLY : ICMP6_ECHO_REPLY_TYPE;
+        uint16_t identifier = static_cast<uint16_t>(icmp[4] << 8 | icmp[5]);
+        if (icmp[0] != reply_type || (socket.raw && identifier != ident_)) {
+            continue;   // Someone else's ping on a raw socket
+        }
+
+        auto probe = in_flight_.find(static_cast<uint16_t>(icmp[6] << 8 | icmp[7]));
+        if (probe == in_flight_.end()) {
+            continue;   // Duplicate or too late
+        }
+        auto session = sessions_.find(probe->second.session);
+        if (session != sessions_.end() && !sameAddress(from, session->second->options.address)) {
+            continue;
+        }
+
+        Echo echo;
+        echo.sequence = probe->second.sequence;
+        echo.success = true;
+        echo.rtt_ms = std::max(0.0, millisecondsBetween(probe->second.sent, received));
+        echo.ttl = ttl;
+        echo.bytes = static_cast<int>(length);
+        echo.from = formatAddress(reinterpret_cast<const sockaddr*>(&from));
+
+        Probe answered = probe->second;
+        in_flight_.erase(probe);
+        complete(answered, echo);
+    }
+}
+
+void IcmpEngine::receiveErrors(const Socket& socket) {
+    char control[CONTROL_BUFFER_SIZE];
+
+    while (true) {
+        sockaddr_storage target{};
+        struct iovec iov{receive_buffer_.data(), receive_buffer_.size()};
+        struct msghdr message{};
+        message.msg_name = &target;
+        message.msg_namelen = sizeof(target);
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        ssize_t n = ::recvmsg(socket.fd, &message, MSG_ERRQUEUE | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+
+        const sock_extended_err* error = nullptr;
+        for (cmsghdr* header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+            if ((header->cmsg_level == IPPROTO_IP && header->cmsg_type == IP_RECVERR) ||
+                (header->cmsg_level == IPPROTO_IPV6 && header->cmsg_type == IPV6_RECVERR)) {
+                error = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(header));
+            }
+        }
+
+        // The queued payload is the echo request that provoked the error
+        const uint8_t* icmp = receive_buffer_.data();
+        if (!error || static_cast<size_t>(n) < ICMP_HEADER_LENGTH) {
+            continue;
+        }
+        uint16_t identifier = static_cast<uint16_t>(icmp[4] << 8 | icmp[5]);
+        if (socket.raw && identifier != ident_) {
+            continue;
+        }
+        auto probe = in_flight_.find(static_cast<uint16_t>(icmp[6] << 8 | icmp[7]));
+        if (probe == in_flight_.end()) {
+            continue;
+        }
+
+        Echo echo;
+        echo.sequence = probe->second.sequence;
+        echo.error = describeError(*error);
+        const sockaddr* offender = SO_EE_OFFENDER(error);
+        if (offender->sa_family == AF_INET || offender->sa_family == AF_INET6) {
+            echo.from = formatAddress(offender);
+        }
+
+        Probe answered = probe->second;
+        in_flight_.erase(probe);
+        complete(answered, echo);
+    }
+}
+
+void IcmpEngine::complete(const Probe& probe, const Echo& echo) {
+    auto it = sessions_.find(probe.session);
+    if (it == sessions_.end()) {
+        return;
+    }
+    Session& session = *it->second;
+    --session.outstanding;
+    if (echo.success) {
+        ++session.result.received;
+    }
+    if (session.stopped || !session.options.on_echo) {
+        return;
+    }
+    try {
+        session.options.on_echo(echo);
+    } catch (const std::exception& e) {
+        ENDPOINT_LOG("icmp-engine", "Echo callback threw: " + std::string(e.what()));
+    }
+}
+
+void IcmpEngine::checkDeadlines() {
+    auto now = std::chrono::steady_clock::now();
+    for (auto it = in_flight_.begin(); it != in_flight_.end();) {
+        auto session = sessions_.find(it->second.session);
+        bool abandoned = session == sessions_.end() || session->second->stopped;
+        if (!abandoned && it->second.deadline > now) {
+            ++it;
+            continue;
+        }
+        Probe probe = it->second;
+        it = in_flight_.erase(it);
+
+        Echo echo;
+        echo.sequence = probe.sequence;
+        echo.error = "Request timeout";
+        complete(probe, echo);
+    }
+}
+
+void IcmpEngine::finish(uint64_t id) {
+    auto it = sessions_.find(id);
+    if (it == sessions_.end()) {
+        return;
+    }
+    std::unique_ptr<Session> session = std::move(it->second);
+    sessions_.erase(it);
+    for (auto probe = in_flight_.begin(); probe != in_flight_.end();) {
+        probe = probe->second.session == id ? in_flight_.erase(probe) : std::next(probe);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        live_.erase(id);
+    }
+
+    session->result.cancelled = session->stopped;
+    if (!session->options.on_done) {
+        return;
+    }
+    try {
+        session->options.on_done(session->result);
+    } catch (const std::exception& e) {
+        ENDPOINT_LOG("icmp-engine", "Completion callback threw: " + std::string(e.what()));
+    }
+}
+
+int IcmpEngine::nextTimeoutMs() const {
+    auto next = std::chrono::steady_clock::time_point::max();
+    for (const auto& [id, session] : sessions_) {
+        const Options& options = session->options;
+        if (!session->stopped && (options.count == 0 || session->result.sent < options.count)) {
+            next = std::min(next, session->next_send);
+        }
+    }
+    for (const auto& [wire, probe] : in_flight_) {
+        next = std::min(next, probe.deadline);
+    }
+    if (next == std::chrono::steady_clock::time_point::max()) {
+        return -1;
+    }
+
+    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next - std::chrono::steady_clock::now());
+    return static_cast<int>(std::clamp<int64_t>(wait.count() + 1, 0, 60000));
+}
@@ -0,0 +1,459 @@
+#include "json_document_store.h"
+#include "atomic_file.h"
+#include "endpoint_logger.h"
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t WAKE_KEY = 0;
+constexpr uint64_t INOTIFY_KEY = 1;
+constexpr std::chrono::seconds RETRY_DELAY{5};     // After a failed write
+constexpr uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE;
+
+} // namespace
+
+JsonDocumentStore& JsonDocumentStore::getInstance() {
+    static JsonDocumentStore instance;
+    return instance;
+}
+
+JsonDocumentStore::JsonDocumentStore() {
+    // Constructed first so that it outlives the store, which flushes through it
+    WriteJournal::getInstance();
+
+    epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (epoll_fd_ < 0 || wake_fd_ < 0) {
+        ENDPOINT_LOG("json-store", "Failed to create epoll/eventfd, writing synchronously: " +
+                     std::string(std::strerror(errno)));
+        stopping_.store(true);
+        return;
+    }
+
+    struct epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = WAKE_KEY;
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event);
+
+    // Without inotify outside edits are not noticed, but everything else works
+    inotify_fd_ = ::inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (inotify_fd_ >= 0) {
+        event.data.u64 = INOTIFY_KEY;
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, inotify_fd_, &event);
+    } else {
+        ENDPOINT_LOG("json-store", "inotify unavailable: " + std::string(std::strerror(errno)));
+    }
+
+    thread_ = std::thread(&JsonDocumentStore::storeLoop, this);
+}
+
+JsonDocumentStore::~JsonDocumentStore() {
+    shutdown();
+    for (int fd : {inotify_fd_, wake_fd_, epoll_fd_}) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+}
+
+std::string JsonDocumentStore::normalize(const std::string& path) {
+    return std::filesystem::path(path).lexically_normal().string();
+}
+
+bool JsonDocumentStore::stampFile(const std::string& path, FileStamp& stamp) {
+    struct stat info{};
+    if (::stat(path.c_str(), &info) != 0) {
+        stamp = FileStamp{};
+        return false;
+    }
+    stamp.inode = info.st_ino;
+    stamp.size = info.st_size;
+    stamp.mtime_ns = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+    return true;
+}
+
+std::shared_ptr<const JsonDocumentStore::Version> JsonDocumentStore::parseFile(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return nullptr;
+    }
+    try {
+        return std::make_shared<const Version>(nlohmann::json::parse(file));
+    } catch (const std::exception& e) {
+        ENDPOINT_LOG("json-store", "Cannot parse " + path + ": " + e.what());
+        return nullptr;
+    }
+}
+
+std::shared_ptr<JsonDocumentStore::Document> JsonDocumentStore::document(const std::string& path) {
+    std::string key = normalize(path);
+    {
+        std::shared_lock<std::shared_mutex> lock(documents_mutex_);
+        auto it = documents_.find(key);
+        if (it != documents_.end()) {
+            return it->second;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(documents_mutex_);
+    auto& entry = documents_[key];
+    if (!entry) {
+        entry = std::make_shared<Document>();
+        entry->path = key;
+    }
+    return entry;
+}
+
+std::shared_ptr<const JsonDocumentStore::Version> JsonDocumentStore::current(Document& document) {
+    {
+        std::shared_lock<std::shared_mutex> lock(document.lock);
+        if (document.loaded) {
+            return document.current;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(document.lock);
+    if (!document.loaded) {
+        // Stamp first: a change racing with the read is then seen as a change
+        FileStamp stamp;
+        stampFile(document.path, stamp);
+        document.current = parseFile(document.path);
+        document.loaded = true;
+        {
+            std::lock_guard<std::mutex> state(state_mutex_);
+            document.stamp = stamp;
+        }
+        watchDirectory(document.path);
+    }
+    return document.current;
+}
+
+std::shared_ptr<const nlohmann::json> JsonDocumentStore::snapshot(const std::string& path) {
+    std::shared_ptr<const Version> version = current(*document(path));
+    if (!version) {
+        return nullptr;
+    }
+    // Aliasing pointer: keeps the whole version alive
+    return std::shared_ptr<const nlohmann::json>(version, &version->document);
+}
+
+bool JsonDocumentStore::read(const std::string& path, nlohmann::json& document) {
+    std::shared_ptr<const Version> version = current(*this->document(path));
+    if (!version) {
+        return false;
+    }
+    document = version->document;
+    return true;
+}
+
+bool JsonDocumentStore::find(const std::string& path, const std::string& array_key, const std::string& id,
+                             nlohmann::json& element, const std::string& id_key) {
+    std::shared_ptr<const Version> version = current(*document(path));
+    if (!version || !version->document.is_object()) {
+        return false;
+    }
+    auto array = version->document.find(array_key);
+    if (array == version->document.end() || !array->is_array()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(version->index_mutex);
+    auto [index, created] = version->indexes.try_emplace(array_key + "\n" + id_key);
+    if (created) {
+        // The first of duplicate ids wins, as with a linear scan
+        for (size_t i = 0; i < array->size(); ++i) {
+            const nlohmann::json& candidate = (*array)[i];
+            if (candidate.is_object()) {
+                auto value = candidate.find(id_key);
+                if (value != candidate.end() && value->is_string()) {
+                    index->second.emplace(value->get<std::string>(), i);
+                }
+            }
+        }
+    }
+
+    auto position = index->second.find(id);
+    if (position == index->second.end()) {
+        return false;
+    }
+    element = (*array)[position->second];
+    return true;
+}
+
+bool JsonDocumentStore::write(const std::string& path, nlohmann::json document, int indent) {
+    std::shared_ptr<Document> entry = this->document(path);
+
+    // As when the file was opened for writing directly
+    struct stat info{};
+    std::string directory = AtomicFile::directoryOf(entry->path);
+    if (::stat(directory.c_str(), &info) != 0 || !S_ISDIR(info.st_mode)) {
+        ENDPOINT_LOG("json-store", "Cannot write " + entry->path + ": no directory " + directory);
+        return false;
+    }
+
+    auto version = std::make_shared<const Version>(std::move(document));
+    {
+        // Swapped and marked dirty together, so a reload never replaces it
+        std::unique_lock<std::shared_mutex> lock(entry->lock);
+        entry->current = std::move(version);
+        entry->loaded = true;
+
+        std::lock_guard<std::mutex> state(state_mutex_);
+        entry->indent = indent;
+        if (!entry->dirty) {
+            entry->dirty = true;
+            entry->due = std::chrono::steady_clock::now() + WRITE_DELAY;
+        }
+    }
+    watchDirectory(entry->path);
+
+    if (stopping_.load()) {
+        return persist({entry});
+    }
+    wake();
+    return true;
+}
+
+bool JsonDocumentStore::flush() {
+    return flushDue(true);
+}
+
+size_t JsonDocumentStore::documentCount() const {
+    std::shared_lock<std::shared_mutex> lock(documents_mutex_);
+    return documents_.size();
+}
+
+void JsonDocumentStore::shutdown() {
+    if (!stopping_.exchange(true)) {
+        wake();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+    flush();
+}
+
+void JsonDocumentStore::watchDirectory(const std::string& path) {
+    if (inotify_fd_ < 0) {
+        return;
+    }
+    std::string directory = AtomicFile::directoryOf(path);
+    std::lock_guard<std::mutex> lock(state_mutex_);
+    if (watched_.count(directory)) {
+        return;
+    }
+    int wd = ::inotify_add_watch(inotify_fd_, directory.c_str(), WATCH_MASK);
+    if (wd < 0) {
+        // Typically the directory does not exist yet; the next write retries
+        return;
+    }
+    watches_[wd] = directory;
+    watched_[directory] = wd;
+}
+
+bool JsonDocumentStore::persist(const std::vector<std::shared_ptr<Document>>& documents) {
+    std::lock_guard<std::mutex> writer(persist_mutex_);
+
+    // Everything due goes to the write journal together: one fsync for the
+    // whole batch instead of two per file
+    std::vector<WriteJournal::Update> updates;
+    std::vector<Document*> written;
+    bool ok = true;
+    for (const auto& document : documents) {
+        int indent;
+        {
+            std::lock_guard<std::mutex> state(state_mutex_);
+            if (!document->dirty) {
+                continue;
+            }
+            document->dirty = false;
+            indent = document->indent;
+        }
+
+        std::shared_ptr<const Version> version;
+        {
+            std::shared_lock<std::shared_mutex> lock(document->lock);
+            version = document->current;
+        }
+        if (!version) {
+            continue;
+        }
+
+        try {
+            updates.push_back({document->path, version->document.dump(indent), {}});
+            written.push_back(document.get());
+        } catch (const std::exception& e) {
+            // Invalid UTF-8 in a string; retrying cannot help
+            ENDPOINT_LOG("json-store", "Cannot serialize " + document->path + ": " + e.what());
+            ok = false;
+        }
+    }
+    if (updates.empty()) {
+        return ok;
+    }
+
+    WriteJournal::getInstance().write(updates);
+
+    for (size_t i = 0; i < updates.size(); ++i) {
+        Document& document = *written[i];
+        if (!updates[i].error.empty()) {
+            ENDPOINT_LOG("json-store", "Failed to write " + document.path + ": " + updates[i].error + "; retrying");
+            ok = false;
+            std::lock_guard<std::mutex> state(state_mutex_);
+            if (!document.dirty) {
+                document.dirty = true;
+                document.due = std::chrono::steady_clock::now() + RETRY_DELAY;
+            }
+            continue;
+        }
+        FileStamp stamp;
+        stampFile(document.path, stamp);
+        std::lock_guard<std::mutex> state(state_mutex_);
+        document.stamp = stamp;
+    }
+    return ok;
+}
+
+bool JsonDocumentStore::flushDue(bool all) {
+    std::vector<std::shared_ptr<Document>> due;
+    {
+        auto now = std::chrono::steady_clock::now();
+        std::shared_lock<std::shared_mutex> lock(documents_mutex_);
+        std::lock_guard<std::mutex> state(state_mutex_);
+        for (const auto& [path, document] : documents_) {
+            if (document->dirty && (all || document->due <= now)) {
+                due.push_back(document);
+            }
+        }
+    }
+
+    return persist(due);
+}
+
+void JsonDocumentStore::reloadIfChanged(Document& document) {
+    FileStamp stamp;
+    bool exists = stampFile(document.path, stamp);
+    {
+        std::lock_guard<std::mutex> state(state_mutex_);
+        if (stamp == document.stamp) {
+            return;     // Our own write, or nothing changed
+        }
+    }
+
+    std::shared_ptr<const Version> version = exists ? parseFile(document.path) : nullptr;
+    if (exists && !version) {
+        return;         // Probably half-written by an editor; its next event reloads
+    }
+
+    {
+        std::unique_lock<std::shared_mutex> lock(document.lock);
+        std::lock_guard<std::mutex> state(state_mutex_);
+        if (document.dirty) {
+            ENDPOINT_LOG("json-store", "Outside change to " + document.path + " is replaced by a pending write");
+            return;
+        }
+        document.current = std::move(version);
+        document.loaded = true;
+        document.stamp = stamp;
+    }
+    ENDPOINT_LOG("json-store", "Reloaded " + document.path + " after an outside change");
+}
+
+void JsonDocumentStore::wake() {
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t written = ::write(wake_fd_, &one, sizeof(one));
+}
+
+void JsonDocumentStore::handleWatchEvents() {
+    alignas(struct inotify_event) char buffer[8192];
+    for (;;) {
+        ssize_t length = ::read(inotify_fd_, buffer, sizeof(buffer));
+        if (length <= 0) {
+            return;
+        }
+
+        std::vector<std::string> changed;
+        for (ssize_t offset = 0; offset < length;) {
+            const auto* event = reinterpret_cast<const struct inotify_event*>(buffer + offset);
+            offset += sizeof(struct inotify_event) + event->len;
+
+            std::lock_guard<std::mutex> state(state_mutex_);
+            auto watch = watches_.find(event->wd);
+            if (watch == watches_.end()) {
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                // The directory went away; watched again on the next write
+                watched_.erase(watch->second);
+                watches_.erase(watch);
+                continue;
+            }
+            if (event->len > 0) {
+                changed.push_back(normalize(watch->second + "/" + event->name));
+            }
+        }
+
+        for (const auto& path : changed) {
+            std::shared_ptr<Document> document;
+            {
+                std::shared_lock<std::shared_mutex> lock(documents_mutex_);
+                auto it = documents_.find(path);
+                if (it != documents_.end()) {
+                    document = it->second;
+                }
+            }
+            if (document) {
+                reloadIfChanged(*document);
+            }
+        }
+    }
+}
+
+int JsonDocumentStore::nextTimeoutMs() const {
+    auto next = std::chrono::steady_clock::time_point::max();
+    {
+        std::shared_lock<std::shared_mutex> lock(documents_mutex_);
+        std::lock_guard<std::mutex> state(state_mutex_);
+        for (const auto& [path, document] : documents_) {
+            if (document->dirty) {
+                next = std::min(next, document->due);
+            }
+        }
+    }
+    if (next == std::chrono::steady_clock::time_point::max()) {
+        return -1;
+    }
+    auto wait = std::chrono::ceil<std::chrono::milliseconds>(next - std::chrono::steady_clock::now());
+    return static_cast<int>(std::max<int64_t>(0, wait.count()));
+}
+
+void JsonDocumentStore::storeLoop() {
+    std::vector<epoll_event> events(8);
+
+    while (!stopping_.load()) {
+        flushDue(false);
+
+        int ready = ::epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), nextTimeoutMs());
+        for (int i = 0; i < ready; ++i) {
+            if (events[i].data.u64 == WAKE_KEY) {
+                uint64_t count;
+                [[maybe_unused]] ssize_t drained = ::read(wake_fd_, &count, sizeof(count));
+            } else if (events[i].data.u64 == INOTIFY_KEY) {
+                try {
+                    handleWatchEvents();
+                } catch (const std::exception& e) {
+                    ENDPOINT_LOG("json-store", "Exception handling file changes: " + std::string(e.what()));
+                }
+            }
+        }
+    }
+}
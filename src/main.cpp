@@ -17,6 +17,14 @@
 #include "api_endpoints.h"
 #include "route_processors.h"
 #include "dashboard_globals.h"
+#include "netlink_state_engine.h"
+#include "process_engine.h"
+#include "icmp_engine.h"
+#include "traceroute_engine.h"
+#include "dns_engine.h"
+#include "event_bus.h"
+#include "json_document_store.h"
+#include "atomic_file.h"
 #include "../mecanisms/login/login_handler.hpp"
 #include "../mecanisms/login/login_manager.hpp"
 #include "auth_router.h"
@@ -88,6 +96,9 @@ int main(int argc, char* argv[]) {
     // Initialize global configuration manager
     ConfigManager::getInstance().setConfig(config);
 
+    // Before anything reads data/: restores the updates a power cut interrupted
+    WriteJournal::getInstance().open(ConfigManager::getInstance().getDataPath(".write-journal"));
+
     // Initialize data managers with configurable paths
     CellularDataManager::initializePaths();
     VpnDataManager::initializePaths();
@@ -186,6 +197,11 @@ int main(int argc, char* argv[]) {
             server.addRouteHandler(path, handler);
         }
     );
+    firmwareRouter->registerStreamingRoutes(
+        [&server](const std::string& path, StreamingRouteFactory factory) {
+            server.addStreamingRouteHandler(path, factory);
+        }
+    );
 
     utils_router->registerRoutes(
         [&server](const std::string& path, UtilsRouter::RouteHandler handler) {
@@ -236,6 +252,10 @@ int main(int argc, char* argv[]) {
         return backupRouter->handleBackupRestore(request);
     });
 
+    server.addStreamingRouteHandler("/api/backup/restore", [&backupRouter](const ApiRequest& request) {
+        return backupRouter->createRestoreSink(request);
+    });
+
     server.addRouteHandler("/api/backup/list", [&backupRouter](const std::string& method, const std::map<std::string, std::string>& params, const std::string& body) -> std::string {
         ApiRequest request;
         request.method = method;
@@ -253,8 +273,9 @@ int main(int argc, char* argv[]) {
         return response.dump();
     });
 
-    // Backup download with path parameter
-    server.addRouteHandler("/api/backup/download/", [&backupRouter](const std::string& method, const std::map<std::string, std::string>& params, const std::string& body) -> std::string {
+    // Backup download with path parameter: GET streams the catalogued file,
+    // other methods get the JSON description
+    server.addDynamicRouteHandler("/api/backup/download/{backup_id}", [&backupRouter](const std::string& method, const std::map<std::string, std::string>& params, const std::string& body) -> std::string {
         ApiRequest request;
         request.method = method;
         request.body = body;
@@ -262,6 +283,10 @@ int main(int argc, char* argv[]) {
 
         return backupRouter->handleBackupDownload(request);
     });
+    server.addDownloadRouteHandler("/api/backup/download/{backup_id}", [&backupRouter](const std::map<std::string, std::string>& params) -> std::string {
+        auto backup_id = params.find("backup_id");
+        return backup_id == params.end() ? std::string() : backupRouter->resolveBackupDownload(backup_id->second);
+    });
 
     // Backup delete with path parameter  
     server.addRouteHandler("/api/backup/delete/", [&backupRouter](const std::string& method, const std::map<std::string, std::string>& params, const std::string& body) -> std::string {
@@ -513,6 +538,15 @@ int main(int argc, char* argv[]) {
     std::cout << "  PUT/DELETE /api/projects/{project_id}/tasks/{task_id}" << std::endl;
     std::cout << "All routers initialized and routes registered successfully." << std::endl;
 
+    // ======== START NETLINK INTERFACE STATE ENGINE ========
+
+    // Link, address and route state for the dashboard and network routes
+    if (NetlinkStateEngine::getInstance().start()) {
+        std::cout << "Netlink interface state engine started" << std::endl;
+    } else {
+        std::cerr << "Netlink interface state engine unavailable; interface data will use defaults" << std::endl;
+    }
+
     // ======== INITIALIZE DASHBOARD GLOBALS SYSTEM ========
 
     std::cout << "Initializing dashboard globals system..." << std::endl;
@@ -524,7 +558,7 @@ int main(int argc, char* argv[]) {
         std::cout << "Dashboard globals system initialized successfully" << std::endl;
 
         // Enable auto-update with reasonable intervals
-        DashboardGlobals::setAutoUpdate(true, 30, 60, 120);  // 30s, 60s, 120s intervals
+        DashboardGlobals::setAutoUpdate(true, 2, 60, 120);  // 2s (sampled natively), 60s, 120s intervals
         std::cout << "Dashboard auto-update enabled" << std::endl;
     } else {
         std::cerr << "Failed to initialize dashboard globals system" << std::endl;
@@ -568,6 +602,22 @@ int main(int argc, char* argv[]) {
     DashboardGlobals::shutdown();
     ENDPOINT_LOG("utils", "Dashboard globals system shutdown complete");
 
+    NetlinkStateEngine::getInstance().stop();
+
+    // Kill diagnostics still running so no child outlives the server
+    ProcessEngine::getInstance().shutdown();
+    IcmpEngine::getInstance().shutdown();
+    TracerouteEngine::getInstance().shutdown();
+    DnsEngine::getInstance().shutdown();
+
+    // Close the event streams with the server, then stop the bus they read from
+    server.stop();
+    EventBus::getInstance().shutdown();
+
+    // Pending data/ writes reach the disk before we exit
+    JsonDocumentStore::getInstance().shutdown();
+    WriteJournal::getInstance().close();
+
     ENDPOINT_LOG("utils", "🛑 HTTP server stopped gracefully.");
     ENDPOINT_LOG("utils", "Final status: HTTP-based event system completed");
 
@@ -1,8 +1,9 @@
 
 #include "multipart_parser.h"
 #include <iostream>
-#include <sstream>
 #include <algorithm>
+#include <cctype>
+#include <cstring>
 
 MultipartParser::MultipartParser(const std::string& content_type) {
     if (!extractBoundary(content_type)) {
@@ -56,170 +57,379 @@ bool MultipartParser::hasField(const std::string& field_name) const {
 }
 
 bool MultipartParser::extractBoundary(const std::string& content_type) {
-    const std::string boundary_prefix = "boundary=";
-    size_t pos = content_type.find(boundary_prefix);
-    
-    if (pos == std::string::npos) {
-        return false;
-    }
-    
-    pos += boundary_prefix.length();
-    size_t end_pos = content_type.find(';', pos);
-    
-    if (end_pos == std::string::npos) {
-        boundary_ = content_type.substr(pos);
-    } else {
-        boundary_ = content_type.substr(pos, end_pos - pos);
-    }
-    
-    // Remove quotes if present
-    if (boundary_.length() >= 2 && boundary_[0] == '"' && boundary_.back() == '"') {
-        boundary_ = boundary_.substr(1, boundary_.length() - 2);
-    }
-    
+    boundary_ = MultipartStreamParser::boundaryFromContentType(content_type);
     std::cout << "[MULTIPART] Extracted boundary: " << boundary_ << std::endl;
     return !boundary_.empty();
 }
 
 bool MultipartParser::parseMultipartData(const std::string& body) {
-    const std::string delimiter = "--" + boundary_;
-    const std::string end_delimiter = "--" + boundary_ + "--";
-    
-    size_t pos = 0;
-    
-    // Find first boundary
-    pos = body.find(delimiter, pos);
-    if (pos == std::string::npos) {
-        std::cout << "[MULTIPART] No starting boundary found" << std::endl;
-        return false;
-    }
-    
-    pos += delimiter.length();
-    
-    while (pos < body.length()) {
-        // Skip CRLF after boundary
-        if (pos < body.length() && body[pos] == '\r') pos++;
-        if (pos < body.length() && body[pos] == '\n') pos++;
-        
-        // Find next boundary or end
-        size_t next_boundary = body.find(delimiter, pos);
-        if (next_boundary == std::string::npos) {
-            break;
-        }
-        
-        // Extract part data
-        std::string part = body.substr(pos, next_boundary - pos);
-        
-        // Remove trailing CRLF
-        while (!part.empty() && (part.back() == '\r' || part.back() == '\n')) {
-            part.pop_back();
-        }
-        
-        // Split headers and data
-        size_t headers_end = part.find("\r\n\r\n");
-        if (headers_end == std::string::npos) {
-            headers_end = part.find("\n\n");
-            if (headers_end == std::string::npos) {
-                pos = next_boundary + delimiter.length();
-                continue;
-            }
-            headers_end += 2;
-        } else {
-            headers_end += 4;
-        }
-        
-        std::string headers = part.substr(0, headers_end);
-        std::string data = part.substr(headers_end);
-        
-        // Parse Content-Disposition header
-        std::string content_disposition = extractHeaderValue(headers, "Content-Disposition");
-        auto disposition_params = parseContentDisposition(content_disposition);
-        
-        std::string field_name = disposition_params["name"];
-        std::string filename = disposition_params["filename"];
-        
-        if (!filename.empty()) {
-            // File field
-            auto file = std::make_shared<MultipartFile>();
-            file->field_name = field_name;
-            file->filename = filename;
-            file->content_type = extractHeaderValue(headers, "Content-Type");
-            file->data.assign(data.begin(), data.end());
-            file->size = file->data.size();
-            
-            files_.push_back(file);
-            std::cout << "[MULTIPART] Parsed file: " << filename << " (" << file->size << " bytes)" << std::endl;
+    MultipartStreamParser parser(boundary_);
+    std::shared_ptr<MultipartFile> current_file;
+    std::shared_ptr<MultipartField> current_field;
+
+    parser.onPartBegin([&](const MultipartPartInfo& part) {
+        if (part.isFile()) {
+            current_file = std::make_shared<MultipartFile>();
+            current_file->field_name = std::string(part.field_name);
+            current_file->filename = std::string(part.filename);
+            current_file->content_type = std::string(part.content_type);
+            current_file->size = 0;
         } else {
-            // Regular field
-            auto field = std::make_shared<MultipartField>();
-            field->field_name = field_name;
-            field->value = data;
-            
-            fields_.push_back(field);
-            std::cout << "[MULTIPART] Parsed field: " << field_name << " = " << data.substr(0, 50) << std::endl;
+            current_field = std::make_shared<MultipartField>();
+            current_field->field_name = std::string(part.field_name);
+        }
+        return true;
+    });
+    parser.onPartData([&](std::string_view data) {
+        if (current_file) {
+            current_file->data.insert(current_file->data.end(), data.begin(), data.end());
+        } else if (current_field) {
+            current_field->value.append(data);
+        }
+        return true;
+    });
+    parser.onPartEnd([&]() {
+        if (current_file) {
+            current_file->size = current_file->data.size();
+            std::cout << "[MULTIPART] Parsed file: " << current_file->filename << " (" << current_file->size << " bytes)" << std::endl;
+            files_.push_back(std::move(current_file));
+        } else if (current_field) {
+            std::cout << "[MULTIPART] Parsed field: " << current_field->field_name << " = " << current_field->value.substr(0, 50) << std::endl;
+            fields_.push_back(std::move(current_field));
         }
-        
-        pos = next_boundary + delimiter.length();
+        current_file.reset();
+        current_field.reset();
+        return true;
+    });
+
+    parser.feed(body.data(), body.size());
+    if (!parser.finish()) {
+        std::cout << "[MULTIPART] Parsing failed: " << parser.getError() << std::endl;
+        return false;
     }
-    
+
     std::cout << "[MULTIPART] Parsing completed: " << files_.size() << " files, " << fields_.size() << " fields" << std::endl;
     return true;
 }
 
-std::string MultipartParser::extractHeaderValue(const std::string& headers, const std::string& name) {
-    std::string search_name = name + ":";
-    size_t pos = headers.find(search_name);
-    
-    if (pos == std::string::npos) {
+// ======== MultipartStreamParser ========
+
+namespace {
+    bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i]))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::string_view trimView(std::string_view value) {
+        while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+            value.remove_prefix(1);
+        }
+        while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) {
+            value.remove_suffix(1);
+        }
+        return value;
+    }
+
+    // Look up a parameter such as name="..." in a Content-Disposition value
+    std::string_view dispositionParam(std::string_view disposition, std::string_view key) {
+        size_t pos = disposition.find(';');
+        while (pos != std::string_view::npos) {
+            std::string_view rest = disposition.substr(pos + 1);
+            size_t next = rest.find(';');
+            std::string_view token = trimView(rest.substr(0, next));
+
+            size_t eq_pos = token.find('=');
+            if (eq_pos != std::string_view::npos && equalsIgnoreCase(trimView(token.substr(0, eq_pos)), key)) {
+                std::string_view value = trimView(token.substr(eq_pos + 1));
+                if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+                    value = value.substr(1, value.size() - 2);
+                }
+                return value;
+            }
+
+            pos = (next == std::string_view::npos) ? next : pos + 1 + next;
+        }
+        return {};
+    }
+}
+
+MultipartStreamParser::MultipartStreamParser(const std::string& boundary)
+    : delimiter_("\r\n--" + boundary), state_(State::BODY), in_part_(false) {
+    // Pretend the body starts after a CRLF so a leading "--boundary" matches the delimiter
+    tail_ = "\r\n";
+
+    const size_t length = delimiter_.size();
+    for (size_t& shift : skip_) {
+        shift = length;
+    }
+    for (size_t i = 0; i + 1 < length; ++i) {
+        skip_[static_cast<unsigned char>(delimiter_[i])] = length - 1 - i;
+    }
+
+    if (boundary.empty()) {
+        fail("Empty multipart boundary");
+    }
+}
+
+std::string MultipartStreamParser::boundaryFromContentType(std::string_view content_type) {
+    const std::string_view boundary_prefix = "boundary=";
+    size_t pos = content_type.find(boundary_prefix);
+    if (pos == std::string_view::npos) {
         return "";
     }
-    
-    pos += search_name.length();
-    
-    // Skip whitespace
-    while (pos < headers.length() && (headers[pos] == ' ' || headers[pos] == '\t')) {
-        pos++;
+
+    std::string_view boundary = content_type.substr(pos + boundary_prefix.size());
+    boundary = trimView(boundary.substr(0, boundary.find(';')));
+    if (boundary.size() >= 2 && boundary.front() == '"' && boundary.back() == '"') {
+        boundary = boundary.substr(1, boundary.size() - 2);
     }
-    
-    size_t end_pos = headers.find('\r', pos);
-    if (end_pos == std::string::npos) {
-        end_pos = headers.find('\n', pos);
+    return std::string(boundary);
+}
+
+bool MultipartStreamParser::feed(const char* data, size_t size) {
+    std::string_view input(data, size);
+
+    while (!input.empty()) {
+        size_t used = 0;
+        switch (state_) {
+            case State::BODY:
+                used = consumeBody(input);
+                break;
+            case State::AFTER_DELIMITER:
+                used = consumeAfterDelimiter(input);
+                break;
+            case State::HEADERS:
+                used = consumeHeaders(input);
+                break;
+            case State::DONE:
+                return true; // Epilogue is ignored
+            case State::ERROR:
+                return false;
+        }
+        input.remove_prefix(used);
     }
-    
-    if (end_pos == std::string::npos) {
-        return headers.substr(pos);
+
+    return state_ != State::ERROR;
+}
+
+bool MultipartStreamParser::finish() {
+    if (state_ == State::DONE) {
+        return true;
     }
-    
-    return headers.substr(pos, end_pos - pos);
+    if (state_ != State::ERROR) {
+        fail("Multipart body ended before the closing boundary");
+    }
+    return false;
 }
 
-std::map<std::string, std::string> MultipartParser::parseContentDisposition(const std::string& value) {
-    std::map<std::string, std::string> params;
-    
-    std::istringstream iss(value);
-    std::string token;
-    
-    // Skip the disposition type (e.g., "form-data")
-    std::getline(iss, token, ';');
-    
-    while (std::getline(iss, token, ';')) {
-        // Trim whitespace
-        token.erase(0, token.find_first_not_of(" \t"));
-        token.erase(token.find_last_not_of(" \t") + 1);
-        
-        size_t eq_pos = token.find('=');
-        if (eq_pos != std::string::npos) {
-            std::string key = token.substr(0, eq_pos);
-            std::string val = token.substr(eq_pos + 1);
-            
-            // Remove quotes
-            if (val.length() >= 2 && val[0] == '"' && val.back() == '"') {
-                val = val.substr(1, val.length() - 2);
+size_t MultipartStreamParser::findDelimiter(std::string_view haystack) const {
+    const size_t length = delimiter_.size();
+    if (haystack.size() < length) {
+        return std::string_view::npos;
+    }
+
+    const char* needle = delimiter_.data();
+    const char last = needle[length - 1];
+    size_t pos = 0;
+    const size_t end = haystack.size() - length;
+    while (pos <= end) {
+        const char tail_char = haystack[pos + length - 1];
+        if (tail_char == last && std::memcmp(haystack.data() + pos, needle, length - 1) == 0) {
+            return pos;
+        }
+        pos += skip_[static_cast<unsigned char>(tail_char)];
+    }
+    return std::string_view::npos;
+}
+
+size_t MultipartStreamParser::delimiterPrefixSuffix(std::string_view data) const {
+    // Longest suffix of data that is a proper prefix of the delimiter
+    size_t max_length = std::min(data.size(), delimiter_.size() - 1);
+    for (size_t length = max_length; length > 0; --length) {
+        if (std::memcmp(data.data() + data.size() - length, delimiter_.data(), length) == 0) {
+            return length;
+        }
+    }
+    return 0;
+}
+
+size_t MultipartStreamParser::consumeBody(std::string_view input) {
+    const size_t length = delimiter_.size();
+
+    if (!tail_.empty()) {
+        // A delimiter may straddle the previous chunk; check the short joint region first
+        std::string joint = tail_;
+        joint.append(input.substr(0, length - 1));
+
+        size_t match = findDelimiter(joint);
+        if (match != std::string_view::npos && match < tail_.size()) {
+            if (!emitData(std::string_view(joint).substr(0, match)) || !endPart()) {
+                return input.size();
             }
-            
-            params[key] = val;
+            size_t used = match + length - tail_.size();
+            tail_.clear();
+            state_ = State::AFTER_DELIMITER;
+            return used;
+        }
+
+        if (input.size() < length - 1) {
+            // Chunk too short to settle the tail; carry whatever could still be a delimiter
+            size_t keep = delimiterPrefixSuffix(joint);
+            emitData(std::string_view(joint).substr(0, joint.size() - keep));
+            tail_ = joint.substr(joint.size() - keep);
+            return input.size();
+        }
+
+        // No delimiter starts inside the tail, so all of it is data
+        std::string pending;
+        pending.swap(tail_);
+        if (!emitData(pending)) {
+            return input.size();
         }
     }
-    
-    return params;
+
+    size_t match = findDelimiter(input);
+    if (match != std::string_view::npos) {
+        if (!emitData(input.substr(0, match)) || !endPart()) {
+            return input.size();
+        }
+        state_ = State::AFTER_DELIMITER;
+        return match + length;
+    }
+
+    size_t keep = delimiterPrefixSuffix(input);
+    if (!emitData(input.substr(0, input.size() - keep))) {
+        return input.size();
+    }
+    tail_.assign(input.substr(input.size() - keep));
+    return input.size();
+}
+
+size_t MultipartStreamParser::consumeAfterDelimiter(std::string_view input) {
+    size_t used = 0;
+    while (used < input.size() && marker_.size() < 2) {
+        char c = input[used++];
+        // Tolerate transport padding between the boundary and its line ending
+        if (marker_.empty() && (c == ' ' || c == '\t')) {
+            continue;
+        }
+        marker_.push_back(c);
+    }
+
+    if (marker_.size() < 2) {
+        return used;
+    }
+
+    if (marker_ == "--") {
+        state_ = State::DONE;
+        used = input.size();
+    } else if (marker_ == "\r\n") {
+        state_ = State::HEADERS;
+    } else {
+        fail("Malformed multipart boundary line");
+    }
+    marker_.clear();
+    return used;
+}
+
+size_t MultipartStreamParser::consumeHeaders(std::string_view input) {
+    const size_t previous_size = header_buf_.size();
+    const size_t room = MAX_HEADER_SIZE + 4 - previous_size;
+    header_buf_.append(input.substr(0, room));
+
+    size_t header_end;
+    size_t separator_length;
+    if (header_buf_.compare(0, 2, "\r\n") == 0) {
+        // Part without any headers
+        header_end = 0;
+        separator_length = 2;
+    } else {
+        size_t search_from = previous_size > 3 ? previous_size - 3 : 0;
+        header_end = header_buf_.find("\r\n\r\n", search_from);
+        separator_length = 4;
+    }
+
+    if (header_end == std::string::npos || header_buf_.size() < 2) {
+        if (header_buf_.size() > MAX_HEADER_SIZE) {
+            fail("Multipart part headers too large");
+        }
+        return std::min(input.size(), room);
+    }
+
+    size_t used = header_end + separator_length - previous_size;
+    bool accepted = parsePartHeaders(std::string_view(header_buf_).substr(0, header_end));
+    header_buf_.clear();
+    if (!accepted) {
+        return input.size();
+    }
+
+    in_part_ = true;
+    state_ = State::BODY;
+    return used;
+}
+
+bool MultipartStreamParser::emitData(std::string_view data) {
+    if (data.empty() || !in_part_ || !on_part_data_) {
+        return true;
+    }
+    if (!on_part_data_(data)) {
+        fail("Part data rejected");
+        return false;
+    }
+    return true;
+}
+
+bool MultipartStreamParser::endPart() {
+    if (!in_part_) {
+        return true;
+    }
+    in_part_ = false;
+    if (on_part_end_ && !on_part_end_()) {
+        fail("Part rejected");
+        return false;
+    }
+    return true;
+}
+
+bool MultipartStreamParser::parsePartHeaders(std::string_view headers) {
+    MultipartPartInfo info;
+
+    while (!headers.empty()) {
+        size_t line_end = headers.find("\r\n");
+        std::string_view line = headers.substr(0, line_end);
+        headers = (line_end == std::string_view::npos) ? std::string_view() : headers.substr(line_end + 2);
+
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos) {
+            continue;
+        }
+
+        std::string_view name = trimView(line.substr(0, colon));
+        std::string_view value = trimView(line.substr(colon + 1));
+        if (equalsIgnoreCase(name, "Content-Disposition")) {
+            info.field_name = dispositionParam(value, "name");
+            info.filename = dispositionParam(value, "filename");
+        } else if (equalsIgnoreCase(name, "Content-Type")) {
+            info.content_type = value;
+        }
+    }
+
+    if (on_part_begin_ && !on_part_begin_(info)) {
+        fail("Part rejected");
+        return false;
+    }
+    return true;
+}
+
+void MultipartStreamParser::fail(const std::string& message) {
+    state_ = State::ERROR;
+    error_ = message;
+    std::cout << "[MULTIPART] Stream parse error: " << message << std::endl;
 }
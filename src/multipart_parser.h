@@ -2,9 +2,11 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
 #include <memory>
+#include <functional>
 
 struct MultipartFile {
     std::string field_name;
@@ -19,6 +21,8 @@ struct MultipartField {
     std::string value;
 };
 
+// Buffered parser: collects every part of a complete body in memory.
+// Built on MultipartStreamParser; prefer that one for uploads.
 class MultipartParser {
 public:
     MultipartParser(const std::string& content_type);
@@ -42,6 +46,91 @@ private:
     
     bool extractBoundary(const std::string& content_type);
     bool parseMultipartData(const std::string& body);
-    std::string extractHeaderValue(const std::string& headers, const std::string& name);
-    std::map<std::string, std::string> parseContentDisposition(const std::string& value);
+};
+
+// Headers of one part as seen by MultipartStreamParser. The views point into
+// the parser's buffer and are only valid during the on-part-begin callback.
+struct MultipartPartInfo {
+    std::string_view field_name;
+    std::string_view filename;
+    std::string_view content_type;
+
+    bool isFile() const { return !filename.empty(); }
+};
+
+/**
+ * Push-based multipart/form-data parser.
+ *
+ * The body is fed in arbitrary chunks as it arrives from the network. Part
+ * headers are reported through onPartBegin, part content through onPartData
+ * (possibly in many pieces) and the end of each part through onPartEnd, so a
+ * file part can be written to disk without ever holding the whole body.
+ *
+ * Part data is passed as views into the caller's chunk; nothing is copied
+ * except the part headers and, when a chunk ends inside something that could
+ * be the start of a delimiter, those few bytes. The delimiter is located with
+ * a Boyer-Moore-Horspool search built once per parser.
+ */
+class MultipartStreamParser {
+public:
+    using PartBeginCallback = std::function<bool(const MultipartPartInfo&)>;
+    using PartDataCallback = std::function<bool(std::string_view)>;
+    using PartEndCallback = std::function<bool()>;
+
+    explicit MultipartStreamParser(const std::string& boundary);
+
+    // Extract the boundary parameter from a Content-Type header value
+    static std::string boundaryFromContentType(std::string_view content_type);
+
+    // Callbacks return false to abort parsing
+    void onPartBegin(PartBeginCallback callback) { on_part_begin_ = std::move(callback); }
+    void onPartData(PartDataCallback callback) { on_part_data_ = std::move(callback); }
+    void onPartEnd(PartEndCallback callback) { on_part_end_ = std::move(callback); }
+
+    // Feed the next chunk of the body; returns false once the parser is in error
+    bool feed(const char* data, size_t size);
+
+    // Call after the last chunk; returns true only if the closing boundary was seen
+    bool finish();
+
+    bool isComplete() const { return state_ == State::DONE; }
+    bool hasError() const { return state_ == State::ERROR; }
+    const std::string& getError() const { return error_; }
+
+private:
+    enum class State {
+        BODY,               // Preamble or part content, scanning for the delimiter
+        AFTER_DELIMITER,    // Expecting "--" (end) or CRLF (next part headers)
+        HEADERS,            // Buffering part headers up to the blank line
+        DONE,
+        ERROR
+    };
+
+    static constexpr size_t MAX_HEADER_SIZE = 16 * 1024;
+
+    std::string delimiter_;     // "\r\n--" + boundary
+    size_t skip_[256];          // Horspool bad-character shifts for delimiter_
+    std::string tail_;          // Unemitted bytes that may start a delimiter (< delimiter size)
+    std::string marker_;        // Bytes seen after a delimiter ("--" or CRLF)
+    std::string header_buf_;
+    State state_;
+    bool in_part_;
+    std::string error_;
+
+    PartBeginCallback on_part_begin_;
+    PartDataCallback on_part_data_;
+    PartEndCallback on_part_end_;
+
+    size_t findDelimiter(std::string_view haystack) const;
+    size_t delimiterPrefixSuffix(std::string_view data) const;
+
+    // State handlers; each consumes a prefix of input and returns the bytes used
+    size_t consumeBody(std::string_view input);
+    size_t consumeAfterDelimiter(std::string_view input);
+    size_t consumeHeaders(std::string_view input);
+
+    bool emitData(std::string_view data);
+    bool endPart();
+    bool parsePartHeaders(std::string_view headers);
+    void fail(const std::string& message);
 };
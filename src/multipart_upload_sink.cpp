@@ -0,0 +1,159 @@
+#include "multipart_upload_sink.h"
+#include "endpoint_logger.h"
+#include <filesystem>
+#include <strings.h>
+
+MultipartFileUploadSink::MultipartFileUploadSink(const std::string& boundary,
+                                                 const std::string& file_field,
+                                                 const std::string& destination_dir,
+                                                 const std::string& file_prefix,
+                                                 size_t max_file_size,
+                                                 CompletionHandler on_complete)
+    : parser_(boundary), file_field_(file_field), destination_dir_(destination_dir),
+      file_prefix_(file_prefix), max_file_size_(max_file_size), on_complete_(std::move(on_complete)),
+      file_received_(false), in_file_part_(false), fields_size_(0), error_status_(400) {
+    parser_.onPartBegin([this](const MultipartPartInfo& part) { return beginPart(part); });
+    parser_.onPartData([this](std::string_view data) { return writePartData(data); });
+    parser_.onPartEnd([this]() {
+        if (in_file_part_) {
+            file_.close();
+            in_file_part_ = false;
+            file_received_ = true;
+        }
+        current_field_.clear();
+        return true;
+    });
+}
+
+MultipartFileUploadSink::~MultipartFileUploadSink() {
+    if (file_.is_open()) {
+        removeFile();
+    }
+}
+
+std::string MultipartFileUploadSink::boundaryFromRequest(const ApiRequest& request) {
+    for (const auto& header : request.headers) {
+        if (strcasecmp(header.first.c_str(), "Content-Type") == 0) {
+            if (header.second.find("multipart/form-data") == std::string::npos) {
+                return "";
+            }
+            return MultipartStreamParser::boundaryFromContentType(header.second);
+        }
+    }
+    return "";
+}
+
+bool MultipartFileUploadSink::beginPart(const MultipartPartInfo& part) {
+    bool wanted_file = part.isFile() && !file_received_ && !file_.is_open() &&
+                       (file_field_.empty() || part.field_name == file_field_);
+    if (!wanted_file) {
+        // Extra files are skipped; anything else is a form field
+        current_field_ = part.isFile() ? "" : std::string(part.field_name);
+        return true;
+    }
+
+    upload_.filename = std::filesystem::path(std::string(part.filename)).filename().string();
+    if (upload_.filename.empty()) {
+        return reject("Invalid upload filename");
+    }
+
+    try {
+        std::filesystem::create_directories(destination_dir_);
+    } catch (const std::exception&) {
+        return reject("Failed to create upload directory", 500);
+    }
+
+    upload_.file_path = destination_dir_ + "/" + file_prefix_ + upload_.filename;
+    file_.open(upload_.file_path, std::ios::binary | std::ios::trunc);
+    if (!file_) {
+        return reject("Failed to save uploaded file", 500);
+    }
+
+    ENDPOINT_LOG("http", "Streaming upload " + upload_.filename + " to " + upload_.file_path);
+    in_file_part_ = true;
+    return true;
+}
+
+bool MultipartFileUploadSink::writePartData(std::string_view data) {
+    if (in_file_part_) {
+        if (upload_.file_size + data.size() > max_file_size_) {
+            return reject("Uploaded file too large", 413);
+        }
+        file_.write(data.data(), data.size());
+        if (!file_) {
+            return reject("Failed to write uploaded file", 500);
+        }
+        upload_.file_size += data.size();
+        return true;
+    }
+
+    if (!current_field_.empty()) {
+        fields_size_ += data.size();
+        if (fields_size_ > MAX_FIELDS_SIZE) {
+            return reject("Form fields too large", 413);
+        }
+        upload_.fields[current_field_].append(data);
+    }
+    return true;
+}
+
+bool MultipartFileUploadSink::consume(const char* data, size_t size) {
+    if (!parser_.feed(data, size)) {
+        if (error_.empty()) {
+            reject("Invalid multipart data: " + parser_.getError());
+        }
+        return false;
+    }
+    return true;
+}
+
+ApiResponse MultipartFileUploadSink::finish() {
+    if (error_.empty()) {
+        if (!parser_.finish()) {
+            reject("Invalid multipart data: " + parser_.getError());
+        } else if (!file_received_) {
+            reject("No file found in upload");
+        }
+    }
+
+    if (!error_.empty()) {
+        return errorResponse();
+    }
+
+    return on_complete_(upload_);
+}
+
+void MultipartFileUploadSink::abort() {
+    if (file_.is_open() || !upload_.file_path.empty()) {
+        removeFile();
+    }
+}
+
+ApiResponse MultipartFileUploadSink::errorResponse() const {
+    ApiResponse response;
+    response.setErrorResponse(error_.empty() ? "Upload rejected" : error_, error_status_);
+    return response;
+}
+
+bool MultipartFileUploadSink::reject(const std::string& message, int status) {
+    ENDPOINT_LOG_ERROR("http", "Upload rejected: " + message);
+    if (error_.empty()) {
+        error_ = message;
+        error_status_ = status;
+    }
+    removeFile();
+    return false;
+}
+
+void MultipartFileUploadSink::removeFile() {
+    if (file_.is_open()) {
+        file_.close();
+    }
+    in_file_part_ = false;
+    file_received_ = false;
+    if (!upload_.file_path.empty()) {
+        std::error_code ec;
+        std::filesystem::remove(upload_.file_path, ec);
+        upload_.file_path.clear();
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <fstream>
+#include <functional>
+#include "request_body_sink.h"
+#include "multipart_parser.h"
+
+/**
+ * Request body sink that streams one multipart file part to disk and keeps
+ * the (small) form fields in memory. Used by upload routes that only need
+ * the file on disk, such as backup restore and .uacc authentication.
+ */
+class MultipartFileUploadSink : public RequestBodySink {
+public:
+    struct Upload {
+        std::string filename;       // Client-supplied name, path components removed
+        std::string file_path;      // Where the part was written
+        size_t file_size = 0;
+        std::map<std::string, std::string> fields;
+    };
+
+    // Runs once the whole body was received; the uploaded file is left in place
+    using CompletionHandler = std::function<ApiResponse(const Upload&)>;
+
+    // file_field selects the part to store ("" = first file part). The file is
+    // written to destination_dir + "/" + file_prefix + filename.
+    MultipartFileUploadSink(const std::string& boundary,
+                            const std::string& file_field,
+                            const std::string& destination_dir,
+                            const std::string& file_prefix,
+                            size_t max_file_size,
+                            CompletionHandler on_complete);
+    ~MultipartFileUploadSink() override;
+
+    // Boundary from a multipart/form-data request, or "" if it is not one
+    static std::string boundaryFromRequest(const ApiRequest& request);
+
+    bool consume(const char* data, size_t size) override;
+    ApiResponse finish() override;
+    void abort() override;
+    ApiResponse errorResponse() const override;
+
+private:
+    static constexpr size_t MAX_FIELDS_SIZE = 64 * 1024;
+
+    MultipartStreamParser parser_;
+    std::string file_field_;
+    std::string destination_dir_;
+    std::string file_prefix_;
+    size_t max_file_size_;
+    CompletionHandler on_complete_;
+
+    Upload upload_;
+    std::ofstream file_;
+    bool file_received_;
+    bool in_file_part_;
+    std::string current_field_;
+    size_t fields_size_;
+    std::string error_;
+    int error_status_;
+
+    bool beginPart(const MultipartPartInfo& part);
+    bool writePartData(std::string_view data);
+    bool reject(const std::string& message, int status = 400);
+    void removeFile();
+};
@@ -0,0 +1,683 @@
+#include "netlink_state_engine.h"
+#include "endpoint_logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <arpa/inet.h>
+#include <linux/if.h>
+#include <linux/if_arp.h>
+#include <linux/if_link.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr size_t RECV_BUFFER_SIZE = 64 * 1024;
+constexpr int SOCKET_RCVBUF = 1024 * 1024;
+
+std::string formatAddress(int family, const void* data, size_t length) {
+    char text[INET6_ADDRSTRLEN] = {};
+    if ((family == AF_INET && length >= 4) || (family == AF_INET6 && length >= 16)) {
+        if (inet_ntop(family, data, text, sizeof(text))) {
+            return text;
+        }
+    }
+    return "";
+}
+
+std::string formatMac(const unsigned char* data, size_t length) {
+    static const char hex[] = "0123456789abcdef";
+    std::string mac;
+    for (size_t i = 0; i < length; ++i) {
+        if (i > 0) {
+            mac += ':';
+        }
+        mac += hex[data[i] >> 4];
+        mac += hex[data[i] & 0x0f];
+    }
+    return mac;
+}
+
+std::string readSysfs(const std::string& name, const char* attribute) {
+    std::ifstream file("/sys/class/net/" + name + "/" + attribute);
+    std::string value;
+    std::getline(file, value);
+    return value;
+}
+
+bool sysfsExists(const std::string& name, const char* entry) {
+    struct stat st;
+    return ::stat(("/sys/class/net/" + name + "/" + entry).c_str(), &st) == 0;
+}
+
+// Attributes are read from sysfs only when a link appears or changes state,
+// never on the request path
+void refreshLinkDetails(NetlinkStateEngine::Link& link) {
+    link.is_wireless = sysfsExists(link.name, "wireless") || sysfsExists(link.name, "phy80211");
+
+    // speed/duplex fail with EINVAL while there is no carrier
+    link.speed_mbps = -1;
+    link.duplex.clear();
+    if (link.hasCarrier()) {
+        std::string speed = readSysfs(link.name, "speed");
+        if (!speed.empty()) {
+            int value = std::atoi(speed.c_str());
+            link.speed_mbps = value > 0 ? value : -1;
+        }
+        std::string duplex = readSysfs(link.name, "duplex");
+        if (duplex == "full" || duplex == "half") {
+            link.duplex = duplex;
+        }
+    }
+}
+
+template <typename Stats>
+void copyCounters(NetlinkStateEngine::LinkCounters& counters, const Stats* stats) {
+    counters.rx_bytes = stats->rx_bytes;
+    counters.tx_bytes = stats->tx_bytes;
+    counters.rx_packets = stats->rx_packets;
+    counters.tx_packets = stats->tx_packets;
+    counters.rx_errors = stats->rx_errors;
+    counters.tx_errors = stats->tx_errors;
+    counters.rx_dropped = stats->rx_dropped;
+    counters.tx_dropped = stats->tx_dropped;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// Link / Table queries
+// ---------------------------------------------------------------------------
+
+bool NetlinkStateEngine::Link::isUp() const {
+    return (flags & IFF_UP) != 0;
+}
+
+bool NetlinkStateEngine::Link::hasCarrier() const {
+    if (operstate == IF_OPER_UP) {
+        return true;
+    }
+    // Drivers without operstate support report UNKNOWN; fall back to flags
+    return operstate == IF_OPER_UNKNOWN && (flags & IFF_UP) && (flags & IFF_RUNNING);
+}
+
+bool NetlinkStateEngine::Link::isLoopback() const {
+    return type == ARPHRD_LOOPBACK || (flags & IFF_LOOPBACK);
+}
+
+const NetlinkStateEngine::Link* NetlinkStateEngine::Table::findLink(int index) const {
+    auto it = links.find(index);
+    return it != links.end() ? &it->second : nullptr;
+}
+
+const NetlinkStateEngine::Link* NetlinkStateEngine::Table::findLink(const std::string& name) const {
+    for (const auto& entry : links) {
+        if (entry.second.name == name) {
+            return &entry.second;
+        }
+    }
+    return nullptr;
+}
+
+const NetlinkStateEngine::Route* NetlinkStateEngine::Table::defaultRoute(int family) const {
+    const Route* best = nullptr;
+    for (const auto& route : routes) {
+        if (route.family == family && route.dst_len == 0 &&
+            (!best || route.priority < best->priority)) {
+            best = &route;
+        }
+    }
+    return best;
+}
+
+std::vector<const NetlinkStateEngine::Address*> NetlinkStateEngine::Table::addressesOf(int index, int family) const {
+    std::vector<const Address*> result;
+    for (const auto& address : addresses) {
+        if (address.ifindex == index && (family == AF_UNSPEC || address.family == family)) {
+            result.push_back(&address);
+        }
+    }
+    return result;
+}
+
+const NetlinkStateEngine::Address* NetlinkStateEngine::Table::primaryAddress(int index, int family) const {
+    for (const auto& address : addresses) {
+        if (address.ifindex == index && address.family == family && address.scope == RT_SCOPE_UNIVERSE) {
+            return &address;
+        }
+    }
+    return nullptr;
+}
+
+const NetlinkStateEngine::Link* NetlinkStateEngine::Table::wiredLink() const {
+    auto is_wired = [](const Link& link) {
+        return link.type == ARPHRD_ETHER && !link.is_wireless && !link.isLoopback();
+    };
+
+    if (const Route* route = defaultRoute(AF_INET)) {
+        const Link* link = findLink(route->oif);
+        if (link && is_wired(*link)) {
+            return link;
+        }
+    }
+
+    const Link* without_carrier = nullptr;
+    for (const auto& entry : links) {
+        const Link& link = entry.second;
+        if (!is_wired(link) || !link.kind.empty()) {
+            continue;
+        }
+        if (link.hasCarrier()) {
+            return &link;
+        }
+        if (!without_carrier) {
+            without_carrier = &link;
+        }
+    }
+    return without_carrier;
+}
+
+// ---------------------------------------------------------------------------
+// Engine
+// ---------------------------------------------------------------------------
+
+NetlinkStateEngine& NetlinkStateEngine::getInstance() {
+    static NetlinkStateEngine instance;
+    return instance;
+}
+
+NetlinkStateEngine::NetlinkStateEngine() {
+    current_.store(std::make_shared<const Table>(), std::memory_order_release);
+
+    // Subscribe before dumping so no change between the dump and the first
+    // event read is lost
+    if (!openSockets()) {
+        ENDPOINT_LOG_ERROR("netlink", "Cannot open NETLINK_ROUTE sockets: " + std::string(std::strerror(errno)));
+        return;
+    }
+    if (!resync()) {
+        ENDPOINT_LOG_ERROR("netlink", "Initial interface dump failed: " + std::string(std::strerror(errno)));
+    }
+    initial_dump_ = false;
+}
+
+NetlinkStateEngine::~NetlinkStateEngine() {
+    stop();
+    for (int fd : {listen_fd_, dump_fd_, wake_fd_}) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+}
+
+bool NetlinkStateEngine::openSockets() {
+    listen_fd_ = ::socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_ROUTE);
+    dump_fd_ = ::socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    wake_fd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (listen_fd_ < 0 || dump_fd_ < 0 || wake_fd_ < 0) {
+        return false;
+    }
+
+    int rcvbuf = SOCKET_RCVBUF;
+    ::setsockopt(listen_fd_, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    struct sockaddr_nl local{};
+    local.nl_family = AF_NETLINK;
+    local.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR |
+                      RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE;
+    if (::bind(listen_fd_, reinterpret_cast<struct sockaddr*>(&local), sizeof(local)) < 0) {
+        return false;
+    }
+
+    // Dump replies can exceed the default buffer on hosts with many routes
+    ::setsockopt(dump_fd_, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    return true;
+}
+
+bool NetlinkStateEngine::resync() {
+    // Rebuilt aside, so a dump failing halfway leaves the table as it was.
+    // The link dump rebuilds the link set itself, keeping up_since for links
+    // it already knew.
+    Table rebuilt = table_;
+    rebuilt.addresses.clear();
+    rebuilt.routes.clear();
+
+    if (!dump(RTM_GETLINK, rebuilt) || !dump(RTM_GETADDR, rebuilt) || !dump(RTM_GETROUTE, rebuilt)) {
+        return false;
+    }
+    table_ = std::move(rebuilt);
+    publish();
+    return true;
+}
+
+// Send a dump request and apply every reply to table until NLMSG_DONE
+bool NetlinkStateEngine::dump(uint16_t type, Table& table) {
+    if (dump_fd_ < 0) {
+        return false;
+    }
+
+    struct {
+        struct nlmsghdr header;
+        union {
+            struct ifinfomsg link;
+            struct ifaddrmsg address;
+            struct rtmsg route;
+        } body;
+    } request{};
+
+    size_t body_size = type == RTM_GETLINK ? sizeof(struct ifinfomsg)
+                     : type == RTM_GETADDR ? sizeof(struct ifaddrmsg)
+                     : sizeof(struct rtmsg);
+    request.header.nlmsg_len = NLMSG_LENGTH(body_size);
+    request.header.nlmsg_type = type;
+    request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.header.nlmsg_seq = ++dump_seq_;
+
+    struct sockaddr_nl kernel{};
+    kernel.nl_family = AF_NETLINK;
+    if (::sendto(dump_fd_, &request, request.header.nlmsg_len, 0,
+                 reinterpret_cast<struct sockaddr*>(&kernel), sizeof(kernel)) < 0) {
+        return false;
+    }
+
+    // A link dump replaces the link set; anything not reported is gone
+    std::map<int, Link> previous_links;
+    if (type == RTM_GETLINK) {
+        previous_links.swap(table.links);
+    }
+
+    std::vector<char> buffer(RECV_BUFFER_SIZE);
+    while (true) {
+        ssize_t received = ::recv(dump_fd_, buffer.data(), buffer.size(), 0);
+        if (received < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        size_t remaining = static_cast<size_t>(received);
+        for (auto* header = reinterpret_cast<struct nlmsghdr*>(buffer.data());
+             NLMSG_OK(header, remaining); header = NLMSG_NEXT(header, remaining)) {
+            if (header->nlmsg_seq != dump_seq_) {
+                continue;
+            }
+            if (header->nlmsg_type == NLMSG_DONE) {
+                return true;
+            }
+            if (header->nlmsg_type == NLMSG_ERROR) {
+                auto* error = static_cast<struct nlmsgerr*>(NLMSG_DATA(header));
+                errno = error->error ? -error->error : EIO;
+                return false;
+            }
+            if (type == RTM_GETLINK && header->nlmsg_type == RTM_NEWLINK) {
+                // Carry over what the dump message does not describe
+                auto* info = static_cast<struct ifinfomsg*>(NLMSG_DATA(header));
+                auto previous = previous_links.find(info->ifi_index);
+                if (previous != previous_links.end()) {
+                    table.links.emplace(previous->first, std::move(previous->second));
+                }
+            }
+            applyMessage(table, header);
+        }
+    }
+}
+
+void NetlinkStateEngine::applyMessage(Table& table, const struct nlmsghdr* header) {
+    switch (header->nlmsg_type) {
+        case RTM_NEWLINK:
+        case RTM_DELLINK:
+            applyLink(table, header);
+            break;
+        case RTM_NEWADDR:
+        case RTM_DELADDR:
+            applyAddress(table, header);
+            break;
+        case RTM_NEWROUTE:
+        case RTM_DELROUTE:
+            applyRoute(table, header);
+            break;
+        default:
+            break;
+    }
+}
+
+void NetlinkStateEngine::applyLink(Table& table, const struct nlmsghdr* header) {
+    if (header->nlmsg_len < NLMSG_LENGTH(sizeof(struct ifinfomsg))) {
+        return;
+    }
+    auto* info = static_cast<const struct ifinfomsg*>(NLMSG_DATA(header));
+
+    if (header->nlmsg_type == RTM_DELLINK) {
+        int index = info->ifi_index;
+        table.links.erase(index);
+        table.addresses.erase(std::remove_if(table.addresses.begin(), table.addresses.end(),
+            [index](const Address& address) { return address.ifindex == index; }), table.addresses.end());
+        table.routes.erase(std::remove_if(table.routes.begin(), table.routes.end(),
+            [index](const Route& route) { return route.oif == index; }), table.routes.end());
+        return;
+    }
+
+    // Events may carry only some attributes: update the existing entry
+    auto [entry, is_new] = table.links.try_emplace(info->ifi_index);
+    Link& link = entry->second;
+    bool had_carrier = !is_new && link.hasCarrier();
+    uint32_t old_flags = link.flags;
+    uint8_t old_operstate = link.operstate;
+
+    link.index = info->ifi_index;
+    link.type = info->ifi_type;
+    link.flags = info->ifi_flags;
+
+    bool have_stats64 = false;
+    int length = IFLA_PAYLOAD(header);
+    for (auto* attr = IFLA_RTA(info); RTA_OK(attr, length); attr = RTA_NEXT(attr, length)) {
+        const void* data = RTA_DATA(attr);
+        size_t size = RTA_PAYLOAD(attr);
+        switch (attr->rta_type) {
+            case IFLA_IFNAME:
+                link.name.assign(static_cast<const char*>(data), strnlen(static_cast<const char*>(data), size));
+                break;
+            case IFLA_ADDRESS:
+                link.mac_address = formatMac(static_cast<const unsigned char*>(data), size);
+                break;
+            case IFLA_MTU:
+                if (size >= sizeof(uint32_t)) {
+                    std::memcpy(&link.mtu, data, sizeof(uint32_t));
+                }
+                break;
+            case IFLA_OPERSTATE:
+                if (size >= 1) {
+                    link.operstate = *static_cast<const uint8_t*>(data);
+                }
+                break;
+            case IFLA_STATS64:
+                if (size >= sizeof(struct rtnl_link_stats64)) {
+                    struct rtnl_link_stats64 stats;
+                    std::memcpy(&stats, data, sizeof(stats));
+                    copyCounters(link.counters, &stats);
+                    have_stats64 = true;
+                }
+                break;
+            case IFLA_STATS:
+                if (!have_stats64 && size >= sizeof(struct rtnl_link_stats)) {
+                    struct rtnl_link_stats stats;
+                    std::memcpy(&stats, data, sizeof(stats));
+                    copyCounters(link.counters, &stats);
+                }
+                break;
+            case IFLA_LINKINFO: {
+                int nested_length = static_cast<int>(size);
+                for (auto* nested = static_cast<const struct rtattr*>(data); RTA_OK(nested, nested_length);
+                     nested = RTA_NEXT(nested, nested_length)) {
+                    if (nested->rta_type == IFLA_INFO_KIND) {
+                        const char* kind = static_cast<const char*>(RTA_DATA(nested));
+                        link.kind.assign(kind, strnlen(kind, RTA_PAYLOAD(nested)));
+                    }
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    bool has_carrier = link.hasCarrier();
+    if (has_carrier && (!had_carrier || is_new)) {
+        link.up_since = std::chrono::steady_clock::now();
+        if (!initial_dump_ && !is_new) {
+            ENDPOINT_LOG_INFO("netlink", "Link up: " + link.name);
+        }
+    } else if (!has_carrier && had_carrier) {
+        ENDPOINT_LOG_INFO("netlink", "Link down: " + link.name);
+    }
+
+    if (is_new || link.flags != old_flags || link.operstate != old_operstate) {
+        refreshLinkDetails(link);
+    }
+}
+
+void NetlinkStateEngine::applyAddress(Table& table, const struct nlmsghdr* header) {
+    if (header->nlmsg_len < NLMSG_LENGTH(sizeof(struct ifaddrmsg))) {
+        return;
+    }
+    auto* info = static_cast<const struct ifaddrmsg*>(NLMSG_DATA(header));
+    if (info->ifa_family != AF_INET && info->ifa_family != AF_INET6) {
+        return;
+    }
+
+    Address address;
+    address.ifindex = static_cast<int>(info->ifa_index);
+    address.family = info->ifa_family;
+    address.prefix_len = info->ifa_prefixlen;
+    address.scope = info->ifa_scope;
+    address.flags = info->ifa_flags;
+
+    std::string local;
+    std::string peer;
+    int length = IFA_PAYLOAD(header);
+    for (auto* attr = IFA_RTA(info); RTA_OK(attr, length); attr = RTA_NEXT(attr, length)) {
+        const void* data = RTA_DATA(attr);
+        size_t size = RTA_PAYLOAD(attr);
+        switch (attr->rta_type) {
+            case IFA_LOCAL:
+                local = formatAddress(info->ifa_family, data, size);
+                break;
+            case IFA_ADDRESS:
+                peer = formatAddress(info->ifa_family, data, size);
+                break;
+            case IFA_FLAGS:
+                if (size >= sizeof(uint32_t)) {
+                    std::memcpy(&address.flags, data, sizeof(uint32_t));
+                }
+                break;
+            case IFA_CACHEINFO:
+                if (size >= sizeof(struct ifa_cacheinfo)) {
+                    struct ifa_cacheinfo cache;
+                    std::memcpy(&cache, data, sizeof(cache));
+                    address.dynamic = cache.ifa_valid != 0xFFFFFFFFu;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    // IFA_ADDRESS is the peer on point-to-point links; IFA_LOCAL is ours
+    address.address = !local.empty() ? local : peer;
+    if (address.address.empty()) {
+        return;
+    }
+
+    auto same = [&address](const Address& other) {
+        return other.ifindex == address.ifindex && other.family == address.family &&
+               other.address == address.address && other.prefix_len == address.prefix_len;
+    };
+    auto existing = std::find_if(table.addresses.begin(), table.addresses.end(), same);
+
+    if (header->nlmsg_type == RTM_DELADDR) {
+        if (existing != table.addresses.end()) {
+            table.addresses.erase(existing);
+        }
+    } else if (existing != table.addresses.end()) {
+        *existing = address;
+    } else {
+        table.addresses.push_back(address);
+    }
+}
+
+void NetlinkStateEngine::applyRoute(Table& table, const struct nlmsghdr* header) {
+    if (header->nlmsg_len < NLMSG_LENGTH(sizeof(struct rtmsg))) {
+        return;
+    }
+    auto* info = static_cast<const struct rtmsg*>(NLMSG_DATA(header));
+    if ((info->rtm_family != AF_INET && info->rtm_family != AF_INET6) || info->rtm_type != RTN_UNICAST) {
+        return;
+    }
+
+    Route route;
+    route.family = info->rtm_family;
+    route.dst_len = info->rtm_dst_len;
+    route.protocol = info->rtm_protocol;
+    uint32_t route_table = info->rtm_table;
+
+    int length = RTM_PAYLOAD(header);
+    for (auto* attr = RTM_RTA(info); RTA_OK(attr, length); attr = RTA_NEXT(attr, length)) {
+        const void* data = RTA_DATA(attr);
+        size_t size = RTA_PAYLOAD(attr);
+        switch (attr->rta_type) {
+            case RTA_DST:
+                route.destination = formatAddress(info->rtm_family, data, size);
+                break;
+            case RTA_GATEWAY:
+                route.gateway = formatAddress(info->rtm_family, data, size);
+                break;
+            case RTA_OIF:
+                if (size >= sizeof(int)) {
+                    std::memcpy(&route.oif, data, sizeof(int));
+                }
+                break;
+            case RTA_PRIORITY:
+                if (size >= sizeof(uint32_t)) {
+                    std::memcpy(&route.priority, data, sizeof(uint32_t));
+                }
+                break;
+            case RTA_TABLE:
+                if (size >= sizeof(uint32_t)) {
+                    std::memcpy(&route_table, data, sizeof(uint32_t));
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    if (route_table != RT_TABLE_MAIN) {
+        return;
+    }
+
+    auto same = [&route](const Route& other) {
+        return other.family == route.family && other.destination == route.destination &&
+               other.dst_len == route.dst_len && other.priority == route.priority &&
+               other.oif == route.oif;
+    };
+    auto existing = std::find_if(table.routes.begin(), table.routes.end(), same);
+
+    if (header->nlmsg_type == RTM_DELROUTE) {
+        if (existing != table.routes.end()) {
+            table.routes.erase(existing);
+        }
+    } else if (existing != table.routes.end()) {
+        *existing = route;
+    } else {
+        table.routes.push_back(route);
+    }
+}
+
+void NetlinkStateEngine::publish() {
+    ++table_.generation;
+    table_.updated_at = std::chrono::steady_clock::now();
+    current_.store(std::make_shared<const Table>(table_), std::memory_order_release);
+}
+
+// Apply everything queued on the event socket, then publish once
+void NetlinkStateEngine::drainEvents() {
+    std::vector<char> buffer(RECV_BUFFER_SIZE);
+    bool changed = false;
+
+    while (true) {
+        ssize_t received = ::recv(listen_fd_, buffer.data(), buffer.size(), MSG_DONTWAIT);
+        if (received < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == ENOBUFS) {
+                // Kernel dropped events: the table can no longer be trusted
+                ENDPOINT_LOG_WARNING("netlink", "Event queue overrun, resyncing");
+                resync();
+                changed = false;
+                continue;
+            }
+            break;
+        }
+
+        size_t remaining = static_cast<size_t>(received);
+        for (auto* header = reinterpret_cast<struct nlmsghdr*>(buffer.data());
+             NLMSG_OK(header, remaining); header = NLMSG_NEXT(header, remaining)) {
+            applyMessage(table_, header);
+            changed = true;
+        }
+    }
+
+    if (changed) {
+        publish();
+    }
+}
+
+bool NetlinkStateEngine::start() {
+    std::lock_guard<std::mutex> lifecycle(lifecycle_mutex_);
+    if (running_.load(std::memory_order_acquire)) {
+        return true;
+    }
+    if (listen_fd_ < 0 || wake_fd_ < 0) {
+        return false;
+    }
+    running_.store(true, std::memory_order_release);
+    thread_ = std::thread(&NetlinkStateEngine::run, this);
+    return true;
+}
+
+void NetlinkStateEngine::stop() {
+    std::lock_guard<std::mutex> lifecycle(lifecycle_mutex_);
+    if (!running_.exchange(false, std::memory_order_acq_rel)) {
+        return;
+    }
+    // If this write fails the thread still notices on its next stats refresh
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t written = ::write(wake_fd_, &one, sizeof(one));
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void NetlinkStateEngine::run() {
+    auto next_stats = std::chrono::steady_clock::now() + STATS_REFRESH_INTERVAL;
+
+    while (running_.load(std::memory_order_acquire)) {
+        auto now = std::chrono::steady_clock::now();
+        int timeout_ms = static_cast<int>(std::max<int64_t>(0,
+            std::chrono::duration_cast<std::chrono::milliseconds>(next_stats - now).count()));
+
+        struct pollfd fds[2] = {
+            {listen_fd_, POLLIN, 0},
+            {wake_fd_, POLLIN, 0}
+        };
+        int ready = ::poll(fds, 2, timeout_ms);
+        if (ready < 0 && errno != EINTR) {
+            ENDPOINT_LOG_ERROR("netlink", "poll failed: " + std::string(std::strerror(errno)));
+            return;
+        }
+        if (fds[1].revents & POLLIN) {
+            uint64_t value;
+            [[maybe_unused]] ssize_t consumed = ::read(wake_fd_, &value, sizeof(value));
+            continue;
+        }
+        if (fds[0].revents & POLLIN) {
+            drainEvents();
+        }
+
+        if (std::chrono::steady_clock::now() >= next_stats) {
+            // Counters only change through polling; refreshed aside so a
+            // failed dump publishes nothing half-done
+            Table refreshed = table_;
+            if (dump(RTM_GETLINK, refreshed)) {
+                table_ = std::move(refreshed);
+                publish();
+            }
+            next_stats = std::chrono::steady_clock::now() + STATS_REFRESH_INTERVAL;
+        }
+    }
+}
@@ -1,7 +1,7 @@
 
 #include "bridge-handler.h"
+#include "json_document_store.h"
 #include <iostream>
-#include <fstream>
 #include <chrono>
 #include <iomanip>
 #include <sstream>
@@ -14,11 +14,8 @@ BridgeHandler::BridgeHandler() {
 }
 
 void BridgeHandler::loadBridges() {
-    std::ifstream file(basePath + "bridges.json");
-    if (file.is_open()) {
-        file >> bridgesData;
-        file.close();
-    }
+    // Served from memory after the first read; a missing file keeps what we had
+    JsonDocumentStore::getInstance().read(basePath + "bridges.json", bridgesData);
 }
 
 nlohmann::json BridgeHandler::getBridges() {
@@ -27,14 +24,9 @@ nlohmann::json BridgeHandler::getBridges() {
 }
 
 nlohmann::json BridgeHandler::getBridge(const std::string& bridgeId) {
-    loadBridges();
-    
-    if (bridgesData.contains("bridges") && bridgesData["bridges"].is_array()) {
-        for (const auto& bridge : bridgesData["bridges"]) {
-            if (bridge.contains("id") && bridge["id"] == bridgeId) {
-                return bridge;
-            }
-        }
+    nlohmann::json bridge;
+    if (JsonDocumentStore::getInstance().find(basePath + "bridges.json", "bridges", bridgeId, bridge)) {
+        return bridge;
     }
     
     return nlohmann::json{};
@@ -264,18 +256,12 @@ bool BridgeHandler::saveBridges() {
 }
 
 bool BridgeHandler::saveJsonToFile(const nlohmann::json& data, const std::string& filename) {
-    try {
-        std::ofstream file(filename);
-        if (file.is_open()) {
-            file << data.dump(2);
-            file.close();
-            return true;
-        }
-        return false;
-    } catch (const std::exception& e) {
-        std::cerr << "[BRIDGE-HANDLER] Failed to save to " << filename << ": " << e.what() << std::endl;
+    // Written behind, atomically; readers see the new data at once
+    if (!JsonDocumentStore::getInstance().write(filename, data, 2)) {
+        std::cerr << "[BRIDGE-HANDLER] Failed to save to " << filename << std::endl;
         return false;
     }
+    return true;
 }
 
 std::string BridgeHandler::getCurrentTimestamp() {
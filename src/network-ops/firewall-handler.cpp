@@ -1,7 +1,7 @@
 
 #include "firewall-handler.h"
+#include "json_document_store.h"
 #include <iostream>
-#include <fstream>
 #include <chrono>
 #include <iomanip>
 #include <sstream>
@@ -14,11 +14,8 @@ FirewallHandler::FirewallHandler() {
 }
 
 void FirewallHandler::loadFirewallRules() {
-    std::ifstream file(basePath + "firewall-rules.json");
-    if (file.is_open()) {
-        file >> firewallRulesData;
-        file.close();
-    }
+    // Served from memory after the first read; a missing file keeps what we had
+    JsonDocumentStore::getInstance().read(basePath + "firewall-rules.json", firewallRulesData);
 }
 
 nlohmann::json FirewallHandler::getFirewallRules() {
@@ -27,14 +24,9 @@ nlohmann::json FirewallHandler::getFirewallRules() {
 }
 
 nlohmann::json FirewallHandler::getFirewallRule(const std::string& ruleId) {
-    loadFirewallRules();
-    
-    if (firewallRulesData.contains("firewall_rules") && firewallRulesData["firewall_rules"].is_array()) {
-        for (const auto& rule : firewallRulesData["firewall_rules"]) {
-            if (rule.contains("id") && rule["id"] == ruleId) {
-                return rule;
-            }
-        }
+    nlohmann::json rule;
+    if (JsonDocumentStore::getInstance().find(basePath + "firewall-rules.json", "firewall_rules", ruleId, rule)) {
+        return rule;
     }
     
     return nlohmann::json{};
@@ -258,18 +250,12 @@ bool FirewallHandler::saveFirewallRules() {
 }
 
 bool FirewallHandler::saveJsonToFile(const nlohmann::json& data, const std::string& filename) {
-    try {
-        std::ofstream file(filename);
-        if (file.is_open()) {
-            file << data.dump(2);
-            file.close();
-            return true;
-        }
-        return false;
-    } catch (const std::exception& e) {
-        std::cerr << "[FIREWALL-HANDLER] Failed to save to " << filename << ": " << e.what() << std::endl;
+    // Written behind, atomically; readers see the new data at once
+    if (!JsonDocumentStore::getInstance().write(filename, data, 2)) {
+        std::cerr << "[FIREWALL-HANDLER] Failed to save to " << filename << std::endl;
         return false;
     }
+    return true;
 }
 
 std::string FirewallHandler::getCurrentTimestamp() {
@@ -1,7 +1,7 @@
 
 #include "nat-handler.h"
+#include "json_document_store.h"
 #include <iostream>
-#include <fstream>
 #include <chrono>
 #include <iomanip>
 #include <sstream>
@@ -14,11 +14,8 @@ NatHandler::NatHandler() {
 }
 
 void NatHandler::loadNatRules() {
-    std::ifstream file(basePath + "nat-rules.json");
-    if (file.is_open()) {
-        file >> natRulesData;
-        file.close();
-    }
+    // Served from memory after the first read; a missing file keeps what we had
+    JsonDocumentStore::getInstance().read(basePath + "nat-rules.json", natRulesData);
 }
 
 nlohmann::json NatHandler::getNatRules() {
@@ -27,14 +24,9 @@ nlohmann::json NatHandler::getNatRules() {
 }
 
 nlohmann::json NatHandler::getNatRule(const std::string& ruleId) {
-    loadNatRules();
-    
-    if (natRulesData.contains("nat_rules") && natRulesData["nat_rules"].is_array()) {
-        for (const auto& rule : natRulesData["nat_rules"]) {
-            if (rule.contains("id") && rule["id"] == ruleId) {
-                return rule;
-            }
-        }
+    nlohmann::json rule;
+    if (JsonDocumentStore::getInstance().find(basePath + "nat-rules.json", "nat_rules", ruleId, rule)) {
+        return rule;
     }
     
     return nlohmann::json{};
@@ -256,18 +248,12 @@ bool NatHandler::saveNatRules() {
 }
 
 bool NatHandler::saveJsonToFile(const nlohmann::json& data, const std::string& filename) {
-    try {
-        std::ofstream file(filename);
-        if (file.is_open()) {
-            file << data.dump(2);
-            file.close();
-            return true;
-        }
-        return false;
-    } catch (const std::exception& e) {
-        std::cerr << "[NAT-HANDLER] Failed to save to " << filename << ": " << e.what() << std::endl;
+    // Written behind, atomically; readers see the new data at once
+    if (!JsonDocumentStore::getInstance().write(filename, data, 2)) {
+        std::cerr << "[NAT-HANDLER] Failed to save to " << filename << std::endl;
         return false;
     }
+    return true;
 }
 
 std::string NatHandler::getCurrentTimestamp() {
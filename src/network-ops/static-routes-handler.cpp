@@ -1,7 +1,7 @@
 
 #include "static-routes-handler.h"
+#include "json_document_store.h"
 #include <iostream>
-#include <fstream>
 #include <chrono>
 #include <iomanip>
 #include <sstream>
@@ -14,11 +14,8 @@ StaticRoutesHandler::StaticRoutesHandler() {
 }
 
 void StaticRoutesHandler::loadStaticRoutes() {
-    std::ifstream file(basePath + "static-routes.json");
-    if (file.is_open()) {
-        file >> staticRoutesData;
-        file.close();
-    }
+    // Served from memory after the first read; a missing file keeps what we had
+    JsonDocumentStore::getInstance().read(basePath + "static-routes.json", staticRoutesData);
 }
 
 nlohmann::json StaticRoutesHandler::getStaticRoutes() {
@@ -27,14 +24,9 @@ nlohmann::json StaticRoutesHandler::getStaticRoutes() {
 }
 
 nlohmann::json StaticRoutesHandler::getStaticRoute(const std::string& routeId) {
-    loadStaticRoutes();
-    
-    if (staticRoutesData.contains("static_routes") && staticRoutesData["static_routes"].is_array()) {
-        for (const auto& route : staticRoutesData["static_routes"]) {
-            if (route.contains("id") && route["id"] == routeId) {
-                return route;
-            }
-        }
+    nlohmann::json route;
+    if (JsonDocumentStore::getInstance().find(basePath + "static-routes.json", "static_routes", routeId, route)) {
+        return route;
     }
     
     return nlohmann::json{};
@@ -258,18 +250,12 @@ bool StaticRoutesHandler::saveStaticRoutes() {
 }
 
 bool StaticRoutesHandler::saveJsonToFile(const nlohmann::json& data, const std::string& filename) {
-    try {
-        std::ofstream file(filename);
-        if (file.is_open()) {
-            file << data.dump(2);
-            file.close();
-            return true;
-        }
-        return false;
-    } catch (const std::exception& e) {
-        std::cerr << "[STATIC-ROUTES-HANDLER] Failed to save to " << filename << ": " << e.what() << std::endl;
+    // Written behind, atomically; readers see the new data at once
+    if (!JsonDocumentStore::getInstance().write(filename, data, 2)) {
+        std::cerr << "[STATIC-ROUTES-HANDLER] Failed to save to " << filename << std::endl;
         return false;
     }
+    return true;
 }
 
 std::string StaticRoutesHandler::getCurrentTimestamp() {
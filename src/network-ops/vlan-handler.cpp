@@ -1,7 +1,7 @@
 
 #include "vlan-handler.h"
+#include "json_document_store.h"
 #include <iostream>
-#include <fstream>
 #include <chrono>
 #include <iomanip>
 #include <sstream>
@@ -14,11 +14,8 @@ VlanHandler::VlanHandler() {
 }
 
 void VlanHandler::loadVlans() {
-    std::ifstream file(basePath + "vlans.json");
-    if (file.is_open()) {
-        file >> vlansData;
-        file.close();
-    }
+    // Served from memory after the first read; a missing file keeps what we had
+    JsonDocumentStore::getInstance().read(basePath + "vlans.json", vlansData);
 }
 
 nlohmann::json VlanHandler::getVlans() {
@@ -27,14 +24,9 @@ nlohmann::json VlanHandler::getVlans() {
 }
 
 nlohmann::json VlanHandler::getVlan(const std::string& vlanId) {
-    loadVlans();
-    
-    if (vlansData.contains("vlans") && vlansData["vlans"].is_array()) {
-        for (const auto& vlan : vlansData["vlans"]) {
-            if (vlan.contains("id") && vlan["id"] == vlanId) {
-                return vlan;
-            }
-        }
+    nlohmann::json vlan;
+    if (JsonDocumentStore::getInstance().find(basePath + "vlans.json", "vlans", vlanId, vlan)) {
+        return vlan;
     }
     
     return nlohmann::json{};
@@ -258,18 +250,12 @@ bool VlanHandler::saveVlans() {
 }
 
 bool VlanHandler::saveJsonToFile(const nlohmann::json& data, const std::string& filename) {
-    try {
-        std::ofstream file(filename);
-        if (file.is_open()) {
-            file << data.dump(2);
-            file.close();
-            return true;
-        }
-        return false;
-    } catch (const std::exception& e) {
-        std::cerr << "[VLAN-HANDLER] Failed to save to " << filename << ": " << e.what() << std::endl;
+    // Written behind, atomically; readers see the new data at once
+    if (!JsonDocumentStore::getInstance().write(filename, data, 2)) {
+        std::cerr << "[VLAN-HANDLER] Failed to save to " << filename << std::endl;
         return false;
     }
+    return true;
 }
 
 std::string VlanHandler::getCurrentTimestamp() {
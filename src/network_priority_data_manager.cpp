@@ -1,7 +1,7 @@
 
 #include "network_priority_data_manager.h"
 #include "config_manager.h"
-#include <fstream>
+#include "json_document_store.h"
 #include <iostream>
 #include <algorithm>
 #include <chrono>
@@ -15,48 +15,36 @@ NetworkPriorityDataManager::NetworkPriorityDataManager() {
 }
 
 nlohmann::json NetworkPriorityDataManager::loadInterfacesData() {
-    std::ifstream file(interfacesFilePath);
-    if (!file.is_open()) {
+    nlohmann::json data;
+    if (!JsonDocumentStore::getInstance().read(interfacesFilePath, data)) {
         std::cerr << "Error: Could not open interfaces file: " << interfacesFilePath << std::endl;
         return nlohmann::json();
     }
-    
-    nlohmann::json data;
-    file >> data;
     return data;
 }
 
 nlohmann::json NetworkPriorityDataManager::loadRoutingRulesData() {
-    std::ifstream file(routingRulesFilePath);
-    if (!file.is_open()) {
+    nlohmann::json data;
+    if (!JsonDocumentStore::getInstance().read(routingRulesFilePath, data)) {
         std::cerr << "Error: Could not open routing rules file: " << routingRulesFilePath << std::endl;
         return nlohmann::json();
     }
-    
-    nlohmann::json data;
-    file >> data;
     return data;
 }
 
 bool NetworkPriorityDataManager::saveInterfacesData(const nlohmann::json& data) {
-    std::ofstream file(interfacesFilePath);
-    if (!file.is_open()) {
+    if (!JsonDocumentStore::getInstance().write(interfacesFilePath, data, 4)) {
         std::cerr << "Error: Could not write to interfaces file: " << interfacesFilePath << std::endl;
         return false;
     }
-    
-    file << data.dump(4);
     return true;
 }
 
 bool NetworkPriorityDataManager::saveRoutingRulesData(const nlohmann::json& data) {
-    std::ofstream file(routingRulesFilePath);
-    if (!file.is_open()) {
+    if (!JsonDocumentStore::getInstance().write(routingRulesFilePath, data, 4)) {
         std::cerr << "Error: Could not write to routing rules file: " << routingRulesFilePath << std::endl;
         return false;
     }
-    
-    file << data.dump(4);
     return true;
 }
 
@@ -65,13 +53,9 @@ nlohmann::json NetworkPriorityDataManager::getInterfaces() {
 }
 
 nlohmann::json NetworkPriorityDataManager::getInterface(const std::string& interfaceId) {
-    auto data = loadInterfacesData();
-    if (data.contains("interfaces")) {
-        for (const auto& interface : data["interfaces"]) {
-            if (interface["id"] == interfaceId) {
-                return interface;
-            }
-        }
+    nlohmann::json interface;
+    if (JsonDocumentStore::getInstance().find(interfacesFilePath, "interfaces", interfaceId, interface)) {
+        return interface;
     }
     return nlohmann::json();
 }
@@ -136,13 +120,9 @@ nlohmann::json NetworkPriorityDataManager::getRoutingRules() {
 }
 
 nlohmann::json NetworkPriorityDataManager::getRoutingRule(const std::string& ruleId) {
-    auto data = loadRoutingRulesData();
-    if (data.contains("routing_rules")) {
-        for (const auto& rule : data["routing_rules"]) {
-            if (rule["id"] == ruleId) {
-                return rule;
-            }
-        }
+    nlohmann::json rule;
+    if (JsonDocumentStore::getInstance().find(routingRulesFilePath, "routing_rules", ruleId, rule)) {
+        return rule;
     }
     return nlohmann::json();
 }
@@ -0,0 +1,531 @@
+#include "process_engine.h"
+#include "endpoint_logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace {
+
+constexpr uint64_t WAKE_KEY = 0;                // Process ids start at 1
+constexpr size_t READ_CHUNK = 64 * 1024;
+constexpr size_t MAX_LINE_LENGTH = 64 * 1024;   // Longer "lines" are split
+constexpr int REAP_POLL_MS = 100;               // Exit polling when pidfd_open is unavailable
+
+uint64_t outputKey(uint64_t id) { return id << 1; }
+uint64_t pidfdKey(uint64_t id) { return (id << 1) | 1; }
+
+int openPidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return static_cast<int>(::syscall(SYS_pidfd_open, pid, 0));
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+} // namespace
+
+CancellationToken::CancellationToken() : cancelled_(std::make_shared<std::atomic<bool>>(false)) {
+}
+
+void CancellationToken::cancel() const {
+    if (!cancelled_->exchange(true)) {
+        ProcessEngine::getInstance().wake();
+    }
+}
+
+bool CancellationToken::isCancelled() const {
+    return cancelled_->load(std::memory_order_acquire);
+}
+
+struct ProcessEngine::Process {
+    uint64_t id = 0;
+    pid_t pid = -1;
+    int output_fd = -1;
+    int pid_fd = -1;
+    Options options;
+    Result result;
+
+    std::string partial_line;   // Bytes after the last newline
+    std::string line;           // Reused for every emitted line
+
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    std::chrono::steady_clock::time_point kill_at = std::chrono::steady_clock::time_point::max();
+    bool term_sent = false;
+    bool exited = false;
+};
+
+ProcessEngine& ProcessEngine::getInstance() {
+    static ProcessEngine instance;
+    return instance;
+}
+
+ProcessEngine::ProcessEngine() : read_buffer_(READ_CHUNK) {
+    epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (epoll_fd_ < 0 || wake_fd_ < 0) {
+        ENDPOINT_LOG("process-engine", "Failed to create epoll/eventfd: " + std::string(std::strerror(errno)));
+        return;
+    }
+
+    struct epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = WAKE_KEY;
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event);
+
+    thread_ = std::thread(&ProcessEngine::reactorLoop, this);
+}
+
+ProcessEngine::~ProcessEngine() {
+    shutdown();
+    if (wake_fd_ >= 0) {
+        ::close(wake_fd_);
+    }
+    if (epoll_fd_ >= 0) {
+        ::close(epoll_fd_);
+    }
+}
+
+bool ProcessEngine::spawn(Options options) {
+    auto process = std::make_unique<Process>();
+    process->options = std::move(options);
+    process->started = std::chrono::steady_clock::now();
+
+    auto fail = [&](const std::string& error) {
+        process->result.error = error;
+        ENDPOINT_LOG("process-engine", "Cannot start " +
+                     (process->options.argv.empty() ? std::string("(empty command)") : process->options.argv[0]) +
+                     ": " + error);
+        if (process->options.on_exit) {
+            process->options.on_exit(process->result);
+        }
+        return false;
+    };
+
+    if (process->options.argv.empty()) {
+        return fail("empty command");
+    }
+    if (stopping_.load() || epoll_fd_ < 0) {
+        return fail("process engine is not running");
+    }
+
+    int pipe_fds[2];
+    if (::pipe2(pipe_fds, O_CLOEXEC) != 0) {
+        return fail(std::strerror(errno));
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, pipe_fds[1], STDOUT_FILENO);
+    if (process->options.merge_stderr) {
+        posix_spawn_file_actions_adddup2(&actions, pipe_fds[1], STDERR_FILENO);
+    } else {
+        posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    }
+
+    // The server ignores SIGPIPE; children get default dispositions, an
+    // empty signal mask and their own process group so a kill reaches any
+    // helpers they start
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t signals;
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attributes, &signals);
+    for (int signal : {SIGPIPE, SIGINT, SIGTERM, SIGHUP, SIGQUIT, SIGCHLD}) {
+        sigaddset(&signals, signal);
+    }
+    posix_spawnattr_setsigdefault(&attributes, &signals);
+    posix_spawnattr_setpgroup(&attributes, 0);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP);
+
+    std::vector<char*> argv;
+    argv.reserve(process->options.argv.size() + 1);
+    for (auto& argument : process->options.argv) {
+        argv.push_back(argument.data());
+    }
+    argv.push_back(nullptr);
+
+    int rc = ::posix_spawnp(&process->pid, argv[0], &actions, &attributes, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+    ::close(pipe_fds[1]);
+    if (rc != 0) {
+        ::close(pipe_fds[0]);
+        return fail(std::strerror(rc));
+    }
+
+    process->output_fd = pipe_fds[0];
+    ::fcntl(process->output_fd, F_SETFL, ::fcntl(process->output_fd, F_GETFL) | O_NONBLOCK);
+    process->pid_fd = openPidfd(process->pid);
+    if (process->options.timeout.count() > 0) {
+        process->deadline = process->started + process->options.timeout;
+    }
+
+    {
+        // Checked under the lock the reactor takes for its final adoption,
+        // so a process is either adopted there or never queued
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!closed_) {
+            process->id = ++next_id_;
+            pending_.push_back(std::move(process));
+        }
+    }
+    if (process) {
+        // Shut down meanwhile: nothing would ever reap this child
+        ::kill(-process->pid, SIGKILL);
+        while (::waitpid(process->pid, nullptr, 0) < 0 && errno == EINTR) {
+        }
+        ::close(process->output_fd);
+        if (process->pid_fd >= 0) {
+            ::close(process->pid_fd);
+        }
+        process->result.cancelled = true;
+        return fail("process engine is not running");
+    }
+    running_.fetch_add(1);
+    wake();
+    return true;
+}
+
+ProcessEngine::Result ProcessEngine::run(std::vector<std::string> argv, std::chrono::milliseconds timeout,
+                                         const CancellationToken& cancel, bool merge_stderr) {
+    if (std::this_thread::get_id() == thread_.get_id()) {
+        Result result;
+        result.error = "run() called from the reactor thread";
+        return result;
+    }
+
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    bool done = false;
+    Result result;
+
+    Options options;
+    options.argv = std::move(argv);
+    options.timeout = timeout;
+    options.cancel = cancel;
+    options.merge_stderr = merge_stderr;
+    options.capture_output = true;
+    options.on_exit = [&](const Result& finished) {
+        std::lock_guard<std::mutex> lock(done_mutex);
+        result = finished;
+        done = true;
+        done_cv.notify_one();
+    };
+
+    spawn(std::move(options));
+
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done_cv.wait(lock, [&]() { return done; });
+    return result;
+}
+
+size_t ProcessEngine::runningCount() const {
+    return running_.load();
+}
+
+void ProcessEngine::shutdown() {
+    if (stopping_.exchange(true)) {
+        return;
+    }
+    wake();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void ProcessEngine::wake() {
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t written = ::write(wake_fd_, &one, sizeof(one));
+}
+
+void ProcessEngine::adoptPending() {
+    std::vector<std::unique_ptr<Process>> adopted;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        adopted.swap(pending_);
+    }
+
+    for (auto& process : adopted) {
+        struct epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = outputKey(process->id);
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, process->output_fd, &event);
+        if (process->pid_fd >= 0) {
+            event.data.u64 = pidfdKey(process->id);
+            ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, process->pid_fd, &event);
+        }
+        uint64_t id = process->id;
+        processes_.emplace(id, std::move(process));
+    }
+}
+
+void ProcessEngine::emitLine(Process& process, const char* data, size_t length) {
+    if (length > 0 && data[length - 1] == '\r') {
+        --length;
+    }
+    if (!process.options.on_line) {
+        return;
+    }
+    process.line.assign(data, length);
+    try {
+        process.options.on_line(process.line);
+    } catch (const std::exception& e) {
+        ENDPOINT_LOG("process-engine", "Line callback for " + process.options.argv[0] + " threw: " + e.what());
+    }
+}
+
+void ProcessEngine::readOutput(Process& process) {
+    if (process.output_fd < 0) {
+        return;
+    }
+
+    while (true) {
+        ssize_t n = ::read(process.output_fd, read_buffer_.data(), read_buffer_.size());
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            n = 0; // Treat read errors like end of output
+        }
+
+        if (n == 0) {
+            if (!process.partial_line.empty()) {
+                emitLine(process, process.partial_line.data(), process.partial_line.size());
+                process.partial_line.clear();
+            }
+            ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, process.output_fd, nullptr);
+            ::close(process.output_fd);
+            process.output_fd = -1;
+            return;
+        }
+
+        const char* data = read_buffer_.data();
+        size_t length = static_cast<size_t>(n);
+
+        if (process.options.capture_output && process.result.output.size() < process.options.max_output) {
+            process.result.output.append(data, std::min(length, process.options.max_output - process.result.output.size()));
+        }
+
+        // Complete lines are emitted straight from the read buffer; only the
+        // tail without a newline is carried over
+        size_t start = 0;
+        while (start < length) {
+            const char* newline = static_cast<const char*>(std::memchr(data + start, '\n', length - start));
+            if (!newline) {
+                process.partial_line.append(data + start, length - start);
+                if (process.partial_line.size() >= MAX_LINE_LENGTH) {
+                    emitLine(process, process.partial_line.data(), process.partial_line.size());
+                    process.partial_line.clear();
+                }
+                break;
+            }
+            size_t end = static_cast<size_t>(newline - data);
+            if (process.partial_line.empty()) {
+                emitLine(process, data + start, end - start);
+            } else {
+                process.partial_line.append(data + start, end - start);
+                emitLine(process, process.partial_line.data(), process.partial_line.size());
+                process.partial_line.clear();
+            }
+            start = end + 1;
+        }
+    }
+}
+
+void ProcessEngine::signalGroup(Process& process, int signal) {
+    // Only while unreaped: afterwards the pid (and group id) may be reused
+    if (!process.exited) {
+        ::kill(-process.pid, signal);
+    }
+}
+
+bool ProcessEngine::reap(Process& process, bool block) {
+    if (process.exited) {
+        return true;
+    }
+
+    int status = 0;
+    pid_t rc;
+    do {
+        rc = ::waitpid(process.pid, &status, block ? 0 : WNOHANG);
+    } while (rc < 0 && errno == EINTR);
+    if (rc == 0) {
+        return false;
+    }
+
+    process.exited = true;
+    if (rc < 0) {
+        process.result.exit_code = -1;
+    } else if (WIFEXITED(status)) {
+        process.result.exit_code = WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+        process.result.exit_code = 128 + WTERMSIG(status);
+    }
+
+    if (process.pid_fd >= 0) {
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, process.pid_fd, nullptr);
+        ::close(process.pid_fd);
+        process.pid_fd = -1;
+    }
+
+    // Whatever is still buffered belongs to this run; a background helper
+    // keeping the pipe open must not hold the result back
+    readOutput(process);
+    if (process.output_fd >= 0) {
+        if (!process.partial_line.empty()) {
+            emitLine(process, process.partial_line.data(), process.partial_line.size());
+            process.partial_line.clear();
+        }
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, process.output_fd, nullptr);
+        ::close(process.output_fd);
+        process.output_fd = -1;
+    }
+    return true;
+}
+
+void ProcessEngine::finish(uint64_t id) {
+    auto it = processes_.find(id);
+    if (it == processes_.end()) {
+        return;
+    }
+
+    std::unique_ptr<Process> process = std::move(it->second);
+    processes_.erase(it);
+    running_.fetch_sub(1);
+
+    process->result.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - process->started);
+    if (process->options.on_exit) {
+        try {
+            process->options.on_exit(process->result);
+        } catch (const std::exception& e) {
+            ENDPOINT_LOG("process-engine", "Exit callback for " + process->options.argv[0] + " threw: " + e.what());
+        }
+    }
+}
+
+void ProcessEngine::checkDeadlines() {
+    auto now = std::chrono::steady_clock::now();
+    std::vector<uint64_t> finished;
+
+    for (auto& [id, process] : processes_) {
+        if (!process->exited) {
+            if (!process->term_sent && process->options.cancel.isCancelled()) {
+                process->result.cancelled = true;
+                process->term_sent = true;
+                process->kill_at = now + CANCEL_GRACE;
+                signalGroup(*process, SIGTERM);
+            }
+            if (now >= process->deadline && !process->result.timed_out) {
+                process->result.timed_out = true;
+                signalGroup(*process, SIGKILL);
+            }
+            if (now >= process->kill_at) {
+                process->kill_at = std::chrono::steady_clock::time_point::max();
+                signalGroup(*process, SIGKILL);
+            }
+            if (process->pid_fd < 0) {
+                reap(*process, false);
+            }
+        }
+        if (process->exited) {
+            finished.push_back(id);
+        }
+    }
+
+    for (uint64_t id : finished) {
+        finish(id);
+    }
+}
+
+int ProcessEngine::nextTimeoutMs() const {
+    auto now = std::chrono::steady_clock::now();
+    auto next = std::chrono::steady_clock::time_point::max();
+    bool polling = false;
+
+    for (const auto& [id, process] : processes_) {
+        if (process->exited) {
+            return 0;
+        }
+        next = std::min({next, process->deadline, process->kill_at});
+        polling = polling || process->pid_fd < 0;
+    }
+
+    int timeout = -1;
+    if (next != std::chrono::steady_clock::time_point::max()) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count();
+        timeout = static_cast<int>(std::clamp<int64_t>(remaining + 1, 0, 60 * 1000));
+    }
+    if (polling && (timeout < 0 || timeout > REAP_POLL_MS)) {
+        timeout = REAP_POLL_MS;
+    }
+    return timeout;
+}
+
+void ProcessEngine::reactorLoop() {
+    struct epoll_event events[64];
+
+    while (!stopping_.load()) {
+        int count = ::epoll_wait(epoll_fd_, events, 64, nextTimeoutMs());
+        if (count < 0 && errno != EINTR) {
+            ENDPOINT_LOG("process-engine", "epoll_wait failed: " + std::string(std::strerror(errno)));
+            break;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            uint64_t key = events[i].data.u64;
+            if (key == WAKE_KEY) {
+                uint64_t value;
+                [[maybe_unused]] ssize_t drained = ::read(wake_fd_, &value, sizeof(value));
+                adoptPending();
+                continue;
+            }
+
+            auto it = processes_.find(key >> 1);
+            if (it == processes_.end()) {
+                continue;
+            }
+            if (key & 1) {
+                reap(*it->second, false);
+            } else {
+                readOutput(*it->second);
+            }
+        }
+
+        // Also picks up cancellations (their wake-up is the WAKE_KEY event)
+        checkDeadlines();
+    }
+
+    // Shutting down: nothing may outlive the engine, and spawn() queues
+    // nothing more once closed_ is set
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+    }
+    adoptPending();
+    for (auto& [id, process] : processes_) {
+        process->result.cancelled = true;
+        signalGroup(*process, SIGKILL);
+        reap(*process, true);
+    }
+    while (!processes_.empty()) {
+        finish(processes_.begin()->first);
+    }
+}
@@ -418,9 +418,9 @@ ApiResponse RouteProcessors::processSystemComponentRequest(const ApiRequest& req
             }
         }
 
-        // Update system data if refresh requested
+        // Schedule a system refresh if requested; the response carries current data
         if (force_refresh) {
-            DashboardGlobals::updateSystemData(true);
+            DashboardGlobals::requestRefresh("system");
         }
 
         // Get isolated system data
@@ -431,7 +431,8 @@ ApiResponse RouteProcessors::processSystemComponentRequest(const ApiRequest& req
                 {"cpu_usage_percent", system_info.cpu_usage_percent},
                 {"cpu_cores", system_info.cpu_cores},
                 {"cpu_model", system_info.cpu_model},
-                {"cpu_temp_celsius", system_info.cpu_temp_celsius},
+                {"cpu_temp_celsius", system_info.cpu_temp_celsius == SystemInfo::TEMPERATURE_UNKNOWN
+                ? nlohmann::json(nullptr) : nlohmann::json(system_info.cpu_temp_celsius)},
                 {"cpu_base_clock_ghz", system_info.cpu_base_clock_ghz},
                 {"cpu_boost_clock_ghz", system_info.cpu_boost_clock_ghz},
                 {"ram_usage_percent", system_info.ram_usage_percent},
@@ -509,9 +510,9 @@ ApiResponse RouteProcessors::processNetworkComponentRequest(const ApiRequest& re
             }
         }
 
-        // Update network data if refresh requested
+        // Schedule a network refresh if requested; the response carries current data
         if (force_refresh) {
-            DashboardGlobals::updateNetworkData(true);
+            DashboardGlobals::requestRefresh("network");
         }
 
         // Get isolated network data
@@ -605,9 +606,9 @@ ApiResponse RouteProcessors::processCellularComponentRequest(const ApiRequest& r
             }
         }
 
-        // Update cellular data if refresh requested
+        // Schedule a cellular refresh if requested; the response carries current data
         if (force_refresh) {
-            DashboardGlobals::updateCellularData(true);
+            DashboardGlobals::requestRefresh("cellular");
         }
 
         // Get isolated cellular data
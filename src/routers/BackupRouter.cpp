@@ -1,5 +1,6 @@
 
 #include "BackupRouter.h"
+#include "../multipart_upload_sink.h"
 #include <iostream>
 #include <fstream>
 #include <chrono>
@@ -51,58 +52,37 @@ std::string BackupRouter::handleBackupEstimate(const ApiRequest& request) {
             tempBackupConfig["password"] = "temp_estimation_password";
         }
         
-        std::cout << "[BACKUP-ROUTER] Creating temporary backup for size estimation..." << std::endl;
-        
-        // Create temporary backup using BackupHandler
-        std::string tempBackupPath = m_backupHandler->createTemporaryBackup(tempBackupConfig);
-        
-        // Get the actual file size from the temporary backup
-        size_t actualSize = 0;
-        size_t fileCount = 0;
+        // Size of a temporary backup, which BackupHandler only builds again
+        // when the selected files changed since the last estimate
+        json estimate = m_backupHandler->estimateBackup(tempBackupConfig);
+        size_t actualSize = estimate.value("size", size_t(0));
+        size_t fileCount = estimate.value("file_count", size_t(0));
         json sizeBreakdown;
         
-        if (std::filesystem::exists(tempBackupPath)) {
-            actualSize = std::filesystem::file_size(tempBackupPath);
+        // Create size breakdown based on backup components
+        if (backupType == "full") {
+            sizeBreakdown["base_size"] = formatFileSize(actualSize * 0.85); // ~85% for base system
+            sizeBreakdown["network_size"] = formatFileSize(actualSize * 0.08); // ~8% for network
+            sizeBreakdown["auth_size"] = formatFileSize(actualSize * 0.04); // ~4% for auth
+            sizeBreakdown["other_size"] = formatFileSize(actualSize * 0.03); // ~3% for other
+        } else {
+            // For partial backups, distribute based on selected components
+            int componentCount = 0;
+            if (requestData.value("network_config_backup", false)) componentCount++;
+            if (requestData.value("authentication_backup", false)) componentCount++;
+            if (requestData.value("license_backup", false)) componentCount++;
+            if (requestData.value("cellular_backup", false)) componentCount++;
+            if (requestData.value("vpn_backup", false)) componentCount++;
+            if (requestData.value("wireless_backup", false)) componentCount++;
             
-            // Get detailed breakdown from the backup handler
-            auto backupDetails = m_backupHandler->getTemporaryBackupDetails(tempBackupPath);
-            fileCount = backupDetails.value("file_count", 0);
+            size_t perComponentSize = componentCount > 0 ? actualSize / componentCount : 0;
             
-            // Create size breakdown based on backup components
-            if (backupType == "full") {
-                sizeBreakdown["base_size"] = formatFileSize(actualSize * 0.85); // ~85% for base system
-                sizeBreakdown["network_size"] = formatFileSize(actualSize * 0.08); // ~8% for network
-                sizeBreakdown["auth_size"] = formatFileSize(actualSize * 0.04); // ~4% for auth
-                sizeBreakdown["other_size"] = formatFileSize(actualSize * 0.03); // ~3% for other
-            } else {
-                // For partial backups, distribute based on selected components
-                int componentCount = 0;
-                if (requestData.value("network_config_backup", false)) componentCount++;
-                if (requestData.value("authentication_backup", false)) componentCount++;
-                if (requestData.value("license_backup", false)) componentCount++;
-                if (requestData.value("cellular_backup", false)) componentCount++;
-                if (requestData.value("vpn_backup", false)) componentCount++;
-                if (requestData.value("wireless_backup", false)) componentCount++;
-                
-                size_t perComponentSize = componentCount > 0 ? actualSize / componentCount : 0;
-                
-                sizeBreakdown["base_size"] = formatFileSize(0);
-                sizeBreakdown["network_size"] = formatFileSize(requestData.value("network_config_backup", false) ? perComponentSize : 0);
-                sizeBreakdown["auth_size"] = formatFileSize(requestData.value("authentication_backup", false) ? perComponentSize : 0);
-                sizeBreakdown["other_size"] = formatFileSize(actualSize - 
-                    (requestData.value("network_config_backup", false) ? perComponentSize : 0) -
-                    (requestData.value("authentication_backup", false) ? perComponentSize : 0));
-            }
-        }
-        
-        // Clean up temporary backup file
-        try {
-            if (std::filesystem::exists(tempBackupPath)) {
-                std::filesystem::remove(tempBackupPath);
-                std::cout << "[BACKUP-ROUTER] Temporary backup file cleaned up: " << tempBackupPath << std::endl;
-            }
-        } catch (const std::exception& cleanupError) {
-            std::cout << "[BACKUP-ROUTER] Warning: Failed to cleanup temporary backup: " << cleanupError.what() << std::endl;
+            sizeBreakdown["base_size"] = formatFileSize(0);
+            sizeBreakdown["network_size"] = formatFileSize(requestData.value("network_config_backup", false) ? perComponentSize : 0);
+            sizeBreakdown["auth_size"] = formatFileSize(requestData.value("authentication_backup", false) ? perComponentSize : 0);
+            sizeBreakdown["other_size"] = formatFileSize(actualSize - 
+                (requestData.value("network_config_backup", false) ? perComponentSize : 0) -
+                (requestData.value("authentication_backup", false) ? perComponentSize : 0));
         }
         
         response["estimated_size"] = formatFileSize(actualSize);
@@ -158,6 +138,11 @@ std::string BackupRouter::handleBackupCreate(const ApiRequest& request) {
             backupConfig["include_credentials"] = requestData.value("include_credentials", false);
         }
         
+        // Incremental backups default to the server configuration
+        if (requestData.contains("incremental_backup")) {
+            backupConfig["incremental"] = requestData.value("incremental_backup", false);
+        }
+        
         // Encryption settings
         bool encrypt = requestData.value("encrypt_backup", false);
         backupConfig["encrypt"] = encrypt;
@@ -176,6 +161,9 @@ std::string BackupRouter::handleBackupCreate(const ApiRequest& request) {
         // Create backup using BackupHandler
         std::string outputPath = m_backupHandler->createBackup(backupConfig);
         std::string filename = std::filesystem::path(outputPath).filename();
+        json entry;
+        m_backupHandler->findBackup(filename, entry);
+        size_t size = entry.value("size", size_t(0));
         
         // Update backup info
         json backupInfo = getBackupInfo();
@@ -184,8 +172,8 @@ std::string BackupRouter::handleBackupCreate(const ApiRequest& request) {
         newBackup["created_at"] = generateTimestamp();
         newBackup["type"] = backupType;
         newBackup["encrypted"] = encrypt;
-        newBackup["size"] = std::filesystem::file_size(outputPath);
-        newBackup["formatted_size"] = formatFileSize(std::filesystem::file_size(outputPath));
+        newBackup["size"] = size;
+        newBackup["formatted_size"] = formatFileSize(size);
         newBackup["status"] = "completed";
         newBackup["file_path"] = outputPath;
         
@@ -206,7 +194,7 @@ std::string BackupRouter::handleBackupCreate(const ApiRequest& request) {
         response["backup_id"] = filename;  // Use filename as backup_id for download
         response["message"] = "Backup created successfully";
         response["timestamp"] = generateTimestamp();
-        response["size"] = formatFileSize(std::filesystem::file_size(outputPath));
+        response["size"] = formatFileSize(size);
         response["backup_type"] = backupType;
         response["encrypted"] = encrypt;
         
@@ -236,22 +224,18 @@ std::string BackupRouter::handleBackupRestore(const ApiRequest& request) {
             return errorResponse.dump();
         }
         
-        // Parse restore request data
+        // Parse restore request data. Multipart uploads are streamed by createRestoreSink;
+        // this buffered path restores a backup that is already on the device.
         json requestData;
         std::string backupFilePath;
-        std::string password;
         
-        // For demonstration, we'll assume the backup file path is provided in the request body
-        // In a full implementation, this would handle multipart file uploads
         try {
             requestData = json::parse(request.body);
             backupFilePath = requestData.value("backup_file_path", "");
-            password = requestData.value("password", "");
         } catch (const std::exception& e) {
-            // If JSON parsing fails, assume it's a file upload - handle accordingly
             json errorResponse;
             errorResponse["success"] = false;
-            errorResponse["error"] = "File upload handling not fully implemented yet";
+            errorResponse["error"] = "Invalid restore request: expected JSON or multipart/form-data upload";
             errorResponse["timestamp"] = generateTimestamp();
             return errorResponse.dump();
         }
@@ -264,24 +248,7 @@ std::string BackupRouter::handleBackupRestore(const ApiRequest& request) {
             return errorResponse.dump();
         }
         
-        // Prepare restore configuration
-        json restoreConfig;
-        restoreConfig["validate_integrity"] = requestData.value("validate_integrity", true);
-        restoreConfig["wipe_before_restore"] = requestData.value("wipe_before_restore", false);
-        if (!password.empty()) {
-            restoreConfig["password"] = password;
-        }
-        
-        // Perform restore using BackupHandler
-        std::string result = m_backupHandler->restoreBackup(backupFilePath, restoreConfig);
-        
-        json response;
-        response["success"] = true;
-        response["message"] = "Restore completed successfully";
-        response["timestamp"] = generateTimestamp();
-        response["details"] = result;
-        
-        std::cout << "[BACKUP-ROUTER] Restore process completed successfully" << std::endl;
+        json response = performRestore(backupFilePath, requestData);
         return response.dump();
         
     } catch (const std::exception& e) {
@@ -295,6 +262,72 @@ std::string BackupRouter::handleBackupRestore(const ApiRequest& request) {
     }
 }
 
+std::unique_ptr<RequestBodySink> BackupRouter::createRestoreSink(const ApiRequest& request) {
+    std::string boundary = MultipartFileUploadSink::boundaryFromRequest(request);
+    if (boundary.empty()) {
+        return nullptr; // JSON restore requests go to handleBackupRestore
+    }
+    
+    std::cout << "[BACKUP-ROUTER] Streaming backup restore upload" << std::endl;
+    
+    std::string uploadPrefix = "restore_upload_" + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count()) + "_";
+    
+    return std::make_unique<MultipartFileUploadSink>(
+        boundary, "backup_file", getBackupDataPath() + "/temp", uploadPrefix, MAX_RESTORE_UPLOAD_SIZE,
+        [this](const MultipartFileUploadSink::Upload& upload) {
+            ApiResponse apiResponse;
+            json response;
+            try {
+                json requestData = json::object();
+                auto options = upload.fields.find("options");
+                if (options != upload.fields.end() && !options->second.empty()) {
+                    requestData = json::parse(options->second);
+                }
+                auto password = upload.fields.find("password");
+                if (password != upload.fields.end()) {
+                    requestData["password"] = password->second;
+                }
+                
+                response = performRestore(upload.file_path, requestData);
+                apiResponse.setJsonResponse(response);
+            } catch (const std::exception& e) {
+                std::cout << "[BACKUP-ROUTER] Error in restore process: " << e.what() << std::endl;
+                response["success"] = false;
+                response["error"] = e.what();
+                response["timestamp"] = generateTimestamp();
+                apiResponse.setJsonResponse(response, 500);
+            }
+            
+            std::error_code ec;
+            std::filesystem::remove(upload.file_path, ec);
+            return apiResponse;
+        });
+}
+
+json BackupRouter::performRestore(const std::string& backupFilePath, const json& requestData) {
+    // Prepare restore configuration
+    json restoreConfig;
+    restoreConfig["validate_integrity"] = requestData.value("validate_integrity", true);
+    restoreConfig["wipe_before_restore"] = requestData.value("wipe_before_restore", false);
+    std::string password = requestData.value("password", "");
+    if (!password.empty()) {
+        restoreConfig["password"] = password;
+    }
+    
+    // Perform restore using BackupHandler
+    std::string result = m_backupHandler->restoreBackup(backupFilePath, restoreConfig);
+    
+    json response;
+    response["success"] = true;
+    response["message"] = "Restore completed successfully";
+    response["timestamp"] = generateTimestamp();
+    response["details"] = result;
+    
+    std::cout << "[BACKUP-ROUTER] Restore process completed successfully" << std::endl;
+    return response;
+}
+
 std::string BackupRouter::handleBackupList(const ApiRequest& request) {
     std::cout << "[BACKUP-ROUTER] Processing backup list request" << std::endl;
     
@@ -303,12 +336,10 @@ std::string BackupRouter::handleBackupList(const ApiRequest& request) {
         response["success"] = true;
         response["timestamp"] = generateTimestamp();
         
-        // Get backup files from filesystem
-        std::vector<std::string> backupFiles = getBackupFiles();
+        // From the backup catalog, newest first
         json backupList = json::array();
-        
-        for (const auto& filePath : backupFiles) {
-            backupList.push_back(createBackupListItem(filePath));
+        for (const auto& entry : m_backupHandler->listBackups()) {
+            backupList.push_back(createBackupListItem(entry));
         }
         
         response["backups"] = backupList;
@@ -352,9 +383,8 @@ std::string BackupRouter::handleBackupDownload(const ApiRequest& request) {
             return errorResponse.dump();
         }
         
-        std::string backupPath = getBackupDataPath() + "/" + backupFilename;
-        
-        if (!std::filesystem::exists(backupPath)) {
+        json entry;
+        if (!m_backupHandler->findBackup(backupFilename, entry)) {
             json errorResponse;
             errorResponse["success"] = false;
             errorResponse["error"] = "Backup file not found: " + backupFilename;
@@ -368,8 +398,8 @@ std::string BackupRouter::handleBackupDownload(const ApiRequest& request) {
         response["success"] = true;
         response["message"] = "File ready for download";
         response["filename"] = backupFilename;
-        response["file_path"] = backupPath;
-        response["file_size"] = std::filesystem::file_size(backupPath);
+        response["file_path"] = entry.value("file_path", "");
+        response["file_size"] = entry.value("size", size_t(0));
         response["content_type"] = "application/octet-stream";
         response["timestamp"] = generateTimestamp();
         
@@ -387,6 +417,15 @@ std::string BackupRouter::handleBackupDownload(const ApiRequest& request) {
     }
 }
 
+std::string BackupRouter::resolveBackupDownload(const std::string& backupId) {
+    json entry;
+    if (backupId.empty() || !m_backupHandler->findBackup(backupId, entry)) {
+        std::cout << "[BACKUP-ROUTER] Download requested for unknown backup: " << backupId << std::endl;
+        return "";
+    }
+    return entry.value("file_path", "");
+}
+
 std::string BackupRouter::handleBackupDelete(const ApiRequest& request) {
     std::cout << "[BACKUP-ROUTER] Processing backup delete request" << std::endl;
     
@@ -408,10 +447,8 @@ std::string BackupRouter::handleBackupDelete(const ApiRequest& request) {
             return errorResponse.dump();
         }
         
-        // Find and delete backup file
-        std::string backupPath = getBackupDataPath() + "/" + backupFilename;
-        if (std::filesystem::exists(backupPath)) {
-            std::filesystem::remove(backupPath);
+        // Only catalogued backups can be deleted
+        if (m_backupHandler->deleteBackup(backupFilename)) {
             
             json response;
             response["success"] = true;
@@ -669,74 +706,24 @@ json BackupRouter::getBackupConfiguration() {
     return json{};
 }
 
-std::vector<std::string> BackupRouter::getBackupFiles() {
-    std::vector<std::string> backupFiles;
-    std::string backupDir = getBackupDataPath();
-    
-    try {
-        if (std::filesystem::exists(backupDir)) {
-            for (const auto& entry : std::filesystem::directory_iterator(backupDir)) {
-                if (entry.is_regular_file()) {
-                    std::string filename = entry.path().filename();
-                    if (filename.size() >= 4 && filename.substr(filename.size() - 4) == ".uhb" || 
-                        filename.size() >= 8 && filename.substr(filename.size() - 8) == ".uhb.enc") {
-                        backupFiles.push_back(entry.path().string());
-                    }
-                }
-            }
-        }
-    } catch (const std::exception& e) {
-        std::cout << "[BACKUP-ROUTER] Error scanning backup directory: " << e.what() << std::endl;
-    }
-    
-    return backupFiles;
-}
-
-json BackupRouter::createBackupListItem(const std::string& filePath) {
+json BackupRouter::createBackupListItem(const json& entry) {
     json item;
+    std::string filename = entry.value("filename", "");
     
-    try {
-        std::filesystem::path path(filePath);
-        std::string filename = path.filename();
-        
-        item["id"] = filename;
-        item["filename"] = filename;
-        item["file_path"] = filePath;
-        item["size"] = std::filesystem::file_size(filePath);
-        item["formatted_size"] = formatFileSize(std::filesystem::file_size(filePath));
-        
-        // Extract backup type from filename
-        if (filename.find("_full_") != std::string::npos) {
-            item["type"] = "full";
-        } else if (filename.find("_partial_") != std::string::npos) {
-            item["type"] = "partial";
-        } else if (filename.find("_network_config_") != std::string::npos) {
-            item["type"] = "network_config";
-        } else if (filename.find("_license_") != std::string::npos) {
-            item["type"] = "license";
-        } else if (filename.find("_authentication_") != std::string::npos) {
-            item["type"] = "authentication";
-        } else {
-            item["type"] = "unknown";
-        }
-        
-        item["encrypted"] = filename.size() >= 4 && filename.substr(filename.size() - 4) == ".enc";
-        item["status"] = "completed";
-        
-        // Extract creation date from filename
-        auto lastWriteTime = std::filesystem::last_write_time(filePath);
-        auto timeT = std::chrono::duration_cast<std::chrono::seconds>(lastWriteTime.time_since_epoch()).count();
-        std::time_t time = static_cast<std::time_t>(timeT);
-        
-        std::stringstream ss;
-        ss << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S");
-        item["created_at"] = ss.str();
-        
-    } catch (const std::exception& e) {
-        std::cout << "[BACKUP-ROUTER] Error creating backup list item: " << e.what() << std::endl;
-        item["id"] = "error";
-        item["filename"] = "Error reading file";
-        item["error"] = e.what();
+    item["id"] = filename;
+    item["filename"] = filename;
+    item["file_path"] = entry.value("file_path", "");
+    item["size"] = entry.value("size", size_t(0));
+    item["formatted_size"] = formatFileSize(entry.value("size", size_t(0)));
+    item["type"] = entry.value("type", "unknown");
+    item["encrypted"] = entry.value("encrypted", false);
+    item["incremental"] = entry.value("incremental", false);
+    item["file_count"] = entry.value("file_count", 0);
+    item["validation"] = entry.value("validation", "unverified");
+    item["status"] = "completed";
+    item["created_at"] = entry.value("created_at", "");
+    if (entry.contains("error")) {
+        item["error"] = entry["error"];
     }
     
     return item;
@@ -2,6 +2,7 @@
 #pragma once
 
 #include "api_request.h"
+#include "request_body_sink.h"
 #include "../backup-restore/backup_handler.h"
 #include <string>
 #include <nlohmann/json.hpp>
@@ -19,14 +20,21 @@ public:
     std::string handleBackupRestore(const ApiRequest& request);
     std::string handleBackupList(const ApiRequest& request);
     std::string handleBackupDownload(const ApiRequest& request);
+    // Catalogued file behind a download, empty when there is no such backup
+    std::string resolveBackupDownload(const std::string& backupId);
     std::string handleBackupDelete(const ApiRequest& request);
     std::string handleBackupValidate(const ApiRequest& request);
     std::string handleBackupConfig(const ApiRequest& request);
     
+    // Streaming restore: multipart "backup_file" upload written straight to storage
+    std::unique_ptr<RequestBodySink> createRestoreSink(const ApiRequest& request);
+    
 // Public method for accessing backup configuration
     json getBackupConfiguration();
 
 private:
+    static constexpr size_t MAX_RESTORE_UPLOAD_SIZE = 1024ULL * 1024 * 1024; // 1GB
+    
     std::unique_ptr<BackupHandler> m_backupHandler;
     
     // Utility methods
@@ -38,9 +46,9 @@ private:
     bool updateBackupInfo(const json& info);
     
     // Helper methods
+    json performRestore(const std::string& backupFilePath, const json& requestData);
     std::string getBackupDataPath();
-    std::vector<std::string> getBackupFiles();
-    json createBackupListItem(const std::string& filePath);
+    json createBackupListItem(const json& entry);
     std::string calculateDirectorySize(const std::string& path, const json& options);
     bool createBackupFile(const json& options, const std::string& outputPath);
     bool extractBackupFile(const std::string& backupPath, const json& options);
@@ -10,11 +10,128 @@
 #include "../firmware-update/manual_upload_handler.h"
 #include "../sysupgrade-mecanism/sysupgrade_handler.h"
 #include "../multipart_parser.h"
+#include "../multipart_upload_sink.h"
 #include "endpoint_logger.h"
+#include "event_bus.h"
 #include <filesystem>
 
 using json = nlohmann::json;
 
+namespace {
+
+// Streams a multipart firmware upload straight into a ManualUploadSession so
+// the image is never buffered in memory.
+class ManualUploadSink : public RequestBodySink {
+public:
+    ManualUploadSink(FirmwareUpdate::ManualUploadHandler& handler, const std::string& boundary)
+        : handler_(handler), parser_(boundary), in_file_part_(false) {
+        parser_.onPartBegin([this](const MultipartPartInfo& part) {
+            in_file_part_ = false;
+            if (!part.isFile() || session_) {
+                return true; // Form fields and extra files are ignored
+            }
+
+            filename_ = std::string(part.filename);
+            std::cout << "[FIRMWARE-ROUTER] Streaming file upload: " << filename_ << std::endl;
+
+            session_ = handler_.beginUpload(filename_, "application/octet-stream", false, error_);
+            in_file_part_ = (session_ != nullptr);
+            return in_file_part_;
+        });
+        parser_.onPartData([this](std::string_view data) {
+            if (!in_file_part_) {
+                return true;
+            }
+            if (!session_->write(data.data(), data.size())) {
+                error_ = session_->getError();
+                return false;
+            }
+            return true;
+        });
+        parser_.onPartEnd([this]() {
+            in_file_part_ = false;
+            return true;
+        });
+    }
+
+    bool consume(const char* data, size_t size) override {
+        if (!parser_.feed(data, size)) {
+            if (error_.empty()) {
+                error_ = "Invalid multipart data: " + parser_.getError();
+            }
+            return false;
+        }
+        return true;
+    }
+
+    ApiResponse finish() override {
+        ApiResponse response;
+        json json_response;
+        json_response["timestamp"] = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()
+        ).count();
+
+        if (!parser_.finish()) {
+            error_ = "Invalid multipart data: " + parser_.getError();
+        } else if (!session_) {
+            error_ = "No file data found in upload";
+        }
+
+        std::string upload_id;
+        if (error_.empty()) {
+            upload_id = session_->commit();
+            if (upload_id.empty()) {
+                error_ = "Failed to upload file - " + session_->getError();
+            }
+        }
+
+        if (!error_.empty()) {
+            abort();
+            json_response["success"] = false;
+            json_response["error"] = error_;
+            std::cout << "[FIRMWARE-ROUTER] Manual upload failed: " << error_ << std::endl;
+            response.setJsonResponse(json_response, 400);
+            return response;
+        }
+
+        json_response["success"] = true;
+        json_response["message"] = "File uploaded successfully";
+        json_response["upload_id"] = upload_id;
+        json_response["status"] = "completed";
+        json_response["filename"] = filename_;
+        json_response["file_size"] = session_->getBytesWritten();
+        json_response["file_type"] = "application/octet-stream";
+        std::cout << "[FIRMWARE-ROUTER] Manual upload successful: " << upload_id << std::endl;
+        response.setJsonResponse(json_response);
+        return response;
+    }
+
+    void abort() override {
+        if (session_) {
+            session_->abort();
+        }
+    }
+
+    ApiResponse errorResponse() const override {
+        ApiResponse response;
+        json json_response;
+        json_response["success"] = false;
+        json_response["error"] = error_.empty() ? "Upload rejected" : error_;
+        response.setJsonResponse(json_response, 400);
+        return response;
+    }
+
+private:
+    FirmwareUpdate::ManualUploadHandler& handler_;
+    MultipartStreamParser parser_;
+    std::unique_ptr<FirmwareUpdate::ManualUploadSession> session_;
+    std::string filename_;
+    std::string error_;
+    bool in_file_part_;
+};
+
+} // namespace
+
 FirmwareRouter::FirmwareRouter() :
     tftp_client(std::make_unique<FirmwareUpdate::TftpClient>()),
     manual_upload_handler(std::make_unique<FirmwareUpdate::ManualUploadHandler>()),
@@ -24,6 +141,16 @@ FirmwareRouter::FirmwareRouter() :
     sysupgrade_manager->setProgressCallback([this](const SysupgradeHandler::UpgradeProgress& progress) {
         // Progress callback will automatically update the JSON file
         ENDPOINT_LOG_INFO("firmware", "Sysupgrade progress updated: " + std::to_string(progress.progress_percentage) + "%");
+
+        // Push the same document /api/firmware/progress returns
+        nlohmann::json event = nlohmann::json::parse(SysupgradeHandler::progressToJson(progress), nullptr, false);
+        if (!event.is_discarded()) {
+            event["success"] = true;
+            event["timestamp"] = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()
+            ).count();
+            EventBus::getInstance().publish("firmware.sysupgrade", event);
+        }
     });
 
     sysupgrade_manager->setCompletionCallback([this](bool success, const std::string& message) {
@@ -152,6 +279,24 @@ void FirmwareRouter::registerRoutes(std::function<void(const std::string&, Route
     std::cout << "FirmwareRouter: All firmware routes registered successfully" << std::endl;
 }
 
+void FirmwareRouter::registerStreamingRoutes(std::function<void(const std::string&, StreamingRouteFactory)> addStreamingRouteHandler) {
+    // POST bodies on this path bypass the buffered handler registered in registerRoutes
+    addStreamingRouteHandler("/api/firmware/manual/upload", [this](const ApiRequest& request) {
+        return this->createManualUploadSink(request);
+    });
+}
+
+std::unique_ptr<RequestBodySink> FirmwareRouter::createManualUploadSink(const ApiRequest& request) {
+    std::string boundary = MultipartFileUploadSink::boundaryFromRequest(request);
+    if (boundary.empty()) {
+        std::cout << "[FIRMWARE-ROUTER] Non-multipart manual upload, using buffered handler" << std::endl;
+        return nullptr;
+    }
+
+    std::cout << "[FIRMWARE-ROUTER] Processing streaming manual upload, boundary: " << boundary << std::endl;
+    return std::make_unique<ManualUploadSink>(*manual_upload_handler, boundary);
+}
+
 std::string FirmwareRouter::handleFirmwareStatus(const ApiRequest& request) {
     std::cout << "[FIRMWARE-ROUTER] Processing firmware status request, method: " << request.method << std::endl;
 
@@ -459,9 +604,11 @@ std::string FirmwareRouter::handleTftpDownload(const ApiRequest& request) {
                 return json_response.dump();
             }
 
-            // Start TFTP download in a separate thread
-            std::thread download_thread([this, server_ip, port, filename]() {
-                std::string result = performTftpDownload(server_ip, port, filename);
+            // Start TFTP download in a separate thread; the id lets the client
+            // pick this download's progress events out of the stream
+            std::string download_id = "tftp_" + generateTimestamp();
+            std::thread download_thread([this, download_id, server_ip, port, filename]() {
+                std::string result = performTftpDownload(download_id, server_ip, port, filename);
                 if (!result.empty()) {
                     std::cout << "[FIRMWARE-ROUTER] TFTP download error: " << result << std::endl;
                 }
@@ -470,7 +617,7 @@ std::string FirmwareRouter::handleTftpDownload(const ApiRequest& request) {
 
             json_response["message"] = "TFTP download initiated";
             json_response["status"] = "downloading";
-            json_response["download_id"] = "tftp_" + generateTimestamp();
+            json_response["download_id"] = download_id;
         } else {
             json_response["success"] = false;
             json_response["error"] = "Only POST method supported";
@@ -550,10 +697,10 @@ std::string FirmwareRouter::performTftpConnectionTest(const std::string& server_
     }
 }
 
-std::string FirmwareRouter::performTftpDownload(const std::string& server_ip, uint16_t port, const std::string& filename) {
+std::string FirmwareRouter::performTftpDownload(const std::string& download_id, const std::string& server_ip,
+                                                uint16_t port, const std::string& filename) {
     std::cout << "[FIRMWARE-ROUTER] Starting TFTP download: " << filename << " from " << server_ip << ":" << port << std::endl;
 
-    std::string download_id = "tftp_" + generateTimestamp();
     auto start_time = std::chrono::steady_clock::now();
 
     // Initialize download progress
@@ -701,6 +848,9 @@ void FirmwareRouter::updateDownloadProgress(const std::string& download_id, cons
             out_file.close();
         }
 
+        progress_data["success"] = true;
+        EventBus::getInstance().publish("firmware.tftp", progress_data);
+
         std::cout << "[FIRMWARE-ROUTER] Download Progress: " << status << " (" << percentage << "%) - "
                   << bytes_downloaded << "/" << total_bytes << " bytes" << std::endl;
     } catch (const std::exception& e) {
@@ -728,53 +878,26 @@ std::string FirmwareRouter::handleManualUpload(const ApiRequest& request) {
 
                 std::cout << "[FIRMWARE-ROUTER] Detected multipart form data upload" << std::endl;
 
-                // Extract boundary from body (first line typically contains boundary)
-                size_t boundary_start = request_body.find("------");
-                if (boundary_start == std::string::npos) {
+                // Buffered handlers do not see the Content-Type header; the body's first line is "--boundary"
+                size_t boundary_end = request_body.find("\r\n");
+                if (request_body.compare(0, 2, "--") != 0 || boundary_end == std::string::npos || boundary_end <= 2) {
                     json_response["success"] = false;
                     json_response["error"] = "Invalid multipart data: no boundary found";
                     return json_response.dump();
                 }
 
-                size_t boundary_end = request_body.find('\n', boundary_start);
-                if (boundary_end == std::string::npos) boundary_end = request_body.find('\r', boundary_start);
-                std::string boundary = request_body.substr(boundary_start, boundary_end - boundary_start);
-
+                std::string boundary = request_body.substr(2, boundary_end - 2);
                 std::cout << "[FIRMWARE-ROUTER] Using boundary: " << boundary << std::endl;
 
-                // Parse multipart form data manually
-                size_t file_data_start = request_body.find("\r\n\r\n");
-                if (file_data_start == std::string::npos) {
-                    file_data_start = request_body.find("\n\n");
-                }
-
-                if (file_data_start == std::string::npos) {
+                MultipartParser multipart("multipart/form-data; boundary=" + boundary);
+                if (!multipart.parse(request_body) || multipart.getFiles().empty()) {
                     json_response["success"] = false;
                     json_response["error"] = "Invalid multipart data: no file content found";
                     return json_response.dump();
                 }
 
-                file_data_start += 4; // Skip past \r\n\r\n or \n\n
-
-                // Find end of file data
-                size_t file_data_end = request_body.find(boundary, file_data_start);
-                if (file_data_end == std::string::npos) {
-                    json_response["success"] = false;
-                    json_response["error"] = "Invalid multipart data: no end boundary found";
-                    return json_response.dump();
-                }
-
-                // Extract file data
-                std::vector<uint8_t> file_data;
-                std::string file_content = request_body.substr(file_data_start, file_data_end - file_data_start);
-
-                // Remove trailing newlines/carriage returns
-                while (!file_content.empty() && (file_content.back() == '\n' || file_content.back() == '\r')) {
-                    file_content.pop_back();
-                }
-
-                // Convert to vector
-                file_data.assign(file_content.begin(), file_content.end());
+                std::shared_ptr<MultipartFile> upload = multipart.getFiles().front();
+                const std::vector<uint8_t>& file_data = upload->data;
 
                 std::cout << "[FIRMWARE-ROUTER] Extracted file data: " << file_data.size() << " bytes" << std::endl;
 
@@ -784,16 +907,7 @@ std::string FirmwareRouter::handleManualUpload(const ApiRequest& request) {
                     return json_response.dump();
                 }
 
-                // Extract filename from Content-Disposition header
-                std::string filename = "firmware.bin"; // Default filename
-                size_t filename_pos = request_body.find("filename=\"");
-                if (filename_pos != std::string::npos) {
-                    filename_pos += 10; // Skip 'filename="'
-                    size_t filename_end = request_body.find("\"", filename_pos);
-                    if (filename_end != std::string::npos) {
-                        filename = request_body.substr(filename_pos, filename_end - filename_pos);
-                    }
-                }
+                std::string filename = upload->filename.empty() ? "firmware.bin" : upload->filename;
 
                 std::cout << "[FIRMWARE-ROUTER] Processing file upload: " << filename
                           << " (" << file_data.size() << " bytes)" << std::endl;
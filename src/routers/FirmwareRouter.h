@@ -6,6 +6,7 @@
 #include <map>
 #include <memory>
 #include "api_request.h"
+#include "request_body_sink.h"
 
 // Forward declarations
 namespace FirmwareUpdate {
@@ -27,6 +28,9 @@ public:
     // Register all firmware routes
     void registerRoutes(std::function<void(const std::string&, RouteHandler)> addRouteHandler);
     
+    // Register routes whose request body is streamed (manual firmware upload)
+    void registerStreamingRoutes(std::function<void(const std::string&, StreamingRouteFactory)> addStreamingRouteHandler);
+    
     // Firmware status endpoint
     std::string handleFirmwareStatus(const ApiRequest& request);
     
@@ -46,6 +50,7 @@ public:
     
     // Manual upload operations
     std::string handleManualUpload(const ApiRequest& request);
+    std::unique_ptr<RequestBodySink> createManualUploadSink(const ApiRequest& request);
     std::string handleManualUploadList(const ApiRequest& request);
     std::string handleManualUploadInfo(const ApiRequest& request);
     
@@ -62,7 +67,8 @@ private:
     
     // TFTP helper methods
     std::string performTftpConnectionTest(const std::string& server_ip, uint16_t port);
-    std::string performTftpDownload(const std::string& server_ip, uint16_t port, const std::string& filename);
+    std::string performTftpDownload(const std::string& download_id, const std::string& server_ip,
+                                    uint16_t port, const std::string& filename);
     void initializeDownloadProgress(const std::string& download_id, const std::string& filename, 
                                    const std::string& server_ip, uint16_t port);
     void updateDownloadProgress(const std::string& download_id, const std::string& status, 
@@ -1,9 +1,9 @@
 #include "LicenseRouter.h"
 #include <iostream>
-#include <fstream>
 #include <chrono>
 #include <filesystem>
 #include "license_data_structure.h"
+#include "json_document_store.h"
 #include "../include/api_request.h" // Assuming this header is still needed for general API utilities
 
 using json = nlohmann::json;
@@ -78,17 +78,9 @@ void LicenseRouter::logLicenseEvent(const std::string& event_type, const std::st
 // Helper function to load JSON from file
 json LicenseRouter::loadJsonFromFile(const std::string& filename) {
     std::string filepath = data_directory + filename;
-    std::ifstream file(filepath);
-    if (!file.is_open()) {
-        std::cerr << "[LICENSE] Failed to open file: " << filepath << std::endl;
-        return json::object();
-    }
-
     json data;
-    try {
-        file >> data;
-    } catch (const std::exception& e) {
-        std::cerr << "[LICENSE] JSON parse error in " << filepath << ": " << e.what() << std::endl;
+    if (!JsonDocumentStore::getInstance().read(filepath, data)) {
+        std::cerr << "[LICENSE] Failed to open or parse file: " << filepath << std::endl;
         return json::object();
     }
     return data;
@@ -98,19 +90,11 @@ json LicenseRouter::loadJsonFromFile(const std::string& filename) {
 bool LicenseRouter::saveJsonToFile(const std::string& filename, const json& data) {
     std::string filepath = data_directory + filename;
 
-    std::ofstream file(filepath);
-    if (!file.is_open()) {
+    if (!JsonDocumentStore::getInstance().write(filepath, data, 2)) {
         std::cerr << "[LICENSE] Failed to open file for writing: " << filepath << std::endl;
         return false;
     }
-
-    try {
-        file << data.dump(2);
-        return true;
-    } catch (const std::exception& e) {
-        std::cerr << "[LICENSE] JSON write error to " << filepath << ": " << e.what() << std::endl;
-        return false;
-    }
+    return true;
 }
 
 // Initialize default license files if they don't exist
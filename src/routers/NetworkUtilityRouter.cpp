@@ -1,5 +1,8 @@
 #include "NetworkUtilityRouter.h"
 #include "endpoint_logger.h"
+#include "netlink_state_engine.h"
+#include "event_bus.h"
+#include "dns_engine.h"
 #include <chrono>
 #include <thread>
 #include <fstream>
@@ -7,16 +10,13 @@
 #include <regex>
 #include <cstdlib>
 #include <unistd.h>
-#include <sys/wait.h>
+#include <sys/utsname.h>
 #include <numeric>
 #include <cmath>
 #include <iomanip>
 #include <algorithm>
 #include <mutex>
 
-// Global mutex for thread safety
-static std::mutex traceroute_mutex;
-
 NetworkUtilityRouter::NetworkUtilityRouter() {
     ENDPOINT_LOG("network-utility", "NetworkUtilityRouter initializing...");
 
@@ -222,6 +222,18 @@ void NetworkUtilityRouter::registerRoutes(std::function<void(const std::string&,
         }
     });
 
+    registerFunc("/api/network-utility/servers/test-all", [this](const std::string& method, const std::map<std::string, std::string>& params, const std::string& body) {
+        if (method != "POST") {
+            return json{{"success", false}, {"message", "Method not allowed"}}.dump();
+        }
+        try {
+            json requestData = body.empty() ? json::object() : json::parse(body);
+            return handleTestAllServers(requestData);
+        } catch (const std::exception& e) {
+            return json{{"success", false}, {"message", "Invalid JSON"}}.dump();
+        }
+    });
+
     // System info routes
     registerFunc("/api/network-utility/system/info", [this](const std::string& method, const std::map<std::string, std::string>& params, const std::string& body) {
         if (method != "GET") {
@@ -308,10 +320,23 @@ std::string NetworkUtilityRouter::handleStartBandwidthTest(const json& requestDa
 
         // Start test with progress callback
         std::string testId = bandwidthEngine_->startBandwidthTest(config, 
-            [this](const BandwidthUtilityEngine::RealtimeUpdate& update) {
-                // Update active tests for compatibility
-                // This allows frontend to get real-time updates
+            [](const BandwidthUtilityEngine::RealtimeUpdate& update) {
                 ENDPOINT_LOG("network-utility", "Bandwidth progress: " + std::to_string(update.progress) + "% - " + update.phase);
+
+                // The status endpoint's testData fields, tagged with the test id
+                bool running = update.phase != "complete" && update.phase != "stopped" && update.phase != "error";
+                EventBus::getInstance().publish("network-utility.bandwidth", json{
+                    {"testId", update.testId},
+                    {"downloadSpeed", update.currentMbps},
+                    {"uploadSpeed", 0.0},
+                    {"latency", 0.0},
+                    {"progress", update.progress},
+                    {"isRunning", running},
+                    {"phase", update.phase},
+                    {"bytesTransferred", static_cast<uint64_t>(update.totalDataMB * 1024 * 1024)},
+                    {"testDuration", update.elapsedSeconds},
+                    {"intervalData", update.intervalData}
+                });
             });
 
         if (testId.empty()) {
@@ -319,13 +344,16 @@ std::string NetworkUtilityRouter::handleStartBandwidthTest(const json& requestDa
         }
 
         // Store in activeTests for compatibility with existing frontend
-        TestState& state = activeTests[testId];
-        state.isRunning = true;
-        state.testType = "bandwidth";
-        state.startTime = std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
-            std::chrono::system_clock::now().time_since_epoch()).count());
-        state.configuration = requestData;
-        state.progress = 0;
+        {
+            std::lock_guard<std::mutex> lock(activeTestsMutex_);
+            TestState& state = activeTests[testId];
+            state.isRunning = true;
+            state.testType = "bandwidth";
+            state.startTime = std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count());
+            state.configuration = requestData;
+            state.progress = 0;
+        }
 
         json response = {
             {"success", true},
@@ -353,14 +381,23 @@ std::string NetworkUtilityRouter::handleStartBandwidthTest(const json& requestDa
 std::string NetworkUtilityRouter::handleStopBandwidthTest() {
     ENDPOINT_LOG("network-utility", "Stopping bandwidth test");
 
-    // Kill any running iperf3 processes
-    system("pkill -f iperf3");
+    // Mark all bandwidth tests as stopped; the engine terminates only its own iperf3 runs
+    std::vector<std::string> stopped;
+    {
+        std::lock_guard<std::mutex> lock(activeTestsMutex_);
+        for (auto& test : activeTests) {
+            if (test.second.testType == "bandwidth" && test.second.isRunning) {
+                test.second.isRunning = false;
+                test.second.results = "Test stopped by user";
+                stopped.push_back(test.first);
+            }
+        }
+    }
 
-    // Mark all bandwidth tests as stopped
-    for (auto& test : activeTests) {
-        if (test.second.testType == "bandwidth" && test.second.isRunning) {
-            test.second.isRunning = false;
-            test.second.results = "Test stopped by user";
+    // Stopping waits for iperf3 to exit, so not under the lock
+    if (bandwidthEngine_) {
+        for (const auto& testId : stopped) {
+            bandwidthEngine_->stopBandwidthTest(testId);
         }
     }
 
@@ -423,6 +460,7 @@ std::string NetworkUtilityRouter::handleGetBandwidthTestStatus() {
             std::chrono::system_clock::now().time_since_epoch()).count()}
     };
 
+    std::lock_guard<std::mutex> lock(activeTestsMutex_);
     for (const auto& test : activeTests) {
         if (test.second.testType == "bandwidth") {
             json testInfo = {
@@ -504,141 +542,136 @@ std::string NetworkUtilityRouter::handleStartPingTest(const json& requestData) {
     }
 
     // Build ping command with validated parameters
-    std::ostringstream cmd;
-    cmd << "ping -c " << (continuous ? "0" : std::to_string(count));
-    cmd << " -s " << packetSize;
-    cmd << " -i " << interval;
-    cmd << " -W " << timeout;
-    cmd << " " << safeHost;
+    std::ostringstream intervalArg;
+    intervalArg << interval;
+    std::vector<std::string> argv = {
+        "ping",
+        "-c", continuous ? "0" : std::to_string(count),
+        "-s", std::to_string(packetSize),
+        "-i", intervalArg.str(),
+        "-W", std::to_string(timeout),
+        safeHost
+    };
 
-    // Store test state
-    TestState& state = activeTests[testId];
-    state.isRunning = true;
-    state.testType = "ping";
-    state.startTime = std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
-        std::chrono::system_clock::now().time_since_epoch()).count());
-    state.configuration = requestData;
-    state.progress = 0;
-    state.realTimeResults = json::array();
+    // Output is parsed on the process engine's reactor thread as it arrives
+    ProcessEngine::Options options;
+    options.argv = std::move(argv);
 
-    // Execute command in background thread with real-time parsing
-    std::string cmdStr = cmd.str();
-    std::thread([this, testId, cmdStr, count, continuous]() {
-        try {
-            auto testIt = activeTests.find(testId);
-            if (testIt == activeTests.end()) return;
-
-            FILE* pipe = popen((cmdStr + " 2>&1").c_str(), "r");
-            if (!pipe) {
-                testIt->second.isRunning = false;
-                testIt->second.results = "Error: Could not execute ping command";
-                return;
-            }
+    // Store test state
+    {
+        std::lock_guard<std::mutex> lock(activeTestsMutex_);
+        TestState& state = activeTests[testId];
+        state.isRunning = true;
+        state.testType = "ping";
+        state.startTime = std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+        state.configuration = requestData;
+        state.progress = 0;
+        state.realTimeResults = json::array();
+        options.cancel = state.cancel;
+    }
+    if (!continuous) {
+        options.timeout = std::chrono::milliseconds(static_cast<int64_t>(count * (interval + timeout) * 1000) + 30000);
+    }
 
-            char buffer[1024];
-            std::string line;
-            int sequenceNum = 0;
-            int totalPackets = continuous ? 0 : count;
-
-            // Regex patterns for parsing ping output
-            std::regex pingRegex(R"(64 bytes from .+?: icmp_seq=(\d+) ttl=(\d+) time=([0-9.]+) ms)");
-            std::regex timeoutRegex(R"(no answer yet for icmp_seq=(\d+))");
-            std::smatch match;
-
-            while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-                testIt = activeTests.find(testId);
-                if (testIt == activeTests.end() || !testIt->second.isRunning) {
-                    break;
-                }
+    int totalPackets = continuous ? 0 : count;
+    options.on_line = [this, testId, totalPackets, sequenceNum = 0](const std::string& line) mutable {
+        // Regex patterns for parsing ping output
+        static const std::regex pingRegex(R"(64 bytes from .+?: icmp_seq=(\d+) ttl=(\d+) time=([0-9.]+) ms)");
+        static const std::regex timeoutRegex(R"(no answer yet for icmp_seq=(\d+))");
+        std::smatch match;
 
-                line = std::string(buffer);
-                line.erase(std::remove(line.begin(), line.end(), '\n'), line.end());
+        std::lock_guard<std::mutex> lock(activeTestsMutex_);
+        auto testIt = activeTests.find(testId);
+        if (testIt == activeTests.end() || !testIt->second.isRunning || line.empty()) {
+            return;
+        }
 
-                if (line.empty()) continue;
+        // Parse successful ping response
+        if (std::regex_search(line, match, pingRegex)) {
+            try {
+                int seq = std::stoi(match[1].str());
+                int ttl = std::stoi(match[2].str());
+                double rtt = std::stod(match[3].str());
+
+                json pingResult = {
+                    {"sequence", seq},
+                    {"ttl", ttl},
+                    {"rtt", rtt},
+                    {"status", "success"},
+                    {"timestamp", std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::system_clock::now().time_since_epoch()).count()}
+                };
 
-                // Parse successful ping response
-                if (std::regex_search(line, match, pingRegex)) {
-                    try {
-                        int seq = std::stoi(match[1].str());
-                        int ttl = std::stoi(match[2].str());
-                        double rtt = std::stod(match[3].str());
-
-                        json pingResult = {
-                            {"sequence", seq},
-                            {"ttl", ttl},
-                            {"rtt", rtt},
-                            {"status", "success"},
-                            {"timestamp", std::chrono::duration_cast<std::chrono::milliseconds>(
-                                std::chrono::system_clock::now().time_since_epoch()).count()}
-                        };
-
-                        testIt->second.realTimeResults.push_back(pingResult);
-                        sequenceNum = std::max(sequenceNum, seq);
-
-                        // Update progress
-                        if (totalPackets > 0) {
-                            testIt->second.progress = std::min(100, (sequenceNum * 100) / totalPackets);
-                        } else {
-                            testIt->second.progress = std::min(99, sequenceNum * 10); // Continuous mode
-                        }
+                testIt->second.realTimeResults.push_back(pingResult);
+                sequenceNum = std::max(sequenceNum, seq);
 
-                    } catch (const std::exception& e) {
-                        ENDPOINT_LOG("network-utility", "Error parsing ping response: " + std::string(e.what()));
-                    }
+                // Update progress
+                if (totalPackets > 0) {
+                    testIt->second.progress = std::min(100, (sequenceNum * 100) / totalPackets);
+                } else {
+                    testIt->second.progress = std::min(99, sequenceNum * 10); // Continuous mode
                 }
-                // Parse timeout/no response
-                else if (std::regex_search(line, match, timeoutRegex)) {
-                    try {
-                        int seq = std::stoi(match[1].str());
-
-                        json pingResult = {
-                            {"sequence", seq},
-                            {"ttl", 0},
-                            {"rtt", -1},
-                            {"status", "timeout"},
-                            {"timestamp", std::chrono::duration_cast<std::chrono::milliseconds>(
-                                std::chrono::system_clock::now().time_since_epoch()).count()}
-                        };
-
-                        testIt->second.realTimeResults.push_back(pingResult);
-                        sequenceNum = std::max(sequenceNum, seq);
-
-                        // Update progress
-                        if (totalPackets > 0) {
-                            testIt->second.progress = std::min(100, (sequenceNum * 100) / totalPackets);
-                        }
+                publishTestUpdate(testId);
 
-                    } catch (const std::exception& e) {
-                        ENDPOINT_LOG("network-utility", "Error parsing ping timeout: " + std::string(e.what()));
-                    }
-                }
+            } catch (const std::exception& e) {
+                ENDPOINT_LOG("network-utility", "Error parsing ping response: " + std::string(e.what()));
             }
+        }
+        // Parse timeout/no response
+        else if (std::regex_search(line, match, timeoutRegex)) {
+            try {
+                int seq = std::stoi(match[1].str());
+
+                json pingResult = {
+                    {"sequence", seq},
+                    {"ttl", 0},
+                    {"rtt", -1},
+                    {"status", "timeout"},
+                    {"timestamp", std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::system_clock::now().time_since_epoch()).count()}
+                };
 
-            pclose(pipe);
-
-            // Final update
-            testIt = activeTests.find(testId);
-            if (testIt != activeTests.end()) {
-                testIt->second.isRunning = false;
-                testIt->second.progress = 100;
+                testIt->second.realTimeResults.push_back(pingResult);
+                sequenceNum = std::max(sequenceNum, seq);
 
-                // Store formatted results as backup
-                if (!testIt->second.realTimeResults.empty()) {
-                    testIt->second.results = testIt->second.realTimeResults.dump(2);
-                } else {
-                    testIt->second.results = "[]";
+                // Update progress
+                if (totalPackets > 0) {
+                    testIt->second.progress = std::min(100, (sequenceNum * 100) / totalPackets);
                 }
-            }
+                publishTestUpdate(testId);
 
-        } catch (const std::exception& e) {
-            ENDPOINT_LOG("network-utility", "Fatal error in ping execution: " + std::string(e.what()));
-            auto testIt = activeTests.find(testId);
-            if (testIt != activeTests.end()) {
-                testIt->second.isRunning = false;
-                testIt->second.results = "Error: " + std::string(e.what());
+            } catch (const std::exception& e) {
+                ENDPOINT_LOG("network-utility", "Error parsing ping timeout: " + std::string(e.what()));
             }
         }
-    }).detach();
+    };
+
+    options.on_exit = [this, testId](const ProcessEngine::Result& exit) {
+        std::lock_guard<std::mutex> lock(activeTestsMutex_);
+        auto testIt = activeTests.find(testId);
+        if (testIt == activeTests.end()) {
+            return;
+        }
+
+        // Final update
+        testIt->second.isRunning = false;
+        testIt->second.progress = 100;
+
+        if (!exit.error.empty()) {
+            testIt->second.results = "Error: Could not execute ping command (" + exit.error + ")";
+        } else if (exit.cancelled) {
+            testIt->second.results = "Test stopped by user";
+        } else if (!testIt->second.realTimeResults.empty()) {
+            // Store formatted results as backup
+            testIt->second.results = testIt->second.realTimeResults.dump(2);
+        } else {
+            testIt->second.results = "[]";
+        }
+        publishTestUpdate(testId);
+    };
+
+    ProcessEngine::getInstance().spawn(std::move(options));
 
     json response = {
         {"success", true},
@@ -654,12 +687,14 @@ std::string NetworkUtilityRouter::handleStartPingTest(const json& requestData) {
 std::string NetworkUtilityRouter::handleStopPingTest() {
     ENDPOINT_LOG("network-utility", "Stopping ping test");
 
-    system("pkill -f ping");
-
+    std::lock_guard<std::mutex> lock(activeTestsMutex_);
     for (auto& test : activeTests) {
         if (test.second.testType == "ping" && test.second.isRunning) {
+            // Only our own ping processes, not every ping on the system
+            test.second.cancel.cancel();
             test.second.isRunning = false;
             test.second.results = "Test stopped by user";
+            publishTestUpdate(test.first);
         }
     }
 
@@ -673,6 +708,63 @@ std::string NetworkUtilityRouter::handleStopPingTest() {
     return response.dump();
 }
 
+// Same shape as an entry of the ping results' activeTests, so polled and pushed updates render alike
+json NetworkUtilityRouter::buildPingTestInfo(const std::string& testId, const TestState& state) const {
+    json testInfo = {
+        {"testId", testId},
+        {"isRunning", state.isRunning},
+        {"startTime", state.startTime},
+        {"progress", state.progress},
+        {"configuration", state.configuration}
+    };
+
+    // Add real-time results if available
+    if (!state.realTimeResults.is_null()) {
+        testInfo["realTimeResults"] = state.realTimeResults;
+
+        // Calculate and add statistics from real-time results
+        double totalRtt = 0.0;
+        int validPings = 0;
+        int failedPings = 0;
+        double minRtt = std::numeric_limits<double>::max();
+        double maxRtt = 0.0;
+
+        for (const auto& result : state.realTimeResults) {
+            if (result.contains("rtt") && result["rtt"].is_number()) {
+                double rtt = result["rtt"];
+                totalRtt += rtt;
+                validPings++;
+                minRtt = std::min(minRtt, rtt);
+                maxRtt = std::max(maxRtt, rtt);
+            } else {
+                failedPings++;
+            }
+        }
+
+        if (validPings > 0) {
+            testInfo["averageRtt"] = totalRtt / validPings;
+            testInfo["minRtt"] = minRtt;
+            testInfo["maxRtt"] = maxRtt;
+            testInfo["packetLoss"] = (failedPings * 100.0) / (validPings + failedPings);
+            testInfo["packetsReceived"] = validPings;
+            testInfo["packetsSent"] = validPings + failedPings;
+        } else {
+            testInfo["averageRtt"] = 0.0;
+            testInfo["minRtt"] = 0.0;
+            testInfo["maxRtt"] = 0.0;
+            testInfo["packetLoss"] = 100.0;
+            testInfo["packetsReceived"] = 0;
+            testInfo["packetsSent"] = failedPings;
+        }
+    }
+
+    if (!state.results.empty()) {
+        testInfo["results"] = state.results;
+    }
+
+    return testInfo;
+}
+
 std::string NetworkUtilityRouter::handleGetPingTestResults() {
     json response = {
         {"success", true},
@@ -681,61 +773,10 @@ std::string NetworkUtilityRouter::handleGetPingTestResults() {
             std::chrono::system_clock::now().time_since_epoch()).count()}
     };
 
+    std::lock_guard<std::mutex> lock(activeTestsMutex_);
     for (const auto& test : activeTests) {
         if (test.second.testType == "ping") {
-            json testInfo = {
-                {"testId", test.first},
-                {"isRunning", test.second.isRunning},
-                {"startTime", test.second.startTime},
-                {"progress", test.second.progress},
-                {"configuration", test.second.configuration}
-            };
-
-            // Add real-time results if available
-            if (!test.second.realTimeResults.is_null()) {
-                testInfo["realTimeResults"] = test.second.realTimeResults;
-
-                // Calculate and add statistics from real-time results
-                double totalRtt = 0.0;
-                int validPings = 0;
-                int failedPings = 0;
-                double minRtt = std::numeric_limits<double>::max();
-                double maxRtt = 0.0;
-
-                for (const auto& result : test.second.realTimeResults) {
-                    if (result.contains("rtt") && result["rtt"].is_number()) {
-                        double rtt = result["rtt"];
-                        totalRtt += rtt;
-                        validPings++;
-                        minRtt = std::min(minRtt, rtt);
-                        maxRtt = std::max(maxRtt, rtt);
-                    } else {
-                        failedPings++;
-                    }
-                }
-
-                if (validPings > 0) {
-                    testInfo["averageRtt"] = totalRtt / validPings;
-                    testInfo["minRtt"] = minRtt;
-                    testInfo["maxRtt"] = maxRtt;
-                    testInfo["packetLoss"] = (failedPings * 100.0) / (validPings + failedPings);
-                    testInfo["packetsReceived"] = validPings;
-                    testInfo["packetsSent"] = validPings + failedPings;
-                } else {
-                    testInfo["averageRtt"] = 0.0;
-                    testInfo["minRtt"] = 0.0;
-                    testInfo["maxRtt"] = 0.0;
-                    testInfo["packetLoss"] = 100.0;
-                    testInfo["packetsReceived"] = 0;
-                    testInfo["packetsSent"] = failedPings;
-                }
-            }
-
-            if (!test.second.results.empty()) {
-                testInfo["results"] = test.second.results;
-            }
-
-            response["activeTests"].push_back(testInfo);
+            response["activeTests"].push_back(buildPingTestInfo(test.first, test.second));
         }
     }
 
@@ -768,18 +809,6 @@ std::string NetworkUtilityRouter::handleStartTraceroute(const json& requestData)
             return json{{"success", false}, {"message", "Protocol must be icmp, udp, or tcp"}}.dump();
         }
 
-    // Build traceroute command safely
-    std::ostringstream cmd;
-
-    // Use basic traceroute command
-    cmd << "timeout " << (timeout * maxHops + 10) << " traceroute";
-
-    // Add safe parameters
-    cmd << " -m " << maxHops;
-    cmd << " -w " << timeout;
-    cmd << " -q 1";  // One probe per hop
-    cmd << " -n";    // Numeric output only
-
     // Validate and escape target host
     std::string safeHost = targetHost;
 
@@ -791,29 +820,35 @@ std::string NetworkUtilityRouter::handleStartTraceroute(const json& requestData)
         }), safeHost.end());
 
     // Basic hostname/IP validation
-    if (safeHost.empty() || safeHost.length() > 253) {
+    if (safeHost.empty() || safeHost.length() > 253 || safeHost[0] == '-') {
         return json{{"success", false}, {"message", "Invalid target host"}}.dump();
     }
 
-    // Add validated host
-    cmd << " " << safeHost;
+    // One probe per hop, numeric output only
+    std::vector<std::string> argv = {
+        "traceroute",
+        "-m", std::to_string(maxHops),
+        "-w", std::to_string(timeout),
+        "-q", "1",
+        "-n",
+        safeHost
+    };
 
     // Store test state
-    TestState& state = activeTests[testId];
-    state.isRunning = true;
-    state.testType = "traceroute";
-    state.startTime = std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
-        std::chrono::system_clock::now().time_since_epoch()).count());
-    state.configuration = requestData;
-    state.progress = 0;
-    state.realTimeResults = json::array();
-
-    // Execute command in background thread with real-time updates
-    std::string cmdStr = cmd.str();
-    std::thread([this, testId, cmdStr, maxHops]() {
-        std::lock_guard<std::mutex> lock(traceroute_mutex);
-        executeTracerouteWithProgress(testId, cmdStr, maxHops);
-    }).detach();
+    {
+        std::lock_guard<std::mutex> lock(activeTestsMutex_);
+        TestState& state = activeTests[testId];
+        state.isRunning = true;
+        state.testType = "traceroute";
+        state.startTime = std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+        state.configuration = requestData;
+        state.progress = 0;
+        state.realTimeResults = json::array();
+    }
+
+    // Runs on the process engine; hops are published as they arrive
+    executeTracerouteWithProgress(testId, argv, std::chrono::seconds(timeout * maxHops + 10), maxHops);
 
     json response = {
         {"success", true},
@@ -839,12 +874,13 @@ std::string NetworkUtilityRouter::handleStartTraceroute(const json& requestData)
 }
 
 std::string NetworkUtilityRouter::handleStopTraceroute() {
-    system("pkill -f traceroute");
-
+    std::lock_guard<std::mutex> lock(activeTestsMutex_);
     for (auto& test : activeTests) {
         if (test.second.testType == "traceroute" && test.second.isRunning) {
+            test.second.cancel.cancel();
             test.second.isRunning = false;
             test.second.results = "Test stopped by user";
+            publishTestUpdate(test.first);
         }
     }
 
@@ -858,6 +894,51 @@ std::string NetworkUtilityRouter::handleStopTraceroute() {
     return response.dump();
 }
 
+json NetworkUtilityRouter::buildTracerouteTestInfo(const std::string& testId, const TestState& state) const {
+    json testInfo = {
+        {"testId", testId},
+        {"isRunning", state.isRunning},
+        {"startTime", state.startTime},
+        {"progress", state.progress},
+        {"configuration", state.configuration},
+        {"currentHop", state.currentHop}
+    };
+
+    // Add real-time results if available
+    if (!state.realTimeResults.is_null()) {
+        testInfo["realTimeResults"] = state.realTimeResults;
+    } else {
+        testInfo["realTimeResults"] = json::array();
+    }
+
+    // Add lastUpdate timestamp if available
+    if (!state.lastUpdate.empty()) {
+        testInfo["lastUpdate"] = state.lastUpdate;
+    }
+
+    if (!state.results.empty()) {
+        testInfo["results"] = state.results;
+    }
+
+    return testInfo;
+}
+
+// Push a test's current state to "network-utility.<type>" event stream subscribers.
+// Called with activeTestsMutex_ held, so updates go out in the order they were made.
+void NetworkUtilityRouter::publishTestUpdate(const std::string& testId) {
+    auto testIt = activeTests.find(testId);
+    if (testIt == activeTests.end()) {
+        return;
+    }
+
+    const TestState& state = testIt->second;
+    if (state.testType == "ping") {
+        EventBus::getInstance().publish("network-utility.ping", buildPingTestInfo(testId, state));
+    } else if (state.testType == "traceroute") {
+        EventBus::getInstance().publish("network-utility.traceroute", buildTracerouteTestInfo(testId, state));
+    }
+}
+
 std::string NetworkUtilityRouter::handleGetTracerouteResults() {
     json response = {
         {"success", true},
@@ -866,34 +947,10 @@ std::string NetworkUtilityRouter::handleGetTracerouteResults() {
             std::chrono::system_clock::now().time_since_epoch()).count()}
     };
 
+    std::lock_guard<std::mutex> lock(activeTestsMutex_);
     for (const auto& test : activeTests) {
         if (test.second.testType == "traceroute") {
-            json testInfo = {
-                {"testId", test.first},
-                {"isRunning", test.second.isRunning},
-                {"startTime", test.second.startTime},
-                {"progress", test.second.progress},
-                {"configuration", test.second.configuration},
-                {"currentHop", test.second.currentHop}
-            };
-
-            // Add real-time results if available
-            if (!test.second.realTimeResults.is_null()) {
-                testInfo["realTimeResults"] = test.second.realTimeResults;
-            } else {
-                testInfo["realTimeResults"] = json::array();
-            }
-
-            // Add lastUpdate timestamp if available
-            if (!test.second.lastUpdate.empty()) {
-                testInfo["lastUpdate"] = test.second.lastUpdate;
-            }
-
-            if (!test.second.results.empty()) {
-                testInfo["results"] = test.second.results;
-            }
-
-            response["activeTests"].push_back(testInfo);
+            response["activeTests"].push_back(buildTracerouteTestInfo(test.first, test.second));
         }
     }
 
@@ -903,6 +960,10 @@ std::string NetworkUtilityRouter::handleGetTracerouteResults() {
 std::string NetworkUtilityRouter::handlePerformDnsLookup(const json& requestData) {
     ENDPOINT_LOG("network-utility", "Performing DNS lookup");
 
+    if (!dnsEngine_) {
+        return json{{"success", false}, {"message", "DNS engine not initialized"}}.dump();
+    }
+
     std::string domain = requestData.value("domain", "example.com");
     std::string recordType = requestData.value("recordType", "A");
     std::string dnsServer = requestData.value("dnsServer", "");
@@ -910,41 +971,60 @@ std::string NetworkUtilityRouter::handlePerformDnsLookup(const json& requestData
     bool trace = requestData.value("trace", false);
     bool recursive = requestData.value("recursive", true);
 
-    // Input validation for security
-    if (domain.empty() || domain.length() > 253) {
-        return json{{"success", false}, {"message", "Invalid domain name"}}.dump();
-    }
-
-    // Validate and sanitize domain to prevent command injection
-    std::string safeDomain = domain;
-    safeDomain.erase(std::remove_if(safeDomain.begin(), safeDomain.end(), 
-        [](char c) { 
-            return c == ';' || c == '|' || c == '&' || c == '`' || c == '$' || 
-                   c == '\'' || c == '"' || c == '\n' || c == '\r' || c == ' ' ||
-                   c == '<' || c == '>' || c == '(' || c == ')';
-        }), safeDomain.end());
+    // Reject anything a shell or the resolver would treat specially
+    auto isSafe = [](const std::string& value) {
+        return !value.empty() && value.length() <= 253 &&
+            std::none_of(value.begin(), value.end(), [](char c) {
+                return c == ';' || c == '|' || c == '&' || c == '`' || c == '$' ||
+                       c == '\'' || c == '"' || c == '\n' || c == '\r' || c == ' ' ||
+                       c == '<' || c == '>' || c == '(' || c == ')';
+            });
+    };
+    std::vector<std::string> validRecordTypes = {"A", "AAAA", "CNAME", "MX", "NS", "PTR", "SOA", "SRV", "TXT",
+                                                 "CAA", "DS", "DNSKEY"};
+    auto isValidRecordType = [&validRecordTypes](const std::string& type) {
+        return std::find(validRecordTypes.begin(), validRecordTypes.end(), type) != validRecordTypes.end();
+    };
 
-    if (safeDomain.empty() || safeDomain != domain) {
-        return json{{"success", false}, {"message", "Invalid characters in domain name"}}.dump();
+    // A bulk request names several domains and/or record types; every
+    // combination is looked up concurrently
+    std::vector<std::string> domains;
+    std::vector<std::string> recordTypes;
+    std::vector<std::string> compareServers;
+    try {
+        domains = requestData.value("domains", std::vector<std::string>{});
+        recordTypes = requestData.value("recordTypes", std::vector<std::string>{});
+        compareServers = requestData.value("compareServers", std::vector<std::string>{});
+    } catch (const std::exception&) {
+        return json{{"success", false}, {"message", "domains, recordTypes and compareServers must be arrays of strings"}}.dump();
     }
+    bool bulk = !domains.empty() || !recordTypes.empty();
+    if (domains.empty()) domains.push_back(domain);
+    if (recordTypes.empty()) recordTypes.push_back(recordType);
 
-    // Validate record type (whitelist approach)
-    std::vector<std::string> validRecordTypes = {"A", "AAAA", "CNAME", "MX", "NS", "PTR", "SOA", "SRV", "TXT"};
-    if (std::find(validRecordTypes.begin(), validRecordTypes.end(), recordType) == validRecordTypes.end()) {
-        return json{{"success", false}, {"message", "Invalid DNS record type"}}.dump();
+    if (domains.size() * recordTypes.size() > 64) {
+        return json{{"success", false}, {"message", "At most 64 lookups per request"}}.dump();
+    }
+    for (const auto& name : domains) {
+        if (!isSafe(name)) {
+            return json{{"success", false}, {"message", "Invalid characters in domain name"}}.dump();
+        }
+    }
+    for (const auto& type : recordTypes) {
+        if (!isValidRecordType(type)) {
+            return json{{"success", false}, {"message", "Invalid DNS record type"}}.dump();
+        }
     }
 
-    // Validate DNS server if specified
-    std::string safeDnsServer = dnsServer;
-    if (!dnsServer.empty() && dnsServer != "System Default") {
-        safeDnsServer.erase(std::remove_if(safeDnsServer.begin(), safeDnsServer.end(), 
-            [](char c) { 
-                return c == ';' || c == '|' || c == '&' || c == '`' || c == '$' || 
-                       c == '\'' || c == '"' || c == '\n' || c == '\r' || c == ' ' ||
-                       c == '<' || c == '>' || c == '(' || c == ')';
-            }), safeDnsServer.end());
-
-        if (safeDnsServer.empty() || safeDnsServer != dnsServer || dnsServer.length() > 253) {
+    // Validate DNS servers if specified
+    if (!dnsServer.empty() && dnsServer != "System Default" && !isSafe(dnsServer)) {
+        return json{{"success", false}, {"message", "Invalid DNS server"}}.dump();
+    }
+    if (compareServers.size() >= DnsEngine::MAX_SERVERS) {
+        return json{{"success", false}, {"message", "Too many DNS servers to compare"}}.dump();
+    }
+    for (const auto& server : compareServers) {
+        if (!isSafe(server)) {
             return json{{"success", false}, {"message", "Invalid DNS server"}}.dump();
         }
     }
@@ -954,124 +1034,89 @@ std::string NetworkUtilityRouter::handlePerformDnsLookup(const json& requestData
         return json{{"success", false}, {"message", "Timeout must be between 1 and 60 seconds"}}.dump();
     }
 
-    // Build dig command with validated parameters
-    std::ostringstream cmd;
-    cmd << "dig";
-
-    if (!safeDnsServer.empty() && safeDnsServer != "System Default") {
-        cmd << " @" << safeDnsServer;
-    }
-
-    cmd << " " << safeDomain << " " << recordType;
-
-    if (trace) {
-        cmd << " +trace";
-    }
-
-    if (!recursive) {
-        cmd << " +norecurse";
+    std::vector<DNSLookupUtilityEngine::DNSConfig> configs;
+    for (const auto& name : domains) {
+        for (const auto& type : recordTypes) {
+            DNSLookupUtilityEngine::DNSConfig config;
+            config.domain = name;
+            config.recordType = type;
+            config.dnsServer = dnsServer;
+            config.compareServers = compareServers;
+            config.timeout = timeout;
+            config.trace = trace;
+            config.recursive = recursive;
+            configs.push_back(config);
+        }
     }
 
-    cmd << " +time=" << timeout;
-    cmd << " +json";
-
-    auto startTime = std::chrono::steady_clock::now();
-    std::string result = executeCommand(cmd.str(), timeout + 5);
-    auto endTime = std::chrono::steady_clock::now();
-
-    // Calculate query time in milliseconds
-    auto queryTime = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count();
-
-    // Parse DNS results
-    json records = json::array();
-    std::string responseCode = "NOERROR";
-    std::string serverUsed = dnsServer.empty() ? "System Default" : dnsServer;
-
-    try {
-        // Try to parse JSON output from dig +json
-        json digOutput = json::parse(result);
-
-        if (digOutput.contains("Status") && digOutput["Status"].is_number()) {
-            int status = digOutput["Status"];
-            responseCode = (status == 0) ? "NOERROR" : "ERROR";
-        }
-
-        // Extract records from dig JSON output
-        if (digOutput.contains("Answer") && digOutput["Answer"].is_array()) {
-            for (const auto& answer : digOutput["Answer"]) {
-                json record = {
-                    {"name", answer.value("name", domain)},
-                    {"type", answer.value("type", recordType)},
-                    {"ttl", answer.value("TTL", 0)},
-                    {"value", answer.value("data", "")},
-                    {"class", answer.value("class", "IN")}
-                };
-
-                // Add type-specific fields
-                if (recordType == "MX" && answer.contains("data")) {
-                    std::string data = answer["data"];
-                    size_t spacePos = data.find(' ');
-                    if (spacePos != std::string::npos) {
-                        record["priority"] = std::stoi(data.substr(0, spacePos));
-                        record["value"] = data.substr(spacePos + 1);
-                    }
-                }
-
-                records.push_back(record);
+    std::vector<DNSLookupUtilityEngine::DNSResult> results = dnsEngine_->performBulkLookup(configs);
+
+    auto buildLookupInfo = [&dnsServer](const DNSLookupUtilityEngine::DNSResult& result) {
+        json records = json::array();
+        for (const auto& record : result.records) {
+            json entry = {
+                {"name", record.name},
+                {"type", record.type},
+                {"ttl", record.ttl},
+                {"value", record.value},
+                {"class", record.recordClass}
+            };
+            if (record.type == "MX") {
+                entry["priority"] = record.priority;
             }
+            records.push_back(entry);
         }
-    } catch (const std::exception& e) {
-        // Fallback: parse text output if JSON parsing fails
-        ENDPOINT_LOG("network-utility", "JSON parsing failed, using text parsing: " + std::string(e.what()));
-
-        std::istringstream iss(result);
-        std::string line;
-        while (std::getline(iss, line)) {
-            // Basic text parsing for common record types
-            if (line.find(domain) != std::string::npos && 
-                line.find(recordType) != std::string::npos &&
-                line.find(";;") != 0) {
-
-                std::istringstream lineStream(line);
-                std::string name, ttl, cls, type, value;
-                lineStream >> name >> ttl >> cls >> type;
-                std::getline(lineStream, value);
-
-                if (!value.empty()) {
-                    value = value.substr(1); // Remove leading space
-
-                    json record = {
-                        {"name", name},
-                        {"type", type}, 
-                        {"ttl", std::stoi(ttl)},
-                        {"value", value},
-                        {"class", cls}
-                    };
-
-                    records.push_back(record);
-                }
-            }
+
+        json resolvers = json::array();
+        for (const auto& timing : result.resolverTimings) {
+            resolvers.push_back({
+                {"server", timing.server},
+                {"answered", timing.answered},
+                {"queryTime", timing.queryTime},
+                {"status", timing.status}
+            });
         }
+
+        std::string serverUsed = !result.resolvedServer.empty() ? result.resolvedServer
+                               : dnsServer.empty() ? "System Default" : dnsServer;
+        std::string responseCode = !result.responseCode.empty() ? result.responseCode
+                                 : result.success ? "NOERROR" : "ERROR";
+        return json{
+            {"success", result.success},
+            {"message", result.success ? "DNS lookup completed" : result.error},
+            {"domain", result.domain},
+            {"recordType", result.recordType},
+            {"dnsServer", dnsServer},
+            {"queryTime", result.queryTime},
+            {"query_time_ms", result.queryTime},
+            {"serverUsed", serverUsed},
+            {"dns_server", serverUsed},
+            {"records", records},
+            {"recordsCount", records.size()},
+            {"responseCode", responseCode},
+            {"response_code", responseCode},
+            {"fromCache", result.fromCache},
+            {"resolvers", resolvers},
+            {"rawResults", result.rawOutput},
+            {"timestamp", std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count()}
+        };
+    };
+
+    if (!bulk) {
+        return buildLookupInfo(results.front()).dump();
     }
 
     json response = {
         {"success", true},
-        {"message", "DNS lookup completed"},
-        {"domain", domain},
-        {"recordType", recordType},
-        {"dnsServer", dnsServer},
-        {"queryTime", queryTime},
-        {"query_time_ms", queryTime},
-        {"serverUsed", serverUsed},
-        {"dns_server", serverUsed},
-        {"records", records},
-        {"recordsCount", records.size()},
-        {"responseCode", responseCode},
-        {"response_code", responseCode},
-        {"rawResults", result},
+        {"message", "DNS lookups completed"},
+        {"results", json::array()},
         {"timestamp", std::chrono::duration_cast<std::chrono::milliseconds>(
             std::chrono::system_clock::now().time_since_epoch()).count()}
     };
+    for (const auto& result : results) {
+        response["results"].push_back(buildLookupInfo(result));
+    }
 
     return response.dump();
 }
@@ -1235,15 +1280,22 @@ std::string NetworkUtilityRouter::handleTestServerConnection(const std::string&
 }
 
 std::string NetworkUtilityRouter::handleGetSystemInfo() {
+    // Kernel, architecture and hostname come straight from uname(2)
+    struct utsname system{};
+    ::uname(&system);
+
+    std::string iperfVersion = executeCommand({"iperf3", "--version"}, 5);
+    iperfVersion = iperfVersion.substr(0, iperfVersion.find('\n'));
+
     json response = {
         {"success", true},
         {"systemInfo", {
-            {"os", executeCommand("uname -o", 5)},
-            {"kernel", executeCommand("uname -r", 5)},
-            {"architecture", executeCommand("uname -m", 5)},
-            {"iperf3_version", executeCommand("iperf3 --version 2>&1 | head -1", 5)},
-            {"hostname", executeCommand("hostname", 5)},
-            {"uptime", executeCommand("uptime -p", 5)}
+            {"os", executeCommand({"uname", "-o"}, 5)},
+            {"kernel", system.release},
+            {"architecture", system.machine},
+            {"iperf3_version", iperfVersion},
+            {"hostname", system.nodename},
+            {"uptime", executeCommand({"uptime", "-p"}, 5)}
         }},
         {"timestamp", std::chrono::duration_cast<std::chrono::milliseconds>(
             std::chrono::system_clock::now().time_since_epoch()).count()}
@@ -1253,11 +1305,72 @@ std::string NetworkUtilityRouter::handleGetSystemInfo() {
 }
 
 std::string NetworkUtilityRouter::handleGetNetworkInterfaces() {
-    std::string ifconfig = executeCommand("ip addr show", 10);
+    // Served from the netlink tables instead of running `ip addr show`
+    static const char* const operstates[] = {
+        "UNKNOWN", "NOTPRESENT", "DOWN", "LOWERLAYERDOWN", "TESTING", "DORMANT", "UP"
+    };
+
+    std::shared_ptr<const NetlinkStateEngine::Table> table = NetlinkStateEngine::getInstance().snapshot();
+
+    json interfaces = json::array();
+    for (const auto& entry : table->links) {
+        const NetlinkStateEngine::Link& link = entry.second;
+
+        json addresses = json::array();
+        for (const NetlinkStateEngine::Address* address : table->addressesOf(link.index)) {
+            addresses.push_back({
+                {"family", address->family == AF_INET6 ? "inet6" : "inet"},
+                {"address", address->address},
+                {"prefix_len", address->prefix_len},
+                {"scope", address->scope},
+                {"dynamic", address->dynamic}
+            });
+        }
+
+        interfaces.push_back({
+            {"index", link.index},
+            {"name", link.name},
+            {"mac_address", link.mac_address},
+            {"kind", link.kind},
+            {"up", link.isUp()},
+            {"carrier", link.hasCarrier()},
+            {"operstate", link.operstate < std::size(operstates) ? operstates[link.operstate] : "UNKNOWN"},
+            {"mtu", link.mtu},
+            {"loopback", link.isLoopback()},
+            {"wireless", link.is_wireless},
+            {"speed_mbps", link.speed_mbps},
+            {"duplex", link.duplex},
+            {"addresses", addresses},
+            {"statistics", {
+                {"rx_bytes", link.counters.rx_bytes},
+                {"tx_bytes", link.counters.tx_bytes},
+                {"rx_packets", link.counters.rx_packets},
+                {"tx_packets", link.counters.tx_packets},
+                {"rx_errors", link.counters.rx_errors},
+                {"tx_errors", link.counters.tx_errors},
+                {"rx_dropped", link.counters.rx_dropped},
+                {"tx_dropped", link.counters.tx_dropped}
+            }}
+        });
+    }
+
+    json default_routes = json::array();
+    for (int family : {AF_INET, AF_INET6}) {
+        if (const NetlinkStateEngine::Route* route = table->defaultRoute(family)) {
+            const NetlinkStateEngine::Link* link = table->findLink(route->oif);
+            default_routes.push_back({
+                {"family", family == AF_INET6 ? "inet6" : "inet"},
+                {"gateway", route->gateway},
+                {"interface", link ? link->name : ""},
+                {"metric", route->priority}
+            });
+        }
+    }
 
     json response = {
         {"success", true},
-        {"interfaces", ifconfig},
+        {"interfaces", interfaces},
+        {"default_routes", default_routes},
         {"timestamp", std::chrono::duration_cast<std::chrono::milliseconds>(
             std::chrono::system_clock::now().time_since_epoch()).count()}
     };
@@ -1265,23 +1378,18 @@ std::string NetworkUtilityRouter::handleGetNetworkInterfaces() {
     return response.dump();
 }
 
-std::string NetworkUtilityRouter::executeCommand(const std::string& command, int timeoutSeconds) {
-    std::string result;
-    FILE* pipe = popen(command.c_str(), "r");
-    if (!pipe) {
+std::string NetworkUtilityRouter::executeCommand(const std::vector<std::string>& argv, int timeoutSeconds) {
+    ProcessEngine::Result run = ProcessEngine::getInstance().run(argv, std::chrono::seconds(timeoutSeconds),
+                                                                 CancellationToken(), false);
+    if (!run.error.empty()) {
         return "Error: Could not execute command";
     }
-
-    char buffer[128];
-    while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-        result += buffer;
-    }
-
-    int status = pclose(pipe);
-    if (status == -1) {
+    if (run.timed_out) {
         return "Error: Command execution failed";
     }
 
+    std::string result = std::move(run.output);
+
     // Trim whitespace
     result.erase(result.find_last_not_of(" \n\r\t") + 1);
 
@@ -1369,6 +1477,41 @@ std::string NetworkUtilityRouter::formatDnsResults(const std::string& output) {
     return result.dump();
 }
 
+std::string NetworkUtilityRouter::handleTestAllServers(const json& requestData) {
+    if (!serversEngine_) {
+        return json{{"success", false}, {"message", "Servers engine not initialized"}}.dump();
+    }
+
+    // Optional: how many servers to test at once, and a period to repeat on
+    int parallelism = requestData.value("parallelism", 0);
+    int scheduleSeconds = requestData.value("scheduleSeconds", -1);
+    if (parallelism < 0 || parallelism > static_cast<int>(Iperf3ServersEngine::MAX_PROBE_PARALLELISM)) {
+        return json{{"success", false}, {"message", "parallelism must be between 1 and " +
+                     std::to_string(Iperf3ServersEngine::MAX_PROBE_PARALLELISM)}}.dump();
+    }
+    if (scheduleSeconds > 0 && scheduleSeconds < 60) {
+        return json{{"success", false}, {"message", "scheduleSeconds must be 0 (off) or at least 60"}}.dump();
+    }
+
+    if (parallelism > 0) {
+        serversEngine_->setProbeParallelism(parallelism);
+    }
+    if (scheduleSeconds >= 0) {
+        serversEngine_->setProbeSchedule(std::chrono::seconds(scheduleSeconds));
+    }
+    serversEngine_->testAllServersAsync();
+
+    json response = {
+        {"success", true},
+        {"message", "Server tests started"},
+        {"probing", serversEngine_->isProbing()},
+        {"timestamp", std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count()}
+    };
+
+    return response.dump();
+}
+
 std::string NetworkUtilityRouter::handleGetServerList() {
     if (!serversEngine_) {
         return json{{"success", false}, {"message", "Servers engine not initialized"}}.dump();
@@ -1382,6 +1525,7 @@ std::string NetworkUtilityRouter::handleGetServerList() {
         {"servers", serverArray},
         {"total_servers", servers.size()},
         {"summary", serversEngine_->getServerStatusSummary()},
+        {"probing", serversEngine_->isProbing()},
         {"timestamp", std::chrono::duration_cast<std::chrono::milliseconds>(
             std::chrono::system_clock::now().time_since_epoch()).count()}
     };
@@ -1684,40 +1828,24 @@ NetworkUtilityRouter::ServerConnectivityResult NetworkUtilityRouter::testServerC
 }
 
 std::string NetworkUtilityRouter::performPingTest(const std::string& hostname) {
-    if (hostname.empty()) {
+    if (hostname.empty() || hostname[0] == '-') {
         return "";
     }
 
-    try {
-        std::ostringstream cmd;
-        cmd << "timeout 8 ping -c 3 -W 2 " << hostname << " 2>/dev/null || echo 'ping_failed'";
-        std::string result = executeCommand(cmd.str(), 10);
-
-        // Check if the command actually failed
-        if (result.find("ping_failed") != std::string::npos) {
-            return "";
-        }
-
-        return result;
-    } catch (const std::exception& e) {
-        ENDPOINT_LOG("network-utility", "Ping command failed: " + std::string(e.what()));
-        return "";
-    }
+    // A failed ping (non-zero exit) yields no output, like the unreachable case
+    ProcessEngine::Result result = ProcessEngine::getInstance().run(
+        {"ping", "-c", "3", "-W", "2", hostname}, std::chrono::seconds(8), CancellationToken(), false);
+    return result.succeeded() ? result.output : "";
 }
 
 std::string NetworkUtilityRouter::performPortConnectivityTest(const std::string& hostname, int port) {
-    if (hostname.empty() || port <= 0 || port > 65535) {
+    if (hostname.empty() || hostname[0] == '-' || port <= 0 || port > 65535) {
         return "Connection failed";
     }
 
-    try {
-        std::ostringstream cmd;
-        cmd << "timeout 3 nc -z -w2 " << hostname << " " << port << " 2>/dev/null && echo \"Connection successful\" || echo \"Connection failed\"";
-        return executeCommand(cmd.str(), 5);
-    } catch (const std::exception& e) {
-        ENDPOINT_LOG("network-utility", "Port connectivity test failed: " + std::string(e.what()));
-        return "Connection failed";
-    }
+    ProcessEngine::Result result = ProcessEngine::getInstance().run(
+        {"nc", "-z", "-w2", hostname, std::to_string(port)}, std::chrono::seconds(3), CancellationToken(), false);
+    return result.succeeded() ? "Connection successful" : "Connection failed";
 }
 
 double NetworkUtilityRouter::calculateServerLoad(const std::string& hostname, int port) {
@@ -1746,13 +1874,20 @@ double NetworkUtilityRouter::calculateServerLoad(const std::string& hostname, in
     }
 }
 
-void NetworkUtilityRouter::executeTracerouteWithProgress(const std::string& testId, const std::string& command, int maxHops) {
-    try {
-        // Validate inputs first
-        if (testId.empty() || command.empty() || maxHops <= 0) {
-            ENDPOINT_LOG("network-utility", "Invalid parameters for traceroute");
-            return;
-        }
+void NetworkUtilityRouter::executeTracerouteWithProgress(const std::string& testId, const std::vector<std::string>& argv,
+                                                         std::chrono::seconds timeout, int maxHops) {
+    // Validate inputs first
+    if (testId.empty() || argv.empty() || maxHops <= 0) {
+        ENDPOINT_LOG("network-utility", "Invalid parameters for traceroute");
+        return;
+    }
+
+    ProcessEngine::Options options;
+    options.argv = argv;
+    options.timeout = timeout;
+
+    {
+        std::lock_guard<std::mutex> lock(activeTestsMutex_);
 
         // Check if test still exists before proceeding
         auto testIt = activeTests.find(testId);
@@ -1761,163 +1896,146 @@ void NetworkUtilityRouter::executeTracerouteWithProgress(const std::string& test
             return;
         }
 
-        ENDPOINT_LOG("network-utility", "Starting traceroute execution for test: " + testId);
-
-        // Use a safer command execution approach
-        std::string safeCommand = command + " 2>&1";
-        FILE* pipe = popen(safeCommand.c_str(), "r");
-        if (!pipe) {
-            testIt->second.isRunning = false;
-            testIt->second.results = "Error: Could not execute traceroute command";
-            ENDPOINT_LOG("network-utility", "Failed to open pipe for traceroute");
-            return;
-        }
-
         // Initialize results array if not already done
         if (testIt->second.realTimeResults.is_null()) {
             testIt->second.realTimeResults = json::array();
         }
+        options.cancel = testIt->second.cancel;
+    }
 
-        char buffer[2048];  // Larger buffer
-        std::string line;
-        int processedHops = 0;
-        int lineCount = 0;
-        const int maxLines = 100; // Prevent infinite loops
-
-        // Simplified regex patterns to avoid complex parsing issues
-        std::regex hopRegex(R"(^\s*(\d+)\s+(.+?)\s+([0-9.]+)\s*ms)");
-        std::regex timeoutRegex(R"(^\s*(\d+)\s+\*\s*\*\s*\*)");
+    ENDPOINT_LOG("network-utility", "Starting traceroute execution for test: " + testId);
 
-        while (fgets(buffer, sizeof(buffer), pipe) != nullptr && 
-               lineCount < maxLines && 
-               processedHops < maxHops) {
+    options.on_line = [this, testId, maxHops, processedHops = 0, lineCount = 0](const std::string& line) mutable {
+        const int maxLines = 100; // Ignore runaway output
 
-            lineCount++;
+        // Simplified regex patterns to avoid complex parsing issues
+        static const std::regex hopRegex(R"(^\s*(\d+)\s+(.+?)\s+([0-9.]+)\s*ms)");
+        static const std::regex timeoutRegex(R"(^\s*(\d+)\s+\*\s*\*\s*\*)");
+        static const std::regex hostIpRegex(R"(([^\s\(]+)\s*\(([^\)]+)\))");
 
-            // Check if test is still valid and running
-            testIt = activeTests.find(testId);
-            if (testIt == activeTests.end() || !testIt->second.isRunning) {
-                break;
-            }
+        if (++lineCount > maxLines || processedHops >= maxHops) {
+            return;
+        }
 
-            line = std::string(buffer);
+        // Check if test is still valid and running
+        std::lock_guard<std::mutex> lock(activeTestsMutex_);
+        auto testIt = activeTests.find(testId);
+        if (testIt == activeTests.end() || !testIt->second.isRunning) {
+            return;
+        }
 
-            // Clean the line
-            line.erase(std::remove(line.begin(), line.end(), '\n'), line.end());
-            line.erase(std::remove(line.begin(), line.end(), '\r'), line.end());
+        if (line.length() < 3) return;
 
-            if (line.empty() || line.length() < 3) continue;
+        std::smatch match;
 
-            std::smatch match;
+        // Try to parse successful hop
+        if (std::regex_search(line, match, hopRegex)) {
+            try {
+                int hopNum = std::stoi(match[1].str());
+                std::string hostInfo = match[2].str();
+                double rtt = std::stod(match[3].str());
+
+                // Extract hostname and IP from hostInfo
+                std::string hostname = "*";
+                std::string ip = "*";
+
+                std::smatch hostMatch;
+                if (std::regex_search(hostInfo, hostMatch, hostIpRegex)) {
+                    hostname = hostMatch[1].str();
+                    ip = hostMatch[2].str();
+                } else {
+                    hostname = hostInfo;
+                }
 
-            // Try to parse successful hop
-            if (std::regex_search(line, match, hopRegex)) {
-                try {
-                    int hopNum = std::stoi(match[1].str());
-                    std::string hostInfo = match[2].str();
-                    double rtt = std::stod(match[3].str());
+                json hopData = {
+                    {"hop", hopNum},
+                    {"hostname", hostname},
+                    {"ip", ip},
+                    {"rtt1", rtt},
+                    {"rtt2", -1},
+                    {"rtt3", -1},
+                    {"status", "success"},
+                    {"timestamp", std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::system_clock::now().time_since_epoch()).count()}
+                };
 
-                    // Extract hostname and IP from hostInfo
-                    std::string hostname = "*";
-                    std::string ip = "*";
+                testIt->second.realTimeResults.push_back(hopData);
+                testIt->second.currentHop = hopNum;
+                testIt->second.progress = std::min(100, (hopNum * 100) / maxHops);
+                testIt->second.lastUpdate = std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count());
+                publishTestUpdate(testId);
 
-                    std::regex hostIpRegex(R"(([^\s\(]+)\s*\(([^\)]+)\))");
-                    std::smatch hostMatch;
-                    if (std::regex_search(hostInfo, hostMatch, hostIpRegex)) {
-                        hostname = hostMatch[1].str();
-                        ip = hostMatch[2].str();
-                    } else {
-                        hostname = hostInfo;
-                    }
+                processedHops++;
 
-                    json hopData = {
-                        {"hop", hopNum},
-                        {"hostname", hostname},
-                        {"ip", ip},
-                        {"rtt1", rtt},
-                        {"rtt2", -1},
-                        {"rtt3", -1},
-                        {"status", "success"},
-                        {"timestamp", std::chrono::duration_cast<std::chrono::milliseconds>(
-                            std::chrono::system_clock::now().time_since_epoch()).count()}
-                    };
-
-                    testIt->second.realTimeResults.push_back(hopData);
-                    testIt->second.currentHop = hopNum;
-                    testIt->second.progress = std::min(100, (hopNum * 100) / maxHops);
-                    testIt->second.lastUpdate = std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
-                        std::chrono::system_clock::now().time_since_epoch()).count());
-
-                    processedHops++;
-
-                } catch (const std::exception& e) {
-                    ENDPOINT_LOG("network-utility", "Error parsing hop: " + std::string(e.what()));
-                }
-            }
-            // Try to parse timeout
-            else if (std::regex_search(line, match, timeoutRegex)) {
-                try {
-                    int hopNum = std::stoi(match[1].str());
-
-                    json hopData = {
-                        {"hop", hopNum},
-                        {"hostname", "*"},
-                        {"ip", "*"},
-                        {"rtt1", -1},
-                        {"rtt2", -1},
-                        {"rtt3", -1},
-                        {"status", "timeout"},
-                        {"timestamp", std::chrono::duration_cast<std::chrono::milliseconds>(
-                            std::chrono::system_clock::now().time_since_epoch()).count()}
-                    };
-
-                    testIt->second.realTimeResults.push_back(hopData);
-                    testIt->second.currentHop = hopNum;
-                    testIt->second.progress = std::min(100, (hopNum * 100) / maxHops);
-                    testIt->second.lastUpdate = std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
-                        std::chrono::system_clock::now().time_since_epoch()).count());
-
-                    processedHops++;
-
-                } catch (const std::exception& e) {
-                    ENDPOINT_LOG("network-utility", "Error parsing timeout: " + std::string(e.what()));
-                }
+            } catch (const std::exception& e) {
+                ENDPOINT_LOG("network-utility", "Error parsing hop: " + std::string(e.what()));
             }
         }
+        // Try to parse timeout
+        else if (std::regex_search(line, match, timeoutRegex)) {
+            try {
+                int hopNum = std::stoi(match[1].str());
+
+                json hopData = {
+                    {"hop", hopNum},
+                    {"hostname", "*"},
+                    {"ip", "*"},
+                    {"rtt1", -1},
+                    {"rtt2", -1},
+                    {"rtt3", -1},
+                    {"status", "timeout"},
+                    {"timestamp", std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::system_clock::now().time_since_epoch()).count()}
+                };
 
-        // Close pipe safely
-        int pipeResult = pclose(pipe);
-        ENDPOINT_LOG("network-utility", "Traceroute completed with exit code: " + std::to_string(pipeResult));
+                testIt->second.realTimeResults.push_back(hopData);
+                testIt->second.currentHop = hopNum;
+                testIt->second.progress = std::min(100, (hopNum * 100) / maxHops);
+                testIt->second.lastUpdate = std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count());
+                publishTestUpdate(testId);
 
-        // Update final state if test still exists
-        testIt = activeTests.find(testId);
-        if (testIt != activeTests.end()) {
-            testIt->second.isRunning = false;
-            testIt->second.progress = 100;
+                processedHops++;
 
-            // Safely serialize results
-            try {
-                if (!testIt->second.realTimeResults.empty()) {
-                    testIt->second.results = testIt->second.realTimeResults.dump(2);
-                } else {
-                    testIt->second.results = "[]";
-                }
             } catch (const std::exception& e) {
-                ENDPOINT_LOG("network-utility", "Error serializing results: " + std::string(e.what()));
-                testIt->second.results = "Error: Failed to serialize results";
+                ENDPOINT_LOG("network-utility", "Error parsing timeout: " + std::string(e.what()));
             }
         }
+    };
 
-    } catch (const std::exception& e) {
-        ENDPOINT_LOG("network-utility", "Fatal error in traceroute execution: " + std::string(e.what()));
+    options.on_exit = [this, testId](const ProcessEngine::Result& exit) {
+        ENDPOINT_LOG("network-utility", "Traceroute completed with exit code: " + std::to_string(exit.exit_code));
 
-        // Clean up safely
+        // Update final state if test still exists
+        std::lock_guard<std::mutex> lock(activeTestsMutex_);
         auto testIt = activeTests.find(testId);
-        if (testIt != activeTests.end()) {
-            testIt->second.isRunning = false;
-            testIt->second.results = "Error: " + std::string(e.what());
+        if (testIt == activeTests.end()) {
+            return;
         }
-    }
+
+        testIt->second.isRunning = false;
+        testIt->second.progress = 100;
+
+        // Safely serialize results
+        try {
+            if (!exit.error.empty()) {
+                testIt->second.results = "Error: Could not execute traceroute command (" + exit.error + ")";
+            } else if (exit.cancelled) {
+                testIt->second.results = "Test stopped by user";
+            } else if (!testIt->second.realTimeResults.empty()) {
+                testIt->second.results = testIt->second.realTimeResults.dump(2);
+            } else {
+                testIt->second.results = "[]";
+            }
+        } catch (const std::exception& e) {
+            ENDPOINT_LOG("network-utility", "Error serializing results: " + std::string(e.what()));
+            testIt->second.results = "Error: Failed to serialize results";
+        }
+        publishTestUpdate(testId);
+    };
+
+    ProcessEngine::getInstance().spawn(std::move(options));
 }
 
 void NetworkUtilityRouter::initializeUtilityEnginesAsync() {
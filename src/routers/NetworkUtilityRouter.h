@@ -3,9 +3,12 @@
 
 #include <string>
 #include <map>
+#include <vector>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include "api_request.h"
+#include "process_engine.h"
 #include "../third_party/nlohmann/json.hpp"
 #include "../utilities/BandwidthUtilityEngine.hpp"
 #include "../utilities/PingUtilityEngine.hpp"
@@ -44,6 +47,7 @@ private:
     // Server status handlers
     std::string handleGetServerStatus();
     std::string handleTestServerConnection(const std::string& serverId);
+    std::string handleTestAllServers(const json& requestData);
     std::string handleGetServerList();
     std::string handleAddCustomServer(const json& requestData);
     std::string handleRemoveCustomServer(const std::string& serverId);
@@ -54,7 +58,7 @@ private:
     std::string handleGetNetworkInterfaces();
 
     // Utility functions
-    std::string executeCommand(const std::string& command, int timeoutSeconds = 30);
+    std::string executeCommand(const std::vector<std::string>& argv, int timeoutSeconds = 30);
     std::string formatIperfResults(const std::string& output);
     std::string formatPingResults(const std::string& output);
     std::string formatTracerouteResults(const std::string& output);
@@ -71,6 +75,7 @@ private:
         json realTimeResults;
         int currentHop = 0;
         std::string lastUpdate;
+        CancellationToken cancel;   // Stops this test's process
     };
 
     struct ServerConnectivityResult {
@@ -83,6 +88,10 @@ private:
         double jitter_ms;
     };
 
+    // Guards activeTests and every TestState in it. Request handlers and the
+    // ProcessEngine reactor callbacks both take it; it is never held across
+    // spawn() or anything that waits for a process.
+    std::mutex activeTestsMutex_;
     std::map<std::string, TestState> activeTests;
 
     // Server connectivity testing
@@ -100,7 +109,13 @@ private:
     void loadServerConfigurationNonBlocking();
     void initializeUtilityEngines();
     void initializeUtilityEnginesAsync();
-    void executeTracerouteWithProgress(const std::string& testId, const std::string& command, int maxHops);
+    void executeTracerouteWithProgress(const std::string& testId, const std::vector<std::string>& argv,
+                                       std::chrono::seconds timeout, int maxHops);
+
+    // Test state as reported by the results endpoints and pushed to event streams
+    json buildPingTestInfo(const std::string& testId, const TestState& state) const;
+    json buildTracerouteTestInfo(const std::string& testId, const TestState& state) const;
+    void publishTestUpdate(const std::string& testId);     // Caller holds activeTestsMutex_
 
     // Utility engines
     std::unique_ptr<BandwidthUtilityEngine> bandwidthEngine_;
@@ -1,9 +1,9 @@
 #include "WirelessRouter.h"
 #include "cellular_data_manager.h"
+#include "json_document_store.h"
 #include <iostream>
 #include <chrono>
 #include <nlohmann/json.hpp>
-#include <fstream> // Required for file operations
 #include <iomanip> // Required for time formatting
 #include <sstream> // Required for stringstream
 
@@ -1179,8 +1179,8 @@ std::string WirelessRouter::handleCellularResetConfig(const std::string& method,
 // ================================
 
 json WirelessRouter::loadSavedNetworks() {
-    std::ifstream file("data/wireless/SavedNetworks.json");
-    if (!file.is_open()) {
+    json data;
+    if (!JsonDocumentStore::getInstance().read("data/wireless/SavedNetworks.json", data)) {
         std::cout << "[WIRELESS-DATA] SavedNetworks.json not found, creating default" << std::endl;
         json defaultData = {
             {"saved_networks", json::array()},
@@ -1190,31 +1190,20 @@ json WirelessRouter::loadSavedNetworks() {
         return defaultData;
     }
     
-    json data;
-    file >> data;
-    file.close();
     return data;
 }
 
 bool WirelessRouter::saveSavedNetworks(const json& networks) {
-    try {
-        std::ofstream file("data/wireless/SavedNetworks.json");
-        if (!file.is_open()) {
-            std::cout << "[WIRELESS-DATA] Failed to open SavedNetworks.json for writing" << std::endl;
-            return false;
-        }
-        file << networks.dump(4);
-        file.close();
-        return true;
-    } catch (const std::exception& e) {
-        std::cout << "[WIRELESS-DATA] Error saving SavedNetworks.json: " << e.what() << std::endl;
+    if (!JsonDocumentStore::getInstance().write("data/wireless/SavedNetworks.json", networks, 4)) {
+        std::cout << "[WIRELESS-DATA] Failed to open SavedNetworks.json for writing" << std::endl;
         return false;
     }
+    return true;
 }
 
 json WirelessRouter::loadAvailableNetworks() {
-    std::ifstream file("data/wireless/AvailableNetworks.json");
-    if (!file.is_open()) {
+    json data;
+    if (!JsonDocumentStore::getInstance().read("data/wireless/AvailableNetworks.json", data)) {
         json defaultData = {
             {"available_networks", json::array()},
             {"scan_timestamp", getCurrentTimestamp()},
@@ -1225,30 +1214,20 @@ json WirelessRouter::loadAvailableNetworks() {
         return defaultData;
     }
     
-    json data;
-    file >> data;
-    file.close();
     return data;
 }
 
 bool WirelessRouter::saveAvailableNetworks(const json& networks) {
-    try {
-        std::ofstream file("data/wireless/AvailableNetworks.json");
-        if (!file.is_open()) {
-            return false;
-        }
-        file << networks.dump(4);
-        file.close();
-        return true;
-    } catch (const std::exception& e) {
-        std::cout << "[WIRELESS-DATA] Error saving AvailableNetworks.json: " << e.what() << std::endl;
+    if (!JsonDocumentStore::getInstance().write("data/wireless/AvailableNetworks.json", networks, 4)) {
+        std::cout << "[WIRELESS-DATA] Failed to write AvailableNetworks.json" << std::endl;
         return false;
     }
+    return true;
 }
 
 json WirelessRouter::loadManualConnections() {
-    std::ifstream file("data/wireless/ManualConnect.json");
-    if (!file.is_open()) {
+    json data;
+    if (!JsonDocumentStore::getInstance().read("data/wireless/ManualConnect.json", data)) {
         json defaultData = {
             {"manual_connections", json::array()},
             {"last_updated", getCurrentTimestamp()}
@@ -1257,30 +1236,20 @@ json WirelessRouter::loadManualConnections() {
         return defaultData;
     }
     
-    json data;
-    file >> data;
-    file.close();
     return data;
 }
 
 bool WirelessRouter::saveManualConnection(const json& connection) {
-    try {
-        std::ofstream file("data/wireless/ManualConnect.json");
-        if (!file.is_open()) {
-            return false;
-        }
-        file << connection.dump(4);
-        file.close();
-        return true;
-    } catch (const std::exception& e) {
-        std::cout << "[WIRELESS-DATA] Error saving ManualConnect.json: " << e.what() << std::endl;
+    if (!JsonDocumentStore::getInstance().write("data/wireless/ManualConnect.json", connection, 4)) {
+        std::cout << "[WIRELESS-DATA] Failed to write ManualConnect.json" << std::endl;
         return false;
     }
+    return true;
 }
 
 json WirelessRouter::loadAccessPointConfig() {
-    std::ifstream file("data/wireless/AccessPointConfiguration.json");
-    if (!file.is_open()) {
+    json data;
+    if (!JsonDocumentStore::getInstance().read("data/wireless/AccessPointConfiguration.json", data)) {
         json defaultData = {
             {"access_point_config", {
                 {"ssid", "UR-WebIF-AP"},
@@ -1302,30 +1271,20 @@ json WirelessRouter::loadAccessPointConfig() {
         return defaultData;
     }
     
-    json data;
-    file >> data;
-    file.close();
     return data;
 }
 
 bool WirelessRouter::saveAccessPointConfig(const json& config) {
-    try {
-        std::ofstream file("data/wireless/AccessPointConfiguration.json");
-        if (!file.is_open()) {
-            return false;
-        }
-        file << config.dump(4);
-        file.close();
-        return true;
-    } catch (const std::exception& e) {
-        std::cout << "[WIRELESS-DATA] Error saving AccessPointConfiguration.json: " << e.what() << std::endl;
+    if (!JsonDocumentStore::getInstance().write("data/wireless/AccessPointConfiguration.json", config, 4)) {
+        std::cout << "[WIRELESS-DATA] Failed to write AccessPointConfiguration.json" << std::endl;
         return false;
     }
+    return true;
 }
 
 json WirelessRouter::loadAccessPointStatus() {
-    std::ifstream file("data/wireless/AccessPointStatus.json");
-    if (!file.is_open()) {
+    json data;
+    if (!JsonDocumentStore::getInstance().read("data/wireless/AccessPointStatus.json", data)) {
         json defaultData = {
             {"access_point_status", {
                 {"is_active", false},
@@ -1344,25 +1303,15 @@ json WirelessRouter::loadAccessPointStatus() {
         return defaultData;
     }
     
-    json data;
-    file >> data;
-    file.close();
     return data;
 }
 
 bool WirelessRouter::saveAccessPointStatus(const json& status) {
-    try {
-        std::ofstream file("data/wireless/AccessPointStatus.json");
-        if (!file.is_open()) {
-            return false;
-        }
-        file << status.dump(4);
-        file.close();
-        return true;
-    } catch (const std::exception& e) {
-        std::cout << "[WIRELESS-DATA] Error saving AccessPointStatus.json: " << e.what() << std::endl;
+    if (!JsonDocumentStore::getInstance().write("data/wireless/AccessPointStatus.json", status, 4)) {
+        std::cout << "[WIRELESS-DATA] Failed to write AccessPointStatus.json" << std::endl;
         return false;
     }
+    return true;
 }
 
 std::string WirelessRouter::generateNetworkId() {
@@ -1,9 +1,10 @@
 #include "source-page-data.hpp"
+#include "system_metrics_sampler.h"
+#include "icmp_engine.h"
 #include <nlohmann/json.hpp>
 #include <fstream>
 #include <sstream>
 #include <chrono>
-#include <thread>
 #include <iostream>
 #include <cstdlib>
 #include <unistd.h>
@@ -12,6 +13,7 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <linux/rtnetlink.h>
 #include <iomanip> // For std::put_time
 
 using json = nlohmann::json;
@@ -26,113 +28,17 @@ SourcePageDataManager::~SourcePageDataManager() {
 }
 
 SystemInfo SourcePageDataManager::collectSystemInfo() {
-    SystemInfo info;
-
-    // CPU Usage - parse from /proc/stat or top command
-    info.cpu_usage_percent = getCpuUsagePercent();
-
-    // CPU Info - parse from /proc/cpuinfo
-    std::string cpu_info = executeSystemCommand("cat /proc/cpuinfo | grep 'model name' | head -1 | cut -d':' -f2");
-    if (!cpu_info.empty()) {
-        // Remove leading/trailing whitespace
-        size_t start = cpu_info.find_first_not_of(" \t\n\r");
-        if (start != std::string::npos) {
-            info.cpu_model = cpu_info.substr(start);
-            size_t end = info.cpu_model.find_last_not_of(" \t\n\r");
-            if (end != std::string::npos) {
-                info.cpu_model = info.cpu_model.substr(0, end + 1);
-            }
-        }
-    }
-    if (info.cpu_model.empty()) {
-        info.cpu_model = "Unknown CPU";
-    }
-
-    // CPU cores
-    info.cpu_cores = parseIntFromCommand("nproc");
-    if (info.cpu_cores == 0) info.cpu_cores = 1;
-
-    // CPU temperature (try different methods)
-    info.cpu_temp_celsius = parseIntFromCommand("sensors | grep 'Core 0' | awk '{print $3}' | sed 's/+//;s/°C.*//'");
-    if (info.cpu_temp_celsius == 0) {
-        info.cpu_temp_celsius = parseIntFromCommand("cat /sys/class/thermal/thermal_zone0/temp 2>/dev/null | awk '{print int($1/1000)}'");
-    }
-    if (info.cpu_temp_celsius == 0) {
-        info.cpu_temp_celsius = 45; // Default reasonable value
-    }
-
-    // CPU clock speeds (approximations)
-    info.cpu_base_clock_ghz = parseFloatFromCommand("cat /proc/cpuinfo | grep 'cpu MHz' | head -1 | awk '{print $4/1000}'");
-    if (info.cpu_base_clock_ghz == 0.0f) {
-        info.cpu_base_clock_ghz = 2.4f; // Default reasonable value
-    }
-    info.cpu_boost_clock_ghz = info.cpu_base_clock_ghz + 0.8f; // Estimate boost clock
-
-    // Memory usage
-    std::string mem_info = executeSystemCommand("free -g");
-    if (!mem_info.empty()) {
-        std::istringstream iss(mem_info);
-        std::string line;
-        while (std::getline(iss, line)) {
-            if (line.find("Mem:") == 0) {
-                std::istringstream line_stream(line);
-                std::string label;
-                float total, used, free, shared, buff_cache, available;
-                line_stream >> label >> total >> used >> free >> shared >> buff_cache >> available;
-
-                info.ram_total_gb = total;
-                info.ram_used_gb = used;
-                info.ram_available_gb = available;
-                if (total > 0) {
-                    info.ram_usage_percent = static_cast<int>((used / total) * 100);
-                }
-                break;
-            }
-        }
-    }
-
-    // Default values if parsing failed
-    if (info.ram_total_gb == 0.0f) {
-        info.ram_total_gb = 8.0f;
-        info.ram_used_gb = 4.2f;
-        info.ram_available_gb = 3.8f;
-        info.ram_usage_percent = 52;
-    }
-    info.ram_type = "DDR4"; // Default
-
-    // Swap usage
-    std::string swap_info = executeSystemCommand("free -g | grep Swap");
-    if (!swap_info.empty()) {
-        std::istringstream line_stream(swap_info);
-        std::string label;
-        float total, used, free;
-        line_stream >> label >> total >> used >> free;
-
-        info.swap_total_gb = total;
-        info.swap_used_mb = used * 1024.0f; // Convert GB to MB
-        info.swap_available_gb = free;
-        if (total > 0) {
-            info.swap_usage_percent = static_cast<int>((used / total) * 100);
-        }
-    }
-
-    // Default values if parsing failed
-    if (info.swap_total_gb == 0.0f) {
-        info.swap_total_gb = 4.0f;
-        info.swap_used_mb = 512.0f;
-        info.swap_available_gb = 3.5f;
-        info.swap_usage_percent = 12;
-    }
-    info.swap_priority = "Normal";
-
-    return info;
+    // CPU, memory and temperature are sampled in the background from
+    // /proc and /sys; this never forks or waits
+    return SystemMetricsSampler::getInstance().snapshot()->system;
 }
 
 NetworkInfo SourcePageDataManager::collectNetworkInfo() {
     NetworkInfo info;
 
-    // Check internet connectivity
-    info.internet_connected = checkInternetConnectivity();
+    // Check internet connectivity; the same echo measures the latency
+    int measured_latency_ms = 0;
+    info.internet_connected = checkInternetConnectivity(measured_latency_ms);
     info.internet_status = info.internet_connected ? "Online" : "Offline";
 
     // Get external IP (if connected)
@@ -166,7 +72,7 @@ NetworkInfo SourcePageDataManager::collectNetworkInfo() {
 
     // Network latency (ping Google DNS)
     if (info.internet_connected) {
-        info.latency_ms = parseIntFromCommand("ping -c 1 -W 2 8.8.8.8 2>/dev/null | grep 'time=' | awk -F'time=' '{print $2}' | awk '{print int($1)}'");
+        info.latency_ms = measured_latency_ms;
         if (info.latency_ms == 0) info.latency_ms = 25;
     }
 
@@ -183,26 +89,41 @@ NetworkInfo SourcePageDataManager::collectNetworkInfo() {
     info.last_ping_ms = info.server_connected ? 15 : 0;
     info.session_duration = "4h 23m active";
 
-    // Connection type and interface info
-    std::string route_info = executeSystemCommand("ip route show default | head -1");
-    if (route_info.find("eth") != std::string::npos) {
-        info.connection_type = "Ethernet";
-        info.interface_name = "eth0";
-    } else if (route_info.find("wlan") != std::string::npos) {
-        info.connection_type = "Wi-Fi";
-        info.interface_name = "wlan0";
+    // Connection type and interface details from the netlink tables
+    fillLinkInfo(info);
+
+    return info;
+}
+
+void SourcePageDataManager::fillLinkInfo(NetworkInfo& info) {
+    std::shared_ptr<const NetlinkStateEngine::Table> table = NetlinkStateEngine::getInstance().snapshot();
+    const NetlinkStateEngine::Route* route = table->defaultRoute(AF_INET);
+    const NetlinkStateEngine::Link* link = route ? table->findLink(route->oif) : table->wiredLink();
+
+    if (link) {
+        info.connection_type = link->is_wireless ? "Wi-Fi" : "Ethernet";
+        info.interface_name = link->name;
     } else {
         info.connection_type = "Ethernet";
         info.interface_name = "eth0";
     }
 
-    // Get network interface details
-    info.local_ip = getLocalIpAddress();
-    info.mac_address = getMacAddress();
-    info.gateway_ip = getGatewayIp();
-    info.connection_speed = "1 Gbps Full Duplex";
-
-    return info;
+    info.local_ip = getLocalIpAddress(*table, link);
+    info.mac_address = getMacAddress(link);
+    info.gateway_ip = getGatewayIp(route);
+
+    if (link && link->speed_mbps > 0) {
+        info.connection_speed = (link->speed_mbps >= 1000 && link->speed_mbps % 1000 == 0)
+            ? std::to_string(link->speed_mbps / 1000) + " Gbps"
+            : std::to_string(link->speed_mbps) + " Mbps";
+        if (link->duplex == "full") {
+            info.connection_speed += " Full Duplex";
+        } else if (link->duplex == "half") {
+            info.connection_speed += " Half Duplex";
+        }
+    } else {
+        info.connection_speed = "1 Gbps Full Duplex";
+    }
 }
 
 CellularInfo SourcePageDataManager::collectCellularInfo() {
@@ -237,7 +158,9 @@ SystemStatusData SourcePageDataManager::getAllSystemData() {
     if (auto_refresh_enabled_) {
         refreshData();
     }
-    return cached_data_;
+    SystemStatusData data = cached_data_;
+    data.system = collectSystemInfo();
+    return data;
 }
 
 void SourcePageDataManager::refreshData() {
@@ -263,7 +186,8 @@ ApiResponse SourcePageDataManager::processSystemDataRequest(const ApiRequest& re
             {"cpu_usage_percent", data.system.cpu_usage_percent},
             {"cpu_cores", data.system.cpu_cores},
             {"cpu_model", data.system.cpu_model},
-            {"cpu_temp_celsius", data.system.cpu_temp_celsius},
+            {"cpu_temp_celsius", data.system.cpu_temp_celsius == SystemInfo::TEMPERATURE_UNKNOWN
+                ? json(nullptr) : json(data.system.cpu_temp_celsius)},
             {"cpu_base_clock_ghz", data.system.cpu_base_clock_ghz},
             {"cpu_boost_clock_ghz", data.system.cpu_boost_clock_ghz},
             {"ram_usage_percent", data.system.ram_usage_percent},
@@ -342,45 +266,30 @@ void SourcePageDataManager::setAutoRefresh(bool enabled, int interval_seconds) {
 }
 
 // Helper method implementations
-int SourcePageDataManager::getCpuUsagePercent() {
-    // Simple CPU usage calculation using /proc/stat
-    std::string stat1 = executeSystemCommand("cat /proc/stat | head -1");
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    std::string stat2 = executeSystemCommand("cat /proc/stat | head -1");
-
-    if (stat1.empty() || stat2.empty()) {
-        return 25; // Default fallback
+bool SourcePageDataManager::checkInternetConnectivity(int& latency_ms) {
+    latency_ms = 0;
+
+    IcmpEngine& icmp = IcmpEngine::getInstance();
+    if (!icmp.available(AF_INET)) {
+        latency_ms = parseIntFromCommand("ping -c 1 -W 2 8.8.8.8 2>/dev/null | grep 'time=' | awk -F'time=' '{print $2}' | awk '{print int($1)}'");
+        std::string result = executeSystemCommand("ping -c 1 -W 2 8.8.8.8 >/dev/null 2>&1 && echo 'connected' || echo 'disconnected'");
+        return result.find("connected") != std::string::npos;
     }
 
-    // Parse CPU times (simplified)
-    std::istringstream iss1(stat1), iss2(stat2);
-    std::string cpu_label;
-    long user1, nice1, system1, idle1, iowait1, irq1, softirq1;
-    long user2, nice2, system2, idle2, iowait2, irq2, softirq2;
-
-    iss1 >> cpu_label >> user1 >> nice1 >> system1 >> idle1 >> iowait1 >> irq1 >> softirq1;
-    iss2 >> cpu_label >> user2 >> nice2 >> system2 >> idle2 >> iowait2 >> irq2 >> softirq2;
-
-    long idle_time1 = idle1 + iowait1;
-    long idle_time2 = idle2 + iowait2;
-    long non_idle1 = user1 + nice1 + system1 + irq1 + softirq1;
-    long non_idle2 = user2 + nice2 + system2 + irq2 + softirq2;
-
-    long total1 = idle_time1 + non_idle1;
-    long total2 = idle_time2 + non_idle2;
-
-    long total_diff = total2 - total1;
-    long idle_diff = idle_time2 - idle_time1;
-
-    if (total_diff <= 0) return 25;
-
-    int cpu_usage = static_cast<int>(100.0 * (total_diff - idle_diff) / total_diff);
-    return (cpu_usage < 0) ? 0 : ((cpu_usage > 100) ? 100 : cpu_usage);
-}
-
-bool SourcePageDataManager::checkInternetConnectivity() {
-    std::string result = executeSystemCommand("ping -c 1 -W 2 8.8.8.8 >/dev/null 2>&1 && echo 'connected' || echo 'disconnected'");
-    return result.find("connected") != std::string::npos;
+    sockaddr_storage address{};
+    auto* google_dns = reinterpret_cast<sockaddr_in*>(&address);
+    google_dns->sin_family = AF_INET;
+    inet_pton(AF_INET, "8.8.8.8", &google_dns->sin_addr);
+
+    IcmpEngine::Result result = icmp.run(address, sizeof(sockaddr_in), 1, std::chrono::milliseconds(0),
+                                         std::chrono::seconds(2));
+    for (const auto& echo : result.echoes) {
+        if (echo.success) {
+            latency_ms = static_cast<int>(echo.rtt_ms);
+            return true;
+        }
+    }
+    return false;
 }
 
 std::string SourcePageDataManager::getCurrentTimestamp() {
@@ -391,35 +300,36 @@ std::string SourcePageDataManager::getCurrentTimestamp() {
     return ss.str();
 }
 
-std::string SourcePageDataManager::getLocalIpAddress() {
-    std::string ip = executeSystemCommand("hostname -I | awk '{print $1}'");
-    if (ip.empty() || ip == "127.0.0.1") {
-        ip = "192.168.1.105"; // Default
+std::string SourcePageDataManager::getLocalIpAddress(const NetlinkStateEngine::Table& table,
+                                                     const NetlinkStateEngine::Link* link) {
+    const NetlinkStateEngine::Address* address = link ? table.primaryAddress(link->index) : nullptr;
+    if (!address) {
+        // Like `hostname -I`: first global IPv4 address on any link
+        for (const auto& candidate : table.addresses) {
+            if (candidate.family == AF_INET && candidate.scope == RT_SCOPE_UNIVERSE) {
+                address = &candidate;
+                break;
+            }
+        }
     }
-    return ip;
+    if (!address) {
+        return "192.168.1.105"; // Default
+    }
+    return address->address;
 }
 
-std::string SourcePageDataManager::getMacAddress() {
-    std::string mac = executeSystemCommand("cat /sys/class/net/eth0/address 2>/dev/null");
-    if (mac.empty()) {
-        mac = executeSystemCommand("cat /sys/class/net/wlan0/address 2>/dev/null");
-    }
-    if (mac.empty()) {
-        mac = "00:1B:44:11:3A:B7"; // Default
-    }
-    // Remove newline
-    if (!mac.empty() && mac.back() == '\n') {
-        mac.pop_back();
+std::string SourcePageDataManager::getMacAddress(const NetlinkStateEngine::Link* link) {
+    if (!link || link->mac_address.empty()) {
+        return "00:1B:44:11:3A:B7"; // Default
     }
-    return mac;
+    return link->mac_address;
 }
 
-std::string SourcePageDataManager::getGatewayIp() {
-    std::string gateway = executeSystemCommand("ip route show default | awk '{print $3}' | head -1");
-    if (gateway.empty()) {
-        gateway = "192.168.1.1"; // Default
+std::string SourcePageDataManager::getGatewayIp(const NetlinkStateEngine::Route* route) {
+    if (!route || route->gateway.empty()) {
+        return "192.168.1.1"; // Default
     }
-    return gateway;
+    return route->gateway;
 }
 
 std::string SourcePageDataManager::executeSystemCommand(const std::string& command) {
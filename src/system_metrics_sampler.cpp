@@ -0,0 +1,347 @@
+#include "system_metrics_sampler.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int MAX_THERMAL_ZONES = 32;
+
+int openReadOnly(const std::string& path) {
+    return ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+// Re-read a /proc or /sys file from the start into buffer (NUL-terminated).
+// Both regenerate their contents on every read at offset 0.
+ssize_t preadFile(int fd, char* buffer, size_t size) {
+    if (fd < 0 || size == 0) {
+        return -1;
+    }
+    ssize_t n;
+    do {
+        n = ::pread(fd, buffer, size - 1, 0);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        return -1;
+    }
+    buffer[n] = '\0';
+    return n;
+}
+
+std::string readSmallFile(const std::string& path) {
+    std::ifstream file(path);
+    std::string value;
+    std::getline(file, value);
+    return value;
+}
+
+std::string trim(const std::string& value) {
+    size_t start = value.find_first_not_of(" \t\n\r");
+    if (start == std::string::npos) {
+        return "";
+    }
+    size_t end = value.find_last_not_of(" \t\n\r");
+    return value.substr(start, end - start + 1);
+}
+
+// Value of a "Key:   1234 kB" line in /proc/meminfo, -1 when absent
+long long meminfoValue(const char* text, const char* key) {
+    const char* line = text;
+    size_t key_length = std::strlen(key);
+    while (line && *line) {
+        if (std::strncmp(line, key, key_length) == 0 && line[key_length] == ':') {
+            return std::strtoll(line + key_length + 1, nullptr, 10);
+        }
+        line = std::strchr(line, '\n');
+        if (line) {
+            ++line;
+        }
+    }
+    return -1;
+}
+
+} // namespace
+
+SystemMetricsSampler& SystemMetricsSampler::getInstance() {
+    static SystemMetricsSampler instance;
+    return instance;
+}
+
+SystemMetricsSampler::SystemMetricsSampler() {
+    openSources();
+    readStaticInfo();
+    // Publish a first snapshot right away so snapshot() is never null. With
+    // no previous sample its CPU figure is the average since boot.
+    sampleOnce();
+}
+
+SystemMetricsSampler::~SystemMetricsSampler() {
+    stop();
+    for (int fd : {stat_fd_, meminfo_fd_, thermal_fd_}) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+}
+
+void SystemMetricsSampler::openSources() {
+    stat_fd_ = openReadOnly("/proc/stat");
+    meminfo_fd_ = openReadOnly("/proc/meminfo");
+
+    // Prefer a zone that describes the CPU package; otherwise the first
+    // readable zone, which is what thermal_zone0 usually is
+    int fallback_fd = -1;
+    for (int zone = 0; zone < MAX_THERMAL_ZONES; ++zone) {
+        std::string base = "/sys/class/thermal/thermal_zone" + std::to_string(zone);
+        int fd = openReadOnly(base + "/temp");
+        if (fd < 0) {
+            if (errno == ENOENT) {
+                break;
+            }
+            continue;
+        }
+
+        std::string type = readSmallFile(base + "/type");
+        bool is_cpu = type.find("cpu") != std::string::npos ||
+                      type.find("x86_pkg_temp") != std::string::npos ||
+                      type.find("soc") != std::string::npos ||
+                      type.find("coretemp") != std::string::npos;
+        if (is_cpu) {
+            thermal_fd_ = fd;
+            break;
+        }
+        if (fallback_fd < 0) {
+            fallback_fd = fd;
+        } else {
+            ::close(fd);
+        }
+    }
+
+    if (thermal_fd_ < 0) {
+        thermal_fd_ = fallback_fd;
+    } else if (fallback_fd >= 0) {
+        ::close(fallback_fd);
+    }
+}
+
+// Model, core count and clocks do not change at runtime: read them once
+void SystemMetricsSampler::readStaticInfo() {
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    float cpu_mhz = 0.0f;
+    while (std::getline(cpuinfo, line)) {
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) {
+            continue;
+        }
+        std::string key = trim(line.substr(0, colon));
+        std::string value = trim(line.substr(colon + 1));
+        if (static_info_.cpu_model.empty() &&
+            (key == "model name" || key == "cpu model" || key == "Hardware")) {
+            static_info_.cpu_model = value;
+        } else if (cpu_mhz == 0.0f && key == "cpu MHz") {
+            cpu_mhz = std::strtof(value.c_str(), nullptr);
+        }
+    }
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    static_info_.cpu_cores = cores > 0 ? static_cast<int>(cores) : -1;
+
+    // cpufreq reports kHz
+    const std::string cpufreq = "/sys/devices/system/cpu/cpu0/cpufreq/";
+    float base_khz = std::strtof(readSmallFile(cpufreq + "base_frequency").c_str(), nullptr);
+    float max_khz = std::strtof(readSmallFile(cpufreq + "cpuinfo_max_freq").c_str(), nullptr);
+
+    if (base_khz > 0.0f) {
+        static_info_.cpu_base_clock_ghz = base_khz / 1e6f;
+    } else if (cpu_mhz > 0.0f) {
+        static_info_.cpu_base_clock_ghz = cpu_mhz / 1000.0f;
+    } else {
+        static_info_.cpu_base_clock_ghz = -1.0f;
+    }
+
+    if (max_khz > 0.0f) {
+        static_info_.cpu_boost_clock_ghz = max_khz / 1e6f;
+    } else {
+        static_info_.cpu_boost_clock_ghz = -1.0f;
+    }
+
+    // Neither is exposed to userspace without root (DMI tables) or swapon,
+    // so they stay empty rather than guessed
+    static_info_.ram_type.clear();
+    static_info_.swap_priority.clear();
+}
+
+bool SystemMetricsSampler::readCpuTimes(CpuTimes& times) {
+    // Only the aggregate "cpu" line at the top is needed
+    char buffer[512];
+    if (preadFile(stat_fd_, buffer, sizeof(buffer)) <= 0 || std::strncmp(buffer, "cpu ", 4) != 0) {
+        return false;
+    }
+
+    // user nice system idle iowait irq softirq steal (guest is already in user)
+    uint64_t fields[8] = {};
+    char* cursor = buffer + 4;
+    for (int i = 0; i < 8; ++i) {
+        char* end = nullptr;
+        fields[i] = std::strtoull(cursor, &end, 10);
+        if (end == cursor) {
+            break;
+        }
+        cursor = end;
+    }
+
+    uint64_t idle = fields[3] + fields[4];
+    times.total = 0;
+    for (uint64_t field : fields) {
+        times.total += field;
+    }
+    times.busy = times.total - idle;
+    return true;
+}
+
+bool SystemMetricsSampler::readMemory(SystemInfo& info) {
+    char buffer[8192];
+    if (preadFile(meminfo_fd_, buffer, sizeof(buffer)) <= 0) {
+        return false;
+    }
+
+    long long total_kb = meminfoValue(buffer, "MemTotal");
+    long long available_kb = meminfoValue(buffer, "MemAvailable");
+    if (total_kb <= 0) {
+        return false;
+    }
+    if (available_kb < 0) {
+        // Kernels before 3.14 lack MemAvailable
+        available_kb = std::max(0LL, meminfoValue(buffer, "MemFree")) +
+                       std::max(0LL, meminfoValue(buffer, "Buffers")) +
+                       std::max(0LL, meminfoValue(buffer, "Cached"));
+    }
+    long long used_kb = std::max(0LL, total_kb - available_kb);
+
+    constexpr float KB_PER_GB = 1024.0f * 1024.0f;
+    info.ram_total_gb = total_kb / KB_PER_GB;
+    info.ram_used_gb = used_kb / KB_PER_GB;
+    info.ram_available_gb = available_kb / KB_PER_GB;
+    info.ram_usage_percent = static_cast<int>(used_kb * 100 / total_kb);
+
+    long long swap_total_kb = std::max(0LL, meminfoValue(buffer, "SwapTotal"));
+    long long swap_free_kb = std::max(0LL, meminfoValue(buffer, "SwapFree"));
+    long long swap_used_kb = std::max(0LL, swap_total_kb - swap_free_kb);
+    info.swap_total_gb = swap_total_kb / KB_PER_GB;
+    info.swap_used_mb = swap_used_kb / 1024.0f;
+    info.swap_available_gb = swap_free_kb / KB_PER_GB;
+    info.swap_usage_percent = swap_total_kb > 0 ? static_cast<int>(swap_used_kb * 100 / swap_total_kb) : 0;
+    return true;
+}
+
+bool SystemMetricsSampler::readTemperature(int& celsius) {
+    char buffer[32];
+    if (preadFile(thermal_fd_, buffer, sizeof(buffer)) <= 0) {
+        return false;
+    }
+    // Millidegrees Celsius; below zero is a real reading on outdoor units
+    char* end = nullptr;
+    errno = 0;
+    long millidegrees = std::strtol(buffer, &end, 10);
+    if (end == buffer || errno != 0 || (*end != '\0' && *end != '\n')) {
+        return false;
+    }
+    celsius = static_cast<int>(millidegrees / 1000);
+    return true;
+}
+
+void SystemMetricsSampler::sampleOnce() {
+    auto next = std::make_shared<Snapshot>();
+    SystemInfo& info = next->system;
+    info = static_info_;
+
+    CpuTimes cpu;
+    if (readCpuTimes(cpu)) {
+        uint64_t total_diff = cpu.total - previous_cpu_.total;
+        uint64_t busy_diff = cpu.busy - previous_cpu_.busy;
+        if (total_diff > 0 && busy_diff <= total_diff) {
+            info.cpu_usage_percent = static_cast<int>(busy_diff * 100 / total_diff);
+        } else if (auto previous = current_.load(std::memory_order_relaxed)) {
+            // No jiffies elapsed (very short interval): keep the last figure
+            info.cpu_usage_percent = previous->system.cpu_usage_percent;
+        }
+        previous_cpu_ = cpu;
+    }
+
+    if (!readMemory(info)) {
+        // /proc/meminfo unavailable: unknown
+        info.ram_total_gb = -1.0f;
+        info.ram_used_gb = -1.0f;
+        info.ram_available_gb = -1.0f;
+        info.ram_usage_percent = -1;
+    }
+
+    if (!readTemperature(info.cpu_temp_celsius)) {
+        info.cpu_temp_celsius = SystemInfo::TEMPERATURE_UNKNOWN; // No thermal zone
+    }
+
+    next->sampled_at = std::chrono::steady_clock::now();
+    next->sequence = ++sequence_;
+    current_.store(std::move(next), std::memory_order_release);
+}
+
+void SystemMetricsSampler::start(std::chrono::milliseconds interval) {
+    std::lock_guard<std::mutex> lifecycle(lifecycle_mutex_);
+    interval_ms_.store(std::max<int64_t>(100, interval.count()), std::memory_order_relaxed);
+    if (running_.load(std::memory_order_acquire)) {
+        requestSample();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        wake_requested_ = false;
+    }
+    running_.store(true, std::memory_order_release);
+    thread_ = std::thread(&SystemMetricsSampler::run, this);
+}
+
+void SystemMetricsSampler::stop() {
+    std::lock_guard<std::mutex> lifecycle(lifecycle_mutex_);
+    if (!running_.exchange(false, std::memory_order_acq_rel)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        wake_requested_ = true;
+    }
+    wake_cv_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void SystemMetricsSampler::requestSample() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        wake_requested_ = true;
+    }
+    wake_cv_.notify_one();
+}
+
+void SystemMetricsSampler::run() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(wake_mutex_);
+            wake_cv_.wait_for(lock, std::chrono::milliseconds(interval_ms_.load(std::memory_order_relaxed)),
+                              [this]() { return wake_requested_; });
+            wake_requested_ = false;
+        }
+        if (!running_.load(std::memory_order_acquire)) {
+            return;
+        }
+        sampleOnce();
+    }
+}
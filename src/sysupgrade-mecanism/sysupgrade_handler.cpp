@@ -1,13 +1,14 @@
 
 #include "sysupgrade_handler.h"
 #include "endpoint_logger.h"
+#include "process_engine.h"
 #include "nlohmann/json.hpp"
 #include <fstream>
 #include <sstream>
 #include <regex>
 #include <cstdlib>
 #include <unistd.h>
-#include <sys/wait.h>
+#include <sys/statvfs.h>
 #include <filesystem>
 #include <iomanip>
 
@@ -135,8 +136,7 @@ void SysupgradeManager::upgradeWorker(const std::string& firmware_path, bool pre
         updateProgress(UpgradeStatus::PREPARING, 20, "preparing", "Performing pre-upgrade checks...");
         
         // Check available space
-        std::string space_check = executeCommand("df -h /tmp | tail -1 | awk '{print $4}'", true);
-        addLogEntry("Available space in /tmp: " + space_check);
+        addLogEntry("Available space in /tmp: " + availableSpace("/tmp"));
         
         if (should_cancel_) {
             throw std::runtime_error("Upgrade cancelled by user");
@@ -154,8 +154,8 @@ void SysupgradeManager::upgradeWorker(const std::string& firmware_path, bool pre
         updateProgress(UpgradeStatus::VERIFYING, 40, "verify", "Verifying firmware checksum...");
         
         // Calculate and verify checksum
-        std::string checksum_cmd = "sha256sum '" + firmware_path + "' | cut -d' ' -f1";
-        std::string firmware_checksum = executeCommand(checksum_cmd, true);
+        std::string firmware_checksum = executeCommand({"sha256sum", firmware_path}, true);
+        firmware_checksum = firmware_checksum.substr(0, firmware_checksum.find(' '));
         addLogEntry("Firmware SHA256: " + firmware_checksum);
         
         std::this_thread::sleep_for(std::chrono::seconds(2));
@@ -276,62 +276,73 @@ void SysupgradeManager::loadProgressFromFile() {
 }
 
 std::string SysupgradeManager::executeSysupgrade(const std::string& firmware_path, bool preserve_config) {
-    std::string command = "sysupgrade";
+    std::vector<std::string> argv = {"sysupgrade"};
     
     if (!preserve_config) {
-        command += " -n";
+        argv.push_back("-n");
     }
     
-    command += " -v '" + firmware_path + "'";
+    argv.push_back("-v");
+    argv.push_back(firmware_path);
     
-    addLogEntry("Executing: " + command);
+    addLogEntry("Executing: sysupgrade" + std::string(preserve_config ? "" : " -n") + " -v " + firmware_path);
     
     // Note: sysupgrade will reboot the system, so we need to handle this carefully
     // In a real implementation, you might want to run this in a way that allows
     // the system to reboot gracefully
     
     try {
-        std::string result = executeCommand(command, false);
+        executeCommand(argv, false);
         return ""; // Success (though system will reboot)
     } catch (const std::exception& e) {
         return std::string("Command execution failed: ") + e.what();
     }
 }
 
-std::string SysupgradeManager::executeCommand(const std::string& command, bool capture_output) {
-    ENDPOINT_LOG_INFO("firmware", "Executing command: " + command);
+std::string SysupgradeManager::executeCommand(const std::vector<std::string>& argv, bool capture_output) {
+    ENDPOINT_LOG_INFO("firmware", "Executing command: " + argv[0]);
     
-    if (capture_output) {
-        FILE* pipe = popen(command.c_str(), "r");
-        if (!pipe) {
-            throw std::runtime_error("popen() failed");
-        }
-        
-        std::string result;
-        char buffer[256];
-        while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-            result += buffer;
-        }
-        
-        int status = pclose(pipe);
-        if (status != 0) {
-            throw std::runtime_error("Command failed with status: " + std::to_string(status));
-        }
-        
-        // Remove trailing newline
-        if (!result.empty() && result.back() == '\n') {
-            result.pop_back();
-        }
-        
-        return result;
-    } else {
-        // For commands that don't return (like sysupgrade), just execute
-        int status = system(command.c_str());
-        if (status != 0) {
-            throw std::runtime_error("Command failed with status: " + std::to_string(status));
-        }
+    // No timeout: sysupgrade runs until the device reboots
+    ProcessEngine::Result result = ProcessEngine::getInstance().run(argv, std::chrono::milliseconds(0));
+    if (!result.error.empty()) {
+        throw std::runtime_error("Could not start " + argv[0] + ": " + result.error);
+    }
+    if (result.exit_code != 0) {
+        throw std::runtime_error("Command failed with status: " + std::to_string(result.exit_code));
+    }
+    
+    if (!capture_output) {
+        ENDPOINT_LOG_INFO("firmware", result.output);
         return "";
     }
+    
+    // Remove trailing newline
+    std::string output = std::move(result.output);
+    if (!output.empty() && output.back() == '\n') {
+        output.pop_back();
+    }
+    
+    return output;
+}
+
+// Free space on the filesystem holding `path`, formatted like `df -h`
+std::string SysupgradeManager::availableSpace(const std::string& path) {
+    struct statvfs stats{};
+    if (statvfs(path.c_str(), &stats) != 0) {
+        return "unknown";
+    }
+    
+    double bytes = static_cast<double>(stats.f_bavail) * stats.f_frsize;
+    const char* units[] = {"", "K", "M", "G", "T"};
+    int unit = 0;
+    while (bytes >= 1024.0 && unit < 4) {
+        bytes /= 1024.0;
+        ++unit;
+    }
+    
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(bytes < 10.0 && unit > 0 ? 1 : 0) << bytes << units[unit];
+    return out.str();
 }
 
 void SysupgradeManager::initializeStages() {
@@ -370,8 +381,16 @@ std::string SysupgradeManager::estimateCompletion() {
 // Static utility functions
 bool SysupgradeManager::isSysupgradeAvailable() {
     try {
-        int result = system("which sysupgrade > /dev/null 2>&1");
-        return (result == 0);
+        // Same lookup `which` did, without forking a shell for it
+        const char* path = std::getenv("PATH");
+        std::stringstream dirs(path ? path : "/usr/sbin:/usr/bin:/sbin:/bin");
+        std::string dir;
+        while (std::getline(dirs, dir, ':')) {
+            if (!dir.empty() && access((dir + "/sysupgrade").c_str(), X_OK) == 0) {
+                return true;
+            }
+        }
+        return false;
     } catch (...) {
         return false;
     }
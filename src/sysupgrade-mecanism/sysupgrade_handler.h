@@ -70,7 +70,8 @@ namespace SysupgradeHandler {
         
         // Command execution
         std::string executeSysupgrade(const std::string& firmware_path, bool preserve_config);
-        std::string executeCommand(const std::string& command, bool capture_output = true);
+        std::string executeCommand(const std::vector<std::string>& argv, bool capture_output = true);
+        static std::string availableSpace(const std::string& path);
         void parseCommandOutput(const std::string& output);
         
         // Progress tracking
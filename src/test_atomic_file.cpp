@@ -0,0 +1,150 @@
+#include "atomic_file.h"
+#include "endpoint_logger.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string& description) {
+    std::cout << (condition ? "PASS: " : "FAIL: ") << description << std::endl;
+    if (!condition) {
+        failures++;
+    }
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+void writeFile(const std::string& path, const std::string& contents) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << contents;
+}
+
+// What a crash leaves behind: the journal as it is on disk right now. close()
+// checkpoints, so the journal is put back afterwards for open() to replay.
+std::string crashImage(const std::string& journal) {
+    return readFile(journal);
+}
+
+void replayAfterCrash(const std::string& journal, const std::string& image) {
+    WriteJournal::getInstance().close();
+    writeFile(journal, image);
+    WriteJournal::getInstance().open(journal);
+}
+
+void testAtomicWrite(const std::string& dir) {
+    std::cout << "\n--- AtomicFile::write ---" << std::endl;
+    std::string path = dir + "/config.json";
+    std::string error;
+
+    check(AtomicFile::write(path, "first", error), "creates a new file");
+    check(readFile(path) == "first", "new file has its contents");
+
+    ::chmod(path.c_str(), 0600);
+    check(AtomicFile::write(path, "second", error), "replaces an existing file");
+    check(readFile(path) == "second", "replaced file has the new contents");
+    check((std::filesystem::status(path).permissions() & std::filesystem::perms::all) ==
+          (std::filesystem::perms::owner_read | std::filesystem::perms::owner_write),
+          "mode of the replaced file is kept");
+
+    check(!AtomicFile::write(dir + "/missing/config.json", "x", error) && !error.empty(),
+          "missing directory is reported");
+}
+
+void testReplay(const std::string& dir) {
+    std::cout << "\n--- Replay ---" << std::endl;
+    std::string journal = dir + "/.write-journal";
+    std::string a = dir + "/a.json";
+    std::string b = dir + "/b.json";
+    std::string error;
+    WriteJournal& writer = WriteJournal::getInstance();
+
+    check(writer.open(journal), "journal opens");
+    writer.write(a, "a1", error);
+    writer.write(a, "a2", error);
+    writer.write(b, "b1", error);
+    std::string image = crashImage(journal);
+    check(!image.empty(), "updates are in the journal until a checkpoint");
+
+    // Files lost with the page cache: replay must bring both back, latest first
+    writeFile(a, "lost");
+    writeFile(b, "lost");
+    replayAfterCrash(journal, image);
+    check(readFile(a) == "a2", "replay restores the latest update of a file");
+    check(readFile(b) == "b1", "replay restores every journaled file");
+
+    // The crash interrupted the append of b's record
+    writeFile(a, "lost");
+    writeFile(b, "old");
+    replayAfterCrash(journal, image.substr(0, image.size() - 3));
+    check(readFile(a) == "a2", "complete records before a torn one are replayed");
+    check(readFile(b) == "old", "torn final record is ignored");
+
+    // The record is complete but its bytes are not what was written
+    std::string corrupt = image;
+    corrupt[corrupt.size() - 1] ^= 0x55;
+    writeFile(a, "lost");
+    writeFile(b, "old");
+    replayAfterCrash(journal, corrupt);
+    check(readFile(a) == "a2", "records before a damaged one are replayed");
+    check(readFile(b) == "old", "record failing its CRC is ignored");
+    check(readFile(journal).empty(), "journal is emptied after replay");
+}
+
+void testDirectWriteSupersedesJournal(const std::string& dir) {
+    std::cout << "\n--- Direct write after journaled writes ---" << std::endl;
+    std::string journal = dir + "/.write-journal";
+    std::string path = dir + "/large.json";
+    std::string error;
+    WriteJournal& writer = WriteJournal::getInstance();
+
+    check(writer.open(journal), "journal opens");
+    writer.write(path, "small", error);
+    check(!readFile(journal).empty(), "small update is journaled");
+
+    // Too large to journal, so written directly
+    std::string large(WriteJournal::MAX_JOURNALED_BYTES + 1, 'x');
+    check(writer.write(path, large, error), "large update is written");
+    std::string image = crashImage(journal);
+    check(image.empty(), "older record of the file is gone from the journal");
+
+    replayAfterCrash(journal, image);
+    check(readFile(path) == large, "replay does not roll the file back to the journaled update");
+
+    // A journaled update after the direct one is replayed as usual
+    writer.write(path, "after", error);
+    image = crashImage(journal);
+    writeFile(path, "lost");
+    replayAfterCrash(journal, image);
+    check(readFile(path) == "after", "later journaled update is replayed");
+}
+
+} // namespace
+
+int main() {
+    std::cout << "Testing AtomicFile and WriteJournal..." << std::endl;
+
+    std::string dir = std::filesystem::temp_directory_path().string() + "/test_atomic_file_" + std::to_string(::getpid());
+    std::filesystem::create_directories(dir);
+
+    testAtomicWrite(dir);
+    testReplay(dir);
+    testDirectWriteSupersedesJournal(dir);
+
+    WriteJournal::getInstance().close();
+    std::filesystem::remove_all(dir);
+
+    std::cout << "\n" << (failures == 0 ? "All tests passed" : std::to_string(failures) + " test(s) failed") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
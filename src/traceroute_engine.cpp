@@ -0,0 +1,1025 @@
+#include "traceroute_engine.h"
+#include "icmp_engine.h"
+#include "endpoint_logger.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <linux/errqueue.h>
+#include <linux/icmp.h>
+#include <netdb.h>
+#include <netinet/icmp6.h>
+#include <netinet/in.h>
+#include <random>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint64_t WAKE_KEY = 0;            // Trace ids, the other keys, start at 1
+constexpr size_t PROBE_PAYLOAD = 32;        // 60-byte IPv4 packets, like traceroute
+constexpr size_t BUFFER_SIZE = 65536;
+constexpr size_t CONTROL_BUFFER_SIZE = 512;
+constexpr int SEND_RETRY_MS = 1;            // Socket buffer full: try the rest shortly
+
+constexpr uint8_t ICMP4_ECHO_REQUEST = 8;
+constexpr uint8_t ICMP4_ECHO_REPLY = 0;
+constexpr uint8_t ICMP6_ECHO_REQUEST_TYPE = 128;
+constexpr uint8_t ICMP6_ECHO_REPLY_TYPE = 129;
+constexpr uint8_t TCP_SYN = 0x02;
+constexpr uint8_t TCP_RST = 0x04;
+constexpr uint8_t TCP_ACK = 0x10;
+
+uint16_t read16(const uint8_t* data) {
+    return static_cast<uint16_t>(data[0] << 8 | data[1]);
+}
+
+uint32_t read32(const uint8_t* data) {
+    return static_cast<uint32_t>(data[0]) << 24 | static_cast<uint32_t>(data[1]) << 16 |
+           static_cast<uint32_t>(data[2]) << 8 | data[3];
+}
+
+void write16(uint8_t* data, uint16_t value) {
+    data[0] = static_cast<uint8_t>(value >> 8);
+    data[1] = static_cast<uint8_t>(value);
+}
+
+void write32(uint8_t* data, uint32_t value) {
+    write16(data, static_cast<uint16_t>(value >> 16));
+    write16(data + 2, static_cast<uint16_t>(value));
+}
+
+// Internet checksum arithmetic: sum 16-bit words, then fold the carries
+uint32_t addWords(const uint8_t* data, size_t length, uint32_t sum = 0) {
+    for (size_t i = 0; i + 1 < length; i += 2) {
+        sum += read16(data + i);
+    }
+    if (length & 1) {
+        sum += static_cast<uint32_t>(data[length - 1] << 8);
+    }
+    return sum;
+}
+
+uint16_t fold(uint32_t sum) {
+    while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return static_cast<uint16_t>(sum);
+}
+
+// IPv4 pseudo header for UDP/TCP checksums
+uint32_t pseudoHeaderSum(const sockaddr_in& source, const sockaddr_in& target, uint8_t protocol, size_t length) {
+    uint8_t header[12];
+    std::memcpy(header, &source.sin_addr, 4);
+    std::memcpy(header + 4, &target.sin_addr, 4);
+    header[8] = 0;
+    header[9] = protocol;
+    write16(header + 10, static_cast<uint16_t>(length));
+    return addWords(header, sizeof(header));
+}
+
+double millisecondsBetween(const timespec& from, const timespec& to) {
+    return (to.tv_sec - from.tv_sec) * 1000.0 + (to.tv_nsec - from.tv_nsec) / 1e6;
+}
+
+bool sameAddress(const sockaddr_storage& a, const sockaddr_storage& b) {
+    if (a.ss_family != b.ss_family) {
+        return false;
+    }
+    if (a.ss_family == AF_INET) {
+        return reinterpret_cast<const sockaddr_in&>(a).sin_addr.s_addr ==
+               reinterpret_cast<const sockaddr_in&>(b).sin_addr.s_addr;
+    }
+    return std::memcmp(&reinterpret_cast<const sockaddr_in6&>(a).sin6_addr,
+                       &reinterpret_cast<const sockaddr_in6&>(b).sin6_addr, sizeof(in6_addr)) == 0;
+}
+
+socklen_t addressLength(int family) {
+    return family == AF_INET6 ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+}
+
+uint16_t portOf(const sockaddr_storage& address) {
+    return ntohs(address.ss_family == AF_INET6 ? reinterpret_cast<const sockaddr_in6&>(address).sin6_port
+                                               : reinterpret_cast<const sockaddr_in&>(address).sin_port);
+}
+
+void setPort(sockaddr_storage& address, uint16_t port) {
+    if (address.ss_family == AF_INET6) {
+        reinterpret_cast<sockaddr_in6&>(address).sin6_port = htons(port);
+    } else {
+        reinterpret_cast<sockaddr_in&>(address).sin_port = htons(port);
+    }
+}
+
+bool canOpen(int family, int type, int protocol) {
+    int fd = ::socket(family, type | SOCK_CLOEXEC, protocol);
+    if (fd < 0) {
+        return false;
+    }
+    ::close(fd);
+    return true;
+}
+
+int icmpProtocol(int family) {
+    return family == AF_INET6 ? static_cast<int>(IPPROTO_ICMPV6) : static_cast<int>(IPPROTO_ICMP);
+}
+
+void setTtl(int fd, int family, int ttl) {
+    if (family == AF_INET6) {
+        ::setsockopt(fd, IPPROTO_IPV6, IPV6_UNICAST_HOPS, &ttl, sizeof(ttl));
+    } else {
+        ::setsockopt(fd, IPPROTO_IP, IP_TTL, &ttl, sizeof(ttl));
+    }
+}
+
+// Annotations as printed by traceroute(8). `reached` is set when the
+// message proves the probe got to the target.
+std::string annotate(const sock_extended_err& error, bool from_target, bool& reached) {
+    reached = false;
+    if (error.ee_origin == SO_EE_ORIGIN_ICMP) {
+        if (error.ee_type == ICMP_TIME_EXCEEDED) {
+            return "";
+        }
+        if (error.ee_type != ICMP_DEST_UNREACH) {
+            return "!" + std::to_string(error.ee_type);
+        }
+        reached = from_target;
+        switch (error.ee_code) {
+        case ICMP_PORT_UNREACH: return "";
+        case ICMP_PROT_UNREACH: return from_target ? "" : "!P";
+        case ICMP_NET_UNREACH:
+        case ICMP_NET_UNKNOWN: return "!N";
+        case ICMP_HOST_UNREACH:
+        case ICMP_HOST_UNKNOWN: return "!H";
+        case ICMP_FRAG_NEEDED: return "!F-" + std::to_string(error.ee_info);
+        case ICMP_SR_FAILED: return "!S";
+        case ICMP_NET_ANO:
+        case ICMP_HOST_ANO:
+        case ICMP_PKT_FILTERED: return "!X";
+        default: return "!<" + std::to_string(error.ee_code) + ">";
+        }
+    }
+    if (error.ee_origin == SO_EE_ORIGIN_ICMP6) {
+        if (error.ee_type == ICMP6_TIME_EXCEEDED) {
+            return "";
+        }
+        if (error.ee_type == ICMP6_PACKET_TOO_BIG) {
+            return "!F-" + std::to_string(error.ee_info);
+        }
+        if (error.ee_type != ICMP6_DST_UNREACH) {
+            return "!" + std::to_string(error.ee_type);
+        }
+        reached = from_target;
+        switch (error.ee_code) {
+        case ICMP6_DST_UNREACH_NOPORT: return "";
+        case ICMP6_DST_UNREACH_NOROUTE: return "!N";
+        case ICMP6_DST_UNREACH_ADMIN: return "!X";
+        case ICMP6_DST_UNREACH_ADDR: return "!H";
+        default: return "!<" + std::to_string(error.ee_code) + ">";
+        }
+    }
+    return std::strerror(static_cast<int>(error.ee_errno));
+}
+
+} // namespace
+
+struct TracerouteEngine::Trace {
+    enum class Mode {
+        ICMP,           // Echo requests on one ICMP socket
+        RAW_TRANSPORT,  // Hand-built UDP or TCP headers on one raw IPv4 socket
+        UDP_SOCKET      // Payload-only probes on one UDP socket, a port per probe
+    };
+
+    struct Probe {
+        int hop = 0;                // 0 until sent
+        timespec sent{};
+        std::chrono::steady_clock::time_point deadline;
+        bool settled = false;
+        bool answered = false;
+        bool reached = false;
+        double rtt_ms = 0.0;
+        std::string annotation;
+    };
+
+    uint64_t id = 0;
+    Options options;
+    Result result;
+    Mode mode = Mode::ICMP;
+    int family = AF_INET;
+    bool raw = false;               // Raw ICMP socket: replies to other pingers are visible
+    int fd = -1;
+    uint16_t ident = 0;             // ICMP identifier, or source port of raw UDP/TCP probes
+    uint32_t sequence_base = 0;     // TCP
+    sockaddr_in source{};           // Pseudo header of raw UDP/TCP probes
+
+    std::vector<Probe> probes;      // (hop - 1) * queries + query
+    size_t next_send = 0;           // Position in send order (query-major)
+    std::vector<std::string> addresses;     // Per hop: first responder
+    std::vector<std::string> names;         // Per hop: PTR name
+    std::vector<int> lookup_state;          // Per hop: 0 none, 1 pending, 2 done
+    int reached_hop = 0;
+    int next_hop = 1;               // Next hop to report
+    bool stopped = false;
+
+    ~Trace() {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    int lastHop() const { return reached_hop ? reached_hop : options.max_hops; }
+    size_t probeCount() const { return static_cast<size_t>(options.max_hops * options.queries); }
+    bool allSent() const { return next_send >= probeCount(); }
+};
+
+TracerouteEngine& TracerouteEngine::getInstance() {
+    static TracerouteEngine instance;
+    return instance;
+}
+
+TracerouteEngine::TracerouteEngine() : buffer_(BUFFER_SIZE) {
+    epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (epoll_fd_ < 0 || wake_fd_ < 0) {
+        ENDPOINT_LOG("traceroute-engine", "Failed to create epoll/eventfd: " + std::string(std::strerror(errno)));
+        return;
+    }
+
+    struct epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = WAKE_KEY;
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event);
+
+    for (size_t i = 0; i < RESOLVER_THREADS; ++i) {
+        resolvers_.emplace_back(&TracerouteEngine::resolverLoop, this);
+    }
+    thread_ = std::thread(&TracerouteEngine::reactorLoop, this);
+}
+
+TracerouteEngine::~TracerouteEngine() {
+    shutdown();
+    if (wake_fd_ >= 0) {
+        ::close(wake_fd_);
+    }
+    if (epoll_fd_ >= 0) {
+        ::close(epoll_fd_);
+    }
+}
+
+bool TracerouteEngine::supports(Protocol protocol, int family) {
+    if (family != AF_INET && family != AF_INET6) {
+        return false;
+    }
+    switch (protocol) {
+    case Protocol::ICMP:
+        return canOpen(family, SOCK_DGRAM, icmpProtocol(family)) || canOpen(family, SOCK_RAW, icmpProtocol(family));
+    case Protocol::UDP:
+        return true;
+    case Protocol::TCP:
+        // SYN probes are built by hand
+        return family == AF_INET && canOpen(AF_INET, SOCK_RAW, IPPROTO_TCP);
+    }
+    return false;
+}
+
+bool TracerouteEngine::openSocket(Trace& trace, std::string& error) {
+    const Options& options = trace.options;
+    int family = trace.family;
+
+    auto failed = [&](const std::string& what) {
+        error = what + ": " + std::strerror(errno);
+        return false;
+    };
+
+    auto configure = [&](int fd) {
+        int on = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+        if (family == AF_INET6) {
+            ::setsockopt(fd, IPPROTO_IPV6, IPV6_RECVERR, &on, sizeof(on));
+            if (options.dont_fragment) {
+                int pmtu = IPV6_PMTUDISC_DO;
+                ::setsockopt(fd, IPPROTO_IPV6, IPV6_MTU_DISCOVER, &pmtu, sizeof(pmtu));
+            }
+        } else {
+            ::setsockopt(fd, IPPROTO_IP, IP_RECVERR, &on, sizeof(on));
+            if (options.dont_fragment) {
+                int pmtu = IP_PMTUDISC_DO;
+                ::setsockopt(fd, IPPROTO_IP, IP_MTU_DISCOVER, &pmtu, sizeof(pmtu));
+            }
+        }
+    };
+
+    int fd;
+    if (trace.mode == Trace::Mode::UDP_SOCKET) {
+        fd = ::socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return failed("cannot open UDP socket");
+        }
+    } else if (trace.mode == Trace::Mode::ICMP) {
+        fd = ::socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, icmpProtocol(family));
+        if (fd < 0) {
+            fd = ::socket(family, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, icmpProtocol(family));
+            trace.raw = true;
+        }
+        if (fd < 0) {
+            return failed("cannot open ICMP socket");
+        }
+    } else {
+        fd = ::socket(AF_INET, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                      options.protocol == Protocol::TCP ? IPPROTO_TCP : IPPROTO_UDP);
+        if (fd < 0) {
+            return failed("cannot open raw socket");
+        }
+    }
+    trace.fd = fd;
+    configure(fd);
+
+    // Every probe of the trace sits in this socket's buffer at once, and so
+    // can every answer: queued errors carry the whole ICMP message
+    int buffer = 1024 * 1024;
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buffer, sizeof(buffer));
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+
+    if (trace.raw) {
+        // Router messages come through the error queue; only echo replies
+        // are read off the socket itself
+        if (family == AF_INET6) {
+            struct icmp6_filter filter;
+            ICMP6_FILTER_SETBLOCKALL(&filter);
+            ICMP6_FILTER_SETPASS(ICMP6_ECHO_REPLY_TYPE, &filter);
+            ::setsockopt(fd, IPPROTO_ICMPV6, ICMP6_FILTER, &filter, sizeof(filter));
+        } else {
+            struct icmp_filter filter{};
+            filter.data = ~(1U << ICMP4_ECHO_REPLY);
+            ::setsockopt(fd, SOL_RAW, ICMP_FILTER, &filter, sizeof(filter));
+        }
+    }
+
+    if (trace.mode == Trace::Mode::UDP_SOCKET) {
+        return true;    // Unconnected: each probe goes to its own port
+    }
+
+    // Connected sockets only see traffic from (and errors about) the target
+    sockaddr_storage target = options.address;
+    setPort(target, 0);
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&target), addressLength(family)) != 0) {
+        return failed("cannot connect socket");
+    }
+
+    if (trace.mode == Trace::Mode::RAW_TRANSPORT) {
+        socklen_t length = sizeof(trace.source);
+        if (::getsockname(fd, reinterpret_cast<sockaddr*>(&trace.source), &length) != 0) {
+            return failed("cannot determine source address");
+        }
+    }
+    return true;
+}
+
+uint64_t TracerouteEngine::start(Options options) {
+    auto trace = std::make_unique<Trace>();
+    trace->options = std::move(options);
+
+    auto fail = [&](const std::string& error) -> uint64_t {
+        trace->result.error = error;
+        ENDPOINT_LOG("traceroute-engine", "Cannot trace " +
+                     IcmpEngine::formatAddress(reinterpret_cast<const sockaddr*>(&trace->options.address)) + ": " + error);
+        if (trace->options.on_done) {
+            trace->options.on_done(trace->result);
+        }
+        return 0;
+    };
+
+    const Options& requested = trace->options;
+    trace->family = requested.address.ss_family;
+    if (trace->family != AF_INET && trace->family != AF_INET6) {
+        return fail("unsupported address family");
+    }
+    if (requested.max_hops < 1 || requested.max_hops > MAX_HOPS ||
+        requested.queries < 1 || requested.queries > MAX_QUERIES) {
+        return fail("invalid options");
+    }
+
+    switch (requested.protocol) {
+    case Protocol::ICMP:
+        trace->mode = Trace::Mode::ICMP;
+        break;
+    case Protocol::TCP:
+        if (trace->family != AF_INET) {
+            return fail("TCP traces need IPv4");
+        }
+        trace->mode = Trace::Mode::RAW_TRANSPORT;
+        break;
+    case Protocol::UDP:
+        trace->mode = trace->family == AF_INET && canOpen(AF_INET, SOCK_RAW, IPPROTO_UDP)
+            ? Trace::Mode::RAW_TRANSPORT : Trace::Mode::UDP_SOCKET;
+        // One destination port per probe, all of them valid
+        if (trace->mode == Trace::Mode::UDP_SOCKET &&
+            (requested.port == 0 || requested.port + trace->probeCount() > 65536)) {
+            return fail("invalid port range");
+        }
+        break;
+    }
+
+    // Identifiers that cannot be mistaken for IcmpEngine's (the pid) or for
+    // a local ephemeral port
+    std::random_device random;
+    uint16_t pid_ident = static_cast<uint16_t>(::getpid() & 0xffff);
+    do {
+        trace->ident = trace->mode == Trace::Mode::RAW_TRANSPORT
+            ? static_cast<uint16_t>(20000 + random() % 12000)
+            : static_cast<uint16_t>(random());
+    } while (trace->ident == pid_ident);
+    trace->sequence_base = random();
+
+    std::string error;
+    if (!openSocket(*trace, error)) {
+        return fail(error);
+    }
+
+    size_t hops = static_cast<size_t>(requested.max_hops);
+    trace->probes.resize(trace->probeCount());
+    trace->addresses.resize(hops);
+    trace->names.resize(hops);
+    trace->lookup_state.assign(hops, 0);
+
+    uint64_t id = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_.load() || epoll_fd_ < 0) {
+            error = "traceroute engine is not running";
+        } else {
+            id = trace->id = ++next_id_;
+            live_.insert(id);
+            pending_.push_back(std::move(trace));
+        }
+    }
+    if (trace) {
+        return fail(error);
+    }
+
+    wake();
+    return id;
+}
+
+bool TracerouteEngine::stop(uint64_t id) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!live_.count(id)) {
+            return false;
+        }
+        stop_requests_.push_back(id);
+    }
+    wake();
+    return true;
+}
+
+size_t TracerouteEngine::activeCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return live_.size();
+}
+
+void TracerouteEngine::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_.exchange(true)) {
+            return;
+        }
+    }
+    {
+        // Under the queue lock so no resolver misses the flag
+        std::lock_guard<std::mutex> lock(lookup_mutex_);
+        lookup_cv_.notify_all();
+    }
+    wake();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    for (auto& resolver : resolvers_) {
+        resolver.join();
+    }
+    resolvers_.clear();
+}
+
+void TracerouteEngine::wake() {
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t written = ::write(wake_fd_, &one, sizeof(one));
+}
+
+void TracerouteEngine::resolverLoop() {
+    while (true) {
+        Lookup lookup;
+        {
+            std::unique_lock<std::mutex> lock(lookup_mutex_);
+            lookup_cv_.wait(lock, [this]() { return stopping_.load() || !lookups_.empty(); });
+            if (stopping_.load()) {
+                return;
+            }
+            lookup = std::move(lookups_.front());
+            lookups_.pop_front();
+        }
+
+        char host[NI_MAXHOST];
+        if (::getnameinfo(reinterpret_cast<const sockaddr*>(&lookup.address), addressLength(lookup.address.ss_family),
+                          host, sizeof(host), nullptr, 0, NI_NAMEREQD) == 0) {
+            lookup.name = host;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            resolved_.push_back(std::move(lookup));
+        }
+        wake();
+    }
+}
+
+void TracerouteEngine::adoptPending() {
+    std::vector<std::unique_ptr<Trace>> adopted;
+    std::vector<uint64_t> stops;
+    std::vector<Lookup> lookups;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        adopted.swap(pending_);
+        stops.swap(stop_requests_);
+        lookups.swap(resolved_);
+    }
+
+    for (auto& trace : adopted) {
+        struct epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = trace->id;
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, trace->fd, &event);
+        uint64_t id = trace->id;
+        traces_.emplace(id, std::move(trace));
+    }
+    for (uint64_t id : stops) {
+        auto it = traces_.find(id);
+        if (it != traces_.end()) {
+            it->second->stopped = true;
+        }
+    }
+    for (auto& lookup : lookups) {
+        auto it = traces_.find(lookup.trace);
+        if (it != traces_.end()) {
+            it->second->names[lookup.hop - 1] = std::move(lookup.name);
+            it->second->lookup_state[lookup.hop - 1] = 2;
+        }
+    }
+}
+
+void TracerouteEngine::reactorLoop() {
+    std::vector<epoll_event> events(64);
+
+    while (!stopping_.load()) {
+        adoptPending();
+
+        std::vector<uint64_t> done;
+        for (auto& [id, trace] : traces_) {
+            if (!trace->stopped) {
+                sendProbes(*trace);
+                checkDeadlines(*trace);
+                reportHops(*trace);
+            }
+            if (trace->stopped || trace->next_hop > trace->lastHop()) {
+                done.push_back(id);
+            }
+        }
+        for (uint64_t id : done) {
+            finish(id);
+        }
+
+        int ready = ::epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), nextTimeoutMs());
+        for (int i = 0; i < ready; ++i) {
+            uint64_t key = events[i].data.u64;
+            if (key == WAKE_KEY) {
+                uint64_t count;
+                [[maybe_unused]] ssize_t drained = ::read(wake_fd_, &count, sizeof(count));
+                continue;
+            }
+            auto it = traces_.find(key);
+            if (it == traces_.end()) {
+                continue;
+            }
+            if (events[i].events & EPOLLERR) {
+                receiveErrors(*it->second);
+            }
+            if (events[i].events & EPOLLIN) {
+                receive(*it->second);
+            }
+        }
+    }
+
+    // Shutting down: everything still queued or running ends cancelled
+    adoptPending();
+    for (auto& [id, trace] : traces_) {
+        trace->stopped = true;
+    }
+    while (!traces_.empty()) {
+        finish(traces_.begin()->first);
+    }
+}
+
+void TracerouteEngine::sendProbes(Trace& trace) {
+    const Options& options = trace.options;
+    uint8_t packet[64];
+    int current_ttl = -1;
+
+    while (!trace.allSent()) {
+        // Query-major order: the queries of one router are spread over the
+        // whole burst, which keeps clear of ICMP rate limits
+        size_t position = trace.next_send;
+        int hop = static_cast<int>(position % options.max_hops) + 1;
+        int query = static_cast<int>(position / options.max_hops);
+        size_t index = static_cast<size_t>((hop - 1) * options.queries + query);
+        if (trace.reached_hop && hop > trace.reached_hop) {
+            ++trace.next_send;
+            continue;
+        }
+
+        int fd = trace.fd;
+        if (current_ttl != hop) {
+            setTtl(fd, trace.family, hop);
+            current_ttl = hop;
+        }
+
+        size_t length = 0;
+        std::memset(packet, 0, sizeof(packet));
+        if (trace.mode == Trace::Mode::ICMP) {
+            // The payload starts with the complement of the sequence number,
+            // so every probe carries the same checksum
+            uint16_t sequence = static_cast<uint16_t>(index + 1);
+            length = 8 + PROBE_PAYLOAD;
+            packet[0] = trace.family == AF_INET6 ? ICMP6_ECHO_REQUEST_TYPE : ICMP4_ECHO_REQUEST;
+            write16(packet + 4, trace.ident);
+            write16(packet + 6, sequence);
+            write16(packet + 8, static_cast<uint16_t>(~sequence));
+            if (trace.family == AF_INET) {
+                write16(packet + 2, static_cast<uint16_t>(~fold(addWords(packet, length))));
+            }
+        } else if (trace.mode == Trace::Mode::RAW_TRANSPORT && options.protocol == Protocol::UDP) {
+            // Fixed ports; the probe number is the UDP checksum, reached by
+            // choosing the first two payload bytes
+            const auto& target = reinterpret_cast<const sockaddr_in&>(options.address);
+            uint16_t checksum = static_cast<uint16_t>(index + 1);
+            length = 8 + PROBE_PAYLOAD;
+            write16(packet, trace.ident);
+            write16(packet + 2, options.port);
+            write16(packet + 4, static_cast<uint16_t>(length));
+            uint16_t partial = fold(addWords(packet, length, pseudoHeaderSum(trace.source, target, IPPROTO_UDP, length)));
+            write16(packet + 8, fold(static_cast<uint32_t>(static_cast<uint16_t>(~checksum)) +
+                                     static_cast<uint16_t>(~partial)));
+            write16(packet + 6, checksum);
+        } else if (trace.mode == Trace::Mode::RAW_TRANSPORT) {
+            // SYN from a fixed port; the probe number is the sequence number
+            const auto& target = reinterpret_cast<const sockaddr_in&>(options.address);
+            length = 24;
+            write16(packet, trace.ident);
+            write16(packet + 2, options.port);
+            write32(packet + 4, trace.sequence_base + static_cast<uint32_t>(index));
+            packet[12] = 6 << 4;                    // Header length with the MSS option
+            packet[13] = TCP_SYN;
+            write16(packet + 14, 64240);
+            packet[20] = 2;                         // MSS 1460
+            packet[21] = 4;
+            write16(packet + 22, 1460);
+            write16(packet + 16, static_cast<uint16_t>(~fold(addWords(packet, length,
+                pseudoHeaderSum(trace.source, target, IPPROTO_TCP, length)))));
+        } else {
+            length = PROBE_PAYLOAD;
+        }
+
+        Trace::Probe& probe = trace.probes[index];
+        ::clock_gettime(CLOCK_REALTIME, &probe.sent);
+        ssize_t sent;
+        if (trace.mode == Trace::Mode::UDP_SOCKET) {
+            // An answer to an earlier probe may be pending as the socket
+            // error, which sendto() would return instead of sending; it is
+            // on the error queue as well, so clear it
+            int pending = 0;
+            socklen_t pending_length = sizeof(pending);
+            ::getsockopt(fd, SOL_SOCKET, SO_ERROR, &pending, &pending_length);
+
+            sockaddr_storage target = options.address;
+            setPort(target, static_cast<uint16_t>(options.port + index));
+            sent = ::sendto(fd, packet, length, 0, reinterpret_cast<const sockaddr*>(&target),
+                            addressLength(trace.family));
+        } else {
+            sent = ::send(fd, packet, length, 0);
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)) {
+            return;     // Resumed from the reactor loop
+        }
+
+        probe.hop = hop;
+        probe.deadline = std::chrono::steady_clock::now() + options.timeout;
+        ++trace.next_send;
+        if (sent < 0) {
+            settle(trace, index, nullptr, nullptr, std::strerror(errno), false);
+        }
+    }
+}
+
+void TracerouteEngine::receive(Trace& trace) {
+    const Options& options = trace.options;
+    int fd = trace.fd;
+    char control[CONTROL_BUFFER_SIZE];
+
+    while (true) {
+        sockaddr_storage from{};
+        struct iovec iov{buffer_.data(), buffer_.size()};
+        struct msghdr message{};
+        message.msg_name = &from;
+        message.msg_namelen = sizeof(from);
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        ssize_t n = ::recvmsg(fd, &message, MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+
+        timespec received{};
+        bool stamped = false;
+        for (cmsghdr* header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+            if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_TIMESTAMPNS) {
+                std::memcpy(&received, CMSG_DATA(header), sizeof(received));
+                stamped = true;
+            }
+        }
+
+        const uint8_t* data = buffer_.data();
+        size_t length = static_cast<size_t>(n);
+        size_t index = SIZE_MAX;
+
+        if (trace.mode == Trace::Mode::UDP_SOCKET) {
+            // A service answered the probe itself, from the port it was sent to
+            if (!sameAddress(from, options.address)) {
+                continue;
+            }
+            index = static_cast<uint16_t>(portOf(from) - options.port);
+        } else if (trace.mode == Trace::Mode::ICMP) {
+            if (trace.raw && trace.family == AF_INET) {
+                size_t header_length = static_cast<size_t>(data[0] & 0x0f) * 4;
+                if (length < header_length) {
+                    continue;
+                }
+                data += header_length;
+                length -= header_length;
+            }
+            uint8_t reply_type = trace.family == AF_INET6 ? ICMP6_ECHO_REPLY_TYPE : ICMP4_ECHO_REPLY;
+            if (length < 8 || data[0] != reply_type || (trace.raw && read16(data + 4) != trace.ident)) {
+                continue;
+            }
+            index = static_cast<size_t>(read16(data + 6)) - 1;
+        } else if (options.protocol == Protocol::TCP) {
+            // Raw IPv4 sockets deliver the IP header; SYN-ACK or RST from the target
+            size_t header_length = static_cast<size_t>(data[0] & 0x0f) * 4;
+            if (length < header_length + 20) {
+                continue;
+            }
+            const uint8_t* tcp = data + header_length;
+            uint8_t flags = tcp[13];
+            bool answer = (flags & TCP_RST) || ((flags & TCP_SYN) && (flags & TCP_ACK));
+            if (!answer || read16(tcp) != options.port || read16(tcp + 2) != trace.ident) {
+                continue;
+            }
+            index = static_cast<size_t>(read32(tcp + 8) - 1 - trace.sequence_base);
+        } else {
+            continue;   // Raw UDP: the target answers through the error queue
+        }
+
+        if (index < trace.probes.size() && trace.probes[index].hop != 0) {
+            settle(trace, index, &from, stamped ? &received : nullptr, "", true);
+        }
+    }
+}
+
+void TracerouteEngine::receiveErrors(Trace& trace) {
+    const Options& options = trace.options;
+    int fd = trace.fd;
+    char control[CONTROL_BUFFER_SIZE];
+
+    while (true) {
+        sockaddr_storage target{};
+        struct iovec iov{buffer_.data(), buffer_.size()};
+        struct msghdr message{};
+        message.msg_name = &target;
+        message.msg_namelen = sizeof(target);
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        ssize_t n = ::recvmsg(fd, &message, MSG_ERRQUEUE | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+
+        const sock_extended_err* error = nullptr;
+        timespec received{};
+        bool stamped = false;
+        for (cmsghdr* header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+            if ((header->cmsg_level == IPPROTO_IP && header->cmsg_type == IP_RECVERR) ||
+                (header->cmsg_level == IPPROTO_IPV6 && header->cmsg_type == IPV6_RECVERR)) {
+                error = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(header));
+            } else if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_TIMESTAMPNS) {
+                std::memcpy(&received, CMSG_DATA(header), sizeof(received));
+                stamped = true;
+            }
+        }
+        if (!error) {
+            continue;
+        }
+
+        // The queued payload is the probe header quoted by the router
+        const uint8_t* quoted = buffer_.data();
+        size_t length = static_cast<size_t>(n);
+        size_t index = SIZE_MAX;
+        if (trace.mode == Trace::Mode::UDP_SOCKET) {
+            // Datagram sockets quote only the payload, but name the probe's
+            // destination, whose port is the probe number
+            index = static_cast<uint16_t>(portOf(target) - options.port);
+        } else if (length < 8) {
+            continue;
+        } else if (trace.mode == Trace::Mode::ICMP) {
+            if (trace.raw && read16(quoted + 4) != trace.ident) {
+                continue;
+            }
+            index = static_cast<size_t>(read16(quoted + 6)) - 1;
+        } else {
+            if (read16(quoted) != trace.ident || read16(quoted + 2) != options.port) {
+                continue;
+            }
+            index = options.protocol == Protocol::TCP
+                ? static_cast<size_t>(read32(quoted + 4) - trace.sequence_base)
+                : static_cast<size_t>(read16(quoted + 6)) - 1;
+        }
+        if (index >= trace.probes.size() || trace.probes[index].hop == 0) {
+            continue;
+        }
+
+        if (error->ee_origin != SO_EE_ORIGIN_ICMP && error->ee_origin != SO_EE_ORIGIN_ICMP6) {
+            // Local failure (no route, message too long): nothing answered
+            settle(trace, index, nullptr, nullptr, std::strerror(static_cast<int>(error->ee_errno)), false);
+            continue;
+        }
+
+        sockaddr_storage from{};
+        const sockaddr* offender = SO_EE_OFFENDER(error);
+        std::memcpy(&from, offender, addressLength(offender->sa_family));
+        bool reached = false;
+        std::string annotation = annotate(*error, sameAddress(from, options.address), reached);
+        settle(trace, index, &from, stamped ? &received : nullptr, annotation, reached);
+    }
+}
+
+void TracerouteEngine::settle(Trace& trace, size_t probe_index, const sockaddr_storage* from,
+                              const timespec* received, const std::string& annotation, bool reached) {
+    Trace::Probe& probe = trace.probes[probe_index];
+    if (probe.settled) {
+        return;
+    }
+    probe.settled = true;
+    probe.annotation = annotation;
+    probe.reached = reached;
+    if (reached && (trace.reached_hop == 0 || probe.hop < trace.reached_hop)) {
+        trace.reached_hop = probe.hop;
+    }
+    if (!from) {
+        return;
+    }
+
+    timespec now{};
+    if (!received) {
+        ::clock_gettime(CLOCK_REALTIME, &now);
+        received = &now;
+    }
+    probe.answered = true;
+    probe.rtt_ms = std::max(0.0, millisecondsBetween(probe.sent, *received));
+
+    size_t hop = static_cast<size_t>(probe.hop - 1);
+    if (trace.addresses[hop].empty()) {
+        trace.addresses[hop] = IcmpEngine::formatAddress(reinterpret_cast<const sockaddr*>(from));
+        if (trace.options.resolve_names) {
+            trace.lookup_state[hop] = 1;
+            Lookup lookup;
+            lookup.trace = trace.id;
+            lookup.hop = probe.hop;
+            lookup.address = *from;
+            {
+                std::lock_guard<std::mutex> lock(lookup_mutex_);
+                lookups_.push_back(std::move(lookup));
+            }
+            lookup_cv_.notify_one();
+        }
+    }
+}
+
+void TracerouteEngine::checkDeadlines(Trace& trace) {
+    auto now = std::chrono::steady_clock::now();
+    for (size_t index = 0; index < trace.probes.size(); ++index) {
+        const Trace::Probe& probe = trace.probes[index];
+        if (probe.hop != 0 && !probe.settled && probe.hop <= trace.lastHop() && probe.deadline <= now) {
+            settle(trace, index, nullptr, nullptr, "", false);
+        }
+    }
+}
+
+void TracerouteEngine::reportHops(Trace& trace) {
+    const Options& options = trace.options;
+    while (trace.next_hop <= trace.lastHop()) {
+        size_t first = static_cast<size_t>((trace.next_hop - 1) * options.queries);
+        for (int query = 0; query < options.queries; ++query) {
+            if (!trace.probes[first + query].settled) {
+                return;
+            }
+        }
+        size_t hop_index = static_cast<size_t>(trace.next_hop - 1);
+        if (trace.lookup_state[hop_index] == 1) {
+            return;     // Name still being looked up
+        }
+
+        Hop hop;
+        hop.number = trace.next_hop;
+        hop.address = trace.addresses[hop_index];
+        hop.hostname = trace.names[hop_index];
+        for (int query = 0; query < options.queries; ++query) {
+            const Trace::Probe& probe = trace.probes[first + query];
+            if (probe.answered) {
+                hop.rtts.push_back(probe.rtt_ms);
+            } else {
+                ++hop.lost;
+            }
+            if (!probe.annotation.empty()) {
+                hop.errors.push_back(probe.annotation);
+            }
+            hop.reached = hop.reached || probe.reached;
+        }
+
+        ++trace.next_hop;
+        trace.result.hops = hop.number;
+        trace.result.reached = trace.result.reached || hop.reached;
+        if (options.on_hop) {
+            try {
+                options.on_hop(hop);
+            } catch (const std::exception& e) {
+                ENDPOINT_LOG("traceroute-engine", "Hop callback threw: " + std::string(e.what()));
+            }
+        }
+    }
+}
+
+void TracerouteEngine::finish(uint64_t id) {
+    auto it = traces_.find(id);
+    if (it == traces_.end()) {
+        return;
+    }
+    std::unique_ptr<Trace> trace = std::move(it->second);
+    traces_.erase(it);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        live_.erase(id);
+    }
+
+    trace->result.cancelled = trace->stopped;
+    if (trace->options.on_done) {
+        try {
+            trace->options.on_done(trace->result);
+        } catch (const std::exception& e) {
+            ENDPOINT_LOG("traceroute-engine", "Completion callback threw: " + std::string(e.what()));
+        }
+    }
+    // The socket closes with the trace, which also drops it from epoll
+}
+
+int TracerouteEngine::nextTimeoutMs() const {
+    auto next = std::chrono::steady_clock::time_point::max();
+    for (const auto& [id, trace] : traces_) {
+        if (trace->stopped) {
+            continue;
+        }
+        if (!trace->allSent()) {
+            return SEND_RETRY_MS;
+        }
+        for (const auto& probe : trace->probes) {
+            if (probe.hop != 0 && !probe.settled && probe.hop <= trace->lastHop()) {
+                next = std::min(next, probe.deadline);
+            }
+        }
+    }
+    if (next == std::chrono::steady_clock::time_point::max()) {
+        return -1;
+    }
+
+    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next - std::chrono::steady_clock::now());
+    return static_cast<int>(std::clamp<int64_t>(wait.count() + 1, 0, 60000));
+}
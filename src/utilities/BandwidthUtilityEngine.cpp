@@ -3,27 +3,23 @@
 #include "endpoint_logger.h"
 #include <sstream>
 #include <regex>
-#include <cstdlib>
-#include <unistd.h>
-#include <sys/wait.h>
-#include <signal.h>
 #include <iomanip>
 #include <algorithm>
 #include <random>
 
+std::atomic<bool> BandwidthUtilityEngine::jsonStreamUnsupported_{false};
+
 BandwidthUtilityEngine::BandwidthUtilityEngine() {
     ENDPOINT_LOG("bandwidth-engine", "BandwidthUtilityEngine initialized");
 }
 
 BandwidthUtilityEngine::~BandwidthUtilityEngine() {
-    // Stop all active tests
+    // Stop all active tests; their callbacks reference this engine
     std::lock_guard<std::mutex> lock(sessionsMutex_);
     for (auto& [testId, session] : activeSessions_) {
         if (session && session->isRunning.load()) {
-            session->shouldStop.store(true);
-            if (session->workerThread && session->workerThread->joinable()) {
-                session->workerThread->join();
-            }
+            session->cancel.cancel();
+            waitForSession(session.get());
         }
     }
     activeSessions_.clear();
@@ -46,16 +42,31 @@ std::string BandwidthUtilityEngine::startBandwidthTest(const BandwidthConfig& co
     session->startTime = std::chrono::steady_clock::now();
     session->result.startTime = std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
         std::chrono::system_clock::now().time_since_epoch()).count());
+    session->update.testId = testId;
+    session->textMode = jsonStreamUnsupported_.load();
     
-    // Start worker thread
-    session->isRunning.store(true);
-    session->workerThread = std::make_unique<std::thread>(&BandwidthUtilityEngine::runBandwidthTest, this, session.get());
-    
+    TestSession* raw = session.get();
     {
         std::lock_guard<std::mutex> lock(sessionsMutex_);
         activeSessions_[testId] = std::move(session);
     }
     
+    raw->update.phase = "connecting";
+    if (raw->progressCallback) {
+        raw->progressCallback(raw->update);
+    }
+    
+    ENDPOINT_LOG("bandwidth-engine", "Executing: iperf3 -c " + sanitizeHostname(config.targetServer) +
+                 " -p " + std::to_string(config.port));
+    
+    raw->update.phase = "testing";
+    if (raw->progressCallback) {
+        raw->progressCallback(raw->update);
+    }
+    
+    raw->isRunning.store(true);
+    spawnIperf(raw);
+    
     ENDPOINT_LOG("bandwidth-engine", "Started bandwidth test: " + testId);
     return testId;
 }
@@ -70,15 +81,9 @@ bool BandwidthUtilityEngine::stopBandwidthTest(const std::string& testId) {
     
     auto& session = it->second;
     if (session && session->isRunning.load()) {
-        session->shouldStop.store(true);
-        
-        // Kill any iperf3 processes
-        std::string killCmd = "pkill -f 'iperf3.*" + session->config.targetServer + "'";
-        system(killCmd.c_str());
-        
-        if (session->workerThread && session->workerThread->joinable()) {
-            session->workerThread->join();
-        }
+        // Terminates this test's iperf3 only
+        session->cancel.cancel();
+        waitForSession(session.get());
         
         ENDPOINT_LOG("bandwidth-engine", "Stopped bandwidth test: " + testId);
         return true;
@@ -121,135 +126,186 @@ std::vector<std::string> BandwidthUtilityEngine::getActiveTestIds() const {
     return activeIds;
 }
 
-void BandwidthUtilityEngine::runBandwidthTest(TestSession* session) {
-    if (!session) return;
+void BandwidthUtilityEngine::spawnIperf(TestSession* session) {
+    ProcessEngine::Options options;
+    options.argv = buildIperfCommand(session->config, !session->textMode);
+    options.timeout = std::chrono::seconds(session->config.duration + 30);
+    options.cancel = session->cancel;
+    options.capture_output = session->textMode;     // The summary lines give the final numbers
+    options.on_line = [this, session](const std::string& line) { handleIperfLine(session, line); };
+    options.on_exit = [this, session](const ProcessEngine::Result& exit) { handleIperfExit(session, exit); };
+    ProcessEngine::getInstance().spawn(std::move(options));
+}
+
+void BandwidthUtilityEngine::handleIperfLine(TestSession* session, const std::string& line) {
+    if (session->cancel.isCancelled()) return;
     
-    try {
-        RealtimeUpdate update;
-        update.phase = "connecting";
-        
-        if (session->progressCallback) {
-            session->progressCallback(update);
+    if (!session->textMode) {
+        if (!line.empty() && line.front() == '{') {
+            try {
+                handleStreamEvent(session, json::parse(line));
+                return;
+            } catch (const std::exception& e) {
+                ENDPOINT_LOG("bandwidth-engine", "Bad iperf3 event: " + std::string(e.what()));
+            }
         }
-        
-        std::string command = buildIperfCommand(session->config);
-        ENDPOINT_LOG("bandwidth-engine", "Executing: " + command);
-        
-        update.phase = "testing";
-        if (session->progressCallback) {
-            session->progressCallback(update);
+        if (!line.empty()) {
+            session->lastMessage = line;
         }
-        
-        std::string output;
-        int exitCode = executeCommandWithCallback(command, 
-            [session, &update](const std::string& line) {
-                if (session->shouldStop.load()) return;
-                
-                // Parse real-time output
-                BandwidthUtilityEngine* engine = nullptr; // This is a bit hacky, but works for the callback
-                if (line.find("Mbits/sec") != std::string::npos || line.find("Gbits/sec") != std::string::npos) {
-                    // Parse bandwidth line
-                    std::regex bandwidthRegex(R"(([0-9.]+)\s+(Mbits|Gbits)/sec)");
-                    std::smatch match;
-                    if (std::regex_search(line, match, bandwidthRegex)) {
-                        double speed = std::stod(match[1].str());
-                        if (match[2].str() == "Gbits") {
-                            speed *= 1000; // Convert to Mbps
-                        }
-                        update.currentMbps = speed;
-                        
-                        if (session->progressCallback) {
-                            session->progressCallback(update);
-                        }
-                    }
-                }
-            },
-            session->shouldStop,
-            session->config.duration + 30
-        );
-        
-        if (session->shouldStop.load()) {
-            std::lock_guard<std::mutex> lock(session->resultMutex);
-            session->result.success = false;
-            session->result.error = "Test stopped by user";
-            update.phase = "stopped";
-        } else if (exitCode == 0) {
-            // Parse final results from iperf3 JSON output
-            std::string jsonCommand = command + " --json";
-            std::string jsonOutput;
-            
-            FILE* pipe = popen(jsonCommand.c_str(), "r");
-            if (pipe) {
-                char buffer[1024];
-                while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-                    jsonOutput += buffer;
-                }
-                pclose(pipe);
+        return;
+    }
+    
+    // Parse real-time output
+    if (line.find("Mbits/sec") != std::string::npos || line.find("Gbits/sec") != std::string::npos) {
+        // Parse bandwidth line
+        static const std::regex bandwidthRegex(R"(([0-9.]+)\s+(Mbits|Gbits)/sec)");
+        std::smatch match;
+        if (std::regex_search(line, match, bandwidthRegex)) {
+            double speed = std::stod(match[1].str());
+            if (match[2].str() == "Gbits") {
+                speed *= 1000; // Convert to Mbps
             }
+            session->update.currentMbps = speed;
             
-            std::lock_guard<std::mutex> lock(session->resultMutex);
-            session->result.success = parseIperfOutput(jsonOutput, session->result);
+            if (session->progressCallback) {
+                session->progressCallback(session->update);
+            }
+        }
+    }
+}
+
+void BandwidthUtilityEngine::handleStreamEvent(TestSession* session, const json& event) {
+    std::string name = event.value("event", "");
+    if (!event.contains("data")) return;
+    const json& data = event["data"];
+    
+    if (name == "start" || name == "end" || name == "error") {
+        session->stream[name] = data;
+        return;
+    }
+    if (name != "interval") return;
+    
+    session->stream["intervals"].push_back(data);
+    
+    // "sum" is the test direction; a bidirectional test adds the reverse one
+    double bitsPerSecond = 0.0;
+    double bytes = 0.0;
+    double end = 0.0;
+    for (const char* key : {"sum", "sum_bidir_reverse"}) {
+        if (!data.contains(key) || !data[key].is_object()) continue;
+        const json& sum = data[key];
+        bitsPerSecond += sum.value("bits_per_second", 0.0);
+        bytes += sum.value("bytes", 0.0);
+        end = std::max(end, sum.value("end", 0.0));
+    }
+    
+    session->update.currentMbps = bitsPerSecond / 1000000.0;
+    session->update.totalDataMB += bytes / 1000000.0;
+    session->update.elapsedSeconds = static_cast<int>(end + 0.5);
+    session->update.progress = std::min(99, static_cast<int>(end * 100 / session->config.duration));
+    session->update.intervalData = data;
+    
+    if (session->progressCallback) {
+        session->progressCallback(session->update);
+    }
+}
+
+void BandwidthUtilityEngine::handleIperfExit(TestSession* session, const ProcessEngine::Result& exit) {
+    // iperf3 before 3.17 stops at the unknown option before any traffic is
+    // sent, so running the test again in text mode costs nothing
+    if (!exit.cancelled && !session->textMode && exit.exit_code != 0 && session->stream.is_null() &&
+        session->lastMessage.find("json-stream") != std::string::npos) {
+        ENDPOINT_LOG("bandwidth-engine", "iperf3 lacks --json-stream, using text output: " + session->lastMessage);
+        jsonStreamUnsupported_.store(true);
+        session->textMode = true;
+        spawnIperf(session);
+        return;
+    }
+    
+    try {
+        std::lock_guard<std::mutex> lock(session->resultMutex);
+        if (exit.cancelled) {
+            session->result.success = false;
+            session->result.error = "Test stopped by user";
+            session->update.phase = "stopped";
+        } else if (session->stream.contains("error") && !session->stream.contains("end")) {
+            session->result.success = false;
+            session->result.error = "iperf3: " + (session->stream["error"].is_string()
+                ? session->stream["error"].get<std::string>() : session->stream["error"].dump());
+            session->update.phase = "error";
+        } else if (exit.exit_code != 0) {
+            session->result.success = false;
+            session->result.error = !exit.error.empty() ? "Failed to start iperf3: " + exit.error
+                                  : !session->lastMessage.empty() ? session->lastMessage
+                                  : "iperf3 command failed with exit code " + std::to_string(exit.exit_code);
+            session->update.phase = "error";
+        } else {
+            session->result.success = session->textMode ? parseIperfOutput(exit.output, session->result)
+                                                         : parseIperfJson(session->stream, session->result);
             session->result.endTime = std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
                 std::chrono::system_clock::now().time_since_epoch()).count());
             
-            update.phase = "complete";
-            update.progress = 100;
-        } else {
-            std::lock_guard<std::mutex> lock(session->resultMutex);
-            session->result.success = false;
-            session->result.error = "iperf3 command failed with exit code " + std::to_string(exitCode);
-            update.phase = "error";
-        }
-        
-        if (session->progressCallback) {
-            session->progressCallback(update);
+            session->update.phase = session->result.success ? "complete" : "error";
+            session->update.progress = 100;
         }
-        
     } catch (const std::exception& e) {
         ENDPOINT_LOG("bandwidth-engine", "Exception in bandwidth test: " + std::string(e.what()));
         
         std::lock_guard<std::mutex> lock(session->resultMutex);
         session->result.success = false;
         session->result.error = "Exception: " + std::string(e.what());
-        
-        RealtimeUpdate update;
-        update.phase = "error";
-        if (session->progressCallback) {
-            session->progressCallback(update);
-        }
+        session->update.phase = "error";
     }
     
-    session->isRunning.store(false);
+    finishBandwidthTest(session);
 }
 
-std::string BandwidthUtilityEngine::buildIperfCommand(const BandwidthConfig& config) const {
-    std::ostringstream cmd;
+void BandwidthUtilityEngine::finishBandwidthTest(TestSession* session) {
+    if (session->progressCallback) {
+        session->progressCallback(session->update);
+    }
     
-    cmd << "timeout " << (config.duration + 30) << " iperf3 -c " << sanitizeHostname(config.targetServer);
-    cmd << " -p " << config.port;
-    cmd << " -t " << config.duration;
-    cmd << " -P " << config.parallelConnections;
-    cmd << " -i " << config.interval;
+    // Notify under the lock: a waiter may destroy the session as soon as it wakes
+    std::lock_guard<std::mutex> lock(session->resultMutex);
+    session->isRunning.store(false);
+    session->finished.notify_all();
+}
+
+void BandwidthUtilityEngine::waitForSession(TestSession* session) {
+    std::unique_lock<std::mutex> lock(session->resultMutex);
+    session->finished.wait(lock, [session]() { return !session->isRunning.load(); });
+}
+
+std::vector<std::string> BandwidthUtilityEngine::buildIperfCommand(const BandwidthConfig& config, bool jsonStream) const {
+    // The hard limit that `timeout` used to impose is the process deadline now
+    std::vector<std::string> argv = {
+        "iperf3", "-c", sanitizeHostname(config.targetServer),
+        "-p", std::to_string(config.port),
+        "-t", std::to_string(config.duration),
+        "-P", std::to_string(config.parallelConnections),
+        "-i", std::to_string(config.interval)
+    };
     
     if (config.protocol == "udp") {
-        cmd << " -u";
+        argv.push_back("-u");
         if (config.bandwidth > 0) {
-            cmd << " -b " << config.bandwidth << "M";
+            argv.insert(argv.end(), {"-b", std::to_string(config.bandwidth) + "M"});
         }
     }
     
     if (config.bidirectional) {
-        cmd << " --bidir";
+        argv.push_back("--bidir");
     }
     
     if (config.bufferSize > 0) {
-        cmd << " -l " << config.bufferSize;
+        argv.insert(argv.end(), {"-l", std::to_string(config.bufferSize)});
     }
     
-    // Add error handling
-    cmd << " 2>&1";
+    if (jsonStream) {
+        argv.push_back("--json-stream");
+    }
     
-    return cmd.str();
+    return argv;
 }
 
 bool BandwidthUtilityEngine::parseIperfOutput(const std::string& output, BandwidthResult& result) const {
@@ -265,40 +321,7 @@ bool BandwidthUtilityEngine::parseIperfOutput(const std::string& output, Bandwid
             std::string jsonPart = output.substr(jsonStart);
             
             try {
-                json iperfJson = json::parse(jsonPart);
-                result.fullResults = iperfJson;
-                
-                // Extract summary information
-                if (iperfJson.contains("end") && iperfJson["end"].contains("sum_received")) {
-                    auto sumReceived = iperfJson["end"]["sum_received"];
-                    if (sumReceived.contains("bits_per_second")) {
-                        result.downloadMbps = sumReceived["bits_per_second"].get<double>() / 1000000.0;
-                    }
-                }
-                
-                if (iperfJson.contains("end") && iperfJson["end"].contains("sum_sent")) {
-                    auto sumSent = iperfJson["end"]["sum_sent"];
-                    if (sumSent.contains("bits_per_second")) {
-                        result.uploadMbps = sumSent["bits_per_second"].get<double>() / 1000000.0;
-                    }
-                    if (sumSent.contains("bytes")) {
-                        result.totalDataMB = sumSent["bytes"].get<double>() / 1000000.0;
-                    }
-                }
-                
-                // Extract server info
-                if (iperfJson.contains("start") && iperfJson["start"].contains("connected")) {
-                    auto connected = iperfJson["start"]["connected"];
-                    if (connected.is_array() && !connected.empty()) {
-                        auto conn = connected[0];
-                        if (conn.contains("remote_host")) {
-                            result.serverInfo = conn["remote_host"].get<std::string>();
-                        }
-                    }
-                }
-                
-                return true;
-                
+                return parseIperfJson(json::parse(jsonPart), result);
             } catch (const std::exception& e) {
                 ENDPOINT_LOG("bandwidth-engine", "JSON parse error: " + std::string(e.what()));
             }
@@ -334,36 +357,59 @@ bool BandwidthUtilityEngine::parseIperfOutput(const std::string& output, Bandwid
     }
 }
 
-int BandwidthUtilityEngine::executeCommandWithCallback(const std::string& command,
-                                                     std::function<void(const std::string&)> outputCallback,
-                                                     const std::atomic<bool>& shouldStop,
-                                                     int timeoutSeconds) {
-    FILE* pipe = popen(command.c_str(), "r");
-    if (!pipe) {
-        return -1;
+bool BandwidthUtilityEngine::parseIperfJson(const json& iperfJson, BandwidthResult& result) const {
+    result.fullResults = iperfJson;
+    
+    if (!iperfJson.contains("end")) {
+        result.error = "iperf3 reported no final results";
+        return false;
     }
+    const json& end = iperfJson["end"];
     
-    char buffer[1024];
-    auto startTime = std::chrono::steady_clock::now();
+    // Extract summary information
+    if (end.contains("sum_received")) {
+        auto sumReceived = end["sum_received"];
+        if (sumReceived.contains("bits_per_second")) {
+            result.downloadMbps = sumReceived["bits_per_second"].get<double>() / 1000000.0;
+        }
+    }
     
-    while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-        if (shouldStop.load()) {
-            break;
+    if (end.contains("sum_sent")) {
+        auto sumSent = end["sum_sent"];
+        if (sumSent.contains("bits_per_second")) {
+            result.uploadMbps = sumSent["bits_per_second"].get<double>() / 1000000.0;
         }
-        
-        // Check timeout
-        auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
-            std::chrono::steady_clock::now() - startTime).count();
-        if (elapsed > timeoutSeconds) {
-            break;
+        if (sumSent.contains("bytes")) {
+            result.totalDataMB = sumSent["bytes"].get<double>() / 1000000.0;
         }
-        
-        if (outputCallback) {
-            outputCallback(std::string(buffer));
+        if (sumSent.contains("seconds")) {
+            result.actualDuration = static_cast<int>(sumSent["seconds"].get<double>() + 0.5);
+        }
+    }
+    
+    // UDP tests report jitter and loss in "sum"
+    if (end.contains("sum") && end["sum"].is_object()) {
+        auto sum = end["sum"];
+        if (sum.contains("jitter_ms")) {
+            result.jitter = sum["jitter_ms"].get<double>();
+        }
+        if (sum.contains("lost_percent")) {
+            result.packetLoss = sum["lost_percent"].get<double>();
         }
     }
     
-    return pclose(pipe);
+    // Extract server info
+    if (iperfJson.contains("start") && iperfJson["start"].contains("connected")) {
+        auto connected = iperfJson["start"]["connected"];
+        if (connected.is_array() && !connected.empty()) {
+            auto conn = connected[0];
+            if (conn.contains("remote_host")) {
+                result.serverInfo = conn["remote_host"].get<std::string>();
+            }
+        }
+    }
+    
+    return true;
 }
 
 bool BandwidthUtilityEngine::validateConfig(const BandwidthConfig& config, std::string& error) {
@@ -3,13 +3,16 @@
 #define BANDWIDTH_UTILITY_ENGINE_H
 
 #include <string>
+#include <vector>
 #include <memory>
 #include <atomic>
 #include <thread>
 #include <mutex>
 #include <functional>
 #include <chrono>
+#include <condition_variable>
 #include "../third_party/nlohmann/json.hpp"
+#include "process_engine.h"
 
 using json = nlohmann::json;
 
@@ -48,6 +51,7 @@ public:
     };
     
     struct RealtimeUpdate {
+        std::string testId;
         double currentMbps = 0.0;
         double totalDataMB = 0.0;
         int elapsedSeconds = 0;
@@ -76,33 +80,46 @@ public:
     static BandwidthConfig configFromJson(const json& j);
 
 private:
+    // A test is one iperf3 run on the shared ProcessEngine. With --json-stream
+    // every interval arrives as a JSON line that drives the live updates, and
+    // the same events rebuild the document --json would have printed for the
+    // final numbers. An iperf3 too old for --json-stream runs in text mode and
+    // the final numbers come from its summary lines.
     struct TestSession {
         std::string testId;
         BandwidthConfig config;
         std::atomic<bool> isRunning{false};
-        std::atomic<bool> shouldStop{false};
-        std::unique_ptr<std::thread> workerThread;
+        CancellationToken cancel;
         BandwidthResult result;
+        RealtimeUpdate update;          // Reactor thread only
+        json stream;                    // Events so far in --json's layout; reactor thread only
+        std::string lastMessage;        // Last line that was not an event; reactor thread only
+        bool textMode = false;
         ProgressCallback progressCallback;
         std::chrono::steady_clock::time_point startTime;
         mutable std::mutex resultMutex;
+        std::condition_variable finished;
     };
     
     mutable std::mutex sessionsMutex_;
     std::map<std::string, std::unique_ptr<TestSession>> activeSessions_;
     
-    // Worker thread functions
-    void runBandwidthTest(TestSession* session);
-    std::string buildIperfCommand(const BandwidthConfig& config) const;
+    // Set once an iperf3 rejects --json-stream; later tests go straight to text mode
+    static std::atomic<bool> jsonStreamUnsupported_;
+    
+    // Process callbacks
+    void spawnIperf(TestSession* session);
+    void handleIperfLine(TestSession* session, const std::string& line);
+    void handleStreamEvent(TestSession* session, const json& event);
+    void handleIperfExit(TestSession* session, const ProcessEngine::Result& exit);
+    void finishBandwidthTest(TestSession* session);
+    static void waitForSession(TestSession* session);
+    
+    std::vector<std::string> buildIperfCommand(const BandwidthConfig& config, bool jsonStream) const;
     bool parseIperfOutput(const std::string& output, BandwidthResult& result) const;
+    bool parseIperfJson(const json& iperfJson, BandwidthResult& result) const;
     void parseRealtimeOutput(const std::string& line, RealtimeUpdate& update) const;
     
-    // Process management
-    int executeCommandWithCallback(const std::string& command, 
-                                 std::function<void(const std::string&)> outputCallback,
-                                 const std::atomic<bool>& shouldStop,
-                                 int timeoutSeconds = 300);
-    
     // Validation and sanitization
     bool isValidHostname(const std::string& hostname) const;
     std::string sanitizeHostname(const std::string& hostname) const;
@@ -1,19 +1,26 @@
 
 #include "DNSLookupUtilityEngine.hpp"
 #include "endpoint_logger.h"
+#include "process_engine.h"
 #include <sstream>
 #include <regex>
-#include <cstdlib>
-#include <unistd.h>
-#include <sys/wait.h>
-#include <signal.h>
 #include <iomanip>
 #include <algorithm>
+#include <arpa/inet.h>
 
 const std::vector<std::string> DNSLookupUtilityEngine::supportedRecordTypes_ = {
     "A", "AAAA", "CNAME", "MX", "NS", "TXT", "SOA", "PTR", "SRV", "CAA", "DNSKEY", "DS", "RRSIG", "NSEC", "ANY"
 };
 
+namespace {
+
+std::string currentTimestamp() {
+    return std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+} // namespace
+
 DNSLookupUtilityEngine::DNSLookupUtilityEngine() {
     ENDPOINT_LOG("dns-engine", "DNSLookupUtilityEngine initialized");
 }
@@ -23,8 +30,6 @@ DNSLookupUtilityEngine::~DNSLookupUtilityEngine() {
 }
 
 DNSLookupUtilityEngine::DNSResult DNSLookupUtilityEngine::performDNSLookup(const DNSConfig& config) {
-    std::lock_guard<std::mutex> lock(engineMutex_);
-    
     std::string validationError;
     if (!validateConfig(config, validationError)) {
         ENDPOINT_LOG("dns-engine", "Invalid config: " + validationError);
@@ -36,16 +41,197 @@ DNSLookupUtilityEngine::DNSResult DNSLookupUtilityEngine::performDNSLookup(const
     
     ENDPOINT_LOG("dns-engine", "Performing DNS lookup for " + config.domain + " (" + config.recordType + ")");
     
+    DNSResult result;
+    DnsEngine::Query query;
+    std::string error;
+    if (config.trace) {
+        // Iterating down from the root servers is left to dig
+        result = performToolLookup(config);
+    } else if (buildQuery(config, query, error)) {
+        result = buildResult(config, DnsEngine::getInstance().lookup(std::move(query)));
+    } else {
+        result.domain = config.domain;
+        result.recordType = config.recordType;
+        result.error = error;
+    }
+    
+    result.timestamp = currentTimestamp();
+    return result;
+}
+
+std::vector<DNSLookupUtilityEngine::DNSResult> DNSLookupUtilityEngine::performBulkLookup(const std::vector<DNSConfig>& configs) {
+    std::vector<DNSResult> results(configs.size());
+    std::vector<DnsEngine::Query> queries;
+    std::vector<size_t> queried;
+    
+    for (size_t i = 0; i < configs.size(); ++i) {
+        const DNSConfig& config = configs[i];
+        if (config.trace) {
+            results[i] = performDNSLookup(config);
+            continue;
+        }
+        
+        std::string error;
+        DnsEngine::Query query;
+        if (!validateConfig(config, error) || !buildQuery(config, query, error)) {
+            results[i].domain = config.domain;
+            results[i].recordType = config.recordType;
+            results[i].error = error;
+            results[i].timestamp = currentTimestamp();
+            continue;
+        }
+        queries.push_back(std::move(query));
+        queried.push_back(i);
+    }
+    
+    ENDPOINT_LOG("dns-engine", "Performing " + std::to_string(queries.size()) + " DNS lookups concurrently");
+    std::vector<DnsEngine::Response> responses = DnsEngine::getInstance().lookupAll(std::move(queries));
+    for (size_t j = 0; j < queried.size(); ++j) {
+        results[queried[j]] = buildResult(configs[queried[j]], responses[j]);
+        results[queried[j]].timestamp = currentTimestamp();
+    }
+    
+    return results;
+}
+
+bool DNSLookupUtilityEngine::buildQuery(const DNSConfig& config, DnsEngine::Query& query, std::string& error) const {
+    if (!DnsEngine::typeFromName(config.recordType, query.type)) {
+        error = "Unsupported record type: " + config.recordType;
+        return false;
+    }
+    
+    query.name = sanitizeDomain(config.domain);
+    if (config.recordType == "PTR") {
+        // An address is looked up in the reverse tree, as dig -x does
+        std::string reverse = DnsEngine::reverseName(query.name);
+        if (!reverse.empty()) {
+            query.name = reverse;
+        }
+    }
+    
+    std::vector<std::string> servers = config.compareServers;
+    if (!config.dnsServer.empty() && config.dnsServer != "System Default") {
+        servers.insert(servers.begin(), config.dnsServer);
+    }
+    for (const auto& server : servers) {
+        // "address", "address#port" or a name, which is resolved first
+        std::string host = sanitizeDNSServer(server);
+        std::string port;
+        size_t hash = host.find('#');
+        if (hash != std::string::npos) {
+            port = host.substr(hash);
+            host = host.substr(0, hash);
+        }
+        
+        sockaddr_storage address{};
+        socklen_t addressLength = 0;
+        if (!DnsEngine::getInstance().resolve(host, config.ipv6 ? AF_INET6 : AF_UNSPEC, address, addressLength, error)) {
+            error = "Cannot resolve DNS server " + host + ": " + error;
+            return false;
+        }
+        char text[INET6_ADDRSTRLEN] = "";
+        if (address.ss_family == AF_INET6) {
+            ::inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6&>(address).sin6_addr, text, sizeof(text));
+        } else {
+            ::inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in&>(address).sin_addr, text, sizeof(text));
+        }
+        query.servers.push_back(text + port);
+    }
+    
+    query.ipv6_transport = config.ipv6;
+    query.recursive = config.recursive;
+    query.all_servers = query.servers.size() > 1;   // Comparing resolvers: time every one
+    query.use_cache = false;                        // Always ask; the answer still refreshes the shared cache
+    query.timeout = std::chrono::seconds(config.timeout);
+    return true;
+}
+
+DNSLookupUtilityEngine::DNSResult DNSLookupUtilityEngine::buildResult(const DNSConfig& config,
+                                                                      const DnsEngine::Response& response) const {
+    DNSResult result;
+    result.domain = config.domain;
+    result.recordType = config.recordType;
+    result.dnsServer = config.dnsServer.empty() ? "System Default" : config.dnsServer;
+    result.resolvedServer = response.server;
+    result.responseCode = response.status;
+    result.queryTime = response.query_time_ms;
+    result.responseSize = static_cast<int>(response.size);
+    result.authoritative = response.authoritative;
+    result.recursionAvailable = response.recursion_available;
+    result.truncated = response.truncated;
+    result.fromCache = response.from_cache;
+    
+    auto convert = [](const DnsEngine::Record& source) {
+        DNSRecord record;
+        record.name = source.name;
+        record.type = source.type;
+        record.value = source.value;
+        record.ttl = static_cast<int>(source.ttl);
+        record.recordClass = source.recordClass;
+        record.priority = source.priority;
+        return record;
+    };
+    for (const auto& record : response.answers) result.records.push_back(convert(record));
+    for (const auto& record : response.authority) result.authorityRecords.push_back(convert(record));
+    for (const auto& record : response.additional) result.additionalRecords.push_back(convert(record));
+    
+    for (const auto& server : response.servers) {
+        ResolverTiming timing;
+        timing.server = server.server;
+        timing.queryTime = server.rtt_ms;
+        timing.answered = server.answered;
+        timing.status = server.status;
+        result.resolverTimings.push_back(timing);
+    }
+    
+    if (!response.error.empty()) {
+        result.error = response.error;
+        result.rawOutput = ";; " + response.error + "\n";
+        return result;
+    }
+    result.success = true;
+    
+    // Text in dig's layout, for the raw output view
+    std::ostringstream raw;
+    raw << ";; ->>HEADER<<- opcode: QUERY, status: " << response.status << "\n";
+    raw << ";; flags: qr" << (response.authoritative ? " aa" : "") << (response.truncated ? " tc" : "")
+        << (config.recursive ? " rd" : "") << (response.recursion_available ? " ra" : "") << "\n";
+    auto section = [&raw](const char* title, const std::vector<DNSRecord>& records) {
+        if (records.empty()) return;
+        raw << "\n;; " << title << " SECTION:\n";
+        for (const auto& record : records) {
+            raw << record.name << "\t" << record.ttl << "\t" << record.recordClass << "\t" << record.type << "\t";
+            if (record.type == "MX") raw << record.priority << " ";
+            raw << record.value << "\n";
+        }
+    };
+    section("ANSWER", result.records);
+    section("AUTHORITY", result.authorityRecords);
+    section("ADDITIONAL", result.additionalRecords);
+    raw << "\n;; Query time: " << std::fixed << std::setprecision(3) << response.query_time_ms << " msec"
+        << (response.from_cache ? " (cached)" : "") << "\n";
+    if (!response.server.empty()) {
+        raw << ";; SERVER: " << response.server << (response.truncated ? " (TCP)" : " (UDP)") << "\n";
+    }
+    raw << ";; MSG SIZE  rcvd: " << response.size << "\n";
+    result.rawOutput = raw.str();
+    
+    result.rawResponse = json{
+        {"status", response.status},
+        {"server", response.server},
+        {"flags", {{"AA", response.authoritative}, {"RA", response.recursion_available}, {"TC", response.truncated}}},
+        {"fromCache", response.from_cache}
+    };
+    return result;
+}
+
+DNSLookupUtilityEngine::DNSResult DNSLookupUtilityEngine::performToolLookup(const DNSConfig& config) {
     // Try dig first (preferred), fall back to nslookup
     DNSResult result = performDigLookup(config);
     if (!result.success && result.error.find("dig") != std::string::npos) {
         ENDPOINT_LOG("dns-engine", "dig failed, trying nslookup");
         result = performNslookupLookup(config);
     }
-    
-    result.timestamp = std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
-        std::chrono::system_clock::now().time_since_epoch()).count());
-    
     return result;
 }
 
@@ -59,7 +245,8 @@ DNSLookupUtilityEngine::DNSResult DNSLookupUtilityEngine::performDigLookup(const
         auto startTime = std::chrono::high_resolution_clock::now();
         
         // Try JSON output first
-        std::string jsonCommand = buildDigCommand(config) + " +json";
+        std::vector<std::string> jsonCommand = buildDigCommand(config);
+        jsonCommand.push_back("+json");
         std::string jsonOutput = executeCommand(jsonCommand, config.timeout + 5);
         
         auto endTime = std::chrono::high_resolution_clock::now();
@@ -75,7 +262,7 @@ DNSLookupUtilityEngine::DNSResult DNSLookupUtilityEngine::performDigLookup(const
         }
         
         // Fall back to standard dig output
-        std::string command = buildDigCommand(config);
+        std::vector<std::string> command = buildDigCommand(config);
         std::string output = executeCommand(command, config.timeout + 5);
         
         if (output.empty()) {
@@ -108,7 +295,7 @@ DNSLookupUtilityEngine::DNSResult DNSLookupUtilityEngine::performNslookupLookup(
     try {
         auto startTime = std::chrono::high_resolution_clock::now();
         
-        std::string command = buildNslookupCommand(config);
+        std::vector<std::string> command = buildNslookupCommand(config);
         std::string output = executeCommand(command, config.timeout + 5);
         
         auto endTime = std::chrono::high_resolution_clock::now();
@@ -136,61 +323,55 @@ DNSLookupUtilityEngine::DNSResult DNSLookupUtilityEngine::performNslookupLookup(
     return result;
 }
 
-std::string DNSLookupUtilityEngine::buildDigCommand(const DNSConfig& config) const {
-    std::ostringstream cmd;
-    
-    cmd << "dig";
+std::vector<std::string> DNSLookupUtilityEngine::buildDigCommand(const DNSConfig& config) const {
+    std::vector<std::string> argv = {"dig"};
     
     if (!config.dnsServer.empty() && config.dnsServer != "System Default") {
-        cmd << " @" << sanitizeDNSServer(config.dnsServer);
+        argv.push_back("@" + sanitizeDNSServer(config.dnsServer));
     }
     
-    cmd << " " << sanitizeDomain(config.domain);
-    cmd << " " << config.recordType;
+    argv.push_back(sanitizeDomain(config.domain));
+    argv.push_back(config.recordType);
     
-    cmd << " +time=" << config.timeout;
+    argv.push_back("+time=" + std::to_string(config.timeout));
     
     if (config.trace) {
-        cmd << " +trace";
+        argv.push_back("+trace");
     }
     
     if (!config.recursive) {
-        cmd << " +norecurse";
+        argv.push_back("+norecurse");
     }
     
     if (config.showStats) {
-        cmd << " +stats";
+        argv.push_back("+stats");
     }
     
     if (config.ipv6) {
-        cmd << " -6";
+        argv.push_back("-6");
     }
     
-    cmd << " 2>&1";
-    
-    return cmd.str();
+    return argv;
 }
 
-std::string DNSLookupUtilityEngine::buildNslookupCommand(const DNSConfig& config) const {
-    std::ostringstream cmd;
-    
-    cmd << "nslookup";
-    cmd << " -type=" << config.recordType;
-    cmd << " -timeout=" << config.timeout;
+std::vector<std::string> DNSLookupUtilityEngine::buildNslookupCommand(const DNSConfig& config) const {
+    std::vector<std::string> argv = {
+        "nslookup",
+        "-type=" + config.recordType,
+        "-timeout=" + std::to_string(config.timeout)
+    };
     
     if (!config.recursive) {
-        cmd << " -norecurse";
+        argv.push_back("-norecurse");
     }
     
-    cmd << " " << sanitizeDomain(config.domain);
+    argv.push_back(sanitizeDomain(config.domain));
     
     if (!config.dnsServer.empty() && config.dnsServer != "System Default") {
-        cmd << " " << sanitizeDNSServer(config.dnsServer);
+        argv.push_back(sanitizeDNSServer(config.dnsServer));
     }
     
-    cmd << " 2>&1";
-    
-    return cmd.str();
+    return argv;
 }
 
 bool DNSLookupUtilityEngine::parseDigJSON(const std::string& jsonOutput, DNSResult& result) const {
@@ -452,28 +633,20 @@ DNSLookupUtilityEngine::DNSRecord DNSLookupUtilityEngine::parseNslookupRecord(co
     return record;
 }
 
-std::string DNSLookupUtilityEngine::executeCommand(const std::string& command, int timeoutSeconds) const {
-    std::string result;
+std::string DNSLookupUtilityEngine::executeCommand(const std::vector<std::string>& argv, int timeoutSeconds) const {
+    ProcessEngine::Result result = ProcessEngine::getInstance().run(argv, std::chrono::seconds(timeoutSeconds));
     
-    std::string timeoutCommand = "timeout " + std::to_string(timeoutSeconds) + " " + command;
-    FILE* pipe = popen(timeoutCommand.c_str(), "r");
-    
-    if (!pipe) {
-        ENDPOINT_LOG("dns-engine", "Failed to execute command: " + command);
+    if (!result.error.empty()) {
+        ENDPOINT_LOG("dns-engine", "Failed to execute " + argv[0] + ": " + result.error);
         return "";
     }
     
-    char buffer[1024];
-    while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-        result += buffer;
-    }
-    
-    int status = pclose(pipe);
-    if (status == -1 || (WIFEXITED(status) && WEXITSTATUS(status) != 0)) {
-        ENDPOINT_LOG("dns-engine", "Command failed: " + command + " (exit code: " + std::to_string(WEXITSTATUS(status)) + ")");
+    if (result.exit_code != 0) {
+        ENDPOINT_LOG("dns-engine", "Command failed: " + argv[0] + " (exit code: " + std::to_string(result.exit_code) +
+                     (result.timed_out ? ", timed out" : "") + ")");
     }
     
-    return result;
+    return result.output;
 }
 
 bool DNSLookupUtilityEngine::validateConfig(const DNSConfig& config, std::string& error) {
@@ -11,6 +11,7 @@
 #include <functional>
 #include <chrono>
 #include "../third_party/nlohmann/json.hpp"
+#include "dns_engine.h"
 
 using json = nlohmann::json;
 
@@ -20,6 +21,7 @@ public:
         std::string domain = "example.com";
         std::string recordType = "A";
         std::string dnsServer = ""; // Empty for system default
+        std::vector<std::string> compareServers; // Also asked, in parallel; see resolverTimings
         int timeout = 5;
         bool trace = false;
         bool recursive = true;
@@ -37,6 +39,13 @@ public:
         std::string additional; // Additional data
     };
     
+    struct ResolverTiming {
+        std::string server;
+        double queryTime = 0.0; // Milliseconds
+        bool answered = false;
+        std::string status; // Response code, or why there was no answer
+    };
+    
     struct DNSResult {
         bool success = false;
         std::string error;
@@ -50,12 +59,16 @@ public:
         // Results
         std::vector<DNSRecord> records;
         
+        std::string responseCode; // NOERROR, NXDOMAIN, SERVFAIL, ...
+        
         // Statistics
         double queryTime = 0.0;
         int responseSize = 0;
         bool authoritative = false;
         bool recursionAvailable = false;
         bool truncated = false;
+        bool fromCache = false;
+        std::vector<ResolverTiming> resolverTimings; // Every server asked
         
         // Additional sections
         std::vector<DNSRecord> authorityRecords;
@@ -75,6 +88,10 @@ public:
     // Synchronous lookup (most DNS queries are quick)
     DNSResult performDNSLookup(const DNSConfig& config);
     
+    // Many names or types at once; the queries run concurrently and the
+    // results come back in config order
+    std::vector<DNSResult> performBulkLookup(const std::vector<DNSConfig>& configs);
+    
     // Utility functions
     static bool validateConfig(const DNSConfig& config, std::string& error);
     static json configToJson(const DNSConfig& config);
@@ -82,13 +99,14 @@ public:
     static std::vector<std::string> getSupportedRecordTypes();
 
 private:
-    mutable std::mutex engineMutex_;
-    
-    // Core functionality
+    // Core functionality: the in-process resolver, or dig/nslookup for +trace
+    bool buildQuery(const DNSConfig& config, DnsEngine::Query& query, std::string& error) const;
+    DNSResult buildResult(const DNSConfig& config, const DnsEngine::Response& response) const;
+    DNSResult performToolLookup(const DNSConfig& config);
     DNSResult performDigLookup(const DNSConfig& config);
     DNSResult performNslookupLookup(const DNSConfig& config);
-    std::string buildDigCommand(const DNSConfig& config) const;
-    std::string buildNslookupCommand(const DNSConfig& config) const;
+    std::vector<std::string> buildDigCommand(const DNSConfig& config) const;
+    std::vector<std::string> buildNslookupCommand(const DNSConfig& config) const;
     
     // Parsing functions
     bool parseDigOutput(const std::string& output, DNSResult& result) const;
@@ -105,7 +123,7 @@ private:
     std::string sanitizeDNSServer(const std::string& server) const;
     
     // Command execution
-    std::string executeCommand(const std::string& command, int timeoutSeconds = 30) const;
+    std::string executeCommand(const std::vector<std::string>& argv, int timeoutSeconds = 30) const;
     
     // Record type mapping
     static const std::vector<std::string> supportedRecordTypes_;
@@ -1,4 +1,7 @@
 #include "Iperf3ServersEngine.hpp"
+#include "dns_engine.h"
+#include "icmp_engine.h"
+#include "process_engine.h"
 #include <fstream>
 #include <sstream>
 #include <chrono>
@@ -12,11 +15,27 @@
 #include <future>
 #include <iostream> // For std::cout and std::cerr
 #include <ctime>    // For std::time
+#include <cerrno>
+#include <cmath>
+#include <netinet/in.h>
+#include <poll.h>
 
 // Using nlohmann/json library
 #include <nlohmann/json.hpp>
 using json = nlohmann::json;
 
+namespace {
+
+// One server's echoes, filled in on the ICMP engine's reactor thread
+struct PingState {
+    std::mutex mutex;
+    std::condition_variable done_cv;
+    bool done = false;
+    std::vector<double> times;
+};
+
+} // namespace
+
 Iperf3ServersEngine::Iperf3ServersEngine()
     : servers_file_path_("mecanisms/iperf3-server-parser/servers/ultima-rabotics-servers.json") {
     try {
@@ -44,7 +63,15 @@ Iperf3ServersEngine::Iperf3ServersEngine()
 }
 
 Iperf3ServersEngine::~Iperf3ServersEngine() {
-    // Destructor
+    // The prober's tests reference this engine; those already running finish first
+    {
+        std::lock_guard<std::mutex> lock(prober_mutex_);
+        prober_stop_ = true;
+    }
+    prober_cv_.notify_all();
+    if (prober_.joinable()) {
+        prober_.join();
+    }
 }
 
 void Iperf3ServersEngine::initializeDefaultConfiguration() {
@@ -362,53 +389,90 @@ const Iperf3ServersEngine::ServerInfo* Iperf3ServersEngine::findServerByIdNoLock
 }
 
 Iperf3ServersEngine::ServerTestResult Iperf3ServersEngine::testServerConnectivity(const std::string& serverId) {
+    ServerInfo server;
+    {
+        std::lock_guard<std::mutex> lock(servers_mutex_);
+        const ServerInfo* found = findServerByIdNoLock(serverId);
+        if (!found) {
+            ServerTestResult result;
+            result.last_tested = getCurrentTimestamp();
+            result.error_message = "Server not found";
+            return result;
+        }
+        server = *found;
+    }
+
+    ServerTestResult result = probeServer(server);
+    if (result.success) {
+        applyTestResult(serverId, result);
+
+        std::lock_guard<std::mutex> lock(servers_mutex_);
+        saveServersToFile(servers_file_path_);
+    }
+
+    return result;
+}
+
+Iperf3ServersEngine::ServerTestResult Iperf3ServersEngine::probeServer(const ServerInfo& server) const {
     ServerTestResult result;
-    result.success = false;
-    result.status = "Unknown";
-    result.ping_ms = -1;
-    result.response_time_ms = -1;
-    result.packet_loss = 100.0;
-    result.jitter_ms = 0.0;
-    result.load_percent = 0;
     result.last_tested = getCurrentTimestamp();
-    result.error_message = "";
 
-    const ServerInfo* server = getServerById(serverId);
-    if (!server) {
-        result.error_message = "Server not found";
+    // The hostname is an argument, not shell text, but must not read as an option
+    if (server.hostname.empty() || server.hostname[0] == '-' || !isValidPort(server.port)) {
+        result.error_message = "Invalid server address";
         return result;
     }
 
     try {
-        // Perform ping test
-        std::string pingResult = performPingTest(server->hostname, 3);
-
-        // Perform port connectivity test
-        std::string portResult = performPortConnectivityTest(server->hostname, server->port);
+        const int pingCount = 3;
+        std::vector<double> pingTimes;
+        double connectMs = -1;
+
+        // A name that does not resolve leaves the server offline
+        sockaddr_storage address{};
+        socklen_t addressLength = 0;
+        std::string error;
+        if (DnsEngine::getInstance().resolve(server.hostname, AF_UNSPEC, address, addressLength, error)) {
+            IcmpEngine& icmp = IcmpEngine::getInstance();
+            bool icmpAvailable = icmp.available(address.ss_family);
+            auto ping = std::make_shared<PingState>();
+
+            if (icmpAvailable) {
+                // The echoes go out while the TCP handshake is timed
+                IcmpEngine::Options options;
+                options.address = address;
+                options.address_length = addressLength;
+                options.count = pingCount;
+                options.interval = std::chrono::milliseconds(200);
+                options.timeout = std::chrono::seconds(2);
+                options.on_echo = [ping](const IcmpEngine::Echo& echo) {
+                    if (!echo.success) return;
+                    std::lock_guard<std::mutex> lock(ping->mutex);
+                    ping->times.push_back(echo.rtt_ms);
+                };
+                options.on_done = [ping](const IcmpEngine::Result&) {
+                    std::lock_guard<std::mutex> lock(ping->mutex);
+                    ping->done = true;
+                    ping->done_cv.notify_all();
+                };
+                icmp.start(std::move(options));
+            }
 
-        // Parse results
-        if (parseConnectivityResults(pingResult, portResult, result)) {
-            result.success = true;
-            result.load_percent = static_cast<int>(calculateServerLoad(server->hostname, server->port));
+            connectMs = performPortConnectivityTest(address, addressLength, server.port);
 
-            // Update server status
-            {
-                std::lock_guard<std::mutex> lock(servers_mutex_);
-                for (auto& srv : servers_) {
-                    if (srv.id == serverId) {
-                        srv.status = result.status;
-                        srv.ping_ms = result.ping_ms;
-                        srv.response_time_ms = result.response_time_ms;
-                        srv.packet_loss = result.packet_loss;
-                        srv.jitter_ms = result.jitter_ms;
-                        srv.load_percent = result.load_percent;
-                        srv.last_tested = result.last_tested;
-                        break;
-                    }
-                }
+            if (icmpAvailable) {
+                std::unique_lock<std::mutex> lock(ping->mutex);
+                ping->done_cv.wait(lock, [&ping]() { return ping->done; });
+                pingTimes = ping->times;
+            } else {
+                pingTimes = performPingTest(server.hostname, pingCount);
             }
+        }
 
-            saveServersToFile(servers_file_path_);
+        // Parse results
+        if (parseConnectivityResults(pingTimes, pingCount, connectMs, result)) {
+            result.success = true;
+            result.load_percent = static_cast<int>(calculateServerLoad(server.hostname, server.port));
         } else {
             result.error_message = "Failed to parse connectivity test results";
         }
@@ -420,6 +484,22 @@ Iperf3ServersEngine::ServerTestResult Iperf3ServersEngine::testServerConnectivit
     return result;
 }
 
+void Iperf3ServersEngine::applyTestResult(const std::string& serverId, const ServerTestResult& result) {
+    std::lock_guard<std::mutex> lock(servers_mutex_);
+    for (auto& srv : servers_) {
+        if (srv.id == serverId) {
+            srv.status = result.status;
+            srv.ping_ms = result.ping_ms;
+            srv.response_time_ms = result.response_time_ms;
+            srv.packet_loss = result.packet_loss;
+            srv.jitter_ms = result.jitter_ms;
+            srv.load_percent = result.load_percent;
+            srv.last_tested = result.last_tested;
+            break;
+        }
+    }
+}
+
 bool Iperf3ServersEngine::updateServerStatus(const std::string& serverId, const std::string& status, double load) {
     std::lock_guard<std::mutex> lock(servers_mutex_);
 
@@ -564,16 +644,129 @@ std::string Iperf3ServersEngine::generateServerId(const std::string& hostname) c
 }
 
 void Iperf3ServersEngine::testAllServersAsync() {
-    std::thread([this]() {
-        auto servers = getAllServers();
+    {
+        std::lock_guard<std::mutex> lock(prober_mutex_);
+        sweep_requested_ = true;
+        ensureProberStarted();
+    }
+    prober_cv_.notify_all();
+}
+
+bool Iperf3ServersEngine::isProbing() const {
+    std::lock_guard<std::mutex> lock(prober_mutex_);
+    return probing_ || sweep_requested_;
+}
+
+void Iperf3ServersEngine::setProbeParallelism(size_t parallelism) {
+    std::lock_guard<std::mutex> lock(prober_mutex_);
+    probe_parallelism_ = std::clamp(parallelism, static_cast<size_t>(1), MAX_PROBE_PARALLELISM);
+}
 
-        for (const auto& server : servers) {
-            if (!server.is_custom || server.status == "untested") {
-                testServerConnectivity(server.id);
-                std::this_thread::sleep_for(std::chrono::milliseconds(500));
+void Iperf3ServersEngine::setProbeSchedule(std::chrono::seconds period) {
+    {
+        std::lock_guard<std::mutex> lock(prober_mutex_);
+        probe_period_ = std::max(period, std::chrono::seconds(0));
+        if (probe_period_.count() > 0) {
+            ensureProberStarted();
+        }
+    }
+    prober_cv_.notify_all();
+}
+
+void Iperf3ServersEngine::ensureProberStarted() {
+    if (!prober_.joinable() && !prober_stop_) {
+        prober_ = std::thread(&Iperf3ServersEngine::proberLoop, this);
+    }
+}
+
+void Iperf3ServersEngine::proberLoop() {
+    std::mt19937 random(std::random_device{}());
+    auto nextSweepAfter = [&random](std::chrono::seconds period) {
+        std::uniform_int_distribution<long long> jitter(0, std::chrono::milliseconds(period).count() / 10);
+        return std::chrono::steady_clock::now() + period + std::chrono::milliseconds(jitter(random));
+    };
+
+    std::unique_lock<std::mutex> lock(prober_mutex_);
+    std::chrono::seconds period{0};
+    std::chrono::steady_clock::time_point nextSweep;
+    while (!prober_stop_) {
+        if (probe_period_ != period) {
+            period = probe_period_;
+            nextSweep = nextSweepAfter(period);
+        }
+
+        bool due = period.count() > 0 && std::chrono::steady_clock::now() >= nextSweep;
+        if (!sweep_requested_ && !due) {
+            if (period.count() > 0) {
+                prober_cv_.wait_until(lock, nextSweep);
+            } else {
+                prober_cv_.wait(lock);
             }
+            continue;
         }
-    }).detach();
+
+        sweep_requested_ = false;
+        probing_ = true;
+        lock.unlock();
+        try {
+            runProbeSweep();
+        } catch (const std::exception& e) {
+            std::cerr << "[Iperf3ServersEngine] Probe sweep failed: " << e.what() << std::endl;
+        }
+        lock.lock();
+        probing_ = false;
+        if (period.count() > 0) {
+            nextSweep = nextSweepAfter(period);
+        }
+    }
+}
+
+void Iperf3ServersEngine::runProbeSweep() {
+    std::vector<ServerInfo> servers;
+    for (const auto& server : getAllServers()) {
+        if (!server.is_custom || server.status == "untested") {
+            servers.push_back(server);
+        }
+    }
+
+    size_t parallelism;
+    {
+        std::lock_guard<std::mutex> lock(prober_mutex_);
+        parallelism = std::min(probe_parallelism_, servers.size());
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<size_t> next{0};
+    auto worker = [this, &servers, &next]() {
+        for (size_t i = next++; i < servers.size(); i = next++) {
+            {
+                std::lock_guard<std::mutex> lock(prober_mutex_);
+                if (prober_stop_) return;
+            }
+            ServerTestResult result = probeServer(servers[i]);
+            if (result.success) {
+                applyTestResult(servers[i].id, result);
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < parallelism; ++i) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : workers) {
+        thread.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(servers_mutex_);
+        saveServersToFile(servers_file_path_);
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::cout << "[Iperf3ServersEngine] Probed " << servers.size() << " servers in " << elapsed.count()
+              << "ms (" << std::max(parallelism, static_cast<size_t>(1)) << " at a time)" << std::endl;
 }
 
 json Iperf3ServersEngine::getServerStatusSummary() const {
@@ -711,8 +904,11 @@ std::string Iperf3ServersEngine::getCurrentTimestamp() const {
         auto time_t = std::chrono::system_clock::to_time_t(now);
         auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000;
 
+        std::tm utc{};
+        gmtime_r(&time_t, &utc);    // Probes run concurrently: not std::gmtime's shared buffer
+
         std::stringstream ss;
-        ss << std::put_time(std::gmtime(&time_t), "%Y-%m-%d %H:%M:%S");
+        ss << std::put_time(&utc, "%Y-%m-%d %H:%M:%S");
         ss << '.' << std::setfill('0') << std::setw(3) << ms.count();
         ss << " UTC";
 
@@ -750,88 +946,64 @@ double Iperf3ServersEngine::calculateUptime(const std::string& serverId) const {
     return dis(gen);
 }
 
-std::string Iperf3ServersEngine::performPingTest(const std::string& hostname, int count) const {
-    if (hostname.empty()) {
-        return "";
-    }
-
-    try {
-        std::ostringstream cmd;
-        cmd << "timeout 10 ping -c " << count << " -W 2 " << hostname << " 2>/dev/null || echo 'ping_failed'";
-
-        FILE* pipe = popen(cmd.str().c_str(), "r");
-        if (!pipe) {
-            return "";
-        }
+std::vector<double> Iperf3ServersEngine::performPingTest(const std::string& hostname, int count) const {
+    std::vector<double> times;
 
-        char buffer[128];
-        std::string result;
-        while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-            result += buffer;
-        }
-
-        int status = pclose(pipe);
+    // The hostname is an argument, not shell text, but must not read as an option
+    if (hostname.empty() || hostname[0] == '-') {
+        return times;
+    }
 
-        if (result.find("ping_failed") != std::string::npos) {
-            return "";
+    ProcessEngine::Result result = ProcessEngine::getInstance().run(
+        {"ping", "-c", std::to_string(count), "-W", "2", hostname}, std::chrono::seconds(10),
+        CancellationToken(), false);
+    static const std::regex timeRegex(R"(time=([0-9.]+) ms)");
+    std::istringstream iss(result.output);
+    std::string line;
+    std::smatch match;
+    while (std::getline(iss, line)) {
+        if (std::regex_search(line, match, timeRegex)) {
+            times.push_back(std::stod(match[1].str()));
         }
-
-        return result;
-    } catch (const std::exception& e) {
-        return "";
     }
+    return times;
 }
 
-std::string Iperf3ServersEngine::performPortConnectivityTest(const std::string& hostname, int port) const {
-    if (hostname.empty() || port <= 0 || port > 65535) {
-        return "Connection failed";
+double Iperf3ServersEngine::performPortConnectivityTest(const sockaddr_storage& address, socklen_t addressLength, int port) const {
+    sockaddr_storage target = address;
+    if (target.ss_family == AF_INET6) {
+        reinterpret_cast<sockaddr_in6&>(target).sin6_port = htons(static_cast<uint16_t>(port));
+    } else {
+        reinterpret_cast<sockaddr_in&>(target).sin_port = htons(static_cast<uint16_t>(port));
     }
 
-    try {
-        std::ostringstream cmd;
-        cmd << "timeout 5 nc -z -w3 " << hostname << " " << port << " 2>/dev/null && echo \"Connection successful\" || echo \"Connection failed\"";
-
-        FILE* pipe = popen(cmd.str().c_str(), "r");
-        if (!pipe) {
-            return "Connection failed";
-        }
+    int fd = ::socket(target.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
 
-        char buffer[128];
-        std::string result;
-        while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-            result += buffer;
+    // Same three second limit nc -w3 had
+    double elapsed = -1;
+    auto start = std::chrono::steady_clock::now();
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&target), addressLength) == 0 || errno == EINPROGRESS) {
+        pollfd pfd{fd, POLLOUT, 0};
+        int error = 0;
+        socklen_t errorLength = sizeof(error);
+        if (::poll(&pfd, 1, 3000) == 1 &&
+            ::getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &errorLength) == 0 && error == 0) {
+            elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
         }
-
-        pclose(pipe);
-
-        // Trim whitespace
-        result.erase(result.find_last_not_of(" \n\r\t") + 1);
-
-        return result;
-    } catch (const std::exception& e) {
-        return "Connection failed";
     }
+    ::close(fd);
+    return elapsed;
 }
 
-bool Iperf3ServersEngine::parseConnectivityResults(const std::string& pingOutput, const std::string& portOutput, ServerTestResult& result) const {
+bool Iperf3ServersEngine::parseConnectivityResults(const std::vector<double>& pingTimes, int pingCount, double connectMs, ServerTestResult& result) const {
     try {
-        // Parse ping results
-        std::regex pingRegex(R"(time=([0-9.]+) ms)");
-        std::smatch match;
         std::vector<double> ping_times;
-
-        std::istringstream iss(pingOutput);
-        std::string line;
-        while (std::getline(iss, line) && ping_times.size() < 10) {
-            if (std::regex_search(line, match, pingRegex)) {
-                try {
-                    double time_val = std::stod(match[1].str());
-                    if (time_val >= 0 && time_val < 10000) {
-                        ping_times.push_back(time_val);
-                    }
-                } catch (const std::exception& e) {
-                    continue;
-                }
+        for (double time_val : pingTimes) {
+            if (time_val >= 0 && time_val < 10000 && ping_times.size() < 10) {
+                ping_times.push_back(time_val);
             }
         }
 
@@ -854,16 +1026,18 @@ bool Iperf3ServersEngine::parseConnectivityResults(const std::string& pingOutput
                 result.jitter_ms = 0.0;
             }
 
-            result.packet_loss = 0.0;
+            result.packet_loss = pingCount > 0
+                ? std::max(0.0, 100.0 * (pingCount - static_cast<int>(pingTimes.size())) / pingCount)
+                : 0.0;
         } else {
             result.ping_ms = -1;
             result.jitter_ms = 0.0;
             result.packet_loss = 100.0;
         }
 
-        // Parse port connectivity
-        if (portOutput.find("Connection successful") != std::string::npos) {
-            result.response_time_ms = result.ping_ms;
+        // Port connectivity
+        if (connectMs >= 0) {
+            result.response_time_ms = connectMs;
 
             if (result.ping_ms >= 0) {
                 if (result.ping_ms < 50) {
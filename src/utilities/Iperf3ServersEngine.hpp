@@ -7,6 +7,10 @@
 #include <map>
 #include <memory>
 #include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+#include <sys/socket.h>
 #include "../third_party/nlohmann/json.hpp"
 
 using json = nlohmann::json;
@@ -38,13 +42,13 @@ public:
     };
 
     struct ServerTestResult {
-        bool success;
-        std::string status;
-        double ping_ms;
-        double response_time_ms;
-        double packet_loss;
-        double jitter_ms;
-        int load_percent;
+        bool success = false;
+        std::string status = "Unknown";
+        double ping_ms = -1;
+        double response_time_ms = -1;   // TCP handshake time
+        double packet_loss = 100.0;
+        double jitter_ms = 0.0;
+        int load_percent = 0;
         std::string last_tested;
         std::string error_message;
     };
@@ -79,8 +83,15 @@ public:
     bool validateServer(const ServerInfo& server) const;
     std::string generateServerId(const std::string& hostname) const;
     
-    // Bulk operations
+    // Bulk operations: a prober thread owned by the engine tests every server
+    // concurrently, at most `parallelism` at a time, and updates each server
+    // as soon as its own test finishes
     void testAllServersAsync();
+    bool isProbing() const;
+    void setProbeParallelism(size_t parallelism);
+    // Test all servers again every period (0 disables), each sweep shifted
+    // by up to a tenth of the period so many units do not probe in step
+    void setProbeSchedule(std::chrono::seconds period);
     json getServerStatusSummary() const;
     
     // Configuration
@@ -89,12 +100,24 @@ public:
     
     // Error handling and timeouts
     static const int DEFAULT_TIMEOUT_MS = 5000;
+    static constexpr size_t DEFAULT_PROBE_PARALLELISM = 16;
+    static constexpr size_t MAX_PROBE_PARALLELISM = 64;
 
 private:
     mutable std::mutex servers_mutex_;
     std::vector<ServerInfo> servers_;
     std::string servers_file_path_;
     
+    // Prober thread, started on first use
+    mutable std::mutex prober_mutex_;
+    std::condition_variable prober_cv_;
+    std::thread prober_;
+    bool prober_stop_ = false;
+    bool sweep_requested_ = false;
+    size_t probe_parallelism_ = DEFAULT_PROBE_PARALLELISM;
+    std::chrono::seconds probe_period_{0};
+    bool probing_ = false;
+    
     // Helper methods
     void loadDefaultServers();
     bool isValidHostname(const std::string& hostname) const;
@@ -104,9 +127,17 @@ private:
     double calculateUptime(const std::string& serverId) const;
     
     // Network testing utilities
-    std::string performPingTest(const std::string& hostname, int count = 3) const;
-    std::string performPortConnectivityTest(const std::string& hostname, int port) const;
-    bool parseConnectivityResults(const std::string& pingOutput, const std::string& portOutput, ServerTestResult& result) const;
+    void ensureProberStarted();     // With prober_mutex_ held
+    void proberLoop();
+    void runProbeSweep();
+    ServerTestResult probeServer(const ServerInfo& server) const;
+    void applyTestResult(const std::string& serverId, const ServerTestResult& result);
+    // Round-trip times of the replies received, in milliseconds, from the
+    // ping binary (when this process cannot open ICMP sockets)
+    std::vector<double> performPingTest(const std::string& hostname, int count = 3) const;
+    // TCP handshake time in milliseconds from a non-blocking connect, -1 when refused or timed out
+    double performPortConnectivityTest(const sockaddr_storage& address, socklen_t addressLength, int port) const;
+    bool parseConnectivityResults(const std::vector<double>& pingTimes, int pingCount, double connectMs, ServerTestResult& result) const;
     
     // Internal state management
     void initializeDefaultConfiguration();
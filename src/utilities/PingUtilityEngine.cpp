@@ -1,12 +1,9 @@
 
 #include "PingUtilityEngine.hpp"
 #include "endpoint_logger.h"
+#include "dns_engine.h"
 #include <sstream>
 #include <regex>
-#include <cstdlib>
-#include <unistd.h>
-#include <sys/wait.h>
-#include <signal.h>
 #include <iomanip>
 #include <algorithm>
 #include <random>
@@ -17,14 +14,15 @@ PingUtilityEngine::PingUtilityEngine() {
 }
 
 PingUtilityEngine::~PingUtilityEngine() {
-    // Stop all active tests
+    // Stop all active tests; their callbacks reference this engine
     std::lock_guard<std::mutex> lock(sessionsMutex_);
     for (auto& [testId, session] : activeSessions_) {
         if (session && session->isRunning.load()) {
-            session->shouldStop.store(true);
-            if (session->workerThread && session->workerThread->joinable()) {
-                session->workerThread->join();
+            session->cancel.cancel();
+            if (session->icmpSession) {
+                IcmpEngine::getInstance().stop(session->icmpSession);
             }
+            waitForSession(session.get());
         }
     }
     activeSessions_.clear();
@@ -48,10 +46,21 @@ std::string PingUtilityEngine::startPingTest(const PingConfig& config, ProgressC
     session->result.startTime = std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
         std::chrono::system_clock::now().time_since_epoch()).count());
     session->result.targetHost = config.targetHost;
+    // Replaced by the resolved address (or the one ping reports in its header line)
+    session->result.resolvedIp = config.targetHost;
     
-    // Start worker thread
-    session->isRunning.store(true);
-    session->workerThread = std::make_unique<std::thread>(&PingUtilityEngine::runPingTest, this, session.get());
+    TestSession* raw = session.get();
+    raw->update.phase = "starting";
+    if (raw->progressCallback) {
+        raw->progressCallback(raw->update);
+    }
+    
+    raw->isRunning.store(true);
+    // The ping binary is only needed where this process may open neither
+    // datagram nor raw ICMP sockets
+    if (!startIcmpTest(raw)) {
+        startProcessTest(raw);
+    }
     
     {
         std::lock_guard<std::mutex> lock(sessionsMutex_);
@@ -62,6 +71,61 @@ std::string PingUtilityEngine::startPingTest(const PingConfig& config, ProgressC
     return testId;
 }
 
+bool PingUtilityEngine::startIcmpTest(TestSession* session) {
+    const PingConfig& config = session->config;
+    int family = config.ipv6 ? AF_INET6 : AF_INET;
+    IcmpEngine& icmp = IcmpEngine::getInstance();
+    if (!icmp.available(family)) {
+        return false;
+    }
+    
+    IcmpEngine::Options options;
+    std::string error;
+    if (!DnsEngine::getInstance().resolve(sanitizeHost(config.targetHost), family, options.address,
+                                          options.address_length, error)) {
+        finishSession(session, false, false, "Cannot resolve " + config.targetHost + ": " + error);
+        return true;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(session->resultMutex);
+        session->result.resolvedIp = IcmpEngine::formatAddress(reinterpret_cast<const sockaddr*>(&options.address));
+        session->result.totalPackets = config.continuous ? 0 : config.count;
+    }
+    
+    options.count = config.continuous ? 0 : config.count;
+    options.interval = std::chrono::milliseconds(std::llround(config.interval * 1000));
+    options.timeout = std::chrono::seconds(config.timeout);
+    options.payload_size = config.packetSize;
+    options.ttl = config.ttl;
+    options.dont_fragment = config.dontFragment;
+    options.on_echo = [this, session](const IcmpEngine::Echo& echo) { handleEcho(session, echo); };
+    options.on_done = [this, session](const IcmpEngine::Result& done) { finishIcmpTest(session, done); };
+    
+    session->update.phase = "pinging";
+    if (session->progressCallback) {
+        session->progressCallback(session->update);
+    }
+    
+    ENDPOINT_LOG("ping-engine", "Pinging " + session->result.resolvedIp + " over ICMP sockets");
+    session->icmpSession = icmp.start(std::move(options));
+    return true;
+}
+
+void PingUtilityEngine::startProcessTest(TestSession* session) {
+    const PingConfig& config = session->config;
+    
+    ProcessEngine::Options options;
+    options.argv = buildPingCommand(config);
+    options.timeout = std::chrono::seconds(config.timeout * config.count + 30);
+    options.cancel = session->cancel;
+    options.on_line = [this, session](const std::string& line) { handlePingLine(session, line); };
+    options.on_exit = [this, session](const ProcessEngine::Result& exit) { finishPingTest(session, exit); };
+    
+    ENDPOINT_LOG("ping-engine", "Executing: " + options.argv[0] + " " + sanitizeHost(config.targetHost));
+    ProcessEngine::getInstance().spawn(std::move(options));
+}
+
 bool PingUtilityEngine::stopPingTest(const std::string& testId) {
     std::lock_guard<std::mutex> lock(sessionsMutex_);
     
@@ -72,15 +136,12 @@ bool PingUtilityEngine::stopPingTest(const std::string& testId) {
     
     auto& session = it->second;
     if (session && session->isRunning.load()) {
-        session->shouldStop.store(true);
-        
-        // Kill any ping processes
-        std::string killCmd = "pkill -f 'ping.*" + session->config.targetHost + "'";
-        system(killCmd.c_str());
-        
-        if (session->workerThread && session->workerThread->joinable()) {
-            session->workerThread->join();
+        // Ends this test's ICMP session or process group only
+        session->cancel.cancel();
+        if (session->icmpSession) {
+            IcmpEngine::getInstance().stop(session->icmpSession);
         }
+        waitForSession(session.get());
         
         ENDPOINT_LOG("ping-engine", "Stopped ping test: " + testId);
         return true;
@@ -123,168 +184,203 @@ std::vector<std::string> PingUtilityEngine::getActiveTestIds() const {
     return activeIds;
 }
 
-void PingUtilityEngine::runPingTest(TestSession* session) {
-    if (!session) return;
+void PingUtilityEngine::handleEcho(TestSession* session, const IcmpEngine::Echo& echo) {
+    PingPacket packet;
+    packet.sequence = echo.sequence;
+    packet.fromHost = echo.from;
+    packet.ttl = echo.ttl;
+    packet.rtt = echo.rtt_ms;
+    packet.packetSize = echo.bytes;
+    packet.success = echo.success;
+    packet.error = echo.error;
+    packet.timestamp = std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
     
-    try {
-        RealtimeUpdate update;
-        update.phase = "starting";
-        
-        if (session->progressCallback) {
-            session->progressCallback(update);
-        }
+    RealtimeUpdate& update = session->update;
+    std::lock_guard<std::mutex> lock(session->resultMutex);
+    PingResult& result = session->result;
+    
+    // Every probe is reported exactly once (reply, error or timeout), so
+    // losses are known as they happen rather than only at the end
+    result.packets.push_back(packet);
+    result.packetsSent = std::max(result.packetsSent, packet.sequence);
+    if (packet.success) {
+        result.packetsReceived++;
+        session->rttTotal += packet.rtt;
+        update.currentRtt = packet.rtt;
+        update.avgRtt = session->rttTotal / result.packetsReceived;
+    }
+    
+    update.latestPacket = packet;
+    update.packetsSent = result.packetsSent;
+    update.packetsReceived = result.packetsReceived;
+    update.packetLossPercent = 100.0 * (1.0 - (double)result.packetsReceived / result.packets.size());
+    if (result.totalPackets > 0) {
+        update.progress = (100 * (int)result.packets.size()) / result.totalPackets;
+    }
+    
+    if (session->progressCallback) {
+        session->progressCallback(update);
+    }
+}
+
+void PingUtilityEngine::handlePingLine(TestSession* session, const std::string& line) {
+    if (line.empty() || session->cancel.isCancelled()) return;
+    
+    RealtimeUpdate& update = session->update;
+    session->output += line;
+    session->output += '\n';
+    
+    // "PING host (1.2.3.4) 56(84) bytes of data." / "PING host(name (2001:db8::1)) 56 data bytes"
+    if (line.rfind("PING ", 0) == 0) {
+        size_t close = line.find(')');
+        size_t open = close == std::string::npos ? std::string::npos : line.rfind('(', close);
         
-        // Resolve hostname first
-        std::string resolvedIp = resolveHostname(session->config.targetHost);
-        {
-            std::lock_guard<std::mutex> lock(session->resultMutex);
-            session->result.resolvedIp = resolvedIp;
+        std::lock_guard<std::mutex> lock(session->resultMutex);
+        if (open != std::string::npos) {
+            session->result.resolvedIp = line.substr(open + 1, close - open - 1);
         }
-        
-        std::string command = buildPingCommand(session->config);
-        ENDPOINT_LOG("ping-engine", "Executing: " + command);
-        
+        session->result.totalPackets = session->config.count;
+        update.packetsSent = 1;
         update.phase = "pinging";
         if (session->progressCallback) {
             session->progressCallback(update);
         }
+        return;
+    }
+    
+    // Parse individual ping response
+    PingPacket packet = parsePingLine(line);
+    if (packet.success) {
+        std::lock_guard<std::mutex> lock(session->resultMutex);
+        session->result.packets.push_back(packet);
+        session->result.packetsReceived++;
         
-        std::vector<std::string> outputLines;
-        int exitCode = executeCommandWithRealtimeOutput(command,
-            [session, &update, &outputLines](const std::string& line) {
-                if (session->shouldStop.load()) return;
-                
-                outputLines.push_back(line);
-                
-                // Parse individual ping response
-                PingPacket packet = PingUtilityEngine().parsePingLine(line);
-                if (packet.success) {
-                    std::lock_guard<std::mutex> lock(session->resultMutex);
-                    session->result.packets.push_back(packet);
-                    session->result.packetsReceived++;
-                    
-                    update.latestPacket = packet;
-                    update.packetsReceived = session->result.packetsReceived;
-                    update.currentRtt = packet.rtt;
-                    
-                    // Calculate running average
-                    double totalRtt = 0.0;
-                    for (const auto& p : session->result.packets) {
-                        totalRtt += p.rtt;
-                    }
-                    update.avgRtt = totalRtt / session->result.packets.size();
-                    
-                    if (session->result.totalPackets > 0) {
-                        update.packetLossPercent = 100.0 * (1.0 - (double)session->result.packetsReceived / session->result.totalPackets);
-                        update.progress = (100 * session->result.packetsReceived) / session->result.totalPackets;
-                    }
-                    
-                    if (session->progressCallback) {
-                        session->progressCallback(update);
-                    }
-                }
-                
-                // Track packets sent
-                if (line.find("PING") != std::string::npos && line.find("bytes of data") != std::string::npos) {
-                    std::lock_guard<std::mutex> lock(session->resultMutex);
-                    session->result.totalPackets = session->config.count;
-                    update.packetsSent = 1;
-                } else if (packet.sequence > 0) {
-                    std::lock_guard<std::mutex> lock(session->resultMutex);
-                    session->result.packetsSent = std::max(session->result.packetsSent, packet.sequence);
-                    update.packetsSent = session->result.packetsSent;
-                }
-            },
-            session->shouldStop,
-            session->config.timeout * session->config.count + 30
-        );
+        update.latestPacket = packet;
+        update.packetsReceived = session->result.packetsReceived;
+        update.currentRtt = packet.rtt;
         
-        // Process final results
-        std::string fullOutput;
-        for (const auto& line : outputLines) {
-            fullOutput += line + "\n";
+        // Calculate running average
+        double totalRtt = 0.0;
+        for (const auto& p : session->result.packets) {
+            totalRtt += p.rtt;
         }
+        update.avgRtt = totalRtt / session->result.packets.size();
         
-        {
-            std::lock_guard<std::mutex> lock(session->resultMutex);
-            session->result.endTime = std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
-                std::chrono::system_clock::now().time_since_epoch()).count());
-            
-            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
-                std::chrono::steady_clock::now() - session->startTime);
-            session->result.totalDuration = elapsed.count() / 1000.0;
-            
-            session->result.rawOutput = json{{"output", fullOutput}};
-            
-            // Calculate final statistics
-            calculateStatistics(session->result);
-            
-            if (session->shouldStop.load()) {
-                session->result.success = false;
-                session->result.error = "Test stopped by user";
-                update.phase = "stopped";
-            } else if (session->result.packetsReceived > 0) {
-                session->result.success = true;
-                update.phase = "complete";
-                update.progress = 100;
-            } else {
-                session->result.success = false;
-                session->result.error = "No packets received";
-                update.phase = "error";
-            }
+        if (session->result.totalPackets > 0) {
+            update.packetLossPercent = 100.0 * (1.0 - (double)session->result.packetsReceived / session->result.totalPackets);
+            update.progress = (100 * session->result.packetsReceived) / session->result.totalPackets;
         }
         
         if (session->progressCallback) {
             session->progressCallback(update);
         }
+    }
+    
+    // Track packets sent
+    if (packet.sequence > 0) {
+        std::lock_guard<std::mutex> lock(session->resultMutex);
+        session->result.packetsSent = std::max(session->result.packetsSent, packet.sequence);
+        update.packetsSent = session->result.packetsSent;
+    }
+}
+
+void PingUtilityEngine::finishIcmpTest(TestSession* session, const IcmpEngine::Result& done) {
+    finishSession(session, done.cancelled, false, done.error);
+}
+
+void PingUtilityEngine::finishPingTest(TestSession* session, const ProcessEngine::Result& exit) {
+    finishSession(session, exit.cancelled, exit.timed_out,
+                  exit.error.empty() ? std::string() : "Failed to start ping: " + exit.error);
+}
+
+void PingUtilityEngine::finishSession(TestSession* session, bool cancelled, bool timedOut, const std::string& error) {
+    RealtimeUpdate& update = session->update;
+    
+    try {
+        std::lock_guard<std::mutex> lock(session->resultMutex);
+        session->result.endTime = std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+        
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - session->startTime);
+        session->result.totalDuration = elapsed.count() / 1000.0;
+        
+        session->result.rawOutput = json{{"output", session->output}};   // Empty for ICMP sessions
+        
+        // Calculate final statistics
+        calculateStatistics(session->result);
         
+        if (cancelled) {
+            session->result.success = false;
+            session->result.error = "Test stopped by user";
+            update.phase = "stopped";
+        } else if (!error.empty()) {
+            session->result.success = false;
+            session->result.error = error;
+            update.phase = "error";
+        } else if (session->result.packetsReceived > 0) {
+            session->result.success = true;
+            update.phase = "complete";
+            update.progress = 100;
+        } else {
+            session->result.success = false;
+            session->result.error = timedOut ? "Ping timed out" : "No packets received";
+            update.phase = "error";
+        }
     } catch (const std::exception& e) {
         ENDPOINT_LOG("ping-engine", "Exception in ping test: " + std::string(e.what()));
         
         std::lock_guard<std::mutex> lock(session->resultMutex);
         session->result.success = false;
         session->result.error = "Exception: " + std::string(e.what());
-        
-        RealtimeUpdate update;
         update.phase = "error";
-        if (session->progressCallback) {
-            session->progressCallback(update);
-        }
     }
     
+    if (session->progressCallback) {
+        session->progressCallback(update);
+    }
+    
+    // Notify under the lock: a waiter may destroy the session as soon as it wakes
+    std::lock_guard<std::mutex> lock(session->resultMutex);
     session->isRunning.store(false);
+    session->finished.notify_all();
 }
 
-std::string PingUtilityEngine::buildPingCommand(const PingConfig& config) const {
-    std::ostringstream cmd;
-    
-    cmd << "ping";
-    
-    if (config.ipv6) {
-        cmd << "6";
-    }
-    
-    cmd << " -c " << (config.continuous ? "0" : std::to_string(config.count));
-    cmd << " -s " << config.packetSize;
-    cmd << " -i " << std::fixed << std::setprecision(1) << config.interval;
-    cmd << " -W " << config.timeout;
-    cmd << " -t " << config.ttl;
+void PingUtilityEngine::waitForSession(TestSession* session) {
+    std::unique_lock<std::mutex> lock(session->resultMutex);
+    session->finished.wait(lock, [session]() { return !session->isRunning.load(); });
+}
+
+std::vector<std::string> PingUtilityEngine::buildPingCommand(const PingConfig& config) const {
+    std::ostringstream interval;
+    interval << std::fixed << std::setprecision(1) << config.interval;
+    
+    std::vector<std::string> argv = {
+        config.ipv6 ? "ping6" : "ping",
+        "-c", config.continuous ? "0" : std::to_string(config.count),
+        "-s", std::to_string(config.packetSize),
+        "-i", interval.str(),
+        "-W", std::to_string(config.timeout),
+        "-t", std::to_string(config.ttl)
+    };
     
     if (config.dontFragment) {
-        cmd << " -M do";
+        argv.insert(argv.end(), {"-M", "do"});
     }
     
-    cmd << " " << sanitizeHost(config.targetHost);
-    cmd << " 2>&1";
+    // No shell is involved any more; sanitizing still keeps option-like and
+    // garbage hosts away from ping
+    argv.push_back(sanitizeHost(config.targetHost));
     
-    return cmd.str();
+    return argv;
 }
 
 PingUtilityEngine::PingPacket PingUtilityEngine::parsePingLine(const std::string& line) const {
     PingPacket packet;
     
     // Standard ping response pattern
-    std::regex pingRegex(R"((\d+) bytes from ([^:]+): icmp_seq=(\d+) ttl=(\d+) time=([0-9.]+) ms)");
+    static const std::regex pingRegex(R"((\d+) bytes from ([^:]+): icmp_seq=(\d+) ttl=(\d+) time=([0-9.]+) ms)");
     std::smatch match;
     
     if (std::regex_search(line, match, pingRegex)) {
@@ -312,7 +408,7 @@ PingUtilityEngine::PingPacket PingUtilityEngine::parsePingLine(const std::string
         }
         
         // Try to extract sequence number from error lines
-        std::regex seqRegex(R"(icmp_seq=(\d+))");
+        static const std::regex seqRegex(R"(icmp_seq=(\d+))");
         if (std::regex_search(line, match, seqRegex)) {
             packet.sequence = std::stoi(match[1].str());
         }
@@ -375,44 +471,6 @@ void PingUtilityEngine::calculateStatistics(PingResult& result) const {
     }
 }
 
-int PingUtilityEngine::executeCommandWithRealtimeOutput(const std::string& command,
-                                                       std::function<void(const std::string&)> lineCallback,
-                                                       const std::atomic<bool>& shouldStop,
-                                                       int timeoutSeconds) {
-    FILE* pipe = popen(command.c_str(), "r");
-    if (!pipe) {
-        return -1;
-    }
-    
-    char buffer[1024];
-    auto startTime = std::chrono::steady_clock::now();
-    
-    while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-        if (shouldStop.load()) {
-            break;
-        }
-        
-        // Check timeout
-        auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
-            std::chrono::steady_clock::now() - startTime).count();
-        if (elapsed > timeoutSeconds) {
-            break;
-        }
-        
-        std::string line(buffer);
-        // Remove trailing newline
-        if (!line.empty() && line.back() == '\n') {
-            line.pop_back();
-        }
-        
-        if (lineCallback && !line.empty()) {
-            lineCallback(line);
-        }
-    }
-    
-    return pclose(pipe);
-}
-
 bool PingUtilityEngine::validateConfig(const PingConfig& config, std::string& error) {
     if (config.targetHost.empty()) {
         error = "Target host cannot be empty";
@@ -487,28 +545,6 @@ std::string PingUtilityEngine::generateTestId() const {
     return "ping_" + std::to_string(timestamp) + "_" + std::to_string(dis(gen));
 }
 
-std::string PingUtilityEngine::resolveHostname(const std::string& hostname) const {
-    std::string command = "getent hosts " + sanitizeHost(hostname) + " | head -1 | awk '{print $1}'";
-    
-    FILE* pipe = popen(command.c_str(), "r");
-    if (!pipe) {
-        return hostname; // Fallback to original
-    }
-    
-    char buffer[256];
-    std::string result;
-    if (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-        result = std::string(buffer);
-        // Remove trailing newline
-        if (!result.empty() && result.back() == '\n') {
-            result.pop_back();
-        }
-    }
-    
-    pclose(pipe);
-    return result.empty() ? hostname : result;
-}
-
 json PingUtilityEngine::configToJson(const PingConfig& config) {
     return json{
         {"targetHost", config.targetHost},
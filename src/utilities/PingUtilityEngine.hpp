@@ -10,7 +10,10 @@
 #include <mutex>
 #include <functional>
 #include <chrono>
+#include <condition_variable>
 #include "../third_party/nlohmann/json.hpp"
+#include "icmp_engine.h"
+#include "process_engine.h"
 
 using json = nlohmann::json;
 
@@ -99,39 +102,49 @@ public:
     static PingConfig configFromJson(const json& j);
 
 private:
+    // A test is a session on the shared IcmpEngine or, where ICMP sockets
+    // cannot be opened, a ping process on the ProcessEngine. Either way it is
+    // driven from a reactor thread and needs no thread of its own.
     struct TestSession {
         std::string testId;
         PingConfig config;
         std::atomic<bool> isRunning{false};
-        std::atomic<bool> shouldStop{false};
-        std::unique_ptr<std::thread> workerThread;
+        uint64_t icmpSession = 0;       // 0 when running the ping binary
+        CancellationToken cancel;
         PingResult result;
+        RealtimeUpdate update;          // Reactor thread only
+        double rttTotal = 0.0;          // Reactor thread only
+        std::string output;             // Reactor thread only
         ProgressCallback progressCallback;
         std::chrono::steady_clock::time_point startTime;
         mutable std::mutex resultMutex;
+        std::condition_variable finished;
     };
     
     mutable std::mutex sessionsMutex_;
     std::map<std::string, std::unique_ptr<TestSession>> activeSessions_;
     
-    // Worker thread functions
-    void runPingTest(TestSession* session);
-    std::string buildPingCommand(const PingConfig& config) const;
+    bool startIcmpTest(TestSession* session);
+    void startProcessTest(TestSession* session);
+    
+    // Reactor callbacks
+    void handleEcho(TestSession* session, const IcmpEngine::Echo& echo);
+    void handlePingLine(TestSession* session, const std::string& line);
+    void recordPacket(TestSession* session, const PingPacket& packet);
+    void finishIcmpTest(TestSession* session, const IcmpEngine::Result& done);
+    void finishPingTest(TestSession* session, const ProcessEngine::Result& exit);
+    void finishSession(TestSession* session, bool cancelled, bool timedOut, const std::string& error);
+    static void waitForSession(TestSession* session);
+    
+    std::vector<std::string> buildPingCommand(const PingConfig& config) const;
     bool parsePingOutput(const std::string& output, PingResult& result) const;
     PingPacket parsePingLine(const std::string& line) const;
     void calculateStatistics(PingResult& result) const;
     
-    // Process management
-    int executeCommandWithRealtimeOutput(const std::string& command,
-                                        std::function<void(const std::string&)> lineCallback,
-                                        const std::atomic<bool>& shouldStop,
-                                        int timeoutSeconds = 300);
-    
     // Validation and utilities
     bool isValidHost(const std::string& host) const;
     std::string sanitizeHost(const std::string& host) const;
     std::string generateTestId() const;
-    std::string resolveHostname(const std::string& hostname) const;
 };
 
 #endif // PING_UTILITY_ENGINE_H
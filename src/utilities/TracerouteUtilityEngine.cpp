@@ -1,12 +1,10 @@
 
 #include "TracerouteUtilityEngine.hpp"
 #include "endpoint_logger.h"
+#include "dns_engine.h"
+#include "icmp_engine.h"
 #include <sstream>
 #include <regex>
-#include <cstdlib>
-#include <unistd.h>
-#include <sys/wait.h>
-#include <signal.h>
 #include <iomanip>
 #include <algorithm>
 #include <random>
@@ -16,14 +14,15 @@ TracerouteUtilityEngine::TracerouteUtilityEngine() {
 }
 
 TracerouteUtilityEngine::~TracerouteUtilityEngine() {
-    // Stop all active tests
+    // Stop all active tests; their callbacks reference this engine
     std::lock_guard<std::mutex> lock(sessionsMutex_);
     for (auto& [testId, session] : activeSessions_) {
         if (session && session->isRunning.load()) {
-            session->shouldStop.store(true);
-            if (session->workerThread && session->workerThread->joinable()) {
-                session->workerThread->join();
+            session->cancel.cancel();
+            if (session->trace) {
+                TracerouteEngine::getInstance().stop(session->trace);
             }
+            waitForSession(session.get());
         }
     }
     activeSessions_.clear();
@@ -48,10 +47,22 @@ std::string TracerouteUtilityEngine::startTraceroute(const TracerouteConfig& con
         std::chrono::system_clock::now().time_since_epoch()).count());
     session->result.targetHost = config.targetHost;
     session->result.maxHops = config.maxHops;
+    // Replaced by the resolved address (or the one traceroute reports in its header line)
+    session->result.resolvedIp = config.targetHost;
     
-    // Start worker thread
-    session->isRunning.store(true);
-    session->workerThread = std::make_unique<std::thread>(&TracerouteUtilityEngine::runTraceroute, this, session.get());
+    TestSession* raw = session.get();
+    raw->update.phase = "starting";
+    raw->update.totalHops = config.maxHops;
+    if (raw->progressCallback) {
+        raw->progressCallback(raw->update);
+    }
+    
+    raw->isRunning.store(true);
+    // The traceroute binary is only needed for protocols this process cannot
+    // send itself (TCP without raw sockets)
+    if (!startNativeTrace(raw)) {
+        startProcessTrace(raw);
+    }
     
     {
         std::lock_guard<std::mutex> lock(sessionsMutex_);
@@ -62,6 +73,65 @@ std::string TracerouteUtilityEngine::startTraceroute(const TracerouteConfig& con
     return testId;
 }
 
+bool TracerouteUtilityEngine::startNativeTrace(TestSession* session) {
+    const TracerouteConfig& config = session->config;
+    int family = config.ipv6 ? AF_INET6 : AF_INET;
+    TracerouteEngine::Protocol protocol = config.protocol == "udp" ? TracerouteEngine::Protocol::UDP
+        : config.protocol == "tcp" ? TracerouteEngine::Protocol::TCP : TracerouteEngine::Protocol::ICMP;
+    if (!TracerouteEngine::supports(protocol, family)) {
+        return false;
+    }
+    
+    TracerouteEngine::Options options;
+    std::string error;
+    if (!DnsEngine::getInstance().resolve(sanitizeHost(config.targetHost), family, options.address,
+                                          options.address_length, error)) {
+        finishSession(session, false, false, "Cannot resolve " + config.targetHost + ": " + error);
+        return true;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(session->resultMutex);
+        session->result.resolvedIp = IcmpEngine::formatAddress(reinterpret_cast<const sockaddr*>(&options.address));
+    }
+    
+    options.protocol = protocol;
+    options.port = static_cast<uint16_t>(config.port);
+    options.max_hops = config.maxHops;
+    options.queries = config.queries;
+    options.timeout = std::chrono::seconds(config.timeout);
+    options.dont_fragment = config.dontFragment;
+    options.resolve_names = config.resolve;
+    options.on_hop = [this, session](const TracerouteEngine::Hop& hop) { handleHop(session, hop); };
+    options.on_done = [this, session](const TracerouteEngine::Result& done) { finishNativeTrace(session, done); };
+    
+    // Same header as traceroute(8), so rawOutput reads the same either way
+    session->output = "traceroute to " + sanitizeHost(config.targetHost) + " (" + session->result.resolvedIp + "), " +
+                      std::to_string(config.maxHops) + " hops max\n";
+    session->update.phase = "tracing";
+    if (session->progressCallback) {
+        session->progressCallback(session->update);
+    }
+    
+    ENDPOINT_LOG("traceroute-engine", "Tracing " + session->result.resolvedIp + " over " + config.protocol + " probes");
+    session->trace = TracerouteEngine::getInstance().start(std::move(options));
+    return true;
+}
+
+void TracerouteUtilityEngine::startProcessTrace(TestSession* session) {
+    const TracerouteConfig& config = session->config;
+    
+    ProcessEngine::Options options;
+    options.argv = buildTracerouteCommand(config);
+    options.timeout = std::chrono::seconds(config.timeout * config.maxHops + 60);
+    options.cancel = session->cancel;
+    options.on_line = [this, session](const std::string& line) { handleTracerouteLine(session, line); };
+    options.on_exit = [this, session](const ProcessEngine::Result& exit) { finishTraceroute(session, exit); };
+    
+    ENDPOINT_LOG("traceroute-engine", "Executing: " + options.argv[0] + " " + sanitizeHost(config.targetHost));
+    ProcessEngine::getInstance().spawn(std::move(options));
+}
+
 bool TracerouteUtilityEngine::stopTraceroute(const std::string& testId) {
     std::lock_guard<std::mutex> lock(sessionsMutex_);
     
@@ -72,15 +142,12 @@ bool TracerouteUtilityEngine::stopTraceroute(const std::string& testId) {
     
     auto& session = it->second;
     if (session && session->isRunning.load()) {
-        session->shouldStop.store(true);
-        
-        // Kill any traceroute processes
-        std::string killCmd = "pkill -f 'traceroute.*" + session->config.targetHost + "'";
-        system(killCmd.c_str());
-        
-        if (session->workerThread && session->workerThread->joinable()) {
-            session->workerThread->join();
+        // Ends this test's trace or process group only
+        session->cancel.cancel();
+        if (session->trace) {
+            TracerouteEngine::getInstance().stop(session->trace);
         }
+        waitForSession(session.get());
         
         ENDPOINT_LOG("traceroute-engine", "Stopped traceroute: " + testId);
         return true;
@@ -123,204 +190,245 @@ std::vector<std::string> TracerouteUtilityEngine::getActiveTestIds() const {
     return activeIds;
 }
 
-void TracerouteUtilityEngine::runTraceroute(TestSession* session) {
-    if (!session) return;
+void TracerouteUtilityEngine::handleHop(TestSession* session, const TracerouteEngine::Hop& engineHop) {
+    TracerouteHop hop;
+    hop.hopNumber = engineHop.number;
+    if (!engineHop.address.empty()) {
+        hop.ip = engineHop.address;
+        hop.hostname = engineHop.hostname.empty() ? engineHop.address : engineHop.hostname;
+    }
+    hop.rtts = engineHop.rtts;
+    hop.errors = engineHop.errors;
+    hop.timeout = engineHop.lost > 0;
+    hop.complete = true;
     
-    try {
-        RealtimeUpdate update;
-        update.phase = "starting";
-        update.totalHops = session->config.maxHops;
-        
+    // " 3  router.example.net (192.0.2.1)  1.234 ms  1.301 ms *"
+    std::ostringstream line;
+    line << std::setw(2) << hop.hopNumber << " ";
+    if (!engineHop.address.empty()) {
+        line << " " << hop.hostname << " (" << hop.ip << ")";
+    }
+    line << std::fixed << std::setprecision(3);
+    for (double rtt : hop.rtts) {
+        line << "  " << rtt << " ms";
+    }
+    for (int i = 0; i < engineHop.lost; ++i) {
+        line << " *";
+    }
+    for (const auto& error : hop.errors) {
+        line << " " << error;
+    }
+    session->output += line.str();
+    session->output += '\n';
+    
+    RealtimeUpdate& update = session->update;
+    std::lock_guard<std::mutex> lock(session->resultMutex);
+    
+    // Hops arrive in order, each once
+    session->result.hops.push_back(hop);
+    
+    update.currentHop = hop.hopNumber;
+    update.latestHop = hop;
+    update.progress = (100 * hop.hopNumber) / session->config.maxHops;
+    if (engineHop.reached) {
+        update.reachedTarget = true;
+        session->result.reachedTarget = true;
+        session->result.totalHops = hop.hopNumber;
+    }
+    
+    if (session->progressCallback) {
+        session->progressCallback(update);
+    }
+}
+
+void TracerouteUtilityEngine::handleTracerouteLine(TestSession* session, const std::string& line) {
+    if (line.empty() || session->cancel.isCancelled()) return;
+    
+    RealtimeUpdate& update = session->update;
+    session->output += line;
+    session->output += '\n';
+    
+    // "traceroute to example.com (93.184.216.34), 30 hops max, 60 byte packets"
+    if (line.rfind("traceroute", 0) == 0) {
+        size_t open = line.find('(');
+        size_t close = open == std::string::npos ? std::string::npos : line.find(')', open);
+        if (close != std::string::npos) {
+            std::lock_guard<std::mutex> lock(session->resultMutex);
+            session->result.resolvedIp = line.substr(open + 1, close - open - 1);
+        }
+        update.phase = "tracing";
         if (session->progressCallback) {
             session->progressCallback(update);
         }
+        return;
+    }
+    
+    // Parse individual traceroute hop
+    TracerouteHop hop = parseTracerouteLine(line);
+    if (hop.hopNumber > 0) {
+        std::lock_guard<std::mutex> lock(session->resultMutex);
         
-        // Resolve hostname first
-        std::string resolvedIp = resolveHostname(session->config.targetHost);
-        {
-            std::lock_guard<std::mutex> lock(session->resultMutex);
-            session->result.resolvedIp = resolvedIp;
+        // Find existing hop or add new one
+        auto it = std::find_if(session->result.hops.begin(), session->result.hops.end(),
+            [&hop](const TracerouteHop& h) { return h.hopNumber == hop.hopNumber; });
+        
+        if (it != session->result.hops.end()) {
+            // Merge data into existing hop
+            if (!hop.rtts.empty()) {
+                it->rtts.insert(it->rtts.end(), hop.rtts.begin(), hop.rtts.end());
+            }
+            if (hop.hostname != "*" && it->hostname == "*") {
+                it->hostname = hop.hostname;
+            }
+            if (hop.ip != "*" && it->ip == "*") {
+                it->ip = hop.ip;
+            }
+            it->timeout = hop.timeout;
+            it->complete = hop.complete;
+        } else {
+            // Add new hop
+            session->result.hops.push_back(hop);
+            std::sort(session->result.hops.begin(), session->result.hops.end(),
+                [](const TracerouteHop& a, const TracerouteHop& b) {
+                    return a.hopNumber < b.hopNumber;
+                });
         }
         
-        std::string command = buildTracerouteCommand(session->config);
-        ENDPOINT_LOG("traceroute-engine", "Executing: " + command);
+        update.currentHop = hop.hopNumber;
+        update.latestHop = hop;
+        update.progress = (100 * hop.hopNumber) / session->config.maxHops;
+        
+        // Check if we reached the target
+        if (hop.ip == session->result.resolvedIp || hop.hostname == session->config.targetHost) {
+            update.reachedTarget = true;
+            session->result.reachedTarget = true;
+            session->result.totalHops = hop.hopNumber;
+        }
         
-        update.phase = "tracing";
         if (session->progressCallback) {
             session->progressCallback(update);
         }
+    }
+}
+
+void TracerouteUtilityEngine::finishNativeTrace(TestSession* session, const TracerouteEngine::Result& done) {
+    finishSession(session, done.cancelled, false, done.error);
+}
+
+void TracerouteUtilityEngine::finishTraceroute(TestSession* session, const ProcessEngine::Result& exit) {
+    finishSession(session, exit.cancelled, exit.timed_out,
+                  exit.error.empty() ? std::string() : "Failed to start traceroute: " + exit.error);
+}
+
+void TracerouteUtilityEngine::finishSession(TestSession* session, bool cancelled, bool timedOut, const std::string& error) {
+    RealtimeUpdate& update = session->update;
+    
+    try {
+        std::lock_guard<std::mutex> lock(session->resultMutex);
+        session->result.endTime = std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
         
-        std::vector<std::string> outputLines;
-        int exitCode = executeCommandWithRealtimeOutput(command,
-            [session, &update, &outputLines](const std::string& line) {
-                if (session->shouldStop.load()) return;
-                
-                outputLines.push_back(line);
-                
-                // Parse individual traceroute hop
-                TracerouteHop hop = TracerouteUtilityEngine().parseTracerouteLine(line);
-                if (hop.hopNumber > 0) {
-                    std::lock_guard<std::mutex> lock(session->resultMutex);
-                    
-                    // Find existing hop or add new one
-                    auto it = std::find_if(session->result.hops.begin(), session->result.hops.end(),
-                        [&hop](const TracerouteHop& h) { return h.hopNumber == hop.hopNumber; });
-                    
-                    if (it != session->result.hops.end()) {
-                        // Merge data into existing hop
-                        if (!hop.rtts.empty()) {
-                            it->rtts.insert(it->rtts.end(), hop.rtts.begin(), hop.rtts.end());
-                        }
-                        if (hop.hostname != "*" && it->hostname == "*") {
-                            it->hostname = hop.hostname;
-                        }
-                        if (hop.ip != "*" && it->ip == "*") {
-                            it->ip = hop.ip;
-                        }
-                        it->timeout = hop.timeout;
-                        it->complete = hop.complete;
-                    } else {
-                        // Add new hop
-                        session->result.hops.push_back(hop);
-                        std::sort(session->result.hops.begin(), session->result.hops.end(),
-                            [](const TracerouteHop& a, const TracerouteHop& b) {
-                                return a.hopNumber < b.hopNumber;
-                            });
-                    }
-                    
-                    update.currentHop = hop.hopNumber;
-                    update.latestHop = hop;
-                    update.progress = (100 * hop.hopNumber) / session->config.maxHops;
-                    
-                    // Check if we reached the target
-                    if (hop.ip == session->result.resolvedIp || hop.hostname == session->config.targetHost) {
-                        update.reachedTarget = true;
-                        session->result.reachedTarget = true;
-                        session->result.totalHops = hop.hopNumber;
-                    }
-                    
-                    if (session->progressCallback) {
-                        session->progressCallback(update);
-                    }
-                }
-            },
-            session->shouldStop,
-            session->config.timeout * session->config.maxHops + 60
-        );
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - session->startTime);
+        session->result.totalTime = elapsed.count() / 1000.0;
         
-        // Process final results
-        std::string fullOutput;
-        for (const auto& line : outputLines) {
-            fullOutput += line + "\n";
-        }
+        session->result.rawOutput = json{{"output", session->output}};
         
-        {
-            std::lock_guard<std::mutex> lock(session->resultMutex);
-            session->result.endTime = std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
-                std::chrono::system_clock::now().time_since_epoch()).count());
-            
-            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
-                std::chrono::steady_clock::now() - session->startTime);
-            session->result.totalTime = elapsed.count() / 1000.0;
+        // Calculate statistics
+        if (!session->result.hops.empty()) {
+            session->result.totalHops = session->result.hops.back().hopNumber;
             
-            session->result.rawOutput = json{{"output", fullOutput}};
+            double totalHopTime = 0.0;
+            int hopCount = 0;
+            int timeouts = 0;
             
-            // Calculate statistics
-            if (!session->result.hops.empty()) {
-                session->result.totalHops = session->result.hops.back().hopNumber;
-                
-                double totalHopTime = 0.0;
-                int hopCount = 0;
-                int timeouts = 0;
-                
-                for (const auto& hop : session->result.hops) {
-                    if (!hop.rtts.empty()) {
-                        for (double rtt : hop.rtts) {
-                            totalHopTime += rtt;
-                            hopCount++;
-                        }
-                    }
-                    if (hop.timeout) {
-                        timeouts++;
+            for (const auto& hop : session->result.hops) {
+                if (!hop.rtts.empty()) {
+                    for (double rtt : hop.rtts) {
+                        totalHopTime += rtt;
+                        hopCount++;
                     }
                 }
-                
-                if (hopCount > 0) {
-                    session->result.avgHopTime = totalHopTime / hopCount;
+                if (hop.timeout) {
+                    timeouts++;
                 }
-                session->result.timeouts = timeouts;
             }
             
-            if (session->shouldStop.load()) {
-                session->result.success = false;
-                session->result.error = "Test stopped by user";
-                update.phase = "stopped";
-            } else if (!session->result.hops.empty()) {
-                session->result.success = true;
-                update.phase = "complete";
-                update.progress = 100;
-            } else {
-                session->result.success = false;
-                session->result.error = "No hops received";
-                update.phase = "error";
+            if (hopCount > 0) {
+                session->result.avgHopTime = totalHopTime / hopCount;
             }
+            session->result.timeouts = timeouts;
         }
         
-        if (session->progressCallback) {
-            session->progressCallback(update);
+        if (cancelled) {
+            session->result.success = false;
+            session->result.error = "Test stopped by user";
+            update.phase = "stopped";
+        } else if (!error.empty()) {
+            session->result.success = false;
+            session->result.error = error;
+            update.phase = "error";
+        } else if (!session->result.hops.empty()) {
+            session->result.success = true;
+            update.phase = "complete";
+            update.progress = 100;
+        } else {
+            session->result.success = false;
+            session->result.error = timedOut ? "Traceroute timed out" : "No hops received";
+            update.phase = "error";
         }
-        
     } catch (const std::exception& e) {
         ENDPOINT_LOG("traceroute-engine", "Exception in traceroute: " + std::string(e.what()));
         
         std::lock_guard<std::mutex> lock(session->resultMutex);
         session->result.success = false;
         session->result.error = "Exception: " + std::string(e.what());
-        
-        RealtimeUpdate update;
         update.phase = "error";
-        if (session->progressCallback) {
-            session->progressCallback(update);
-        }
     }
     
+    if (session->progressCallback) {
+        session->progressCallback(update);
+    }
+    
+    // Notify under the lock: a waiter may destroy the session as soon as it wakes
+    std::lock_guard<std::mutex> lock(session->resultMutex);
     session->isRunning.store(false);
+    session->finished.notify_all();
 }
 
-std::string TracerouteUtilityEngine::buildTracerouteCommand(const TracerouteConfig& config) const {
-    std::ostringstream cmd;
-    
-    if (config.ipv6) {
-        cmd << "traceroute6";
-    } else {
-        cmd << "traceroute";
-    }
-    
-    cmd << " -m " << config.maxHops;
-    cmd << " -w " << config.timeout;
-    cmd << " -q " << config.queries;
+void TracerouteUtilityEngine::waitForSession(TestSession* session) {
+    std::unique_lock<std::mutex> lock(session->resultMutex);
+    session->finished.wait(lock, [session]() { return !session->isRunning.load(); });
+}
+
+std::vector<std::string> TracerouteUtilityEngine::buildTracerouteCommand(const TracerouteConfig& config) const {
+    std::vector<std::string> argv = {
+        config.ipv6 ? "traceroute6" : "traceroute",
+        "-m", std::to_string(config.maxHops),
+        "-w", std::to_string(config.timeout),
+        "-q", std::to_string(config.queries)
+    };
     
     if (config.protocol == "udp") {
-        cmd << " -U";
+        argv.push_back("-U");
         if (config.port != 33434) {
-            cmd << " -p " << config.port;
+            argv.insert(argv.end(), {"-p", std::to_string(config.port)});
         }
     } else if (config.protocol == "tcp") {
-        cmd << " -T -p " << config.port;
+        argv.insert(argv.end(), {"-T", "-p", std::to_string(config.port)});
     }
     
     if (!config.resolve) {
-        cmd << " -n";
+        argv.push_back("-n");
     }
     
     if (config.dontFragment) {
-        cmd << " -F";
+        argv.push_back("-F");
     }
     
-    cmd << " " << sanitizeHost(config.targetHost);
-    cmd << " 2>&1";
+    argv.push_back(sanitizeHost(config.targetHost));
     
-    return cmd.str();
+    return argv;
 }
 
 TracerouteUtilityEngine::TracerouteHop TracerouteUtilityEngine::parseTracerouteLine(const std::string& line) const {
@@ -332,7 +440,7 @@ TracerouteUtilityEngine::TracerouteHop TracerouteUtilityEngine::parseTracerouteL
     }
     
     // Standard traceroute line pattern: " 1  hostname (ip)  rtt1 ms  rtt2 ms  rtt3 ms"
-    std::regex hopRegex(R"(^\s*(\d+)\s+([^\s]+)\s+\(([^)]+)\)\s+([\d.]+)\s*ms)");
+    static const std::regex hopRegex(R"(^\s*(\d+)\s+([^\s]+)\s+\(([^)]+)\)\s+([\d.]+)\s*ms)");
     std::smatch match;
     
     if (std::regex_search(line, match, hopRegex)) {
@@ -341,7 +449,7 @@ TracerouteUtilityEngine::TracerouteHop TracerouteUtilityEngine::parseTracerouteL
         hop.ip = match[3].str();
         
         // Parse all RTT values in the line
-        std::regex rttRegex(R"(([\d.]+)\s*ms)");
+        static const std::regex rttRegex(R"(([\d.]+)\s*ms)");
         std::sregex_iterator rttIt(line.begin(), line.end(), rttRegex);
         std::sregex_iterator rttEnd;
         
@@ -355,14 +463,14 @@ TracerouteUtilityEngine::TracerouteHop TracerouteUtilityEngine::parseTracerouteL
     }
     
     // Pattern for numeric IP only: " 1  192.168.1.1  rtt1 ms  rtt2 ms  rtt3 ms"
-    std::regex ipOnlyRegex(R"(^\s*(\d+)\s+([0-9.]+)\s+([\d.]+)\s*ms)");
+    static const std::regex ipOnlyRegex(R"(^\s*(\d+)\s+([0-9.]+)\s+([\d.]+)\s*ms)");
     if (std::regex_search(line, match, ipOnlyRegex)) {
         hop.hopNumber = std::stoi(match[1].str());
         hop.ip = match[2].str();
         hop.hostname = match[2].str(); // Use IP as hostname
         
         // Parse RTT values
-        std::regex rttRegex(R"(([\d.]+)\s*ms)");
+        static const std::regex rttRegex(R"(([\d.]+)\s*ms)");
         std::sregex_iterator rttIt(line.begin(), line.end(), rttRegex);
         std::sregex_iterator rttEnd;
         
@@ -376,7 +484,7 @@ TracerouteUtilityEngine::TracerouteHop TracerouteUtilityEngine::parseTracerouteL
     }
     
     // Pattern for timeouts: " 1  * * *"
-    std::regex timeoutRegex(R"(^\s*(\d+)\s+\*.*\*)");
+    static const std::regex timeoutRegex(R"(^\s*(\d+)\s+\*.*\*)");
     if (std::regex_search(line, match, timeoutRegex)) {
         hop.hopNumber = std::stoi(match[1].str());
         hop.timeout = true;
@@ -385,12 +493,12 @@ TracerouteUtilityEngine::TracerouteHop TracerouteUtilityEngine::parseTracerouteL
     }
     
     // Pattern for mixed responses: " 1  hostname (ip) rtt ms  *  rtt ms"
-    std::regex mixedRegex(R"(^\s*(\d+)\s+([^\s*]+))");
+    static const std::regex mixedRegex(R"(^\s*(\d+)\s+([^\s*]+))");
     if (std::regex_search(line, match, mixedRegex)) {
         hop.hopNumber = std::stoi(match[1].str());
         
         std::string hostPart = match[2].str();
-        std::regex hostIpRegex(R"(([^\s(]+)\s*\(([^)]+)\))");
+        static const std::regex hostIpRegex(R"(([^\s(]+)\s*\(([^)]+)\))");
         std::smatch hostMatch;
         
         if (std::regex_search(hostPart, hostMatch, hostIpRegex)) {
@@ -402,7 +510,7 @@ TracerouteUtilityEngine::TracerouteHop TracerouteUtilityEngine::parseTracerouteL
         }
         
         // Parse RTT values
-        std::regex rttRegex(R"(([\d.]+)\s*ms)");
+        static const std::regex rttRegex(R"(([\d.]+)\s*ms)");
         std::sregex_iterator rttIt(line.begin(), line.end(), rttRegex);
         std::sregex_iterator rttEnd;
         
@@ -423,44 +531,6 @@ TracerouteUtilityEngine::TracerouteHop TracerouteUtilityEngine::parseTracerouteL
     return hop; // Return empty hop if no pattern matches
 }
 
-int TracerouteUtilityEngine::executeCommandWithRealtimeOutput(const std::string& command,
-                                                            std::function<void(const std::string&)> lineCallback,
-                                                            const std::atomic<bool>& shouldStop,
-                                                            int timeoutSeconds) {
-    FILE* pipe = popen(command.c_str(), "r");
-    if (!pipe) {
-        return -1;
-    }
-    
-    char buffer[1024];
-    auto startTime = std::chrono::steady_clock::now();
-    
-    while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-        if (shouldStop.load()) {
-            break;
-        }
-        
-        // Check timeout
-        auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
-            std::chrono::steady_clock::now() - startTime).count();
-        if (elapsed > timeoutSeconds) {
-            break;
-        }
-        
-        std::string line(buffer);
-        // Remove trailing newline
-        if (!line.empty() && line.back() == '\n') {
-            line.pop_back();
-        }
-        
-        if (lineCallback && !line.empty()) {
-            lineCallback(line);
-        }
-    }
-    
-    return pclose(pipe);
-}
-
 bool TracerouteUtilityEngine::validateConfig(const TracerouteConfig& config, std::string& error) {
     if (config.targetHost.empty()) {
         error = "Target host cannot be empty";
@@ -535,50 +605,6 @@ std::string TracerouteUtilityEngine::generateTestId() const {
     return "traceroute_" + std::to_string(timestamp) + "_" + std::to_string(dis(gen));
 }
 
-std::string TracerouteUtilityEngine::resolveHostname(const std::string& hostname) const {
-    std::string command = "getent hosts " + sanitizeHost(hostname) + " | head -1 | awk '{print $1}'";
-    
-    FILE* pipe = popen(command.c_str(), "r");
-    if (!pipe) {
-        return hostname; // Fallback to original
-    }
-    
-    char buffer[256];
-    std::string result;
-    if (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-        result = std::string(buffer);
-        // Remove trailing newline
-        if (!result.empty() && result.back() == '\n') {
-            result.pop_back();
-        }
-    }
-    
-    pclose(pipe);
-    return result.empty() ? hostname : result;
-}
-
-std::string TracerouteUtilityEngine::lookupHostname(const std::string& ip) const {
-    std::string command = "getent hosts " + sanitizeHost(ip) + " | head -1 | awk '{print $2}'";
-    
-    FILE* pipe = popen(command.c_str(), "r");
-    if (!pipe) {
-        return ip; // Fallback to IP
-    }
-    
-    char buffer[256];
-    std::string result;
-    if (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-        result = std::string(buffer);
-        // Remove trailing newline
-        if (!result.empty() && result.back() == '\n') {
-            result.pop_back();
-        }
-    }
-    
-    pclose(pipe);
-    return result.empty() ? ip : result;
-}
-
 json TracerouteUtilityEngine::configToJson(const TracerouteConfig& config) {
     return json{
         {"targetHost", config.targetHost},
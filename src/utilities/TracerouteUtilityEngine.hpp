@@ -10,7 +10,10 @@
 #include <mutex>
 #include <functional>
 #include <chrono>
+#include <condition_variable>
 #include "../third_party/nlohmann/json.hpp"
+#include "process_engine.h"
+#include "traceroute_engine.h"
 
 using json = nlohmann::json;
 
@@ -94,39 +97,46 @@ public:
     static TracerouteConfig configFromJson(const json& j);
 
 private:
+    // A traceroute is a trace on the shared TracerouteEngine or, where the
+    // protocol cannot be sent natively, a traceroute process on the
+    // ProcessEngine. Hops are recorded on the reactor thread as they arrive.
     struct TestSession {
         std::string testId;
         TracerouteConfig config;
         std::atomic<bool> isRunning{false};
-        std::atomic<bool> shouldStop{false};
-        std::unique_ptr<std::thread> workerThread;
+        uint64_t trace = 0;             // 0 when running the traceroute binary
+        CancellationToken cancel;
         TracerouteResult result;
+        RealtimeUpdate update;          // Reactor thread only
+        std::string output;             // Reactor thread only
         ProgressCallback progressCallback;
         std::chrono::steady_clock::time_point startTime;
         mutable std::mutex resultMutex;
+        std::condition_variable finished;
     };
     
     mutable std::mutex sessionsMutex_;
     std::map<std::string, std::unique_ptr<TestSession>> activeSessions_;
     
-    // Worker thread functions
-    void runTraceroute(TestSession* session);
-    std::string buildTracerouteCommand(const TracerouteConfig& config) const;
+    bool startNativeTrace(TestSession* session);
+    void startProcessTrace(TestSession* session);
+    
+    // Reactor callbacks
+    void handleHop(TestSession* session, const TracerouteEngine::Hop& hop);
+    void handleTracerouteLine(TestSession* session, const std::string& line);
+    void finishNativeTrace(TestSession* session, const TracerouteEngine::Result& done);
+    void finishTraceroute(TestSession* session, const ProcessEngine::Result& exit);
+    void finishSession(TestSession* session, bool cancelled, bool timedOut, const std::string& error);
+    static void waitForSession(TestSession* session);
+    
+    std::vector<std::string> buildTracerouteCommand(const TracerouteConfig& config) const;
     TracerouteHop parseTracerouteLine(const std::string& line) const;
     void processTracerouteOutput(const std::vector<std::string>& lines, TracerouteResult& result) const;
     
-    // Process management
-    int executeCommandWithRealtimeOutput(const std::string& command,
-                                        std::function<void(const std::string&)> lineCallback,
-                                        const std::atomic<bool>& shouldStop,
-                                        int timeoutSeconds = 300);
-    
     // Validation and utilities
     bool isValidHost(const std::string& host) const;
     std::string sanitizeHost(const std::string& host) const;
     std::string generateTestId() const;
-    std::string resolveHostname(const std::string& hostname) const;
-    std::string lookupHostname(const std::string& ip) const;
 };
 
 #endif // TRACEROUTE_UTILITY_ENGINE_H
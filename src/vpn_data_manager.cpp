@@ -1,7 +1,7 @@
 
 #include "vpn_data_manager.h"
 #include "config_manager.h"
-#include <fstream>
+#include "json_document_store.h"
 #include <iostream>
 #include <chrono>
 #include <iomanip>
@@ -25,23 +25,12 @@ VpnDataManager& VpnDataManager::getInstance() {
 }
 
 json VpnDataManager::loadDataFromFile(const std::string& filePath) {
-    try {
-        std::ifstream file(filePath);
-        if (!file.is_open()) {
-            std::cerr << "[VPN-DATA-MGR] Error: Could not open file " << filePath << std::endl;
-            return json::object();
-        }
-        
-        json data;
-        file >> data;
-        file.close();
-        
-        std::cout << "[VPN-DATA-MGR] Successfully loaded data from " << filePath << std::endl;
-        return data;
-    } catch (const std::exception& e) {
-        std::cerr << "[VPN-DATA-MGR] Error loading data from " << filePath << ": " << e.what() << std::endl;
+    json data;
+    if (!JsonDocumentStore::getInstance().read(filePath, data)) {
+        std::cerr << "[VPN-DATA-MGR] Error: Could not open file " << filePath << std::endl;
         return json::object();
     }
+    return data;
 }
 
 bool VpnDataManager::saveDataToFile(const std::string& filePath, const json& data) {
@@ -49,16 +38,10 @@ bool VpnDataManager::saveDataToFile(const std::string& filePath, const json& dat
         // Ensure directory exists
         std::filesystem::create_directories(std::filesystem::path(filePath).parent_path());
         
-        std::ofstream file(filePath);
-        if (!file.is_open()) {
+        if (!JsonDocumentStore::getInstance().write(filePath, data, 2)) {
             std::cerr << "[VPN-DATA-MGR] Error: Could not open file for writing " << filePath << std::endl;
             return false;
         }
-        
-        file << data.dump(2);
-        file.close();
-        
-        std::cout << "[VPN-DATA-MGR] Successfully saved data to " << filePath << std::endl;
         return true;
     } catch (const std::exception& e) {
         std::cerr << "[VPN-DATA-MGR] Error saving data to " << filePath << ": " << e.what() << std::endl;
@@ -150,12 +133,9 @@ bool VpnDataManager::deleteVpnProfile(const std::string& profileId) {
 }
 
 json VpnDataManager::getVpnProfile(const std::string& profileId) {
-    json profiles = getVpnProfiles();
-    
-    for (const auto& profile : profiles) {
-        if (profile["id"] == profileId) {
-            return profile;
-        }
+    json profile;
+    if (JsonDocumentStore::getInstance().find(VPN_PROFILES_FILE, "vpn_profiles", profileId, profile)) {
+        return profile;
     }
     return json::object();
 }
@@ -217,12 +197,9 @@ bool VpnDataManager::deleteRoutingRule(const std::string& ruleId) {
 }
 
 json VpnDataManager::getRoutingRule(const std::string& ruleId) {
-    json rules = getRoutingRules();
-    
-    for (const auto& rule : rules) {
-        if (rule["id"] == ruleId) {
-            return rule;
-        }
+    json rule;
+    if (JsonDocumentStore::getInstance().find(ROUTING_RULES_FILE, "routing_rules", ruleId, rule)) {
+        return rule;
     }
     return json::object();
 }
@@ -5,6 +5,7 @@
 #include "http_handler.h"
 #include "file_server.h"
 #include "api_request.h"
+#include "event_stream.h"
 #include <iostream>
 #include <cstring>
 #include <algorithm>
@@ -43,6 +44,8 @@ void WebServer::setConfig(const ServerConfig& config) {
    if (file_server_) {
        file_server_->setDocumentRoot(config_.document_root);
        file_server_->setDefaultFile(config_.default_file);
+       file_server_->setCacheControlRules(config_.cache_control);
+       file_server_->setImmutableFingerprintedAssets(config_.immutable_fingerprinted_assets);
    }
 }
 
@@ -53,17 +56,29 @@ bool WebServer::start() {
    }
 
    try {
-       // Simplified HTTP daemon flags for better compatibility
-       unsigned int flags = MHD_USE_INTERNAL_POLLING_THREAD;
+       // A previous stop() closed the event streams and refuses new ones
+       EventStream::reopen();
+
+       unsigned int flags = buildDaemonFlags();
+       bool use_pool = (config_.threading_mode == "thread_pool");
+       
+       // Options are assembled as an array so the pool size is only passed in pool mode
+       // (MHD rejects MHD_OPTION_THREAD_POOL_SIZE > 1 together with thread-per-connection)
+       std::vector<struct MHD_OptionItem> options;
+       options.push_back({MHD_OPTION_CONNECTION_TIMEOUT, (intptr_t)config_.connection_timeout, nullptr});
+       options.push_back({MHD_OPTION_CONNECTION_LIMIT, (intptr_t)config_.max_connections, nullptr});
+       options.push_back({MHD_OPTION_NOTIFY_COMPLETED, (intptr_t)&WebServer::requestCompletedCallback, this});
+       if (use_pool) {
+           options.push_back({MHD_OPTION_THREAD_POOL_SIZE, (intptr_t)config_.thread_pool_size, nullptr});
+       }
+       options.push_back({MHD_OPTION_END, 0, nullptr});
        
-       // Start HTTP server with minimal configuration for debugging
        http_daemon_ = MHD_start_daemon(
            flags,
            config_.port,
            nullptr, nullptr,
            &WebServer::accessHandlerCallback, this,
-           MHD_OPTION_CONNECTION_TIMEOUT, (unsigned int)30,
-           MHD_OPTION_NOTIFY_COMPLETED, &WebServer::requestCompletedCallback, this,
+           MHD_OPTION_ARRAY, options.data(),
            MHD_OPTION_END
        );
 
@@ -73,7 +88,13 @@ bool WebServer::start() {
            return false;
        }
 
-       std::cout << "HTTP server started on " << config_.host << ":" << config_.port << std::endl;
+       std::cout << "HTTP server started on " << config_.host << ":" << config_.port
+                 << " (threading: " << config_.threading_mode;
+       if (use_pool) {
+           std::cout << ", " << config_.thread_pool_size << " workers";
+       }
+       std::cout << ", max connections: " << config_.max_connections
+                 << ", timeout: " << config_.connection_timeout << "s)" << std::endl;
 
        // Start WebSocket server if enabled
        if (config_.enable_websocket) {
@@ -116,6 +137,10 @@ void WebServer::stop() {
 
    // Stop HTTP server
    if (http_daemon_) {
+       // Event streams never end on their own (and suspended ones would keep
+       // MHD_stop_daemon waiting), so close them and let their connections
+       // drain while the daemon can still resume and finish them
+       EventStream::closeAll();
        MHD_stop_daemon(http_daemon_);
        http_daemon_ = nullptr;
        std::cout << "HTTP server stopped" << std::endl;
@@ -182,6 +207,18 @@ void WebServer::addStructuredRouteHandler(const std::string& path, RouteProcesso
    addRouteHandler(path, wrapper_handler);
 }
 
+void WebServer::addStreamingRouteHandler(const std::string& path, StreamingRouteFactory factory) {
+   if (http_handler_) {
+       http_handler_->addStreamingRouteHandler(path, factory);
+   }
+}
+
+void WebServer::addDownloadRouteHandler(const std::string& pattern, DownloadRouteResolver resolver) {
+   if (http_handler_) {
+       http_handler_->addDownloadRouteHandler(pattern, resolver);
+   }
+}
+
 // ======== NEW CALLBACK-BASED WEBSOCKET INTERFACE ========
 
 std::string WebServer::onWebSocketConnected(std::function<EventResult(int connection_id, const ConnectionInfo&)> callback) {
@@ -762,7 +799,8 @@ void WebServer::requestCompletedCallback(void* cls, struct MHD_Connection* conne
    // Critical: Safe cleanup of connection-specific data to prevent memory leaks and corruption
    if (con_cls && *con_cls != nullptr) {
        // Validate the pointer before attempting to delete it
-       std::string* state = static_cast<std::string*>(*con_cls);
+       // Deleting the state also aborts any streaming body sink left unfinished
+       ConnectionState* state = static_cast<ConnectionState*>(*con_cls);
        try {
            delete state;
            *con_cls = nullptr;
@@ -808,13 +846,12 @@ enum MHD_Result WebServer::handleRequest(struct MHD_Connection* connection,
    // Critical: Proper MHD connection state handling to prevent core dumps
    if (nullptr == *con_cls) {
        // First call - initialize connection state with properly allocated memory
-       std::string* request_state = new std::string("initialized");
-       *con_cls = request_state;
+       *con_cls = new ConnectionState();
        return MHD_YES; // Tell MHD to call us again with initialized state
    }
 
    // Validate connection state to prevent memory corruption
-   std::string* state = static_cast<std::string*>(*con_cls);
+   ConnectionState* state = static_cast<ConnectionState*>(*con_cls);
    if (!state) {
        std::cerr << "Error: Invalid connection state detected" << std::endl;
        return MHD_NO;
@@ -824,6 +861,12 @@ enum MHD_Result WebServer::handleRequest(struct MHD_Connection* connection,
    std::string method_str(method);
    ENDPOINT_LOG("http", "Request: " + method_str + " " + url_str + " (processing)");
    
+   // Server-Sent Events stream: answered with a long-lived callback response
+   if (url_str == EventStream::PATH) {
+       return EventStream::handleRequest(connection, method_str,
+                                         config_.threading_mode != "thread_per_connection");
+   }
+
    // Try HTTP handler first (for API routes only)
    if (url_str.find("/api/") == 0) {
        ENDPOINT_LOG("http", "Processing as API route: " + url_str);
@@ -884,6 +927,32 @@ enum MHD_Result WebServer::handleRequest(struct MHD_Connection* connection,
 
 // ======== INTERNAL HELPERS ========
 
+unsigned int WebServer::buildDaemonFlags() const {
+   if (config_.threading_mode == "thread_per_connection") {
+       // Each connection gets its own thread, so a slow handler (backup, DNS, shell-outs)
+       // only stalls its own client
+       return MHD_USE_THREAD_PER_CONNECTION | MHD_USE_INTERNAL_POLLING_THREAD;
+   }
+   
+   // Polling modes park idle event streams with MHD_suspend_connection
+#if MHD_VERSION >= 0x00095900
+   unsigned int suspend_flag = MHD_ALLOW_SUSPEND_RESUME;
+#else
+   unsigned int suspend_flag = MHD_USE_SUSPEND_RESUME;
+#endif
+   
+   if (config_.threading_mode == "thread_pool") {
+       // Prefer epoll on Linux, fall back to poll() when MHD was built without it
+       if (MHD_is_feature_supported(MHD_FEATURE_EPOLL) == MHD_YES) {
+           return MHD_USE_EPOLL_INTERNAL_THREAD | suspend_flag;
+       }
+       return MHD_USE_POLL_INTERNAL_THREAD | suspend_flag;
+   }
+   
+   // "single": legacy behaviour, all requests served by one internal thread
+   return MHD_USE_INTERNAL_POLLING_THREAD | suspend_flag;
+}
+
 void WebServer::setupDefaultWebSocketCallbacks() {
    // Set up basic logging callbacks
    onWebSocketConnected([](int connection_id, const ConnectionInfo& info) -> EventResult {
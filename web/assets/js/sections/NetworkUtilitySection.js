@@ -44,6 +44,7 @@ class NetworkUtilitySection {
         // Test state management
         this.activeTests = new Map();
         this.updateIntervals = new Map();
+        this.eventStreams = new Map();
         this.serverStatusInterval = null;
         this.tracerouteStartTime = null;
 
@@ -157,21 +158,15 @@ class NetworkUtilitySection {
     }
 
     startTracerouteMonitoring(testId) {
-        this.stopTracerouteMonitoring(); // Clear any existing interval
+        this.stopTracerouteMonitoring(); // Clear any existing monitor
 
-        const interval = setInterval(async () => {
-            await this.updateTracerouteProgress(testId);
-        }, 1000);
-
-        this.updateIntervals.set('traceroute', interval);
+        this.watchTestEvents('traceroute', 'network-utility.traceroute', testId,
+            (test) => this.handleTracerouteUpdate(test),
+            () => this.updateTracerouteProgress(testId));
     }
 
     stopTracerouteMonitoring() {
-        const interval = this.updateIntervals.get('traceroute');
-        if (interval) {
-            clearInterval(interval);
-            this.updateIntervals.delete('traceroute');
-        }
+        this.stopWatchingTestEvents('traceroute');
     }
 
     async updateTracerouteProgress(testId) {
@@ -182,13 +177,7 @@ class NetworkUtilitySection {
                 const test = response.activeTests.find(t => t.testId === testId);
 
                 if (test) {
-                    this.updateTracerouteDisplay(test);
-
-                    if (!test.isRunning) {
-                        this.stopTracerouteMonitoring();
-                        this.updateTracerouteUI('complete');
-                        this.log('Traceroute completed');
-                    }
+                    this.handleTracerouteUpdate(test);
                 }
             }
         } catch (error) {
@@ -196,6 +185,16 @@ class NetworkUtilitySection {
         }
     }
 
+    handleTracerouteUpdate(test) {
+        this.updateTracerouteDisplay(test);
+
+        if (!test.isRunning) {
+            this.stopTracerouteMonitoring();
+            this.updateTracerouteUI('complete');
+            this.log('Traceroute completed');
+        }
+    }
+
     updateTracerouteDisplay(test) {
         // Update progress
         const progress = test.progress || 0;
@@ -435,19 +434,13 @@ class NetworkUtilitySection {
     startBandwidthMonitoring(testId) {
         this.stopBandwidthMonitoring();
 
-        const interval = setInterval(async () => {
-            await this.updateBandwidthProgress(testId);
-        }, 1000);
-
-        this.updateIntervals.set('bandwidth', interval);
+        this.watchTestEvents('bandwidth', 'network-utility.bandwidth', testId,
+            (data) => this.handleBandwidthUpdate(data),
+            () => this.updateBandwidthProgress(testId));
     }
 
     stopBandwidthMonitoring() {
-        const interval = this.updateIntervals.get('bandwidth');
-        if (interval) {
-            clearInterval(interval);
-            this.updateIntervals.delete('bandwidth');
-        }
+        this.stopWatchingTestEvents('bandwidth');
     }
 
     async updateBandwidthProgress(testId) {
@@ -455,32 +448,34 @@ class NetworkUtilitySection {
             const response = await this.makeApiRequest('GET', `${this.endpoints.bandwidth.status}?testId=${testId}`);
 
             if (response.success && response.testData) {
-                const data = response.testData;
-
-                // Update speed displays
-                this.updateElement('bandwidth-download', `${(data.downloadSpeed || 0).toFixed(2)} Mbps`);
-                this.updateElement('bandwidth-upload', `${(data.uploadSpeed || 0).toFixed(2)} Mbps`);
-                this.updateElement('bandwidth-latency', `${(data.latency || 0).toFixed(1)} ms`);
-
-                // Update progress
-                const progress = Math.round(data.progress || 0);
-                this.updateElement('bandwidth-progress-text', `${progress}% Complete`);
-                
-                const progressBar = document.getElementById('bandwidth-progress-bar');
-                if (progressBar) {
-                    progressBar.style.width = `${progress}%`;
-                }
-
-                if (!data.isRunning) {
-                    this.stopBandwidthMonitoring();
-                    this.updateBandwidthUI('complete');
-                }
+                this.handleBandwidthUpdate(response.testData);
             }
         } catch (error) {
             this.logError('Error updating bandwidth progress:', error);
         }
     }
 
+    handleBandwidthUpdate(data) {
+        // Update speed displays
+        this.updateElement('bandwidth-download', `${(data.downloadSpeed || 0).toFixed(2)} Mbps`);
+        this.updateElement('bandwidth-upload', `${(data.uploadSpeed || 0).toFixed(2)} Mbps`);
+        this.updateElement('bandwidth-latency', `${(data.latency || 0).toFixed(1)} ms`);
+
+        // Update progress
+        const progress = Math.round(data.progress || 0);
+        this.updateElement('bandwidth-progress-text', `${progress}% Complete`);
+        
+        const progressBar = document.getElementById('bandwidth-progress-bar');
+        if (progressBar) {
+            progressBar.style.width = `${progress}%`;
+        }
+
+        if (!data.isRunning) {
+            this.stopBandwidthMonitoring();
+            this.updateBandwidthUI('complete');
+        }
+    }
+
     updateBandwidthUI(state) {
         const startBtn = document.getElementById('start-bandwidth-test');
         const stopBtn = document.getElementById('stop-bandwidth-test');
@@ -667,19 +662,13 @@ class NetworkUtilitySection {
     startPingMonitoring(testId) {
         this.stopPingMonitoring();
 
-        const interval = setInterval(async () => {
-            await this.updatePingProgress(testId);
-        }, 1000);
-
-        this.updateIntervals.set('ping', interval);
+        this.watchTestEvents('ping', 'network-utility.ping', testId,
+            (test) => this.handlePingUpdate(test),
+            () => this.updatePingProgress(testId));
     }
 
     stopPingMonitoring() {
-        const interval = this.updateIntervals.get('ping');
-        if (interval) {
-            clearInterval(interval);
-            this.updateIntervals.delete('ping');
-        }
+        this.stopWatchingTestEvents('ping');
     }
 
     async updatePingProgress(testId) {
@@ -690,12 +679,7 @@ class NetworkUtilitySection {
                 const test = response.activeTests.find(t => t.testId === testId);
 
                 if (test) {
-                    this.updatePingDisplay(test);
-
-                    if (!test.isRunning) {
-                        this.stopPingMonitoring();
-                        this.updatePingUI('complete');
-                    }
+                    this.handlePingUpdate(test);
                 }
             }
         } catch (error) {
@@ -703,6 +687,15 @@ class NetworkUtilitySection {
         }
     }
 
+    handlePingUpdate(test) {
+        this.updatePingDisplay(test);
+
+        if (!test.isRunning) {
+            this.stopPingMonitoring();
+            this.updatePingUI('complete');
+        }
+    }
+
     updatePingDisplay(test) {
         // Update statistics
         this.updateElement('ping-packets-sent', test.packetsSent || 0);
@@ -1526,6 +1519,55 @@ class NetworkUtilitySection {
     }
 
     // Utility methods
+    // Follow a test through the server's event stream, falling back to
+    // polling every second when EventSource is unavailable or the stream fails
+    watchTestEvents(kind, topic, testId, onUpdate, poll) {
+        const startPolling = () => {
+            this.stopWatchingTestEvents(kind);
+            this.updateIntervals.set(kind, setInterval(poll, 1000));
+        };
+
+        if (!window.EventSource) {
+            startPolling();
+            return;
+        }
+
+        const source = new EventSource(`/api/events/stream?topics=${encodeURIComponent(topic)}`);
+        source.addEventListener(topic, (event) => {
+            try {
+                const update = JSON.parse(event.data);
+                // The stream replays the last event of the topic, which may be an earlier test
+                if (update.testId === testId) {
+                    onUpdate(update);
+                }
+            } catch (error) {
+                this.logError(`Invalid ${kind} event:`, error);
+            }
+        });
+        source.onerror = () => {
+            // EventSource retries on its own unless the server refused the stream
+            if (source.readyState === EventSource.CLOSED) {
+                this.log(`${kind} event stream unavailable, polling instead`);
+                startPolling();
+            }
+        };
+        this.eventStreams.set(kind, source);
+    }
+
+    stopWatchingTestEvents(kind) {
+        const source = this.eventStreams.get(kind);
+        if (source) {
+            source.close();
+            this.eventStreams.delete(kind);
+        }
+
+        const interval = this.updateIntervals.get(kind);
+        if (interval) {
+            clearInterval(interval);
+            this.updateIntervals.delete(kind);
+        }
+    }
+
     async makeApiRequest(method, url, data = null) {
         try {
             const options = {
@@ -1567,9 +1609,11 @@ class NetworkUtilitySection {
 
     // Cleanup method
     destroy() {
-        // Clear all intervals
+        // Clear all intervals and event streams
         this.updateIntervals.forEach(interval => clearInterval(interval));
         this.updateIntervals.clear();
+        this.eventStreams.forEach(source => source.close());
+        this.eventStreams.clear();
 
         if (this.serverStatusInterval) {
             clearInterval(this.serverStatusInterval);